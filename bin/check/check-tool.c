@@ -106,6 +106,7 @@ unsigned int zone_options = DNS_ZONEOPT_CHECKNS |
 			    DNS_ZONEOPT_WARNMXCNAME |
 			    DNS_ZONEOPT_WARNSRVCNAME;
 unsigned int zone_options2 = 0;
+unsigned int loadjobs = 1;
 
 /*
  * This needs to match the list in bin/named/log.c.
@@ -702,6 +703,7 @@ load_zone(isc_mem_t *mctx, const char *zonename, const char *filename,
 	dns_zone_setoption(zone, DNS_ZONEOPT_NOMERGE, nomerge);
 
 	dns_zone_setmaxttl(zone, maxttl);
+	dns_zone_setloadjobs(zone, loadjobs);
 
 	if (docheckmx)
 		dns_zone_setcheckmx(zone, checkmx);
@@ -48,6 +48,7 @@ extern isc_boolean_t docheckns;
 extern isc_boolean_t dochecksrv;
 extern unsigned int zone_options;
 extern unsigned int zone_options2;
+extern unsigned int loadjobs;
 
 ISC_LANG_ENDDECLS
 
@@ -75,7 +75,7 @@ usage(void) {
 		"[-n (ignore|warn|fail)] [-m (ignore|warn|fail)] "
 		"[-r (ignore|warn|fail)] "
 		"[-i (full|full-sibling|local|local-sibling|none)] "
-		"[-M (ignore|warn|fail)] [-S (ignore|warn|fail)] "
+		"[-M (ignore|warn|fail)] [-P jobs] [-S (ignore|warn|fail)] "
 		"[-W (ignore|warn)] "
 		"%s zonename filename\n",
 		prog_name,
@@ -162,7 +162,7 @@ main(int argc, char **argv) {
 	isc_commandline_errprint = ISC_FALSE;
 
 	while ((c = isc_commandline_parse(argc, argv,
-			       "c:df:hi:jJ:k:L:l:m:n:qr:s:t:o:vw:DF:M:S:T:W:"))
+			       "c:df:hi:jJ:k:L:l:m:n:qr:s:t:o:vw:DF:M:P:S:T:W:"))
 	       != EOF) {
 		switch (c) {
 		case 'c':
@@ -379,6 +379,16 @@ main(int argc, char **argv) {
 			}
 			break;
 
+		case 'P':
+			endp = NULL;
+			loadjobs = strtol(isc_commandline_argument, &endp, 0);
+			if (*endp != '\0' || loadjobs < 1 || loadjobs > 1024) {
+				fprintf(stderr, "number of jobs must be "
+						"between 1 and 1024\n");
+				exit(1);
+			}
+			break;
+
 		case 'S':
 			if (ARGCMP("fail")) {
 				zone_options &= ~DNS_ZONEOPT_WARNSRVCNAME;
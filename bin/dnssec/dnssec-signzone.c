@@ -36,6 +36,7 @@
 #include <isc/file.h>
 #include <isc/hash.h>
 #include <isc/hex.h>
+#include <isc/iterated_hash.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/os.h>
@@ -692,11 +693,25 @@ signset(dns_diff_t *del, dns_diff_t *add, dns_dbnode_t *node, dns_name_t *name,
 	isc_mem_put(mctx, nowsignedby, arraysize * sizeof(isc_boolean_t));
 }
 
+/*
+ * Names are queued and hashed HASHLIST_BATCH at a time, which lets
+ * isc_iterated_hash_batch() work on several of them at once.
+ */
+#define HASHLIST_BATCH 64
+
 struct hashlist {
 	unsigned char *hashbuf;
 	size_t entries;
 	size_t size;
 	size_t length;
+	/* Names waiting to be hashed. */
+	unsigned int pending;
+	unsigned int hashalg;
+	unsigned int iterations;
+	const unsigned char *salt;
+	size_t salt_len;
+	isc_boolean_t speculative[HASHLIST_BATCH];
+	dns_fixedname_t names[HASHLIST_BATCH];
 };
 
 static void
@@ -704,6 +719,7 @@ hashlist_init(hashlist_t *l, unsigned int nodes, unsigned int length) {
 
 	l->entries = 0;
 	l->length = length + 1;
+	l->pending = 0;
 
 	if (nodes != 0) {
 		l->size = nodes;
@@ -733,28 +749,65 @@ hashlist_add(hashlist_t *l, const unsigned char *hash, size_t len)
 	l->entries++;
 }
 
+/*
+ * Hash the queued names and add them to the list.
+ */
+static void
+hashlist_flush(hashlist_t *l) {
+	char nametext[DNS_NAME_FORMATSIZE];
+	unsigned char hashes[HASHLIST_BATCH][NSEC3_MAX_HASH_LENGTH + 1];
+	unsigned char *out[HASHLIST_BATCH];
+	const unsigned char *in[HASHLIST_BATCH];
+	int inlength[HASHLIST_BATCH];
+	dns_name_t *name;
+	unsigned int len, n;
+	size_t i;
+
+	if (l->pending == 0)
+		return;
+
+	for (n = 0; n < l->pending; n++) {
+		name = dns_fixedname_name(&l->names[n]);
+		in[n] = name->ndata;
+		inlength[n] = name->length;
+		out[n] = hashes[n];
+	}
+	len = isc_iterated_hash_batch(out, l->pending, l->hashalg,
+				      l->iterations, l->salt,
+				      (int)l->salt_len, in, inlength);
+	for (n = 0; n < l->pending; n++) {
+		if (verbose) {
+			name = dns_fixedname_name(&l->names[n]);
+			dns_name_format(name, nametext, sizeof nametext);
+			for (i = 0 ; i < len; i++)
+				fprintf(stderr, "%02x", hashes[n][i]);
+			fprintf(stderr, " %s\n", nametext);
+		}
+		hashes[n][len] = l->speculative[n] ? 1 : 0;
+		hashlist_add(l, hashes[n], len + 1);
+	}
+	l->pending = 0;
+}
+
 static void
 hashlist_add_dns_name(hashlist_t *l, /*const*/ dns_name_t *name,
 		      unsigned int hashalg, unsigned int iterations,
 		      const unsigned char *salt, size_t salt_len,
 		      isc_boolean_t speculative)
 {
-	char nametext[DNS_NAME_FORMATSIZE];
-	unsigned char hash[NSEC3_MAX_HASH_LENGTH + 1];
-	unsigned int len;
-	size_t i;
-
-	len = isc_iterated_hash(hash, hashalg, iterations,
-				salt, (int)salt_len,
-				name->ndata, name->length);
-	if (verbose) {
-		dns_name_format(name, nametext, sizeof nametext);
-		for (i = 0 ; i < len; i++)
-			fprintf(stderr, "%02x", hash[i]);
-		fprintf(stderr, " %s\n", nametext);
-	}
-	hash[len++] = speculative ? 1 : 0;
-	hashlist_add(l, hash, len);
+	INSIST(l->pending == 0 ||
+	       (l->hashalg == hashalg && l->iterations == iterations &&
+		l->salt == salt && l->salt_len == salt_len));
+
+	l->hashalg = hashalg;
+	l->iterations = iterations;
+	l->salt = salt;
+	l->salt_len = salt_len;
+	l->speculative[l->pending] = speculative;
+	dns_fixedname_init(&l->names[l->pending]);
+	dns_name_copy(name, dns_fixedname_name(&l->names[l->pending]), NULL);
+	if (++l->pending == HASHLIST_BATCH)
+		hashlist_flush(l);
 }
 
 static int
@@ -764,6 +817,7 @@ hashlist_comp(const void *a, const void *b) {
 
 static void
 hashlist_sort(hashlist_t *l) {
+	hashlist_flush(l);
 	qsort(l->hashbuf, l->entries, l->length, hashlist_comp);
 }
 
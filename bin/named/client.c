@@ -27,6 +27,7 @@
 #include <isc/util.h>
 
 #include <dns/adb.h>
+#include <dns/anscache.h>
 #include <dns/badcache.h>
 #include <dns/db.h>
 #include <dns/dispatch.h>
@@ -95,6 +96,13 @@
 #define SEND_BUFFER_SIZE		4096
 #define RECV_BUFFER_SIZE		4096
 
+/*%
+ * Number of clients listening on each UDP dispatch.  Their receives
+ * and sends are queued on the shared socket so that the socket manager
+ * can move several datagrams per system call.
+ */
+#define UDP_LISTENERS			8
+
 #ifdef ISC_PLATFORM_USETHREADS
 #define NMCTXS				100
 /*%<
@@ -592,6 +600,7 @@ exit_check(ns_client_t *client) {
 
 		ns_query_free(client);
 		isc_mem_put(client->mctx, client->recvbuf, RECV_BUFFER_SIZE);
+		isc_mem_put(client->mctx, client->sendbuf, SEND_BUFFER_SIZE);
 		isc_event_free((isc_event_t **)&client->sendevent);
 		isc_event_free((isc_event_t **)&client->recvevent);
 		isc_timer_detach(&client->timer);
@@ -844,7 +853,7 @@ client_senddone(isc_task_t *task, isc_event_t *event) {
 static isc_result_t
 client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
 		    isc_buffer_t *tcpbuffer, isc_uint32_t length,
-		    unsigned char *sendbuf, unsigned char **datap)
+		    unsigned char **datap)
 {
 	unsigned char *data;
 	isc_uint32_t bufsize;
@@ -875,7 +884,7 @@ client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
 			isc_buffer_putuint16(buffer, (isc_uint16_t)length);
 		}
 	} else {
-		data = sendbuf;
+		data = client->sendbuf;
 		if ((client->attributes & NS_CLIENTATTR_HAVECOOKIE) == 0) {
 			if (client->view != NULL)
 				bufsize = client->view->nocookieudp;
@@ -927,7 +936,7 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 				  &match, NULL) == ISC_R_SUCCESS &&
 		    match > 0)
 			return (DNS_R_BLACKHOLED);
-		sockflags |= ISC_SOCKFLAG_NORETRY;
+		sockflags |= ISC_SOCKFLAG_NORETRY | ISC_SOCKFLAG_BATCH;
 	}
 
 	if ((client->attributes & NS_CLIENTATTR_PKTINFO) != 0 &&
@@ -984,7 +993,6 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	isc_buffer_t buffer;
 	isc_region_t r;
 	isc_region_t *mr;
-	unsigned char sendbuf[SEND_BUFFER_SIZE];
 
 	REQUIRE(NS_CLIENT_VALID(client));
 
@@ -997,7 +1005,7 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	}
 
 	result = client_allocsendbuf(client, &buffer, NULL, mr->length,
-				     sendbuf, &data);
+				     &data);
 	if (result != ISC_R_SUCCESS)
 		goto done;
 
@@ -1023,6 +1031,232 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	ns_client_next(client, result);
 }
 
+/*
+ * Properties of a query, beyond its name, type, class and UDP buffer
+ * size, that change the rendered response.  They form the 'flags'
+ * part of the answer cache key.
+ */
+#define ANSCACHE_RD		0x01
+#define ANSCACHE_CD		0x02
+#define ANSCACHE_AD		0x04
+#define ANSCACHE_DO		0x08
+#define ANSCACHE_EDNS		0x10
+#define ANSCACHE_INET6		0x20
+
+/*%
+ * Fill in the answer cache key for the current query of 'client',
+ * answered from 'zone' at generation 'generation'.  Returns ISC_FALSE
+ * if the response depends on something other than the key and the
+ * zone data, in which case the answer cache must not be used.
+ */
+static isc_boolean_t
+client_anscachekey(ns_client_t *client, dns_zone_t *zone,
+		   isc_uint32_t generation, dns_anscachekey_t *key)
+{
+	dns_view_t *view = client->view;
+	dns_message_t *message = client->message;
+
+	if (view == NULL || view->anscache == NULL || zone == NULL ||
+	    TCP_CLIENT(client))
+		return (ISC_FALSE);
+
+	if (message->tsigkey != NULL || message->sig0key != NULL ||
+	    client->signer != NULL)
+		return (ISC_FALSE);
+
+	if ((client->attributes & (NS_CLIENTATTR_WANTEXPIRE |
+				   NS_CLIENTATTR_HAVEECS)) != 0 ||
+	    (WANTPAD(client) && view->padding > 0))
+		return (ISC_FALSE);
+#ifdef ALLOW_FILTER_AAAA
+	if ((client->attributes & NS_CLIENTATTR_FILTER_AAAA) != 0)
+		return (ISC_FALSE);
+#endif
+
+	if (view->rpzs != NULL || view->rrl != NULL || view->dns64cnt != 0 ||
+	    view->sortlist != NULL || view->nocasecompress != NULL ||
+	    view->v4_aaaa != dns_aaaa_ok || view->v6_aaaa != dns_aaaa_ok)
+		return (ISC_FALSE);
+#ifdef HAVE_DNSTAP
+	if (view->dtenv != NULL)
+		return (ISC_FALSE);
+#endif /* HAVE_DNSTAP */
+
+	key->name = client->query.origqname;
+	key->type = client->query.qtype;
+	key->rdclass = message->rdclass;
+	key->udpsize = client->udpsize;
+	key->owner = zone;
+	key->generation = generation;
+
+	key->flags = 0;
+	if ((message->flags & DNS_MESSAGEFLAG_RD) != 0)
+		key->flags |= ANSCACHE_RD;
+	if ((message->flags & DNS_MESSAGEFLAG_CD) != 0)
+		key->flags |= ANSCACHE_CD;
+	if ((client->attributes & NS_CLIENTATTR_WANTAD) != 0)
+		key->flags |= ANSCACHE_AD;
+	if ((client->attributes & NS_CLIENTATTR_WANTDNSSEC) != 0)
+		key->flags |= ANSCACHE_DO;
+	if (client->ednsversion >= 0)
+		key->flags |= ANSCACHE_EDNS;
+	if (isc_sockaddr_pf(&client->peeraddr) == AF_INET6)
+		key->flags |= ANSCACHE_INET6;
+
+	return (ISC_TRUE);
+}
+
+/*%
+ * Store the response just rendered into 'buffer' in the view's answer
+ * cache.  'prefixlen' is the length of the message before the OPT
+ * record was added; the OPT is regenerated for every cached answer.
+ */
+static void
+client_anscacheadd(ns_client_t *client, isc_buffer_t *buffer,
+		   unsigned int prefixlen, isc_boolean_t opt_included)
+{
+	dns_message_t *message = client->message;
+	dns_anscachekey_t key;
+	unsigned char *base;
+	unsigned int arcount;
+	isc_region_t r;
+
+	if ((client->query.attributes & NS_QUERYATTR_ANSCACHE) == 0 ||
+	    client->query.restarts != 0 ||
+	    (client->query.attributes & NS_QUERYATTR_REDIRECT) != 0 ||
+	    (message->flags & (DNS_MESSAGEFLAG_AA|DNS_MESSAGEFLAG_TC)) !=
+	    DNS_MESSAGEFLAG_AA ||
+	    (message->rcode != dns_rcode_noerror &&
+	     message->rcode != dns_rcode_nxdomain) ||
+	    message->padding_off > 0)
+		return;
+
+	if (!client_anscachekey(client, client->query.authzone,
+				client->query.anscachegen, &key))
+		return;
+
+	base = isc_buffer_base(buffer);
+	arcount = message->counts[DNS_SECTION_ADDITIONAL];
+	if (opt_included) {
+		INSIST(arcount > 0);
+		arcount--;
+	}
+
+	/*
+	 * Store the message as if it had been rendered without the
+	 * OPT, then restore the real ARCOUNT before the message is sent.
+	 */
+	base[10] = (arcount >> 8) & 0xff;
+	base[11] = arcount & 0xff;
+	r.base = base;
+	r.length = prefixlen;
+	(void)dns_anscache_add(client->view->anscache, &key, &r,
+			       client->query.anscachetag);
+	arcount = message->counts[DNS_SECTION_ADDITIONAL];
+	base[10] = (arcount >> 8) & 0xff;
+	base[11] = arcount & 0xff;
+}
+
+isc_result_t
+ns_client_findcached(ns_client_t *client, dns_zone_t *zone,
+		     isc_uint32_t generation, unsigned int *tagp,
+		     isc_buffer_t *buffer)
+{
+	isc_result_t result;
+	dns_anscachekey_t key;
+	unsigned char *data;
+	dns_rdataset_t *opt = NULL;
+	dns_compress_t cctx;
+	unsigned int count = 0, arcount;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(tagp != NULL);
+	REQUIRE(buffer != NULL);
+
+	if (!client_anscachekey(client, zone, generation, &key))
+		return (ISC_R_IGNORE);
+
+	result = client_allocsendbuf(client, buffer, NULL,
+				     DNS_MESSAGE_HEADERLEN, &data);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	result = dns_anscache_find(client->view->anscache, &key, buffer,
+				   tagp);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	data[0] = (client->message->id >> 8) & 0xff;
+	data[1] = client->message->id & 0xff;
+
+	/*
+	 * The OPT carries per-client data (COOKIE, NSID) so it is
+	 * never cached; build and append a fresh one.
+	 */
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		result = ns_client_addopt(client, client->message, &opt);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+		result = dns_compress_init(&cctx, -1, client->mctx);
+		if (result == ISC_R_SUCCESS) {
+			result = dns_rdataset_towire(opt, dns_rootname, &cctx,
+						     buffer, 0, &count);
+			dns_compress_invalidate(&cctx);
+		}
+		dns_rdataset_disassociate(opt);
+		dns_message_puttemprdataset(client->message, &opt);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+		arcount = ((data[10] << 8) | data[11]) + count;
+		data[10] = (arcount >> 8) & 0xff;
+		data[11] = arcount & 0xff;
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+ns_client_sendcached(ns_client_t *client, isc_buffer_t *buffer) {
+	isc_result_t result;
+	unsigned char *data;
+	dns_rcode_t rcode;
+	size_t respsize;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(!TCP_CLIENT(client));
+
+	CTRACE("sendcached");
+
+	data = isc_buffer_base(buffer);
+	rcode = data[3] & 0x0f;
+	respsize = isc_buffer_usedlength(buffer);
+
+	switch (isc_sockaddr_pf(&client->peeraddr)) {
+	case AF_INET:
+		isc_stats_increment(ns_g_server->udpoutstats4,
+				    ISC_MIN((int)respsize / 16, 256));
+		break;
+	case AF_INET6:
+		isc_stats_increment(ns_g_server->udpoutstats6,
+				    ISC_MIN((int)respsize / 16, 256));
+		break;
+	default:
+		INSIST(0);
+		break;
+	}
+
+	isc_stats_increment(ns_g_server->nsstats, dns_nsstatscounter_response);
+	dns_rcodestats_increment(ns_g_server->rcodestats, rcode);
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_edns0out);
+	}
+
+	result = client_sendpkg(client, buffer);
+	if (result != ISC_R_SUCCESS)
+		ns_client_next(client, result);
+}
+
 static void
 client_send(ns_client_t *client) {
 	isc_result_t result;
@@ -1032,10 +1266,10 @@ client_send(ns_client_t *client) {
 	isc_region_t r;
 	dns_compress_t cctx;
 	isc_boolean_t cleanup_cctx = ISC_FALSE;
-	unsigned char sendbuf[SEND_BUFFER_SIZE];
 	unsigned int render_opts;
 	unsigned int preferred_glue;
 	isc_boolean_t opt_included = ISC_FALSE;
+	unsigned int prefixlen;
 	size_t respsize;
 #ifdef HAVE_DNSTAP
 	unsigned char zone[DNS_NAME_MAXWIRE];
@@ -1103,7 +1337,7 @@ client_send(ns_client_t *client) {
 	 * XXXRTH  The following doesn't deal with TCP buffer resizing.
 	 */
 	result = client_allocsendbuf(client, &buffer, &tcpbuffer, 0,
-				     sendbuf, &data);
+				     &data);
 	if (result != ISC_R_SUCCESS)
 		goto done;
 
@@ -1181,11 +1415,15 @@ client_send(ns_client_t *client) {
 	if (result != ISC_R_SUCCESS && result != ISC_R_NOSPACE)
 		goto done;
  renderend:
+	prefixlen = isc_buffer_usedlength(&buffer);
 	result = dns_message_renderend(client->message);
 
 	if (result != ISC_R_SUCCESS)
 		goto done;
 
+	if (client->view != NULL && client->view->anscache != NULL)
+		client_anscacheadd(client, &buffer, prefixlen, opt_included);
+
 #ifdef HAVE_DNSTAP
 	memset(&zr, 0, sizeof(zr));
 	if (((client->message->flags & DNS_MESSAGEFLAG_AA) != 0) &&
@@ -3035,12 +3273,18 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
 		goto cleanup_sendevent;
 	}
 
+	client->sendbuf = isc_mem_get(client->mctx, SEND_BUFFER_SIZE);
+	if  (client->sendbuf == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_recvbuf;
+	}
+
 	client->recvevent = isc_socket_socketevent(client->mctx, client,
 						   ISC_SOCKEVENT_RECVDONE,
 						   client_request, client);
 	if (client->recvevent == NULL) {
 		result = ISC_R_NOMEMORY;
-		goto cleanup_recvbuf;
+		goto cleanup_sendbuf;
 	}
 
 	client->magic = NS_CLIENT_MAGIC;
@@ -3123,6 +3367,9 @@ client_create(ns_clientmgr_t *manager, ns_client_t **clientp) {
  cleanup_recvevent:
 	isc_event_free((isc_event_t **)&client->recvevent);
 
+ cleanup_sendbuf:
+	isc_mem_put(client->mctx, client->sendbuf, SEND_BUFFER_SIZE);
+
  cleanup_recvbuf:
 	isc_mem_put(client->mctx, client->recvbuf, RECV_BUFFER_SIZE);
 
@@ -3324,14 +3571,16 @@ client_udprecv(ns_client_t *client) {
 	r.base = client->recvbuf;
 	r.length = RECV_BUFFER_SIZE;
 	result = isc_socket_recv2(client->udpsocket, &r, 1,
-				  client->task, client->recvevent, 0);
+				  client->task, client->recvevent,
+				  ISC_SOCKFLAG_BATCH);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_socket_recv2() failed: %s",
 				 isc_result_totext(result));
 		/*
 		 * This cannot happen in the current implementation, since
-		 * isc_socket_recv2() cannot fail if flags == 0.
+		 * isc_socket_recv2() cannot fail without
+		 * ISC_SOCKFLAG_IMMEDIATE.
 		 *
 		 * If this does fail, we just go idle.
 		 */
@@ -3667,17 +3916,21 @@ ns_clientmgr_createclients(ns_clientmgr_t *manager, unsigned int n,
 			   ns_interface_t *ifp, isc_boolean_t tcp)
 {
 	isc_result_t result = ISC_R_SUCCESS;
-	unsigned int disp;
+	unsigned int disp, i, nlisteners;
 
 	REQUIRE(VALID_MANAGER(manager));
 	REQUIRE(n > 0);
 
 	MTRACE("createclients");
 
+	nlisteners = tcp ? 1 : UDP_LISTENERS;
 	for (disp = 0; disp < n; disp++) {
-		result = get_client(manager, ifp, ifp->udpdispatch[disp], tcp);
-		if (result != ISC_R_SUCCESS)
-			break;
+		for (i = 0; i < nlisteners; i++) {
+			result = get_client(manager, ifp,
+					    ifp->udpdispatch[disp], tcp);
+			if (result != ISC_R_SUCCESS)
+				return (result);
+		}
 	}
 
 	return (result);
@@ -43,6 +43,7 @@
 /*% default configuration */
 static char defaultconf[] = "\
 options {\n\
+	acl-cache-size 0;\n\
 	automatic-interface-scan yes;\n\
 	bindkeys-file \"" NS_SYSCONFDIR "/bind.keys\";\n\
 #	blackhole {none;};\n"
@@ -94,6 +95,7 @@ options {\n\
 "\
 	recursive-clients 1000;\n\
 	resolver-query-timeout 10;\n\
+	reuseport yes;\n\
 #	serial-queries <obsolete>;\n\
 	serial-query-rate 20;\n\
 	server-id none;\n\
@@ -109,6 +111,7 @@ options {\n\
 #	tkey-dhkey <none>\n\
 #	tkey-gssapi-credential <none>\n\
 #	tkey-domain <none>\n\
+	transfer-message-cache-size 0;\n\
 	transfer-message-size 20480;\n\
 	transfers-per-ns 2;\n\
 	transfers-in 10;\n\
@@ -117,6 +120,7 @@ options {\n\
 	trust-anchor-telemetry yes;\n\
 #	use-id-pool <obsolete>;\n\
 #	use-ixfr <obsolete>;\n\
+	validation-cache-size 10000;\n\
 	edns-udp-size 4096;\n\
 	max-udp-size 4096;\n\
 	nocookie-udp-size 4096;\n\
@@ -137,6 +141,7 @@ options {\n\
 #	allow-v6-synthesis <obsolete>;\n\
 #	sortlist <none>\n\
 #	topology <none>\n\
+	answer-cache-size 0;\n\
 	auth-nxdomain false;\n\
 	glue-cache yes;\n\
 	minimal-any false;\n\
@@ -227,6 +232,7 @@ options {\n\
 	max-transfer-time-out 120;\n\
 	max-transfer-idle-in 60;\n\
 	max-transfer-idle-out 60;\n\
+	masterfile-load-jobs 1;\n\
 	max-records 0;\n\
 	max-retry-time 1209600; /* 2 weeks */\n\
 	min-retry-time 500;\n\
@@ -235,6 +241,7 @@ options {\n\
 	multi-master no;\n\
 	dnssec-secure-to-insecure no;\n\
 	sig-validity-interval 30; /* days */\n\
+	sig-signing-jobs 1;\n\
 	sig-signing-nodes 100;\n\
 	sig-signing-signatures 10;\n\
 	sig-signing-type 65534;\n\
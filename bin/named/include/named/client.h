@@ -113,6 +113,7 @@ struct ns_client {
 	isc_socketevent_t *	sendevent;
 	isc_socketevent_t *	recvevent;
 	unsigned char *		recvbuf;
+	unsigned char *		sendbuf;
 	dns_rdataset_t *	opt;
 	isc_uint16_t		udpsize;
 	isc_uint16_t		extflags;
@@ -227,6 +228,34 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *msg);
  * send msg as a response using client->message->id for the id.
  */
 
+isc_result_t
+ns_client_findcached(ns_client_t *client, dns_zone_t *zone,
+		     isc_uint32_t generation, unsigned int *tagp,
+		     isc_buffer_t *buffer);
+/*%
+ * Look in the view's answer cache for a response to the current
+ * request answered from 'zone' at generation 'generation'.  If one is
+ * found, '*buffer' is set up to hold it, with the id and a freshly
+ * built OPT record for the current request, ready to be passed to
+ * ns_client_sendcached(), and '*tagp' is set to the tag it was
+ * stored with.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		a response is ready in '*buffer'
+ *\li	#ISC_R_NOTFOUND		no current response is stored; the
+ *				response may be stored once rendered
+ *\li	#ISC_R_IGNORE		the answer cache can't be used for
+ *				this request
+ *\li	Others			the request must be answered normally
+ */
+
+void
+ns_client_sendcached(ns_client_t *client, isc_buffer_t *buffer);
+/*%
+ * Finish processing the current client request by sending the
+ * response prepared by ns_client_findcached().
+ */
+
 void
 ns_client_error(ns_client_t *client, isc_result_t result);
 /*%
@@ -294,7 +323,9 @@ ns_clientmgr_createclients(ns_clientmgr_t *manager, unsigned int n,
 /*%
  * Create up to 'n' clients listening on interface 'ifp'.
  * If 'tcp' is ISC_TRUE, the clients will listen for TCP connections,
- * otherwise for UDP requests.
+ * otherwise for UDP requests, in which case 'n' is the number of UDP
+ * dispatches and several clients are created for each of them so
+ * that their I/O can be batched.
  */
 
 isc_sockaddr_t *
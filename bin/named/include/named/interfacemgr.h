@@ -153,6 +153,19 @@ ns_interfacemgr_setlistenon6(ns_interfacemgr_t *mgr, ns_listenlist_t *value);
  * The previous IPv6 listen-on list is freed.
  */
 
+void
+ns_interfacemgr_setudplisteners(ns_interfacemgr_t *mgr,
+				unsigned int udplisteners,
+				isc_boolean_t reuseport);
+/*%
+ * Set the number of UDP listeners opened for each new interface to
+ * 'udplisteners' (at most MAX_UDP_DISPATCH).  If 'reuseport' is true
+ * each listener is a separate socket bound with SO_REUSEPORT, so that
+ * the kernel spreads incoming queries among them; otherwise (or when
+ * the system does not support it) the listeners share one socket.
+ * Interfaces that are already listening are not affected.
+ */
+
 dns_aclenv_t *
 ns_interfacemgr_getaclenv(ns_interfacemgr_t *mgr);
 
@@ -45,6 +45,10 @@ struct ns_query {
 	dns_zone_t *			authzone;
 	isc_boolean_t			authdbset;
 	isc_boolean_t			isreferral;
+	isc_uint32_t			zonegen;
+	isc_boolean_t			zonegenvalid;
+	isc_uint32_t			anscachegen;
+	unsigned int			anscachetag;
 	isc_mutex_t			fetchlock;
 	dns_fetch_t *			fetch;
 	dns_fetch_t *			prefetch;
@@ -92,6 +96,7 @@ struct ns_query {
 #define NS_QUERYATTR_DNS64EXCLUDE	0x8000
 #define NS_QUERYATTR_RRL_CHECKED	0x10000
 #define NS_QUERYATTR_REDIRECT		0x20000
+#define NS_QUERYATTR_ANSCACHE		0x40000
 
 isc_result_t
 ns_query_init(ns_client_t *client);
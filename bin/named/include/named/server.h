@@ -22,6 +22,8 @@
 #include <dns/dnstap.h>
 #include <dns/types.h>
 
+#include <dst/dst.h>
+
 #include <named/types.h>
 
 #define NS_EVENTCLASS		ISC_EVENTCLASS(0x4E43)
@@ -72,6 +74,8 @@ struct ns_server {
 	ns_interfacemgr_t *	interfacemgr;
 	dns_db_t *		in_roothints;
 	dns_tkeyctx_t *		tkeyctx;
+	dns_sigcache_t *	sigcache;	/*%< Verified signatures */
+	dst_cryptopool_t *	cryptopool;	/*%< Signature verification */
 
 	isc_timer_t *		interface_timer;
 	isc_timer_t *		heartbeat_timer;
@@ -124,6 +128,7 @@ struct ns_server {
 	char *			lockfile;
 
 	isc_uint16_t		transfer_tcp_message_size;
+	ns_xfrcache_t *		xfrcache;	/*%< Rendered AXFR messages */
 };
 
 #define NS_SERVER_MAGIC			ISC_MAGIC('S','V','E','R')
@@ -205,7 +210,10 @@ enum {
 	dns_nsstatscounter_cookienew = 56,
 	dns_nsstatscounter_badcookie = 57,
 
-	dns_nsstatscounter_max = 58
+	dns_nsstatscounter_anscachehit = 58,
+	dns_nsstatscounter_anscachemiss = 59,
+
+	dns_nsstatscounter_max = 60
 };
 
 /*%
@@ -36,6 +36,7 @@ typedef struct ns_dispatch		ns_dispatch_t;
 typedef ISC_LIST(ns_dispatch_t)		ns_dispatchlist_t;
 typedef struct ns_statschannel		ns_statschannel_t;
 typedef ISC_LIST(ns_statschannel_t)	ns_statschannellist_t;
+typedef struct ns_xfrcache		ns_xfrcache_t;
 
 typedef enum {
 	ns_cookiealg_aes,
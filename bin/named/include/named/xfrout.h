@@ -27,4 +27,26 @@
 void
 ns_xfr_start(ns_client_t *client, dns_rdatatype_t xfrtype);
 
+isc_result_t
+ns_xfrcache_create(isc_mem_t *mctx, ns_xfrcache_t **cachep);
+/*%<
+ * Create a cache of rendered AXFR messages, shared between concurrent
+ * and subsequent transfers of the same version of a zone.  The cache
+ * is disabled until a size is set with ns_xfrcache_setsize().
+ */
+
+void
+ns_xfrcache_attach(ns_xfrcache_t *source, ns_xfrcache_t **targetp);
+
+void
+ns_xfrcache_detach(ns_xfrcache_t **cachep);
+
+void
+ns_xfrcache_setsize(ns_xfrcache_t *cache, size_t size);
+/*%<
+ * Limit the memory used by cached messages to 'size' bytes.  A size
+ * of zero disables the cache; messages held by transfers in progress
+ * are released when those transfers end.
+ */
+
 #endif /* NAMED_XFROUT_H */
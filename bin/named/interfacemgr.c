@@ -74,6 +74,8 @@ struct ns_interfacemgr {
 	dns_aclenv_t		aclenv;		/*%< Localhost/localnets ACLs */
 	ISC_LIST(ns_interface_t) interfaces;	/*%< List of interfaces. */
 	ISC_LIST(isc_sockaddr_t) listenon;
+	unsigned int		udplisteners;	/*%< UDP listeners per iface */
+	isc_boolean_t		reuseport;	/*%< Use SO_REUSEPORT */
 #ifdef USE_ROUTE_SOCKET
 	isc_task_t *		task;
 	isc_socket_t *		route;
@@ -193,6 +195,8 @@ ns_interfacemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	mgr->generation = 1;
 	mgr->listenon4 = NULL;
 	mgr->listenon6 = NULL;
+	mgr->udplisteners = ns_g_udpdisp;
+	mgr->reuseport = ISC_TRUE;
 
 	ISC_LIST_INIT(mgr->interfaces);
 	ISC_LIST_INIT(mgr->listenon);
@@ -411,6 +415,22 @@ ns_interface_create(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr,
 	return (ISC_R_UNEXPECTED);
 }
 
+static isc_result_t
+ns_interface_getudp(ns_interface_t *ifp, int disp, unsigned int attrs,
+		    unsigned int attrmask)
+{
+	return (dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
+					ns_g_socketmgr,
+					ns_g_taskmgr, &ifp->addr,
+					4096, UDPBUFFERS,
+					32768, 8219, 8237,
+					attrs, attrmask,
+					&ifp->udpdispatch[disp],
+					disp == 0
+					   ? NULL
+					   : ifp->udpdispatch[0]));
+}
+
 static isc_result_t
 ns_interface_listenudp(ns_interface_t *ifp) {
 	isc_result_t result;
@@ -429,18 +449,29 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	attrmask |= DNS_DISPATCHATTR_UDP | DNS_DISPATCHATTR_TCP;
 	attrmask |= DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_IPV6;
 
-	ifp->nudpdispatch = ISC_MIN(ns_g_udpdisp, MAX_UDP_DISPATCH);
+	ifp->nudpdispatch = ISC_MIN(ifp->mgr->udplisteners, MAX_UDP_DISPATCH);
+	if (ifp->nudpdispatch > 1 && ifp->mgr->reuseport) {
+		attrs |= DNS_DISPATCHATTR_REUSEPORT;
+		attrmask |= DNS_DISPATCHATTR_REUSEPORT;
+	}
 	for (disp = 0; disp < ifp->nudpdispatch; disp++) {
-		result = dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
-						 ns_g_socketmgr,
-						 ns_g_taskmgr, &ifp->addr,
-						 4096, UDPBUFFERS,
-						 32768, 8219, 8237,
-						 attrs, attrmask,
-						 &ifp->udpdispatch[disp],
-						 disp == 0
-						    ? NULL
-						    : ifp->udpdispatch[0]);
+		result = ns_interface_getudp(ifp, disp, attrs, attrmask);
+		if (result == ISC_R_NOTIMPLEMENTED && disp == 0 &&
+		    (attrs & DNS_DISPATCHATTR_REUSEPORT) != 0)
+		{
+			/*
+			 * The kernel cannot share the port among several
+			 * sockets; make the listeners share one socket.
+			 */
+			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_INFO,
+				      "SO_REUSEPORT not available, "
+				      "sharing one UDP socket among "
+				      "%d listeners", ifp->nudpdispatch);
+			attrs &= ~DNS_DISPATCHATTR_REUSEPORT;
+			attrmask &= ~DNS_DISPATCHATTR_REUSEPORT;
+			result = ns_interface_getudp(ifp, disp, attrs,
+						     attrmask);
+		}
 		if (result != ISC_R_SUCCESS) {
 			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
 				      "could not listen on UDP socket: %s",
@@ -1206,6 +1237,24 @@ ns_interfacemgr_setlistenon6(ns_interfacemgr_t *mgr, ns_listenlist_t *value) {
 	UNLOCK(&mgr->lock);
 }
 
+void
+ns_interfacemgr_setudplisteners(ns_interfacemgr_t *mgr,
+				unsigned int udplisteners,
+				isc_boolean_t reuseport)
+{
+	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
+
+	if (udplisteners < 1)
+		udplisteners = 1;
+	if (udplisteners > MAX_UDP_DISPATCH)
+		udplisteners = MAX_UDP_DISPATCH;
+
+	LOCK(&mgr->lock);
+	mgr->udplisteners = udplisteners;
+	mgr->reuseport = reuseport;
+	UNLOCK(&mgr->lock);
+}
+
 void
 ns_interfacemgr_dumprecursing(FILE *f, ns_interfacemgr_t *mgr) {
 	ns_interface_t *interface;
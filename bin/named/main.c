@@ -786,12 +786,8 @@ create_managers(void) {
 #ifdef WIN32
 	ns_g_udpdisp = 1;
 #else
-	if (ns_g_udpdisp == 0) {
-		if (ns_g_cpus_detected == 1)
-			ns_g_udpdisp = 1;
-		else
-			ns_g_udpdisp = ns_g_cpus_detected - 1;
-	}
+	if (ns_g_udpdisp == 0)
+		ns_g_udpdisp = ns_g_cpus;
 	if (ns_g_udpdisp > ns_g_cpus)
 		ns_g_udpdisp = ns_g_cpus;
 #endif
@@ -817,7 +813,13 @@ create_managers(void) {
 		return (ISC_R_UNEXPECTED);
 	}
 
-	result = isc_socketmgr_create2(ns_g_mctx, &ns_g_socketmgr, maxsocks);
+	/*
+	 * Use one socket watcher thread per worker thread, so that the
+	 * per-interface UDP listeners can each be serviced by a thread
+	 * of their own.
+	 */
+	result = isc_socketmgr_create2(ns_g_mctx, &ns_g_socketmgr, maxsocks,
+				       (int)ns_g_cpus);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_socketmgr_create() failed: %s",
@@ -373,6 +373,9 @@ query_resume(query_ctx_t *qctx);
 static isc_result_t
 query_sfcache(query_ctx_t *qctx);
 
+static isc_result_t
+query_anscache(query_ctx_t *qctx);
+
 static isc_result_t
 query_checkrrl(query_ctx_t *qctx, isc_result_t result);
 
@@ -526,6 +529,9 @@ query_send(ns_client_t *client) {
 	else /* We end up here in case of YXDOMAIN, and maybe others */
 		counter = dns_nsstatscounter_failure;
 
+	if ((client->query.attributes & NS_QUERYATTR_ANSCACHE) != 0)
+		client->query.anscachetag = counter;
+
 	inc_stats(client, counter);
 	ns_client_send(client);
 }
@@ -711,6 +717,10 @@ query_reset(ns_client_t *client, isc_boolean_t everything) {
 	client->query.gluedb = NULL;
 	client->query.authdbset = ISC_FALSE;
 	client->query.isreferral = ISC_FALSE;
+	client->query.zonegen = 0;
+	client->query.zonegenvalid = ISC_FALSE;
+	client->query.anscachegen = 0;
+	client->query.anscachetag = 0;
 	client->query.dns64_options = 0;
 	client->query.dns64_ttl = ISC_UINT32_MAX;
 }
@@ -1184,8 +1194,19 @@ query_getzonedb(ns_client_t *client, const dns_name_t *name,
 
 	if (result == DNS_R_PARTIALMATCH)
 		partial = ISC_TRUE;
-	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH)
+	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH) {
+		/*
+		 * Note the zone's generation before its database and
+		 * version are taken, so that an answer stored in the
+		 * answer cache under this generation can never be older
+		 * than the generation says.
+		 */
+		client->query.zonegenvalid =
+			ISC_TF(dns_zone_getgeneration(zone,
+					&client->query.zonegen) ==
+			       ISC_R_SUCCESS);
 		result = dns_zone_getdb(zone, &db);
+	}
 
 	if (result != ISC_R_SUCCESS)
 		goto fail;
@@ -1805,6 +1826,14 @@ query_addadditional(void *arg, const dns_name_t *name, dns_rdatatype_t qtype) {
 	 */
 	query_keepname(client, fname, dbuf);
 
+	/*
+	 * A change to another database would not invalidate an answer
+	 * cache entry, which only follows the generation of the zone
+	 * that was queried.
+	 */
+	if (db != client->query.authdb)
+		client->query.attributes &= ~NS_QUERYATTR_ANSCACHE;
+
 	/*
 	 * If we have an rdataset, add it to the additional data
 	 * section.
@@ -2080,6 +2109,10 @@ query_addrdataset(ns_client_t *client, dns_name_t *fname,
 		if (dbversion == NULL)
 			goto regular;
 
+		/* See query_addadditional(). */
+		if (client->query.gluedb != client->query.authdb)
+			client->query.attributes &= ~NS_QUERYATTR_ANSCACHE;
+
 #ifdef ALLOW_FILTER_AAAA
 		if (client->filter_aaaa == dns_aaaa_filter ||
 		    client->filter_aaaa == dns_aaaa_break_dnssec)
@@ -4903,11 +4936,65 @@ query_start(query_ctx_t *qctx) {
 		} else {
 			inc_stats(qctx->client, dns_nsstatscounter_udp);
 		}
+
+		if (qctx->is_zone && qctx->client->view->anscache != NULL) {
+			result = query_anscache(qctx);
+			if (result != ISC_R_COMPLETE) {
+				return (result);
+			}
+		}
 	}
 
 	return (query_lookup(qctx));
 }
 
+/*%
+ * Answer the query with a response stored in the view's answer cache,
+ * if there is a current one.  Returns ISC_R_COMPLETE if the query is
+ * to be looked up as usual; on a miss the query is marked so that the
+ * response will be stored once it has been rendered.
+ */
+static isc_result_t
+query_anscache(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	isc_buffer_t buffer;
+	isc_uint32_t generation;
+	unsigned int tag;
+	isc_result_t result;
+
+	if (qctx->zone == NULL || qctx->is_staticstub_zone ||
+	    !client->query.zonegenvalid)
+	{
+		return (ISC_R_COMPLETE);
+	}
+
+	generation = client->query.zonegen;
+	result = ns_client_findcached(client, qctx->zone, generation,
+				      &tag, &buffer);
+	if (result == ISC_R_NOTFOUND) {
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_anscachemiss);
+		client->query.attributes |= NS_QUERYATTR_ANSCACHE;
+		client->query.anscachegen = generation;
+		return (ISC_R_COMPLETE);
+	} else if (result != ISC_R_SUCCESS) {
+		return (ISC_R_COMPLETE);
+	}
+
+	CCTRACE(ISC_LOG_DEBUG(3), "query_anscache: hit");
+
+	isc_stats_increment(ns_g_server->nsstats,
+			    dns_nsstatscounter_anscachehit);
+	inc_stats(client, dns_nsstatscounter_authans);
+	inc_stats(client, (isc_statscounter_t)tag);
+
+	qctx_clean(qctx);
+	qctx_freedata(qctx);
+	ns_client_sendcached(client, &buffer);
+	ns_client_detach(&qctx->client);
+	return (ISC_R_SUCCESS);
+}
+
 /*%
  * Perform a local database lookup, in either an authoritative or
  * cache database. If unable to answer, call query_done(); otherwise
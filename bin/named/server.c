@@ -53,6 +53,7 @@
 #include <bind9/check.h>
 
 #include <dns/adb.h>
+#include <dns/anscache.h>
 #include <dns/badcache.h>
 #include <dns/cache.h>
 #include <dns/catz.h>
@@ -84,6 +85,7 @@
 #include <dns/rootns.h>
 #include <dns/rriterator.h>
 #include <dns/secalg.h>
+#include <dns/sigcache.h>
 #include <dns/soa.h>
 #include <dns/stats.h>
 #include <dns/tkey.h>
@@ -112,6 +114,7 @@
 #include <named/statschannel.h>
 #include <named/tkeyconf.h>
 #include <named/tsigconf.h>
+#include <named/xfrout.h>
 #include <named/zoneconf.h>
 #ifdef HAVE_LIBSCF
 #include <named/ns_smf_globals.h>
@@ -3331,6 +3334,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	isc_uint32_t max_cache_size_percent = 0;
 	size_t max_adb_size;
 	isc_uint32_t lame_ttl, fail_ttl;
+	isc_uint32_t anscache_size;
 	dns_tsig_keyring_t *ring = NULL;
 	dns_view_t *pview = NULL;	/* Production view */
 	isc_mem_t *cmctx = NULL, *hmctx = NULL;
@@ -3888,12 +3892,17 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	}
 
 	if (resstats == NULL) {
-		CHECK(isc_stats_create(mctx, &resstats,
-				       dns_resstatscounter_max));
+		CHECK(isc_stats_create2(mctx, &resstats,
+					dns_resstatscounter_max,
+					ISC_STATSCREATE_SHARDED));
 	}
 	dns_view_setresstats(view, resstats);
+	if (ns_g_server->sigcache != NULL)
+		dns_view_setsigcache(view, ns_g_server->sigcache);
+	dns_view_setcryptopool(view, ns_g_server->cryptopool);
 	if (resquerystats == NULL)
-		CHECK(dns_rdatatypestats_create(mctx, &resquerystats));
+		CHECK(dns_rdatatypestats_create(mctx, &resquerystats,
+						ISC_TRUE));
 	dns_view_setresquerystats(view, resquerystats);
 
 	ndisp = 4 * ISC_MIN(ns_g_udpdisp, MAX_UDP_DISPATCH);
@@ -4242,6 +4251,24 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	INSIST(result == ISC_R_SUCCESS);
 	view->use_glue_cache = cfg_obj_asboolean(obj);
 
+	/*
+	 * The answer cache only holds authoritative responses, which
+	 * can't depend on the resolver's cache when recursion is off.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "answer-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	anscache_size = cfg_obj_asuint32(obj);
+	if (anscache_size > 0 && view->recursion) {
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_WARNING,
+			      "view '%s': answer-cache-size ignored: "
+			      "recursion is enabled", view->name);
+	} else if (anscache_size > 0) {
+		CHECK(dns_anscache_create(mctx, anscache_size,
+					  &view->anscache));
+	}
+
 	obj = NULL;
 	result = ns_config_get(maps, "minimal-any", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -7108,6 +7135,40 @@ check_lockfile(ns_server_t *server, const cfg_obj_t *config,
 	return (ISC_R_FAILURE);
 }
 
+/*
+ * Turn asynchronous logging on or off according to the
+ * 'async-queue-size' and 'async-queue-overflow' logging options.
+ */
+static isc_result_t
+configure_asynclog(const cfg_obj_t *logobj) {
+	const cfg_obj_t *obj;
+	isc_uint32_t size = 0;
+	isc_logoverflow_t overflow = isc_logoverflow_block;
+	isc_result_t result;
+
+	if (logobj != NULL) {
+		obj = NULL;
+		(void)cfg_map_get(logobj, "async-queue-size", &obj);
+		if (obj != NULL)
+			size = cfg_obj_asuint32(obj);
+		obj = NULL;
+		(void)cfg_map_get(logobj, "async-queue-overflow", &obj);
+		if (obj != NULL &&
+		    strcasecmp(cfg_obj_asstring(obj), "drop") == 0)
+			overflow = isc_logoverflow_drop;
+	}
+
+	result = isc_log_setasync(ns_g_lctx, size, overflow);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_WARNING,
+			      "'async-queue-size' is not supported "
+			      "on this platform; logging synchronously");
+		result = ISC_R_SUCCESS;
+	}
+	return (result);
+}
+
 static isc_result_t
 load_configuration(const char *filename, ns_server_t *server,
 		   isc_boolean_t first_time)
@@ -7140,6 +7201,8 @@ load_configuration(const char *filename, ns_server_t *server,
 	isc_uint32_t reserved;
 	isc_uint32_t udpsize;
 	isc_uint32_t transfer_message_size;
+	isc_uint64_t xfrcache_size;
+	isc_uint32_t sigcache_size;
 	ns_cache_t *nsc;
 	ns_cachelist_t cachelist, tmpcachelist;
 	unsigned int maxsocks;
@@ -7341,6 +7404,30 @@ load_configuration(const char *filename, ns_server_t *server,
 	ns_g_server->aclenv.geoip_use_ecs = cfg_obj_asboolean(obj);
 #endif /* HAVE_GEOIP */
 
+	/*
+	 * Size of the per-ACL decision cache; this must be set before
+	 * any ACLs are configured.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "acl-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_g_aclconfctx->cachesize = cfg_obj_asuint32(obj);
+
+	/*
+	 * The cache of verified signatures is shared by all views, and
+	 * survives reconfiguration unless its size changes.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "validation-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	sigcache_size = cfg_obj_asuint32(obj);
+	if (server->sigcache != NULL &&
+	    dns_sigcache_getsize(server->sigcache) != sigcache_size)
+		dns_sigcache_detach(&server->sigcache);
+	if (server->sigcache == NULL && sigcache_size > 0)
+		CHECK(dns_sigcache_create(ns_g_mctx, sigcache_size,
+					  &server->sigcache));
+
 	/*
 	 * Configure various server options.
 	 */
@@ -7528,6 +7615,27 @@ load_configuration(const char *filename, ns_server_t *server,
 		transfer_message_size = 65535;
 	server->transfer_tcp_message_size = (isc_uint16_t) transfer_message_size;
 
+	/* Set the size of the shared AXFR message cache */
+	obj = NULL;
+	result = ns_config_get(maps, "transfer-message-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_isstring(obj)) {
+		/* "unlimited" */
+		xfrcache_size = SIZE_MAX;
+	} else {
+		xfrcache_size = cfg_obj_asuint64(obj);
+		if (xfrcache_size > SIZE_MAX) {
+			cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+				    "'transfer-message-cache-size "
+				    "%" ISC_PRINT_QUADFORMAT "u' "
+				    "is too large for this "
+				    "system; reducing to %lu",
+				    xfrcache_size, (unsigned long)SIZE_MAX);
+			xfrcache_size = SIZE_MAX;
+		}
+	}
+	ns_xfrcache_setsize(server->xfrcache, (size_t)xfrcache_size);
+
 	/*
 	 * Configure the zone manager.
 	 */
@@ -7579,6 +7687,29 @@ load_configuration(const char *filename, ns_server_t *server,
 	if ((ns_g_listen > 0) && (ns_g_listen < 10))
 		ns_g_listen = 10;
 
+	/*
+	 * Set the number of UDP listeners per interface.  Unless told
+	 * otherwise this follows "-U", which defaults to the number of
+	 * worker threads.
+	 */
+	{
+		unsigned int udplisteners = ns_g_udpdisp;
+		isc_boolean_t reuseport;
+
+		obj = NULL;
+		result = ns_config_get(maps, "udp-listeners", &obj);
+		if (result == ISC_R_SUCCESS)
+			udplisteners = cfg_obj_asuint32(obj);
+
+		obj = NULL;
+		result = ns_config_get(maps, "reuseport", &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		reuseport = cfg_obj_asboolean(obj);
+
+		ns_interfacemgr_setudplisteners(server->interfacemgr,
+						udplisteners, reuseport);
+	}
+
 	/*
 	 * Configure the interface manager according to the "listen-on"
 	 * statement.
@@ -8055,6 +8186,9 @@ load_configuration(const char *filename, ns_server_t *server,
 		       "installing logging configuration");
 		logc = NULL;
 
+		CHECKM(configure_asynclog(logobj),
+		       "configuring asynchronous logging");
+
 		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
 			      NS_LOGMODULE_SERVER, ISC_LOG_DEBUG(1),
 			      "now using logging configuration from "
@@ -8570,6 +8704,8 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 	dns_dispatchmgr_destroy(&ns_g_dispatchmgr);
 
 	dns_zonemgr_shutdown(server->zonemgr);
+	dst_cryptopool_detach(&server->cryptopool);
+	ns_xfrcache_detach(&server->xfrcache);
 
 	if (ns_g_sessionkey != NULL) {
 		dns_tsigkey_detach(&ns_g_sessionkey);
@@ -8656,6 +8792,7 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 		   "allocating reload event");
 
 	server->tkeyctx = NULL;
+	server->sigcache = NULL;
 	CHECKFATAL(dns_tkeyctx_create(ns_g_mctx, ns_g_entropy,
 				      &server->tkeyctx),
 		   "creating TKEY context");
@@ -8688,6 +8825,15 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 	CHECKFATAL(dns_zonemgr_setsize(server->zonemgr, 1000),
 		   "dns_zonemgr_setsize");
 
+	server->cryptopool = NULL;
+	CHECKFATAL(dst_cryptopool_create(ns_g_mctx, ns_g_taskmgr, ns_g_cpus,
+					 &server->cryptopool),
+		   "creating crypto pool");
+
+	server->xfrcache = NULL;
+	CHECKFATAL(ns_xfrcache_create(ns_g_mctx, &server->xfrcache),
+		   "creating zone transfer message cache");
+
 	server->statsfile = isc_mem_strdup(server->mctx, "named.stats");
 	CHECKFATAL(server->statsfile == NULL ? ISC_R_NOMEMORY : ISC_R_SUCCESS,
 		   "isc_mem_strdup");
@@ -8706,8 +8852,9 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 	server->tcpoutstats4 = NULL;
 	server->tcpinstats6 = NULL;
 	server->tcpoutstats6 = NULL;
-	CHECKFATAL(isc_stats_create(server->mctx, &server->sockstats,
-				    isc_sockstatscounter_max),
+	CHECKFATAL(isc_stats_create2(server->mctx, &server->sockstats,
+				     isc_sockstatscounter_max,
+				     ISC_STATSCREATE_SHARDED),
 		   "isc_stats_create");
 	isc_socketmgr_setstats(ns_g_socketmgr, server->sockstats);
 
@@ -8736,58 +8883,72 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 	server->server_usehostname = ISC_FALSE;
 	server->server_id = NULL;
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->nsstats,
-				    dns_nsstatscounter_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->nsstats,
+				     dns_nsstatscounter_max,
+				     ISC_STATSCREATE_SHARDED),
 		   "dns_stats_create (server)");
 
 	CHECKFATAL(dns_rdatatypestats_create(ns_g_mctx,
-					     &server->rcvquerystats),
+					     &server->rcvquerystats,
+					     ISC_TRUE),
 		   "dns_stats_create (rcvquery)");
 
-	CHECKFATAL(dns_opcodestats_create(ns_g_mctx, &server->opcodestats),
+	CHECKFATAL(dns_opcodestats_create(ns_g_mctx, &server->opcodestats,
+					  ISC_TRUE),
 		   "dns_stats_create (opcode)");
 
-	CHECKFATAL(dns_rcodestats_create(ns_g_mctx, &server->rcodestats),
+	CHECKFATAL(dns_rcodestats_create(ns_g_mctx, &server->rcodestats,
+					 ISC_TRUE),
 		   "dns_stats_create (rcode)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->zonestats,
-				    dns_zonestatscounter_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->zonestats,
+				     dns_zonestatscounter_max,
+				     ISC_STATSCREATE_SHARDED),
 		   "dns_stats_create (zone)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->resolverstats,
-				    dns_resstatscounter_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->resolverstats,
+				     dns_resstatscounter_max,
+				     ISC_STATSCREATE_SHARDED),
 		   "dns_stats_create (resolver)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpinstats4,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpinstats4,
+				     dns_sizecounter_in_max,
+				     ISC_STATSCREATE_SHARDED),
 		   "dns_stats_create (inbound UDP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpoutstats4,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpoutstats4,
+				     dns_sizecounter_out_max,
+				     ISC_STATSCREATE_SHARDED),
 		   "dns_stats_create (outbound UDP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpinstats6,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpinstats6,
+				     dns_sizecounter_in_max,
+				     ISC_STATSCREATE_SHARDED),
 		   "dns_stats_create (inbound UDP IPv6 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->udpoutstats6,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->udpoutstats6,
+				     dns_sizecounter_out_max,
+				     ISC_STATSCREATE_SHARDED),
 		   "dns_stats_create (outbound UDP IPv6 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpinstats4,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpinstats4,
+				     dns_sizecounter_in_max,
+				     ISC_STATSCREATE_SHARDED),
 		   "dns_stats_create (inbound TCP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpoutstats4,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpoutstats4,
+				     dns_sizecounter_out_max,
+				     ISC_STATSCREATE_SHARDED),
 		   "dns_stats_create (outbound TCP IPv4 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpinstats6,
-				    dns_sizecounter_in_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpinstats6,
+				     dns_sizecounter_in_max,
+				     ISC_STATSCREATE_SHARDED),
 		   "dns_stats_create (inbound TCP IPv6 traffic size)");
 
-	CHECKFATAL(isc_stats_create(ns_g_mctx, &server->tcpoutstats6,
-				    dns_sizecounter_out_max),
+	CHECKFATAL(isc_stats_create2(ns_g_mctx, &server->tcpoutstats6,
+				     dns_sizecounter_out_max,
+				     ISC_STATSCREATE_SHARDED),
 		   "dns_stats_create (outbound TCP IPv6 traffic size)");
 
 	server->flushonshutdown = ISC_FALSE;
@@ -8866,6 +9027,9 @@ ns_server_destroy(ns_server_t **serverp) {
 	if (server->tkeyctx != NULL)
 		dns_tkeyctx_destroy(&server->tkeyctx);
 
+	if (server->sigcache != NULL)
+		dns_sigcache_detach(&server->sigcache);
+
 	dst_lib_destroy();
 
 	isc_event_free(&server->reload_event);
@@ -13084,6 +13248,8 @@ ns_server_zonestatus(ns_server_t *server, isc_lex_t *lex,
 	char zonename[DNS_NAME_FORMATSIZE];
 	isc_uint32_t serial, signed_serial, nodes;
 	char serbuf[16], sserbuf[16], nodebuf[16], resignbuf[512];
+	char signbuf[64];
+	isc_uint64_t signatures = 0, usecs = 0;
 	char lbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
 	char xbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
 	char rbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
@@ -13232,6 +13398,16 @@ ns_server_zonestatus(ns_server_t *server, isc_lex_t *lex,
 		}
 	}
 
+	/* Signatures generated by incremental signing and re-signing */
+	dns_zone_getsigningstats(zone, &signatures, &usecs);
+	if (signatures != 0) {
+		snprintf(signbuf, sizeof(signbuf),
+			 "%" ISC_PRINT_QUADFORMAT "u (%" ISC_PRINT_QUADFORMAT
+			 "u per second)", signatures,
+			 usecs == 0 ? signatures
+				    : signatures * 1000000 / usecs);
+	}
+
 	/* Create text */
 	CHECK(putstr(text, "name: "));
 	CHECK(putstr(text, zonename));
@@ -13302,6 +13478,11 @@ ns_server_zonestatus(ns_server_t *server, isc_lex_t *lex,
 		CHECK(putstr(text, rtbuf));
 	}
 
+	if (signatures != 0) {
+		CHECK(putstr(text, "\nsignatures generated: "));
+		CHECK(putstr(text, signbuf));
+	}
+
 	if (dynamic) {
 		CHECK(putstr(text, "\ndynamic: yes"));
 		if (frozen)
@@ -28,6 +28,7 @@
 #include <dns/rdataclass.h>
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
+#include <dns/rrl.h>
 #include <dns/stats.h>
 #include <dns/view.h>
 #include <dns/zt.h>
@@ -290,6 +291,10 @@ init_desc(void) {
 		"resulted in a successful remote lookup",
 		"QryNXRedirRLookup");
 	SET_NSSTATDESC(badcookie, "sent badcookie response", "QryBADCOOKIE");
+	SET_NSSTATDESC(anscachehit, "queries answered from the answer cache",
+		       "AnsCacheHit");
+	SET_NSSTATDESC(anscachemiss, "answer cache lookups that missed",
+		       "AnsCacheMiss");
 	INSIST(i == dns_nsstatscounter_max);
 
 	/* Initialize resolver statistics */
@@ -377,6 +382,13 @@ init_desc(void) {
 	SET_RESSTATDESC(serverquota, "spilled due to server quota",
 			"ServerQuota");
 	SET_RESSTATDESC(nextitem, "waited for next item", "NextItem");
+	SET_RESSTATDESC(bucketpeak, "peak fetches in one bucket",
+			"BucketPeak");
+	SET_RESSTATDESC(bucketresize, "bucket fetch table resizes",
+			"BucketResize");
+	SET_RESSTATDESC(sigcachehit, "validation cache hits", "ValCacheHit");
+	SET_RESSTATDESC(sigcachemiss, "validation cache misses",
+			"ValCacheMiss");
 
 	INSIST(i == dns_resstatscounter_max);
 
@@ -552,6 +564,28 @@ init_desc(void) {
 	SET_SOCKSTATDESC(unixactive, "Unix domain sockets active",
 			 "UnixActive");
 	SET_SOCKSTATDESC(rawactive, "Raw sockets active", "RawActive");
+	SET_SOCKSTATDESC(udprecvbatch1, "UDP recv batches of 1 datagram",
+			 "UDPRecvBatch1");
+	SET_SOCKSTATDESC(udprecvbatch2, "UDP recv batches of 2-3 datagrams",
+			 "UDPRecvBatch2");
+	SET_SOCKSTATDESC(udprecvbatch4, "UDP recv batches of 4-7 datagrams",
+			 "UDPRecvBatch4");
+	SET_SOCKSTATDESC(udprecvbatch8, "UDP recv batches of 8-15 datagrams",
+			 "UDPRecvBatch8");
+	SET_SOCKSTATDESC(udprecvbatch16,
+			 "UDP recv batches of 16 or more datagrams",
+			 "UDPRecvBatch16");
+	SET_SOCKSTATDESC(udpsendbatch1, "UDP send batches of 1 datagram",
+			 "UDPSendBatch1");
+	SET_SOCKSTATDESC(udpsendbatch2, "UDP send batches of 2-3 datagrams",
+			 "UDPSendBatch2");
+	SET_SOCKSTATDESC(udpsendbatch4, "UDP send batches of 4-7 datagrams",
+			 "UDPSendBatch4");
+	SET_SOCKSTATDESC(udpsendbatch8, "UDP send batches of 8-15 datagrams",
+			 "UDPSendBatch8");
+	SET_SOCKSTATDESC(udpsendbatch16,
+			 "UDP send batches of 16 or more datagrams",
+			 "UDPSendBatch16");
 	INSIST(i == isc_sockstatscounter_max);
 
 	/* Initialize DNSSEC statistics */
@@ -3539,6 +3573,19 @@ ns_stats_dump(ns_server_t *server, FILE *fp) {
 				     adbstats_index, adbstat_values, 0);
 	}
 
+	fprintf(fp, "++ Response Rate Limiting ++\n");
+	for (view = ISC_LIST_HEAD(server->viewlist);
+	     view != NULL;
+	     view = ISC_LIST_NEXT(view, link)) {
+		if (view->rrl == NULL)
+			continue;
+		if (strcmp(view->name, "_default") == 0)
+			fprintf(fp, "[View: default]\n");
+		else
+			fprintf(fp, "[View: %s]\n", view->name);
+		dns_rrl_dumpstats(view->rrl, fp);
+	}
+
 	fprintf(fp, "++ Socket I/O Statistics ++\n");
 	(void) dump_counters(server->sockstats, isc_statsformat_file, fp, NULL,
 			     sockstats_desc, isc_sockstatscounter_max,
@@ -11,10 +11,13 @@
 #include <config.h>
 
 #include <isc/formatcheck.h>
+#include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/timer.h>
 #include <isc/print.h>
 #include <isc/stats.h>
+#include <isc/string.h>
 #include <isc/util.h>
 
 #include <dns/db.h>
@@ -67,6 +70,15 @@
 
 #define XFROUT_RR_LOGLEVEL	ISC_LOG_DEBUG(8)
 
+/*%
+ * Transmit buffers.  While one is being sent the next is filled with
+ * as many messages as fit, so that rendering overlaps with sending and
+ * each write carries several messages.  A buffer is always started
+ * with room for a maximum-sized message and its length prefix.
+ */
+#define XFROUT_TXBUFS		2
+#define XFROUT_TXBUFSIZE	(3 * (2 + 65535))
+
 /*%
  * Fail unconditionally and log as a client error.
  * The test against ISC_R_SUCCESS is there to keep the Solaris compiler
@@ -639,6 +651,318 @@ static rrstream_methods_t compound_rrstream_methods = {
 	compound_rrstream_destroy
 };
 
+/**************************************************************************/
+/*
+ * Rendered AXFR messages, shared between transfers of the same version
+ * of a zone when "transfer-message-cache-size" is set.
+ *
+ * Messages are only shared by transfers that are neither signed with
+ * TSIG nor answered with an EDNS option, so that every message after
+ * the first is the same for all of them apart from the message ID.
+ * The first message carries the question section and is never shared:
+ * message 'n' of a transfer is message 'n - 1' of its cache entry.
+ *
+ * A transfer that gets to the end of an entry renders the next message
+ * itself and appends it, so concurrent transfers of a zone share the
+ * rendering between them.
+ */
+
+typedef struct xfrmsg xfrmsg_t;
+typedef struct xfrentry xfrentry_t;
+
+struct xfrmsg {
+	unsigned int		rrcount;	/* RRs in the message */
+	unsigned int		length;		/* Length of 'data' */
+	unsigned char		*data;		/* Length prefix and message */
+	ISC_LINK(xfrmsg_t)	link;
+};
+
+struct xfrentry {
+	dns_db_t		*db;
+	isc_uint32_t		serial;
+	unsigned int		flags;		/* Message header flags */
+	unsigned int		msgsize;	/* transfer-message-size */
+	isc_boolean_t		many_answers;
+	isc_boolean_t		complete;	/* Has the last message */
+	unsigned int		references;
+	size_t			size;
+	ISC_LIST(xfrmsg_t)	msgs;
+	ISC_LINK(xfrentry_t)	link;
+};
+
+#define XFRCACHE_MAGIC		ISC_MAGIC('X', 'f', 'r', 'C')
+#define VALID_XFRCACHE(c)	ISC_MAGIC_VALID(c, XFRCACHE_MAGIC)
+
+struct ns_xfrcache {
+	unsigned int		magic;
+	isc_mem_t		*mctx;
+	isc_mutex_t		lock;
+	/* Locked by lock. */
+	unsigned int		references;
+	size_t			maxsize;
+	size_t			size;
+	ISC_LIST(xfrentry_t)	entries;	/* Most recently used first */
+};
+
+/*
+ * Free 'entry'.  Caller must be holding the cache lock.
+ */
+static void
+xfrcache_freeentry(ns_xfrcache_t *cache, xfrentry_t *entry) {
+	xfrmsg_t *msg;
+
+	INSIST(entry->references == 0);
+
+	while ((msg = ISC_LIST_HEAD(entry->msgs)) != NULL) {
+		ISC_LIST_UNLINK(entry->msgs, msg, link);
+		isc_mem_put(cache->mctx, msg, sizeof(*msg) + msg->length);
+	}
+	ISC_LIST_UNLINK(cache->entries, entry, link);
+	INSIST(cache->size >= entry->size);
+	cache->size -= entry->size;
+	dns_db_detach(&entry->db);
+	isc_mem_put(cache->mctx, entry, sizeof(*entry));
+}
+
+/*
+ * Free unused entries, least recently used first, until 'need' more
+ * bytes fit.  Caller must be holding the cache lock.
+ */
+static isc_boolean_t
+xfrcache_evict(ns_xfrcache_t *cache, size_t need) {
+	xfrentry_t *entry, *prev;
+
+	for (entry = ISC_LIST_TAIL(cache->entries);
+	     entry != NULL && cache->size + need > cache->maxsize;
+	     entry = prev)
+	{
+		prev = ISC_LIST_PREV(entry, link);
+		if (entry->references == 0)
+			xfrcache_freeentry(cache, entry);
+	}
+	return (ISC_TF(cache->size + need <= cache->maxsize &&
+		       need <= cache->maxsize));
+}
+
+isc_result_t
+ns_xfrcache_create(isc_mem_t *mctx, ns_xfrcache_t **cachep) {
+	ns_xfrcache_t *cache;
+	isc_result_t result;
+
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	if (cache == NULL)
+		return (ISC_R_NOMEMORY);
+	result = isc_mutex_init(&cache->lock);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(mctx, cache, sizeof(*cache));
+		return (result);
+	}
+	cache->mctx = NULL;
+	isc_mem_attach(mctx, &cache->mctx);
+	cache->references = 1;
+	cache->maxsize = 0;
+	cache->size = 0;
+	ISC_LIST_INIT(cache->entries);
+	cache->magic = XFRCACHE_MAGIC;
+
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+}
+
+void
+ns_xfrcache_attach(ns_xfrcache_t *source, ns_xfrcache_t **targetp) {
+	REQUIRE(VALID_XFRCACHE(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	LOCK(&source->lock);
+	INSIST(source->references > 0);
+	source->references++;
+	UNLOCK(&source->lock);
+
+	*targetp = source;
+}
+
+void
+ns_xfrcache_detach(ns_xfrcache_t **cachep) {
+	ns_xfrcache_t *cache;
+	xfrentry_t *entry;
+	isc_boolean_t destroy;
+
+	REQUIRE(cachep != NULL && VALID_XFRCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	LOCK(&cache->lock);
+	INSIST(cache->references > 0);
+	cache->references--;
+	destroy = ISC_TF(cache->references == 0);
+	UNLOCK(&cache->lock);
+
+	if (!destroy)
+		return;
+
+	while ((entry = ISC_LIST_HEAD(cache->entries)) != NULL)
+		xfrcache_freeentry(cache, entry);
+	INSIST(cache->size == 0);
+	cache->magic = 0;
+	DESTROYLOCK(&cache->lock);
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+void
+ns_xfrcache_setsize(ns_xfrcache_t *cache, size_t size) {
+	REQUIRE(VALID_XFRCACHE(cache));
+
+	LOCK(&cache->lock);
+	cache->maxsize = size;
+	(void)xfrcache_evict(cache, 0);
+	UNLOCK(&cache->lock);
+}
+
+/*
+ * Find or create the entry for a transfer of version 'serial' of 'db'
+ * and take a reference to it.  Older versions of the zone that are no
+ * longer being transferred are dropped.  Returns NULL if the cache is
+ * disabled.
+ */
+static xfrentry_t *
+xfrcache_getentry(ns_xfrcache_t *cache, dns_db_t *db, isc_uint32_t serial,
+		  unsigned int flags, unsigned int msgsize,
+		  isc_boolean_t many_answers)
+{
+	xfrentry_t *entry, *next;
+
+	LOCK(&cache->lock);
+	if (cache->maxsize == 0) {
+		UNLOCK(&cache->lock);
+		return (NULL);
+	}
+
+	for (entry = ISC_LIST_HEAD(cache->entries);
+	     entry != NULL;
+	     entry = next)
+	{
+		next = ISC_LIST_NEXT(entry, link);
+		if (entry->db == db && entry->serial == serial) {
+			if (entry->flags == flags &&
+			    entry->msgsize == msgsize &&
+			    entry->many_answers == many_answers)
+				break;
+			continue;
+		}
+		if (entry->references == 0 &&
+		    dns_db_class(entry->db) == dns_db_class(db) &&
+		    dns_name_equal(dns_db_origin(entry->db),
+				   dns_db_origin(db)))
+			xfrcache_freeentry(cache, entry);
+	}
+
+	if (entry == NULL && xfrcache_evict(cache, sizeof(*entry))) {
+		entry = isc_mem_get(cache->mctx, sizeof(*entry));
+		if (entry != NULL) {
+			entry->db = NULL;
+			dns_db_attach(db, &entry->db);
+			entry->serial = serial;
+			entry->flags = flags;
+			entry->msgsize = msgsize;
+			entry->many_answers = many_answers;
+			entry->complete = ISC_FALSE;
+			entry->references = 0;
+			entry->size = sizeof(*entry);
+			ISC_LIST_INIT(entry->msgs);
+			ISC_LINK_INIT(entry, link);
+			ISC_LIST_APPEND(cache->entries, entry, link);
+			cache->size += entry->size;
+		}
+	}
+
+	if (entry != NULL) {
+		ISC_LIST_UNLINK(cache->entries, entry, link);
+		ISC_LIST_PREPEND(cache->entries, entry, link);
+		entry->references++;
+	}
+	UNLOCK(&cache->lock);
+
+	return (entry);
+}
+
+static void
+xfrcache_putentry(ns_xfrcache_t *cache, xfrentry_t **entryp) {
+	xfrentry_t *entry = *entryp;
+
+	*entryp = NULL;
+
+	LOCK(&cache->lock);
+	INSIST(entry->references > 0);
+	entry->references--;
+	(void)xfrcache_evict(cache, 0);
+	UNLOCK(&cache->lock);
+}
+
+/*
+ * Return the message after 'msg' in 'entry', or the first message if
+ * 'msg' is NULL; NULL if there is none yet.
+ */
+static xfrmsg_t *
+xfrcache_next(ns_xfrcache_t *cache, xfrentry_t *entry, xfrmsg_t *msg) {
+	LOCK(&cache->lock);
+	if (msg == NULL)
+		msg = ISC_LIST_HEAD(entry->msgs);
+	else
+		msg = ISC_LIST_NEXT(msg, link);
+	UNLOCK(&cache->lock);
+
+	return (msg);
+}
+
+/*
+ * A transfer positioned after '*msgp' in 'entry' has rendered the next
+ * message itself.  Append it unless another transfer got there first,
+ * and point '*msgp' at the entry's copy.  Returns ISC_FALSE if the
+ * entry cannot hold the message.
+ */
+static isc_boolean_t
+xfrcache_append(ns_xfrcache_t *cache, xfrentry_t *entry, xfrmsg_t **msgp,
+		const unsigned char *data, unsigned int length,
+		unsigned int rrcount, isc_boolean_t last)
+{
+	xfrmsg_t *msg, *next;
+	isc_boolean_t appended = ISC_FALSE;
+
+	LOCK(&cache->lock);
+	msg = *msgp;
+	next = (msg == NULL) ? ISC_LIST_HEAD(entry->msgs)
+			     : ISC_LIST_NEXT(msg, link);
+	if (next != NULL) {
+		*msgp = next;
+		appended = ISC_TRUE;
+	} else if (!entry->complete &&
+		   xfrcache_evict(cache, sizeof(*next) + length))
+	{
+		next = isc_mem_get(cache->mctx, sizeof(*next) + length);
+		if (next != NULL) {
+			next->rrcount = rrcount;
+			next->length = length;
+			next->data = (unsigned char *)(next + 1);
+			memmove(next->data, data, length);
+			ISC_LINK_INIT(next, link);
+			ISC_LIST_APPEND(entry->msgs, next, link);
+			entry->size += sizeof(*next) + length;
+			cache->size += sizeof(*next) + length;
+			if (last)
+				entry->complete = ISC_TRUE;
+			*msgp = next;
+			appended = ISC_TRUE;
+		}
+	}
+	UNLOCK(&cache->lock);
+
+	return (appended);
+}
+
 /**************************************************************************/
 /*
  * An 'xfrout_ctx_t' contains the state of an outgoing AXFR or IXFR
@@ -660,11 +984,17 @@ typedef struct {
 	isc_boolean_t		end_of_stream;	/* EOS has been reached */
 	isc_buffer_t 		buf;		/* Buffer for message owner
 						   names and rdatas */
-	isc_buffer_t 		txlenbuf;	/* Transmit length buffer */
-	isc_buffer_t		txbuf;		/* Transmit message buffer */
+	isc_buffer_t		txbuf[XFROUT_TXBUFS];
+						/* Transmit buffers */
+	unsigned int		txnext;		/* Next transmit buffer */
 	void 			*txmem;
 	unsigned int 		txmemlen;
+	unsigned int		msgsize;	/* transfer-message-size */
 	unsigned int		nmsg;		/* Number of messages sent */
+	ns_xfrcache_t		*cache;
+	xfrentry_t		*cacheentry;	/* Shared messages */
+	xfrmsg_t		*cachemsg;	/* Last shared message */
+	unsigned int		nshared;	/* Messages not rendered */
 	dns_tsigkey_t		*tsigkey;	/* Key used to create TSIG */
 	isc_buffer_t		*lasttsig;	/* the last TSIG */
 	isc_boolean_t		verified_tsig;	/* verified request MAC */
@@ -687,6 +1017,12 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client,
 		  isc_boolean_t many_answers,
 		  xfrout_ctx_t **xfrp);
 
+static isc_result_t
+rendermessage(xfrout_ctx_t *xfr, isc_buffer_t *tx, unsigned int *rrcountp);
+
+static isc_result_t
+nextmessage(xfrout_ctx_t *xfr, isc_buffer_t *tx);
+
 static void
 sendstream(xfrout_ctx_t *xfr);
 
@@ -1056,6 +1392,28 @@ ns_xfr_start(ns_client_t *client, dns_rdatatype_t reqtype) {
 	stream = NULL;
 	quota = NULL;
 
+	/*
+	 * Plain AXFRs of a zone may share their rendered messages with
+	 * other transfers of the same version.
+	 */
+	if (reqtype == dns_rdatatype_axfr && !is_dlz &&
+	    xfr->tsigkey == NULL &&
+	    (client->attributes & NS_CLIENTATTR_TCP) != 0 &&
+	    (client->attributes & NS_CLIENTATTR_WANTOPT) == 0 &&
+	    ns_g_server->xfrcache != NULL)
+	{
+		unsigned int flags = DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_AA;
+
+		if ((client->attributes & NS_CLIENTATTR_RA) != 0)
+			flags |= DNS_MESSAGEFLAG_RA;
+		xfr->cacheentry = xfrcache_getentry(ns_g_server->xfrcache,
+						    xfr->db, current_serial,
+						    flags, xfr->msgsize,
+						    xfr->many_answers);
+		if (xfr->cacheentry != NULL)
+			ns_xfrcache_attach(ns_g_server->xfrcache, &xfr->cache);
+	}
+
 	CHECK(xfr->stream->methods->first(xfr->stream));
 
 	if (xfr->tsigkey != NULL)
@@ -1148,7 +1506,7 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client, unsigned int id,
 {
 	xfrout_ctx_t *xfr;
 	isc_result_t result;
-	unsigned int len;
+	unsigned int i, len;
 	void *mem;
 
 	INSIST(xfrp != NULL && *xfrp == NULL);
@@ -1176,7 +1534,13 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client, unsigned int id,
 	xfr->verified_tsig = verified_tsig;
 	xfr->txmem = NULL;
 	xfr->txmemlen = 0;
+	xfr->txnext = 0;
+	xfr->msgsize = ns_g_server->transfer_tcp_message_size;
 	xfr->nmsg = 0;
+	xfr->cache = NULL;
+	xfr->cacheentry = NULL;
+	xfr->cachemsg = NULL;
+	xfr->nshared = 0;
 	xfr->many_answers = many_answers;
 	xfr->sends = 0;
 	xfr->shuttingdown = ISC_FALSE;
@@ -1207,17 +1571,19 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client, unsigned int id,
 	isc_buffer_init(&xfr->buf, mem, len);
 
 	/*
-	 * Allocate another temporary buffer for the compressed
-	 * response message and its TCP length prefix.
+	 * Allocate the transmit buffers for the compressed response
+	 * messages and their TCP length prefixes.
 	 */
-	len = 2 + 65535;
+	len = XFROUT_TXBUFS * XFROUT_TXBUFSIZE;
 	mem = isc_mem_get(mctx, len);
 	if (mem == NULL) {
 		result = ISC_R_NOMEMORY;
 		goto failure;
 	}
-	isc_buffer_init(&xfr->txlenbuf, mem, 2);
-	isc_buffer_init(&xfr->txbuf, (char *) mem + 2, len - 2);
+	for (i = 0; i < XFROUT_TXBUFS; i++)
+		isc_buffer_init(&xfr->txbuf[i],
+				(char *) mem + i * XFROUT_TXBUFSIZE,
+				XFROUT_TXBUFSIZE);
 	xfr->txmem = mem;
 	xfr->txmemlen = len;
 
@@ -1248,18 +1614,17 @@ failure:
 
 
 /*
- * Arrange to send as much as we can of "stream" without blocking.
- *
- * Requires:
- *	The stream iterator is initialized and points at an RR,
- *      or possibly at the end of the stream (that is, the
- *      _first method of the iterator has been called).
+ * Render the next message of "stream".  Over TCP the message is
+ * appended to 'tx', preceded by its length; over UDP ('tx' is NULL) it
+ * is built in the client message, which the caller sends.  The number
+ * of RRs in the message is returned in '*rrcountp'.
  */
-static void
-sendstream(xfrout_ctx_t *xfr) {
+static isc_result_t
+rendermessage(xfrout_ctx_t *xfr, isc_buffer_t *tx, unsigned int *rrcountp) {
 	dns_message_t *tcpmsg = NULL;
 	dns_message_t *msg = NULL; /* Client message if UDP, tcpmsg if TCP */
 	isc_result_t result;
+	isc_buffer_t txbuf;
 	isc_region_t used;
 	isc_region_t region;
 	dns_rdataset_t *qrdataset;
@@ -1272,12 +1637,11 @@ sendstream(xfrout_ctx_t *xfr) {
 	isc_boolean_t is_tcp;
 
 	int n_rrs;
+	unsigned int rrcount = 0;
 
 	isc_buffer_clear(&xfr->buf);
-	isc_buffer_clear(&xfr->txlenbuf);
-	isc_buffer_clear(&xfr->txbuf);
 
-	is_tcp = ISC_TF((xfr->client->attributes & NS_CLIENTATTR_TCP) != 0);
+	is_tcp = ISC_TF(tx != NULL);
 	if (!is_tcp) {
 		/*
 		 * In the UDP case, we put the response data directly into
@@ -1471,6 +1835,7 @@ sendstream(xfrout_ctx_t *xfr) {
 
 		dns_message_addname(msg, msgname, DNS_SECTION_ANSWER);
 		msgname = NULL;
+		rrcount++;
 
 		result = xfr->stream->methods->next(xfr->stream);
 		if (result == ISC_R_NOMORE) {
@@ -1486,8 +1851,8 @@ sendstream(xfrout_ctx_t *xfr) {
 		 * the message. Check if we want to clamp this message
 		 * here (TCP only).
 		 */
-		if ((isc_buffer_usedlength(&xfr->buf) >=
-		     ns_g_server->transfer_tcp_message_size) && is_tcp)
+		if ((isc_buffer_usedlength(&xfr->buf) >= xfr->msgsize) &&
+		    is_tcp)
 			break;
 	}
 
@@ -1495,37 +1860,33 @@ sendstream(xfrout_ctx_t *xfr) {
 		CHECK(dns_compress_init(&cctx, -1, xfr->mctx));
 		dns_compress_setsensitive(&cctx, ISC_TRUE);
 		cleanup_cctx = ISC_TRUE;
-		CHECK(dns_message_renderbegin(msg, &cctx, &xfr->txbuf));
+
+		/*
+		 * Render after the space for the length prefix.
+		 */
+		isc_buffer_availableregion(tx, &region);
+		INSIST(region.length >= 2 + 65535);
+		isc_buffer_init(&txbuf, region.base + 2, 65535);
+		CHECK(dns_message_renderbegin(msg, &cctx, &txbuf));
 		CHECK(dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0));
 		CHECK(dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0));
 		CHECK(dns_message_renderend(msg));
 		dns_compress_invalidate(&cctx);
 		cleanup_cctx = ISC_FALSE;
 
-		isc_buffer_usedregion(&xfr->txbuf, &used);
-		isc_buffer_putuint16(&xfr->txlenbuf,
-				     (isc_uint16_t)used.length);
-		region.base = xfr->txlenbuf.base;
-		region.length = 2 + used.length;
+		isc_buffer_usedregion(&txbuf, &used);
+		isc_buffer_putuint16(tx, (isc_uint16_t)used.length);
+		isc_buffer_add(tx, used.length);
 		xfrout_log(xfr, ISC_LOG_DEBUG(8),
-			   "sending TCP message of %d bytes",
+			   "rendered TCP message of %d bytes",
 			   used.length);
-		CHECK(isc_socket_send(xfr->client->tcpsocket, /* XXX */
-				      &region, xfr->client->task,
-				      xfrout_senddone,
-				      xfr));
-		xfr->sends++;
-	} else {
-		xfrout_log(xfr, ISC_LOG_DEBUG(8), "sending IXFR UDP response");
-		ns_client_send(xfr->client);
-		xfr->stream->methods->pause(xfr->stream);
-		xfrout_ctx_destroy(&xfr);
-		return;
-	}
 
-	/* Advance lasttsig to be the last TSIG generated */
-	CHECK(dns_message_getquerytsig(msg, xfr->mctx, &xfr->lasttsig));
+		/* Advance lasttsig to be the last TSIG generated */
+		CHECK(dns_message_getquerytsig(msg, xfr->mctx,
+					       &xfr->lasttsig));
+	}
 
+	*rrcountp = rrcount;
 	xfr->nmsg++;
 
  failure:
@@ -1549,6 +1910,134 @@ sendstream(xfrout_ctx_t *xfr) {
 
 	if (cleanup_cctx)
 		dns_compress_invalidate(&cctx);
+
+	return (result);
+}
+
+/*
+ * Append the next TCP message of the transfer to 'tx'.  If another
+ * transfer has already rendered it, copy it from the cache entry and
+ * skip its RRs in "stream"; otherwise render it and offer it to the
+ * cache entry.
+ */
+static isc_result_t
+nextmessage(xfrout_ctx_t *xfr, isc_buffer_t *tx) {
+	xfrmsg_t *cmsg = NULL;
+	isc_region_t r;
+	isc_result_t result;
+	isc_boolean_t shared;
+	unsigned int i, start, rrcount;
+
+	/*
+	 * The first message holds the question and is never shared.
+	 */
+	shared = ISC_TF(xfr->cacheentry != NULL && xfr->nmsg > 0);
+	if (shared)
+		cmsg = xfrcache_next(xfr->cache, xfr->cacheentry,
+				     xfr->cachemsg);
+
+	if (cmsg != NULL) {
+		isc_buffer_availableregion(tx, &r);
+		INSIST(r.length >= cmsg->length);
+		memmove(r.base, cmsg->data, cmsg->length);
+		/* Message ID. */
+		r.base[2] = (xfr->id >> 8) & 0xff;
+		r.base[3] = xfr->id & 0xff;
+		isc_buffer_add(tx, cmsg->length);
+
+		result = ISC_R_SUCCESS;
+		for (i = 0; i < cmsg->rrcount && result == ISC_R_SUCCESS; i++)
+			result = xfr->stream->methods->next(xfr->stream);
+		if (result == ISC_R_NOMORE && i == cmsg->rrcount) {
+			xfr->end_of_stream = ISC_TRUE;
+			result = ISC_R_SUCCESS;
+		} else if (result == ISC_R_NOMORE)
+			result = ISC_R_UNEXPECTED;
+		if (result != ISC_R_SUCCESS)
+			return (result);
+
+		xfr->cachemsg = cmsg;
+		xfr->nmsg++;
+		xfr->nshared++;
+		return (ISC_R_SUCCESS);
+	}
+
+	start = isc_buffer_usedlength(tx);
+	result = rendermessage(xfr, tx, &rrcount);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	if (shared &&
+	    !xfrcache_append(xfr->cache, xfr->cacheentry, &xfr->cachemsg,
+			     (unsigned char *)isc_buffer_base(tx) + start,
+			     isc_buffer_usedlength(tx) - start, rrcount,
+			     xfr->end_of_stream))
+	{
+		/*
+		 * The cache is full: render the rest of the transfer
+		 * ourselves.
+		 */
+		xfrcache_putentry(xfr->cache, &xfr->cacheentry);
+		xfr->cachemsg = NULL;
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Arrange to send as much as we can of "stream" without blocking.
+ *
+ * Over TCP, messages are rendered into a transmit buffer until it
+ * has no room for another one, and the whole buffer is sent with a
+ * single write.  Up to XFROUT_TXBUFS buffers are in flight at once,
+ * so that the next messages are rendered while earlier ones are still
+ * being sent.
+ *
+ * Requires:
+ *	The stream iterator is initialized and points at an RR,
+ *      or possibly at the end of the stream (that is, the
+ *      _first method of the iterator has been called).
+ */
+static void
+sendstream(xfrout_ctx_t *xfr) {
+	isc_buffer_t *tx;
+	isc_region_t region;
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int rrcount;
+
+	if ((xfr->client->attributes & NS_CLIENTATTR_TCP) == 0) {
+		result = rendermessage(xfr, NULL, &rrcount);
+		xfr->stream->methods->pause(xfr->stream);
+		if (result != ISC_R_SUCCESS) {
+			xfrout_fail(xfr, result, "sending zone data");
+			return;
+		}
+		xfrout_log(xfr, ISC_LOG_DEBUG(8), "sending IXFR UDP response");
+		ns_client_send(xfr->client);
+		xfrout_ctx_destroy(&xfr);
+		return;
+	}
+
+	while (xfr->sends < XFROUT_TXBUFS && !xfr->end_of_stream) {
+		tx = &xfr->txbuf[xfr->txnext];
+		isc_buffer_clear(tx);
+		do {
+			CHECK(nextmessage(xfr, tx));
+		} while (!xfr->end_of_stream &&
+			 isc_buffer_availablelength(tx) >= 2 + 65535);
+
+		isc_buffer_usedregion(tx, &region);
+		xfrout_log(xfr, ISC_LOG_DEBUG(8),
+			   "sending %u bytes of TCP messages", region.length);
+		CHECK(isc_socket_send(xfr->client->tcpsocket, /* XXX */
+				      &region, xfr->client->task,
+				      xfrout_senddone,
+				      xfr));
+		xfr->sends++;
+		xfr->txnext = (xfr->txnext + 1) % XFROUT_TXBUFS;
+	}
+
+ failure:
 	/*
 	 * Make sure to release any locks held by database
 	 * iterators before returning from the event handler.
@@ -1573,6 +2062,10 @@ xfrout_ctx_destroy(xfrout_ctx_t **xfrp) {
 
 	if (xfr->stream != NULL)
 		xfr->stream->methods->destroy(&xfr->stream);
+	if (xfr->cacheentry != NULL)
+		xfrcache_putentry(xfr->cache, &xfr->cacheentry);
+	if (xfr->cache != NULL)
+		ns_xfrcache_detach(&xfr->cache);
 	if (xfr->buf.base != NULL)
 		isc_mem_put(xfr->mctx, xfr->buf.base, xfr->buf.length);
 	if (xfr->txmem != NULL)
@@ -1612,7 +2105,6 @@ xfrout_senddone(isc_task_t *task, isc_event_t *event) {
 
 	isc_event_free(&event);
 	xfr->sends--;
-	INSIST(xfr->sends == 0);
 
 	(void)isc_timer_touch(xfr->client->timer);
 	if (xfr->shuttingdown == ISC_TRUE) {
@@ -1621,10 +2113,14 @@ xfrout_senddone(isc_task_t *task, isc_event_t *event) {
 		xfrout_fail(xfr, evresult, "send");
 	} else if (xfr->end_of_stream == ISC_FALSE) {
 		sendstream(xfr);
-	} else {
+	} else if (xfr->sends == 0) {
 		/* End of zone transfer stream. */
 		inc_stats(xfr->zone, dns_nsstatscounter_xfrdone);
 		xfrout_log(xfr, ISC_LOG_INFO, "%s ended", xfr->mnemonic);
+		if (xfr->nshared > 0)
+			xfrout_log(xfr, ISC_LOG_DEBUG(3),
+				   "%u of %u messages shared",
+				   xfr->nshared, xfr->nmsg);
 		ns_client_next(xfr->client, ISC_R_SUCCESS);
 		xfrout_ctx_destroy(&xfr);
 	}
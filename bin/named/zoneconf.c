@@ -799,6 +799,7 @@ ns_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 	const char *dupcheck;
 	dns_notifytype_t notifytype = dns_notifytype_yes;
 	isc_uint32_t count;
+	unsigned int jobs;
 	unsigned int dbargc;
 	char **dbargv;
 	static char default_dbtype[] = "rbt";
@@ -999,6 +1000,12 @@ ns_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 	if (zone != mayberaw)
 		dns_zone_setmaxrecords(zone, 0);
 
+	obj = NULL;
+	result = ns_config_get(maps, "masterfile-load-jobs", &obj);
+	INSIST(result == ISC_R_SUCCESS && obj != NULL);
+	jobs = cfg_obj_asuint32(obj);
+	dns_zone_setloadjobs(mayberaw, jobs == 0 ? ns_g_cpus : jobs);
+
 	if (raw != NULL && filename != NULL) {
 #define SIGNED ".signed"
 		size_t signedlen = strlen(filename) + sizeof(SIGNED);
@@ -1099,7 +1106,7 @@ ns_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		RETERR(isc_stats_create(mctx, &zoneqrystats,
 					dns_nsstatscounter_max));
 		RETERR(dns_rdatatypestats_create(mctx,
-					&rcvquerystats));
+					&rcvquerystats, ISC_FALSE));
 	}
 	dns_zone_setrequeststats(zone,  zoneqrystats);
 	dns_zone_setrcvquerystats(zone, rcvquerystats);
@@ -1426,6 +1433,12 @@ ns_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
 		dns_zone_setnodes(zone, cfg_obj_asuint32(obj));
 
+		obj = NULL;
+		result = ns_config_get(maps, "sig-signing-jobs", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		jobs = cfg_obj_asuint32(obj);
+		dns_zone_setsignjobs(zone, jobs == 0 ? ns_g_cpus : jobs);
+
 		obj = NULL;
 		result = ns_config_get(maps, "sig-signing-type", &obj);
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
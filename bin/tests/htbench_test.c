@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Hash table benchmark.
+ *
+ * Adds a set of keys to an isc_ht table, looks each of them up, looks
+ * up the same number of absent keys and deletes them all again,
+ * reporting the average time per operation for each phase.  The same
+ * is then done with a copy of the fixed-size chained table that isc_ht
+ * used to be, for comparison.  Both tables start with 2^bits buckets.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/commandline.h>
+#include <isc/hash.h>
+#include <isc/ht.h>
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#define KEYSIZE		32
+
+static isc_mem_t *mctx = NULL;
+static unsigned int nkeys = 100000;
+static unsigned int bits = 12;
+static unsigned char *keys = NULL;
+static unsigned char *absent = NULL;
+static isc_uint32_t *keylens = NULL;
+
+/*
+ * The chained table, as it was before isc_ht grew open addressing.
+ */
+typedef struct chain_node chain_node_t;
+
+struct chain_node {
+	void *value;
+	chain_node_t *next;
+	size_t keysize;
+	unsigned char key[];
+};
+
+typedef struct {
+	size_t size;
+	size_t mask;
+	chain_node_t **table;
+} chain_t;
+
+static isc_result_t
+chain_init(void **tablep, isc_uint8_t nbits) {
+	chain_t *ht;
+	size_t i;
+
+	ht = isc_mem_get(mctx, sizeof(*ht));
+	if (ht == NULL)
+		return (ISC_R_NOMEMORY);
+	ht->size = (size_t)1 << nbits;
+	ht->mask = ht->size - 1;
+	ht->table = isc_mem_get(mctx, ht->size * sizeof(chain_node_t *));
+	if (ht->table == NULL) {
+		isc_mem_put(mctx, ht, sizeof(*ht));
+		return (ISC_R_NOMEMORY);
+	}
+	for (i = 0; i < ht->size; i++)
+		ht->table[i] = NULL;
+
+	*tablep = ht;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+chain_destroy(void **tablep) {
+	chain_t *ht = *tablep;
+	chain_node_t *node, *next;
+	size_t i;
+
+	for (i = 0; i < ht->size; i++) {
+		for (node = ht->table[i]; node != NULL; node = next) {
+			next = node->next;
+			isc_mem_put(mctx, node,
+				    sizeof(chain_node_t) + node->keysize);
+		}
+	}
+	isc_mem_put(mctx, ht->table, ht->size * sizeof(chain_node_t *));
+	isc_mem_put(mctx, ht, sizeof(*ht));
+	*tablep = NULL;
+}
+
+static isc_result_t
+chain_add(void *table, const unsigned char *key, isc_uint32_t keysize,
+	  void *value)
+{
+	chain_t *ht = table;
+	chain_node_t *node;
+	isc_uint32_t hash;
+
+	hash = isc_hash_function(key, keysize, ISC_TRUE, NULL);
+	for (node = ht->table[hash & ht->mask];
+	     node != NULL;
+	     node = node->next)
+	{
+		if (keysize == node->keysize &&
+		    memcmp(key, node->key, keysize) == 0)
+			return (ISC_R_EXISTS);
+	}
+
+	node = isc_mem_get(mctx, sizeof(chain_node_t) + keysize);
+	if (node == NULL)
+		return (ISC_R_NOMEMORY);
+	memmove(node->key, key, keysize);
+	node->keysize = keysize;
+	node->value = value;
+	node->next = ht->table[hash & ht->mask];
+	ht->table[hash & ht->mask] = node;
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+chain_find(void *table, const unsigned char *key, isc_uint32_t keysize,
+	   void **valuep)
+{
+	chain_t *ht = table;
+	chain_node_t *node;
+	isc_uint32_t hash;
+
+	hash = isc_hash_function(key, keysize, ISC_TRUE, NULL);
+	for (node = ht->table[hash & ht->mask];
+	     node != NULL;
+	     node = node->next)
+	{
+		if (keysize == node->keysize &&
+		    memcmp(key, node->key, keysize) == 0)
+		{
+			*valuep = node->value;
+			return (ISC_R_SUCCESS);
+		}
+	}
+	return (ISC_R_NOTFOUND);
+}
+
+static isc_result_t
+chain_delete(void *table, const unsigned char *key, isc_uint32_t keysize) {
+	chain_t *ht = table;
+	chain_node_t *node, *prev = NULL;
+	isc_uint32_t hash;
+
+	hash = isc_hash_function(key, keysize, ISC_TRUE, NULL);
+	for (node = ht->table[hash & ht->mask];
+	     node != NULL;
+	     prev = node, node = node->next)
+	{
+		if (keysize == node->keysize &&
+		    memcmp(key, node->key, keysize) == 0)
+		{
+			if (prev == NULL)
+				ht->table[hash & ht->mask] = node->next;
+			else
+				prev->next = node->next;
+			isc_mem_put(mctx, node,
+				    sizeof(chain_node_t) + node->keysize);
+			return (ISC_R_SUCCESS);
+		}
+	}
+	return (ISC_R_NOTFOUND);
+}
+
+/*
+ * Thin wrappers so that isc_ht fits the same table of operations.
+ */
+static isc_result_t
+ht_init(void **tablep, isc_uint8_t nbits) {
+	isc_ht_t *ht = NULL;
+	isc_result_t result;
+
+	result = isc_ht_init(&ht, mctx, nbits);
+	*tablep = ht;
+	return (result);
+}
+
+static void
+ht_destroy(void **tablep) {
+	isc_ht_t *ht = *tablep;
+
+	isc_ht_destroy(&ht);
+	*tablep = NULL;
+}
+
+static isc_result_t
+ht_add(void *table, const unsigned char *key, isc_uint32_t keysize,
+       void *value)
+{
+	return (isc_ht_add(table, key, keysize, value));
+}
+
+static isc_result_t
+ht_find(void *table, const unsigned char *key, isc_uint32_t keysize,
+	void **valuep)
+{
+	return (isc_ht_find(table, key, keysize, valuep));
+}
+
+static isc_result_t
+ht_delete(void *table, const unsigned char *key, isc_uint32_t keysize) {
+	return (isc_ht_delete(table, key, keysize));
+}
+
+typedef struct {
+	const char *name;
+	isc_result_t (*init)(void **, isc_uint8_t);
+	void (*destroy)(void **);
+	isc_result_t (*add)(void *, const unsigned char *, isc_uint32_t,
+			    void *);
+	isc_result_t (*find)(void *, const unsigned char *, isc_uint32_t,
+			     void **);
+	isc_result_t (*del)(void *, const unsigned char *, isc_uint32_t);
+} impl_t;
+
+static impl_t impls[] = {
+	{ "isc_ht", ht_init, ht_destroy, ht_add, ht_find, ht_delete },
+	{ "chained", chain_init, chain_destroy, chain_add, chain_find,
+	  chain_delete }
+};
+
+static void
+report(const char *name, const char *phase, isc_time_t *start) {
+	isc_time_t finish;
+	isc_uint64_t usecs;
+
+	TIME_NOW(&finish);
+	usecs = isc_time_microdiff(&finish, start);
+	printf("%-8s %-8s %8llu.%03llu ms %6llu ns/op\n", name, phase,
+	       (unsigned long long)(usecs / 1000),
+	       (unsigned long long)(usecs % 1000),
+	       (unsigned long long)(usecs * 1000 / nkeys));
+	TIME_NOW(start);
+}
+
+static void
+run(impl_t *impl) {
+	isc_time_t start;
+	void *table = NULL;
+	void *value;
+	unsigned int i;
+
+	RUNTIME_CHECK(impl->init(&table, bits) == ISC_R_SUCCESS);
+
+	TIME_NOW(&start);
+	for (i = 0; i < nkeys; i++)
+		RUNTIME_CHECK(impl->add(table, keys + i * KEYSIZE, keylens[i],
+					(void *)(size_t)i) ==
+			      ISC_R_SUCCESS);
+	report(impl->name, "add", &start);
+
+	for (i = 0; i < nkeys; i++) {
+		RUNTIME_CHECK(impl->find(table, keys + i * KEYSIZE,
+					 keylens[i], &value) ==
+			      ISC_R_SUCCESS);
+		INSIST(value == (void *)(size_t)i);
+	}
+	report(impl->name, "find", &start);
+
+	for (i = 0; i < nkeys; i++)
+		RUNTIME_CHECK(impl->find(table, absent + i * KEYSIZE,
+					 keylens[i], &value) ==
+			      ISC_R_NOTFOUND);
+	report(impl->name, "miss", &start);
+
+	for (i = 0; i < nkeys; i++)
+		RUNTIME_CHECK(impl->del(table, keys + i * KEYSIZE,
+					keylens[i]) == ISC_R_SUCCESS);
+	report(impl->name, "delete", &start);
+
+	impl->destroy(&table);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: htbench_test [-b bits] [-n keys]\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[]) {
+	unsigned int i;
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "b:n:")) != -1) {
+		switch (ch) {
+		case 'b':
+			bits = atoi(isc_commandline_argument);
+			break;
+		case 'n':
+			nkeys = atoi(isc_commandline_argument);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (nkeys == 0 || bits < 1 || bits > 24)
+		usage();
+
+	RUNTIME_CHECK(isc_mem_create(0, 0, &mctx) == ISC_R_SUCCESS);
+
+	/*
+	 * Keys look like the owner names catalog zones and RPZ use.
+	 */
+	keys = isc_mem_get(mctx, nkeys * KEYSIZE);
+	absent = isc_mem_get(mctx, nkeys * KEYSIZE);
+	keylens = isc_mem_get(mctx, nkeys * sizeof(isc_uint32_t));
+	RUNTIME_CHECK(keys != NULL && absent != NULL && keylens != NULL);
+	for (i = 0; i < nkeys; i++) {
+		keylens[i] = snprintf((char *)keys + i * KEYSIZE, KEYSIZE,
+				      "zone%u.example.com", i);
+		(void)snprintf((char *)absent + i * KEYSIZE, KEYSIZE,
+			       "zone%u.example.net", i);
+	}
+
+	printf("%u keys, 2^%u initial buckets\n", nkeys, bits);
+	for (i = 0; i < sizeof(impls) / sizeof(impls[0]); i++)
+		run(&impls[i]);
+
+	isc_mem_put(mctx, keys, nkeys * KEYSIZE);
+	isc_mem_put(mctx, absent, nkeys * KEYSIZE);
+	isc_mem_put(mctx, keylens, nkeys * sizeof(isc_uint32_t));
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
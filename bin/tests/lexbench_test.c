@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Master file tokenizer benchmark.
+ *
+ * Tokenizes a zone file the way the master file loader does, reading
+ * it as a file the lexer opened itself, as a stream opened by the
+ * caller (which the lexer reads a character at a time) and from
+ * memory.  Reports the time taken and the throughput of each.
+ *
+ * A suitable zone can be made with the startperf tools:
+ *
+ *	perl startperf/mkzonefile.pl example 1000000 > example.db
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/commandline.h>
+#include <isc/file.h>
+#include <isc/lex.h>
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/result.h>
+#include <isc/stdio.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+static isc_mem_t *mctx = NULL;
+static unsigned int iterations = 5;
+
+typedef enum { mode_file, mode_stream, mode_buffer } lexmode_t;
+
+static const char *modenames[] = { "file", "stream", "buffer" };
+
+static unsigned long
+tokenize(const char *filename, lexmode_t mode, isc_buffer_t *data) {
+	isc_lex_t *lex = NULL;
+	isc_lexspecials_t specials;
+	isc_token_t token;
+	isc_result_t result;
+	unsigned long ntokens = 0;
+	FILE *stream = NULL;
+
+	RUNTIME_CHECK(isc_lex_create(mctx, 1024, &lex) == ISC_R_SUCCESS);
+
+	/* The same settings as lib/dns/master.c. */
+	memset(specials, 0, sizeof(specials));
+	specials[0] = 1;
+	specials['('] = 1;
+	specials[')'] = 1;
+	specials['"'] = 1;
+	isc_lex_setspecials(lex, specials);
+	isc_lex_setcomments(lex, ISC_LEXCOMMENT_DNSMASTERFILE);
+
+	switch (mode) {
+	case mode_file:
+		result = isc_lex_openfile(lex, filename);
+		break;
+	case mode_stream:
+		RUNTIME_CHECK(isc_stdio_open(filename, "r", &stream) ==
+			      ISC_R_SUCCESS);
+		result = isc_lex_openstream(lex, stream);
+		break;
+	case mode_buffer:
+		isc_buffer_first(data);
+		result = isc_lex_openbuffer(lex, data);
+		break;
+	default:
+		INSIST(0);
+	}
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	for (;;) {
+		result = isc_lex_getmastertoken(lex, &token,
+						isc_tokentype_string,
+						ISC_TRUE);
+		if (result != ISC_R_SUCCESS) {
+			fprintf(stderr, "%s:%lu: %s\n", filename,
+				isc_lex_getsourceline(lex),
+				isc_result_totext(result));
+			exit(1);
+		}
+		if (token.type == isc_tokentype_eof)
+			break;
+		ntokens++;
+	}
+
+	isc_lex_destroy(&lex);
+	if (stream != NULL)
+		(void)isc_stdio_close(stream);
+	return (ntokens);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: lexbench_test [-n iterations] zonefile\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[]) {
+	isc_buffer_t *data = NULL;
+	isc_time_t start, finish;
+	isc_uint64_t usecs;
+	unsigned long ntokens = 0;
+	off_t size;
+	FILE *fp = NULL;
+	lexmode_t mode;
+	unsigned int i;
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "n:")) != -1) {
+		switch (ch) {
+		case 'n':
+			iterations = atoi(isc_commandline_argument);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= isc_commandline_index;
+	argv += isc_commandline_index;
+	if (argc != 1 || iterations == 0)
+		usage();
+
+	RUNTIME_CHECK(isc_mem_create(0, 0, &mctx) == ISC_R_SUCCESS);
+
+	/*
+	 * Read the whole file in for the buffer case.
+	 */
+	RUNTIME_CHECK(isc_file_getsize(argv[0], &size) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(size > 0 && size < 0x7fffffff);
+	RUNTIME_CHECK(isc_stdio_open(argv[0], "r", &fp) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_buffer_allocate(mctx, &data, (unsigned int)size) ==
+		      ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_stdio_read(isc_buffer_base(data), 1, (size_t)size,
+				     fp, NULL) == ISC_R_SUCCESS);
+	isc_buffer_add(data, (unsigned int)size);
+	(void)isc_stdio_close(fp);
+
+	printf("%s: %llu bytes, %u iterations\n", argv[0],
+	       (unsigned long long)size, iterations);
+	for (mode = mode_file; mode <= mode_buffer; mode++) {
+		TIME_NOW(&start);
+		for (i = 0; i < iterations; i++)
+			ntokens = tokenize(argv[0], mode, data);
+		TIME_NOW(&finish);
+		usecs = isc_time_microdiff(&finish, &start) / iterations;
+		if (usecs == 0)
+			usecs = 1;
+		printf("%-8s %lu tokens %8llu.%03llu ms %8.1f MB/s\n",
+		       modenames[mode], ntokens,
+		       (unsigned long long)(usecs / 1000),
+		       (unsigned long long)(usecs % 1000),
+		       (double)size / usecs);
+	}
+
+	isc_buffer_free(&data);
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
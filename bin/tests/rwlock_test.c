@@ -14,10 +14,13 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <isc/commandline.h>
+#include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/thread.h>
 #include <isc/rwlock.h>
 #include <isc/string.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #ifdef WIN32
@@ -28,6 +31,15 @@
 
 isc_rwlock_t lock;
 
+/*
+ * Contention benchmark (-B): every thread takes the lock for reading
+ * 'iterations' times, and for writing every 'writeevery' times.  The
+ * writers keep 'value1' and 'value2' equal, which the readers check.
+ */
+static unsigned int iterations = 1000000;
+static unsigned int writeevery = 0;
+static unsigned int value1 = 0, value2 = 0;
+
 static isc_threadresult_t
 #ifdef WIN32
 WINAPI
@@ -90,6 +102,82 @@ run2(void *arg) {
 	return ((isc_threadresult_t)0);
 }
 
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+bench(void *arg) {
+	unsigned int i;
+
+	UNUSED(arg);
+
+	for (i = 1; i <= iterations; i++) {
+		if (writeevery != 0 && i % writeevery == 0) {
+			RUNTIME_CHECK(isc_rwlock_lock(&lock,
+						      isc_rwlocktype_write) ==
+				      ISC_R_SUCCESS);
+			value1++;
+			value2++;
+			RUNTIME_CHECK(isc_rwlock_unlock(&lock,
+							isc_rwlocktype_write) ==
+				      ISC_R_SUCCESS);
+			continue;
+		}
+		RUNTIME_CHECK(isc_rwlock_lock(&lock, isc_rwlocktype_read) ==
+			      ISC_R_SUCCESS);
+		INSIST(value1 == value2);
+		RUNTIME_CHECK(isc_rwlock_unlock(&lock, isc_rwlocktype_read) ==
+			      ISC_R_SUCCESS);
+	}
+	return ((isc_threadresult_t)0);
+}
+
+static void
+benchmark(unsigned int nworkers, unsigned int options) {
+	isc_mem_t *mctx = NULL;
+	isc_thread_t workers[100];
+	isc_time_t start, finish;
+	isc_uint64_t usecs, ops;
+	unsigned int i;
+
+	RUNTIME_CHECK(isc_mem_create(0, 0, &mctx) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_rwlock_initx(&lock, 0, 0, mctx, options) ==
+		      ISC_R_SUCCESS);
+	value1 = value2 = 0;
+
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (i = 0; i < nworkers; i++)
+		RUNTIME_CHECK(isc_thread_create(bench, NULL, &workers[i]) ==
+			      ISC_R_SUCCESS);
+	for (i = 0; i < nworkers; i++)
+		(void)isc_thread_join(workers[i], NULL);
+	RUNTIME_CHECK(isc_time_now(&finish) == ISC_R_SUCCESS);
+
+	INSIST(writeevery == 0 ||
+	       value1 == nworkers * (iterations / writeevery));
+
+	usecs = isc_time_microdiff(&finish, &start);
+	ops = (isc_uint64_t)nworkers * iterations;
+	printf("%-10s %u threads: %llu locks in %llu.%06llu seconds "
+	       "(%llu per second)\n",
+	       (options & ISC_RWLOCK_BIGREADER) != 0 ? "big-reader" : "default",
+	       nworkers, (unsigned long long)ops,
+	       (unsigned long long)(usecs / 1000000),
+	       (unsigned long long)(usecs % 1000000),
+	       (unsigned long long)(usecs == 0 ? 0 : ops * 1000000 / usecs));
+
+	isc_rwlock_destroy(&lock);
+	isc_mem_destroy(&mctx);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: rwlock_test [nworkers]\n"
+		"       rwlock_test -B [-b] [-n iterations] "
+		"[-w writeevery] [nworkers]\n");
+	exit(1);
+}
+
 int
 main(int argc, char *argv[]) {
 	unsigned int nworkers;
@@ -97,15 +185,51 @@ main(int argc, char *argv[]) {
 	isc_thread_t workers[100];
 	char name[100];
 	void *dupname;
+	isc_boolean_t bench_mode = ISC_FALSE;
+	isc_boolean_t bigreader = ISC_FALSE;
+	int ch;
 
-	if (argc > 1)
-		nworkers = atoi(argv[1]);
+	while ((ch = isc_commandline_parse(argc, argv, "Bbn:w:")) != -1) {
+		switch (ch) {
+		case 'B':
+			bench_mode = ISC_TRUE;
+			break;
+		case 'b':
+			bigreader = ISC_TRUE;
+			break;
+		case 'n':
+			iterations = atoi(isc_commandline_argument);
+			break;
+		case 'w':
+			writeevery = atoi(isc_commandline_argument);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= isc_commandline_index;
+	argv += isc_commandline_index;
+
+	if (argc > 0)
+		nworkers = atoi(argv[0]);
 	else
 		nworkers = 2;
+	if (nworkers == 0)
+		usage();
 	if (nworkers > 100)
 		nworkers = 100;
 	printf("%d workers\n", nworkers);
 
+	/*
+	 * Without -b the benchmark compares both kinds of lock.
+	 */
+	if (bench_mode) {
+		if (!bigreader)
+			benchmark(nworkers, 0);
+		benchmark(nworkers, ISC_RWLOCK_BIGREADER);
+		return (0);
+	}
+
 	RUNTIME_CHECK(isc_rwlock_init(&lock, 5, 10) == ISC_R_SUCCESS);
 
 	for (i = 0; i < nworkers; i++) {
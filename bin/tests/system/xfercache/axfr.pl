@@ -0,0 +1,101 @@
+#!/usr/bin/perl
+#
+# Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+# Request an AXFR of a zone over TCP, without EDNS or TSIG, and print
+# each message of the response as a line of hexadecimal.  The message
+# ID, which is chosen at random for each transfer, is printed as 0000
+# so that transfers of the same zone can be compared byte for byte.
+#
+# Usage: axfr.pl [-a address] [-p port] zone
+
+require 5.006_001;
+
+use strict;
+use Getopt::Std;
+use IO::Socket;
+
+sub usage {
+    print ("Usage: axfr.pl [-a address] [-p port] zone\n");
+    exit 1;
+}
+
+sub readn {
+    my ($sock, $n) = @_;
+    my $data = "";
+
+    while (length($data) < $n) {
+	my $buf;
+	my $bytes = $sock->sysread($buf, $n - length($data));
+	die "read: $!" unless defined($bytes);
+	die "connection closed" if ($bytes == 0);
+	$data .= $buf;
+    }
+    return $data;
+}
+
+# Return the offset just past the (possibly compressed) name at $off.
+sub skipname {
+    my ($msg, $off) = @_;
+
+    for (;;) {
+	my $len = ord(substr($msg, $off, 1));
+	return $off + 2 if (($len & 0xc0) == 0xc0);
+	$off += $len + 1;
+	return $off if ($len == 0);
+    }
+}
+
+my %options={};
+getopts("a:p:", \%options);
+usage() if (@ARGV != 1);
+
+my $addr = "127.0.0.1";
+$addr = $options{a} if defined $options{a};
+
+my $port = 53;
+$port = $options{p} if defined $options{p};
+
+my $qname = "";
+foreach my $label (split(/\./, $ARGV[0])) {
+    $qname .= pack("C", length($label)) . $label;
+}
+$qname .= pack("C", 0);
+
+my $id = int(rand(65536));
+my $query = pack("nnnnnn", $id, 0, 1, 0, 0, 0) . $qname . pack("nn", 252, 1);
+
+my $sock = IO::Socket::INET->new(PeerAddr => $addr, PeerPort => $port,
+				 Proto => "tcp") or die "$!";
+$sock->syswrite(pack("n", length($query)) . $query);
+
+my $soa = 0;
+while ($soa < 2) {
+    my $len = unpack("n", readn($sock, 2));
+    my $msg = readn($sock, $len);
+    my ($msgid, $flags, $qdcount, $ancount) = unpack("nnnn", $msg);
+
+    die "unexpected message ID $msgid" if ($msgid != $id);
+    die "rcode " . ($flags & 0xf) if (($flags & 0xf) != 0);
+
+    my $off = 12;
+    for (my $i = 0; $i < $qdcount; $i++) {
+	$off = skipname($msg, $off) + 4;
+    }
+    for (my $i = 0; $i < $ancount; $i++) {
+	$off = skipname($msg, $off);
+	my ($type, $class, $ttl, $rdlen) =
+	    unpack("nnNn", substr($msg, $off, 10));
+	$off += 10 + $rdlen;
+	$soa++ if ($type == 6);
+    }
+
+    substr($msg, 0, 2) = pack("n", 0);
+    print unpack("H*", $msg), "\n";
+}
+
+$sock->close;
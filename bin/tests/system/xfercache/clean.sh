@@ -0,0 +1,13 @@
+#!/bin/sh
+#
+# Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+rm -f axfr.out.* dig.out.*
+rm -f ns*/example.db ns*/example.db.jnl
+rm -f ns*/named.memstats
+rm -f ns*/named.run
+rm -f ns*/named.lock
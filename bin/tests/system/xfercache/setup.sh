@@ -0,0 +1,33 @@
+#!/bin/sh
+#
+# Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+SYSTEMTESTTOP=..
+. $SYSTEMTESTTOP/conf.sh
+
+$SHELL clean.sh
+
+#
+# A zone big enough to need a few dozen AXFR messages.  ns1 and ns2
+# serve the same data; only ns1 keeps rendered messages.
+#
+{
+	cat <<EOF
+\$TTL 300
+@	IN SOA	ns1 hostmaster 1 300 120 3600 86400
+	NS	ns1
+ns1	A	10.53.0.1
+EOF
+	i=0
+	while [ $i -lt 2000 ]
+	do
+		echo "host$i	A	10.0.`expr $i / 256`.`expr $i % 256`"
+		echo "	TXT	\"transfer-message-cache-size test record $i\""
+		i=`expr $i + 1`
+	done
+} > ns1/example.db
+cp ns1/example.db ns2/example.db
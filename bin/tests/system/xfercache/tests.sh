@@ -0,0 +1,105 @@
+#!/bin/sh
+#
+# Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+SYSTEMTESTTOP=..
+. $SYSTEMTESTTOP/conf.sh
+
+DIGOPTS="+tcp +noedns +noadd +nosea +nostat +noquest +nocomm +nocmd -p 5300"
+
+status=0
+n=0
+
+n=`expr $n + 1`
+echo "I:getting a reference transfer from the server without a cache ($n)"
+ret=0
+$PERL axfr.pl -a 10.53.0.2 -p 5300 example > axfr.out.ns2 || ret=1
+lines=`wc -l < axfr.out.ns2`
+[ $lines -gt 10 ] || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:checking that concurrent transfers are the same as the reference ($n)"
+ret=0
+for i in 1 2 3 4 5 6 7 8
+do
+	$PERL axfr.pl -a 10.53.0.1 -p 5300 example > axfr.out.ns1.$i &
+done
+wait
+for i in 1 2 3 4 5 6 7 8
+do
+	cmp -s axfr.out.ns2 axfr.out.ns1.$i || {
+		echo "I:transfer $i differs"
+		ret=1
+	}
+done
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:checking that a later transfer is the same as the reference ($n)"
+ret=0
+$PERL axfr.pl -a 10.53.0.1 -p 5300 example > axfr.out.ns1.later || ret=1
+cmp -s axfr.out.ns2 axfr.out.ns1.later || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:checking that transfers shared rendered messages ($n)"
+ret=0
+grep "transfer of 'example/IN': AXFR ended" ns1/named.run > /dev/null || ret=1
+grep "transfer of 'example/IN': [0-9]* of [0-9]* messages shared" \
+	ns1/named.run > /dev/null || ret=1
+grep "messages shared" ns2/named.run > /dev/null && ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:updating the zone ($n)"
+ret=0
+$NSUPDATE <<END > /dev/null || ret=1
+server 10.53.0.1 5300
+update add added.example. 300 A 10.0.255.1
+send
+END
+for i in 1 2 3 4 5 6 7 8 9 10
+do
+	$DIG $DIGOPTS +short example. soa @10.53.0.1 > dig.out.soa.test$n
+	serial=`awk '{print $3}' dig.out.soa.test$n`
+	[ "$serial" = 2 ] && break
+	sleep 1
+done
+[ "$serial" = 2 ] || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+n=`expr $n + 1`
+echo "I:checking that transfers started after the update get the new serial ($n)"
+ret=0
+for i in 1 2 3 4
+do
+	$PERL axfr.pl -a 10.53.0.1 -p 5300 example > axfr.out.update.$i &
+done
+$DIG $DIGOPTS example. axfr @10.53.0.1 > dig.out.test$n
+wait
+cmp -s axfr.out.ns2 axfr.out.update.1 && ret=1
+for i in 2 3 4
+do
+	cmp -s axfr.out.update.1 axfr.out.update.$i || {
+		echo "I:transfer $i differs"
+		ret=1
+	}
+done
+soas=`awk '$4 == "SOA" && $7 == 2 { print }' dig.out.test$n | wc -l`
+[ $soas -eq 2 ] || ret=1
+grep "^added.example.*10.0.255.1" dig.out.test$n > /dev/null || ret=1
+if [ $ret != 0 ]; then echo "I:failed"; fi
+status=`expr $status + $ret`
+
+echo "I:exit status: $status"
+[ $status -eq 0 ] || exit 1
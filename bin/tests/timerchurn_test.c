@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Timer churn benchmark.
+ *
+ * Several threads each create a batch of idle timers, reset every one
+ * of them a number of times (as a busy server does with its client
+ * timers) and then destroy them, and the combined rate of timer
+ * operations is reported.  Afterwards a batch of short timers is
+ * allowed to fire, to check that none are lost and to report how late
+ * they were delivered.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/commandline.h>
+#include <isc/condition.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/print.h>
+#include <isc/task.h>
+#include <isc/thread.h>
+#include <isc/time.h>
+#include <isc/timer.h>
+#include <isc/util.h>
+
+#ifdef ISC_PLATFORM_USETHREADS
+
+#define MAXTHREADS	64
+
+static isc_mem_t *mctx = NULL;
+static isc_taskmgr_t *taskmgr = NULL;
+static isc_timermgr_t *timermgr = NULL;
+static unsigned int ntimers = 10000;
+static unsigned int nresets = 10;
+
+static isc_mutex_t lock;
+static isc_condition_t done;
+static unsigned int nfired = 0;
+static isc_uint64_t totallate = 0;
+static isc_uint64_t maxlate = 0;
+
+typedef struct {
+	isc_task_t *		task;
+	isc_timer_t **		timers;
+} churn_t;
+
+static void
+noop(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	isc_event_free(&event);
+}
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+churn(void *arg) {
+	churn_t *ctx = arg;
+	isc_interval_t interval;
+	unsigned int i, j;
+
+	for (i = 0; i < ntimers; i++) {
+		isc_interval_set(&interval, 30 + i % 30, 0);
+		RUNTIME_CHECK(isc_timer_create(timermgr, isc_timertype_once,
+					       NULL, &interval, ctx->task,
+					       noop, NULL,
+					       &ctx->timers[i]) ==
+			      ISC_R_SUCCESS);
+	}
+
+	for (j = 0; j < nresets; j++) {
+		for (i = 0; i < ntimers; i++) {
+			isc_interval_set(&interval, 30 + (i + j) % 30,
+					 (i % 1000) * 1000);
+			RUNTIME_CHECK(isc_timer_reset(ctx->timers[i],
+						      isc_timertype_once,
+						      NULL, &interval,
+						      ISC_FALSE) ==
+				      ISC_R_SUCCESS);
+		}
+	}
+
+	for (i = 0; i < ntimers; i++)
+		isc_timer_detach(&ctx->timers[i]);
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+fired(isc_task_t *task, isc_event_t *event) {
+	isc_timer_t *timer = (isc_timer_t *)event->ev_sender;
+	isc_timerevent_t *tevent = (isc_timerevent_t *)event;
+	isc_time_t now;
+	isc_uint64_t late;
+
+	UNUSED(task);
+
+	TIME_NOW(&now);
+	late = isc_time_microdiff(&now, &tevent->due);
+
+	isc_event_free(&event);
+	isc_timer_detach(&timer);
+
+	LOCK(&lock);
+	nfired++;
+	totallate += late;
+	if (late > maxlate)
+		maxlate = late;
+	if (nfired == ntimers)
+		SIGNAL(&done);
+	UNLOCK(&lock);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: timerchurn_test [-n timers] [-r resets] "
+		"[-t threads]\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[]) {
+	unsigned int nthreads = 4;
+	isc_thread_t threads[MAXTHREADS];
+	churn_t ctx[MAXTHREADS];
+	isc_timer_t *timer;
+	isc_interval_t interval;
+	isc_time_t start, finish;
+	isc_uint64_t usecs, ops;
+	unsigned int i;
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "n:r:t:")) != -1) {
+		switch (ch) {
+		case 'n':
+			ntimers = atoi(isc_commandline_argument);
+			break;
+		case 'r':
+			nresets = atoi(isc_commandline_argument);
+			break;
+		case 't':
+			nthreads = atoi(isc_commandline_argument);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (ntimers == 0 || nthreads == 0 || nthreads > MAXTHREADS)
+		usage();
+
+	RUNTIME_CHECK(isc_mem_create(0, 0, &mctx) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_mutex_init(&lock) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_condition_init(&done) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_taskmgr_create(mctx, nthreads, 0, &taskmgr) ==
+		      ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_timermgr_create(mctx, &timermgr) == ISC_R_SUCCESS);
+
+	for (i = 0; i < nthreads; i++) {
+		ctx[i].task = NULL;
+		RUNTIME_CHECK(isc_task_create(taskmgr, 0, &ctx[i].task) ==
+			      ISC_R_SUCCESS);
+		ctx[i].timers = isc_mem_get(mctx,
+					    ntimers * sizeof(isc_timer_t *));
+		RUNTIME_CHECK(ctx[i].timers != NULL);
+		memset(ctx[i].timers, 0, ntimers * sizeof(isc_timer_t *));
+	}
+
+	/*
+	 * Churn: create, reset and destroy timers from every thread.
+	 */
+	TIME_NOW(&start);
+	for (i = 0; i < nthreads; i++)
+		RUNTIME_CHECK(isc_thread_create(churn, &ctx[i],
+						&threads[i]) ==
+			      ISC_R_SUCCESS);
+	for (i = 0; i < nthreads; i++)
+		(void)isc_thread_join(threads[i], NULL);
+	TIME_NOW(&finish);
+
+	usecs = isc_time_microdiff(&finish, &start);
+	ops = (isc_uint64_t)nthreads * ntimers * (nresets + 2);
+	printf("%u threads, %u timers, %u resets: "
+	       "%llu operations in %llu.%06llu seconds (%llu per second)\n",
+	       nthreads, ntimers, nresets, (unsigned long long)ops,
+	       (unsigned long long)(usecs / 1000000),
+	       (unsigned long long)(usecs % 1000000),
+	       (unsigned long long)(usecs == 0 ? 0 : ops * 1000000 / usecs));
+
+	/*
+	 * Firing: spread 'ntimers' short timers over 100ms and wait for
+	 * all of them to go off.  Each timer is destroyed by its own
+	 * event handler.
+	 */
+	for (i = 0; i < ntimers; i++) {
+		timer = NULL;
+		isc_interval_set(&interval, 0, (i % 100 + 1) * 1000000);
+		RUNTIME_CHECK(isc_timer_create(timermgr, isc_timertype_once,
+					       NULL, &interval,
+					       ctx[i % nthreads].task,
+					       fired, NULL, &timer) ==
+			      ISC_R_SUCCESS);
+	}
+	LOCK(&lock);
+	while (nfired < ntimers)
+		WAIT(&done, &lock);
+	UNLOCK(&lock);
+
+	printf("%u timers fired, %llu us late on average, %llu us at most\n",
+	       nfired, (unsigned long long)(totallate / nfired),
+	       (unsigned long long)maxlate);
+
+	for (i = 0; i < nthreads; i++) {
+		isc_mem_put(mctx, ctx[i].timers,
+			    ntimers * sizeof(isc_timer_t *));
+		isc_task_detach(&ctx[i].task);
+	}
+	isc_timermgr_destroy(&timermgr);
+	isc_taskmgr_destroy(&taskmgr);
+	(void)isc_condition_destroy(&done);
+	DESTROYLOCK(&lock);
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
+
+#else
+
+int
+main(int argc, char *argv[]) {
+	UNUSED(argc);
+	UNUSED(argv);
+	fprintf(stderr, "This test requires threads.\n");
+	return(1);
+}
+
+#endif
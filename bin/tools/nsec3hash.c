@@ -53,10 +53,10 @@ check_result(isc_result_t result, const char *message) {
 
 static void
 usage() {
-	fprintf(stderr, "Usage: %s salt algorithm iterations domain\n",
-		program);
-	fprintf(stderr, "       %s -r algorithm flags iterations salt domain\n",
-		program);
+	fprintf(stderr, "Usage: %s salt algorithm iterations domain "
+		"[domain ...]\n", program);
+	fprintf(stderr, "       %s -r algorithm flags iterations salt domain "
+		"[domain ...]\n", program);
 	exit(1);
 }
 
@@ -64,16 +64,23 @@ typedef void nsec3printer(unsigned algo, unsigned flags, unsigned iters,
 			  const char *saltstr, const char *domain,
 			  const char *digest);
 
+/*
+ * Hash all of 'domains' with the same parameters, in one batch.
+ */
 static void
 nsec3hash(nsec3printer *nsec3print, const char *algostr, const char *flagstr,
-	  const char *iterstr, const char *saltstr, const char *domain)
+	  const char *iterstr, const char *saltstr, char **domains,
+	  unsigned int ndomains)
 {
-	dns_fixedname_t fixed;
+	dns_fixedname_t *fixed;
 	dns_name_t *name;
 	isc_buffer_t buffer;
 	isc_region_t region;
 	isc_result_t result;
-	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
+	unsigned char *hashes;
+	unsigned char **out;
+	const unsigned char **in;
+	int *inlength;
 	unsigned char salt[DNS_NSEC3_SALTSIZE];
 	unsigned char text[1024];
 	unsigned int hash_alg;
@@ -81,6 +88,7 @@ nsec3hash(nsec3printer *nsec3print, const char *algostr, const char *flagstr,
 	unsigned int length;
 	unsigned int iterations;
 	unsigned int salt_length;
+	unsigned int i;
 	const char dash[] = "-";
 
 	if (strcmp(saltstr, "-") == 0) {
@@ -106,25 +114,51 @@ nsec3hash(nsec3printer *nsec3print, const char *algostr, const char *flagstr,
 	if (iterations > 0xffffU)
 		fatal("iterations to large");
 
-	dns_fixedname_init(&fixed);
-	name = dns_fixedname_name(&fixed);
-	isc_buffer_constinit(&buffer, domain, strlen(domain));
-	isc_buffer_add(&buffer, strlen(domain));
-	result = dns_name_fromtext(name, &buffer, dns_rootname, 0, NULL);
-	check_result(result, "dns_name_fromtext() failed");
+	fixed = malloc(ndomains * sizeof(*fixed));
+	hashes = malloc(ndomains * NSEC3_MAX_HASH_LENGTH);
+	out = malloc(ndomains * sizeof(*out));
+	in = malloc(ndomains * sizeof(*in));
+	inlength = malloc(ndomains * sizeof(*inlength));
+	if (fixed == NULL || hashes == NULL || out == NULL || in == NULL ||
+	    inlength == NULL)
+		fatal("out of memory");
+
+	for (i = 0; i < ndomains; i++) {
+		dns_fixedname_init(&fixed[i]);
+		name = dns_fixedname_name(&fixed[i]);
+		isc_buffer_constinit(&buffer, domains[i], strlen(domains[i]));
+		isc_buffer_add(&buffer, strlen(domains[i]));
+		result = dns_name_fromtext(name, &buffer, dns_rootname, 0,
+					   NULL);
+		check_result(result, "dns_name_fromtext() failed");
+
+		dns_name_downcase(name, name, NULL);
+		in[i] = name->ndata;
+		inlength[i] = name->length;
+		out[i] = hashes + i * NSEC3_MAX_HASH_LENGTH;
+	}
 
-	dns_name_downcase(name, name, NULL);
-	length = isc_iterated_hash(hash, hash_alg, iterations,  salt,
-				   salt_length, name->ndata, name->length);
+	length = isc_iterated_hash_batch(out, ndomains, hash_alg, iterations,
+					 salt, salt_length, in, inlength);
 	if (length == 0)
 		fatal("isc_iterated_hash failed");
-	region.base = hash;
-	region.length = length;
-	isc_buffer_init(&buffer, text, sizeof(text));
-	isc_base32hexnp_totext(&region, 1, "", &buffer);
-	isc_buffer_putuint8(&buffer, '\0');
 
-	nsec3print(hash_alg, flags, iterations, saltstr, domain, (char *)text);
+	for (i = 0; i < ndomains; i++) {
+		region.base = out[i];
+		region.length = length;
+		isc_buffer_init(&buffer, text, sizeof(text));
+		isc_base32hexnp_totext(&region, 1, "", &buffer);
+		isc_buffer_putuint8(&buffer, '\0');
+
+		nsec3print(hash_alg, flags, iterations, saltstr, domains[i],
+			   (char *)text);
+	}
+
+	free(fixed);
+	free(hashes);
+	free(out);
+	free(in);
+	free(inlength);
 }
 
 static void
@@ -170,17 +204,17 @@ main(int argc, char *argv[]) {
 	argv += isc_commandline_index;
 
 	if (rdata_format) {
-		if (argc != 5) {
+		if (argc < 5) {
 			usage();
 		}
-		nsec3hash(nsec3hash_rdata_print,
-			  argv[0], argv[1], argv[2], argv[3], argv[4]);
+		nsec3hash(nsec3hash_rdata_print, argv[0], argv[1], argv[2],
+			  argv[3], &argv[4], argc - 4);
 	} else {
-		if (argc != 4) {
+		if (argc < 4) {
 			usage();
 		}
-		nsec3hash(nsec3hash_print,
-			  argv[1], NULL, argv[2], argv[0], argv[3]);
+		nsec3hash(nsec3hash_print, argv[1], NULL, argv[2],
+			  argv[0], &argv[3], argc - 3);
 	}
 	return(0);
 }
@@ -10,8 +10,12 @@
 
 #include <config.h>
 
+#include <stdlib.h>
+
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/once.h>
+#include <isc/radix.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
@@ -60,6 +64,7 @@ dns_acl_create(isc_mem_t *mctx, int n, dns_acl_t **target) {
 	acl->alloc = 0;
 	acl->length = 0;
 	acl->has_negatives = ISC_FALSE;
+	acl->compiled = NULL;
 
 	ISC_LINK_INIT(acl, nextincache);
 	/*
@@ -169,6 +174,473 @@ dns_acl_isnone(dns_acl_t *acl)
 	return (dns_acl_isanyornone(acl, ISC_FALSE));
 }
 
+/*
+ * Compiled ACLs.
+ *
+ * The IP table of a compiled ACL is flattened into one trie per address
+ * family with a stride of one address byte.  Each trie node covers the
+ * 256 values of the next byte with two bitmaps: 'matchmap' marks the
+ * values for which a prefix ending in this byte matches, and 'childmap'
+ * the values for which longer prefixes continue in a child node.  Match
+ * values and child nodes are stored densely, so the position of the
+ * entry for a byte is found by counting the bits set below it.
+ *
+ * A prefix whose length is not a multiple of 8 is expanded to every
+ * byte value it covers.  Where several prefixes cover the same value,
+ * the one added to the ACL first (lowest node number) is kept, which is
+ * the "first match" rule isc_radix_search() applies; a lookup keeps the
+ * lowest node number it meets on the way down for the same reason.
+ *
+ * Match values are node numbers, negated for negative entries, as
+ * returned in '*match' by dns_acl_match().
+ */
+
+#define ACL_CACHE_LOCKS		16
+
+typedef struct acl_trienode {
+	isc_uint64_t		childmap[4];
+	isc_uint64_t		matchmap[4];
+	isc_uint32_t		children;	/*%< index of first child */
+	isc_uint32_t		matches;	/*%< index of first match */
+	isc_uint8_t		childrank[4];	/*%< children before word */
+	isc_uint8_t		matchrank[4];	/*%< matches before word */
+} acl_trienode_t;
+
+typedef struct acl_trie {
+	int			root;		/*%< zero-length prefix */
+	unsigned int		nnodes, nodealloc;
+	unsigned int		nmatches, matchalloc;
+	acl_trienode_t		*nodes;
+	int			*matches;
+} acl_trie_t;
+
+typedef struct acl_prefix {
+	unsigned char		addr[16];
+	unsigned int		bitlen;
+	int			match;
+} acl_prefix_t;
+
+typedef struct acl_cacheentry {
+	unsigned int		family;		/*%< 0 if unused */
+	unsigned char		addr[16];
+	int			match;
+	const dns_aclelement_t	*matchelt;
+} acl_cacheentry_t;
+
+struct dns_aclcompiled {
+	acl_trie_t		trie[2];	/*%< IPv4, IPv6 */
+	unsigned int		*keyhash;	/*%< per element */
+	unsigned int		cachemask;
+	acl_cacheentry_t	*cache;
+	isc_mutex_t		cachelock[ACL_CACHE_LOCKS];
+};
+
+static inline unsigned int
+popcount64(isc_uint64_t w) {
+	w = w - ((w >> 1) & 0x5555555555555555ULL);
+	w = (w & 0x3333333333333333ULL) +
+	    ((w >> 2) & 0x3333333333333333ULL);
+	w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return ((unsigned int)((w * 0x0101010101010101ULL) >> 56));
+}
+
+/*
+ * Return ISC_TRUE if match value 'm' takes precedence over 'than'.
+ */
+static inline isc_boolean_t
+better_match(int m, int than) {
+	if (than == 0)
+		return (ISC_TRUE);
+	return (ISC_TF((m < 0 ? -m : m) < (than < 0 ? -than : than)));
+}
+
+static int
+trie_lookup(const acl_trie_t *trie, const unsigned char *addr,
+	    unsigned int len)
+{
+	const acl_trienode_t *node;
+	isc_uint64_t bit;
+	unsigned int i, w;
+	int match = trie->root, m;
+
+	if (trie->nnodes == 0)
+		return (match);
+
+	node = &trie->nodes[0];
+	for (i = 0; i < len; i++) {
+		w = addr[i] >> 6;
+		bit = (isc_uint64_t)1 << (addr[i] & 63);
+		if ((node->matchmap[w] & bit) != 0) {
+			m = trie->matches[node->matches + node->matchrank[w] +
+					  popcount64(node->matchmap[w] &
+						     (bit - 1))];
+			if (better_match(m, match))
+				match = m;
+		}
+		if ((node->childmap[w] & bit) == 0)
+			break;
+		node = &trie->nodes[node->children + node->childrank[w] +
+				    popcount64(node->childmap[w] & (bit - 1))];
+	}
+
+	return (match);
+}
+
+static int
+prefix_compare(const void *a, const void *b) {
+	const acl_prefix_t *pa = a, *pb = b;
+
+	return (memcmp(pa->addr, pb->addr, sizeof(pa->addr)));
+}
+
+static isc_result_t
+trie_grow(isc_mem_t *mctx, void **arrayp, unsigned int *allocp,
+	  unsigned int need, size_t elemsize)
+{
+	unsigned int newalloc;
+	void *newarray;
+
+	if (need <= *allocp)
+		return (ISC_R_SUCCESS);
+
+	newalloc = *allocp * 2;
+	if (newalloc < need)
+		newalloc = need;
+	if (newalloc < 16)
+		newalloc = 16;
+	newarray = isc_mem_get(mctx, newalloc * elemsize);
+	if (newarray == NULL)
+		return (ISC_R_NOMEMORY);
+	if (*arrayp != NULL) {
+		memmove(newarray, *arrayp, *allocp * elemsize);
+		isc_mem_put(mctx, *arrayp, *allocp * elemsize);
+	}
+	*arrayp = newarray;
+	*allocp = newalloc;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Fill in node 'index' at depth 'level' from the sorted prefixes
+ * 'pfx[0..n-1]', which all agree on the first 'level' bytes, and
+ * recursively its children.  Prefixes no longer than 'level' bytes
+ * have been dealt with by an ancestor and are skipped.
+ */
+static isc_result_t
+trie_build(isc_mem_t *mctx, acl_trie_t *trie, unsigned int index,
+	   unsigned int level, acl_prefix_t *pfx, unsigned int n)
+{
+	acl_trienode_t *node;
+	int values[256];
+	isc_uint64_t childmap[4];
+	unsigned int i, j, v, lo, hi, bits, nchildren, child;
+	isc_result_t result;
+
+	memset(values, 0, sizeof(values));
+	memset(childmap, 0, sizeof(childmap));
+
+	for (i = 0; i < n; i++) {
+		if (pfx[i].bitlen <= level * 8)
+			continue;
+		v = pfx[i].addr[level];
+		if (pfx[i].bitlen > (level + 1) * 8) {
+			childmap[v >> 6] |= (isc_uint64_t)1 << (v & 63);
+			continue;
+		}
+		bits = pfx[i].bitlen - level * 8;
+		lo = v & (0xff << (8 - bits)) & 0xff;
+		hi = lo | (0xff >> bits);
+		for (v = lo; v <= hi; v++)
+			if (better_match(pfx[i].match, values[v]))
+				values[v] = pfx[i].match;
+	}
+
+	nchildren = 0;
+	for (i = 0; i < 4; i++)
+		nchildren += popcount64(childmap[i]);
+
+	result = trie_grow(mctx, (void **)&trie->matches, &trie->matchalloc,
+			   trie->nmatches + 256, sizeof(int));
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = trie_grow(mctx, (void **)&trie->nodes, &trie->nodealloc,
+			   trie->nnodes + nchildren, sizeof(acl_trienode_t));
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	/*
+	 * Reserve consecutive nodes for the children before building any
+	 * of them, so that they can be found by rank.
+	 */
+	node = &trie->nodes[index];
+	memset(node, 0, sizeof(*node));
+	memmove(node->childmap, childmap, sizeof(childmap));
+	node->children = trie->nnodes;
+	node->matches = trie->nmatches;
+	for (v = 0; v < 256; v++) {
+		if (values[v] == 0)
+			continue;
+		node->matchmap[v >> 6] |= (isc_uint64_t)1 << (v & 63);
+		trie->matches[trie->nmatches++] = values[v];
+	}
+	for (i = 1; i < 4; i++) {
+		node->childrank[i] = node->childrank[i - 1] +
+				     popcount64(node->childmap[i - 1]);
+		node->matchrank[i] = node->matchrank[i - 1] +
+				     popcount64(node->matchmap[i - 1]);
+	}
+	memset(&trie->nodes[trie->nnodes], 0,
+	       nchildren * sizeof(acl_trienode_t));
+	trie->nnodes += nchildren;
+
+	/*
+	 * The prefixes for each child are contiguous in sorted order.
+	 */
+	child = trie->nodes[index].children;
+	for (i = 0; i < n; i = j) {
+		if (pfx[i].bitlen <= (level + 1) * 8) {
+			j = i + 1;
+			continue;
+		}
+		v = pfx[i].addr[level];
+		for (j = i + 1; j < n && pfx[j].addr[level] == v; j++)
+			;
+		result = trie_build(mctx, trie, child++, level + 1,
+				    &pfx[i], j - i);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+	INSIST(child == trie->nodes[index].children + nchildren);
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+trie_free(isc_mem_t *mctx, acl_trie_t *trie) {
+	if (trie->nodes != NULL)
+		isc_mem_put(mctx, trie->nodes,
+			    trie->nodealloc * sizeof(acl_trienode_t));
+	if (trie->matches != NULL)
+		isc_mem_put(mctx, trie->matches,
+			    trie->matchalloc * sizeof(int));
+	memset(trie, 0, sizeof(*trie));
+}
+
+/*
+ * Build the trie for IPv4 (off == 0) or IPv6 (off == 1) client addresses
+ * from the entries of 'radix'.
+ */
+static isc_result_t
+trie_create(isc_mem_t *mctx, isc_radix_tree_t *radix, int off,
+	    acl_trie_t *trie)
+{
+	isc_radix_node_t *node;
+	acl_prefix_t *pfx = NULL;
+	unsigned int n = 0, alloc = 0;
+	isc_result_t result = ISC_R_SUCCESS;
+	int match;
+
+	memset(trie, 0, sizeof(*trie));
+
+	RADIX_WALK(radix->head, node) {
+		if (node->node_num[off] == -1 || node->data[off] == NULL)
+			goto next;
+		match = node->node_num[off];
+		if (!*(isc_boolean_t *)node->data[off])
+			match = -match;
+		if (node->prefix->bitlen == 0) {
+			if (better_match(match, trie->root))
+				trie->root = match;
+			goto next;
+		}
+		result = trie_grow(mctx, (void **)&pfx, &alloc, n + 1,
+				   sizeof(*pfx));
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+		memset(&pfx[n], 0, sizeof(pfx[n]));
+		memmove(pfx[n].addr, isc_prefix_touchar(node->prefix),
+			(node->prefix->bitlen + 7) / 8);
+		pfx[n].bitlen = node->prefix->bitlen;
+		pfx[n].match = match;
+		n++;
+	next:
+		;
+	} RADIX_WALK_END;
+
+	if (n == 0)
+		goto cleanup;
+
+	qsort(pfx, n, sizeof(*pfx), prefix_compare);
+
+	result = trie_grow(mctx, (void **)&trie->nodes, &trie->nodealloc,
+			   1, sizeof(acl_trienode_t));
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	trie->nnodes = 1;
+	result = trie_build(mctx, trie, 0, 0, pfx, n);
+
+ cleanup:
+	if (pfx != NULL)
+		isc_mem_put(mctx, pfx, alloc * sizeof(*pfx));
+	if (result != ISC_R_SUCCESS)
+		trie_free(mctx, trie);
+	return (result);
+}
+
+/*
+ * Return ISC_TRUE if the result of matching 'acl' against an unsigned
+ * request depends on the client address alone.
+ */
+static isc_boolean_t
+acl_addressonly(const dns_acl_t *acl) {
+	unsigned int i;
+
+	for (i = 0; i < acl->length; i++) {
+		const dns_aclelement_t *e = &acl->elements[i];
+
+		switch (e->type) {
+		case dns_aclelementtype_keyname:
+			break;
+		case dns_aclelementtype_nestedacl:
+			if (!acl_addressonly(e->nestedacl))
+				return (ISC_FALSE);
+			break;
+		default:
+			return (ISC_FALSE);
+		}
+	}
+
+	return (ISC_TRUE);
+}
+
+static void
+compiled_free(isc_mem_t *mctx, dns_aclcompiled_t **compp,
+	      unsigned int length)
+{
+	dns_aclcompiled_t *comp = *compp;
+	unsigned int i;
+
+	trie_free(mctx, &comp->trie[0]);
+	trie_free(mctx, &comp->trie[1]);
+	if (comp->keyhash != NULL)
+		isc_mem_put(mctx, comp->keyhash,
+			    length * sizeof(unsigned int));
+	if (comp->cache != NULL) {
+		isc_mem_put(mctx, comp->cache,
+			    (comp->cachemask + 1) * sizeof(acl_cacheentry_t));
+		for (i = 0; i < ACL_CACHE_LOCKS; i++)
+			DESTROYLOCK(&comp->cachelock[i]);
+	}
+	isc_mem_put(mctx, comp, sizeof(*comp));
+	*compp = NULL;
+}
+
+static inline unsigned int
+cache_hash(const unsigned char *addr, unsigned int len) {
+	isc_uint32_t h = 0, w;
+	unsigned int i;
+
+	for (i = 0; i < len; i += 4) {
+		w = (addr[i] << 24) | (addr[i + 1] << 16) |
+		    (addr[i + 2] << 8) | addr[i + 3];
+		h = (h ^ w) * 0x9e3779b1U;
+	}
+	return (h ^ (h >> 16));
+}
+
+/*
+ * dns_acl_match2() for a compiled ACL and no ECS option.  'addr' is
+ * the client address after any v4-mapped conversion.
+ */
+static void
+match_compiled(const isc_netaddr_t *addr, const isc_netaddr_t *reqaddr,
+	       const dns_name_t *reqsigner, const dns_acl_t *acl,
+	       const dns_aclenv_t *env, int *match,
+	       const dns_aclelement_t **matchelt)
+{
+	dns_aclcompiled_t *comp = acl->compiled;
+	const dns_aclelement_t *elt = NULL;
+	const unsigned char *bytes;
+	acl_cacheentry_t *entry = NULL;
+	isc_boolean_t hashed = ISC_FALSE;
+	unsigned int i, len, signerhash = 0, slot = 0;
+	int match_num;
+
+	if (addr->family == AF_INET6) {
+		bytes = addr->type.in6.s6_addr;
+		len = 16;
+	} else {
+		bytes = (const unsigned char *)&addr->type.in;
+		len = 4;
+	}
+
+	if (comp->cache != NULL && reqsigner == NULL) {
+		slot = cache_hash(bytes, len) & comp->cachemask;
+		entry = &comp->cache[slot];
+		LOCK(&comp->cachelock[slot % ACL_CACHE_LOCKS]);
+		if (entry->family == addr->family &&
+		    memcmp(entry->addr, bytes, len) == 0)
+		{
+			*match = entry->match;
+			if (matchelt != NULL)
+				*matchelt = entry->matchelt;
+			UNLOCK(&comp->cachelock[slot % ACL_CACHE_LOCKS]);
+			return;
+		}
+		UNLOCK(&comp->cachelock[slot % ACL_CACHE_LOCKS]);
+	}
+
+	*match = trie_lookup(&comp->trie[addr->family == AF_INET6 ? 1 : 0],
+			     bytes, len);
+	match_num = (*match == 0) ? -1 : (*match < 0 ? -*match : *match);
+
+	for (i = 0; i < acl->length; i++) {
+		const dns_aclelement_t *e = &acl->elements[i];
+
+		if (match_num != -1 && match_num < e->node_num)
+			break;
+
+		/*
+		 * Key names can be ruled out by hash value.
+		 */
+		if (e->type == dns_aclelementtype_keyname) {
+			if (reqsigner == NULL)
+				continue;
+			if (!hashed) {
+				signerhash = dns_name_hash(reqsigner,
+							   ISC_FALSE);
+				hashed = ISC_TRUE;
+			}
+			if (comp->keyhash[i] != signerhash)
+				continue;
+		}
+
+		if (dns_aclelement_match2(reqaddr, reqsigner, NULL, 0, NULL,
+					  e, env, &elt))
+		{
+			if (match_num == -1 || e->node_num < match_num) {
+				if (e->negative)
+					*match = -e->node_num;
+				else
+					*match = e->node_num;
+			}
+			break;
+		}
+	}
+
+	if (matchelt != NULL)
+		*matchelt = elt;
+
+	if (entry != NULL) {
+		LOCK(&comp->cachelock[slot % ACL_CACHE_LOCKS]);
+		entry->family = addr->family;
+		memmove(entry->addr, bytes, len);
+		entry->match = *match;
+		entry->matchelt = elt;
+		UNLOCK(&comp->cachelock[slot % ACL_CACHE_LOCKS]);
+	}
+}
+
 /*
  * Determine whether a given address or signer matches a given ACL.
  * For a match with a positive ACL element or iptable radix entry,
@@ -219,6 +691,13 @@ dns_acl_match2(const isc_netaddr_t *reqaddr,
 		addr = &v4addr;
 	}
 
+	if (acl->compiled != NULL && ecs == NULL) {
+		*match = 0;
+		match_compiled(addr, reqaddr, reqsigner, acl, env,
+			       match, matchelt);
+		return (ISC_R_SUCCESS);
+	}
+
 	/* Always match with host addresses. */
 	bitlen = (addr->family == AF_INET6) ? 128 : 32;
 	NETADDR_TO_PREFIX_T(addr, pfx, bitlen, ISC_FALSE);
@@ -303,6 +782,99 @@ dns_acl_match2(const isc_netaddr_t *reqaddr,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Build the compiled form of 'acl' (and of any nested ACLs that lack
+ * one), with a decision cache if 'cachesize' is nonzero and the ACL
+ * qualifies for one.
+ */
+isc_result_t
+dns_acl_compile(dns_acl_t *acl, unsigned int cachesize) {
+	dns_aclcompiled_t *comp;
+	isc_result_t result;
+	unsigned int i, size;
+
+	REQUIRE(DNS_ACL_VALID(acl));
+
+	if (acl->compiled != NULL)
+		compiled_free(acl->mctx, &acl->compiled, acl->length);
+
+	for (i = 0; i < acl->length; i++) {
+		dns_aclelement_t *e = &acl->elements[i];
+		if (e->type == dns_aclelementtype_nestedacl &&
+		    e->nestedacl->compiled == NULL)
+		{
+			result = dns_acl_compile(e->nestedacl, cachesize);
+			if (result != ISC_R_SUCCESS)
+				return (result);
+		}
+	}
+
+	comp = isc_mem_get(acl->mctx, sizeof(*comp));
+	if (comp == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(comp, 0, sizeof(*comp));
+
+	result = trie_create(acl->mctx, acl->iptable->radix, 0,
+			     &comp->trie[0]);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	result = trie_create(acl->mctx, acl->iptable->radix, 1,
+			     &comp->trie[1]);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	if (acl->length != 0) {
+		comp->keyhash = isc_mem_get(acl->mctx,
+					    acl->length * sizeof(unsigned int));
+		if (comp->keyhash == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		for (i = 0; i < acl->length; i++) {
+			dns_aclelement_t *e = &acl->elements[i];
+			comp->keyhash[i] = 0;
+			if (e->type == dns_aclelementtype_keyname)
+				comp->keyhash[i] = dns_name_hash(&e->keyname,
+								 ISC_FALSE);
+		}
+	}
+
+	/*
+	 * Without elements the trie lookup is as cheap as a cache
+	 * lookup would be, so only ACLs with elements get a cache.
+	 */
+	if (cachesize != 0 && acl->length != 0 && acl_addressonly(acl)) {
+		for (size = ACL_CACHE_LOCKS; size < cachesize; size <<= 1)
+			;
+		comp->cache = isc_mem_get(acl->mctx,
+					  size * sizeof(acl_cacheentry_t));
+		if (comp->cache == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		memset(comp->cache, 0, size * sizeof(acl_cacheentry_t));
+		comp->cachemask = size - 1;
+		for (i = 0; i < ACL_CACHE_LOCKS; i++) {
+			result = isc_mutex_init(&comp->cachelock[i]);
+			if (result != ISC_R_SUCCESS) {
+				while (i-- > 0)
+					DESTROYLOCK(&comp->cachelock[i]);
+				isc_mem_put(acl->mctx, comp->cache,
+					    size * sizeof(acl_cacheentry_t));
+				comp->cache = NULL;
+				goto cleanup;
+			}
+		}
+	}
+
+	acl->compiled = comp;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	compiled_free(acl->mctx, &comp, acl->length);
+	return (result);
+}
+
 /*
  * Merge the contents of one ACL into another.  Call dns_iptable_merge()
  * for the IP tables, then concatenate the element arrays.
@@ -319,6 +891,10 @@ dns_acl_merge(dns_acl_t *dest, dns_acl_t *source, isc_boolean_t pos)
 	unsigned int newalloc, nelem, i;
 	int max_node = 0, nodes;
 
+	/* The compiled form will be out of date. */
+	if (dest->compiled != NULL)
+		compiled_free(dest->mctx, &dest->compiled, dest->length);
+
 	/* Resize the element array if needed. */
 	if (dest->length + source->length > dest->alloc) {
 		void *newmem;
@@ -530,6 +1106,9 @@ destroy(dns_acl_t *dacl) {
 
 	INSIST(!ISC_LINK_LINKED(dacl, nextincache));
 
+	if (dacl->compiled != NULL)
+		compiled_free(dacl->mctx, &dacl->compiled, dacl->length);
+
 	for (i = 0; i < dacl->length; i++) {
 		dns_aclelement_t *de = &dacl->elements[i];
 		if (de->type == dns_aclelementtype_keyname) {
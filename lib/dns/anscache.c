@@ -0,0 +1,375 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/anscache.h>
+#include <dns/name.h>
+#include <dns/types.h>
+
+/*
+ * Number of independently locked stripes.  Each stripe is a small
+ * hash table with its own LRU list and a share of the entry limit.
+ */
+#define ANSCACHE_NSTRIPES	64
+
+typedef struct dns_acentry dns_acentry_t;
+
+struct dns_acentry {
+	dns_acentry_t *			next;
+	ISC_LINK(dns_acentry_t)		link;
+	unsigned int			hashval;
+	const void *			owner;
+	isc_uint32_t			generation;
+	dns_rdatatype_t			type;
+	dns_rdataclass_t		rdclass;
+	unsigned int			flags;
+	isc_uint16_t			udpsize;
+	unsigned int			tag;
+	unsigned int			namelen;
+	unsigned int			wirelen;
+	/* name data followed by the message */
+};
+
+#define ENTRY_NAME(e)	((unsigned char *)((e) + 1))
+#define ENTRY_WIRE(e)	(ENTRY_NAME(e) + (e)->namelen)
+#define ENTRY_SIZE(e)	(sizeof(*(e)) + (e)->namelen + (e)->wirelen)
+
+typedef struct dns_acstripe {
+	isc_mutex_t			lock;
+	dns_acentry_t **		table;
+	unsigned int			size;
+	unsigned int			count;
+	ISC_LIST(dns_acentry_t)		lru;
+} dns_acstripe_t;
+
+struct dns_anscache {
+	unsigned int			magic;
+	isc_mem_t *			mctx;
+	unsigned int			limit;		/* per stripe */
+	dns_acstripe_t			stripes[ANSCACHE_NSTRIPES];
+};
+
+#define ANSCACHE_MAGIC			ISC_MAGIC('A', 'n', 'C', 'a')
+#define VALID_ANSCACHE(m)		ISC_MAGIC_VALID(m, ANSCACHE_MAGIC)
+
+isc_result_t
+dns_anscache_create(isc_mem_t *mctx, unsigned int size,
+		    dns_anscache_t **cachep)
+{
+	isc_result_t result;
+	dns_anscache_t *cache;
+	dns_acstripe_t *stripe;
+	unsigned int i, tsize;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(size > 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	if (cache == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(cache, 0, sizeof(*cache));
+
+	cache->limit = (size + ANSCACHE_NSTRIPES - 1) / ANSCACHE_NSTRIPES;
+	tsize = cache->limit / 2 + 1;
+
+	for (i = 0; i < ANSCACHE_NSTRIPES; i++) {
+		stripe = &cache->stripes[i];
+		stripe->table = isc_mem_get(mctx,
+					    tsize * sizeof(dns_acentry_t *));
+		if (stripe->table == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		memset(stripe->table, 0, tsize * sizeof(dns_acentry_t *));
+		result = isc_mutex_init(&stripe->lock);
+		if (result != ISC_R_SUCCESS) {
+			isc_mem_put(mctx, stripe->table,
+				    tsize * sizeof(dns_acentry_t *));
+			goto cleanup;
+		}
+		stripe->size = tsize;
+		stripe->count = 0;
+		ISC_LIST_INIT(stripe->lru);
+	}
+
+	isc_mem_attach(mctx, &cache->mctx);
+	cache->magic = ANSCACHE_MAGIC;
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	while (i-- > 0) {
+		stripe = &cache->stripes[i];
+		DESTROYLOCK(&stripe->lock);
+		isc_mem_put(mctx, stripe->table,
+			    stripe->size * sizeof(dns_acentry_t *));
+	}
+	isc_mem_put(mctx, cache, sizeof(*cache));
+	return (result);
+}
+
+static inline unsigned int
+key_hash(const dns_anscachekey_t *key) {
+	isc_uint32_t hashval;
+	isc_uint32_t fields[4];
+
+	fields[0] = key->type;
+	fields[1] = key->rdclass;
+	fields[2] = key->flags;
+	fields[3] = key->udpsize;
+
+	hashval = isc_hash_function(key->name->ndata, key->name->length,
+				    ISC_TRUE, NULL);
+	return (isc_hash_function(fields, sizeof(fields), ISC_TRUE, &hashval));
+}
+
+static inline isc_boolean_t
+key_match(dns_acentry_t *entry, unsigned int hashval,
+	  const dns_anscachekey_t *key)
+{
+	return (ISC_TF(entry->hashval == hashval &&
+		       entry->type == key->type &&
+		       entry->rdclass == key->rdclass &&
+		       entry->flags == key->flags &&
+		       entry->udpsize == key->udpsize &&
+		       entry->owner == key->owner &&
+		       entry->namelen == key->name->length &&
+		       memcmp(ENTRY_NAME(entry), key->name->ndata,
+			      entry->namelen) == 0));
+}
+
+/*
+ * Unlink 'entry' from the hash chain (after 'prev', or at the head of
+ * bucket 'i') and from the LRU list, and free it.  Stripe must be locked.
+ */
+static void
+unlink_entry(dns_anscache_t *cache, dns_acstripe_t *stripe, unsigned int i,
+	     dns_acentry_t *prev, dns_acentry_t *entry)
+{
+	if (prev == NULL)
+		stripe->table[i] = entry->next;
+	else
+		prev->next = entry->next;
+	ISC_LIST_UNLINK(stripe->lru, entry, link);
+	INSIST(stripe->count > 0);
+	stripe->count--;
+	isc_mem_put(cache->mctx, entry, ENTRY_SIZE(entry));
+}
+
+/*
+ * Free the least recently used entry of 'stripe'.  Stripe must be locked.
+ */
+static void
+evict_entry(dns_anscache_t *cache, dns_acstripe_t *stripe) {
+	dns_acentry_t *victim, *entry, *prev = NULL;
+	unsigned int i;
+
+	victim = ISC_LIST_TAIL(stripe->lru);
+	if (victim == NULL)
+		return;
+
+	i = (victim->hashval / ANSCACHE_NSTRIPES) % stripe->size;
+	for (entry = stripe->table[i]; entry != victim; entry = entry->next) {
+		INSIST(entry != NULL);
+		prev = entry;
+	}
+	unlink_entry(cache, stripe, i, prev, victim);
+}
+
+isc_result_t
+dns_anscache_find(dns_anscache_t *cache, const dns_anscachekey_t *key,
+		  isc_buffer_t *target, unsigned int *tagp)
+{
+	dns_acstripe_t *stripe;
+	dns_acentry_t *entry, *prev = NULL;
+	isc_result_t result = ISC_R_NOTFOUND;
+	unsigned int hashval, i;
+
+	REQUIRE(VALID_ANSCACHE(cache));
+	REQUIRE(key != NULL && key->name != NULL);
+	REQUIRE(dns_name_isabsolute(key->name));
+	REQUIRE(ISC_BUFFER_VALID(target));
+
+	hashval = key_hash(key);
+	stripe = &cache->stripes[hashval % ANSCACHE_NSTRIPES];
+	i = (hashval / ANSCACHE_NSTRIPES) % stripe->size;
+
+	LOCK(&stripe->lock);
+	for (entry = stripe->table[i]; entry != NULL; entry = entry->next) {
+		if (key_match(entry, hashval, key))
+			break;
+		prev = entry;
+	}
+	if (entry == NULL)
+		goto unlock;
+
+	if (entry->generation != key->generation) {
+		unlink_entry(cache, stripe, i, prev, entry);
+		goto unlock;
+	}
+
+	if (isc_buffer_availablelength(target) < entry->wirelen) {
+		result = ISC_R_NOSPACE;
+		goto unlock;
+	}
+
+	isc_buffer_putmem(target, ENTRY_WIRE(entry), entry->wirelen);
+	if (tagp != NULL)
+		*tagp = entry->tag;
+
+	if (entry != ISC_LIST_HEAD(stripe->lru)) {
+		ISC_LIST_UNLINK(stripe->lru, entry, link);
+		ISC_LIST_PREPEND(stripe->lru, entry, link);
+	}
+	result = ISC_R_SUCCESS;
+
+ unlock:
+	UNLOCK(&stripe->lock);
+	return (result);
+}
+
+isc_result_t
+dns_anscache_add(dns_anscache_t *cache, const dns_anscachekey_t *key,
+		 const isc_region_t *wire, unsigned int tag)
+{
+	dns_acstripe_t *stripe;
+	dns_acentry_t *entry, *prev = NULL, *newentry;
+	unsigned int hashval, i;
+
+	REQUIRE(VALID_ANSCACHE(cache));
+	REQUIRE(key != NULL && key->name != NULL);
+	REQUIRE(dns_name_isabsolute(key->name));
+	REQUIRE(wire != NULL);
+
+	if (wire->length > DNS_ANSCACHE_MAXWIRE)
+		return (ISC_R_NOSPACE);
+
+	/*
+	 * Build the new entry before taking the stripe lock.
+	 */
+	newentry = isc_mem_get(cache->mctx, sizeof(*newentry) +
+			       key->name->length + wire->length);
+	if (newentry == NULL)
+		return (ISC_R_NOMEMORY);
+	ISC_LINK_INIT(newentry, link);
+	newentry->next = NULL;
+	newentry->owner = key->owner;
+	newentry->generation = key->generation;
+	newentry->type = key->type;
+	newentry->rdclass = key->rdclass;
+	newentry->flags = key->flags;
+	newentry->udpsize = key->udpsize;
+	newentry->tag = tag;
+	newentry->namelen = key->name->length;
+	newentry->wirelen = wire->length;
+	memmove(ENTRY_NAME(newentry), key->name->ndata, newentry->namelen);
+	memmove(ENTRY_WIRE(newentry), wire->base, newentry->wirelen);
+
+	hashval = newentry->hashval = key_hash(key);
+	stripe = &cache->stripes[hashval % ANSCACHE_NSTRIPES];
+	i = (hashval / ANSCACHE_NSTRIPES) % stripe->size;
+
+	LOCK(&stripe->lock);
+	for (entry = stripe->table[i]; entry != NULL; entry = entry->next) {
+		if (key_match(entry, hashval, key)) {
+			unlink_entry(cache, stripe, i, prev, entry);
+			break;
+		}
+		prev = entry;
+	}
+
+	while (stripe->count >= cache->limit)
+		evict_entry(cache, stripe);
+
+	newentry->next = stripe->table[i];
+	stripe->table[i] = newentry;
+	ISC_LIST_PREPEND(stripe->lru, newentry, link);
+	stripe->count++;
+	UNLOCK(&stripe->lock);
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_anscache_flush(dns_anscache_t *cache) {
+	dns_acstripe_t *stripe;
+	dns_acentry_t *entry, *next;
+	unsigned int i, j;
+
+	REQUIRE(VALID_ANSCACHE(cache));
+
+	for (i = 0; i < ANSCACHE_NSTRIPES; i++) {
+		stripe = &cache->stripes[i];
+		LOCK(&stripe->lock);
+		for (j = 0; stripe->count > 0 && j < stripe->size; j++) {
+			for (entry = stripe->table[j];
+			     entry != NULL;
+			     entry = next)
+			{
+				next = entry->next;
+				ISC_LIST_UNLINK(stripe->lru, entry, link);
+				isc_mem_put(cache->mctx, entry,
+					    ENTRY_SIZE(entry));
+				stripe->count--;
+			}
+			stripe->table[j] = NULL;
+		}
+		INSIST(ISC_LIST_EMPTY(stripe->lru));
+		UNLOCK(&stripe->lock);
+	}
+}
+
+unsigned int
+dns_anscache_count(dns_anscache_t *cache) {
+	unsigned int i, count = 0;
+
+	REQUIRE(VALID_ANSCACHE(cache));
+
+	for (i = 0; i < ANSCACHE_NSTRIPES; i++) {
+		LOCK(&cache->stripes[i].lock);
+		count += cache->stripes[i].count;
+		UNLOCK(&cache->stripes[i].lock);
+	}
+
+	return (count);
+}
+
+void
+dns_anscache_destroy(dns_anscache_t **cachep) {
+	dns_anscache_t *cache;
+	dns_acstripe_t *stripe;
+	unsigned int i;
+
+	REQUIRE(cachep != NULL);
+	cache = *cachep;
+	REQUIRE(VALID_ANSCACHE(cache));
+
+	dns_anscache_flush(cache);
+
+	cache->magic = 0;
+	for (i = 0; i < ANSCACHE_NSTRIPES; i++) {
+		stripe = &cache->stripes[i];
+		DESTROYLOCK(&stripe->lock);
+		isc_mem_put(cache->mctx, stripe->table,
+			    stripe->size * sizeof(dns_acentry_t *));
+	}
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+	*cachep = NULL;
+}
@@ -1410,6 +1410,9 @@ dns_cache_dumpstats(dns_cache_t *cache, FILE *fp) {
 	fprintf(fp, "%20" ISC_PLATFORM_QUADFORMAT "u %s\n",
 		(isc_uint64_t) dns_db_hashsize(cache->db),
 		"cache database hash buckets");
+	fprintf(fp, "%20" ISC_PLATFORM_QUADFORMAT "u %s\n",
+		(isc_uint64_t) dns_db_hashpending(cache->db),
+		"cache database hash buckets left to rehash");
 
 	fprintf(fp, "%20" ISC_PLATFORM_QUADFORMAT "u %s\n",
 		(isc_uint64_t) isc_mem_total(cache->mctx),
@@ -1475,6 +1478,8 @@ dns_cache_renderxml(dns_cache_t *cache, xmlTextWriterPtr writer) {
 
 	TRY0(renderstat("CacheNodes", dns_db_nodecount(cache->db), writer));
 	TRY0(renderstat("CacheBuckets", dns_db_hashsize(cache->db), writer));
+	TRY0(renderstat("CacheRehashPending", dns_db_hashpending(cache->db),
+			writer));
 
 	TRY0(renderstat("TreeMemTotal", isc_mem_total(cache->mctx), writer));
 	TRY0(renderstat("TreeMemInUse", isc_mem_inuse(cache->mctx), writer));
@@ -1540,6 +1545,10 @@ dns_cache_renderjson(dns_cache_t *cache, json_object *cstats) {
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "CacheBuckets", obj);
 
+	obj = json_object_new_int64(dns_db_hashpending(cache->db));
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "CacheRehashPending", obj);
+
 	obj = json_object_new_int64(isc_mem_total(cache->mctx));
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "TreeMemTotal", obj);
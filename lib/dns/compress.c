@@ -63,74 +63,27 @@ static unsigned char maptolower[] = {
 };
 
 /*
- * The tableindex array below is of size 256, one entry for each
- * unsigned char value. The tableindex array elements are dependent on
- * DNS_COMPRESS_TABLESIZE. The table was created using the following
- * function.
+ * Flags kept in the top bits of dns_compressnode_t.offset; message
+ * offsets usable in compression pointers are below 0x4000.
  *
- * static void
- * gentable(unsigned char *table) {
- *         unsigned int i;
- *         const unsigned int left = DNS_COMPRESS_TABLESIZE - 38;
- *         long r;
- *
- *         for (i = 0; i < 26; i++) {
- *                 table['A' + i] = i;
- *                 table['a' + i] = i;
- *         }
- *
- *         for (i = 0; i <= 9; i++)
- *                 table['0' + i] = i + 26;
- *
- *         table['-'] = 36;
- *         table['_'] = 37;
- *
- *         for (i = 0; i < 256; i++) {
- *                 if ((i >= 'a' && i <= 'z') ||
- *                     (i >= 'A' && i <= 'Z') ||
- *                     (i >= '0' && i <= '9') ||
- *                     (i == '-') ||
- *                     (i == '_'))
- *                         continue;
- *                 r = random() % left;
- *                 table[i] = 38 + r;
- *         }
- * }
+ * NODE_ALLOCATED marks a node whose name data was allocated from the
+ * memory context and NODE_ARENA one whose name data was taken from the
+ * arena.  Either flag is set only on the first node added for a name;
+ * further nodes for the same name point into its copy.
  */
-static unsigned char tableindex[256] = {
-	0x3e, 0x3e, 0x33, 0x2d, 0x30, 0x38, 0x31, 0x3c,
-	0x2b, 0x33, 0x30, 0x3f, 0x2d, 0x3c, 0x36, 0x3a,
-	0x28, 0x2c, 0x2a, 0x37, 0x3d, 0x34, 0x35, 0x2d,
-	0x39, 0x2b, 0x2f, 0x2c, 0x3b, 0x32, 0x2b, 0x39,
-	0x30, 0x38, 0x28, 0x3c, 0x32, 0x33, 0x39, 0x38,
-	0x27, 0x2b, 0x39, 0x30, 0x27, 0x24, 0x2f, 0x2b,
-	0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21,
-	0x22, 0x3a, 0x29, 0x36, 0x31, 0x3c, 0x35, 0x26,
-	0x31, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
-	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
-	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
-	0x17, 0x18, 0x19, 0x3e, 0x3b, 0x39, 0x2f, 0x25,
-	0x27, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
-	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
-	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
-	0x17, 0x18, 0x19, 0x36, 0x3b, 0x2f, 0x2f, 0x2e,
-	0x29, 0x33, 0x2a, 0x36, 0x28, 0x3f, 0x2e, 0x29,
-	0x2c, 0x29, 0x36, 0x2d, 0x32, 0x3d, 0x33, 0x2a,
-	0x2e, 0x2f, 0x3b, 0x30, 0x3d, 0x39, 0x2b, 0x36,
-	0x2a, 0x2f, 0x2c, 0x26, 0x3a, 0x37, 0x30, 0x3d,
-	0x2a, 0x36, 0x33, 0x2c, 0x38, 0x3d, 0x32, 0x3e,
-	0x26, 0x2a, 0x2c, 0x35, 0x27, 0x39, 0x3b, 0x31,
-	0x2a, 0x37, 0x3c, 0x27, 0x32, 0x29, 0x39, 0x37,
-	0x34, 0x3f, 0x39, 0x2e, 0x38, 0x2b, 0x2c, 0x3e,
-	0x3b, 0x3b, 0x2d, 0x33, 0x3b, 0x3b, 0x32, 0x3d,
-	0x3f, 0x3a, 0x34, 0x26, 0x35, 0x30, 0x31, 0x39,
-	0x27, 0x2f, 0x3d, 0x35, 0x35, 0x36, 0x2e, 0x29,
-	0x38, 0x27, 0x34, 0x32, 0x2c, 0x3c, 0x31, 0x28,
-	0x37, 0x38, 0x37, 0x34, 0x33, 0x29, 0x32, 0x34,
-	0x3f, 0x26, 0x34, 0x34, 0x32, 0x27, 0x30, 0x33,
-	0x33, 0x2d, 0x2b, 0x28, 0x3f, 0x33, 0x2b, 0x39,
-	0x37, 0x39, 0x2c, 0x3d, 0x35, 0x39, 0x27, 0x2f
-};
+#define NODE_ALLOCATED	0x8000
+#define NODE_ARENA	0x4000
+#define NODE_OFFSET(n)	((n)->offset & 0x3fff)
+
+/*
+ * FNV-1a, applied to the case-folded suffix a label at a time starting
+ * from the label nearest the root.  Folding the high bits into the low
+ * ones before masking spreads names that only differ at the front.
+ */
+#define HASH_INIT	2166136261U
+#define HASH_PRIME	16777619U
+#define HASH_SLOT(h, size) \
+	(((h) ^ ((h) >> 16)) & ((size) - 1))
 
 /***
  ***	Compression
@@ -145,8 +98,13 @@ dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
 	cctx->mctx = mctx;
 	cctx->count = 0;
 	cctx->allowed = DNS_COMPRESS_ENABLED;
+	cctx->arenaused = 0;
 
-	memset(&cctx->table[0], 0, sizeof(cctx->table));
+	memset(&cctx->initialtable[0], 0, sizeof(cctx->initialtable));
+	cctx->table = cctx->initialtable;
+	cctx->tablesize = DNS_COMPRESS_TABLESIZE;
+	cctx->nodes = cctx->initialnodes;
+	cctx->nodessize = DNS_COMPRESS_INITIALNODES;
 
 	cctx->magic = CCTX_MAGIC;
 
@@ -160,19 +118,21 @@ dns_compress_invalidate(dns_compress_t *cctx) {
 
 	REQUIRE(VALID_CCTX(cctx));
 
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		while (cctx->table[i] != NULL) {
-			node = cctx->table[i];
-			cctx->table[i] = cctx->table[i]->next;
-			if ((node->offset & 0x8000) != 0)
-				isc_mem_put(cctx->mctx, node->r.base,
-					    node->r.length);
-			if (node->count < DNS_COMPRESS_INITIALNODES)
-				continue;
-			isc_mem_put(cctx->mctx, node, sizeof(*node));
-		}
+	for (i = 0; i < cctx->count; i++) {
+		node = &cctx->nodes[i];
+		if ((node->offset & NODE_ALLOCATED) != 0)
+			isc_mem_put(cctx->mctx, node->ndata, node->length);
 	}
-
+	if (cctx->table != cctx->initialtable)
+		isc_mem_put(cctx->mctx, cctx->table,
+			    cctx->tablesize * sizeof(cctx->table[0]));
+	if (cctx->nodes != cctx->initialnodes)
+		isc_mem_put(cctx->mctx, cctx->nodes,
+			    cctx->nodessize * sizeof(cctx->nodes[0]));
+
+	cctx->table = NULL;
+	cctx->nodes = NULL;
+	cctx->count = 0;
 	cctx->magic = 0;
 	cctx->allowed = 0;
 	cctx->edns = -1;
@@ -221,6 +181,174 @@ dns_compress_getedns(dns_compress_t *cctx) {
 	return (cctx->edns);
 }
 
+/*
+ * Compute the case-folded hashes of the first 'count' suffixes of
+ * 'name', and the offsets within 'name' at which they start.  The
+ * hash is built from the root towards the first label so a single
+ * pass over the name yields every suffix hash.
+ */
+static void
+suffix_hashes(const dns_name_t *name, unsigned int count,
+	      isc_uint32_t *hashes, unsigned int *starts)
+{
+	dns_offsets_t odata;
+	const unsigned char *offsets, *p;
+	unsigned int labels, i, n, llen;
+	isc_uint32_t h;
+
+	labels = name->labels;
+	offsets = name->offsets;
+	if (offsets == NULL) {
+		p = name->ndata;
+		for (n = 0; n < labels; n++) {
+			odata[n] = (unsigned char)(p - name->ndata);
+			p += *p + 1;
+		}
+		offsets = odata;
+	}
+
+	/*
+	 * The root label is common to every name and is left out.
+	 */
+	h = HASH_INIT;
+	for (n = labels - 1; n-- > 0; ) {
+		p = name->ndata + offsets[n];
+		llen = *p + 1;
+		for (i = 0; i < llen; i++)
+			h = (h ^ maptolower[p[i]]) * HASH_PRIME;
+		if (n < count) {
+			hashes[n] = h;
+			starts[n] = offsets[n];
+		}
+	}
+}
+
+/*
+ * Return the eight bytes in 'w' with upper case ASCII letters
+ * converted to lower case.  A byte is an upper case letter if its top
+ * bit is clear and adding 0x80 - 'A' to it sets the top bit while
+ * adding 0x7f - 'Z' does not; neither sum can carry into the next
+ * byte.
+ */
+static inline isc_uint64_t
+fold64(isc_uint64_t w) {
+	const isc_uint64_t ones = 0x0101010101010101ULL;
+	isc_uint64_t low, ge_a, gt_z, upper;
+
+	low = w & (ones * 0x7f);
+	ge_a = low + ones * (0x80 - 'A');
+	gt_z = low + ones * (0x7f - 'Z');
+	upper = (ge_a ^ gt_z) & ~w & (ones * 0x80);
+
+	return (w | (upper >> 2));
+}
+
+/*
+ * Compare two names of 'length' bytes in wire format ignoring case.
+ * Label length bytes are all below 'A' and are left alone by case
+ * folding, so the names can be compared as plain strings, eight bytes
+ * at a time while enough remain.
+ */
+static inline isc_boolean_t
+equal_nocase(const unsigned char *a, const unsigned char *b,
+	     unsigned int length)
+{
+	isc_uint64_t wa, wb;
+
+	while (length >= 8) {
+		memmove(&wa, a, sizeof(wa));
+		memmove(&wb, b, sizeof(wb));
+		if (wa != wb && fold64(wa) != fold64(wb))
+			return (ISC_FALSE);
+		a += 8;
+		b += 8;
+		length -= 8;
+	}
+	while (length-- > 0) {
+		if (maptolower[*a++] != maptolower[*b++])
+			return (ISC_FALSE);
+	}
+
+	return (ISC_TRUE);
+}
+
+static inline dns_compressnode_t *
+find_node(dns_compress_t *cctx, isc_uint32_t hash, const unsigned char *ndata,
+	  unsigned int length, isc_boolean_t sensitive)
+{
+	dns_compressnode_t *node;
+	unsigned int i;
+
+	for (i = HASH_SLOT(hash, cctx->tablesize);
+	     cctx->table[i] != 0;
+	     i = (i + 1) & (cctx->tablesize - 1))
+	{
+		node = &cctx->nodes[cctx->table[i] - 1];
+		if (node->hash != hash || node->length != length)
+			continue;
+		if (ISC_LIKELY(memcmp(node->ndata, ndata, length) == 0))
+			return (node);
+		if (!sensitive && equal_nocase(node->ndata, ndata, length))
+			return (node);
+	}
+
+	return (NULL);
+}
+
+static inline void
+insert_node(dns_compress_t *cctx, unsigned int n) {
+	unsigned int i;
+
+	for (i = HASH_SLOT(cctx->nodes[n].hash, cctx->tablesize);
+	     cctx->table[i] != 0;
+	     i = (i + 1) & (cctx->tablesize - 1))
+		;
+	cctx->table[i] = (isc_uint16_t)(n + 1);
+}
+
+/*
+ * Make room for one more node, growing the node array and the table
+ * as needed.  The table is rebuilt by adding the nodes in their
+ * original order, so it ends up as if they had been added to the
+ * larger table all along; dns_compress_rollback() relies on this.
+ */
+static isc_boolean_t
+grow(dns_compress_t *cctx) {
+	dns_compressnode_t *nodes;
+	isc_uint16_t *table;
+	unsigned int i, size;
+
+	if (cctx->count == cctx->nodessize) {
+		size = cctx->nodessize * 2;
+		nodes = isc_mem_get(cctx->mctx, size * sizeof(nodes[0]));
+		if (nodes == NULL)
+			return (ISC_FALSE);
+		memmove(nodes, cctx->nodes, cctx->count * sizeof(nodes[0]));
+		if (cctx->nodes != cctx->initialnodes)
+			isc_mem_put(cctx->mctx, cctx->nodes,
+				    cctx->nodessize * sizeof(nodes[0]));
+		cctx->nodes = nodes;
+		cctx->nodessize = size;
+	}
+
+	if (cctx->count + 1U > cctx->tablesize / 2) {
+		size = cctx->tablesize * 2;
+		table = isc_mem_get(cctx->mctx, size * sizeof(table[0]));
+		if (table == NULL)
+			return (ISC_FALSE);
+		memset(table, 0, size * sizeof(table[0]));
+		if (cctx->table != cctx->initialtable)
+			isc_mem_put(cctx->mctx, cctx->table,
+				    cctx->tablesize * sizeof(table[0]));
+		cctx->table = table;
+		cctx->tablesize = size;
+		for (i = 0; i < cctx->count; i++)
+			insert_node(cctx, i);
+	}
+
+	return (ISC_TRUE);
+}
+
 /*
  * Find the longest match of name in the table.
  * If match is found return ISC_TRUE. prefix, suffix and offset are updated.
@@ -230,11 +358,12 @@ isc_boolean_t
 dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 			dns_name_t *prefix, isc_uint16_t *offset)
 {
-	dns_name_t tname;
 	dns_compressnode_t *node = NULL;
-	unsigned int labels, i, n;
+	isc_uint32_t hashes[2];
+	unsigned int starts[2];
+	unsigned int labels, n;
 	unsigned int numlabels;
-	unsigned char *p;
+	isc_boolean_t sensitive;
 
 	REQUIRE(VALID_CCTX(cctx));
 	REQUIRE(dns_name_isabsolute(name) == ISC_TRUE);
@@ -249,102 +378,20 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 	labels = dns_name_countlabels(name);
 	INSIST(labels > 0);
 
-	dns_name_init(&tname, NULL);
-
 	numlabels = labels > 3U ? 3U : labels;
-	p = name->ndata;
-
-	for (n = 0; n < numlabels - 1; n++) {
-		unsigned char ch, llen;
-		unsigned int firstoffset, length;
-
-		firstoffset = p - name->ndata;
-		length = name->length - firstoffset;
-
-		/*
-		 * We calculate the table index using the first
-		 * character in the first label of the suffix name.
-		 */
-		ch = p[1];
-		i = tableindex[ch];
-		if (ISC_LIKELY((cctx->allowed &
-				DNS_COMPRESS_CASESENSITIVE) != 0))
-		{
-			for (node = cctx->table[i];
-			     node != NULL;
-			     node = node->next)
-			{
-				if (ISC_UNLIKELY(node->name.length != length))
-					continue;
+	if (numlabels < 2U)
+		return (ISC_FALSE);
 
-				if (ISC_LIKELY(memcmp(node->name.ndata,
-						      p, length) == 0))
-					goto found;
-			}
-		} else {
-			for (node = cctx->table[i];
-			     node != NULL;
-			     node = node->next)
-			{
-				unsigned int l, count;
-				unsigned char c;
-				unsigned char *label1, *label2;
-
-				if (ISC_UNLIKELY(node->name.length != length))
-					continue;
-
-				l = labels - n;
-				if (ISC_UNLIKELY(node->name.labels != l))
-					continue;
-
-				label1 = node->name.ndata;
-				label2 = p;
-				while (ISC_LIKELY(l-- > 0)) {
-					count = *label1++;
-					if (count != *label2++)
-						goto cont1;
-
-					/* no bitstring support */
-					INSIST(count <= 63);
-
-					/* Loop unrolled for performance */
-					while (ISC_LIKELY(count > 3)) {
-						c = maptolower[label1[0]];
-						if (c != maptolower[label2[0]])
-							goto cont1;
-						c = maptolower[label1[1]];
-						if (c != maptolower[label2[1]])
-							goto cont1;
-						c = maptolower[label1[2]];
-						if (c != maptolower[label2[2]])
-							goto cont1;
-						c = maptolower[label1[3]];
-						if (c != maptolower[label2[3]])
-							goto cont1;
-						count -= 4;
-						label1 += 4;
-						label2 += 4;
-					}
-					while (ISC_LIKELY(count-- > 0)) {
-						c = maptolower[*label1++];
-						if (c != maptolower[*label2++])
-							goto cont1;
-					}
-				}
-				break;
- cont1:
-				continue;
-			}
-		}
+	sensitive = ISC_TF((cctx->allowed & DNS_COMPRESS_CASESENSITIVE) != 0);
+	suffix_hashes(name, numlabels - 1, hashes, starts);
 
+	for (n = 0; n < numlabels - 1; n++) {
+		node = find_node(cctx, hashes[n], name->ndata + starts[n],
+				 name->length - starts[n], sensitive);
 		if (node != NULL)
 			break;
-
-		llen = *p;
-		p += llen + 1;
 	}
 
- found:
 	/*
 	 * If node == NULL, we found no match at all.
 	 */
@@ -356,32 +403,21 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 	else
 		dns_name_getlabelsequence(name, 0, n, prefix);
 
-	*offset = (node->offset & 0x7fff);
+	*offset = NODE_OFFSET(node);
 	return (ISC_TRUE);
 }
 
-static inline unsigned int
-name_length(const dns_name_t *name) {
-	isc_region_t r;
-	dns_name_toregion(name, &r);
-	return (r.length);
-}
-
 void
 dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 		 const dns_name_t *prefix, isc_uint16_t offset)
 {
-	dns_name_t tname, xname;
-	unsigned int start;
-	unsigned int n;
-	unsigned int count;
-	unsigned int i;
 	dns_compressnode_t *node;
-	unsigned int length;
-	unsigned int tlength;
+	isc_uint32_t hashes[2];
+	unsigned int starts[2];
+	unsigned int count, n, first;
+	unsigned int length, tlength;
 	isc_uint16_t toffset;
-	unsigned char *tmp;
-	isc_region_t r;
+	unsigned char *tmp = NULL;
 
 	REQUIRE(VALID_CCTX(cctx));
 	REQUIRE(dns_name_isabsolute(name));
@@ -391,109 +427,98 @@ dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 
 	if (offset >= 0x4000)
 		return;
-	dns_name_init(&tname, NULL);
-	dns_name_init(&xname, NULL);
 
-	n = dns_name_countlabels(name);
 	count = dns_name_countlabels(prefix);
 	if (dns_name_isabsolute(prefix))
 		count--;
 	if (count == 0)
 		return;
-	start = 0;
-	dns_name_toregion(name, &r);
-	length = r.length;
-	tmp = isc_mem_get(cctx->mctx, length);
-	if (tmp == NULL)
-		return;
-	/*
-	 * Copy name data to 'tmp' and make 'r' use 'tmp'.
-	 */
-	memmove(tmp, r.base, r.length);
-	r.base = tmp;
-	dns_name_fromregion(&xname, &r);
-
 	if (count > 2U)
 		count = 2U;
 
-	while (count > 0) {
-		unsigned char ch;
+	length = name->length;
+	suffix_hashes(name, count, hashes, starts);
 
-		dns_name_getlabelsequence(&xname, start, n, &tname);
-		/*
-		 * We calculate the table index using the first
-		 * character in the first label of tname.
-		 */
-		ch = tname.ndata[1];
-		i = tableindex[ch];
-		tlength = name_length(&tname);
-		toffset = (isc_uint16_t)(offset + (length - tlength));
+	first = 0;
+	for (n = 0; n < count; n++) {
+		tlength = length - starts[n];
+		toffset = (isc_uint16_t)(offset + starts[n]);
 		if (toffset >= 0x4000)
 			break;
+
 		/*
-		 * Create a new node and add it.
+		 * Existing pointers are not replaced.
 		 */
-		if (cctx->count < DNS_COMPRESS_INITIALNODES)
-			node = &cctx->initialnodes[cctx->count];
-		else {
-			node = isc_mem_get(cctx->mctx,
-					   sizeof(dns_compressnode_t));
-			if (node == NULL)
-				break;
-		}
-		node->count = cctx->count++;
+		if (find_node(cctx, hashes[n], name->ndata + starts[n],
+			      tlength, ISC_TRUE) != NULL)
+			continue;
+
+		if (!grow(cctx))
+			break;
+
 		/*
-		 * 'node->r.base' becomes 'tmp' when start == 0.
-		 * Record this by setting 0x8000 so it can be freed later.
+		 * The first node added for the name gets a copy of it,
+		 * from the arena if there is room; later ones share it.
 		 */
-		if (start == 0)
-			toffset |= 0x8000;
+		if (tmp == NULL) {
+			if (tlength <= DNS_COMPRESS_ARENASIZE -
+				       cctx->arenaused)
+			{
+				tmp = cctx->arena + cctx->arenaused;
+				cctx->arenaused += tlength;
+				toffset |= NODE_ARENA;
+			} else {
+				tmp = isc_mem_get(cctx->mctx, tlength);
+				if (tmp == NULL)
+					break;
+				toffset |= NODE_ALLOCATED;
+			}
+			memmove(tmp, name->ndata + starts[n], tlength);
+			first = starts[n];
+		}
+
+		node = &cctx->nodes[cctx->count];
+		node->hash = hashes[n];
 		node->offset = toffset;
-		dns_name_toregion(&tname, &node->r);
-		dns_name_init(&node->name, NULL);
-		node->name.length = node->r.length;
-		node->name.ndata = node->r.base;
-		node->name.labels = tname.labels;
-		node->name.attributes = DNS_NAMEATTR_ABSOLUTE;
-		node->next = cctx->table[i];
-		cctx->table[i] = node;
-		start++;
-		n--;
-		count--;
+		node->length = (isc_uint16_t)tlength;
+		node->ndata = tmp + (starts[n] - first);
+		insert_node(cctx, cctx->count);
+		cctx->count++;
 	}
-
-	if (start == 0)
-		isc_mem_put(cctx->mctx, tmp, length);
 }
 
 void
 dns_compress_rollback(dns_compress_t *cctx, isc_uint16_t offset) {
-	unsigned int i;
 	dns_compressnode_t *node;
+	unsigned int i;
 
 	REQUIRE(VALID_CCTX(cctx));
 
 	if (ISC_UNLIKELY((cctx->allowed & DNS_COMPRESS_ENABLED) == 0))
 		return;
 
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		node = cctx->table[i];
-		/*
-		 * This relies on nodes with greater offsets being
-		 * closer to the beginning of the list, and the
-		 * items with the greatest offsets being at the end
-		 * of the initialnodes[] array.
-		 */
-		while (node != NULL && (node->offset & 0x7fff) >= offset) {
-			cctx->table[i] = node->next;
-			if ((node->offset & 0x8000) != 0)
-				isc_mem_put(cctx->mctx, node->r.base,
-					    node->r.length);
-			if (node->count >= DNS_COMPRESS_INITIALNODES)
-				isc_mem_put(cctx->mctx, node, sizeof(*node));
-			cctx->count--;
-			node = cctx->table[i];
-		}
+	/*
+	 * This relies on nodes being added in order of increasing
+	 * offset.  Removing the most recently added node from a
+	 * linear probing table restores the table exactly as it was
+	 * before the node was added, so no tombstones are needed.
+	 */
+	while (cctx->count > 0) {
+		node = &cctx->nodes[cctx->count - 1];
+		if (NODE_OFFSET(node) < offset)
+			break;
+
+		for (i = HASH_SLOT(node->hash, cctx->tablesize);
+		     cctx->table[i] != cctx->count;
+		     i = (i + 1) & (cctx->tablesize - 1))
+			INSIST(cctx->table[i] != 0);
+		cctx->table[i] = 0;
+
+		if ((node->offset & NODE_ALLOCATED) != 0)
+			isc_mem_put(cctx->mctx, node->ndata, node->length);
+		else if ((node->offset & NODE_ARENA) != 0)
+			cctx->arenaused -= node->length;
+		cctx->count--;
 	}
 }
 
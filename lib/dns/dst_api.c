@@ -35,6 +35,7 @@
 #include <isc/buffer.h>
 #include <isc/dir.h>
 #include <isc/entropy.h>
+#include <isc/event.h>
 #include <isc/fsaccess.h>
 #include <isc/hmacsha.h>
 #include <isc/lex.h>
@@ -45,14 +46,20 @@
 #include <isc/refcount.h>
 #include <isc/random.h>
 #include <isc/string.h>
+#include <isc/task.h>
 #include <isc/time.h>
 #include <isc/util.h>
 #include <isc/file.h>
 
+#ifdef ISC_PLATFORM_HAVEXADD
+#include <isc/atomic.h>
+#endif
+
 #include <pk11/site.h>
 
 #define DST_KEY_INTERNAL
 
+#include <dns/events.h>
 #include <dns/fixedname.h>
 #include <dns/keyvalues.h>
 #include <dns/name.h>
@@ -2029,3 +2036,161 @@ dst_key_tkeytoken(const dst_key_t *key) {
 	REQUIRE(VALID_KEY(key));
 	return (key->key_tkeytoken);
 }
+
+/*
+ * A job queued on a crypto pool task.
+ */
+typedef struct dst_cryptojob {
+	ISC_EVENT_COMMON(struct dst_cryptojob);
+	dst_cryptowork_t	work;
+	isc_task_t		*task;
+	isc_event_t		*done;
+} dst_cryptojob_t;
+
+isc_result_t
+dst_cryptopool_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
+		      unsigned int ntasks, dst_cryptopool_t **poolp)
+{
+	dst_cryptopool_t *pool;
+	isc_result_t result;
+	unsigned int i;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(taskmgr != NULL);
+	REQUIRE(ntasks > 0);
+	REQUIRE(poolp != NULL && *poolp == NULL);
+
+	pool = isc_mem_get(mctx, sizeof(*pool));
+	if (pool == NULL)
+		return (ISC_R_NOMEMORY);
+	pool->tasks = isc_mem_get(mctx, ntasks * sizeof(isc_task_t *));
+	if (pool->tasks == NULL) {
+		isc_mem_put(mctx, pool, sizeof(*pool));
+		return (ISC_R_NOMEMORY);
+	}
+	for (i = 0; i < ntasks; i++)
+		pool->tasks[i] = NULL;
+	pool->ntasks = ntasks;
+	pool->next = 0;
+	pool->mctx = NULL;
+	isc_mem_attach(mctx, &pool->mctx);
+#ifndef ISC_PLATFORM_HAVEXADD
+	result = isc_mutex_init(&pool->lock);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(mctx, pool->tasks, ntasks * sizeof(isc_task_t *));
+		isc_mem_putanddetach(&pool->mctx, pool, sizeof(*pool));
+		return (result);
+	}
+#endif
+
+	for (i = 0; i < ntasks; i++) {
+		result = isc_task_create(taskmgr, 0, &pool->tasks[i]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+		isc_task_setname(pool->tasks[i], "crypto", pool);
+	}
+
+	result = isc_refcount_init(&pool->references, 1);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	pool->magic = POOL_MAGIC;
+	*poolp = pool;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	for (i = 0; i < ntasks; i++)
+		if (pool->tasks[i] != NULL)
+			isc_task_detach(&pool->tasks[i]);
+#ifndef ISC_PLATFORM_HAVEXADD
+	DESTROYLOCK(&pool->lock);
+#endif
+	isc_mem_put(mctx, pool->tasks, ntasks * sizeof(isc_task_t *));
+	isc_mem_putanddetach(&pool->mctx, pool, sizeof(*pool));
+	return (result);
+}
+
+void
+dst_cryptopool_attach(dst_cryptopool_t *source, dst_cryptopool_t **targetp) {
+	REQUIRE(VALID_POOL(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+	*targetp = source;
+}
+
+void
+dst_cryptopool_detach(dst_cryptopool_t **poolp) {
+	dst_cryptopool_t *pool;
+	unsigned int i, refs;
+
+	REQUIRE(poolp != NULL && VALID_POOL(*poolp));
+
+	pool = *poolp;
+	*poolp = NULL;
+
+	isc_refcount_decrement(&pool->references, &refs);
+	if (refs != 0)
+		return;
+
+	pool->magic = 0;
+	for (i = 0; i < pool->ntasks; i++)
+		isc_task_detach(&pool->tasks[i]);
+	isc_mem_put(pool->mctx, pool->tasks,
+		    pool->ntasks * sizeof(isc_task_t *));
+#ifndef ISC_PLATFORM_HAVEXADD
+	DESTROYLOCK(&pool->lock);
+#endif
+	isc_refcount_destroy(&pool->references);
+	isc_mem_putanddetach(&pool->mctx, pool, sizeof(*pool));
+}
+
+static void
+cryptojob_run(isc_task_t *task, isc_event_t *event) {
+	dst_cryptojob_t *job = (dst_cryptojob_t *)event;
+
+	UNUSED(task);
+	INSIST(event->ev_type == DNS_EVENT_CRYPTOJOB);
+
+	(job->work)(job->done);
+	isc_task_sendanddetach(&job->task, &job->done);
+	isc_event_free(&event);
+}
+
+isc_result_t
+dst_cryptopool_submit(dst_cryptopool_t *pool, dst_cryptowork_t work,
+		      isc_task_t *task, isc_event_t **eventp)
+{
+	dst_cryptojob_t *job;
+	isc_uint32_t next;
+
+	REQUIRE(VALID_POOL(pool));
+	REQUIRE(work != NULL);
+	REQUIRE(task != NULL);
+	REQUIRE(eventp != NULL && *eventp != NULL);
+
+	job = (dst_cryptojob_t *)
+		isc_event_allocate(pool->mctx, pool, DNS_EVENT_CRYPTOJOB,
+				   cryptojob_run, NULL, sizeof(*job));
+	if (job == NULL)
+		return (ISC_R_NOMEMORY);
+	job->work = work;
+	job->task = NULL;
+	isc_task_attach(task, &job->task);
+	job->done = *eventp;
+	*eventp = NULL;
+
+	/*
+	 * Hand the jobs out round robin, so that a busy key does not
+	 * queue up behind a single task.
+	 */
+#ifdef ISC_PLATFORM_HAVEXADD
+	next = (isc_uint32_t)isc_atomic_xadd(&pool->next, 1);
+#else
+	LOCK(&pool->lock);
+	next = (isc_uint32_t)pool->next++;
+	UNLOCK(&pool->lock);
+#endif
+	isc_task_send(pool->tasks[next % pool->ntasks], (isc_event_t **)&job);
+	return (ISC_R_SUCCESS);
+}
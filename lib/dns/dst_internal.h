@@ -62,9 +62,11 @@ ISC_LANG_BEGINDECLS
 
 #define KEY_MAGIC	ISC_MAGIC('D','S','T','K')
 #define CTX_MAGIC	ISC_MAGIC('D','S','T','C')
+#define POOL_MAGIC	ISC_MAGIC('D','S','T','P')
 
 #define VALID_KEY(x) ISC_MAGIC_VALID(x, KEY_MAGIC)
 #define VALID_CTX(x) ISC_MAGIC_VALID(x, CTX_MAGIC)
+#define VALID_POOL(x) ISC_MAGIC_VALID(x, POOL_MAGIC)
 
 LIBDNS_EXTERNAL_DATA extern isc_mem_t *dst__memory_pool;
 
@@ -181,6 +183,18 @@ struct dst_context {
 	} ctxdata;
 };
 
+struct dst_cryptopool {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	unsigned int ntasks;
+	isc_task_t **tasks;
+	isc_int32_t next;		/* next task to use */
+#ifndef ISC_PLATFORM_HAVEXADD
+	isc_mutex_t lock;		/* protects 'next' */
+#endif
+};
+
 struct dst_func {
 	/*
 	 * Context functions
@@ -57,6 +57,7 @@ typedef enum {
 } dns_aclelementtype_t;
 
 typedef struct dns_aclipprefix dns_aclipprefix_t;
+typedef struct dns_aclcompiled dns_aclcompiled_t;
 
 struct dns_aclipprefix {
 	isc_netaddr_t address; /* IP4/IP6 */
@@ -86,6 +87,7 @@ struct dns_acl {
 	unsigned int 		length;		/*%< Elements initialized */
 	char 			*name;		/*%< Temporary use only */
 	ISC_LINK(dns_acl_t) 	nextincache;	/*%< Ditto */
+	dns_aclcompiled_t	*compiled;	/*%< See dns_acl_compile() */
 };
 
 struct dns_aclenv {
@@ -174,6 +176,34 @@ dns_acl_detach(dns_acl_t **aclp);
  *\li	'*aclp' is not linked on final detach.
  */
 
+isc_result_t
+dns_acl_compile(dns_acl_t *acl, unsigned int cachesize);
+/*%<
+ * Build a compiled form of 'acl' for dns_acl_match() to use in place
+ * of walking the IP table: a multibit trie per address family that
+ * gives the first matching prefix for an address in at most one step
+ * per address byte.  Nested ACLs which have not been compiled yet are
+ * compiled as well.  Any earlier compiled form is discarded.
+ *
+ * If 'cachesize' is nonzero and the result of matching 'acl' depends
+ * only on the client address (i.e., it does not refer to "localhost",
+ * "localnets" or GeoIP data, directly or through nested ACLs), the
+ * results of unsigned, non-ECS matches are also remembered in a
+ * direct-mapped cache of about 'cachesize' entries.
+ *
+ * The ACL must not be modified after it has been compiled, other than
+ * by dns_acl_merge(), which discards the compiled form.  This is
+ * intended to be called once the ACL is fully configured and before
+ * it is shared with other threads.
+ *
+ * Requires:
+ *\li	'acl' to be a valid acl.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
 isc_boolean_t
 dns_acl_isinsecure(const dns_acl_t *a);
 /*%<
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef DNS_ANSCACHE_H
+#define DNS_ANSCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/anscache.h
+ * \brief
+ * Defines dns_anscache_t, the "answer cache" object.
+ *
+ * Notes:
+ *\li	An answer cache holds fully rendered response messages in wire
+ *	format, so that a repeated query can be answered by copying the
+ *	stored message and patching its header instead of looking up and
+ *	rendering the answer again.
+ *
+ *\li	Each entry is bound to an owner (normally the zone the answer
+ *	came from) and to a generation number supplied by the caller.
+ *	An entry whose generation no longer matches the caller's is
+ *	stale and is discarded the next time it is looked up; there is
+ *	no other expiry.
+ *
+ *\li	The cache treats the message contents and the 'flags' and 'tag'
+ *	values as opaque.  The caller is responsible for deciding which
+ *	responses may be stored and for including in 'flags' every
+ *	property of a query that can change the rendered response.
+ *
+ * MP:
+ *\li	The cache is split into a number of independently locked
+ *	stripes, each with its own LRU list, so concurrent lookups of
+ *	different names rarely contend.
+ *
+ * Reliability:
+ *
+ * Resources:
+ *\li	The number of entries is bounded by the size given to
+ *	dns_anscache_create(); the least recently used entry in a stripe
+ *	is evicted to make room for a new one.
+ *
+ * Security:
+ *
+ * Standards:
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <isc/buffer.h>
+#include <isc/lang.h>
+#include <isc/region.h>
+
+#include <dns/types.h>
+
+ISC_LANG_BEGINDECLS
+
+/*%
+ * The largest message that will be stored.
+ */
+#define DNS_ANSCACHE_MAXWIRE		4096
+
+typedef struct dns_anscachekey {
+	const dns_name_t	*name;		/*%< exact (case-sensitive) */
+	dns_rdatatype_t		type;
+	dns_rdataclass_t	rdclass;
+	unsigned int		flags;		/*%< opaque to the cache */
+	isc_uint16_t		udpsize;
+	const void		*owner;
+	isc_uint32_t		generation;
+} dns_anscachekey_t;
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_anscache_create(isc_mem_t *mctx, unsigned int size,
+		    dns_anscache_t **cachep);
+/*%
+ * Create an answer cache holding at most 'size' entries and store it
+ * in '*cachep'.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	size > 0
+ * \li	cachep != NULL && *cachep == NULL
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_anscache_destroy(dns_anscache_t **cachep);
+/*%
+ * Flush and then free the answer cache in '*cachep'.  '*cachep' is set
+ * to NULL on return.
+ *
+ * Requires:
+ * \li	'*cachep' to be a valid answer cache
+ */
+
+isc_result_t
+dns_anscache_find(dns_anscache_t *cache, const dns_anscachekey_t *key,
+		  isc_buffer_t *target, unsigned int *tagp);
+/*%
+ * Look up the message stored for 'key'.  If an entry with a matching
+ * generation exists, copy the stored message into 'target' and, if
+ * 'tagp' is not NULL, set '*tagp' to the tag it was stored with.
+ *
+ * An entry stored for the same key under a different generation is
+ * removed.
+ *
+ * Requires:
+ * \li	'cache' to be a valid answer cache
+ * \li	'key' and 'key->name' to be valid, 'key->name' absolute
+ * \li	'target' to be a valid buffer
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND
+ * \li	#ISC_R_NOSPACE		the stored message does not fit in 'target'
+ */
+
+isc_result_t
+dns_anscache_add(dns_anscache_t *cache, const dns_anscachekey_t *key,
+		 const isc_region_t *wire, unsigned int tag);
+/*%
+ * Store a copy of the message in 'wire' for 'key', replacing any
+ * existing entry for the key.  'tag' is returned by later successful
+ * calls to dns_anscache_find().
+ *
+ * Requires:
+ * \li	'cache' to be a valid answer cache
+ * \li	'key' and 'key->name' to be valid, 'key->name' absolute
+ * \li	'wire' != NULL
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOSPACE		'wire' is larger than #DNS_ANSCACHE_MAXWIRE
+ * \li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_anscache_flush(dns_anscache_t *cache);
+/*%
+ * Remove every entry from the answer cache.
+ *
+ * Requires:
+ * \li	'cache' to be a valid answer cache
+ */
+
+unsigned int
+dns_anscache_count(dns_anscache_t *cache);
+/*%
+ * Return the number of entries currently held in the answer cache.
+ *
+ * Requires:
+ * \li	'cache' to be a valid answer cache
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_ANSCACHE_H */
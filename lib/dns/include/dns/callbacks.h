@@ -39,6 +39,14 @@ struct dns_rdatacallbacks {
 	 */
 	dns_addrdatasetfunc_t add;
 
+	/*%
+	 * If not NULL, dns_master_load*() may call this instead of
+	 * 'add' to commit an array of rdatasets and their owner names
+	 * at once, storing the result for each in the results array.
+	 * It may be called from several threads concurrently.
+	 */
+	dns_addrdatasetsfunc_t addbatch;
+
 	/*%
 	 * This is called when reading in a database image from a 'map'
 	 * format zone file.
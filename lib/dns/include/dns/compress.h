@@ -40,33 +40,48 @@ ISC_LANG_BEGINDECLS
 
 /*
  * DNS_COMPRESS_TABLESIZE must be a power of 2. The compress code
- * utilizes this assumption.
+ * utilizes this assumption.  It is the initial size of the global
+ * compression table, which is grown as names are added so that it
+ * is never more than half full.
  */
 #define DNS_COMPRESS_TABLEBITS 6
 #define DNS_COMPRESS_TABLESIZE (1U << DNS_COMPRESS_TABLEBITS)
 #define DNS_COMPRESS_TABLEMASK (DNS_COMPRESS_TABLESIZE - 1)
-#define DNS_COMPRESS_INITIALNODES 16
+#define DNS_COMPRESS_INITIALNODES (DNS_COMPRESS_TABLESIZE / 2)
+#define DNS_COMPRESS_ARENASIZE 512
 
 typedef struct dns_compressnode dns_compressnode_t;
 
 struct dns_compressnode {
-	dns_compressnode_t	*next;
-	isc_uint16_t		offset;
-	isc_uint16_t		count;
-	isc_region_t            r;
-	dns_name_t              name;
+	isc_uint32_t		hash;		/*%< Case-folded suffix hash. */
+	isc_uint16_t		offset;		/*%< Offset and flags. */
+	isc_uint16_t		length;		/*%< Suffix length. */
+	unsigned char		*ndata;		/*%< Suffix wire data. */
 };
 
 struct dns_compress {
 	unsigned int		magic;		/*%< Magic number. */
 	unsigned int		allowed;	/*%< Allowed methods. */
 	int			edns;		/*%< Edns version or -1. */
-	/*% Global compression table. */
-	dns_compressnode_t	*table[DNS_COMPRESS_TABLESIZE];
-	/*% Preallocated nodes for the table. */
-	dns_compressnode_t	initialnodes[DNS_COMPRESS_INITIALNODES];
+	/*%
+	 * Global compression table: open addressing with linear
+	 * probing, each slot holding a node number plus one, or zero
+	 * if the slot is empty.
+	 */
+	isc_uint16_t		*table;
+	unsigned int		tablesize;	/*%< Number of slots. */
+	/*% Nodes, in the order they were added. */
+	dns_compressnode_t	*nodes;
+	unsigned int		nodessize;	/*%< Allocated nodes. */
 	isc_uint16_t		count;		/*%< Number of nodes. */
 	isc_mem_t		*mctx;		/*%< Memory context. */
+	unsigned int		arenaused;	/*%< Bytes used in arena. */
+	/*% Preallocated table. */
+	isc_uint16_t		initialtable[DNS_COMPRESS_TABLESIZE];
+	/*% Preallocated nodes for the table. */
+	dns_compressnode_t	initialnodes[DNS_COMPRESS_INITIALNODES];
+	/*% Preallocated storage for copies of added names. */
+	unsigned char		arena[DNS_COMPRESS_ARENASIZE];
 };
 
 typedef enum {
@@ -189,6 +189,7 @@ typedef struct dns_dbmethods {
 					dns_name_t *name);
 	isc_result_t	(*getsize)(dns_db_t *db, dns_dbversion_t *version,
 				   isc_uint64_t *records, isc_uint64_t *bytes);
+	size_t		(*hashpending)(dns_db_t *db);
 } dns_dbmethods_t;
 
 typedef isc_result_t
@@ -1399,6 +1400,21 @@ dns_db_hashsize(dns_db_t *db);
  *      0 if not implemented.
  */
 
+size_t
+dns_db_hashpending(dns_db_t *db);
+/*%<
+ * For database implementations whose hash table grows incrementally,
+ * report how much of the rehash in progress is left to do, in buckets.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database.
+ *
+ * Returns:
+ * \li	The number of buckets still to be rehashed, or 0 if no rehash
+ *      is in progress or if not implemented.
+ */
+
 void
 dns_db_settask(dns_db_t *db, isc_task_t *task);
 /*%<
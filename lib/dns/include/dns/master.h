@@ -164,6 +164,19 @@ dns_master_loadfile5(const char *master_file,
 		     dns_masterformat_t format,
 		     dns_ttl_t maxttl);
 
+isc_result_t
+dns_master_loadfile6(const char *master_file,
+		     dns_name_t *top,
+		     dns_name_t *origin,
+		     dns_rdataclass_t zclass,
+		     unsigned int options,
+		     isc_uint32_t resign,
+		     dns_rdatacallbacks_t *callbacks,
+		     dns_masterincludecb_t include_cb,
+		     void *include_arg, isc_mem_t *mctx,
+		     dns_masterformat_t format,
+		     dns_ttl_t maxttl, unsigned int jobs);
+
 isc_result_t
 dns_master_loadstream(FILE *stream,
 		      dns_name_t *top,
@@ -309,6 +322,13 @@ dns_master_loadlexerinc(isc_lex_t *lex,
  * 'resign' the number of seconds before a RRSIG expires that it should
  * be re-signed.  0 is used if not provided.
  *
+ * 'jobs' is the number of threads dns_master_loadfile6() may use to
+ * parse a large text format file.  This is only done if
+ * 'callbacks->addbatch' is set and the file does not use $INCLUDE or
+ * $DATE; errors found when the data is added are then reported
+ * without a line number.  Otherwise, or if 'jobs' is 1, the file is
+ * loaded serially.
+ *
  * Requires:
  *\li	'master_file' points to a valid string.
  *\li	'lexer' points to a valid lexer.
@@ -180,6 +180,10 @@ typedef isc_result_t (*dns_rbtdatafixer_t)(dns_rbtnode_t *rbtnode,
 					   void *base, size_t offset,
 					   void *arg, isc_uint64_t *crc);
 
+typedef void (*dns_rbtdatarebaser_t)(dns_rbtnode_t *rbtnode,
+				     void *base, isc_uint64_t mapbase,
+				     void *arg, isc_uint64_t *crc);
+
 typedef void (*dns_rbtdeleter_t)(void *, void *);
 
 /*****
@@ -684,6 +688,22 @@ dns_rbt_hashsize(dns_rbt_t *rbt);
  * \li  rbt is a valid rbt manager.
  */
 
+size_t
+dns_rbt_hashpending(dns_rbt_t *rbt);
+/*%<
+ * Obtain the amount of work left in the rehash of the 'rbt' hash table
+ * that is in progress, as the number of buckets of the new table still
+ * to be cleared plus the number of buckets of the old table still to
+ * be moved.  When the table grows, its buckets are rehashed a few at a
+ * time as nodes are added, rather than all at once.
+ *
+ * Requires:
+ * \li  rbt is a valid rbt manager.
+ *
+ * Returns:
+ * \li  0 if no rehash is in progress.
+ */
+
 void
 dns_rbt_destroy(dns_rbt_t **rbtp);
 isc_result_t
@@ -746,6 +766,34 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
  *      be a stream.  This condition is not checked in the code.
  */
 
+isc_result_t
+dns_rbt_prelink_tree(void *base_address, size_t filesize,
+		     off_t header_offset, isc_uint64_t mapbase,
+		     isc_mem_t *mctx,
+		     dns_rbtdatafixer_t datafixer, void *fixer_arg,
+		     dns_rbtdatarebaser_t datarebaser, void *rebaser_arg);
+/*%<
+ * Prelink the RBT image written by dns_rbt_serialize_tree() at
+ * 'header_offset' in the writable shared mapping of its file at
+ * 'base_address', for loading at address 'mapbase'.
+ *
+ * The image is first resolved in place as dns_rbt_deserialize_tree()
+ * would, calling 'datafixer' for each node's data; then every pointer is
+ * moved from 'base_address' to 'mapbase', calling 'datarebaser' to do the
+ * same for the data (which it must also add to 'crc').  When such an
+ * image is later mapped at 'mapbase', dns_rbt_deserialize_tree() only
+ * reads it, so its pages stay shared with the page cache.  Mapped
+ * anywhere else, it is relocated like any other image.
+ *
+ * Requires:
+ * \li	'mapbase' is nonzero and page aligned.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_EXISTS if the image is already prelinked.
+ * \li	Any error from dns_rbt_deserialize_tree().
+ */
+
 void
 dns_rbt_printtext(dns_rbt_t *rbt,
 		  void (*data_printer)(FILE *, void *), FILE *f);
@@ -14,7 +14,11 @@
  * Rate limit DNS responses.
  */
 
+#include <stdio.h>
+
 #include <isc/lang.h>
+#include <isc/mutex.h>
+#include <isc/stdtime.h>
 
 #include <dns/fixedname.h>
 #include <dns/rdata.h>
@@ -191,12 +195,62 @@ struct dns_rrl_rate {
 	const char  *str;
 };
 
+/*
+ * One shard of the rate-limit table.  Clients are spread over the shards
+ * by their address prefix, so that every entry for a client (including
+ * its all-per-second and TCP entries) is in the same shard, and each
+ * shard has its own lock, entries, LRU list, time bases and hash table.
+ */
+typedef struct dns_rrl_shard dns_rrl_shard_t;
+struct dns_rrl_shard {
+	isc_mutex_t	lock;
+
+	int		num_entries;
+
+	unsigned int	probes;
+	unsigned int	searches;
+
+	ISC_LIST(dns_rrl_block_t) blocks;
+	ISC_LIST(dns_rrl_entry_t) lru;
+
+	dns_rrl_hash_t	*hash;
+	dns_rrl_hash_t	*old_hash;
+	unsigned int	hash_gen;
+
+	unsigned int	ts_gen;
+# define DNS_RRL_TS_BASES   (1<<DNS_RRL_TS_GEN_BITS)
+	isc_stdtime_t	ts_bases[DNS_RRL_TS_BASES];
+
+	/*
+	 * Rates last scaled by qps-scale in this shard, indexed by
+	 * dns_rrl_rtype_t; 0 until the rate is first scaled.
+	 */
+	int		scaled[DNS_RRL_RTYPE_TCP];
+	int		slip_scaled;
+
+	isc_stdtime_t	log_stops_time;
+	isc_stdtime_t	sweep_time;
+	dns_rrl_entry_t	*last_logged;
+	int		num_logged;
+	int		num_qnames;
+	ISC_LIST(dns_rrl_qname_buf_t) qname_free;
+# define DNS_RRL_QNAMES	    (1<<DNS_RRL_QNAMES_BITS)
+	dns_rrl_qname_buf_t *qnames[DNS_RRL_QNAMES];
+
+	/*
+	 * Statistics.
+	 */
+	isc_uint64_t	responses;
+	isc_uint64_t	dropped;
+	isc_uint64_t	slipped;
+};
+
 /*
  * Per-view query rate limit parameters and a pointer to database.
  */
 typedef struct dns_rrl dns_rrl_t;
 struct dns_rrl {
-	isc_mutex_t	lock;
+	isc_mutex_t	lock;		/* qps estimate and num_entries */
 	isc_mem_t	*mctx;
 
 	isc_boolean_t	log_only;
@@ -213,38 +267,19 @@ struct dns_rrl {
 
 	dns_acl_t	*exempt;
 
-	int		num_entries;
+	int		num_entries;	/* in all shards */
 
 	int		qps_responses;
 	isc_stdtime_t	qps_time;
 	double		qps;
 
-	unsigned int	probes;
-	unsigned int	searches;
-
-	ISC_LIST(dns_rrl_block_t) blocks;
-	ISC_LIST(dns_rrl_entry_t) lru;
-
-	dns_rrl_hash_t	*hash;
-	dns_rrl_hash_t	*old_hash;
-	unsigned int	hash_gen;
-
-	unsigned int	ts_gen;
-# define DNS_RRL_TS_BASES   (1<<DNS_RRL_TS_GEN_BITS)
-	isc_stdtime_t	ts_bases[DNS_RRL_TS_BASES];
+	unsigned int	nshards;
+	dns_rrl_shard_t	*shards;
 
 	int		ipv4_prefixlen;
 	isc_uint32_t	ipv4_mask;
 	int		ipv6_prefixlen;
 	isc_uint32_t	ipv6_mask[4];
-
-	isc_stdtime_t	log_stops_time;
-	dns_rrl_entry_t	*last_logged;
-	int		num_logged;
-	int		num_qnames;
-	ISC_LIST(dns_rrl_qname_buf_t) qname_free;
-# define DNS_RRL_QNAMES	    (1<<DNS_RRL_QNAMES_BITS)
-	dns_rrl_qname_buf_t *qnames[DNS_RRL_QNAMES];
 };
 
 typedef enum {
@@ -265,6 +300,19 @@ dns_rrl_view_destroy(dns_view_t *view);
 
 isc_result_t
 dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries);
+/*%<
+ * Create the rate limiting state for 'view', with room for at least
+ * 'min_entries' entries spread over the shards.  The caller fills in
+ * the parameters.  'max_entries' limits the whole table, not each
+ * shard.
+ */
+
+void
+dns_rrl_dumpstats(dns_rrl_t *rrl, FILE *fp);
+/*%<
+ * Write the response rate limiting statistics of 'rrl', for the whole
+ * table and for each shard, to 'fp'.
+ */
 
 ISC_LANG_ENDDECLS
 
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef DNS_SIGCACHE_H
+#define DNS_SIGCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/sigcache.h
+ * \brief
+ * Defines dns_sigcache_t, the "validated signature cache" object.
+ *
+ * Notes:
+ *\li	A signature cache remembers RRSIGs that have been verified
+ *	successfully, so that verifying the same signature over the
+ *	same RRset with the same DNSKEY again does not repeat the
+ *	public key operation.
+ *
+ *\li	Entries are keyed on a SHA-256 digest of the owner name, the
+ *	RRset, the RRSIG and the DNSKEY, so an entry can only be found
+ *	again when all of them are identical.  Only the cryptographic
+ *	result is cached: the caller still has to find the key through
+ *	the usual chain of trust, and the signature's validity period is
+ *	checked against the current time on every lookup.
+ *
+ *\li	A cache can be shared between views.
+ *
+ * MP:
+ *\li	The cache is split into a number of independently locked
+ *	stripes, each with its own LRU list.
+ *
+ * Reliability:
+ *
+ * Resources:
+ *\li	The number of entries is bounded by the size given to
+ *	dns_sigcache_create(); the least recently used entry in a stripe
+ *	is evicted to make room for a new one.
+ *
+ * Security:
+ *\li	Nothing is cached for signatures that failed to verify, or that
+ *	were only accepted because their validity period was ignored.
+ *
+ * Standards:
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <isc/lang.h>
+#include <isc/sha2.h>
+#include <isc/stdtime.h>
+
+#include <dns/fixedname.h>
+#include <dns/types.h>
+
+#include <dst/dst.h>
+
+ISC_LANG_BEGINDECLS
+
+typedef struct dns_sigcachekey {
+	unsigned char		digest[ISC_SHA256_DIGESTLENGTH];
+	isc_stdtime_t		inception;
+	isc_stdtime_t		expiration;
+	isc_boolean_t		wildcard;	/*%< RRset expanded from 'wild' */
+	dns_fixedname_t		wild;
+} dns_sigcachekey_t;
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_sigcache_create(isc_mem_t *mctx, unsigned int size,
+		    dns_sigcache_t **cachep);
+/*%
+ * Create a signature cache holding at most 'size' entries and store it
+ * in '*cachep'.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	size > 0
+ * \li	cachep != NULL && *cachep == NULL
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_sigcache_attach(dns_sigcache_t *source, dns_sigcache_t **targetp);
+/*%
+ * Attach '*targetp' to 'source'.
+ *
+ * Requires:
+ * \li	'source' to be a valid signature cache
+ * \li	targetp != NULL && *targetp == NULL
+ */
+
+void
+dns_sigcache_detach(dns_sigcache_t **cachep);
+/*%
+ * Detach '*cachep' from its signature cache, freeing the cache when
+ * the last reference goes away.  '*cachep' is set to NULL on return.
+ *
+ * Requires:
+ * \li	'*cachep' to be a valid signature cache
+ */
+
+isc_result_t
+dns_sigcache_makekey(const dns_name_t *name, dns_rdataset_t *rdataset,
+		     dns_rdata_t *sigrdata, dst_key_t *key,
+		     unsigned int maxbits, dns_sigcachekey_t *sckey);
+/*%
+ * Build the cache key for verifying the RRSIG in 'sigrdata' over
+ * 'rdataset' (owned by 'name') with 'key', under the key size limit
+ * 'maxbits' that would be passed to dns_dnssec_verify3().
+ *
+ * Requires:
+ * \li	'name' to be a valid absolute name
+ * \li	'rdataset' to be a valid, associated rdataset
+ * \li	'sigrdata' to be an RRSIG
+ * \li	'key' to be a valid key
+ * \li	sckey != NULL
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	Others if the RRSIG or the key cannot be converted
+ */
+
+isc_result_t
+dns_sigcache_find(dns_sigcache_t *cache, const dns_sigcachekey_t *sckey,
+		  isc_stdtime_t now, dns_name_t *wild);
+/*%
+ * Look up 'sckey'.  A signature that is not valid at 'now' is never
+ * found.  The results match those of dns_dnssec_verify3(): if the
+ * RRset was expanded from a wildcard, DNS_R_FROMWILDCARD is returned
+ * and, if 'wild' is not NULL, the wildcard name is copied to it.
+ *
+ * Requires:
+ * \li	'cache' to be a valid signature cache
+ * \li	'sckey' to have been built by dns_sigcache_makekey()
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#DNS_R_FROMWILDCARD
+ * \li	#ISC_R_NOTFOUND
+ */
+
+isc_result_t
+dns_sigcache_add(dns_sigcache_t *cache, const dns_sigcachekey_t *sckey);
+/*%
+ * Record that the signature described by 'sckey' verified
+ * successfully.
+ *
+ * Requires:
+ * \li	'cache' to be a valid signature cache
+ * \li	'sckey' to have been built by dns_sigcache_makekey()
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_sigcache_flush(dns_sigcache_t *cache);
+/*%
+ * Remove every entry from the signature cache.
+ *
+ * Requires:
+ * \li	'cache' to be a valid signature cache
+ */
+
+unsigned int
+dns_sigcache_count(dns_sigcache_t *cache);
+/*%
+ * Return the number of entries currently held in the signature cache.
+ *
+ * Requires:
+ * \li	'cache' to be a valid signature cache
+ */
+
+unsigned int
+dns_sigcache_getsize(dns_sigcache_t *cache);
+/*%
+ * Return the size the signature cache was created with.
+ *
+ * Requires:
+ * \li	'cache' to be a valid signature cache
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_SIGCACHE_H */
@@ -66,7 +66,11 @@ enum {
 	dns_resstatscounter_zonequota = 41,
 	dns_resstatscounter_serverquota = 42,
 	dns_resstatscounter_nextitem = 43,
-	dns_resstatscounter_max = 44,
+	dns_resstatscounter_bucketpeak = 44,
+	dns_resstatscounter_bucketresize = 45,
+	dns_resstatscounter_sigcachehit = 46,
+	dns_resstatscounter_sigcachemiss = 47,
+	dns_resstatscounter_max = 48,
 
 	/*
 	 * DNSSEC stats.
@@ -222,9 +226,12 @@ dns_generalstats_create(isc_mem_t *mctx, dns_stats_t **statsp, int ncounters);
  */
 
 isc_result_t
-dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
+dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp,
+			  isc_boolean_t sharded);
 /*%<
- * Create a statistics counter structure per rdatatype.
+ * Create a statistics counter structure per rdatatype.  If 'sharded' is true,
+ * the counters are created with ISC_STATSCREATE_SHARDED (see
+ * isc_stats_create2()), for sets that are updated by every query.
  *
  * Requires:
  *\li	'mctx' must be a valid memory context.
@@ -254,9 +261,12 @@ dns_rdatasetstats_create(isc_mem_t *mctx, dns_stats_t **statsp);
  */
 
 isc_result_t
-dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
+dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp,
+		       isc_boolean_t sharded);
 /*%<
- * Create a statistics counter structure per opcode.
+ * Create a statistics counter structure per opcode.  If 'sharded' is true,
+ * the counters are created with ISC_STATSCREATE_SHARDED (see
+ * isc_stats_create2()), for sets that are updated by every query.
  *
  * Requires:
  *\li	'mctx' must be a valid memory context.
@@ -270,9 +280,12 @@ dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
  */
 
 isc_result_t
-dns_rcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
+dns_rcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp,
+		      isc_boolean_t sharded);
 /*%<
- * Create a statistics counter structure per assigned rcode.
+ * Create a statistics counter structure per assigned rcode.  If 'sharded' is true,
+ * the counters are created with ISC_STATSCREATE_SHARDED (see
+ * isc_stats_create2()), for sets that are updated by every query.
  *
  * Requires:
  *\li	'mctx' must be a valid memory context.
@@ -31,6 +31,7 @@ typedef ISC_LIST(dns_adbaddrinfo_t)		dns_adbaddrinfolist_t;
 typedef struct dns_adbentry			dns_adbentry_t;
 typedef struct dns_adbfind			dns_adbfind_t;
 typedef ISC_LIST(dns_adbfind_t)			dns_adbfindlist_t;
+typedef struct dns_anscache			dns_anscache_t;
 typedef struct dns_badcache 			dns_badcache_t;
 typedef struct dns_byaddr			dns_byaddr_t;
 typedef struct dns_catz_zonemodmethods		dns_catz_zonemodmethods_t;
@@ -124,6 +125,7 @@ typedef struct dns_resolver			dns_resolver_t;
 typedef struct dns_sdbimplementation		dns_sdbimplementation_t;
 typedef isc_uint8_t				dns_secalg_t;
 typedef isc_uint8_t				dns_secproto_t;
+typedef struct dns_sigcache			dns_sigcache_t;
 typedef struct dns_signature			dns_signature_t;
 typedef struct dns_ssurule			dns_ssurule_t;
 typedef struct dns_ssutable			dns_ssutable_t;
@@ -392,6 +394,10 @@ typedef void
 typedef isc_result_t
 (*dns_addrdatasetfunc_t)(void *, const dns_name_t *, dns_rdataset_t *);
 
+typedef void
+(*dns_addrdatasetsfunc_t)(void *, unsigned int, const dns_name_t *,
+			  dns_rdataset_t *, isc_result_t *);
+
 typedef isc_result_t
 (*dns_additionaldatafunc_t)(void *, const dns_name_t *, dns_rdatatype_t);
 
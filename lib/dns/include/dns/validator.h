@@ -129,6 +129,7 @@ struct dns_validator {
 	dns_keynode_t *			keynode;
 	dst_key_t *			key;
 	dns_rdata_rrsig_t *		siginfo;
+	isc_result_t			vresult;
 	isc_task_t *			task;
 	isc_taskaction_t		action;
 	void *				arg;
@@ -71,6 +71,8 @@
 #include <dns/types.h>
 #include <dns/zt.h>
 
+#include <dst/dst.h>
+
 ISC_LANG_BEGINDECLS
 
 struct dns_view {
@@ -176,6 +178,9 @@ struct dns_view {
 	dns_dlzdblist_t 		dlz_unsearched;
 	isc_uint32_t			fail_ttl;
 	dns_badcache_t			*failcache;
+	dns_anscache_t			*anscache;
+	dns_sigcache_t			*sigcache;
+	dst_cryptopool_t		*cryptopool;
 
 	/*
 	 * Configurable data for server use only,
@@ -1043,6 +1048,31 @@ dns_view_setresstats(dns_view_t *view, isc_stats_t *stats);
  *	(see dns/stats.h).
  */
 
+void
+dns_view_setsigcache(dns_view_t *view, dns_sigcache_t *sigcache);
+/*%<
+ * Set the cache of verified signatures used by validators in 'view'.
+ * The cache may be shared with other views.
+ *
+ * Requires:
+ * \li	'view' is valid and is not frozen.
+ *
+ *\li	'sigcache' is a valid signature cache (see dns/sigcache.h).
+ */
+
+void
+dns_view_setcryptopool(dns_view_t *view, dst_cryptopool_t *cryptopool);
+/*%<
+ * Set the pool of tasks that validators in 'view' use to verify
+ * signatures.  Without one, signatures are verified on the validator's
+ * own task.
+ *
+ * Requires:
+ * \li	'view' is valid and is not frozen.
+ *
+ *\li	'cryptopool' is a valid crypto pool (see dst/dst.h).
+ */
+
 void
 dns_view_getresstats(dns_view_t *view, isc_stats_t **statsp);
 /*%<
@@ -194,6 +194,25 @@ dns_zone_getserial(dns_zone_t *zone);
  *\li	#DNS_R_NOTLOADED	zone DB is not loaded
  */
 
+isc_result_t
+dns_zone_getgeneration(dns_zone_t *zone, isc_uint32_t *generationp);
+/*%<
+ *	Get the zone's generation number.  The generation changes
+ *	whenever a database is attached to or detached from the zone
+ *	and whenever a new version of the zone's database is committed,
+ *	so two equal values bracket a period in which the zone's data
+ *	did not change.  The starting value is random.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'generationp' to be non NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND	commits to the zone's database are not being
+ *			followed, so the generation cannot be relied on.
+ */
+
 void
 dns_zone_settype(dns_zone_t *zone, dns_zonetype_t type);
 /*%<
@@ -345,6 +364,28 @@ dns_zone_getmaxttl(dns_zone_t *zone);
  *\li	dns_ttl_t maxttl.
  */
 
+void
+dns_zone_setloadjobs(dns_zone_t *zone, unsigned int jobs);
+/*%<
+ * 	Sets the number of threads that may be used to parse the zone's
+ * 	master file when it is in text format.  The default is 1.  With
+ * 	more than one, a zone managed by a zone manager loads its file
+ * 	in a single event on its load task instead of incrementally.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ *\li	'jobs' > 0.
+ */
+
+unsigned int
+dns_zone_getloadjobs(dns_zone_t *zone);
+/*%<
+ * 	Gets the number of threads used to load the zone's master file.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
 isc_result_t
 dns_zone_load(dns_zone_t *zone);
 
@@ -2121,6 +2162,38 @@ dns_zone_getsignatures(dns_zone_t *zone);
  * Get the number of signatures that will be generated per quantum.
  */
 
+void
+dns_zone_setsignjobs(dns_zone_t *zone, unsigned int jobs);
+/*%<
+ * Set the number of threads that generate signatures when the zone is
+ * signed or re-signed incrementally.  Each thread gets the number of
+ * nodes and signatures set by dns_zone_setnodes() and
+ * dns_zone_setsignatures() per quantum.  The default is 1.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ *\li	'jobs' > 0.
+ */
+
+unsigned int
+dns_zone_getsignjobs(dns_zone_t *zone);
+/*%<
+ * Get the number of threads that generate signatures.
+ */
+
+void
+dns_zone_getsigningstats(dns_zone_t *zone, isc_uint64_t *signaturesp,
+			 isc_uint64_t *usecsp);
+/*%<
+ * Get the number of signatures generated by incremental signing and
+ * re-signing of the zone so far, and the time spent doing so in
+ * microseconds.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ *\li	'signaturesp' and 'usecsp' are not NULL.
+ */
+
 isc_result_t
 dns_zone_signwithkey(dns_zone_t *zone, dns_secalg_t algorithm,
 		     isc_uint16_t keyid, isc_boolean_t deleteit);
@@ -37,6 +37,12 @@ ISC_LANG_BEGINDECLS
 
 typedef struct dst_key		dst_key_t;
 typedef struct dst_context 	dst_context_t;
+typedef struct dst_cryptopool	dst_cryptopool_t;
+
+/*%
+ * Work function run by a crypto pool task; see dst_cryptopool_submit().
+ */
+typedef void (*dst_cryptowork_t)(isc_event_t *event);
 
 /* DST algorithm codes */
 #define DST_ALG_UNKNOWN		0
@@ -985,6 +991,70 @@ dst_key_setexternal(dst_key_t *key, isc_boolean_t value);
 isc_boolean_t
 dst_key_isexternal(dst_key_t *key);
 
+isc_result_t
+dst_cryptopool_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
+		      unsigned int ntasks, dst_cryptopool_t **poolp);
+/*%<
+ * Create a pool of 'ntasks' tasks which run expensive public key
+ * operations away from the tasks that need them.
+ *
+ * Requires:
+ * \li	'mctx' is a valid memory context.
+ * \li	'taskmgr' is a valid task manager.
+ * \li	ntasks > 0
+ * \li	poolp != NULL && *poolp == NULL
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	ISC_R_NOMEMORY
+ * \li	others if the tasks could not be created.
+ */
+
+void
+dst_cryptopool_attach(dst_cryptopool_t *source, dst_cryptopool_t **targetp);
+/*%<
+ * Attach '*targetp' to 'source'.
+ *
+ * Requires:
+ * \li	'source' is a valid crypto pool.
+ * \li	targetp != NULL && *targetp == NULL
+ */
+
+void
+dst_cryptopool_detach(dst_cryptopool_t **poolp);
+/*%<
+ * Detach from a crypto pool.  The pool's tasks are detached when the
+ * last reference goes away; jobs already queued still run.
+ *
+ * Requires:
+ * \li	'*poolp' is a valid crypto pool.
+ */
+
+isc_result_t
+dst_cryptopool_submit(dst_cryptopool_t *pool, dst_cryptowork_t work,
+		      isc_task_t *task, isc_event_t **eventp);
+/*%<
+ * Queue a job that calls 'work' with '*eventp' on one of the pool's
+ * tasks, and then sends '*eventp' to 'task'.  'work' must not use
+ * anything that 'task' may change while the job is queued.
+ *
+ * Jobs are handed to the pool's tasks in turn, so they may run in any
+ * order and concurrently with one another, even for the same key.
+ *
+ * Requires:
+ * \li	'pool' is a valid crypto pool.
+ * \li	'work' != NULL
+ * \li	'task' is a valid task.
+ * \li	eventp != NULL && *eventp != NULL
+ *
+ * Ensures:
+ * \li	On success, *eventp is NULL.
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	ISC_R_NOMEMORY
+ */
+
 ISC_LANG_ENDDECLS
 
 #endif /* DST_DST_H */
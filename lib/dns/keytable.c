@@ -82,7 +82,12 @@ dns_keytable_create(isc_mem_t *mctx, dns_keytable_t **keytablep) {
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_rbt;
 
-	result = isc_rwlock_init(&keytable->rwlock, 0, 0);
+	/*
+	 * The validator searches the key table far more often than
+	 * trust anchors change.
+	 */
+	result = isc_rwlock_initx(&keytable->rwlock, 0, 0, mctx,
+				  ISC_RWLOCK_BIGREADER);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_lock;
 
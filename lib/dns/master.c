@@ -13,15 +13,18 @@
 #include <config.h>
 
 #include <isc/event.h>
+#include <isc/file.h>
 #include <isc/lex.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/serial.h>
 #include <isc/stdio.h>
 #include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #include <dns/callbacks.h>
@@ -40,6 +43,16 @@
 #include <dns/time.h>
 #include <dns/ttl.h>
 
+#ifdef ISC_PLATFORM_USETHREADS
+#ifndef WIN32
+#include <sys/mman.h>
+#else
+#define PROT_READ	0x01
+#define MAP_PRIVATE	0x0002
+#define MAP_FAILED	((void *)-1)
+#endif
+#endif
+
 /*!
  * Grow the number of dns_rdatalist_t (#RDLSZ) and dns_rdata_t (#RDSZ) structures
  * by these sizes when we need to.
@@ -2558,6 +2571,675 @@ load_raw(dns_loadctx_t *lctx) {
 	return (result);
 }
 
+#ifdef ISC_PLATFORM_USETHREADS
+/*
+ * Parallel loading of large text format master files.
+ *
+ * The file is mapped into memory and scanned once for lines that
+ * start a new owner name outside of parentheses and quoted strings.
+ * It is split at some of these lines into chunks, each of which
+ * records the origin, default TTL and line number in effect where it
+ * starts.  The chunks are then parsed by load_text() on several
+ * threads, and the rdatasets each thread produces are passed to
+ * callbacks->addbatch() a batch at a time.
+ *
+ * If the scan finds anything it does not fully understand ($INCLUDE,
+ * $DATE, unbalanced parentheses or quotes, no final newline, ...)
+ * the file is loaded serially instead, so that any errors are reported
+ * exactly as before.
+ */
+
+/*% Files smaller than this are always loaded serially. */
+#define PARLOAD_MINSIZE		(1024 * 1024)
+/*% Chunks per thread, to even out the work. */
+#define PARLOAD_CHUNKSPERJOB	4
+/*% Largest chunk size aimed for. */
+#define PARLOAD_MAXCHUNK	(256 * 1024 * 1024)
+/*% Size limits of a batch passed to callbacks->addbatch(). */
+#define PARLOAD_BATCH		64
+#define PARLOAD_BATCHRDATA	1024
+#define PARLOAD_BATCHDATA	(64 * 1024)
+
+#define PARLOAD_ISSPACE(c) \
+	((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+#define PARLOAD_ISDELIM(c) \
+	(PARLOAD_ISSPACE(c) || (c) == ';' || (c) == '(' || (c) == ')' || \
+	 (c) == '"')
+
+typedef struct {
+	const unsigned char	*base;
+	size_t			length;
+	unsigned long		line;
+	dns_fixedname_t		origin;
+	isc_uint32_t		default_ttl;
+	isc_result_t		result;
+} parchunk_t;
+
+typedef struct {
+	const char		*master_file;
+	dns_name_t		*top;
+	dns_rdataclass_t	zclass;
+	unsigned int		options;
+	isc_uint32_t		resign;
+	dns_rdatacallbacks_t	*callbacks;
+	isc_mem_t		*mctx;
+	dns_ttl_t		maxttl;
+	parchunk_t		*chunks;
+	unsigned int		nchunks;
+	unsigned int		maxchunks;
+	isc_mutex_t		lock;
+	/* Locked by lock. */
+	unsigned int		next;
+	isc_boolean_t		failed;
+} parload_t;
+
+typedef struct {
+	parload_t		*parload;
+	dns_rdatacallbacks_t	callbacks;
+	isc_result_t		result;
+	isc_thread_t		thread;
+	/* The pending batch. */
+	unsigned int		count;
+	unsigned int		nrdata;
+	unsigned int		used;
+	dns_name_t		names[PARLOAD_BATCH];
+	unsigned char		namedata[PARLOAD_BATCH][DNS_NAME_MAXWIRE];
+	dns_rdatalist_t		rdatalists[PARLOAD_BATCH];
+	dns_rdataset_t		rdatasets[PARLOAD_BATCH];
+	isc_result_t		results[PARLOAD_BATCH];
+	dns_rdata_t		rdata[PARLOAD_BATCHRDATA];
+	unsigned char		data[PARLOAD_BATCHDATA];
+} parworker_t;
+
+/*
+ * Skip to the start of the next line outside of any parentheses.
+ */
+static isc_result_t
+parload_skipline(const unsigned char **pp, const unsigned char *end,
+		 unsigned long *linep)
+{
+	const unsigned char *p = *pp;
+	unsigned int depth = 0;
+
+	while (p < end) {
+		switch (*p++) {
+		case '\\':
+			if (p < end && *p++ == '\n')
+				(*linep)++;
+			break;
+		case '"':
+			while (p < end && *p != '"' && *p != '\n') {
+				if (*p == '\\' && p + 1 < end) {
+					if (p[1] == '\n')
+						(*linep)++;
+					p++;
+				}
+				p++;
+			}
+			if (p == end || *p == '\n')
+				return (ISC_R_NOTIMPLEMENTED);
+			p++;
+			break;
+		case ';':
+			while (p < end && *p != '\n')
+				p++;
+			break;
+		case '(':
+			depth++;
+			break;
+		case ')':
+			if (depth == 0)
+				return (ISC_R_NOTIMPLEMENTED);
+			depth--;
+			break;
+		case '\n':
+			(*linep)++;
+			if (depth == 0) {
+				*pp = p;
+				return (ISC_R_SUCCESS);
+			}
+			break;
+		}
+	}
+
+	/* Unbalanced parentheses or no final newline. */
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+/*
+ * Find the next token on the current line.
+ */
+static isc_result_t
+parload_token(const unsigned char **pp, const unsigned char *end,
+	      isc_textregion_t *r)
+{
+	const unsigned char *p = *pp;
+	const unsigned char *start;
+
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	start = p;
+	while (p < end && !PARLOAD_ISDELIM(*p)) {
+		if (*p == '\\' && p + 1 < end)
+			p++;
+		p++;
+	}
+	if (p == start || (p < end && !PARLOAD_ISSPACE(*p) && *p != ';'))
+		return (ISC_R_NOTIMPLEMENTED);
+
+	DE_CONST(start, r->base);
+	r->length = (unsigned int)(p - start);
+	*pp = p;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Track the $ORIGIN and $TTL directives.  Any others that change the
+ * state load_text() carries from line to line are not supported.
+ */
+static isc_result_t
+parload_directive(const unsigned char **pp, const unsigned char *end,
+		  dns_name_t *origin, isc_uint32_t *ttlp,
+		  isc_boolean_t *ttl_knownp)
+{
+	isc_textregion_t directive, arg;
+	dns_fixedname_t fixed;
+	isc_buffer_t buffer;
+	isc_result_t result;
+
+	result = parload_token(pp, end, &directive);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+#define DIRECTIVE(s) \
+	(directive.length == sizeof(s) - 1 && \
+	 strncasecmp(directive.base, s, sizeof(s) - 1) == 0)
+
+	if (DIRECTIVE("$GENERATE"))
+		return (ISC_R_SUCCESS);
+	if (!DIRECTIVE("$ORIGIN") && !DIRECTIVE("$TTL"))
+		return (ISC_R_NOTIMPLEMENTED);
+
+	result = parload_token(pp, end, &arg);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	if (DIRECTIVE("$TTL")) {
+		result = dns_ttl_fromtext(&arg, ttlp);
+		if (result != ISC_R_SUCCESS)
+			return (ISC_R_NOTIMPLEMENTED);
+		if (*ttlp > 0x7fffffffUL)
+			*ttlp = 0;
+		*ttl_knownp = ISC_TRUE;
+		return (ISC_R_SUCCESS);
+	}
+
+#undef DIRECTIVE
+
+	dns_fixedname_init(&fixed);
+	isc_buffer_init(&buffer, arg.base, arg.length);
+	isc_buffer_add(&buffer, arg.length);
+	result = dns_name_fromtext(dns_fixedname_name(&fixed), &buffer,
+				   origin, 0, NULL);
+	if (result != ISC_R_SUCCESS)
+		return (ISC_R_NOTIMPLEMENTED);
+	return (dns_name_copy(dns_fixedname_name(&fixed), origin, NULL));
+}
+
+static void
+parload_addchunk(parload_t *parload, const unsigned char *base,
+		 unsigned long line, dns_name_t *origin, isc_uint32_t ttl)
+{
+	parchunk_t *chunk;
+
+	INSIST(parload->nchunks < parload->maxchunks);
+	chunk = &parload->chunks[parload->nchunks++];
+	chunk->base = base;
+	chunk->length = 0;
+	chunk->line = line;
+	dns_fixedname_init(&chunk->origin);
+	RUNTIME_CHECK(dns_name_copy(origin, dns_fixedname_name(&chunk->origin),
+				    NULL) == ISC_R_SUCCESS);
+	chunk->default_ttl = ttl;
+	chunk->result = ISC_R_SUCCESS;
+}
+
+/*
+ * Split the file into chunks of at least 'target' bytes.  A new chunk
+ * is only started at a line whose owner name differs from that of the
+ * line before, and only once the default TTL is known, as these are
+ * the only things other than the origin that load_text() carries
+ * over from one record to the next.
+ */
+static isc_result_t
+parload_split(parload_t *parload, const unsigned char *base, size_t size,
+	      dns_name_t *origin, size_t target)
+{
+	const unsigned char *p = base, *end = base + size, *next;
+	const unsigned char *owner = NULL, *q;
+	size_t ownerlen = 0;
+	unsigned long line = 1;
+	isc_boolean_t ttl_known;
+	isc_uint32_t ttl = 0;
+	dns_fixedname_t fixed;
+	dns_name_t *current;
+	isc_result_t result;
+	unsigned int i;
+
+	ttl_known = ISC_TF((parload->options & DNS_MASTER_NOTTL) != 0);
+	dns_fixedname_init(&fixed);
+	current = dns_fixedname_name(&fixed);
+	RUNTIME_CHECK(dns_name_copy(origin, current, NULL) == ISC_R_SUCCESS);
+
+	parload_addchunk(parload, base, line, current, ttl);
+	next = base + target;
+
+	while (p < end) {
+		if (*p == '$') {
+			result = parload_directive(&p, end, current,
+						   &ttl, &ttl_known);
+			if (result != ISC_R_SUCCESS)
+				return (result);
+		} else if (!PARLOAD_ISDELIM(*p)) {
+			q = p;
+			while (q < end && !PARLOAD_ISDELIM(*q)) {
+				if (*q == '\\' && q + 1 < end)
+					q++;
+				q++;
+			}
+			if (p >= next && ttl_known &&
+			    ((size_t)(q - p) != ownerlen ||
+			     strncasecmp((const char *)p, (const char *)owner,
+					 ownerlen) != 0))
+			{
+				parload_addchunk(parload, p, line, current,
+						 ttl);
+				next = p + target;
+			}
+			owner = p;
+			ownerlen = q - p;
+		}
+		result = parload_skipline(&p, end, &line);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+
+	for (i = 0; i < parload->nchunks; i++) {
+		if (i + 1 < parload->nchunks)
+			end = parload->chunks[i + 1].base;
+		else
+			end = base + size;
+		parload->chunks[i].length = end - parload->chunks[i].base;
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+parload_error(parworker_t *worker, const dns_name_t *owner,
+	      isc_result_t result)
+{
+	dns_rdatacallbacks_t *callbacks = worker->parload->callbacks;
+	char namebuf[DNS_NAME_FORMATSIZE];
+
+	if (result == ISC_R_NOMEMORY) {
+		(*callbacks->error)(callbacks, "dns_master_load: %s",
+				    dns_result_totext(result));
+	} else {
+		dns_name_format(owner, namebuf, sizeof(namebuf));
+		(*callbacks->error)(callbacks, "%s: %s: %s: %s",
+				    "dns_master_load",
+				    worker->parload->master_file,
+				    namebuf, dns_result_totext(result));
+	}
+	if (worker->result == ISC_R_SUCCESS)
+		worker->result = result;
+}
+
+static void
+parload_flush(parworker_t *worker) {
+	dns_rdatacallbacks_t *callbacks = worker->parload->callbacks;
+	unsigned int i;
+
+	if (worker->count == 0)
+		return;
+
+	(*callbacks->addbatch)(callbacks->add_private, worker->count,
+			       worker->names, worker->rdatasets,
+			       worker->results);
+	for (i = 0; i < worker->count; i++) {
+		if (worker->results[i] != ISC_R_SUCCESS)
+			parload_error(worker, &worker->names[i],
+				      worker->results[i]);
+		dns_rdataset_disassociate(&worker->rdatasets[i]);
+	}
+	worker->count = 0;
+	worker->nrdata = 0;
+	worker->used = 0;
+}
+
+/*
+ * The 'add' callback used by load_text() for a chunk: copy the rdataset
+ * into the pending batch, as load_text() reuses its buffers once this
+ * returns.  Errors are reported when the batch is flushed, so they
+ * carry no line number.
+ */
+static isc_result_t
+parload_add(void *arg, const dns_name_t *owner, dns_rdataset_t *rdataset) {
+	parworker_t *worker = arg;
+	dns_rdatacallbacks_t *callbacks = worker->parload->callbacks;
+	dns_rdatalist_t *rdatalist;
+	dns_rdataset_t *dataset;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_t *copy;
+	unsigned int count = 0, length = 0;
+	isc_buffer_t buffer;
+	isc_region_t r;
+	isc_result_t result;
+
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdataset_current(rdataset, &rdata);
+		count++;
+		length += rdata.length;
+		dns_rdata_reset(&rdata);
+	}
+
+	if (count > PARLOAD_BATCHRDATA || length > PARLOAD_BATCHDATA) {
+		/*
+		 * Too large to copy; add it on its own.
+		 */
+		parload_flush(worker);
+		(*callbacks->addbatch)(callbacks->add_private, 1, owner,
+				       rdataset, &result);
+		if (result != ISC_R_SUCCESS)
+			parload_error(worker, owner, result);
+		return (ISC_R_SUCCESS);
+	}
+
+	if (worker->count == PARLOAD_BATCH ||
+	    worker->nrdata + count > PARLOAD_BATCHRDATA ||
+	    worker->used + length > PARLOAD_BATCHDATA)
+		parload_flush(worker);
+
+	isc_buffer_init(&buffer, worker->namedata[worker->count],
+			sizeof(worker->namedata[worker->count]));
+	dns_name_init(&worker->names[worker->count], NULL);
+	RUNTIME_CHECK(dns_name_copy(owner, &worker->names[worker->count],
+				    &buffer) == ISC_R_SUCCESS);
+
+	rdatalist = &worker->rdatalists[worker->count];
+	dns_rdatalist_init(rdatalist);
+	rdatalist->rdclass = rdataset->rdclass;
+	rdatalist->type = rdataset->type;
+	rdatalist->covers = rdataset->covers;
+	rdatalist->ttl = rdataset->ttl;
+
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdataset_current(rdataset, &rdata);
+		r.base = worker->data + worker->used;
+		r.length = rdata.length;
+		memmove(r.base, rdata.data, rdata.length);
+		worker->used += rdata.length;
+		copy = &worker->rdata[worker->nrdata++];
+		dns_rdata_init(copy);
+		dns_rdata_fromregion(copy, rdata.rdclass, rdata.type, &r);
+		copy->flags = rdata.flags;
+		ISC_LIST_APPEND(rdatalist->rdata, copy, link);
+		dns_rdata_reset(&rdata);
+	}
+
+	dataset = &worker->rdatasets[worker->count];
+	dns_rdataset_init(dataset);
+	RUNTIME_CHECK(dns_rdatalist_tordataset(rdatalist, dataset)
+		      == ISC_R_SUCCESS);
+	dataset->trust = rdataset->trust;
+	dataset->attributes |= rdataset->attributes & DNS_RDATASETATTR_RESIGN;
+	dataset->resign = rdataset->resign;
+	worker->count++;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+parload_chunk(parworker_t *worker, parchunk_t *chunk, isc_boolean_t first) {
+	parload_t *parload = worker->parload;
+	dns_loadctx_t *lctx = NULL;
+	isc_buffer_t buffer;
+	isc_result_t result;
+
+	worker->result = ISC_R_SUCCESS;
+
+	result = loadctx_create(dns_masterformat_text, parload->mctx,
+				parload->options, parload->resign,
+				parload->top, parload->zclass,
+				dns_fixedname_name(&chunk->origin),
+				&worker->callbacks, NULL, NULL, NULL,
+				NULL, NULL, NULL, &lctx);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	lctx->maxttl = parload->maxttl;
+	if (!first) {
+		lctx->ttl = lctx->default_ttl = chunk->default_ttl;
+		lctx->ttl_known = lctx->default_ttl_known = ISC_TRUE;
+	}
+
+	isc_buffer_constinit(&buffer, chunk->base, chunk->length);
+	isc_buffer_add(&buffer, (unsigned int)chunk->length);
+	result = isc_lex_openbuffer(lctx->lex, &buffer);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	result = isc_lex_setsourcename(lctx->lex, parload->master_file);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	RUNTIME_CHECK(isc_lex_setsourceline(lctx->lex, chunk->line)
+		      == ISC_R_SUCCESS);
+
+	result = load_text(lctx);
+	INSIST(result != DNS_R_CONTINUE);
+
+ cleanup:
+	dns_loadctx_detach(&lctx);
+	parload_flush(worker);
+	if (result == ISC_R_SUCCESS)
+		result = worker->result;
+	return (result);
+}
+
+static isc_threadresult_t
+#ifdef _WIN32
+WINAPI
+#endif
+parload_run(isc_threadarg_t arg) {
+	parworker_t *worker = arg;
+	parload_t *parload = worker->parload;
+	isc_result_t result;
+	unsigned int i;
+
+	for (;;) {
+		LOCK(&parload->lock);
+		if (parload->failed || parload->next == parload->nchunks) {
+			UNLOCK(&parload->lock);
+			break;
+		}
+		i = parload->next++;
+		UNLOCK(&parload->lock);
+
+		result = parload_chunk(worker, &parload->chunks[i],
+				       ISC_TF(i == 0));
+		parload->chunks[i].result = result;
+		if (result != ISC_R_SUCCESS &&
+		    (parload->options & DNS_MASTER_MANYERRORS) == 0)
+		{
+			LOCK(&parload->lock);
+			parload->failed = ISC_TRUE;
+			UNLOCK(&parload->lock);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+/*
+ * Load 'master_file' using up to 'jobs' threads.  If this is not
+ * possible '*serialp' is set and nothing has been added to the
+ * database; the caller should then load the file serially, which will
+ * also report any error.
+ */
+static isc_result_t
+parload_file(const char *master_file, dns_name_t *top, dns_name_t *origin,
+	     dns_rdataclass_t zclass, unsigned int options,
+	     isc_uint32_t resign, dns_rdatacallbacks_t *callbacks,
+	     isc_mem_t *mctx, dns_ttl_t maxttl, unsigned int jobs,
+	     isc_boolean_t *serialp)
+{
+	parload_t parload;
+	parworker_t **workers = NULL;
+	unsigned int i, nworkers = 0, nthreads = 0;
+	FILE *f = NULL;
+	off_t filesize;
+	size_t size, target;
+	void *base = NULL;
+	int flags;
+	isc_result_t result;
+
+	*serialp = ISC_TRUE;
+
+	memset(&parload, 0, sizeof(parload));
+	parload.master_file = master_file;
+	parload.top = top;
+	parload.zclass = zclass;
+	parload.options = options;
+	parload.resign = resign;
+	parload.callbacks = callbacks;
+	parload.mctx = mctx;
+	parload.maxttl = maxttl;
+
+	result = isc_stdio_open(master_file, "rb", &f);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = isc_file_getsizefd(fileno(f), &filesize);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	size = (size_t)filesize;
+	if (filesize < PARLOAD_MINSIZE || (off_t)size != filesize) {
+		result = ISC_R_NOTIMPLEMENTED;
+		goto cleanup;
+	}
+
+	flags = MAP_PRIVATE;
+#ifdef MAP_FILE
+	flags |= MAP_FILE;
+#endif
+	base = isc_file_mmap(NULL, size, PROT_READ, flags, fileno(f), 0);
+	if (base == NULL || base == MAP_FAILED) {
+		base = NULL;
+		result = ISC_R_NOTIMPLEMENTED;
+		goto cleanup;
+	}
+
+	target = size / (jobs * PARLOAD_CHUNKSPERJOB);
+	if (target > PARLOAD_MAXCHUNK)
+		target = PARLOAD_MAXCHUNK;
+	parload.maxchunks = (unsigned int)(size / target) + 1;
+	parload.chunks = isc_mem_get(mctx, parload.maxchunks *
+					   sizeof(parload.chunks[0]));
+	if (parload.chunks == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+
+	result = parload_split(&parload, base, size, origin, target);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	if (parload.nchunks < 2) {
+		result = ISC_R_NOTIMPLEMENTED;
+		goto cleanup;
+	}
+
+	result = isc_mutex_init(&parload.lock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	if (jobs > parload.nchunks)
+		jobs = parload.nchunks;
+	workers = isc_mem_get(mctx, jobs * sizeof(workers[0]));
+	if (workers == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_lock;
+	}
+	for (nworkers = 0; nworkers < jobs; nworkers++) {
+		parworker_t *worker;
+
+		worker = isc_mem_get(mctx, sizeof(*worker));
+		if (worker == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup_workers;
+		}
+		worker->parload = &parload;
+		worker->callbacks = *callbacks;
+		worker->callbacks.add = parload_add;
+		worker->callbacks.addbatch = NULL;
+		worker->callbacks.add_private = worker;
+		worker->result = ISC_R_SUCCESS;
+		worker->count = 0;
+		worker->nrdata = 0;
+		worker->used = 0;
+		workers[nworkers] = worker;
+	}
+
+	*serialp = ISC_FALSE;
+
+	/*
+	 * This thread does its share of the work too.  If a thread
+	 * cannot be created the others just get more of it.
+	 */
+	for (i = 1; i < nworkers; i++) {
+		if (isc_thread_create(parload_run, workers[i],
+				      &workers[i]->thread) != ISC_R_SUCCESS)
+			break;
+		nthreads = i;
+	}
+	(void)parload_run(workers[0]);
+	for (i = 1; i <= nthreads; i++)
+		RUNTIME_CHECK(isc_thread_join(workers[i]->thread, NULL)
+			      == ISC_R_SUCCESS);
+
+	/*
+	 * Report the error from the earliest chunk, as a serial load
+	 * would have.
+	 */
+	result = ISC_R_SUCCESS;
+	for (i = 0; i < parload.nchunks; i++) {
+		if (parload.chunks[i].result != ISC_R_SUCCESS) {
+			result = parload.chunks[i].result;
+			break;
+		}
+	}
+
+ cleanup_workers:
+	for (i = 0; i < nworkers; i++)
+		isc_mem_put(mctx, workers[i], sizeof(*workers[i]));
+	isc_mem_put(mctx, workers, jobs * sizeof(workers[0]));
+ cleanup_lock:
+	DESTROYLOCK(&parload.lock);
+ cleanup:
+	if (parload.chunks != NULL)
+		isc_mem_put(mctx, parload.chunks,
+			    parload.maxchunks * sizeof(parload.chunks[0]));
+	if (base != NULL)
+		(void)isc_file_munmap(base, size);
+	(void)isc_stdio_close(f);
+	return (result);
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
 isc_result_t
 dns_master_loadfile(const char *master_file, dns_name_t *top,
 		    dns_name_t *origin,
@@ -2615,10 +3297,41 @@ dns_master_loadfile5(const char *master_file, dns_name_t *top,
 		     dns_masterincludecb_t include_cb, void *include_arg,
 		     isc_mem_t *mctx, dns_masterformat_t format,
 		     dns_ttl_t maxttl)
+{
+	return (dns_master_loadfile6(master_file, top, origin, zclass,
+				     options, resign, callbacks,
+				     include_cb, include_arg,
+				     mctx, format, maxttl, 1));
+}
+
+isc_result_t
+dns_master_loadfile6(const char *master_file, dns_name_t *top,
+		     dns_name_t *origin, dns_rdataclass_t zclass,
+		     unsigned int options, isc_uint32_t resign,
+		     dns_rdatacallbacks_t *callbacks,
+		     dns_masterincludecb_t include_cb, void *include_arg,
+		     isc_mem_t *mctx, dns_masterformat_t format,
+		     dns_ttl_t maxttl, unsigned int jobs)
 {
 	dns_loadctx_t *lctx = NULL;
 	isc_result_t result;
 
+#ifdef ISC_PLATFORM_USETHREADS
+	if (jobs > 1 && format == dns_masterformat_text &&
+	    callbacks->addbatch != NULL)
+	{
+		isc_boolean_t serial;
+
+		result = parload_file(master_file, top, origin, zclass,
+				      options, resign, callbacks, mctx,
+				      maxttl, jobs, &serial);
+		if (!serial)
+			return (result);
+	}
+#else
+	UNUSED(jobs);
+#endif
+
 	result = loadctx_create(format, mctx, options, resign, top, zclass,
 				origin, callbacks, NULL, NULL, NULL,
 				include_cb, include_arg, NULL, &lctx);
@@ -19,10 +19,12 @@
 
 #include <isc/crc64.h>
 #include <isc/file.h>
+#include <isc/hash.h>
 #include <isc/hex.h>
 #include <isc/mem.h>
 #include <isc/platform.h>
 #include <isc/print.h>
+#include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/socket.h>
 #include <isc/stdio.h>
@@ -68,6 +70,18 @@
 #define RBT_HASH_SIZE 2 /*%< To give the reallocation code a workout. */
 #endif
 
+/*%
+ * When the hash table grows, the new table is cleared and the nodes
+ * are moved into it from the old one a little at a time, on each
+ * insertion, rather than all at once: each step clears up to
+ * RBT_REHASH_CLEAR buckets of the new table and, once that is done,
+ * moves the nodes of up to RBT_REHASH_MOVE buckets of the old one.
+ * Both are far more than needed for a rehash to finish before the
+ * table next has to grow.
+ */
+#define RBT_REHASH_CLEAR        1024
+#define RBT_REHASH_MOVE         16
+
 struct dns_rbt {
 	unsigned int		magic;
 	isc_mem_t *		mctx;
@@ -77,7 +91,19 @@ struct dns_rbt {
 	unsigned int		nodecount;
 	size_t			hashsize;
 	dns_rbtnode_t **	hashtable;
+	isc_uint32_t		hashseed;
 	void *			mmap_location;
+	/*
+	 * While a rehash is in progress, 'oldhashtable' is the table
+	 * being replaced.  The first 'hashcleared' buckets of
+	 * 'hashtable' have been cleared, and the nodes of the first
+	 * 'hashmoved' buckets of 'oldhashtable' have been moved to
+	 * 'hashtable'; the others are still in 'oldhashtable'.
+	 */
+	size_t			oldhashsize;
+	dns_rbtnode_t **	oldhashtable;
+	size_t			hashcleared;
+	size_t			hashmoved;
 };
 
 #define RED 0
@@ -109,6 +135,8 @@ struct file_header {
 	unsigned int rdataset_fixed:1;	/* compiled with --enable-rrset-fixed */
 	unsigned int nodecount;		/* shadow from rbt structure */
 	isc_uint64_t crc;
+	isc_uint32_t hashseed;		/* shadow from rbt structure */
+	isc_uint64_t mapbase;		/* nonzero if prelinked */
 	char version2[32];  		/* repeated; must match version1 */
 };
 
@@ -127,6 +155,11 @@ struct file_header {
  * The RBTDB object will do this three times, once for each of the three
  * RBT objects it contains.
  *
+ * Optionally, dns_rbt_prelink_tree() then resolves every pointer in the
+ * image for a preferred load address, recorded as 'mapbase' in the
+ * header.  An image that gets mapped at that address loads without
+ * writing to a single page of it.
+ *
  * Note: 'file' must point an actual open file that can be mmapped
  * and fseeked, not to a pipe or stream
  */
@@ -355,7 +388,8 @@ fixup_uppernodes_helper(dns_rbtnode_t *node, dns_rbtnode_t *uppernode) {
 	if (node == NULL)
 		return;
 
-	UPPERNODE(node) = uppernode;
+	if (UPPERNODE(node) != uppernode)
+		UPPERNODE(node) = uppernode;
 
 	fixup_uppernodes_helper(LEFT(node), uppernode);
 	fixup_uppernodes_helper(RIGHT(node), uppernode);
@@ -421,16 +455,29 @@ static isc_result_t
 create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep);
 
 #ifdef DNS_RBT_USEHASH
+static inline unsigned int
+hash_fullname(dns_rbt_t *rbt, const dns_name_t *name);
+static inline dns_rbtnode_t **
+hash_bucket(dns_rbt_t *rbt, unsigned int hashval);
 static inline void
 hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, const dns_name_t *name);
 static inline void
+hash_mapped_node(dns_rbt_t *rbt, dns_rbtnode_t *node,
+		 const dns_name_t *name);
+static inline void
 unhash_node(dns_rbt_t *rbt, dns_rbtnode_t *node);
 static void
 rehash(dns_rbt_t *rbt, unsigned int newcount);
+static void
+rehash_step(dns_rbt_t *rbt, size_t clear, size_t move);
+static void
+rehash_finish(dns_rbt_t *rbt);
 #else
 #define hash_node(rbt, node, name)
+#define hash_mapped_node(rbt, node, name)
 #define unhash_node(rbt, node)
 #define rehash(rbt, newcount)
+#define rehash_finish(rbt)
 #endif
 
 static inline void
@@ -446,11 +493,16 @@ static void
 deletefromlevel(dns_rbtnode_t *item, dns_rbtnode_t **rootp);
 
 static isc_result_t
-treefix(dns_rbt_t *rbt, void *base, size_t size,
+treefix(dns_rbt_t *rbt, void *base, size_t size, uintptr_t mapbase,
 	dns_rbtnode_t *n, const dns_name_t *name,
 	dns_rbtdatafixer_t datafixer, void *fixer_arg,
 	isc_uint64_t *crc);
 
+static void
+treerebase(dns_rbtnode_t *n, void *base, uintptr_t mapbase,
+	   dns_rbtdatarebaser_t datarebaser, void *rebaser_arg,
+	   isc_uint64_t *crc);
+
 static void
 deletetreeflat(dns_rbt_t *rbt, unsigned int quantum, isc_boolean_t unhash,
 	       dns_rbtnode_t **nodep);
@@ -518,6 +570,7 @@ write_header(FILE *file, dns_rbt_t *rbt, isc_uint64_t first_node_offset,
 #endif
 
 	header.nodecount = rbt->nodecount;
+	header.hashseed = rbt->hashseed;
 
 	header.crc = crc;
 
@@ -744,16 +797,53 @@ dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
 	} \
 } while(0);
 
+/*
+ * Return the file offset a pointer read from a map image refers to.
+ * Pointers are either offsets, as written by serialize_node(), or
+ * absolute addresses assigned by dns_rbt_prelink_tree() for an image
+ * mapped at 'mapbase'.
+ */
+static inline uintptr_t
+getoffset(void *ptr, unsigned int is_relative, uintptr_t mapbase) {
+	if (is_relative)
+		return ((uintptr_t) ptr);
+	return ((uintptr_t) ptr - mapbase);
+}
+
+/*
+ * Resolve one pointer of node 'n' against the address the image is
+ * mapped at.  The node is only written to if the stored value is not
+ * already the right one, which is always the case for a prelinked image
+ * mapped at its preferred address; that keeps its pages clean and
+ * shared with the page cache.
+ */
+#define RESOLVE(n, field, rel, max, target) do { \
+	if ((n)->field != NULL) { \
+		uintptr_t off = getoffset((n)->field, (n)->rel, mapbase); \
+		CONFIRM(off <= (uintptr_t) (max)); \
+		(target) = (void *) ((char *) base + off); \
+		if ((n)->field != (target)) \
+			(n)->field = (target); \
+		if ((n)->rel) \
+			(n)->rel = 0; \
+	} else { \
+		CONFIRM(!(n)->rel); \
+		(target) = NULL; \
+	} \
+} while (0)
+
 static isc_result_t
-treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
-	const dns_name_t *name, dns_rbtdatafixer_t datafixer,
-	void *fixer_arg, isc_uint64_t *crc)
+treefix(dns_rbt_t *rbt, void *base, size_t filesize, uintptr_t mapbase,
+	dns_rbtnode_t *n, const dns_name_t *name,
+	dns_rbtdatafixer_t datafixer, void *fixer_arg, isc_uint64_t *crc)
 {
 	isc_result_t result = ISC_R_SUCCESS;
 	dns_fixedname_t fixed;
 	dns_name_t nodename, *fullname;
 	unsigned char *node_data;
 	dns_rbtnode_t header;
+	dns_rbtnode_t *left, *right, *down, *parent;
+	void *data;
 	size_t datasize, nodemax = filesize - sizeof(dns_rbtnode_t);
 
 	if (n == NULL)
@@ -778,59 +868,34 @@ treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
 	/* memorize header contents prior to fixup */
 	memmove(&header, n, sizeof(header));
 
-	if (n->left_is_relative) {
-		CONFIRM(n->left <= (dns_rbtnode_t *) nodemax);
-		n->left = getleft(n, rbt->mmap_location);
-		n->left_is_relative = 0;
-		CONFIRM(DNS_RBTNODE_VALID(n->left));
-	} else
-		CONFIRM(n->left == NULL);
+	RESOLVE(n, left, left_is_relative, nodemax, left);
+	CONFIRM(left == NULL || DNS_RBTNODE_VALID(left));
 
-	if (n->right_is_relative) {
-		CONFIRM(n->right <= (dns_rbtnode_t *) nodemax);
-		n->right = getright(n, rbt->mmap_location);
-		n->right_is_relative = 0;
-		CONFIRM(DNS_RBTNODE_VALID(n->right));
-	} else
-		CONFIRM(n->right == NULL);
-
-	if (n->down_is_relative) {
-		CONFIRM(n->down <= (dns_rbtnode_t *) nodemax);
-		n->down = getdown(n, rbt->mmap_location);
-		n->down_is_relative = 0;
-		CONFIRM(n->down > (dns_rbtnode_t *) n);
-		CONFIRM(DNS_RBTNODE_VALID(n->down));
-	} else
-		CONFIRM(n->down == NULL);
-
-	if (n->parent_is_relative) {
-		CONFIRM(n->parent <= (dns_rbtnode_t *) nodemax);
-		n->parent = getparent(n, rbt->mmap_location);
-		n->parent_is_relative = 0;
-		CONFIRM(n->parent < (dns_rbtnode_t *) n);
-		CONFIRM(DNS_RBTNODE_VALID(n->parent));
-	} else
-		CONFIRM(n->parent == NULL);
+	RESOLVE(n, right, right_is_relative, nodemax, right);
+	CONFIRM(right == NULL || DNS_RBTNODE_VALID(right));
 
-	if (n->data_is_relative) {
-		CONFIRM(n->data <= (void *) filesize);
-		n->data = getdata(n, rbt->mmap_location);
-		n->data_is_relative = 0;
-		CONFIRM(n->data > (void *) n);
-	} else
-		CONFIRM(n->data == NULL);
+	RESOLVE(n, down, down_is_relative, nodemax, down);
+	CONFIRM(down == NULL || down > n);
+	CONFIRM(down == NULL || DNS_RBTNODE_VALID(down));
+
+	RESOLVE(n, parent, parent_is_relative, nodemax, parent);
+	CONFIRM(parent == NULL || parent < n);
+	CONFIRM(parent == NULL || DNS_RBTNODE_VALID(parent));
 
-	hash_node(rbt, n, fullname);
+	RESOLVE(n, data, data_is_relative, filesize, data);
+	CONFIRM(data == NULL || data > (void *) n);
+
+	hash_mapped_node(rbt, n, fullname);
 
 	/* a change in the order (from left, right, down) will break hashing*/
 	if (n->left != NULL)
-		CHECK(treefix(rbt, base, filesize, n->left, name,
+		CHECK(treefix(rbt, base, filesize, mapbase, n->left, name,
 			      datafixer, fixer_arg, crc));
 	if (n->right != NULL)
-		CHECK(treefix(rbt, base, filesize, n->right, name,
+		CHECK(treefix(rbt, base, filesize, mapbase, n->right, name,
 			      datafixer, fixer_arg, crc));
 	if (n->down != NULL)
-		CHECK(treefix(rbt, base, filesize, n->down, fullname,
+		CHECK(treefix(rbt, base, filesize, mapbase, n->down, fullname,
 			      datafixer, fixer_arg, crc));
 
 	if (datafixer != NULL && n->data != NULL)
@@ -857,6 +922,8 @@ treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
 	return (result);
 }
 
+#undef RESOLVE
+
 isc_result_t
 dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 			 off_t header_offset, isc_mem_t *mctx,
@@ -910,10 +977,12 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 		result = ISC_R_INVALIDFILE;
 		goto cleanup;
 	}
+	rbt->hashseed = header->hashseed;
 	rehash(rbt, header->nodecount);
+	rehash_finish(rbt);
 
-	CHECK(treefix(rbt, base_address, filesize, rbt->root,
-		      dns_rootname, datafixer, fixer_arg, &crc));
+	CHECK(treefix(rbt, base_address, filesize, (uintptr_t) header->mapbase,
+		      rbt->root, dns_rootname, datafixer, fixer_arg, &crc));
 
 	isc_crc64_final(&crc);
 #ifdef DEBUG
@@ -949,6 +1018,96 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 	return (result);
 }
 
+/*
+ * Rewrite the pointers of node 'n' and everything below it, which have
+ * been resolved for an image mapped at 'base', for one mapped at
+ * 'mapbase' instead, and compute the CRC of the result in the order
+ * treefix() will.
+ */
+#define REBASE(p) \
+	((p) == NULL ? NULL : \
+	 (void *) ((uintptr_t) (p) - (uintptr_t) base + mapbase))
+
+static void
+treerebase(dns_rbtnode_t *n, void *base, uintptr_t mapbase,
+	   dns_rbtdatarebaser_t datarebaser, void *rebaser_arg,
+	   isc_uint64_t *crc)
+{
+	if (n == NULL)
+		return;
+
+	treerebase(n->left, base, mapbase, datarebaser, rebaser_arg, crc);
+	treerebase(n->right, base, mapbase, datarebaser, rebaser_arg, crc);
+	treerebase(n->down, base, mapbase, datarebaser, rebaser_arg, crc);
+
+	if (datarebaser != NULL && n->data != NULL)
+		datarebaser(n, base, mapbase, rebaser_arg, crc);
+
+	n->left = REBASE(n->left);
+	n->right = REBASE(n->right);
+	n->down = REBASE(n->down);
+	n->parent = REBASE(n->parent);
+	n->data = REBASE(n->data);
+#ifdef DNS_RBT_USEHASH
+	UPPERNODE(n) = REBASE(UPPERNODE(n));
+	HASHNEXT(n) = REBASE(HASHNEXT(n));
+#endif
+
+	isc_crc64_update(crc, (const isc_uint8_t *) n, NODE_SIZE(n));
+}
+
+#undef REBASE
+
+isc_result_t
+dns_rbt_prelink_tree(void *base_address, size_t filesize,
+		     off_t header_offset, isc_uint64_t mapbase,
+		     isc_mem_t *mctx,
+		     dns_rbtdatafixer_t datafixer, void *fixer_arg,
+		     dns_rbtdatarebaser_t datarebaser, void *rebaser_arg)
+{
+	isc_result_t result;
+	file_header_t *header;
+	dns_rbt_t *rbt = NULL;
+	isc_uint64_t crc;
+
+	REQUIRE(base_address != NULL);
+	REQUIRE(mapbase != 0);
+	REQUIRE((mapbase & 4095) == 0);
+
+	header = (file_header_t *)((char *)base_address + header_offset);
+	if (header->mapbase != 0)
+		return (ISC_R_EXISTS);
+
+	/*
+	 * Resolve the image where it is, filling in everything the
+	 * loader would (pointers, hash chains, upper nodes)...
+	 */
+	result = dns_rbt_deserialize_tree(base_address, filesize,
+					  header_offset, mctx, NULL, NULL,
+					  datafixer, fixer_arg, NULL, &rbt);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	/*
+	 * ...then move it to 'mapbase' and record the CRC of the final
+	 * contents, which is what the loader will see.
+	 */
+	isc_crc64_init(&crc);
+	treerebase(rbt->root, base_address, (uintptr_t) mapbase,
+		   datarebaser, rebaser_arg, &crc);
+	isc_crc64_final(&crc);
+
+	header->crc = crc;
+	header->mapbase = mapbase;
+
+	/* The nodes belong to the image; don't let destroy touch them. */
+	rbt->root = NULL;
+	rbt->nodecount = 0;
+	dns_rbt_destroy(&rbt);
+
+	return (ISC_R_SUCCESS);
+}
+
 /*
  * Initialize a red/black tree of trees.
  */
@@ -977,7 +1136,12 @@ dns_rbt_create(isc_mem_t *mctx, dns_rbtdeleter_t deleter,
 	rbt->nodecount = 0;
 	rbt->hashtable = NULL;
 	rbt->hashsize = 0;
+	isc_random_get(&rbt->hashseed);
 	rbt->mmap_location = NULL;
+	rbt->oldhashtable = NULL;
+	rbt->oldhashsize = 0;
+	rbt->hashcleared = 0;
+	rbt->hashmoved = 0;
 
 #ifdef DNS_RBT_USEHASH
 	result = inithash(rbt);
@@ -1021,6 +1185,9 @@ dns_rbt_destroy2(dns_rbt_t **rbtp, unsigned int quantum) {
 	if (rbt->hashtable != NULL)
 		isc_mem_put(rbt->mctx, rbt->hashtable,
 			    rbt->hashsize * sizeof(dns_rbtnode_t *));
+	if (rbt->oldhashtable != NULL)
+		isc_mem_put(rbt->mctx, rbt->oldhashtable,
+			    rbt->oldhashsize * sizeof(dns_rbtnode_t *));
 
 	rbt->magic = 0;
 
@@ -1045,6 +1212,18 @@ dns_rbt_hashsize(dns_rbt_t *rbt) {
 	return (rbt->hashsize);
 }
 
+size_t
+dns_rbt_hashpending(dns_rbt_t *rbt) {
+
+	REQUIRE(VALID_RBT(rbt));
+
+	if (rbt->oldhashtable == NULL)
+		return (0);
+
+	return ((rbt->hashsize - rbt->hashcleared) +
+		(rbt->oldhashsize - rbt->hashmoved));
+}
+
 static inline isc_result_t
 chain_name(dns_rbtnodechain_t *chain, dns_name_t *name,
 	   isc_boolean_t include_chain_end)
@@ -1578,7 +1757,7 @@ dns_rbt_findnode(dns_rbt_t *rbt, const dns_name_t *name, dns_name_t *foundname,
 						  nlabels - tlabels,
 						  hlabels + tlabels,
 						  &hash_name);
-			hash = dns_name_fullhash(&hash_name, ISC_FALSE);
+			hash = hash_fullname(rbt, &hash_name);
 			dns_name_getlabelsequence(search_name,
 						  nlabels - tlabels,
 						  tlabels, &hash_name);
@@ -1587,7 +1766,7 @@ dns_rbt_findnode(dns_rbt_t *rbt, const dns_name_t *name, dns_name_t *foundname,
 			 * Walk all the nodes in the hash bucket pointed
 			 * by the computed hash value.
 			 */
-			for (hnode = rbt->hashtable[hash % rbt->hashsize];
+			for (hnode = *hash_bucket(rbt, hash);
 			     hnode != NULL;
 			     hnode = hnode->hashnext)
 			{
@@ -2278,18 +2457,50 @@ create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
 }
 
 #ifdef DNS_RBT_USEHASH
+/*
+ * Hash a name for the tree's hash table.  This is dns_name_fullhash(),
+ * keyed with a seed of the tree's own rather than the process-wide one,
+ * so that hash values stored in a map image remain valid when it is
+ * loaded by another process.
+ */
+static inline unsigned int
+hash_fullname(dns_rbt_t *rbt, const dns_name_t *name) {
+	if (name->labels == 0)
+		return (0);
+
+	return (isc_hash_function_reverse(name->ndata, name->length,
+					  ISC_FALSE, &rbt->hashseed));
+}
+
+/*
+ * Return the hash chain that holds, or is to hold, nodes with hash value
+ * 'hashval'.  While a rehash is in progress, that is the chain in the
+ * old table unless its bucket has already been moved to the new one.
+ */
+static inline dns_rbtnode_t **
+hash_bucket(dns_rbt_t *rbt, unsigned int hashval) {
+	size_t old;
+
+	if (ISC_UNLIKELY(rbt->oldhashtable != NULL)) {
+		old = hashval % rbt->oldhashsize;
+		if (old >= rbt->hashmoved)
+			return (&rbt->oldhashtable[old]);
+	}
+
+	return (&rbt->hashtable[hashval % rbt->hashsize]);
+}
+
 static inline void
 hash_add_node(dns_rbt_t *rbt, dns_rbtnode_t *node, const dns_name_t *name) {
-	unsigned int hash;
+	dns_rbtnode_t **bucket;
 
 	REQUIRE(name != NULL);
 
-	HASHVAL(node) = dns_name_fullhash(name, ISC_FALSE);
+	HASHVAL(node) = hash_fullname(rbt, name);
 
-	hash = HASHVAL(node) % rbt->hashsize;
-	HASHNEXT(node) = rbt->hashtable[hash];
-
-	rbt->hashtable[hash] = node;
+	bucket = hash_bucket(rbt, HASHVAL(node));
+	HASHNEXT(node) = *bucket;
+	*bucket = node;
 }
 
 static isc_result_t
@@ -2308,34 +2519,69 @@ inithash(dns_rbt_t *rbt) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Start growing the hash table to suit 'newcount' nodes.  The nodes are
+ * moved to the new table by rehash_step(); until then, a node whose
+ * bucket in the old table has not been moved is still found there (see
+ * hash_bucket()).
+ */
 static void
 rehash(dns_rbt_t *rbt, unsigned int newcount) {
-	unsigned int oldsize;
-	dns_rbtnode_t **oldtable;
+	size_t newsize;
+	dns_rbtnode_t **newtable;
+
+	/*
+	 * Only one rehash can be in progress at a time.  This is not
+	 * expected to happen, since the table would have to grow again
+	 * before the steps taken on insertion had moved every bucket.
+	 */
+	rehash_finish(rbt);
+
+	newsize = rbt->hashsize;
+	do {
+		INSIST((newsize * 2 + 1) > newsize);
+		newsize = newsize * 2 + 1;
+	} while (newcount >= (newsize * 3));
+
+	newtable = isc_mem_get(rbt->mctx, newsize * sizeof(dns_rbtnode_t *));
+	if (newtable == NULL)
+		return;
+
+	rbt->oldhashtable = rbt->hashtable;
+	rbt->oldhashsize = rbt->hashsize;
+	rbt->hashtable = newtable;
+	rbt->hashsize = newsize;
+	rbt->hashcleared = 0;
+	rbt->hashmoved = 0;
+}
+
+/*
+ * Take a step of the rehash in progress: clear up to 'clear' buckets of
+ * the new table and, once all are clear, move the nodes of up to 'move'
+ * buckets of the old table to the new one.  The old table is freed when
+ * it is empty.
+ */
+static void
+rehash_step(dns_rbt_t *rbt, size_t clear, size_t move) {
 	dns_rbtnode_t *node;
 	dns_rbtnode_t *nextnode;
 	unsigned int hash;
-	unsigned int i;
+	size_t n;
 
-	oldsize = (unsigned int)rbt->hashsize;
-	oldtable = rbt->hashtable;
-	do {
-		INSIST((rbt->hashsize * 2 + 1) > rbt->hashsize);
-		rbt->hashsize = rbt->hashsize * 2 + 1;
-	} while (newcount >= (rbt->hashsize * 3));
-	rbt->hashtable = isc_mem_get(rbt->mctx,
-				     rbt->hashsize * sizeof(dns_rbtnode_t *));
-	if (rbt->hashtable == NULL) {
-		rbt->hashtable = oldtable;
-		rbt->hashsize = oldsize;
-		return;
-	}
+	INSIST(rbt->oldhashtable != NULL);
 
-	for (i = 0; i < rbt->hashsize; i++)
-		rbt->hashtable[i] = NULL;
+	n = ISC_MIN(clear, rbt->hashsize - rbt->hashcleared);
+	memset(rbt->hashtable + rbt->hashcleared, 0,
+	       n * sizeof(dns_rbtnode_t *));
+	rbt->hashcleared += n;
+	if (rbt->hashcleared < rbt->hashsize)
+		return;
 
-	for (i = 0; i < oldsize; i++) {
-		for (node = oldtable[i]; node != NULL; node = nextnode) {
+	while (move-- > 0 && rbt->hashmoved < rbt->oldhashsize) {
+		node = rbt->oldhashtable[rbt->hashmoved];
+		rbt->oldhashtable[rbt->hashmoved] = NULL;
+		rbt->hashmoved++;
+		for (; node != NULL; node = nextnode) {
 			hash = HASHVAL(node) % rbt->hashsize;
 			nextnode = HASHNEXT(node);
 			HASHNEXT(node) = rbt->hashtable[hash];
@@ -2343,7 +2589,21 @@ rehash(dns_rbt_t *rbt, unsigned int newcount) {
 		}
 	}
 
-	isc_mem_put(rbt->mctx, oldtable, oldsize * sizeof(dns_rbtnode_t *));
+	if (rbt->hashmoved == rbt->oldhashsize) {
+		isc_mem_put(rbt->mctx, rbt->oldhashtable,
+			    rbt->oldhashsize * sizeof(dns_rbtnode_t *));
+		rbt->oldhashtable = NULL;
+		rbt->oldhashsize = 0;
+	}
+}
+
+/*
+ * Complete any rehash in progress.
+ */
+static void
+rehash_finish(dns_rbt_t *rbt) {
+	if (rbt->oldhashtable != NULL)
+		rehash_step(rbt, rbt->hashsize, rbt->oldhashsize);
 }
 
 static inline void
@@ -2352,22 +2612,56 @@ hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, const dns_name_t *name) {
 
 	if (rbt->nodecount >= (rbt->hashsize * 3))
 		rehash(rbt, rbt->nodecount);
+	if (ISC_UNLIKELY(rbt->oldhashtable != NULL))
+		rehash_step(rbt, RBT_REHASH_CLEAR, RBT_REHASH_MOVE);
 
 	hash_add_node(rbt, node, name);
 }
 
+/*
+ * Add a node from a map image to the hash table.  This is hash_node()
+ * for deserialization: the table has been sized for the whole image, and
+ * the node is only written to if its stored hash linkage differs from
+ * what the insertion produces (see treefix()).
+ */
+static inline void
+hash_mapped_node(dns_rbt_t *rbt, dns_rbtnode_t *node,
+		 const dns_name_t *name)
+{
+	unsigned int hashval;
+	dns_rbtnode_t **bucket;
+
+	REQUIRE(DNS_RBTNODE_VALID(node));
+	REQUIRE(name != NULL);
+
+	if (rbt->nodecount >= (rbt->hashsize * 3)) {
+		rehash(rbt, rbt->nodecount);
+		rehash_finish(rbt);
+	}
+
+	hashval = hash_fullname(rbt, name);
+	if (HASHVAL(node) != hashval)
+		HASHVAL(node) = hashval;
+
+	bucket = hash_bucket(rbt, hashval);
+	if (HASHNEXT(node) != *bucket)
+		HASHNEXT(node) = *bucket;
+
+	*bucket = node;
+}
+
 static inline void
 unhash_node(dns_rbt_t *rbt, dns_rbtnode_t *node) {
-	unsigned int bucket;
+	dns_rbtnode_t **bucket;
 	dns_rbtnode_t *bucket_node;
 
 	REQUIRE(DNS_RBTNODE_VALID(node));
 
-	bucket = HASHVAL(node) % rbt->hashsize;
-	bucket_node = rbt->hashtable[bucket];
+	bucket = hash_bucket(rbt, HASHVAL(node));
+	bucket_node = *bucket;
 
 	if (bucket_node == node) {
-		rbt->hashtable[bucket] = HASHNEXT(node);
+		*bucket = HASHNEXT(node);
 	} else {
 		while (HASHNEXT(bucket_node) != node) {
 			INSIST(HASHNEXT(bucket_node) != NULL);
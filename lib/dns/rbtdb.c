@@ -28,6 +28,7 @@
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/once.h>
+#include <isc/os.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/random.h>
@@ -71,6 +72,7 @@
 #else
 #define PROT_READ	0x01
 #define PROT_WRITE	0x02
+#define MAP_SHARED	0x0001
 #define MAP_PRIVATE	0x0002
 #define MAP_FAILED	((void *)-1)
 #endif
@@ -110,6 +112,7 @@ struct rbtdb_file_header {
 	isc_uint64_t tree;
 	isc_uint64_t nsec;
 	isc_uint64_t nsec3;
+	isc_uint64_t mapbase;		/* nonzero if prelinked */
 
 	char version2[32];  		/* repeated; must match version1 */
 };
@@ -160,10 +163,12 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define cache_find cache_find64
 #define cache_findrdataset cache_findrdataset64
 #define cache_findzonecut cache_findzonecut64
+#define cache_node_lock_count cache_node_lock_count64
 #define cache_zonecut_callback cache_zonecut_callback64
 #define check_stale_header check_stale_header64
 #define cleanup_dead_nodes cleanup_dead_nodes64
 #define cleanup_dead_nodes_callback cleanup_dead_nodes_callback64
+#define schedule_dead_nodes schedule_dead_nodes64
 #define closeversion closeversion64
 #define createiterator createiterator64
 #define currentversion currentversion64
@@ -206,13 +211,17 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define getsigningtime getsigningtime64
 #define getsize getsize64
 #define glue_nsdname_cb glue_nsdname_cb64
+#define hashpending hashpending64
 #define hashsize hashsize64
 #define init_file_version init_file_version64
 #define isdnssec isdnssec64
 #define ispersistent ispersistent64
 #define issecure issecure64
 #define iszonesecure iszonesecure64
+#define loading_addheader loading_addheader64
 #define loading_addrdataset loading_addrdataset64
+#define loading_addrdatasets loading_addrdatasets64
+#define loading_makeheader loading_makeheader64
 #define loadnode loadnode64
 #define mark_stale_header mark_stale_header64
 #define matchparams matchparams64
@@ -224,9 +233,12 @@ typedef isc_uint64_t                    rbtdb_serial_t;
 #define overmem overmem64
 #define previous_closest_nsec previous_closest_nsec64
 #define printnode printnode64
+#define prelink prelink64
 #define prune_tree prune_tree64
 #define rbt_datafixer rbt_datafixer64
+#define rbt_datarebaser rbt_datarebaser64
 #define rbt_datawriter rbt_datawriter64
+#define rbtdb_mapbase rbtdb_mapbase64
 #define rbtdb_zero_header rbtdb_zero_header64
 #define rdataset_addglue rdataset_addglue64
 #define rdataset_clearprefetch rdataset_clearprefetch64
@@ -518,10 +530,12 @@ typedef ISC_LIST(dns_rbtnode_t)         rbtnodelist_t;
  * There is a tradeoff issue about configuring this value: if this is too
  * small, it may cause heavier contention between threads; if this is too large,
  * LRU purge algorithm won't work well (entries tend to be purged prematurely).
- * The default value should work well for most environments, but this can
- * also be configurable at compilation time via the
- * DNS_RBTDB_CACHE_NODE_LOCK_COUNT variable.  This value must be larger than
- * 1 due to the assumption of overmem_purge().
+ * By default the count is chosen at run time, CACHE_NODE_LOCKS_PER_CPU
+ * buckets for each CPU, but no fewer than DEFAULT_CACHE_NODE_LOCK_COUNT
+ * and no more than MAX_CACHE_NODE_LOCK_COUNT.  A fixed value can be
+ * configured at compilation time via the DNS_RBTDB_CACHE_NODE_LOCK_COUNT
+ * variable.  This value must be larger than 1 due to the assumption of
+ * overmem_purge().
  */
 #ifdef DNS_RBTDB_CACHE_NODE_LOCK_COUNT
 #if DNS_RBTDB_CACHE_NODE_LOCK_COUNT <= 1
@@ -531,6 +545,8 @@ typedef ISC_LIST(dns_rbtnode_t)         rbtnodelist_t;
 #endif
 #else
 #define DEFAULT_CACHE_NODE_LOCK_COUNT   16
+#define CACHE_NODE_LOCKS_PER_CPU        4
+#define MAX_CACHE_NODE_LOCK_COUNT       256
 #endif	/* DNS_RBTDB_CACHE_NODE_LOCK_COUNT */
 
 typedef struct {
@@ -640,6 +656,7 @@ struct dns_rbtdb {
 	rbtdb_version_t *               future_version;
 	rbtdb_versionlist_t             open_versions;
 	isc_task_t *                    task;
+	isc_boolean_t                   deadnodes_scheduled;
 	dns_dbnode_t                    *soanode;
 	dns_dbnode_t                    *nsnode;
 
@@ -708,8 +725,15 @@ typedef struct {
 typedef struct {
 	dns_rbtdb_t *           rbtdb;
 	isc_stdtime_t           now;
+	isc_mutex_t             lock;		/*%< Serializes addbatch. */
 } rbtdb_load_t;
 
+/*%
+ * Number of slabs loading_addrdatasets() builds before taking the
+ * load context lock to add them to the tree.
+ */
+#define DNS_RBTDB_LOADBATCH	64
+
 static void delete_callback(void *data, void *arg);
 static void rdataset_disassociate(dns_rdataset_t *rdataset);
 static isc_result_t rdataset_first(dns_rdataset_t *rdataset);
@@ -738,6 +762,7 @@ static isc_result_t resign_insert(dns_rbtdb_t *rbtdb, int idx,
 static void resign_delete(dns_rbtdb_t *rbtdb, rbtdb_version_t *version,
 			  rdatasetheader_t *header);
 static void prune_tree(isc_task_t *task, isc_event_t *event);
+static void schedule_dead_nodes(dns_rbtdb_t *rbtdb);
 static void rdataset_settrust(dns_rdataset_t *rdataset, dns_trust_t trust);
 static void rdataset_expire(dns_rdataset_t *rdataset);
 static void rdataset_clearprefetch(dns_rdataset_t *rdataset);
@@ -2167,8 +2192,15 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 	 * Attempt to switch to a write lock on the tree.  If this fails,
 	 * we will add this node to a linked list of nodes in this locking
 	 * bucket which we will free later.
+	 *
+	 * Readers of a cache never try: an exclusive tree lock taken here,
+	 * on the lookup path, stalls every other lookup.  Such nodes are
+	 * instead reclaimed in batches by cleanup_dead_nodes_callback(),
+	 * or by the next writer that holds the tree lock.
 	 */
-	if (tlock != isc_rwlocktype_write) {
+	if (tlock != isc_rwlocktype_write && IS_CACHE(rbtdb)) {
+		write_locked = ISC_FALSE;
+	} else if (tlock != isc_rwlocktype_write) {
 		/*
 		 * Locking hierarchy notwithstanding, we don't need to free
 		 * the node lock before acquiring the tree write lock because
@@ -2260,6 +2292,8 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 		INSIST(node->data == NULL);
 		INSIST(!ISC_LINK_LINKED(node, deadlink));
 		ISC_LIST_APPEND(rbtdb->deadnodes[bucket], node, deadlink);
+		if (IS_CACHE(rbtdb))
+			schedule_dead_nodes(rbtdb);
 	}
 
  restore_locks:
@@ -2544,6 +2578,15 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 	unsigned int locknum;
 	unsigned int refs;
 
+	/*
+	 * Clear the flag before looking at the lists: a node queued
+	 * behind the scan will then schedule another pass rather than
+	 * be left on a list that has already been looked at.
+	 */
+	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
+	rbtdb->deadnodes_scheduled = ISC_FALSE;
+	RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
+
 	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	for (locknum = 0; locknum < rbtdb->node_lock_count; locknum++) {
 		NODE_LOCK(&rbtdb->node_locks[locknum].lock,
@@ -2565,6 +2608,39 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 	}
 }
 
+/*
+ * Arrange for cleanup_dead_nodes_callback() to reclaim the nodes on the
+ * dead node lists, unless it is already pending.  This lets cache readers
+ * leave the deletion of nodes they emptied to a single batched pass under
+ * the tree write lock.
+ *
+ * The caller holds the lock of the bucket the node was queued on.  The
+ * flag is cleared before that bucket is scanned, so reading it without
+ * rbtdb->lock cannot miss a pass that has yet to see the node; it saves
+ * taking rbtdb->lock for every dying node while a pass is pending.
+ */
+static void
+schedule_dead_nodes(dns_rbtdb_t *rbtdb) {
+	isc_event_t *event;
+
+	if (rbtdb->task == NULL || rbtdb->deadnodes_scheduled)
+		return;
+
+	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
+	if (!rbtdb->deadnodes_scheduled) {
+		event = isc_event_allocate(rbtdb->common.mctx, NULL,
+					   DNS_EVENT_RBTDEADNODES,
+					   cleanup_dead_nodes_callback,
+					   rbtdb, sizeof(isc_event_t));
+		if (event != NULL) {
+			rbtdb->deadnodes_scheduled = ISC_TRUE;
+			isc_refcount_increment(&rbtdb->references, NULL);
+			isc_task_send(rbtdb->task, &event);
+		}
+	}
+	RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
+}
+
 static void
 closeversion(dns_db_t *db, dns_dbversion_t **versionp, isc_boolean_t commit) {
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
@@ -7094,25 +7170,21 @@ loadnode(dns_rbtdb_t *rbtdb, const dns_name_t *name, dns_rbtnode_t **nodep,
 	return (noderesult);
 }
 
+/*
+ * Check an rdataset being loaded and build its slab.  This does not
+ * touch the tree and may be called by several threads at once.
+ */
 static isc_result_t
-loading_addrdataset(void *arg, const dns_name_t *name,
-		    dns_rdataset_t *rdataset)
+loading_makeheader(rbtdb_load_t *loadctx, const dns_name_t *name,
+		   dns_rdataset_t *rdataset, rdatasetheader_t **headerp)
 {
-	rbtdb_load_t *loadctx = arg;
 	dns_rbtdb_t *rbtdb = loadctx->rbtdb;
-	dns_rbtnode_t *node;
 	isc_result_t result;
 	isc_region_t region;
 	rdatasetheader_t *newheader;
 
 	REQUIRE(rdataset->rdclass == rbtdb->common.rdclass);
 
-	/*
-	 * This routine does no node locking.  See comments in
-	 * 'load' below for more information on loading and
-	 * locking.
-	 */
-
 	/*
 	 * SOA records are only allowed at top of zone.
 	 */
@@ -7120,10 +7192,6 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 	    !IS_CACHE(rbtdb) && !dns_name_equal(name, &rbtdb->common.origin))
 		return (DNS_R_NOTZONETOP);
 
-	if (rdataset->type != dns_rdatatype_nsec3 &&
-	    rdataset->covers != dns_rdatatype_nsec3)
-		add_empty_wildcards(rbtdb, name);
-
 	if (dns_name_iswildcard(name)) {
 		/*
 		 * NS record owners cannot legally be wild cards.
@@ -7135,34 +7203,6 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 		 */
 		if (rdataset->type == dns_rdatatype_nsec3)
 			return (DNS_R_INVALIDNSEC3);
-		result = add_wildcard_magic(rbtdb, name);
-		if (result != ISC_R_SUCCESS)
-			return (result);
-	}
-
-	node = NULL;
-	if (rdataset->type == dns_rdatatype_nsec3 ||
-	    rdataset->covers == dns_rdatatype_nsec3) {
-		result = dns_rbt_addnode(rbtdb->nsec3, name, &node);
-		if (result == ISC_R_SUCCESS)
-			node->nsec = DNS_RBT_NSEC_NSEC3;
-	} else if (rdataset->type == dns_rdatatype_nsec) {
-		result = loadnode(rbtdb, name, &node, ISC_TRUE);
-	} else {
-		result = loadnode(rbtdb, name, &node, ISC_FALSE);
-	}
-	if (result != ISC_R_SUCCESS && result != ISC_R_EXISTS)
-		return (result);
-	if (result == ISC_R_SUCCESS) {
-		dns_name_t foundname;
-		dns_name_init(&foundname, NULL);
-		dns_rbt_namefromnode(node, &foundname);
-#ifdef DNS_RBT_USEHASH
-		node->locknum = node->hashval % rbtdb->node_lock_count;
-#else
-		node->locknum = dns_name_hash(&foundname, ISC_TRUE) %
-			rbtdb->node_lock_count;
-#endif
 	}
 
 	result = dns_rdataslab_fromrdataset(rdataset, rbtdb->common.mctx,
@@ -7181,9 +7221,8 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 	newheader->serial = 1;
 	newheader->noqname = NULL;
 	newheader->closest = NULL;
-	newheader->count = init_count++;
 	newheader->last_used = 0;
-	newheader->node = node;
+	newheader->node = NULL;
 	setownercase(newheader, name);
 
 	if ((rdataset->attributes & DNS_RDATASETATTR_RESIGN) != 0) {
@@ -7196,6 +7235,60 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 		newheader->resign_lsb = 0;
 	}
 
+	*headerp = newheader;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Add a header built by loading_makeheader() to the tree.  The caller
+ * must make sure only one thread at a time is in here.
+ */
+static isc_result_t
+loading_addheader(rbtdb_load_t *loadctx, const dns_name_t *name,
+		  dns_rdataset_t *rdataset, rdatasetheader_t *newheader)
+{
+	dns_rbtdb_t *rbtdb = loadctx->rbtdb;
+	dns_rbtnode_t *node;
+	isc_result_t result;
+
+	if (rdataset->type != dns_rdatatype_nsec3 &&
+	    rdataset->covers != dns_rdatatype_nsec3)
+		add_empty_wildcards(rbtdb, name);
+
+	if (dns_name_iswildcard(name)) {
+		result = add_wildcard_magic(rbtdb, name);
+		if (result != ISC_R_SUCCESS)
+			goto freeheader;
+	}
+
+	node = NULL;
+	if (rdataset->type == dns_rdatatype_nsec3 ||
+	    rdataset->covers == dns_rdatatype_nsec3) {
+		result = dns_rbt_addnode(rbtdb->nsec3, name, &node);
+		if (result == ISC_R_SUCCESS)
+			node->nsec = DNS_RBT_NSEC_NSEC3;
+	} else if (rdataset->type == dns_rdatatype_nsec) {
+		result = loadnode(rbtdb, name, &node, ISC_TRUE);
+	} else {
+		result = loadnode(rbtdb, name, &node, ISC_FALSE);
+	}
+	if (result != ISC_R_SUCCESS && result != ISC_R_EXISTS)
+		goto freeheader;
+	if (result == ISC_R_SUCCESS) {
+		dns_name_t foundname;
+		dns_name_init(&foundname, NULL);
+		dns_rbt_namefromnode(node, &foundname);
+#ifdef DNS_RBT_USEHASH
+		node->locknum = node->hashval % rbtdb->node_lock_count;
+#else
+		node->locknum = dns_name_hash(&foundname, ISC_TRUE) %
+			rbtdb->node_lock_count;
+#endif
+	}
+
+	newheader->count = init_count++;
+	newheader->node = node;
+
 	result = add32(rbtdb, node, rbtdb->current_version, newheader,
 		       DNS_DBADD_MERGE, ISC_TRUE, NULL, 0);
 	if (result == ISC_R_SUCCESS &&
@@ -7205,6 +7298,72 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 		result = ISC_R_SUCCESS;
 
 	return (result);
+
+ freeheader:
+	isc_mem_put(rbtdb->common.mctx, newheader,
+		    dns_rdataslab_size((unsigned char *)newheader,
+				       sizeof(*newheader)));
+	return (result);
+}
+
+static isc_result_t
+loading_addrdataset(void *arg, const dns_name_t *name,
+		    dns_rdataset_t *rdataset)
+{
+	rbtdb_load_t *loadctx = arg;
+	rdatasetheader_t *newheader = NULL;
+	isc_result_t result;
+
+	/*
+	 * This routine does no node locking.  See comments in
+	 * 'load' below for more information on loading and
+	 * locking.
+	 */
+
+	result = loading_makeheader(loadctx, name, rdataset, &newheader);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	return (loading_addheader(loadctx, name, rdataset, newheader));
+}
+
+/*
+ * Add a batch of rdatasets.  The slabs are built without holding any
+ * lock, so several loading threads can do that part concurrently;
+ * adding them to the tree is serialized by the load context lock.
+ */
+static void
+loading_addrdatasets(void *arg, unsigned int count, const dns_name_t *names,
+		     dns_rdataset_t *rdatasets, isc_result_t *results)
+{
+	rbtdb_load_t *loadctx = arg;
+	rdatasetheader_t *headers[DNS_RBTDB_LOADBATCH];
+	unsigned int i, n;
+
+	while (count > 0) {
+		n = ISC_MIN(count, DNS_RBTDB_LOADBATCH);
+		for (i = 0; i < n; i++) {
+			headers[i] = NULL;
+			results[i] = loading_makeheader(loadctx, &names[i],
+							&rdatasets[i],
+							&headers[i]);
+		}
+
+		LOCK(&loadctx->lock);
+		for (i = 0; i < n; i++) {
+			if (results[i] != ISC_R_SUCCESS)
+				continue;
+			results[i] = loading_addheader(loadctx, &names[i],
+						       &rdatasets[i],
+						       headers[i]);
+		}
+		UNLOCK(&loadctx->lock);
+
+		names += n;
+		rdatasets += n;
+		results += n;
+		count -= n;
+	}
 }
 
 static isc_result_t
@@ -7221,23 +7380,60 @@ rbt_datafixer(dns_rbtnode_t *rbtnode, void *base, size_t filesize,
 
 	REQUIRE(rbtnode != NULL);
 
+	/*
+	 * The header fields are only written when they differ from what
+	 * is already there, so that a prelinked image mapped at its
+	 * preferred address is not dirtied (see prelink()).
+	 */
 	for (header = rbtnode->data; header != NULL; header = header->next) {
 		p = (unsigned char *) header;
 
 		size = dns_rdataslab_size(p, sizeof(*header));
 		count = dns_rdataslab_count(p, sizeof(*header));;
-		rbtdb->current_version->records += count;
-		rbtdb->current_version->bytes += size;
+		if (rbtdb != NULL) {
+			rbtdb->current_version->records += count;
+			rbtdb->current_version->bytes += size;
+		}
 		isc_crc64_update(crc, p, size);
 #ifdef DEBUG
 		hexdump("hashing header", p, sizeof(rdatasetheader_t));
 		hexdump("hashing slab", p + sizeof(rdatasetheader_t),
 			size - sizeof(rdatasetheader_t));
 #endif
-		header->serial = 1;
-		header->is_mmapped = 1;
-		header->node = rbtnode;
-		header->node_is_relative = 0;
+		if (header->next != NULL) {
+			size_t cooked = dns_rbt_serialize_align(size);
+			uintptr_t next = (uintptr_t) header->next;
+
+			/*
+			 * Written by rbt_datawriter(), 'next' is an offset
+			 * and 'node' the header's own offset; prelinked,
+			 * both are addresses for the preferred location.
+			 */
+			if (header->next_is_relative) {
+				if (next != (p - (unsigned char *)base) +
+					    cooked)
+					return (ISC_R_INVALIDFILE);
+			} else if (header->node_is_relative ||
+				   next - (uintptr_t)header->node !=
+				   (uintptr_t)(p + cooked) - (uintptr_t)rbtnode)
+				return (ISC_R_INVALIDFILE);
+			if (header->next != (rdatasetheader_t *)(p + cooked))
+				header->next = (rdatasetheader_t *)(p + cooked);
+			if (header->next_is_relative)
+				header->next_is_relative = 0;
+			if ((header->next < (rdatasetheader_t *) base) ||
+			    (header->next > (rdatasetheader_t *) limit))
+				return (ISC_R_INVALIDFILE);
+		}
+
+		if (header->serial != 1)
+			header->serial = 1;
+		if (!header->is_mmapped)
+			header->is_mmapped = 1;
+		if (header->node != rbtnode)
+			header->node = rbtnode;
+		if (header->node_is_relative)
+			header->node_is_relative = 0;
 
 		if (rbtdb != NULL && RESIGN(header) &&
 		    (header->resign != 0 || header->resign_lsb != 0))
@@ -7247,23 +7443,38 @@ rbt_datafixer(dns_rbtnode_t *rbtnode, void *base, size_t filesize,
 			if (result != ISC_R_SUCCESS)
 				return (result);
 		}
-
-		if (header->next != NULL) {
-			size_t cooked = dns_rbt_serialize_align(size);
-			if ((uintptr_t)header->next !=
-				    (p - (unsigned char *)base) + cooked)
-				return (ISC_R_INVALIDFILE);
-			header->next = (rdatasetheader_t *)(p + cooked);
-			header->next_is_relative = 0;
-			if ((header->next < (rdatasetheader_t *) base) ||
-			    (header->next > (rdatasetheader_t *) limit))
-				return (ISC_R_INVALIDFILE);
-		}
 	}
 
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Move the rdataset headers of 'rbtnode', resolved by rbt_datafixer()
+ * for an image mapped at 'base', to one mapped at 'mapbase'.
+ */
+static void
+rbt_datarebaser(dns_rbtnode_t *rbtnode, void *base, isc_uint64_t mapbase,
+		void *arg, isc_uint64_t *crc)
+{
+	rdatasetheader_t *header, *next;
+	unsigned char *p;
+	uintptr_t delta = (uintptr_t) mapbase - (uintptr_t) base;
+
+	UNUSED(arg);
+
+	for (header = rbtnode->data; header != NULL; header = next) {
+		p = (unsigned char *) header;
+		next = header->next;
+
+		header->node = (dns_rbtnode_t *)((uintptr_t) rbtnode + delta);
+		if (next != NULL)
+			header->next = (rdatasetheader_t *)
+				((uintptr_t) next + delta);
+
+		isc_crc64_update(crc, p, dns_rdataslab_size(p, sizeof(*header)));
+	}
+}
+
 /*
  * Load the RBT database from the image in 'f'
  */
@@ -7303,6 +7514,26 @@ deserialize32(void *arg, FILE *f, off_t offset) {
 
 	header = (rbtdb_file_header_t *)(base + offset);
 
+	/*
+	 * A prelinked image needs no fixups, and so stays shared with the
+	 * page cache, if it is mapped where it was prelinked for.  Try to
+	 * get it there; if the address is taken, relocate it as usual.
+	 */
+	if (header->mapbase != 0 &&
+	    (isc_uint64_t) (uintptr_t) base != header->mapbase)
+	{
+		void *hint = (void *) (uintptr_t) header->mapbase;
+		char *rebase;
+
+		rebase = isc_file_mmap(hint, filesize, protect, flags, fd, 0);
+		if (rebase == hint) {
+			isc_file_munmap(base, (size_t) filesize);
+			base = rebase;
+			header = (rbtdb_file_header_t *)(base + offset);
+		} else if (rebase != NULL && rebase != MAP_FAILED)
+			isc_file_munmap(rebase, (size_t) filesize);
+	}
+
 	if (header->tree != 0) {
 		result = dns_rbt_deserialize_tree(base, filesize,
 						  (off_t) header->tree,
@@ -7383,6 +7614,7 @@ static isc_result_t
 beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	rbtdb_load_t *loadctx;
 	dns_rbtdb_t *rbtdb;
+	isc_result_t result;
 	rbtdb = (dns_rbtdb_t *)db;
 
 	REQUIRE(DNS_CALLBACK_VALID(callbacks));
@@ -7398,6 +7630,12 @@ beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	else
 		loadctx->now = 0;
 
+	result = isc_mutex_init(&loadctx->lock);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(rbtdb->common.mctx, loadctx, sizeof(*loadctx));
+		return (result);
+	}
+
 	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
 
 	REQUIRE((rbtdb->attributes & (RBTDB_ATTR_LOADED|RBTDB_ATTR_LOADING))
@@ -7407,6 +7645,7 @@ beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
 
 	callbacks->add = loading_addrdataset;
+	callbacks->addbatch = loading_addrdatasets;
 	callbacks->add_private = loadctx;
 	callbacks->deserialize = deserialize32;
 	callbacks->deserialize_private = loadctx;
@@ -7443,10 +7682,12 @@ endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 		iszonesecure(db, rbtdb->current_version, rbtdb->origin_node);
 
 	callbacks->add = NULL;
+	callbacks->addbatch = NULL;
 	callbacks->add_private = NULL;
 	callbacks->deserialize = NULL;
 	callbacks->deserialize_private = NULL;
 
+	DESTROYLOCK(&loadctx->lock);
 	isc_mem_put(rbtdb->common.mctx, loadctx, sizeof(*loadctx));
 
 	return (ISC_R_SUCCESS);
@@ -7605,6 +7846,95 @@ rbtdb_write_header(FILE *rbtfile, off_t tree_location, off_t nsec_location,
 	return (result);
 }
 
+/*
+ * Choose the address a map image of 'rbtdb' should be prelinked for.
+ * Zones are spread over 64K slots of 1GB in a 64TB window, by a hash of
+ * their name, so that different zones rarely want the same address; if
+ * they do, or the address is otherwise unavailable, the image is simply
+ * relocated at load time.  There is no room for this on 32-bit systems.
+ */
+static isc_uint64_t
+rbtdb_mapbase(dns_rbtdb_t *rbtdb) {
+	isc_uint64_t slot;
+
+	if (sizeof(void *) < 8)
+		return (0);
+
+	slot = dns_name_hash(&rbtdb->common.origin, ISC_FALSE) & 0xffff;
+	return (((isc_uint64_t) 1 << 44) + (slot << 30));
+}
+
+/*
+ * Resolve the image just written to 'rbtfile' for the address chosen by
+ * rbtdb_mapbase(), so that deserialize32() has nothing to write when it
+ * gets that address: the zone then loads without copying any of the
+ * image, and every process (or reload) mapping the same file shares its
+ * pages.  This is an optimization only; if the file cannot be mapped
+ * for writing, the image is left as it is.
+ */
+static isc_result_t
+prelink(dns_rbtdb_t *rbtdb, FILE *rbtfile, off_t header_location) {
+#if defined(HAVE_MMAP) && defined(MAP_SHARED)
+	isc_result_t result = ISC_R_SUCCESS;
+	rbtdb_file_header_t *header;
+	isc_uint64_t mapbase;
+	off_t filesize = 0;
+	char *base;
+	int fd, flags;
+
+	mapbase = rbtdb_mapbase(rbtdb);
+	if (mapbase == 0)
+		return (ISC_R_SUCCESS);
+
+	if (fflush(rbtfile) != 0)
+		return (ISC_R_SUCCESS);
+	fd = fileno(rbtfile);
+	result = isc_file_getsizefd(fd, &filesize);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	flags = MAP_SHARED;
+#ifdef MAP_FILE
+	flags |= MAP_FILE;
+#endif
+	base = isc_file_mmap(NULL, (size_t) filesize, PROT_READ|PROT_WRITE,
+			     flags, fd, 0);
+	if (base == NULL || base == MAP_FAILED)
+		return (ISC_R_SUCCESS);
+
+	header = (rbtdb_file_header_t *)(base + header_location);
+	if (header->tree != 0)
+		CHECK(dns_rbt_prelink_tree(base, (size_t) filesize,
+					   (off_t) header->tree, mapbase,
+					   rbtdb->common.mctx,
+					   rbt_datafixer, NULL,
+					   rbt_datarebaser, NULL));
+	if (header->nsec != 0)
+		CHECK(dns_rbt_prelink_tree(base, (size_t) filesize,
+					   (off_t) header->nsec, mapbase,
+					   rbtdb->common.mctx,
+					   rbt_datafixer, NULL,
+					   rbt_datarebaser, NULL));
+	if (header->nsec3 != 0)
+		CHECK(dns_rbt_prelink_tree(base, (size_t) filesize,
+					   (off_t) header->nsec3, mapbase,
+					   rbtdb->common.mctx,
+					   rbt_datafixer, NULL,
+					   rbt_datarebaser, NULL));
+	header->mapbase = mapbase;
+
+ failure:
+	isc_file_munmap(base, (size_t) filesize);
+	return (result);
+#else
+	UNUSED(rbtdb);
+	UNUSED(rbtfile);
+	UNUSED(header_location);
+
+	return (ISC_R_SUCCESS);
+#endif
+}
+
 static isc_result_t
 serialize(dns_db_t *db, dns_dbversion_t *ver, FILE *rbtfile) {
 	rbtdb_version_t *version = (rbtdb_version_t *) ver;
@@ -7644,6 +7974,7 @@ serialize(dns_db_t *db, dns_dbversion_t *ver, FILE *rbtfile) {
 	CHECK(isc_stdio_seek(rbtfile, header_location, SEEK_SET));
 	CHECK(rbtdb_write_header(rbtfile, tree_location, nsec_location,
 				 nsec3_location));
+	CHECK(prelink(rbtdb, rbtfile, header_location));
  failure:
 	return (result);
 }
@@ -7746,6 +8077,22 @@ hashsize(dns_db_t *db) {
 	return (size);
 }
 
+static size_t
+hashpending(dns_db_t *db) {
+	dns_rbtdb_t *rbtdb;
+	size_t pending;
+
+	rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	pending = dns_rbt_hashpending(rbtdb->tree);
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+
+	return (pending);
+}
+
 static void
 settask(dns_db_t *db, isc_task_t *task) {
 	dns_rbtdb_t *rbtdb;
@@ -8076,7 +8423,8 @@ static dns_dbmethods_t zone_methods = {
 	NULL,
 	hashsize,
 	nodefullname,
-	getsize
+	getsize,
+	hashpending
 };
 
 static dns_dbmethods_t cache_methods = {
@@ -8124,9 +8472,30 @@ static dns_dbmethods_t cache_methods = {
 	setcachestats,
 	hashsize,
 	nodefullname,
-	NULL
+	NULL,
+	hashpending
 };
 
+/*
+ * Choose the number of node locks (and LRU lists and TTL heaps) for a
+ * cache database, scaling with the number of CPUs.
+ */
+static unsigned int
+cache_node_lock_count(void) {
+#ifdef DNS_RBTDB_CACHE_NODE_LOCK_COUNT
+	return (DEFAULT_CACHE_NODE_LOCK_COUNT);
+#else
+	unsigned int count;
+
+	count = isc_os_ncpus() * CACHE_NODE_LOCKS_PER_CPU;
+	if (count < DEFAULT_CACHE_NODE_LOCK_COUNT)
+		count = DEFAULT_CACHE_NODE_LOCK_COUNT;
+	if (count > MAX_CACHE_NODE_LOCK_COUNT)
+		count = MAX_CACHE_NODE_LOCK_COUNT;
+	return (count);
+#endif
+}
+
 isc_result_t
 #ifdef DNS_RBTDB_VERSION64
 dns_rbtdb64_create
@@ -8189,7 +8558,7 @@ dns_rbtdb_create
 	 */
 	if (rbtdb->node_lock_count == 0) {
 		if (IS_CACHE(rbtdb))
-			rbtdb->node_lock_count = DEFAULT_CACHE_NODE_LOCK_COUNT;
+			rbtdb->node_lock_count = cache_node_lock_count();
 		else
 			rbtdb->node_lock_count = DEFAULT_NODE_LOCK_COUNT;
 	} else if (rbtdb->node_lock_count < 2 && IS_CACHE(rbtdb)) {
@@ -8392,6 +8761,7 @@ dns_rbtdb_create
 	}
 	rbtdb->attributes = 0;
 	rbtdb->task = NULL;
+	rbtdb->deadnodes_scheduled = ISC_FALSE;
 
 	/*
 	 * Version Initialization.
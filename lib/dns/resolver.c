@@ -177,6 +177,18 @@
 #endif
 #define RES_NOBUCKET		0xffffffff
 
+/*%
+ * Initial and maximum sizes of the per-bucket fetch context index.
+ * The index doubles when a bucket holds more than two fetch contexts
+ * per slot, and halves again when it drops below one per eight.
+ */
+#ifndef RES_FCTX_TABLE_MINSIZE
+#define RES_FCTX_TABLE_MINSIZE	64
+#endif
+#ifndef RES_FCTX_TABLE_MAXSIZE
+#define RES_FCTX_TABLE_MAXSIZE	65536
+#endif
+
 /*%
  * Maximum EDNS0 input packet size.
  */
@@ -258,6 +270,7 @@ struct fetchctx {
 	dns_rdatatype_t			type;
 	unsigned int			options;
 	unsigned int			bucketnum;
+	unsigned int			hashval;
 	unsigned int			dbucketnum;
 	char *				info;
 	isc_mem_t *			mctx;
@@ -270,6 +283,7 @@ struct fetchctx {
 	unsigned int			references;
 	isc_event_t			control_event;
 	ISC_LINK(struct fetchctx)       link;
+	fetchctx_t *			hashnext;
 	ISC_LIST(dns_fetchevent_t)      events;
 	/*% Locked by task event serialization. */
 	dns_name_t			domain;
@@ -416,6 +430,9 @@ typedef struct fctxbucket {
 	isc_task_t *			task;
 	isc_mutex_t			lock;
 	ISC_LIST(fetchctx_t)		fctxs;
+	fetchctx_t **			table;
+	unsigned int			tablesize;
+	unsigned int			count;
 	isc_boolean_t			exiting;
 	isc_mem_t *			mctx;
 } fctxbucket_t;
@@ -509,6 +526,7 @@ struct dns_resolver {
 	dns_fetch_t *			primefetch;
 	/* Locked by nlock. */
 	unsigned int			nfctx;
+	unsigned int			bucketpeak;
 };
 
 #define RES_MAGIC			ISC_MAGIC('R', 'e', 's', '!')
@@ -4031,6 +4049,89 @@ fctx_try(fetchctx_t *fctx, isc_boolean_t retrying, isc_boolean_t badcache) {
 		inc_stats(res, dns_resstatscounter_retry);
 }
 
+/*
+ * Fetch context index.  Each bucket keeps its fetch contexts on the
+ * 'fctxs' list, which is walked at shutdown, and in a chained hash
+ * table keyed by name, type and options so that joining an existing
+ * fetch does not have to scan every fetch in the bucket.  The table
+ * is resized as the bucket fills and drains.
+ *
+ * Caller must be holding the bucket lock.
+ */
+static inline unsigned int
+fctx_hash(unsigned int namehash, dns_rdatatype_t type, unsigned int options) {
+	return (namehash ^ (type * 0x9e3779b1U) ^ (options * 0x85ebca6bU));
+}
+
+static void
+fctx_resizetable(dns_resolver_t *res, fctxbucket_t *bucket,
+		 unsigned int newsize)
+{
+	fetchctx_t **newtable;
+	fetchctx_t *fctx, *next;
+	unsigned int i, slot;
+
+	newtable = isc_mem_get(bucket->mctx, newsize * sizeof(*newtable));
+	if (newtable == NULL) {
+		/*
+		 * Keep the current table; only lookups get slower.
+		 */
+		return;
+	}
+	memset(newtable, 0, newsize * sizeof(*newtable));
+
+	for (i = 0; i < bucket->tablesize; i++) {
+		for (fctx = bucket->table[i]; fctx != NULL; fctx = next) {
+			next = fctx->hashnext;
+			slot = fctx->hashval & (newsize - 1);
+			fctx->hashnext = newtable[slot];
+			newtable[slot] = fctx;
+		}
+	}
+
+	isc_mem_put(bucket->mctx, bucket->table,
+		    bucket->tablesize * sizeof(*bucket->table));
+	bucket->table = newtable;
+	bucket->tablesize = newsize;
+
+	inc_stats(res, dns_resstatscounter_bucketresize);
+}
+
+static void
+fctx_tableadd(dns_resolver_t *res, fctxbucket_t *bucket, fetchctx_t *fctx) {
+	unsigned int slot;
+
+	if (bucket->count >= bucket->tablesize * 2 &&
+	    bucket->tablesize < RES_FCTX_TABLE_MAXSIZE)
+		fctx_resizetable(res, bucket, bucket->tablesize * 2);
+
+	slot = fctx->hashval & (bucket->tablesize - 1);
+	fctx->hashnext = bucket->table[slot];
+	bucket->table[slot] = fctx;
+	bucket->count++;
+}
+
+static void
+fctx_tableremove(dns_resolver_t *res, fctxbucket_t *bucket,
+		 fetchctx_t *fctx)
+{
+	fetchctx_t **fctxp;
+
+	fctxp = &bucket->table[fctx->hashval & (bucket->tablesize - 1)];
+	while (*fctxp != fctx) {
+		INSIST(*fctxp != NULL);
+		fctxp = &(*fctxp)->hashnext;
+	}
+	*fctxp = fctx->hashnext;
+	fctx->hashnext = NULL;
+	INSIST(bucket->count > 0);
+	bucket->count--;
+
+	if (bucket->count < bucket->tablesize / 8 &&
+	    bucket->tablesize > RES_FCTX_TABLE_MINSIZE)
+		fctx_resizetable(res, bucket, bucket->tablesize / 2);
+}
+
 static isc_boolean_t
 fctx_unlink(fetchctx_t *fctx) {
 	dns_resolver_t *res;
@@ -4057,6 +4158,7 @@ fctx_unlink(fetchctx_t *fctx) {
 	bucketnum = fctx->bucketnum;
 
 	ISC_LIST_UNLINK(res->buckets[bucketnum].fctxs, fctx, link);
+	fctx_tableremove(res, &res->buckets[bucketnum], fctx);
 
 	LOCK(&res->nlock);
 	res->nfctx--;
@@ -4456,8 +4558,8 @@ log_ns_ttl(fetchctx_t *fctx, const char *where) {
 static isc_result_t
 fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	    const dns_name_t *domain, dns_rdataset_t *nameservers,
-	    unsigned int options, unsigned int bucketnum, unsigned int depth,
-	    isc_counter_t *qc, fetchctx_t **fctxp)
+	    unsigned int options, unsigned int bucketnum, unsigned int hashval,
+	    unsigned int depth, isc_counter_t *qc, fetchctx_t **fctxp)
 {
 	fetchctx_t *fctx;
 	isc_result_t result;
@@ -4521,6 +4623,8 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	fctx->res = res;
 	fctx->references = 0;
 	fctx->bucketnum = bucketnum;
+	fctx->hashval = hashval;
+	fctx->hashnext = NULL;
 	fctx->dbucketnum = RES_NOBUCKET;
 	fctx->state = fetchstate_init;
 	fctx->want_shutdown = ISC_FALSE;
@@ -4720,9 +4824,16 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	fctx->magic = FCTX_MAGIC;
 
 	ISC_LIST_APPEND(res->buckets[bucketnum].fctxs, fctx, link);
+	fctx_tableadd(res, &res->buckets[bucketnum], fctx);
 
 	LOCK(&res->nlock);
 	res->nfctx++;
+	if (res->buckets[bucketnum].count > res->bucketpeak) {
+		res->bucketpeak = res->buckets[bucketnum].count;
+		if (res->view->resstats != NULL)
+			isc_stats_set(res->view->resstats, res->bucketpeak,
+				      dns_resstatscounter_bucketpeak);
+	}
 	UNLOCK(&res->nlock);
 	inc_stats(res, dns_resstatscounter_nfetch);
 
@@ -9426,6 +9537,10 @@ destroy(dns_resolver_t *res) {
 	DESTROYLOCK(&res->lock);
 	for (i = 0; i < res->nbuckets; i++) {
 		INSIST(ISC_LIST_EMPTY(res->buckets[i].fctxs));
+		INSIST(res->buckets[i].count == 0);
+		isc_mem_put(res->buckets[i].mctx, res->buckets[i].table,
+			    res->buckets[i].tablesize *
+			    sizeof(*res->buckets[i].table));
 		isc_task_shutdown(res->buckets[i].task);
 		isc_task_detach(&res->buckets[i].task);
 		DESTROYLOCK(&res->buckets[i].lock);
@@ -9632,6 +9747,21 @@ dns_resolver_create(dns_view_t *view,
 #else
 		isc_mem_attach(view->mctx, &res->buckets[i].mctx);
 #endif
+		res->buckets[i].table =
+			isc_mem_get(res->buckets[i].mctx,
+				    RES_FCTX_TABLE_MINSIZE *
+				    sizeof(*res->buckets[i].table));
+		if (res->buckets[i].table == NULL) {
+			isc_mem_detach(&res->buckets[i].mctx);
+			isc_task_detach(&res->buckets[i].task);
+			DESTROYLOCK(&res->buckets[i].lock);
+			result = ISC_R_NOMEMORY;
+			goto cleanup_buckets;
+		}
+		memset(res->buckets[i].table, 0,
+		       RES_FCTX_TABLE_MINSIZE * sizeof(*res->buckets[i].table));
+		res->buckets[i].tablesize = RES_FCTX_TABLE_MINSIZE;
+		res->buckets[i].count = 0;
 		isc_task_setname(res->buckets[i].task, name, res);
 		ISC_LIST_INIT(res->buckets[i].fctxs);
 		res->buckets[i].exiting = ISC_FALSE;
@@ -9683,6 +9813,7 @@ dns_resolver_create(dns_view_t *view,
 	res->priming = ISC_FALSE;
 	res->primefetch = NULL;
 	res->nfctx = 0;
+	res->bucketpeak = 0;
 
 	result = isc_mutex_init(&res->lock);
 	if (result != ISC_R_SUCCESS)
@@ -9762,6 +9893,9 @@ dns_resolver_create(dns_view_t *view,
 
  cleanup_buckets:
 	for (i = 0; i < buckets_created; i++) {
+		isc_mem_put(res->buckets[i].mctx, res->buckets[i].table,
+			    res->buckets[i].tablesize *
+			    sizeof(*res->buckets[i].table));
 		isc_mem_detach(&res->buckets[i].mctx);
 		DESTROYLOCK(&res->buckets[i].lock);
 		isc_task_shutdown(res->buckets[i].task);
@@ -10106,7 +10240,8 @@ dns_resolver_createfetch3(dns_resolver_t *res, const dns_name_t *name,
 	dns_fetch_t *fetch;
 	fetchctx_t *fctx = NULL;
 	isc_result_t result = ISC_R_SUCCESS;
-	unsigned int bucketnum;
+	fctxbucket_t *bucket;
+	unsigned int bucketnum, namehash, hashval;
 	isc_boolean_t new_fctx = ISC_FALSE;
 	isc_event_t *event;
 	unsigned int count = 0;
@@ -10141,7 +10276,10 @@ dns_resolver_createfetch3(dns_resolver_t *res, const dns_name_t *name,
 	fetch->mctx = NULL;
 	isc_mem_attach(res->mctx, &fetch->mctx);
 
-	bucketnum = dns_name_fullhash(name, ISC_FALSE) % res->nbuckets;
+	namehash = dns_name_fullhash(name, ISC_FALSE);
+	bucketnum = namehash % res->nbuckets;
+	hashval = fctx_hash(namehash, type, options);
+	bucket = &res->buckets[bucketnum];
 
 	LOCK(&res->lock);
 	spillat = res->spillat;
@@ -10155,10 +10293,11 @@ dns_resolver_createfetch3(dns_resolver_t *res, const dns_name_t *name,
 	}
 
 	if ((options & DNS_FETCHOPT_UNSHARED) == 0) {
-		for (fctx = ISC_LIST_HEAD(res->buckets[bucketnum].fctxs);
+		for (fctx = bucket->table[hashval & (bucket->tablesize - 1)];
 		     fctx != NULL;
-		     fctx = ISC_LIST_NEXT(fctx, link)) {
-			if (fctx_match(fctx, name, type, options))
+		     fctx = fctx->hashnext) {
+			if (fctx->hashval == hashval &&
+			    fctx_match(fctx, name, type, options))
 				break;
 		}
 	}
@@ -10191,7 +10330,8 @@ dns_resolver_createfetch3(dns_resolver_t *res, const dns_name_t *name,
 
 	if (fctx == NULL) {
 		result = fctx_create(res, name, type, domain, nameservers,
-				     options, bucketnum, depth, qc, &fctx);
+				     options, bucketnum, hashval, depth, qc,
+				     &fctx);
 		if (result != ISC_R_SUCCESS)
 			goto unlock;
 		new_fctx = ISC_TRUE;
@@ -18,7 +18,9 @@
 #include <isc/mem.h>
 #include <isc/net.h>
 #include <isc/netaddr.h>
+#include <isc/os.h>
 #include <isc/print.h>
+#include <isc/util.h>
 
 #include <dns/result.h>
 #include <dns/rcode.h>
@@ -28,9 +30,17 @@
 #include <dns/rrl.h>
 #include <dns/view.h>
 
+/*
+ * The number of shards scales with the number of CPUs.
+ */
+#define RRL_SHARDS_PER_CPU	4
+#define RRL_MAX_SHARDS		256
+
+#define SHARD_INDEX(rrl, shard)	((unsigned int)((shard) - (rrl)->shards))
+
 static void
-log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_boolean_t early,
-	char *log_buf, unsigned int log_buf_len);
+log_end(dns_rrl_t *rrl, dns_rrl_shard_t *shard, dns_rrl_entry_t *e,
+	isc_boolean_t early, char *log_buf, unsigned int log_buf_len);
 
 /*
  * Get a modulus for a hash function that is tolerably likely to be
@@ -123,20 +133,22 @@ delta_rrl_time(isc_stdtime_t ts, isc_stdtime_t now) {
 }
 
 static inline int
-get_age(const dns_rrl_t *rrl, const dns_rrl_entry_t *e, isc_stdtime_t now) {
+get_age(const dns_rrl_shard_t *shard, const dns_rrl_entry_t *e,
+	isc_stdtime_t now)
+{
 	if (!e->ts_valid)
 		return (DNS_RRL_FOREVER);
-	return (delta_rrl_time(e->ts + rrl->ts_bases[e->ts_gen], now));
+	return (delta_rrl_time(e->ts + shard->ts_bases[e->ts_gen], now));
 }
 
 static inline void
-set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
+set_age(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	dns_rrl_entry_t *e_old;
 	unsigned int ts_gen;
 	int i, ts;
 
-	ts_gen = rrl->ts_gen;
-	ts = now - rrl->ts_bases[ts_gen];
+	ts_gen = shard->ts_gen;
+	ts = now - shard->ts_bases[ts_gen];
 	if (ts < 0) {
 		if (ts < -DNS_RRL_MAX_TIME_TRAVEL)
 			ts = DNS_RRL_FOREVER;
@@ -158,7 +170,7 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	 */
 	if (ts >= DNS_RRL_MAX_TS) {
 		ts_gen = (ts_gen + 1) % DNS_RRL_TS_BASES;
-		for (e_old = ISC_LIST_TAIL(rrl->lru), i = 0;
+		for (e_old = ISC_LIST_TAIL(shard->lru), i = 0;
 		     e_old != NULL && (e_old->ts_gen == ts_gen ||
 				       !ISC_LINK_LINKED(e_old, hlink));
 		     e_old = ISC_LIST_PREV(e_old, lru), ++i)
@@ -170,15 +182,15 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 				      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DEBUG1,
 				      "rrl new time base scanned %d entries"
 				      " at %d for %d %d %d %d",
-				      i, now, rrl->ts_bases[ts_gen],
-				      rrl->ts_bases[(ts_gen + 1) %
+				      i, now, shard->ts_bases[ts_gen],
+				      shard->ts_bases[(ts_gen + 1) %
 					DNS_RRL_TS_BASES],
-				      rrl->ts_bases[(ts_gen + 2) %
+				      shard->ts_bases[(ts_gen + 2) %
 					DNS_RRL_TS_BASES],
-				      rrl->ts_bases[(ts_gen + 3) %
+				      shard->ts_bases[(ts_gen + 3) %
 					DNS_RRL_TS_BASES]);
-		rrl->ts_gen = ts_gen;
-		rrl->ts_bases[ts_gen] = now;
+		shard->ts_gen = ts_gen;
+		shard->ts_bases[ts_gen] = now;
 		ts = 0;
 	}
 
@@ -187,37 +199,48 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	e->ts_valid = ISC_TRUE;
 }
 
+/*
+ * Add entries to a shard.  max-table-size limits the entries in all of
+ * the shards together, so that a shard with busy clients can use the
+ * room that quiet shards do not need.
+ */
 static isc_result_t
-expand_entries(dns_rrl_t *rrl, int newsize) {
+expand_entries(dns_rrl_t *rrl, dns_rrl_shard_t *shard, int newsize) {
 	unsigned int bsize;
 	dns_rrl_block_t *b;
 	dns_rrl_entry_t *e;
 	double rate;
 	int i;
 
+	LOCK(&rrl->lock);
 	if (rrl->num_entries + newsize >= rrl->max_entries &&
 	    rrl->max_entries != 0)
 	{
 		newsize = rrl->max_entries - rrl->num_entries;
-		if (newsize <= 0)
+		if (newsize <= 0) {
+			UNLOCK(&rrl->lock);
 			return (ISC_R_SUCCESS);
+		}
 	}
+	rrl->num_entries += newsize;
+	UNLOCK(&rrl->lock);
 
 	/*
 	 * Log expansions so that the user can tune max-table-size
 	 * and min-table-size.
 	 */
 	if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DROP) &&
-	    rrl->hash != NULL) {
-		rate = rrl->probes;
-		if (rrl->searches != 0)
-			rate /= rrl->searches;
+	    shard->hash != NULL) {
+		rate = shard->probes;
+		if (shard->searches != 0)
+			rate /= shard->searches;
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DROP,
-			      "increase from %d to %d RRL entries with"
-			      " %d bins; average search length %.1f",
-			      rrl->num_entries, rrl->num_entries+newsize,
-			      rrl->hash->length, rate);
+			      "increase shard %u from %d to %d RRL entries"
+			      " with %d bins; average search length %.1f",
+			      SHARD_INDEX(rrl, shard), shard->num_entries,
+			      shard->num_entries+newsize,
+			      shard->hash->length, rate);
 	}
 
 	bsize = sizeof(dns_rrl_block_t) + (newsize-1)*sizeof(dns_rrl_entry_t);
@@ -227,6 +250,9 @@ expand_entries(dns_rrl_t *rrl, int newsize) {
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_FAIL,
 			      "isc_mem_get(%d) failed for RRL entries",
 			      bsize);
+		LOCK(&rrl->lock);
+		rrl->num_entries -= newsize;
+		UNLOCK(&rrl->lock);
 		return (ISC_R_NOMEMORY);
 	}
 	memset(b, 0, bsize);
@@ -235,10 +261,10 @@ expand_entries(dns_rrl_t *rrl, int newsize) {
 	e = b->entries;
 	for (i = 0; i < newsize; ++i, ++e) {
 		ISC_LINK_INIT(e, hlink);
-		ISC_LIST_INITANDAPPEND(rrl->lru, e, lru);
+		ISC_LIST_INITANDAPPEND(shard->lru, e, lru);
 	}
-	rrl->num_entries += newsize;
-	ISC_LIST_INITANDAPPEND(rrl->blocks, b, link);
+	shard->num_entries += newsize;
+	ISC_LIST_INITANDAPPEND(shard->blocks, b, link);
 
 	return (ISC_R_SUCCESS);
 }
@@ -250,12 +276,12 @@ get_bin(dns_rrl_hash_t *hash, unsigned int hval) {
 }
 
 static void
-free_old_hash(dns_rrl_t *rrl) {
+free_old_hash(dns_rrl_t *rrl, dns_rrl_shard_t *shard) {
 	dns_rrl_hash_t *old_hash;
 	dns_rrl_bin_t *old_bin;
 	dns_rrl_entry_t *e, *e_next;
 
-	old_hash = rrl->old_hash;
+	old_hash = shard->old_hash;
 	for (old_bin = &old_hash->bins[0];
 	     old_bin < &old_hash->bins[old_hash->length];
 	     ++old_bin)
@@ -269,26 +295,26 @@ free_old_hash(dns_rrl_t *rrl) {
 	isc_mem_put(rrl->mctx, old_hash,
 		    sizeof(*old_hash)
 		      + (old_hash->length - 1) * sizeof(old_hash->bins[0]));
-	rrl->old_hash = NULL;
+	shard->old_hash = NULL;
 }
 
 static isc_result_t
-expand_rrl_hash(dns_rrl_t *rrl, isc_stdtime_t now) {
+expand_rrl_hash(dns_rrl_t *rrl, dns_rrl_shard_t *shard, isc_stdtime_t now) {
 	dns_rrl_hash_t *hash;
 	int old_bins, new_bins, hsize;
 	double rate;
 
-	if (rrl->old_hash != NULL)
-		free_old_hash(rrl);
+	if (shard->old_hash != NULL)
+		free_old_hash(rrl, shard);
 
 	/*
 	 * Most searches fail and so go to the end of the chain.
 	 * Use a small hash table load factor.
 	 */
-	old_bins = (rrl->hash == NULL) ? 0 : rrl->hash->length;
+	old_bins = (shard->hash == NULL) ? 0 : shard->hash->length;
 	new_bins = old_bins/8 + old_bins;
-	if (new_bins < rrl->num_entries)
-		new_bins = rrl->num_entries;
+	if (new_bins < shard->num_entries)
+		new_bins = shard->num_entries;
 	new_bins = hash_divisor(new_bins);
 
 	hsize = sizeof(dns_rrl_hash_t) + (new_bins-1)*sizeof(hash->bins[0]);
@@ -303,38 +329,41 @@ expand_rrl_hash(dns_rrl_t *rrl, isc_stdtime_t now) {
 	}
 	memset(hash, 0, hsize);
 	hash->length = new_bins;
-	rrl->hash_gen ^= 1;
-	hash->gen = rrl->hash_gen;
+	shard->hash_gen ^= 1;
+	hash->gen = shard->hash_gen;
 
 	if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DROP) && old_bins != 0) {
-		rate = rrl->probes;
-		if (rrl->searches != 0)
-			rate /= rrl->searches;
+		rate = shard->probes;
+		if (shard->searches != 0)
+			rate /= shard->searches;
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DROP,
-			      "increase from %d to %d RRL bins for"
+			      "increase shard %u from %d to %d RRL bins for"
 			      " %d entries; average search length %.1f",
-			      old_bins, new_bins, rrl->num_entries, rate);
+			      SHARD_INDEX(rrl, shard), old_bins, new_bins,
+			      shard->num_entries, rate);
 	}
 
-	rrl->old_hash = rrl->hash;
-	if (rrl->old_hash != NULL)
-		rrl->old_hash->check_time = now;
-	rrl->hash = hash;
+	shard->old_hash = shard->hash;
+	if (shard->old_hash != NULL)
+		shard->old_hash->check_time = now;
+	shard->hash = hash;
 
 	return (ISC_R_SUCCESS);
 }
 
 static void
-ref_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, int probes, isc_stdtime_t now) {
+ref_entry(dns_rrl_t *rrl, dns_rrl_shard_t *shard, dns_rrl_entry_t *e,
+	  int probes, isc_stdtime_t now)
+{
 	/*
 	 * Make the entry most recently used.
 	 */
-	if (ISC_LIST_HEAD(rrl->lru) != e) {
-		if (e == rrl->last_logged)
-			rrl->last_logged = ISC_LIST_PREV(e, lru);
-		ISC_LIST_UNLINK(rrl->lru, e, lru);
-		ISC_LIST_PREPEND(rrl->lru, e, lru);
+	if (ISC_LIST_HEAD(shard->lru) != e) {
+		if (e == shard->last_logged)
+			shard->last_logged = ISC_LIST_PREV(e, lru);
+		ISC_LIST_UNLINK(shard->lru, e, lru);
+		ISC_LIST_PREPEND(shard->lru, e, lru);
 	}
 
 	/*
@@ -343,15 +372,15 @@ ref_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, int probes, isc_stdtime_t now) {
 	 * old hash table.  It will migrate to the new hash table the next
 	 * time it is used or be cut loose when the old hash table is destroyed.
 	 */
-	rrl->probes += probes;
-	++rrl->searches;
-	if (rrl->searches > 100 &&
-	    delta_rrl_time(rrl->hash->check_time, now) > 1) {
-		if (rrl->probes/rrl->searches > 2)
-			expand_rrl_hash(rrl, now);
-		rrl->hash->check_time = now;
-		rrl->probes = 0;
-		rrl->searches = 0;
+	shard->probes += probes;
+	++shard->searches;
+	if (shard->searches > 100 &&
+	    delta_rrl_time(shard->hash->check_time, now) > 1) {
+		if (shard->probes/shard->searches > 2)
+			expand_rrl_hash(rrl, shard, now);
+		shard->hash->check_time = now;
+		shard->probes = 0;
+		shard->searches = 0;
 	}
 }
 
@@ -440,6 +469,32 @@ make_key(const dns_rrl_t *rrl, dns_rrl_key_t *key,
 	}
 }
 
+/*
+ * Find the shard for a client from its address prefix, masked as in
+ * make_key().
+ */
+static inline dns_rrl_shard_t *
+get_shard(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr) {
+	isc_uint32_t ip[DNS_RRL_MAX_PREFIX/32];
+	isc_uint32_t hval = 0;
+	int i;
+
+	switch (client_addr->type.sa.sa_family) {
+	case AF_INET:
+		hval = (client_addr->type.sin.sin_addr.s_addr &
+			rrl->ipv4_mask);
+		break;
+	case AF_INET6:
+		memmove(ip, &client_addr->type.sin6.sin6_addr, sizeof(ip));
+		for (i = 0; i < DNS_RRL_MAX_PREFIX/32; ++i)
+			hval = (hval ^ (ip[i] & rrl->ipv6_mask[i])) *
+			       0x9e3779b1U;
+		break;
+	}
+	hval *= 0x9e3779b1U;
+	return (&rrl->shards[(hval >> 16) & (rrl->nshards - 1)]);
+}
+
 static inline dns_rrl_rate_t *
 get_rate(dns_rrl_t *rrl, dns_rrl_rtype_t rtype) {
 	switch (rtype) {
@@ -462,15 +517,20 @@ get_rate(dns_rrl_t *rrl, dns_rrl_rtype_t rtype) {
 }
 
 static int
-response_balance(dns_rrl_t *rrl, const dns_rrl_entry_t *e, int age) {
+response_balance(dns_rrl_t *rrl, const dns_rrl_shard_t *shard,
+		 const dns_rrl_entry_t *e, int age)
+{
 	dns_rrl_rate_t *ratep;
 	int balance, rate;
 
 	if (e->key.s.rtype == DNS_RRL_RTYPE_TCP) {
 		rate = 1;
 	} else {
-		ratep = get_rate(rrl, e->key.s.rtype);
-		rate = ratep->scaled;
+		rate = shard->scaled[e->key.s.rtype];
+		if (rate == 0) {
+			ratep = get_rate(rrl, e->key.s.rtype);
+			rate = ratep->scaled;
+		}
 	}
 
 	balance = e->responses + age * rate;
@@ -483,7 +543,8 @@ response_balance(dns_rrl_t *rrl, const dns_rrl_entry_t *e, int age) {
  * Search for an entry for a response and optionally create it.
  */
 static dns_rrl_entry_t *
-get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
+get_entry(dns_rrl_t *rrl, dns_rrl_shard_t *shard,
+	  const isc_sockaddr_t *client_addr,
 	  dns_rdataclass_t qclass, dns_rdatatype_t qtype,
 	  const dns_name_t *qname, dns_rrl_rtype_t rtype, isc_stdtime_t now,
 	  isc_boolean_t create, char *log_buf, unsigned int log_buf_len)
@@ -501,12 +562,12 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 	/*
 	 * Look for the entry in the current hash table.
 	 */
-	new_bin = get_bin(rrl->hash, hval);
+	new_bin = get_bin(shard->hash, hval);
 	probes = 1;
 	e = ISC_LIST_HEAD(*new_bin);
 	while (e != NULL) {
 		if (key_cmp(&e->key, &key)) {
-			ref_entry(rrl, e, probes, now);
+			ref_entry(rrl, shard, e, probes, now);
 			return (e);
 		}
 		++probes;
@@ -516,15 +577,15 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 	/*
 	 * Look in the old hash table.
 	 */
-	if (rrl->old_hash != NULL) {
-		old_bin = get_bin(rrl->old_hash, hval);
+	if (shard->old_hash != NULL) {
+		old_bin = get_bin(shard->old_hash, hval);
 		e = ISC_LIST_HEAD(*old_bin);
 		while (e != NULL) {
 			if (key_cmp(&e->key, &key)) {
 				ISC_LIST_UNLINK(*old_bin, e, hlink);
 				ISC_LIST_PREPEND(*new_bin, e, hlink);
-				e->hash_gen = rrl->hash_gen;
-				ref_entry(rrl, e, probes, now);
+				e->hash_gen = shard->hash_gen;
+				ref_entry(rrl, shard, e, probes, now);
 				return (e);
 			}
 			e = ISC_LIST_NEXT(e, hlink);
@@ -533,9 +594,9 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 		/*
 		 * Discard prevous hash table when all of its entries are old.
 		 */
-		age = delta_rrl_time(rrl->old_hash->check_time, now);
+		age = delta_rrl_time(shard->old_hash->check_time, now);
 		if (age > rrl->window)
-			free_old_hash(rrl);
+			free_old_hash(rrl, shard);
 	}
 
 	if (!create)
@@ -547,39 +608,40 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 	 * Try to make more entries if none are idle.
 	 * Steal the oldest entry if we cannot create more.
 	 */
-	for (e = ISC_LIST_TAIL(rrl->lru);
+	for (e = ISC_LIST_TAIL(shard->lru);
 	     e != NULL;
 	     e = ISC_LIST_PREV(e, lru))
 	{
 		if (!ISC_LINK_LINKED(e, hlink))
 			break;
-		age = get_age(rrl, e, now);
+		age = get_age(shard, e, now);
 		if (age <= 1) {
 			e = NULL;
 			break;
 		}
-		if (!e->logged && response_balance(rrl, e, age) > 0)
+		if (!e->logged && response_balance(rrl, shard, e, age) > 0)
 			break;
 	}
 	if (e == NULL) {
-		expand_entries(rrl, ISC_MIN((rrl->num_entries+1)/2, 1000));
-		e = ISC_LIST_TAIL(rrl->lru);
+		expand_entries(rrl, shard,
+			       ISC_MIN((shard->num_entries+1)/2, 1000));
+		e = ISC_LIST_TAIL(shard->lru);
 	}
 	if (e->logged)
-		log_end(rrl, e, ISC_TRUE, log_buf, log_buf_len);
+		log_end(rrl, shard, e, ISC_TRUE, log_buf, log_buf_len);
 	if (ISC_LINK_LINKED(e, hlink)) {
-		if (e->hash_gen == rrl->hash_gen)
-			hash = rrl->hash;
+		if (e->hash_gen == shard->hash_gen)
+			hash = shard->hash;
 		else
-			hash = rrl->old_hash;
+			hash = shard->old_hash;
 		old_bin = get_bin(hash, hash_key(&e->key));
 		ISC_LIST_UNLINK(*old_bin, e, hlink);
 	}
 	ISC_LIST_PREPEND(*new_bin, e, hlink);
-	e->hash_gen = rrl->hash_gen;
+	e->hash_gen = shard->hash_gen;
 	e->key = key;
 	e->ts_valid = ISC_FALSE;
-	ref_entry(rrl, e, probes, now);
+	ref_entry(rrl, shard, e, probes, now);
 	return (e);
 }
 
@@ -601,9 +663,9 @@ debit_log(const dns_rrl_entry_t *e, int age, const char *action) {
 }
 
 static inline dns_rrl_result_t
-debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
-		const isc_sockaddr_t *client_addr, isc_stdtime_t now,
-		char *log_buf, unsigned int log_buf_len)
+debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_shard_t *shard, dns_rrl_entry_t *e,
+		double qps, double scale, const isc_sockaddr_t *client_addr,
+		isc_stdtime_t now, char *log_buf, unsigned int log_buf_len)
 {
 	int rate, new_rate, slip, new_slip, age, log_secs, min;
 	dns_rrl_rate_t *ratep;
@@ -622,12 +684,12 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 		/*
 		 * The limit for clients that have used TCP is not scaled.
 		 */
-		credit_e = get_entry(rrl, client_addr,
+		credit_e = get_entry(rrl, shard, client_addr,
 				     0, dns_rdatatype_none, NULL,
 				     DNS_RRL_RTYPE_TCP, now, ISC_FALSE,
 				     log_buf, log_buf_len);
 		if (credit_e != NULL) {
-			age = get_age(rrl, e, now);
+			age = get_age(shard, e, now);
 			if (age < rrl->window)
 				scale = 1.0;
 		}
@@ -636,7 +698,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 		new_rate = (int) (rate * scale);
 		if (new_rate < 1)
 			new_rate = 1;
-		if (ratep->scaled != new_rate) {
+		if (shard->scaled[e->key.s.rtype] != new_rate) {
 			isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 				      DNS_LOGMODULE_REQUEST,
 				      DNS_RRL_LOG_DEBUG1,
@@ -645,7 +707,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 				      (int)qps, ratep->str, scale,
 				      rate, new_rate);
 			rate = new_rate;
-			ratep->scaled = rate;
+			shard->scaled[e->key.s.rtype] = rate;
 		}
 	}
 
@@ -656,7 +718,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 	 * Treat entries older than the window as if they were just created
 	 * Credit other entries.
 	 */
-	age = get_age(rrl, e, now);
+	age = get_age(shard, e, now);
 	if (age > 0) {
 		/*
 		 * Credit tokens earned during elapsed time.
@@ -687,7 +749,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 			e->log_secs = log_secs;
 		}
 	}
-	set_age(rrl, e, now);
+	set_age(shard, e, now);
 
 	/*
 	 * Debit the entry for this response.
@@ -709,7 +771,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 		new_slip = (int) (slip * scale);
 		if (new_slip < 2)
 			new_slip = 2;
-		if (rrl->slip.scaled != new_slip) {
+		if (shard->slip_scaled != new_slip) {
 			isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 				      DNS_LOGMODULE_REQUEST,
 				      DNS_RRL_LOG_DEBUG1,
@@ -718,7 +780,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 				      (int)qps, scale,
 				      slip, new_slip);
 			slip = new_slip;
-			rrl->slip.scaled = slip;
+			shard->slip_scaled = slip;
 		}
 	}
 	if (slip != 0 && e->key.s.rtype != DNS_RRL_RTYPE_ALL) {
@@ -739,23 +801,23 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 }
 
 static inline dns_rrl_qname_buf_t *
-get_qname(dns_rrl_t *rrl, const dns_rrl_entry_t *e) {
+get_qname(dns_rrl_shard_t *shard, const dns_rrl_entry_t *e) {
 	dns_rrl_qname_buf_t *qbuf;
 
-	qbuf = rrl->qnames[e->log_qname];
+	qbuf = shard->qnames[e->log_qname];
 	if (qbuf == NULL || qbuf->e != e)
 		return (NULL);
 	return (qbuf);
 }
 
 static inline void
-free_qname(dns_rrl_t *rrl, dns_rrl_entry_t *e) {
+free_qname(dns_rrl_shard_t *shard, dns_rrl_entry_t *e) {
 	dns_rrl_qname_buf_t *qbuf;
 
-	qbuf = get_qname(rrl, e);
+	qbuf = get_qname(shard, e);
 	if (qbuf != NULL) {
 		qbuf->e = NULL;
-		ISC_LIST_APPEND(rrl->qname_free, qbuf, link);
+		ISC_LIST_APPEND(shard->qname_free, qbuf, link);
 	}
 }
 
@@ -779,7 +841,7 @@ add_log_str(isc_buffer_t *lb, const char *str, unsigned int str_len) {
  * Build strings for the logs
  */
 static void
-make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e,
+make_log_buf(dns_rrl_t *rrl, dns_rrl_shard_t *shard, dns_rrl_entry_t *e,
 	     const char *str1, const char *str2, isc_boolean_t plural,
 	     const dns_name_t *qname, isc_boolean_t save_qname,
 	     dns_rrl_result_t rrl_result, isc_result_t resp_result,
@@ -871,22 +933,23 @@ make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e,
 	    e->key.s.rtype == DNS_RRL_RTYPE_REFERRAL ||
 	    e->key.s.rtype == DNS_RRL_RTYPE_NODATA ||
 	    e->key.s.rtype == DNS_RRL_RTYPE_NXDOMAIN) {
-		qbuf = get_qname(rrl, e);
+		qbuf = get_qname(shard, e);
 		if (save_qname && qbuf == NULL &&
 		    qname != NULL && dns_name_isabsolute(qname)) {
 			/*
 			 * Capture the qname for the "stop limiting" message.
 			 */
-			qbuf = ISC_LIST_TAIL(rrl->qname_free);
+			qbuf = ISC_LIST_TAIL(shard->qname_free);
 			if (qbuf != NULL) {
-				ISC_LIST_UNLINK(rrl->qname_free, qbuf, link);
-			} else if (rrl->num_qnames < DNS_RRL_QNAMES) {
+				ISC_LIST_UNLINK(shard->qname_free, qbuf, link);
+			} else if (shard->num_qnames < DNS_RRL_QNAMES) {
 				qbuf = isc_mem_get(rrl->mctx, sizeof(*qbuf));
 				if (qbuf != NULL) {
 					memset(qbuf, 0, sizeof(*qbuf));
 					ISC_LINK_INIT(qbuf, link);
-					qbuf->index = rrl->num_qnames;
-					rrl->qnames[rrl->num_qnames++] = qbuf;
+					qbuf->index = shard->num_qnames;
+					shard->qnames[shard->num_qnames++] =
+						qbuf;
 				} else {
 					isc_log_write(dns_lctx,
 						      DNS_LOGCATEGORY_RRL,
@@ -934,11 +997,11 @@ make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e,
 }
 
 static void
-log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_boolean_t early,
-	char *log_buf, unsigned int log_buf_len)
+log_end(dns_rrl_t *rrl, dns_rrl_shard_t *shard, dns_rrl_entry_t *e,
+	isc_boolean_t early, char *log_buf, unsigned int log_buf_len)
 {
 	if (e->logged) {
-		make_log_buf(rrl, e,
+		make_log_buf(rrl, shard, e,
 			     early ? "*" : NULL,
 			     rrl->log_only ? "would stop limiting "
 					   : "stop limiting ",
@@ -948,9 +1011,9 @@ log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_boolean_t early,
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DROP,
 			      "%s", log_buf);
-		free_qname(rrl, e);
+		free_qname(shard, e);
 		e->logged = ISC_FALSE;
-		--rrl->num_logged;
+		--shard->num_logged;
 	}
 }
 
@@ -958,39 +1021,39 @@ log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_boolean_t early,
  * Log messages for streams that have stopped being rate limited.
  */
 static void
-log_stops(dns_rrl_t *rrl, isc_stdtime_t now, int limit,
-	  char *log_buf, unsigned int log_buf_len)
+log_stops(dns_rrl_t *rrl, dns_rrl_shard_t *shard, isc_stdtime_t now,
+	  int limit, char *log_buf, unsigned int log_buf_len)
 {
 	dns_rrl_entry_t *e;
 	int age;
 
-	for (e = rrl->last_logged; e != NULL; e = ISC_LIST_PREV(e, lru)) {
+	for (e = shard->last_logged; e != NULL; e = ISC_LIST_PREV(e, lru)) {
 		if (!e->logged)
 			continue;
 		if (now != 0) {
-			age = get_age(rrl, e, now);
+			age = get_age(shard, e, now);
 			if (age < DNS_RRL_STOP_LOG_SECS ||
-			    response_balance(rrl, e, age) < 0)
+			    response_balance(rrl, shard, e, age) < 0)
 				break;
 		}
 
-		log_end(rrl, e, now == 0, log_buf, log_buf_len);
-		if (rrl->num_logged <= 0)
+		log_end(rrl, shard, e, now == 0, log_buf, log_buf_len);
+		if (shard->num_logged <= 0)
 			break;
 
 		/*
 		 * Too many messages could stall real work.
 		 */
 		if (--limit < 0) {
-			rrl->last_logged = ISC_LIST_PREV(e, lru);
+			shard->last_logged = ISC_LIST_PREV(e, lru);
 			return;
 		}
 	}
 	if (e == NULL) {
-		INSIST(rrl->num_logged == 0);
-		rrl->log_stops_time = now;
+		INSIST(shard->num_logged == 0);
+		shard->log_stops_time = now;
 	}
-	rrl->last_logged = e;
+	shard->last_logged = e;
 }
 
 /*
@@ -1004,6 +1067,7 @@ dns_rrl(dns_view_t *view,
 	isc_boolean_t wouldlog, char *log_buf, unsigned int log_buf_len)
 {
 	dns_rrl_t *rrl;
+	dns_rrl_shard_t *shard, *other;
 	dns_rrl_rtype_t rtype;
 	dns_rrl_entry_t *e;
 	isc_netaddr_t netclient;
@@ -1024,8 +1088,6 @@ dns_rrl(dns_view_t *view,
 			return (DNS_RRL_RESULT_OK);
 	}
 
-	LOCK(&rrl->lock);
-
 	/*
 	 * Estimate total query per second rate when scaling by qps.
 	 */
@@ -1033,6 +1095,7 @@ dns_rrl(dns_view_t *view,
 		qps = 0.0;
 		scale = 1.0;
 	} else {
+		LOCK(&rrl->lock);
 		++rrl->qps_responses;
 		secs = delta_rrl_time(rrl->qps_time, now);
 		if (secs <= 0) {
@@ -1057,14 +1120,35 @@ dns_rrl(dns_view_t *view,
 				qps = rrl->qps;
 			}
 		}
+		UNLOCK(&rrl->lock);
 		scale = rrl->qps_scale / qps;
 	}
 
+	shard = get_shard(rrl, client_addr);
+	LOCK(&shard->lock);
+
 	/*
-	 * Do maintenance once per second.
+	 * Do maintenance once per second.  Also look at another shard,
+	 * a different one each second, so that "stop limiting" messages
+	 * are not held back by shards whose clients have gone quiet.
+	 * Never wait for it; another query will get to it.
 	 */
-	if (rrl->num_logged > 0 && rrl->log_stops_time != now)
-		log_stops(rrl, now, 8, log_buf, log_buf_len);
+	if (shard->num_logged > 0 && shard->log_stops_time != now)
+		log_stops(rrl, shard, now, 8, log_buf, log_buf_len);
+	if (shard->sweep_time != now) {
+		shard->sweep_time = now;
+		other = &rrl->shards[(SHARD_INDEX(rrl, shard) + 1 + now) %
+				     rrl->nshards];
+		if (other != shard &&
+		    isc_mutex_trylock(&other->lock) == ISC_R_SUCCESS)
+		{
+			if (other->num_logged > 0 &&
+			    other->log_stops_time != now)
+				log_stops(rrl, other, now, 8,
+					  log_buf, log_buf_len);
+			UNLOCK(&other->lock);
+		}
+	}
 
 	/*
 	 * Notice TCP responses when scaling limits by qps.
@@ -1072,19 +1156,21 @@ dns_rrl(dns_view_t *view,
 	 */
 	if (is_tcp) {
 		if (scale < 1.0) {
-			e = get_entry(rrl, client_addr,
+			e = get_entry(rrl, shard, client_addr,
 				      0, dns_rdatatype_none, NULL,
 				      DNS_RRL_RTYPE_TCP, now, ISC_TRUE,
 				      log_buf, log_buf_len);
 			if (e != NULL) {
 				e->responses = -(rrl->window+1);
-				set_age(rrl, e, now);
+				set_age(shard, e, now);
 			}
 		}
-		UNLOCK(&rrl->lock);
+		UNLOCK(&shard->lock);
 		return (ISC_R_SUCCESS);
 	}
 
+	++shard->responses;
+
 	/*
 	 * Find the right kind of entry, creating it if necessary.
 	 * If that is impossible, then nothing more can be done
@@ -1106,10 +1192,10 @@ dns_rrl(dns_view_t *view,
 		rtype = DNS_RRL_RTYPE_ERROR;
 		break;
 	}
-	e = get_entry(rrl, client_addr, qclass, qtype, qname, rtype,
+	e = get_entry(rrl, shard, client_addr, qclass, qtype, qname, rtype,
 		      now, ISC_TRUE, log_buf, log_buf_len);
 	if (e == NULL) {
-		UNLOCK(&rrl->lock);
+		UNLOCK(&shard->lock);
 		return (DNS_RRL_RESULT_OK);
 	}
 
@@ -1118,7 +1204,8 @@ dns_rrl(dns_view_t *view,
 		 * Do not worry about speed or releasing the lock.
 		 * This message appears before messages from debit_rrl_entry().
 		 */
-		make_log_buf(rrl, e, "consider limiting ", NULL, ISC_FALSE,
+		make_log_buf(rrl, shard, e, "consider limiting ", NULL,
+			     ISC_FALSE,
 			     qname, ISC_FALSE, DNS_RRL_RESULT_OK, resp_result,
 			     log_buf, log_buf_len);
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
@@ -1126,8 +1213,8 @@ dns_rrl(dns_view_t *view,
 			      "%s", log_buf);
 	}
 
-	rrl_result = debit_rrl_entry(rrl, e, qps, scale, client_addr, now,
-				     log_buf, log_buf_len);
+	rrl_result = debit_rrl_entry(rrl, shard, e, qps, scale, client_addr,
+				     now, log_buf, log_buf_len);
 
 	if (rrl->all_per_second.r != 0) {
 		/*
@@ -1141,22 +1228,22 @@ dns_rrl(dns_view_t *view,
 		dns_rrl_entry_t *e_all;
 		dns_rrl_result_t rrl_all_result;
 
-		e_all = get_entry(rrl, client_addr,
+		e_all = get_entry(rrl, shard, client_addr,
 				  0, dns_rdatatype_none, NULL,
 				  DNS_RRL_RTYPE_ALL, now, ISC_TRUE,
 				  log_buf, log_buf_len);
 		if (e_all == NULL) {
-			UNLOCK(&rrl->lock);
+			UNLOCK(&shard->lock);
 			return (DNS_RRL_RESULT_OK);
 		}
-		rrl_all_result = debit_rrl_entry(rrl, e_all, qps, scale,
-						 client_addr, now,
+		rrl_all_result = debit_rrl_entry(rrl, shard, e_all, qps,
+						 scale, client_addr, now,
 						 log_buf, log_buf_len);
 		if (rrl_all_result != DNS_RRL_RESULT_OK) {
 			e = e_all;
 			rrl_result = rrl_all_result;
 			if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DEBUG1)) {
-				make_log_buf(rrl, e,
+				make_log_buf(rrl, shard, e,
 					     "prefer all-per-second limiting ",
 					     NULL, ISC_TRUE, qname, ISC_FALSE,
 					     DNS_RRL_RESULT_OK, resp_result,
@@ -1170,24 +1257,28 @@ dns_rrl(dns_view_t *view,
 	}
 
 	if (rrl_result == DNS_RRL_RESULT_OK) {
-		UNLOCK(&rrl->lock);
+		UNLOCK(&shard->lock);
 		return (DNS_RRL_RESULT_OK);
 	}
+	if (rrl_result == DNS_RRL_RESULT_SLIP)
+		++shard->slipped;
+	else
+		++shard->dropped;
 
 	/*
 	 * Log occassionally in the rate-limit category.
 	 */
 	if ((!e->logged || e->log_secs >= DNS_RRL_MAX_LOG_SECS) &&
 	    isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DROP)) {
-		make_log_buf(rrl, e, rrl->log_only ? "would " : NULL,
+		make_log_buf(rrl, shard, e, rrl->log_only ? "would " : NULL,
 			     e->logged ? "continue limiting " : "limit ",
 			     ISC_TRUE, qname, ISC_TRUE,
 			     DNS_RRL_RESULT_OK, resp_result,
 			     log_buf, log_buf_len);
 		if (!e->logged) {
 			e->logged = ISC_TRUE;
-			if (++rrl->num_logged <= 1)
-				rrl->last_logged = e;
+			if (++shard->num_logged <= 1)
+				shard->last_logged = e;
 		}
 		e->log_secs = 0;
 
@@ -1195,7 +1286,7 @@ dns_rrl(dns_view_t *view,
 		 * Avoid holding the lock.
 		 */
 		if (!wouldlog) {
-			UNLOCK(&rrl->lock);
+			UNLOCK(&shard->lock);
 			e = NULL;
 		}
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
@@ -1207,7 +1298,7 @@ dns_rrl(dns_view_t *view,
 	 * Make a log message for the caller.
 	 */
 	if (wouldlog)
-		make_log_buf(rrl, e,
+		make_log_buf(rrl, shard, e,
 			     rrl->log_only ? "would rate limit " : "rate limit ",
 			     NULL, ISC_FALSE, qname, ISC_FALSE,
 			     rrl_result, resp_result, log_buf, log_buf_len);
@@ -1218,67 +1309,99 @@ dns_rrl(dns_view_t *view,
 		 * the ending log message.
 		 */
 		if (!e->logged)
-			free_qname(rrl, e);
-		UNLOCK(&rrl->lock);
+			free_qname(shard, e);
+		UNLOCK(&shard->lock);
 	}
 
 	return (rrl_result);
 }
 
-void
-dns_rrl_view_destroy(dns_view_t *view) {
-	dns_rrl_t *rrl;
+static void
+free_shard(dns_rrl_t *rrl, dns_rrl_shard_t *shard) {
 	dns_rrl_block_t *b;
 	dns_rrl_hash_t *h;
 	char log_buf[DNS_RRL_LOG_BUF_LEN];
 	int i;
 
-	rrl = view->rrl;
-	if (rrl == NULL)
-		return;
-	view->rrl = NULL;
-
-	/*
-	 * Assume the caller takes care of locking the view and anything else.
-	 */
-
-	if (rrl->num_logged > 0)
-		log_stops(rrl, 0, ISC_INT32_MAX, log_buf, sizeof(log_buf));
+	if (shard->num_logged > 0)
+		log_stops(rrl, shard, 0, ISC_INT32_MAX,
+			  log_buf, sizeof(log_buf));
 
 	for (i = 0; i < DNS_RRL_QNAMES; ++i) {
-		if (rrl->qnames[i] == NULL)
+		if (shard->qnames[i] == NULL)
 			break;
-		isc_mem_put(rrl->mctx, rrl->qnames[i], sizeof(*rrl->qnames[i]));
+		isc_mem_put(rrl->mctx, shard->qnames[i],
+			    sizeof(*shard->qnames[i]));
 	}
 
-	if (rrl->exempt != NULL)
-		dns_acl_detach(&rrl->exempt);
-
-	DESTROYLOCK(&rrl->lock);
+	DESTROYLOCK(&shard->lock);
 
-	while (!ISC_LIST_EMPTY(rrl->blocks)) {
-		b = ISC_LIST_HEAD(rrl->blocks);
-		ISC_LIST_UNLINK(rrl->blocks, b, link);
+	while (!ISC_LIST_EMPTY(shard->blocks)) {
+		b = ISC_LIST_HEAD(shard->blocks);
+		ISC_LIST_UNLINK(shard->blocks, b, link);
 		isc_mem_put(rrl->mctx, b, b->size);
 	}
 
-	h = rrl->hash;
+	h = shard->hash;
 	if (h != NULL)
 		isc_mem_put(rrl->mctx, h,
 			    sizeof(*h) + (h->length - 1) * sizeof(h->bins[0]));
 
-	h = rrl->old_hash;
+	h = shard->old_hash;
 	if (h != NULL)
 		isc_mem_put(rrl->mctx, h,
 			    sizeof(*h) + (h->length - 1) * sizeof(h->bins[0]));
+}
+
+void
+dns_rrl_view_destroy(dns_view_t *view) {
+	dns_rrl_t *rrl;
+	unsigned int i;
+
+	rrl = view->rrl;
+	if (rrl == NULL)
+		return;
+	view->rrl = NULL;
+
+	/*
+	 * Assume the caller takes care of locking the view and anything else.
+	 */
+
+	for (i = 0; i < rrl->nshards; ++i)
+		free_shard(rrl, &rrl->shards[i]);
+	isc_mem_put(rrl->mctx, rrl->shards,
+		    rrl->nshards * sizeof(dns_rrl_shard_t));
+
+	if (rrl->exempt != NULL)
+		dns_acl_detach(&rrl->exempt);
+
+	DESTROYLOCK(&rrl->lock);
 
 	isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
 }
 
+/*
+ * Choose the number of shards: a power of two, so that a shard can be
+ * picked with a mask.
+ */
+static unsigned int
+shard_count(void) {
+	unsigned int count, n;
+
+	n = isc_os_ncpus() * RRL_SHARDS_PER_CPU;
+	for (count = 1; count < n && count < RRL_MAX_SHARDS; count <<= 1)
+		;
+	return (count);
+}
+
 isc_result_t
 dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries) {
 	dns_rrl_t *rrl;
+	dns_rrl_shard_t *shard;
+	isc_stdtime_t now;
 	isc_result_t result;
+	unsigned int i;
+	int entries;
 
 	*rrlp = NULL;
 
@@ -1292,21 +1415,116 @@ dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries) {
 		isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
 		return (result);
 	}
-	isc_stdtime_get(&rrl->ts_bases[0]);
+
+	rrl->nshards = shard_count();
+	rrl->shards = isc_mem_get(rrl->mctx,
+				  rrl->nshards * sizeof(dns_rrl_shard_t));
+	if (rrl->shards == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_lock;
+	}
+	memset(rrl->shards, 0, rrl->nshards * sizeof(dns_rrl_shard_t));
+	isc_stdtime_get(&now);
+	for (i = 0; i < rrl->nshards; ++i) {
+		shard = &rrl->shards[i];
+		result = isc_mutex_init(&shard->lock);
+		if (result != ISC_R_SUCCESS) {
+			while (i-- > 0)
+				DESTROYLOCK(&rrl->shards[i].lock);
+			goto cleanup_shards;
+		}
+		ISC_LIST_INIT(shard->blocks);
+		ISC_LIST_INIT(shard->lru);
+		ISC_LIST_INIT(shard->qname_free);
+		shard->ts_bases[0] = now;
+	}
 
 	view->rrl = rrl;
 
-	result = expand_entries(rrl, min_entries);
-	if (result != ISC_R_SUCCESS) {
-		dns_rrl_view_destroy(view);
-		return (result);
-	}
-	result = expand_rrl_hash(rrl, 0);
-	if (result != ISC_R_SUCCESS) {
-		dns_rrl_view_destroy(view);
-		return (result);
+	entries = (min_entries + rrl->nshards - 1) / rrl->nshards;
+	for (i = 0; i < rrl->nshards; ++i) {
+		result = expand_entries(rrl, &rrl->shards[i], entries);
+		if (result != ISC_R_SUCCESS) {
+			dns_rrl_view_destroy(view);
+			return (result);
+		}
+		result = expand_rrl_hash(rrl, &rrl->shards[i], 0);
+		if (result != ISC_R_SUCCESS) {
+			dns_rrl_view_destroy(view);
+			return (result);
+		}
 	}
 
 	*rrlp = rrl;
 	return (ISC_R_SUCCESS);
+
+ cleanup_shards:
+	isc_mem_put(rrl->mctx, rrl->shards,
+		    rrl->nshards * sizeof(dns_rrl_shard_t));
+ cleanup_lock:
+	DESTROYLOCK(&rrl->lock);
+	isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
+	return (result);
+}
+
+typedef struct {
+	isc_uint64_t	responses;
+	isc_uint64_t	dropped;
+	isc_uint64_t	slipped;
+	int		entries;
+	int		bins;
+} rrl_stats_t;
+
+static void
+dump_counters(FILE *fp, const rrl_stats_t *stats) {
+	fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u %s\n",
+		stats->responses, "responses checked");
+	fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u %s\n",
+		stats->dropped, "responses dropped");
+	fprintf(fp, "%20" ISC_PRINT_QUADFORMAT "u %s\n",
+		stats->slipped, "responses slipped");
+	fprintf(fp, "%20d %s\n", stats->entries, "table entries");
+	fprintf(fp, "%20d %s\n", stats->bins, "hash table bins");
+}
+
+void
+dns_rrl_dumpstats(dns_rrl_t *rrl, FILE *fp) {
+	dns_rrl_shard_t *shard;
+	rrl_stats_t total, *stats;
+	unsigned int i;
+
+	REQUIRE(rrl != NULL);
+
+	/*
+	 * Take a snapshot of each shard in turn, so that printing does
+	 * not hold up queries.
+	 */
+	stats = isc_mem_get(rrl->mctx, rrl->nshards * sizeof(*stats));
+	if (stats == NULL)
+		return;
+	memset(&total, 0, sizeof(total));
+	for (i = 0; i < rrl->nshards; ++i) {
+		shard = &rrl->shards[i];
+		LOCK(&shard->lock);
+		stats[i].responses = shard->responses;
+		stats[i].dropped = shard->dropped;
+		stats[i].slipped = shard->slipped;
+		stats[i].entries = shard->num_entries;
+		stats[i].bins = (shard->hash == NULL) ? 0 : shard->hash->length;
+		UNLOCK(&shard->lock);
+		total.responses += stats[i].responses;
+		total.dropped += stats[i].dropped;
+		total.slipped += stats[i].slipped;
+		total.entries += stats[i].entries;
+		total.bins += stats[i].bins;
+	}
+
+	fprintf(fp, "%20u %s\n", rrl->nshards, "shards");
+	dump_counters(fp, &total);
+	for (i = 0; i < rrl->nshards; ++i) {
+		fprintf(fp, "[Shard %u]\n", i);
+		dump_counters(fp, &stats[i]);
+	}
+
+	isc_mem_put(rrl->mctx, stats, rrl->nshards * sizeof(*stats));
 }
@@ -0,0 +1,468 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/buffer.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/serial.h>
+#include <isc/sha2.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/rdatastruct.h>
+#include <dns/result.h>
+#include <dns/sigcache.h>
+
+#include <dst/dst.h>
+
+/*
+ * Number of independently locked stripes.  Each stripe is a small
+ * hash table with its own LRU list and a share of the entry limit.
+ */
+#define SIGCACHE_NSTRIPES	16
+
+typedef struct dns_scentry dns_scentry_t;
+
+struct dns_scentry {
+	dns_scentry_t *			next;
+	ISC_LINK(dns_scentry_t)		link;
+	unsigned char			digest[ISC_SHA256_DIGESTLENGTH];
+};
+
+typedef struct dns_scstripe {
+	isc_mutex_t			lock;
+	dns_scentry_t **		table;
+	unsigned int			size;
+	unsigned int			count;
+	ISC_LIST(dns_scentry_t)		lru;
+} dns_scstripe_t;
+
+struct dns_sigcache {
+	unsigned int			magic;
+	isc_mem_t *			mctx;
+	isc_refcount_t			references;
+	unsigned int			size;
+	unsigned int			limit;		/* per stripe */
+	dns_scstripe_t			stripes[SIGCACHE_NSTRIPES];
+};
+
+#define SIGCACHE_MAGIC			ISC_MAGIC('S', 'g', 'C', 'a')
+#define VALID_SIGCACHE(m)		ISC_MAGIC_VALID(m, SIGCACHE_MAGIC)
+
+isc_result_t
+dns_sigcache_create(isc_mem_t *mctx, unsigned int size,
+		    dns_sigcache_t **cachep)
+{
+	isc_result_t result;
+	dns_sigcache_t *cache;
+	dns_scstripe_t *stripe;
+	unsigned int i, tsize;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(size > 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	if (cache == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(cache, 0, sizeof(*cache));
+
+	result = isc_refcount_init(&cache->references, 1);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(mctx, cache, sizeof(*cache));
+		return (result);
+	}
+
+	cache->size = size;
+	cache->limit = (size + SIGCACHE_NSTRIPES - 1) / SIGCACHE_NSTRIPES;
+	tsize = cache->limit / 2 + 1;
+
+	for (i = 0; i < SIGCACHE_NSTRIPES; i++) {
+		stripe = &cache->stripes[i];
+		stripe->table = isc_mem_get(mctx,
+					    tsize * sizeof(dns_scentry_t *));
+		if (stripe->table == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		memset(stripe->table, 0, tsize * sizeof(dns_scentry_t *));
+		result = isc_mutex_init(&stripe->lock);
+		if (result != ISC_R_SUCCESS) {
+			isc_mem_put(mctx, stripe->table,
+				    tsize * sizeof(dns_scentry_t *));
+			goto cleanup;
+		}
+		stripe->size = tsize;
+		stripe->count = 0;
+		ISC_LIST_INIT(stripe->lru);
+	}
+
+	isc_mem_attach(mctx, &cache->mctx);
+	cache->magic = SIGCACHE_MAGIC;
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	while (i-- > 0) {
+		stripe = &cache->stripes[i];
+		DESTROYLOCK(&stripe->lock);
+		isc_mem_put(mctx, stripe->table,
+			    stripe->size * sizeof(dns_scentry_t *));
+	}
+	isc_refcount_destroy(&cache->references);
+	isc_mem_put(mctx, cache, sizeof(*cache));
+	return (result);
+}
+
+static void
+destroy(dns_sigcache_t *cache) {
+	dns_scstripe_t *stripe;
+	unsigned int i;
+
+	dns_sigcache_flush(cache);
+
+	cache->magic = 0;
+	for (i = 0; i < SIGCACHE_NSTRIPES; i++) {
+		stripe = &cache->stripes[i];
+		DESTROYLOCK(&stripe->lock);
+		isc_mem_put(cache->mctx, stripe->table,
+			    stripe->size * sizeof(dns_scentry_t *));
+	}
+	isc_refcount_destroy(&cache->references);
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+void
+dns_sigcache_attach(dns_sigcache_t *source, dns_sigcache_t **targetp) {
+	REQUIRE(VALID_SIGCACHE(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+	*targetp = source;
+}
+
+void
+dns_sigcache_detach(dns_sigcache_t **cachep) {
+	dns_sigcache_t *cache;
+	unsigned int refs;
+
+	REQUIRE(cachep != NULL);
+	cache = *cachep;
+	REQUIRE(VALID_SIGCACHE(cache));
+
+	*cachep = NULL;
+	isc_refcount_decrement(&cache->references, &refs);
+	if (refs == 0)
+		destroy(cache);
+}
+
+/*
+ * Feed a length-prefixed region to the digest, so that the boundaries
+ * between the components of the key are unambiguous.
+ */
+static void
+digest_region(isc_sha256_t *ctx, const unsigned char *base,
+	      unsigned int length)
+{
+	unsigned char lenbuf[4];
+
+	lenbuf[0] = (unsigned char)(length >> 24);
+	lenbuf[1] = (unsigned char)(length >> 16);
+	lenbuf[2] = (unsigned char)(length >> 8);
+	lenbuf[3] = (unsigned char)length;
+	isc_sha256_update(ctx, lenbuf, sizeof(lenbuf));
+	isc_sha256_update(ctx, base, length);
+}
+
+isc_result_t
+dns_sigcache_makekey(const dns_name_t *name, dns_rdataset_t *rdataset,
+		     dns_rdata_t *sigrdata, dst_key_t *key,
+		     unsigned int maxbits, dns_sigcachekey_t *sckey)
+{
+	isc_result_t result;
+	isc_sha256_t ctx;
+	isc_buffer_t buffer;
+	isc_region_t r;
+	dns_rdata_rrsig_t sig;
+	dns_fixedname_t fixed;
+	dns_name_t *owner;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	unsigned char keydata[DST_KEY_MAXSIZE];
+	unsigned char header[8];
+	unsigned int labels;
+
+	REQUIRE(name != NULL && dns_name_isabsolute(name));
+	REQUIRE(DNS_RDATASET_VALID(rdataset));
+	REQUIRE(sigrdata != NULL && sigrdata->type == dns_rdatatype_rrsig);
+	REQUIRE(key != NULL);
+	REQUIRE(sckey != NULL);
+
+	result = dns_rdata_tostruct(sigrdata, &sig, NULL);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	isc_buffer_init(&buffer, keydata, sizeof(keydata));
+	result = dst_key_todns(key, &buffer);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	/*
+	 * Names are compared case-insensitively when signatures are
+	 * verified, so case differences in the owner name don't matter.
+	 */
+	dns_fixedname_init(&fixed);
+	owner = dns_fixedname_name(&fixed);
+	RUNTIME_CHECK(dns_name_downcase(name, owner, NULL) == ISC_R_SUCCESS);
+
+	isc_sha256_init(&ctx);
+
+	header[0] = (unsigned char)(maxbits >> 24);
+	header[1] = (unsigned char)(maxbits >> 16);
+	header[2] = (unsigned char)(maxbits >> 8);
+	header[3] = (unsigned char)maxbits;
+	header[4] = (unsigned char)(rdataset->type >> 8);
+	header[5] = (unsigned char)rdataset->type;
+	header[6] = (unsigned char)(rdataset->rdclass >> 8);
+	header[7] = (unsigned char)rdataset->rdclass;
+	isc_sha256_update(&ctx, header, sizeof(header));
+
+	dns_name_toregion(owner, &r);
+	digest_region(&ctx, r.base, r.length);
+
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdata_reset(&rdata);
+		dns_rdataset_current(rdataset, &rdata);
+		dns_rdata_toregion(&rdata, &r);
+		digest_region(&ctx, r.base, r.length);
+	}
+	if (result != ISC_R_NOMORE) {
+		isc_sha256_invalidate(&ctx);
+		return (result);
+	}
+
+	dns_rdata_toregion(sigrdata, &r);
+	digest_region(&ctx, r.base, r.length);
+
+	isc_buffer_usedregion(&buffer, &r);
+	digest_region(&ctx, r.base, r.length);
+
+	isc_sha256_final(sckey->digest, &ctx);
+
+	sckey->inception = sig.timesigned;
+	sckey->expiration = sig.timeexpire;
+
+	/*
+	 * The same test dns_dnssec_verify3() uses to decide whether the
+	 * RRset was expanded from a wildcard.
+	 */
+	labels = dns_name_countlabels(owner) - 1;
+	sckey->wildcard = ISC_TF(labels > sig.labels);
+	dns_fixedname_init(&sckey->wild);
+	if (sckey->wildcard) {
+		dns_name_split(owner, sig.labels + 1, NULL, owner);
+		RUNTIME_CHECK(dns_name_concatenate(dns_wildcardname, owner,
+					   dns_fixedname_name(&sckey->wild),
+					   NULL) == ISC_R_SUCCESS);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * The digest is already uniformly distributed.
+ */
+static inline unsigned int
+digest_hash(const unsigned char *digest) {
+	return (((unsigned int)digest[0] << 24) |
+		((unsigned int)digest[1] << 16) |
+		((unsigned int)digest[2] << 8) |
+		(unsigned int)digest[3]);
+}
+
+isc_result_t
+dns_sigcache_find(dns_sigcache_t *cache, const dns_sigcachekey_t *sckey,
+		  isc_stdtime_t now, dns_name_t *wild)
+{
+	dns_scstripe_t *stripe;
+	dns_scentry_t *entry;
+	unsigned int hashval, i;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+	REQUIRE(sckey != NULL);
+
+	/*
+	 * Only the signature itself is cached; it must still be current.
+	 */
+	if (isc_serial_lt(sckey->expiration, sckey->inception) ||
+	    isc_serial_lt((isc_uint32_t)now, sckey->inception) ||
+	    isc_serial_lt(sckey->expiration, (isc_uint32_t)now))
+		return (ISC_R_NOTFOUND);
+
+	hashval = digest_hash(sckey->digest);
+	stripe = &cache->stripes[hashval % SIGCACHE_NSTRIPES];
+	i = (hashval / SIGCACHE_NSTRIPES) % stripe->size;
+
+	LOCK(&stripe->lock);
+	for (entry = stripe->table[i]; entry != NULL; entry = entry->next)
+		if (memcmp(entry->digest, sckey->digest,
+			   sizeof(entry->digest)) == 0)
+			break;
+	if (entry != NULL && entry != ISC_LIST_HEAD(stripe->lru)) {
+		ISC_LIST_UNLINK(stripe->lru, entry, link);
+		ISC_LIST_PREPEND(stripe->lru, entry, link);
+	}
+	UNLOCK(&stripe->lock);
+
+	if (entry == NULL)
+		return (ISC_R_NOTFOUND);
+
+	if (sckey->wildcard) {
+		if (wild != NULL)
+			dns_name_copy(dns_fixedname_name(&sckey->wild),
+				      wild, NULL);
+		return (DNS_R_FROMWILDCARD);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Free the least recently used entry of 'stripe'.  Stripe must be locked.
+ */
+static void
+evict_entry(dns_sigcache_t *cache, dns_scstripe_t *stripe) {
+	dns_scentry_t *victim, *entry, *prev = NULL;
+	unsigned int hashval, i;
+
+	victim = ISC_LIST_TAIL(stripe->lru);
+	if (victim == NULL)
+		return;
+
+	hashval = digest_hash(victim->digest);
+	i = (hashval / SIGCACHE_NSTRIPES) % stripe->size;
+	for (entry = stripe->table[i]; entry != victim; entry = entry->next) {
+		INSIST(entry != NULL);
+		prev = entry;
+	}
+	if (prev == NULL)
+		stripe->table[i] = victim->next;
+	else
+		prev->next = victim->next;
+	ISC_LIST_UNLINK(stripe->lru, victim, link);
+	INSIST(stripe->count > 0);
+	stripe->count--;
+	isc_mem_put(cache->mctx, victim, sizeof(*victim));
+}
+
+isc_result_t
+dns_sigcache_add(dns_sigcache_t *cache, const dns_sigcachekey_t *sckey) {
+	dns_scstripe_t *stripe;
+	dns_scentry_t *entry, *newentry;
+	unsigned int hashval, i;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+	REQUIRE(sckey != NULL);
+
+	newentry = isc_mem_get(cache->mctx, sizeof(*newentry));
+	if (newentry == NULL)
+		return (ISC_R_NOMEMORY);
+	ISC_LINK_INIT(newentry, link);
+	memmove(newentry->digest, sckey->digest, sizeof(newentry->digest));
+
+	hashval = digest_hash(sckey->digest);
+	stripe = &cache->stripes[hashval % SIGCACHE_NSTRIPES];
+	i = (hashval / SIGCACHE_NSTRIPES) % stripe->size;
+
+	LOCK(&stripe->lock);
+	for (entry = stripe->table[i]; entry != NULL; entry = entry->next)
+		if (memcmp(entry->digest, sckey->digest,
+			   sizeof(entry->digest)) == 0)
+			break;
+	if (entry != NULL) {
+		/*
+		 * Another thread verified the same signature meanwhile.
+		 */
+		UNLOCK(&stripe->lock);
+		isc_mem_put(cache->mctx, newentry, sizeof(*newentry));
+		return (ISC_R_SUCCESS);
+	}
+
+	while (stripe->count >= cache->limit)
+		evict_entry(cache, stripe);
+
+	newentry->next = stripe->table[i];
+	stripe->table[i] = newentry;
+	ISC_LIST_PREPEND(stripe->lru, newentry, link);
+	stripe->count++;
+	UNLOCK(&stripe->lock);
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_sigcache_flush(dns_sigcache_t *cache) {
+	dns_scstripe_t *stripe;
+	dns_scentry_t *entry, *next;
+	unsigned int i, j;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+
+	for (i = 0; i < SIGCACHE_NSTRIPES; i++) {
+		stripe = &cache->stripes[i];
+		LOCK(&stripe->lock);
+		for (j = 0; stripe->count > 0 && j < stripe->size; j++) {
+			for (entry = stripe->table[j];
+			     entry != NULL;
+			     entry = next)
+			{
+				next = entry->next;
+				ISC_LIST_UNLINK(stripe->lru, entry, link);
+				isc_mem_put(cache->mctx, entry,
+					    sizeof(*entry));
+				stripe->count--;
+			}
+			stripe->table[j] = NULL;
+		}
+		INSIST(ISC_LIST_EMPTY(stripe->lru));
+		UNLOCK(&stripe->lock);
+	}
+}
+
+unsigned int
+dns_sigcache_count(dns_sigcache_t *cache) {
+	unsigned int i, count = 0;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+
+	for (i = 0; i < SIGCACHE_NSTRIPES; i++) {
+		LOCK(&cache->stripes[i].lock);
+		count += cache->stripes[i].count;
+		UNLOCK(&cache->stripes[i].lock);
+	}
+
+	return (count);
+}
+
+unsigned int
+dns_sigcache_getsize(dns_sigcache_t *cache) {
+	REQUIRE(VALID_SIGCACHE(cache));
+
+	return (cache->size);
+}
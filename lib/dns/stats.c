@@ -122,7 +122,7 @@ dns_stats_detach(dns_stats_t **statsp) {
  */
 static isc_result_t
 create_stats(isc_mem_t *mctx, dns_statstype_t type, int ncounters,
-	     dns_stats_t **statsp)
+	     isc_boolean_t sharded, dns_stats_t **statsp)
 {
 	dns_stats_t *stats;
 	isc_result_t result;
@@ -138,7 +138,8 @@ create_stats(isc_mem_t *mctx, dns_statstype_t type, int ncounters,
 	if (result != ISC_R_SUCCESS)
 		goto clean_stats;
 
-	result = isc_stats_create(mctx, &stats->counters, ncounters);
+	result = isc_stats_create2(mctx, &stats->counters, ncounters,
+				   sharded ? ISC_STATSCREATE_SHARDED : 0);
 	if (result != ISC_R_SUCCESS)
 		goto clean_mutex;
 
@@ -162,15 +163,18 @@ isc_result_t
 dns_generalstats_create(isc_mem_t *mctx, dns_stats_t **statsp, int ncounters) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, dns_statstype_general, ncounters, statsp));
+	return (create_stats(mctx, dns_statstype_general, ncounters,
+			     ISC_FALSE, statsp));
 }
 
 isc_result_t
-dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
+dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp,
+			  isc_boolean_t sharded)
+{
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	return (create_stats(mctx, dns_statstype_rdtype, rdtypecounter_max,
-			     statsp));
+			     sharded, statsp));
 }
 
 isc_result_t
@@ -178,22 +182,26 @@ dns_rdatasetstats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	return (create_stats(mctx, dns_statstype_rdataset,
-			     rdatasettypecounter_max, statsp));
+			     rdatasettypecounter_max, ISC_FALSE, statsp));
 }
 
 isc_result_t
-dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
+dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp,
+		       isc_boolean_t sharded)
+{
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, dns_statstype_opcode, 16, statsp));
+	return (create_stats(mctx, dns_statstype_opcode, 16, sharded, statsp));
 }
 
 isc_result_t
-dns_rcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
+dns_rcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp,
+		      isc_boolean_t sharded)
+{
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	return (create_stats(mctx, dns_statstype_rcode,
-			     dns_rcode_badcookie + 1, statsp));
+			     dns_rcode_badcookie + 1, sharded, statsp));
 }
 
 /*%
@@ -15,11 +15,14 @@
 #include <atf-c.h>
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <isc/print.h>
 
 #include <dns/acl.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
 #include "dnstest.h"
 
 /*
@@ -324,10 +327,241 @@ ATF_TC_BODY(dns_acl_isinsecure, tc) {
 	dns_test_end();
 }
 
+/*
+ * Deterministic pseudo-random numbers, so that failures can be
+ * reproduced.
+ */
+static isc_uint32_t rnd_state;
+
+static isc_uint32_t
+rnd(void) {
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8);
+}
+
+/*
+ * Address bytes come from a small alphabet so that the prefixes in an
+ * ACL overlap and nest in interesting ways.
+ */
+static void
+random_addr(isc_netaddr_t *addr, int family, unsigned int bitlen) {
+	static const unsigned char alphabet[] = { 0x00, 0x01, 0x0a, 0x7f,
+						  0x80, 0xc0, 0xfe, 0xff };
+	unsigned char bytes[16];
+	unsigned int i, len = (family == AF_INET6) ? 16 : 4;
+
+	for (i = 0; i < len; i++) {
+		if (rnd() % 4 == 0)
+			bytes[i] = rnd() & 0xff;
+		else
+			bytes[i] = alphabet[rnd() % sizeof(alphabet)];
+		if (bitlen <= i * 8)
+			bytes[i] = 0;
+		else if (bitlen < (i + 1) * 8)
+			bytes[i] &= 0xff << (8 - (bitlen - i * 8));
+	}
+	if (family == AF_INET6)
+		isc_netaddr_fromin6(addr, (struct in6_addr *)bytes);
+	else
+		isc_netaddr_fromin(addr, (struct in_addr *)bytes);
+}
+
+static void
+random_prefix(isc_netaddr_t *addr, unsigned int *bitlen) {
+	int family = (rnd() % 2 == 0) ? AF_INET : AF_INET6;
+	unsigned int max = (family == AF_INET6) ? 128 : 32;
+
+	if (rnd() % 16 == 0)
+		*bitlen = 0;
+	else if (rnd() % 4 == 0)
+		*bitlen = max;
+	else
+		*bitlen = rnd() % (max + 1);
+	random_addr(addr, family, *bitlen);
+}
+
+/*
+ * Add the same random prefix to both 'a' and, if not NULL, 'b'.
+ */
+static void
+add_prefix(dns_acl_t *a, dns_acl_t *b) {
+	isc_netaddr_t addr;
+	unsigned int bitlen;
+	isc_boolean_t pos = ISC_TF(rnd() % 3 != 0);
+	isc_result_t result;
+
+	random_prefix(&addr, &bitlen);
+	result = dns_iptable_addprefix(a->iptable, &addr, bitlen, pos);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	if (b != NULL) {
+		result = dns_iptable_addprefix(b->iptable, &addr, bitlen, pos);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+}
+
+/*
+ * Add a nested ACL or key name element to both 'a' and 'b', the way
+ * cfg_acl_fromconfig() does.
+ */
+static void
+add_element(dns_acl_t *a, dns_acl_t *b, dns_acl_t *nested,
+	    const dns_name_t *keyname, isc_boolean_t neg)
+{
+	dns_acl_t *acls[2];
+	dns_aclelement_t *de;
+	isc_result_t result;
+	unsigned int i;
+
+	acls[0] = a;
+	acls[1] = b;
+	for (i = 0; i < 2; i++) {
+		ATF_REQUIRE(acls[i]->length < acls[i]->alloc);
+		de = &acls[i]->elements[acls[i]->length];
+		de->negative = neg;
+		de->nestedacl = NULL;
+		if (nested != NULL) {
+			de->type = dns_aclelementtype_nestedacl;
+			dns_acl_attach(nested, &de->nestedacl);
+		} else {
+			de->type = dns_aclelementtype_keyname;
+			dns_name_init(&de->keyname, NULL);
+			result = dns_name_dup(keyname, mctx, &de->keyname);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		}
+		acls[i]->node_count++;
+		de->node_num = acls[i]->node_count;
+		acls[i]->length++;
+	}
+}
+
+static void
+compare_match(const isc_netaddr_t *addr, const dns_name_t *signer,
+	      dns_acl_t *compiled, dns_acl_t *plain, dns_aclenv_t *env)
+{
+	const dns_aclelement_t *elt1 = NULL, *elt2 = NULL;
+	char buf[ISC_NETADDR_FORMATSIZE];
+	int match1, match2;
+	isc_result_t result;
+
+	result = dns_acl_match(addr, signer, compiled, env, &match1, &elt1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_acl_match(addr, signer, plain, env, &match2, &elt2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_netaddr_format(addr, buf, sizeof(buf));
+	ATF_CHECK_MSG(match1 == match2, "%s%s: compiled %d, plain %d", buf,
+		      signer != NULL ? " (signed)" : "", match1, match2);
+	ATF_CHECK_MSG((elt1 == NULL) == (elt2 == NULL),
+		      "%s: matching element differs", buf);
+}
+
+ATF_TC(dns_acl_compile);
+ATF_TC_HEAD(dns_acl_compile, tc) {
+	atf_tc_set_md_var(tc, "descr", "test that compiled ACLs match the "
+			  "same way as uncompiled ones");
+}
+ATF_TC_BODY(dns_acl_compile, tc) {
+	isc_result_t result;
+	dns_aclenv_t env;
+	dns_fixedname_t fkey1, fkey2, fsigner;
+	dns_name_t *key1, *key2, *signer;
+	unsigned int pass, i, j, n;
+	static const unsigned int cachesizes[] = { 0, 1, 64 };
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_aclenv_init(mctx, &env);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fkey1);
+	key1 = dns_fixedname_name(&fkey1);
+	result = dns_name_fromstring(key1, "key1.example", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_fixedname_init(&fkey2);
+	key2 = dns_fixedname_name(&fkey2);
+	result = dns_name_fromstring(key2, "key2.example", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_fixedname_init(&fsigner);
+	signer = dns_fixedname_name(&fsigner);
+	result = dns_name_fromstring(signer, "KEY2.example", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	rnd_state = 1;
+	for (pass = 0; pass < 300; pass++) {
+		dns_acl_t *compiled = NULL, *plain = NULL, *nested = NULL;
+		isc_netaddr_t addr, mapped;
+		struct in6_addr in6;
+		unsigned int bitlen;
+
+		result = dns_acl_create(mctx, 4, &compiled);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_acl_create(mctx, 4, &plain);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		n = rnd() % 64;
+		for (i = 0; i < n; i++) {
+			switch (rnd() % 32) {
+			case 0:
+				result = dns_acl_create(mctx, 0, &nested);
+				ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+				for (j = rnd() % 8; j > 0; j--)
+					add_prefix(nested, NULL);
+				if (compiled->length < compiled->alloc)
+					add_element(compiled, plain, nested,
+						    NULL, ISC_TF(rnd() % 2));
+				dns_acl_detach(&nested);
+				break;
+			case 1:
+				if (compiled->length < compiled->alloc)
+					add_element(compiled, plain, NULL,
+						    rnd() % 2 ? key1 : key2,
+						    ISC_TF(rnd() % 2));
+				break;
+			default:
+				add_prefix(compiled, plain);
+			}
+		}
+
+		result = dns_acl_compile(compiled,
+					 cachesizes[pass % 3]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		env.match_mapped = ISC_TF(pass % 2);
+		for (i = 0; i < 200; i++) {
+			random_prefix(&addr, &bitlen);
+			random_addr(&addr, addr.family,
+				    rnd() % 2 ? bitlen : 0);
+			compare_match(&addr, NULL, compiled, plain, &env);
+			/* Again, from the cache if there is one. */
+			compare_match(&addr, NULL, compiled, plain, &env);
+			compare_match(&addr, signer, compiled, plain, &env);
+			if (addr.family == AF_INET) {
+				memset(&in6, 0, sizeof(in6));
+				in6.s6_addr[10] = 0xff;
+				in6.s6_addr[11] = 0xff;
+				memmove(&in6.s6_addr[12], &addr.type.in, 4);
+				isc_netaddr_fromin6(&mapped, &in6);
+				compare_match(&mapped, NULL, compiled,
+					      plain, &env);
+			}
+		}
+
+		dns_acl_detach(&compiled);
+		dns_acl_detach(&plain);
+	}
+
+	dns_aclenv_destroy(&env);
+	dns_test_end();
+}
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, dns_acl_isinsecure);
+	ATF_TP_ADD_TC(tp, dns_acl_compile);
 	return (atf_no_error());
 }
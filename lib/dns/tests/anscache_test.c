@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/util.h>
+
+#include <dns/anscache.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+static void
+makekey(const char *namestr, dns_fixedname_t *fixed, dns_anscachekey_t *key)
+{
+	isc_buffer_t b;
+	isc_result_t result;
+
+	dns_fixedname_init(fixed);
+	isc_buffer_constinit(&b, namestr, strlen(namestr));
+	isc_buffer_add(&b, strlen(namestr));
+	result = dns_name_fromtext(dns_fixedname_name(fixed), &b,
+				   dns_rootname, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	memset(key, 0, sizeof(*key));
+	key->name = dns_fixedname_name(fixed);
+	key->type = dns_rdatatype_a;
+	key->rdclass = dns_rdataclass_in;
+	key->flags = 0;
+	key->udpsize = 4096;
+	key->owner = fixed;
+	key->generation = 1;
+}
+
+static void
+addwire(dns_anscache_t *cache, dns_anscachekey_t *key, unsigned char fill,
+	unsigned int length, unsigned int tag)
+{
+	unsigned char wire[512];
+	isc_region_t r;
+
+	ATF_REQUIRE(length <= sizeof(wire));
+	memset(wire, fill, length);
+	r.base = wire;
+	r.length = length;
+	ATF_REQUIRE_EQ(dns_anscache_add(cache, key, &r, tag), ISC_R_SUCCESS);
+}
+
+ATF_TC(addfind);
+ATF_TC_HEAD(addfind, tc) {
+	atf_tc_set_md_var(tc, "descr", "stored messages are found by key");
+}
+ATF_TC_BODY(addfind, tc) {
+	dns_anscache_t *cache = NULL;
+	dns_anscachekey_t key, other;
+	dns_fixedname_t fixed, ofixed;
+	unsigned char data[512];
+	isc_buffer_t target;
+	unsigned int tag = 0;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_anscache_create(mctx, 100, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	makekey("www.example.", &fixed, &key);
+	addwire(cache, &key, 0xaa, 100, 7);
+	ATF_CHECK_EQ(dns_anscache_count(cache), 1);
+
+	isc_buffer_init(&target, data, sizeof(data));
+	result = dns_anscache_find(cache, &key, &target, &tag);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&target), 100);
+	ATF_CHECK_EQ(data[0], 0xaa);
+	ATF_CHECK_EQ(data[99], 0xaa);
+	ATF_CHECK_EQ(tag, 7);
+
+	/* Every key field takes part in the match. */
+	other = key;
+	other.type = dns_rdatatype_aaaa;
+	isc_buffer_init(&target, data, sizeof(data));
+	result = dns_anscache_find(cache, &other, &target, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	other = key;
+	other.flags = 1;
+	isc_buffer_init(&target, data, sizeof(data));
+	result = dns_anscache_find(cache, &other, &target, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	other = key;
+	other.udpsize = 512;
+	isc_buffer_init(&target, data, sizeof(data));
+	result = dns_anscache_find(cache, &other, &target, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* Names are matched case-sensitively. */
+	makekey("WWW.example.", &ofixed, &other);
+	other.owner = key.owner;
+	isc_buffer_init(&target, data, sizeof(data));
+	result = dns_anscache_find(cache, &other, &target, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* Too small a target is reported, not truncated. */
+	isc_buffer_init(&target, data, 50);
+	result = dns_anscache_find(cache, &key, &target, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOSPACE);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&target), 0);
+
+	/* Adding again replaces the entry. */
+	addwire(cache, &key, 0xbb, 60, 8);
+	ATF_CHECK_EQ(dns_anscache_count(cache), 1);
+	isc_buffer_init(&target, data, sizeof(data));
+	result = dns_anscache_find(cache, &key, &target, &tag);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&target), 60);
+	ATF_CHECK_EQ(data[0], 0xbb);
+	ATF_CHECK_EQ(tag, 8);
+
+	dns_anscache_flush(cache);
+	ATF_CHECK_EQ(dns_anscache_count(cache), 0);
+
+	dns_anscache_destroy(&cache);
+	ATF_CHECK_EQ(cache, NULL);
+
+	dns_test_end();
+}
+
+ATF_TC(generation);
+ATF_TC_HEAD(generation, tc) {
+	atf_tc_set_md_var(tc, "descr", "a generation change invalidates "
+			  "stored messages");
+}
+ATF_TC_BODY(generation, tc) {
+	dns_anscache_t *cache = NULL;
+	dns_anscachekey_t key;
+	dns_fixedname_t fixed;
+	unsigned char data[512];
+	isc_buffer_t target;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_anscache_create(mctx, 100, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	makekey("www.example.", &fixed, &key);
+	addwire(cache, &key, 0xaa, 100, 0);
+
+	key.generation++;
+	isc_buffer_init(&target, data, sizeof(data));
+	result = dns_anscache_find(cache, &key, &target, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* The stale entry was removed by the lookup. */
+	ATF_CHECK_EQ(dns_anscache_count(cache), 0);
+	key.generation--;
+	isc_buffer_init(&target, data, sizeof(data));
+	result = dns_anscache_find(cache, &key, &target, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	dns_anscache_destroy(&cache);
+
+	dns_test_end();
+}
+
+ATF_TC(limit);
+ATF_TC_HEAD(limit, tc) {
+	atf_tc_set_md_var(tc, "descr", "the number of entries is bounded");
+}
+ATF_TC_BODY(limit, tc) {
+	dns_anscache_t *cache = NULL;
+	dns_anscachekey_t key;
+	dns_fixedname_t fixed;
+	unsigned char wire[DNS_ANSCACHE_MAXWIRE + 1];
+	char namestr[64];
+	isc_buffer_t target;
+	isc_region_t r;
+	isc_result_t result;
+	unsigned int i, tag = 0;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_anscache_create(mctx, 128, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 5000; i++) {
+		snprintf(namestr, sizeof(namestr), "h%u.example.", i);
+		makekey(namestr, &fixed, &key);
+		addwire(cache, &key, i & 0xff, 64, i);
+	}
+	ATF_CHECK(dns_anscache_count(cache) <= 128);
+
+	/* The most recent entry survives. */
+	isc_buffer_init(&target, wire, sizeof(wire));
+	result = dns_anscache_find(cache, &key, &target, &tag);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(tag, i - 1);
+
+	/* Oversized messages are refused. */
+	memset(wire, 0, sizeof(wire));
+	r.base = wire;
+	r.length = sizeof(wire);
+	result = dns_anscache_add(cache, &key, &r, 0);
+	ATF_CHECK_EQ(result, ISC_R_NOSPACE);
+
+	dns_anscache_destroy(&cache);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, addfind);
+	ATF_TP_ADD_TC(tp, generation);
+	ATF_TP_ADD_TC(tp, limit);
+	return (atf_no_error());
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+
+#include <isc/app.h>
+#include <isc/event.h>
+#include <isc/mutex.h>
+#include <isc/task.h>
+#include <isc/util.h>
+
+#include <dns/events.h>
+
+#include <dst/dst.h>
+
+#include "dnstest.h"
+
+#define NTASKS		4
+#define NJOBS		300
+
+typedef struct testevent {
+	ISC_EVENT_COMMON(struct testevent);
+	isc_boolean_t		worked;
+} testevent_t;
+
+static isc_mutex_t lock;
+static dst_cryptopool_t *pool = NULL;
+static isc_task_t *submitter = NULL;
+static unsigned int worked;
+static unsigned int done;
+static unsigned int notworked;
+static unsigned int wrongtask;
+
+/*
+ * Helper functions
+ */
+
+/*
+ * Runs on a pool task.
+ */
+static void
+work(isc_event_t *event) {
+	testevent_t *tevent = (testevent_t *)event;
+
+	LOCK(&lock);
+	worked++;
+	UNLOCK(&lock);
+	tevent->worked = ISC_TRUE;
+}
+
+static void
+jobdone(isc_task_t *task, isc_event_t *event) {
+	testevent_t *tevent = (testevent_t *)event;
+
+	if (!tevent->worked)
+		notworked++;
+	if (task != submitter)
+		wrongtask++;
+	isc_event_free(&event);
+	if (++done == NJOBS)
+		isc_app_shutdown();
+}
+
+static void
+submitjobs(isc_task_t *task, isc_event_t *event) {
+	testevent_t *tevent;
+	isc_event_t *ev;
+	unsigned int i;
+	isc_result_t result;
+
+	isc_event_free(&event);
+
+	for (i = 0; i < NJOBS; i++) {
+		tevent = (testevent_t *)
+			isc_event_allocate(mctx, task,
+					   DNS_EVENT_VALIDATORVERIFY,
+					   jobdone, NULL, sizeof(*tevent));
+		ATF_REQUIRE(tevent != NULL);
+		tevent->worked = ISC_FALSE;
+
+		ev = (isc_event_t *)tevent;
+		result = dst_cryptopool_submit(pool, work, task, &ev);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_REQUIRE_EQ(ev, NULL);
+	}
+}
+
+ATF_TC(submit);
+ATF_TC_HEAD(submit, tc) {
+	atf_tc_set_md_var(tc, "descr", "jobs run on the pool and complete "
+			  "on the submitting task");
+}
+ATF_TC_BODY(submit, tc) {
+	dst_cryptopool_t *pool2 = NULL;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = isc_mutex_init(&lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &submitter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dst_cryptopool_create(mctx, taskmgr, NTASKS, &pool);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dst_cryptopool_attach(pool, &pool2);
+
+	worked = done = notworked = wrongtask = 0;
+
+	result = isc_app_onrun(mctx, submitter, submitjobs, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_app_run();
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ATF_CHECK_EQ(done, NJOBS);
+	ATF_CHECK_EQ(worked, NJOBS);
+	ATF_CHECK_EQ(notworked, 0);
+	ATF_CHECK_EQ(wrongtask, 0);
+
+	dst_cryptopool_detach(&pool2);
+	dst_cryptopool_detach(&pool);
+	ATF_CHECK_EQ(pool, NULL);
+	isc_task_detach(&submitter);
+
+	dns_test_end();
+	DESTROYLOCK(&lock);
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, submit);
+
+	return (atf_no_error());
+}
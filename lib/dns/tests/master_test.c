@@ -15,6 +15,7 @@
 #include <atf-c.h>
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <isc/print.h>
@@ -650,6 +651,117 @@ ATF_TC_BODY(neworigin, tc) {
 	dns_test_end();
 }
 
+/* Parallel load */
+static void
+write_bigzone(const char *filename) {
+	FILE *fp;
+	unsigned int i;
+
+	fp = fopen(filename, "w");
+	ATF_REQUIRE(fp != NULL);
+	fprintf(fp, "$TTL 3600\n");
+	fprintf(fp, "@ SOA ns hostmaster ( 1 ; serial\n"
+		    "\t3600 900 604800 300 )\n");
+	fprintf(fp, "@ NS ns\nns A 10.53.0.1\n");
+	for (i = 0; i < 40000; i++) {
+		if (i % 1000 == 0)
+			fprintf(fp, "$ORIGIN sub%u.test.\n", i / 1000);
+		if (i % 3000 == 0)
+			fprintf(fp, "$TTL %u\n", 300 + i / 3000);
+		switch (i % 4) {
+		case 0:
+			fprintf(fp, "h%u A 10.0.%u.%u\n\tAAAA ::%x\n",
+				i, (i >> 8) & 0xff, i & 0xff, i & 0xffff);
+			break;
+		case 1:
+			fprintf(fp, "h%u 60 TXT \"a ; (\" \"\\\"b\" ; c (\n",
+				i);
+			break;
+		case 2:
+			fprintf(fp, "d%u NS ns.d%u\nns.d%u A 10.53.0.2\n",
+				i, i, i);
+			break;
+		case 3:
+			fprintf(fp, "h%u MX ( 10\n\tmail )\n; comment\n\n", i);
+			break;
+		}
+	}
+	fclose(fp);
+}
+
+static void
+load_bigzone(const char *filename, unsigned int jobs, const char *dumpname) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_rdatacallbacks_t dbcallbacks;
+
+	result = setup_master(NULL, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mctx, "rbt", &dns_origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_rdatacallbacks_init_stdio(&dbcallbacks);
+	result = dns_db_beginload(db, &dbcallbacks);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(dbcallbacks.addbatch != NULL);
+	result = dns_master_loadfile6(filename, &dns_origin, &dns_origin,
+				      dns_rdataclass_in, 0, 0, &dbcallbacks,
+				      NULL, NULL, mctx,
+				      dns_masterformat_text, 0, jobs);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_endload(db, &dbcallbacks);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_db_currentversion(db, &version);
+	result = dns_master_dump(mctx, db, version,
+				 &dns_master_style_default, dumpname);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, ISC_FALSE);
+	dns_db_detach(&db);
+}
+
+ATF_TC(parallel);
+ATF_TC_HEAD(parallel, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_master_loadfile6() loads the "
+				       "same data with several jobs as with "
+				       "one");
+}
+ATF_TC_BODY(parallel, tc) {
+	isc_result_t result;
+	char buf1[4096], buf2[4096];
+	size_t n1, n2;
+	FILE *fp1, *fp2;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	write_bigzone("test.parallel");
+	load_bigzone("test.parallel", 1, "test1.dump");
+	load_bigzone("test.parallel", 4, "test2.dump");
+
+	fp1 = fopen("test1.dump", "r");
+	fp2 = fopen("test2.dump", "r");
+	ATF_REQUIRE(fp1 != NULL && fp2 != NULL);
+	do {
+		n1 = fread(buf1, 1, sizeof(buf1), fp1);
+		n2 = fread(buf2, 1, sizeof(buf2), fp2);
+		ATF_REQUIRE_EQ(n1, n2);
+		ATF_REQUIRE(memcmp(buf1, buf2, n1) == 0);
+	} while (n1 != 0);
+	fclose(fp1);
+	fclose(fp2);
+
+	unlink("test.parallel");
+	unlink("test1.dump");
+	unlink("test2.dump");
+	dns_test_end();
+}
+
 /*
  * Main
  */
@@ -672,6 +784,7 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, toobig);
 	ATF_TP_ADD_TC(tp, maxrdata);
 	ATF_TP_ADD_TC(tp, neworigin);
+	ATF_TP_ADD_TC(tp, parallel);
 
 	return (atf_no_error());
 }
@@ -27,8 +27,12 @@
 #include <isc/util.h>
 
 #include <dns/compress.h>
+#include <dns/message.h>
 #include <dns/name.h>
 #include <dns/fixedname.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
 
 #include "dnstest.h"
 
@@ -277,6 +281,122 @@ ATF_TC_BODY(compression, tc) {
 	dns_test_end();
 }
 
+ATF_TC(compression_table);
+ATF_TC_HEAD(compression_table, tc) {
+	atf_tc_set_md_var(tc, "descr", "compression table growth, "
+			  "case folding and rollback");
+}
+ATF_TC_BODY(compression_table, tc) {
+	dns_compress_t cctx;
+	dns_decompress_t dctx;
+	dns_fixedname_t fixed;
+	dns_name_t *name, wname;
+	isc_buffer_t source, target;
+	unsigned char buf1[16384];
+	unsigned char buf2[DNS_NAME_MAXWIRE];
+	unsigned char saved[sizeof(buf1)];
+	unsigned int i, used, half;
+	char namestr[64];
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	ATF_REQUIRE_EQ(dns_test_begin(NULL, ISC_FALSE), ISC_R_SUCCESS);
+
+	ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	dns_compress_setsensitive(&cctx, ISC_FALSE);
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	isc_buffer_init(&source, buf1, sizeof(buf1));
+
+	/*
+	 * Enough names to grow the table several times.  Every name
+	 * after the first shares a suffix with an earlier one.
+	 */
+	half = 0;
+	for (i = 0; i < 400; i++) {
+		if (i == 200)
+			half = source.used;
+		snprintf(namestr, sizeof(namestr), "host%u.zone%u.example.",
+			 i, i % 7);
+		result = dns_name_fromstring(name, namestr, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		used = source.used;
+		result = dns_name_towire(name, &cctx, &source);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		if (i >= 7)
+			ATF_CHECK(source.used - used < name->length);
+	}
+
+	/*
+	 * An upper case copy of an earlier name compresses to a bare
+	 * pointer.
+	 */
+	result = dns_name_fromstring(name, "HOST150.ZONE3.EXAMPLE.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	used = source.used;
+	ATF_REQUIRE_EQ(dns_name_towire(name, &cctx, &source), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(source.used - used, 2);
+
+	/*
+	 * After rolling back the second half of the names, adding them
+	 * again must produce the same wire format.
+	 */
+	memmove(saved, buf1 + half, source.used - half);
+	used = source.used;
+	dns_compress_rollback(&cctx, (isc_uint16_t)half);
+	source.used = half;
+	for (i = 200; i < 400; i++) {
+		snprintf(namestr, sizeof(namestr), "host%u.zone%u.example.",
+			 i, i % 7);
+		result = dns_name_fromstring(name, namestr, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_name_towire(name, &cctx, &source);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	result = dns_name_fromstring(name, "HOST150.ZONE3.EXAMPLE.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE_EQ(dns_name_towire(name, &cctx, &source), ISC_R_SUCCESS);
+	ATF_REQUIRE_EQ(source.used, used);
+	ATF_CHECK(memcmp(saved, buf1 + half, used - half) == 0);
+
+	dns_compress_invalidate(&cctx);
+
+	/*
+	 * Everything decompresses to the names that were added.
+	 */
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_STRICT);
+	dns_decompress_setmethods(&dctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_setactive(&source, source.used);
+	for (i = 0; i < 401; i++) {
+		dns_fixedname_t efixed;
+		dns_name_t *expected;
+
+		if (i < 400)
+			snprintf(namestr, sizeof(namestr),
+				 "host%u.zone%u.example.", i, i % 7);
+		else
+			snprintf(namestr, sizeof(namestr),
+				 "host150.zone3.example.");
+		dns_fixedname_init(&efixed);
+		expected = dns_fixedname_name(&efixed);
+		result = dns_name_fromstring(expected, namestr, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		isc_buffer_init(&target, buf2, sizeof(buf2));
+		dns_name_init(&wname, NULL);
+		result = dns_name_fromwire(&wname, &source, &dctx, 0,
+					   &target);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK(dns_name_equal(&wname, expected));
+	}
+	dns_decompress_invalidate(&dctx);
+
+	dns_test_end();
+}
+
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
 
@@ -372,6 +492,207 @@ ATF_TC_BODY(benchmark, tc) {
 	dns_test_end();
 }
 
+ATF_TC(compress_benchmark);
+ATF_TC_HEAD(compress_benchmark, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "Benchmark name compression rendering large "
+			  "messages");
+}
+
+static unsigned char benchwire[65536];
+static isc_buffer_t benchbuffer;
+static dns_rdata_t benchrdata[1024];
+static unsigned int nbenchrdata;
+static dns_rdatalist_t benchrdatalist[512];
+static unsigned int nbenchrdatalist;
+
+/*
+ * Add an empty rrset of type 'type' owned by 'owner' to 'section'.
+ */
+static dns_rdatalist_t *
+bench_rrset(dns_message_t *msg, dns_section_t section, const char *owner,
+	    dns_rdatatype_t type)
+{
+	dns_rdatalist_t *rdatalist;
+	dns_rdataset_t *rdataset = NULL;
+	dns_name_t *name = NULL;
+	isc_result_t result;
+
+	ATF_REQUIRE(nbenchrdatalist < 512);
+	rdatalist = &benchrdatalist[nbenchrdatalist++];
+	dns_rdatalist_init(rdatalist);
+	rdatalist->rdclass = dns_rdataclass_in;
+	rdatalist->type = type;
+	rdatalist->ttl = 3600;
+
+	result = dns_message_gettempname(msg, &name);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_name_fromstring(name, owner, 0, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_message_gettemprdataset(msg, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_rdatalist_tordataset(rdatalist, rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ISC_LIST_APPEND(name->list, rdataset, link);
+	dns_message_addname(msg, name, section);
+
+	return (rdatalist);
+}
+
+/*
+ * Add a record to 'rdatalist'.  'value' is the address or the MX
+ * preference, 'target' the name for NS and MX records.
+ */
+static void
+bench_rdata(dns_rdatalist_t *rdatalist, unsigned int value,
+	    const char *target)
+{
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdata_t *rdata;
+	isc_region_t r;
+	isc_result_t result;
+
+	r.base = isc_buffer_used(&benchbuffer);
+	switch (rdatalist->type) {
+	case dns_rdatatype_a:
+		isc_buffer_putuint32(&benchbuffer, 0x0a000000 + value);
+		break;
+	case dns_rdatatype_aaaa:
+		isc_buffer_putuint32(&benchbuffer, 0x20010db8);
+		isc_buffer_putuint32(&benchbuffer, 0);
+		isc_buffer_putuint32(&benchbuffer, 0);
+		isc_buffer_putuint32(&benchbuffer, value);
+		break;
+	case dns_rdatatype_mx:
+		isc_buffer_putuint16(&benchbuffer, value);
+		/* FALLTHROUGH */
+	case dns_rdatatype_ns:
+		dns_fixedname_init(&fixed);
+		name = dns_fixedname_name(&fixed);
+		result = dns_name_fromstring(name, target, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		isc_buffer_putmem(&benchbuffer, name->ndata, name->length);
+		break;
+	default:
+		INSIST(0);
+	}
+	r.length = (unsigned char *)isc_buffer_used(&benchbuffer) - r.base;
+
+	ATF_REQUIRE(nbenchrdata < 1024);
+	rdata = &benchrdata[nbenchrdata++];
+	dns_rdata_init(rdata);
+	dns_rdata_fromregion(rdata, rdatalist->rdclass, rdatalist->type, &r);
+	ISC_LIST_APPEND(rdatalist->rdata, rdata, link);
+}
+
+static void
+bench_render(dns_message_t *msg, const char *what) {
+	unsigned int maxval = 200000;
+	unsigned char data[65535];
+	isc_buffer_t buffer;
+	isc_time_t ts1, ts2;
+	dns_compress_t cctx;
+	isc_result_t result;
+	unsigned int i;
+	double t;
+
+	result = isc_time_now(&ts1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < maxval; i++) {
+		isc_buffer_init(&buffer, data, sizeof(data));
+		result = dns_compress_init(&cctx, -1, mctx);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_compress_setsensitive(&cctx, ISC_FALSE);
+		result = dns_message_renderbegin(msg, &cctx, &buffer);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_message_rendersection(msg, DNS_SECTION_AUTHORITY,
+						   0);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_message_rendersection(msg, DNS_SECTION_ADDITIONAL,
+						   0);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_message_renderend(msg);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_message_renderreset(msg);
+		dns_compress_invalidate(&cctx);
+	}
+
+	result = isc_time_now(&ts2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	t = isc_time_microdiff(&ts2, &ts1);
+
+	printf("%s: %u bytes, %u renders, %f seconds, %f renders/second\n",
+	       what, isc_buffer_usedlength(&buffer), maxval, t / 1000000.0,
+	       maxval / (t / 1000000.0));
+}
+
+ATF_TC_BODY(compress_benchmark, tc) {
+	dns_message_t *msg = NULL;
+	dns_rdatalist_t *rdatalist, *ns;
+	char namestr[64], target[64];
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	debug_mem_record = ISC_FALSE;
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_buffer_init(&benchbuffer, benchwire, sizeof(benchwire));
+
+	/*
+	 * A referral: a large NS set and its address records.
+	 */
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, &msg);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ns = bench_rrset(msg, DNS_SECTION_AUTHORITY, "example.",
+			 dns_rdatatype_ns);
+	for (i = 0; i < 13; i++) {
+		snprintf(target, sizeof(target), "%c.gtld-servers.example.",
+			 'a' + i);
+		bench_rdata(ns, 0, target);
+		rdatalist = bench_rrset(msg, DNS_SECTION_ADDITIONAL, target,
+					dns_rdatatype_a);
+		bench_rdata(rdatalist, i, NULL);
+		rdatalist = bench_rrset(msg, DNS_SECTION_ADDITIONAL, target,
+					dns_rdatatype_aaaa);
+		bench_rdata(rdatalist, i, NULL);
+	}
+	bench_render(msg, "referral");
+	dns_message_destroy(&msg);
+
+	/*
+	 * A large answer with many owner names in mixed case, such as
+	 * a big ANY response or a chunk of a zone transfer.
+	 */
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, &msg);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (i = 0; i < 150; i++) {
+		snprintf(namestr, sizeof(namestr),
+			 (i % 2) == 0 ? "host%u.Zone.Example.COM." :
+					"HOST%u.zone.example.com.", i);
+		snprintf(target, sizeof(target), "mail%u.zone.example.com.",
+			 i % 5);
+		rdatalist = bench_rrset(msg, DNS_SECTION_ANSWER, namestr,
+					dns_rdatatype_a);
+		bench_rdata(rdatalist, i, NULL);
+		rdatalist = bench_rrset(msg, DNS_SECTION_ANSWER, namestr,
+					dns_rdatatype_mx);
+		bench_rdata(rdatalist, 10, target);
+	}
+	bench_render(msg, "bulk");
+	dns_message_destroy(&msg);
+
+	dns_test_end();
+}
+
 #endif /* DNS_BENCHMARK_TESTS */
 #endif /* ISC_PLATFORM_USETHREADS */
 
@@ -381,9 +702,11 @@ ATF_TC_BODY(benchmark, tc) {
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, fullcompare);
 	ATF_TP_ADD_TC(tp, compression);
+	ATF_TP_ADD_TC(tp, compression_table);
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
 	ATF_TP_ADD_TC(tp, benchmark);
+	ATF_TP_ADD_TC(tp, compress_benchmark);
 #endif /* DNS_BENCHMARK_TESTS */
 #endif /* ISC_PLATFORM_USETHREADS */
 
@@ -143,11 +143,12 @@ fix_data(dns_rbtnode_t *p, void *base, size_t max, void *arg,
 	 isc_uint64_t *crc)
 {
 	data_holder_t *data = p->data;
+	const char *offset;
+	char *fixed;
 	size_t size;
 
 	UNUSED(base);
 	UNUSED(max);
-	UNUSED(arg);
 
 	REQUIRE(crc != NULL);
 	REQUIRE(p != NULL);
@@ -165,16 +166,22 @@ fix_data(dns_rbtnode_t *p, void *base, size_t max, void *arg,
 
 	size = max - ((char *)p - (char *)base);
 
-	if (data->len > (int) size || data->data > (const char *) max) {
+	/* 'arg' is the address a prelinked image was prelinked for. */
+	offset = data->data;
+	if (arg != NULL && offset != NULL)
+		offset -= *(uintptr_t *)arg;
+
+	if (data->len > (int) size || offset > (const char *) max) {
 		printf("data invalid\n");
 		return (ISC_R_INVALIDFILE);
 	}
 
 	isc_crc64_update(crc, (void *)data, sizeof(*data));
 
-	data->data = (data->len == 0)
-		? NULL
-		: (char *)data + sizeof(data_holder_t);
+	/* Don't write to a prelinked image that needs no fixing. */
+	fixed = (data->len == 0) ? NULL : (char *)data + sizeof(data_holder_t);
+	if (data->data != fixed)
+		data->data = fixed;
 
 	if (data->len > 0)
 		isc_crc64_update(crc, (const void *)data->data, data->len);
@@ -182,6 +189,25 @@ fix_data(dns_rbtnode_t *p, void *base, size_t max, void *arg,
 	return (ISC_R_SUCCESS);
 }
 
+static void
+rebase_data(dns_rbtnode_t *p, void *base, isc_uint64_t mapbase, void *arg,
+	    isc_uint64_t *crc)
+{
+	data_holder_t *data = p->data;
+
+	UNUSED(arg);
+
+	if (data->len != 0)
+		data->data = (char *)((uintptr_t)data->data -
+				      (uintptr_t)base + (uintptr_t)mapbase);
+
+	isc_crc64_update(crc, (void *)data, sizeof(*data));
+	if (data->len > 0)
+		isc_crc64_update(crc, (const void *)((char *)data +
+						     sizeof(*data)),
+				 data->len);
+}
+
 /*
  * Load test data into the RBT.
  */
@@ -422,6 +448,101 @@ ATF_TC_BODY(deserialize_corrupt, tc) {
 	dns_test_end();
 }
 
+ATF_TC(prelink);
+ATF_TC_HEAD(prelink, tc) {
+	atf_tc_set_md_var(tc, "descr", "Test loading a prelinked map file");
+}
+ATF_TC_BODY(prelink, tc) {
+	dns_rbt_t *rbt = NULL;
+	isc_result_t result;
+	FILE *rbtfile = NULL;
+	off_t offset;
+	int fd;
+	off_t filesize = 0;
+	char *base, *mapbase, *reloc;
+	uintptr_t linkbase;
+
+	UNUSED(tc);
+
+	isc_mem_debugging = ISC_MEM_DEBUGRECORD;
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rbt_create(mctx, delete_data, NULL, &rbt);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	add_test_data(mctx, rbt);
+	rbtfile = fopen("./zone.bin", "w+b");
+	ATF_REQUIRE(rbtfile != NULL);
+	result = dns_rbt_serialize_tree(rbtfile, rbt, write_data, NULL,
+					&offset);
+	ATF_REQUIRE(result == ISC_R_SUCCESS);
+	fclose(rbtfile);
+	dns_rbt_destroy(&rbt);
+
+	fd = open("zone.bin", O_RDWR);
+	ATF_REQUIRE(fd >= 0);
+	isc_file_getsizefd(fd, &filesize);
+
+	/* Find an address range that is free, to prelink for. */
+	mapbase = mmap(NULL, filesize, PROT_NONE,
+		       MAP_ANON|MAP_PRIVATE, -1, 0);
+	ATF_REQUIRE(mapbase != MAP_FAILED);
+	munmap(mapbase, filesize);
+	linkbase = (uintptr_t)mapbase;
+
+	base = mmap(NULL, filesize, PROT_READ|PROT_WRITE,
+		    MAP_FILE|MAP_SHARED, fd, 0);
+	ATF_REQUIRE(base != MAP_FAILED);
+	result = dns_rbt_prelink_tree(base, filesize, 0,
+				      linkbase, mctx,
+				      fix_data, NULL, rebase_data, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_rbt_prelink_tree(base, filesize, 0,
+				      linkbase, mctx,
+				      fix_data, NULL, rebase_data, NULL);
+	ATF_CHECK_EQ(result, ISC_R_EXISTS);
+	munmap(base, filesize);
+
+	/*
+	 * Mapped at the address it was prelinked for, the image must
+	 * load without being written to.
+	 */
+	base = mmap(mapbase, filesize, PROT_READ, MAP_FILE|MAP_PRIVATE, fd, 0);
+	ATF_REQUIRE(base != MAP_FAILED);
+	ATF_CHECK_EQ(base, mapbase);
+	if (base == mapbase) {
+		result = dns_rbt_deserialize_tree(base, filesize, 0, mctx,
+						  delete_data, NULL,
+						  fix_data, &linkbase,
+						  NULL, &rbt);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		check_test_data(rbt);
+
+		/* Destroying the tree writes to the nodes. */
+		mprotect(base, filesize, PROT_READ|PROT_WRITE);
+		dns_rbt_destroy(&rbt);
+	}
+
+	/* Anywhere else, it is relocated. */
+	reloc = mmap(NULL, filesize, PROT_READ|PROT_WRITE,
+		     MAP_FILE|MAP_PRIVATE, fd, 0);
+	ATF_REQUIRE(reloc != MAP_FAILED);
+	ATF_CHECK(reloc != mapbase);
+	result = dns_rbt_deserialize_tree(reloc, filesize, 0, mctx,
+					  delete_data, NULL, fix_data, &linkbase,
+					  NULL, &rbt);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	check_test_data(rbt);
+	dns_rbt_destroy(&rbt);
+	munmap(reloc, filesize);
+	munmap(base, filesize);
+
+	close(fd);
+	unlink("zone.bin");
+	dns_test_end();
+}
 
 ATF_TC(serialize_align);
 ATF_TC_HEAD(serialize_align, tc) {
@@ -451,6 +572,7 @@ ATF_TC_BODY(serialize_align, tc) {
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, serialize);
 	ATF_TP_ADD_TC(tp, deserialize_corrupt);
+	ATF_TP_ADD_TC(tp, prelink);
 	ATF_TP_ADD_TC(tp, serialize_align);
 
 	return (atf_no_error());
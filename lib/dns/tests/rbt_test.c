@@ -1070,6 +1070,109 @@ ATF_TC_BODY(rbt_insert_and_remove, tc) {
 	dns_test_end();
 }
 
+#define REHASH_NAMES	20000
+
+/*
+ * Look up every one of the first 'count' names of rbt_rehash and check
+ * that it is found if and only if it is present.
+ */
+static void
+check_rehash_names(dns_rbt_t *mytree, isc_boolean_t *present,
+		   unsigned int count)
+{
+	char namebuf[32];
+	dns_fixedname_t fname, ffound;
+	isc_result_t result;
+	unsigned int i;
+	size_t *n;
+
+	dns_fixedname_init(&ffound);
+	for (i = 0; i < count; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%u.", i);
+		build_name_from_str(namebuf, &fname);
+		n = NULL;
+		result = dns_rbt_findname(mytree, dns_fixedname_name(&fname),
+					  0, dns_fixedname_name(&ffound),
+					  (void *) &n);
+		if (present[i]) {
+			ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+			if (result == ISC_R_SUCCESS)
+				ATF_CHECK_EQ(*n, i);
+		} else
+			ATF_CHECK(result != ISC_R_SUCCESS);
+	}
+}
+
+ATF_TC(rbt_rehash);
+ATF_TC_HEAD(rbt_rehash, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "Test that names are found, added and removed "
+			  "while the hash table is being rehashed");
+}
+ATF_TC_BODY(rbt_rehash, tc) {
+	isc_result_t result;
+	dns_rbt_t *mytree = NULL;
+	isc_boolean_t *present;
+	isc_boolean_t rehashing = ISC_FALSE;
+	dns_fixedname_t fname;
+	char namebuf[32];
+	unsigned int i;
+	size_t *n;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rbt_create(mctx, delete_data, NULL, &mytree);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	present = isc_mem_get(mctx, REHASH_NAMES * sizeof(isc_boolean_t));
+	ATF_REQUIRE(present != NULL);
+	memset(present, 0, REHASH_NAMES * sizeof(isc_boolean_t));
+
+	for (i = 0; i < REHASH_NAMES; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%u.", i);
+		build_name_from_str(namebuf, &fname);
+		n = isc_mem_get(mctx, sizeof(size_t));
+		ATF_REQUIRE(n != NULL);
+		*n = i;
+		result = dns_rbt_addname(mytree, dns_fixedname_name(&fname),
+					 n);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		present[i] = ISC_TRUE;
+
+		/*
+		 * Remove some names as we go, some of them from buckets
+		 * that have not been moved to the new table yet.
+		 */
+		if (i % 5 == 4) {
+			snprintf(namebuf, sizeof(namebuf), "n%u.", i - 3);
+			build_name_from_str(namebuf, &fname);
+			result = dns_rbt_deletename(mytree,
+						    dns_fixedname_name(&fname),
+						    ISC_FALSE);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			present[i - 3] = ISC_FALSE;
+		}
+
+		if (dns_rbt_hashpending(mytree) != 0) {
+			rehashing = ISC_TRUE;
+			if (i % 97 == 0)
+				check_rehash_names(mytree, present, i + 1);
+		}
+	}
+
+	ATF_CHECK(rehashing);
+	ATF_CHECK(dns_rbt_hashsize(mytree) > 64);
+	check_rehash_names(mytree, present, REHASH_NAMES);
+
+	isc_mem_put(mctx, present, REHASH_NAMES * sizeof(isc_boolean_t));
+	dns_rbt_destroy(&mytree);
+
+	dns_test_end();
+}
+
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
 
@@ -1212,6 +1315,7 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, rbt_insert);
 	ATF_TP_ADD_TC(tp, rbt_remove);
 	ATF_TP_ADD_TC(tp, rbt_insert_and_remove);
+	ATF_TP_ADD_TC(tp, rbt_rehash);
 #ifdef ISC_PLATFORM_USETHREADS
 #ifdef DNS_BENCHMARK_TESTS
 	ATF_TP_ADD_TC(tp, benchmark);
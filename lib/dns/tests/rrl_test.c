@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <isc/print.h>
+#include <isc/sockaddr.h>
+#include <isc/stdtime.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rrl.h>
+#include <dns/view.h>
+
+#include "dnstest.h"
+
+#define STATSFILE	"./rrl_test.stats"
+#define RATE		5
+#define QUERIES		20
+#define CLIENTS		64
+#define NTHREADS	4
+
+static dns_view_t *view = NULL;
+static dns_name_t *qname = NULL;
+static dns_fixedname_t fqname;
+static isc_stdtime_t now;
+
+static void
+setup_rrl(void) {
+	dns_rrl_t *rrl = NULL;
+	isc_result_t result;
+
+	result = dns_test_makeview("view", &view);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rrl_init(&rrl, view, 10);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	rrl->max_entries = 1000;
+	rrl->responses_per_second.r = RATE;
+	rrl->referrals_per_second.r = RATE;
+	rrl->nodata_per_second.r = RATE;
+	rrl->nxdomains_per_second.r = RATE;
+	rrl->errors_per_second.r = RATE;
+	rrl->responses_per_second.scaled = RATE;
+	rrl->referrals_per_second.scaled = RATE;
+	rrl->nodata_per_second.scaled = RATE;
+	rrl->nxdomains_per_second.scaled = RATE;
+	rrl->errors_per_second.scaled = RATE;
+	rrl->slip.r = 2;
+	rrl->slip.scaled = 2;
+	rrl->window = 15;
+	rrl->ipv4_prefixlen = 24;
+	rrl->ipv4_mask = htonl(0xffffff00);
+	rrl->ipv6_prefixlen = 56;
+	rrl->ipv6_mask[0] = 0xffffffff;
+	rrl->ipv6_mask[1] = htonl(0xffffff00);
+
+	dns_fixedname_init(&fqname);
+	qname = dns_fixedname_name(&fqname);
+	result = dns_name_fromstring(qname, "www.example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+}
+
+/*
+ * Client 'n' lives in its own /24.
+ */
+static void
+client_addr(isc_sockaddr_t *sa, unsigned int n) {
+	struct in_addr ina;
+
+	ina.s_addr = htonl(0x0a000000 | (n << 8) | 1);
+	isc_sockaddr_fromin(sa, &ina, 53);
+}
+
+/*
+ * Send QUERIES responses for client 'n' in one second and count the
+ * outcomes.
+ */
+static void
+burst(unsigned int n, unsigned int *ok, unsigned int *dropped,
+      unsigned int *slipped)
+{
+	char log_buf[DNS_RRL_LOG_BUF_LEN];
+	isc_sockaddr_t sa;
+	unsigned int i;
+
+	client_addr(&sa, n);
+	for (i = 0; i < QUERIES; i++) {
+		switch (dns_rrl(view, &sa, ISC_FALSE, dns_rdataclass_in,
+				dns_rdatatype_a, qname, ISC_R_SUCCESS, now,
+				ISC_FALSE, log_buf, sizeof(log_buf)))
+		{
+		case DNS_RRL_RESULT_OK:
+			(*ok)++;
+			break;
+		case DNS_RRL_RESULT_DROP:
+			(*dropped)++;
+			break;
+		case DNS_RRL_RESULT_SLIP:
+			(*slipped)++;
+			break;
+		}
+	}
+}
+
+/*
+ * Read a total back from the statistics dump.
+ */
+static unsigned long
+stats_total(const char *desc) {
+	char line[256];
+	unsigned long value;
+	FILE *fp;
+
+	fp = fopen(STATSFILE, "r");
+	ATF_REQUIRE(fp != NULL);
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (strstr(line, desc) != NULL &&
+		    sscanf(line, "%lu", &value) == 1)
+		{
+			fclose(fp);
+			return (value);
+		}
+	}
+	fclose(fp);
+	ATF_CHECK_MSG(0, "'%s' not found", desc);
+	return (0);
+}
+
+static void
+dump_stats(void) {
+	FILE *fp;
+
+	fp = fopen(STATSFILE, "w");
+	ATF_REQUIRE(fp != NULL);
+	dns_rrl_dumpstats(view->rrl, fp);
+	fclose(fp);
+}
+
+ATF_TC(limit);
+ATF_TC_HEAD(limit, tc) {
+	atf_tc_set_md_var(tc, "descr", "responses over the limit are "
+			  "dropped or slipped, and counted");
+}
+ATF_TC_BODY(limit, tc) {
+	isc_result_t result;
+	unsigned int n, ok, dropped, slipped;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	setup_rrl();
+
+	for (n = 0; n < CLIENTS; n++) {
+		ok = dropped = slipped = 0;
+		burst(n, &ok, &dropped, &slipped);
+		ATF_CHECK_EQ(ok, RATE);
+		ATF_CHECK_EQ(dropped + slipped, QUERIES - RATE);
+		ATF_CHECK(slipped > 0);
+		ATF_CHECK(dropped > 0);
+	}
+
+	dump_stats();
+	ATF_CHECK_EQ(stats_total("responses checked"), CLIENTS * QUERIES);
+	ATF_CHECK_EQ(stats_total("responses dropped") +
+		     stats_total("responses slipped"),
+		     CLIENTS * (QUERIES - RATE));
+	ATF_CHECK(stats_total("table entries") >= CLIENTS);
+	(void)unlink(STATSFILE);
+
+	dns_view_detach(&view);
+	dns_test_end();
+}
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+worker(void *arg) {
+	unsigned int id = *(unsigned int *)arg;
+	unsigned int n, ok = 0, dropped = 0, slipped = 0;
+
+	for (n = id; n < CLIENTS; n += NTHREADS)
+		burst(n, &ok, &dropped, &slipped);
+
+	*(unsigned int *)arg = ok;
+	return ((isc_threadresult_t)0);
+}
+
+ATF_TC(threads);
+ATF_TC_HEAD(threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "clients rate limited from several "
+			  "threads at once keep their own limits");
+}
+ATF_TC_BODY(threads, tc) {
+	isc_result_t result;
+	isc_thread_t threads[NTHREADS];
+	unsigned int args[NTHREADS];
+	unsigned int i, ok = 0;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	setup_rrl();
+
+	for (i = 0; i < NTHREADS; i++) {
+		args[i] = i;
+		result = isc_thread_create(worker, &args[i], &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++) {
+		(void)isc_thread_join(threads[i], NULL);
+		ok += args[i];
+	}
+	ATF_CHECK_EQ(ok, CLIENTS * RATE);
+
+	dump_stats();
+	ATF_CHECK_EQ(stats_total("responses checked"), CLIENTS * QUERIES);
+	(void)unlink(STATSFILE);
+
+	dns_view_detach(&view);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, limit);
+	ATF_TP_ADD_TC(tp, threads);
+	return (atf_no_error());
+}
@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/keyvalues.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/rdatastruct.h>
+#include <dns/result.h>
+#include <dns/sigcache.h>
+
+#include <dst/dst.h>
+
+#include "dnstest.h"
+
+#define INCEPTION	1000000000U
+#define EXPIRATION	1001000000U
+
+/*
+ * Helper functions
+ */
+
+static void
+fromtext(const char *namestr, dns_fixedname_t *fixed) {
+	isc_buffer_t b;
+	isc_result_t result;
+
+	dns_fixedname_init(fixed);
+	isc_buffer_constinit(&b, namestr, strlen(namestr));
+	isc_buffer_add(&b, strlen(namestr));
+	result = dns_name_fromtext(dns_fixedname_name(fixed), &b,
+				   dns_rootname, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static dst_key_t *
+makezonekey(unsigned char fill) {
+	unsigned char secret[32];
+	isc_buffer_t b;
+	dst_key_t *key = NULL;
+	isc_result_t result;
+
+	memset(secret, fill, sizeof(secret));
+	isc_buffer_init(&b, secret, sizeof(secret));
+	isc_buffer_add(&b, sizeof(secret));
+	result = dst_key_frombuffer(dns_rootname, DST_ALG_HMACSHA256,
+				    DNS_KEYOWNER_ZONE, DNS_KEYPROTO_DNSSEC,
+				    dns_rdataclass_in, &b, mctx, &key);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	return (key);
+}
+
+/*
+ * Build a one record A RRset for address 'addr' in 'rdataset', using
+ * 'rdatalist', 'rdata' and 'data' as storage.
+ */
+static void
+makerdataset(isc_uint32_t addr, dns_rdatalist_t *rdatalist,
+	     dns_rdata_t *rdata, unsigned char data[4],
+	     dns_rdataset_t *rdataset)
+{
+	isc_region_t r;
+
+	data[0] = (unsigned char)(addr >> 24);
+	data[1] = (unsigned char)(addr >> 16);
+	data[2] = (unsigned char)(addr >> 8);
+	data[3] = (unsigned char)addr;
+	r.base = data;
+	r.length = 4;
+
+	dns_rdata_init(rdata);
+	dns_rdata_fromregion(rdata, dns_rdataclass_in, dns_rdatatype_a, &r);
+	dns_rdatalist_init(rdatalist);
+	rdatalist->type = dns_rdatatype_a;
+	rdatalist->rdclass = dns_rdataclass_in;
+	rdatalist->ttl = 300;
+	ISC_LIST_APPEND(rdatalist->rdata, rdata, link);
+	dns_rdataset_init(rdataset);
+	ATF_REQUIRE_EQ(dns_rdatalist_tordataset(rdatalist, rdataset),
+		       ISC_R_SUCCESS);
+}
+
+/*
+ * Build an RRSIG covering type A with 'labels' labels in 'sigrdata'.
+ * The signature itself is never checked by the cache.
+ */
+static void
+makesig(unsigned int labels, dns_rdata_t *sigrdata, unsigned char *data,
+	unsigned int size)
+{
+	dns_rdata_rrsig_t sig;
+	unsigned char sigdata[32];
+	isc_buffer_t b;
+	isc_result_t result;
+
+	memset(sigdata, 0x5a, sizeof(sigdata));
+	memset(&sig, 0, sizeof(sig));
+	sig.common.rdclass = dns_rdataclass_in;
+	sig.common.rdtype = dns_rdatatype_rrsig;
+	ISC_LINK_INIT(&sig.common, link);
+	sig.covered = dns_rdatatype_a;
+	sig.algorithm = DST_ALG_HMACSHA256;
+	sig.labels = labels;
+	sig.originalttl = 300;
+	sig.timesigned = INCEPTION;
+	sig.timeexpire = EXPIRATION;
+	sig.keyid = 1;
+	dns_name_init(&sig.signer, NULL);
+	dns_name_clone(dns_rootname, &sig.signer);
+	sig.siglen = sizeof(sigdata);
+	sig.signature = sigdata;
+
+	dns_rdata_init(sigrdata);
+	isc_buffer_init(&b, data, size);
+	result = dns_rdata_fromstruct(sigrdata, dns_rdataclass_in,
+				      dns_rdatatype_rrsig, &sig, &b);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+ATF_TC(addfind);
+ATF_TC_HEAD(addfind, tc) {
+	atf_tc_set_md_var(tc, "descr", "verified signatures are found again");
+}
+ATF_TC_BODY(addfind, tc) {
+	dns_sigcache_t *cache = NULL;
+	dns_sigcachekey_t sckey, other;
+	dns_fixedname_t fixed, ufixed;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata, sigrdata;
+	unsigned char data[4], sigdata[512];
+	dst_key_t *key = NULL, *key2 = NULL;
+	isc_stdtime_t now = INCEPTION + 10;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_sigcache_create(mctx, 100, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_sigcache_getsize(cache), 100);
+
+	fromtext("www.example.", &fixed);
+	fromtext("WWW.Example.", &ufixed);
+	key = makezonekey(1);
+	key2 = makezonekey(2);
+	makerdataset(0x0a000001, &rdatalist, &rdata, data, &rdataset);
+	makesig(2, &sigrdata, sigdata, sizeof(sigdata));
+
+	result = dns_sigcache_makekey(dns_fixedname_name(&fixed), &rdataset,
+				      &sigrdata, key, 0, &sckey);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(!sckey.wildcard);
+	ATF_CHECK_EQ(sckey.inception, INCEPTION);
+	ATF_CHECK_EQ(sckey.expiration, EXPIRATION);
+
+	ATF_CHECK_EQ(dns_sigcache_find(cache, &sckey, now, NULL),
+		     ISC_R_NOTFOUND);
+	ATF_CHECK_EQ(dns_sigcache_add(cache, &sckey), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_sigcache_find(cache, &sckey, now, NULL),
+		     ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_sigcache_count(cache), 1);
+
+	/* Adding the same signature again doesn't make a new entry. */
+	ATF_CHECK_EQ(dns_sigcache_add(cache, &sckey), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_sigcache_count(cache), 1);
+
+	/* The owner name is compared case-insensitively. */
+	result = dns_sigcache_makekey(dns_fixedname_name(&ufixed), &rdataset,
+				      &sigrdata, key, 0, &other);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_sigcache_find(cache, &other, now, NULL),
+		     ISC_R_SUCCESS);
+
+	/* A different key or key size limit is a different entry. */
+	result = dns_sigcache_makekey(dns_fixedname_name(&fixed), &rdataset,
+				      &sigrdata, key2, 0, &other);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_sigcache_find(cache, &other, now, NULL),
+		     ISC_R_NOTFOUND);
+	result = dns_sigcache_makekey(dns_fixedname_name(&fixed), &rdataset,
+				      &sigrdata, key, 1024, &other);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_sigcache_find(cache, &other, now, NULL),
+		     ISC_R_NOTFOUND);
+
+	/* So is different RRset data. */
+	dns_rdataset_disassociate(&rdataset);
+	makerdataset(0x0a000002, &rdatalist, &rdata, data, &rdataset);
+	result = dns_sigcache_makekey(dns_fixedname_name(&fixed), &rdataset,
+				      &sigrdata, key, 0, &other);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_sigcache_find(cache, &other, now, NULL),
+		     ISC_R_NOTFOUND);
+
+	dns_sigcache_flush(cache);
+	ATF_CHECK_EQ(dns_sigcache_count(cache), 0);
+	ATF_CHECK_EQ(dns_sigcache_find(cache, &sckey, now, NULL),
+		     ISC_R_NOTFOUND);
+
+	dns_rdataset_disassociate(&rdataset);
+	dst_key_free(&key);
+	dst_key_free(&key2);
+	dns_sigcache_detach(&cache);
+	ATF_CHECK_EQ(cache, NULL);
+
+	dns_test_end();
+}
+
+ATF_TC(validity);
+ATF_TC_HEAD(validity, tc) {
+	atf_tc_set_md_var(tc, "descr", "signatures are only found while "
+			  "they are valid");
+}
+ATF_TC_BODY(validity, tc) {
+	dns_sigcache_t *cache = NULL;
+	dns_sigcachekey_t sckey;
+	dns_fixedname_t fixed;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata, sigrdata;
+	unsigned char data[4], sigdata[512];
+	dst_key_t *key = NULL;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_sigcache_create(mctx, 100, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	fromtext("www.example.", &fixed);
+	key = makezonekey(1);
+	makerdataset(0x0a000001, &rdatalist, &rdata, data, &rdataset);
+	makesig(2, &sigrdata, sigdata, sizeof(sigdata));
+
+	result = dns_sigcache_makekey(dns_fixedname_name(&fixed), &rdataset,
+				      &sigrdata, key, 0, &sckey);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_sigcache_add(cache, &sckey), ISC_R_SUCCESS);
+
+	ATF_CHECK_EQ(dns_sigcache_find(cache, &sckey, INCEPTION, NULL),
+		     ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_sigcache_find(cache, &sckey, EXPIRATION, NULL),
+		     ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_sigcache_find(cache, &sckey, INCEPTION - 1, NULL),
+		     ISC_R_NOTFOUND);
+	ATF_CHECK_EQ(dns_sigcache_find(cache, &sckey, EXPIRATION + 1, NULL),
+		     ISC_R_NOTFOUND);
+
+	dns_rdataset_disassociate(&rdataset);
+	dst_key_free(&key);
+	dns_sigcache_detach(&cache);
+
+	dns_test_end();
+}
+
+ATF_TC(wildcard);
+ATF_TC_HEAD(wildcard, tc) {
+	atf_tc_set_md_var(tc, "descr", "wildcard expansions are reported "
+			  "as they are by dns_dnssec_verify3()");
+}
+ATF_TC_BODY(wildcard, tc) {
+	dns_sigcache_t *cache = NULL;
+	dns_sigcachekey_t sckey;
+	dns_fixedname_t fixed, expected, found;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata, sigrdata;
+	unsigned char data[4], sigdata[512];
+	dst_key_t *key = NULL;
+	isc_stdtime_t now = INCEPTION + 10;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_sigcache_create(mctx, 100, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	fromtext("a.b.example.", &fixed);
+	fromtext("*.b.example.", &expected);
+	key = makezonekey(1);
+	makerdataset(0x0a000001, &rdatalist, &rdata, data, &rdataset);
+	makesig(2, &sigrdata, sigdata, sizeof(sigdata));
+
+	result = dns_sigcache_makekey(dns_fixedname_name(&fixed), &rdataset,
+				      &sigrdata, key, 0, &sckey);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(sckey.wildcard);
+	ATF_CHECK(dns_name_equal(dns_fixedname_name(&sckey.wild),
+				 dns_fixedname_name(&expected)));
+
+	ATF_CHECK_EQ(dns_sigcache_add(cache, &sckey), ISC_R_SUCCESS);
+	dns_fixedname_init(&found);
+	ATF_CHECK_EQ(dns_sigcache_find(cache, &sckey, now,
+				       dns_fixedname_name(&found)),
+		     DNS_R_FROMWILDCARD);
+	ATF_CHECK(dns_name_equal(dns_fixedname_name(&found),
+				 dns_fixedname_name(&expected)));
+	ATF_CHECK_EQ(dns_sigcache_find(cache, &sckey, now, NULL),
+		     DNS_R_FROMWILDCARD);
+
+	dns_rdataset_disassociate(&rdataset);
+	dst_key_free(&key);
+	dns_sigcache_detach(&cache);
+
+	dns_test_end();
+}
+
+ATF_TC(evict);
+ATF_TC_HEAD(evict, tc) {
+	atf_tc_set_md_var(tc, "descr", "the cache does not grow past its "
+			  "size");
+}
+ATF_TC_BODY(evict, tc) {
+	dns_sigcache_t *cache = NULL;
+	dns_sigcachekey_t sckey;
+	dns_fixedname_t fixed;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata, sigrdata;
+	unsigned char data[4], sigdata[512];
+	dst_key_t *key = NULL;
+	isc_stdtime_t now = INCEPTION + 10;
+	isc_uint32_t i;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_sigcache_create(mctx, 32, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	fromtext("www.example.", &fixed);
+	key = makezonekey(1);
+	makesig(2, &sigrdata, sigdata, sizeof(sigdata));
+
+	for (i = 0; i < 1000; i++) {
+		makerdataset(0x0a000000 + i, &rdatalist, &rdata, data,
+			     &rdataset);
+		result = dns_sigcache_makekey(dns_fixedname_name(&fixed),
+					      &rdataset, &sigrdata, key, 0,
+					      &sckey);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_REQUIRE_EQ(dns_sigcache_add(cache, &sckey),
+			       ISC_R_SUCCESS);
+		dns_rdataset_disassociate(&rdataset);
+		ATF_REQUIRE(dns_sigcache_count(cache) <= 32);
+	}
+
+	/* The most recent entry is always kept. */
+	ATF_CHECK_EQ(dns_sigcache_find(cache, &sckey, now, NULL),
+		     ISC_R_SUCCESS);
+	ATF_CHECK(dns_sigcache_count(cache) > 0);
+
+	dst_key_free(&key);
+	dns_sigcache_detach(&cache);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, addfind);
+	ATF_TP_ADD_TC(tp, validity);
+	ATF_TP_ADD_TC(tp, wildcard);
+	ATF_TP_ADD_TC(tp, evict);
+
+	return (atf_no_error());
+}
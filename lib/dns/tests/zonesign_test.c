@@ -0,0 +1,389 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/result.h>
+#include <isc/util.h>
+
+#include <dns/adb.h>
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/dnssec.h>
+#include <dns/fixedname.h>
+#include <dns/journal.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/rdatasetiter.h>
+#include <dns/rdatastruct.h>
+#include <dns/rdatatype.h>
+#include <dns/view.h>
+#include <dns/zone.h>
+
+#include <dst/dst.h>
+
+#include "dnstest.h"
+
+/*
+ * The zone in testdata/zonesign is signed with a HMAC-SHA256 "zone key"
+ * so the test does not depend on a public key crypto provider.
+ */
+#define ZONEFILE	"testdata/zonesign/example.db"
+#define KEYDIR		"testdata/zonesign"
+#define KEYID		43961
+#define JOURNAL		"zonesign.jnl"
+#define PRIVATETYPE	65534
+#define DIFFSIZE	(512 * 1024)
+
+/*
+ * Helper functions
+ */
+
+/*
+ * Has signing the zone with the test key finished?
+ */
+static isc_boolean_t
+signing_complete(dns_zone_t *zone) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_boolean_t complete = ISC_FALSE;
+
+	dns_rdataset_init(&rdataset);
+	if (dns_zone_getdb(zone, &db) != ISC_R_SUCCESS)
+		return (ISC_FALSE);
+	result = dns_db_getoriginnode(db, &node);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	result = dns_db_findrdataset(db, node, NULL, PRIVATETYPE, 0, 0,
+				     &rdataset, NULL);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	for (result = dns_rdataset_first(&rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(&rdataset))
+	{
+		dns_rdataset_current(&rdataset, &rdata);
+		if (rdata.length == 5 && rdata.data[0] == DST_ALG_HMACSHA256 &&
+		    rdata.data[1] == ((KEYID >> 8) & 0xff) &&
+		    rdata.data[2] == (KEYID & 0xff) && rdata.data[4] != 0)
+			complete = ISC_TRUE;
+		dns_rdata_reset(&rdata);
+	}
+
+ cleanup:
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+	if (node != NULL)
+		dns_db_detachnode(db, &node);
+	dns_db_detach(&db);
+	return (complete);
+}
+
+/*
+ * Append a line describing 'rdata' at 'name' to 'out'.  The validity
+ * period and the signature of a RRSIG record depend on when it was
+ * generated so only the rest of it is described.
+ */
+static void
+append_rr(isc_buffer_t *out, dns_name_t *name, isc_uint32_t ttl,
+	  dns_rdata_t *rdata)
+{
+	isc_result_t result;
+	char data[4096], num[64];
+	isc_buffer_t b;
+	isc_region_t r;
+
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_name_totext(name, ISC_FALSE, &b);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	snprintf(num, sizeof(num), " %u ", ttl);
+	isc_buffer_putstr(&b, num);
+	result = dns_rdatatype_totext(rdata->type, &b);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_putstr(&b, " ");
+	if (rdata->type == dns_rdatatype_rrsig) {
+		dns_rdata_rrsig_t sig;
+
+		result = dns_rdata_tostruct(rdata, &sig, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_rdatatype_totext(sig.covered, &b);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		snprintf(num, sizeof(num), " %u %u %u %u ", sig.algorithm,
+			 sig.labels, sig.originalttl, sig.keyid);
+		isc_buffer_putstr(&b, num);
+		result = dns_name_totext(&sig.signer, ISC_FALSE, &b);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_rdata_freestruct(&sig);
+	} else {
+		result = dns_rdata_totext(rdata, NULL, &b);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	isc_buffer_putstr(&b, "\n");
+	isc_buffer_usedregion(&b, &r);
+	result = isc_buffer_copyregion(out, &r);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+/*
+ * Describe every change in the journal in 'out', in order.
+ */
+static void
+read_journal(isc_buffer_t *out) {
+	isc_result_t result;
+	dns_journal_t *j = NULL;
+	dns_name_t *name;
+	dns_rdata_t *rdata;
+	isc_uint32_t ttl;
+	unsigned int n = 0;
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_READ, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_journal_iter_init(j, dns_journal_first_serial(j),
+				       dns_journal_last_serial(j));
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (result = dns_journal_first_rr(j);
+	     result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(j))
+	{
+		name = NULL;
+		rdata = NULL;
+		dns_journal_current_rr(j, &name, &ttl, &rdata);
+		append_rr(out, name, ttl, rdata);
+		n++;
+	}
+	ATF_CHECK_EQ(result, ISC_R_NOMORE);
+	ATF_CHECK(n > 0);
+	dns_journal_destroy(&j);
+}
+
+/*
+ * Check every signature in the zone with 'key'.  Return the number
+ * checked.
+ */
+static unsigned int
+verify_zone(dns_zone_t *zone, dst_key_t *key) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbiterator_t *dbiter = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_rdatasetiter_t *rdsiter = NULL;
+	dns_rdataset_t sigset, rdataset;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_rrsig_t sig;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	unsigned int n = 0;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	dns_rdataset_init(&sigset);
+	dns_rdataset_init(&rdataset);
+
+	result = dns_zone_getdb(zone, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_createiterator(db, 0, &dbiter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (result = dns_dbiterator_first(dbiter);
+	     result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(dbiter))
+	{
+		result = dns_dbiterator_current(dbiter, &node, name);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_dbiterator_pause(dbiter);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_db_allrdatasets(db, node, NULL, 0, &rdsiter);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		for (result = dns_rdatasetiter_first(rdsiter);
+		     result == ISC_R_SUCCESS;
+		     result = dns_rdatasetiter_next(rdsiter))
+		{
+			dns_rdatasetiter_current(rdsiter, &sigset);
+			if (sigset.type != dns_rdatatype_rrsig) {
+				dns_rdataset_disassociate(&sigset);
+				continue;
+			}
+			result = dns_db_findrdataset(db, node, NULL,
+						     sigset.covers, 0, 0,
+						     &rdataset, NULL);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			for (result = dns_rdataset_first(&sigset);
+			     result == ISC_R_SUCCESS;
+			     result = dns_rdataset_next(&sigset))
+			{
+				dns_rdataset_current(&sigset, &rdata);
+				result = dns_rdata_tostruct(&rdata, &sig,
+							    NULL);
+				ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+				ATF_CHECK_EQ(sig.keyid, KEYID);
+				dns_rdata_freestruct(&sig);
+				result = dns_dnssec_verify(name, &rdataset,
+							   key, ISC_FALSE,
+							   mctx, &rdata);
+				ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS,
+						 "signature %u: %s", n,
+						 isc_result_totext(result));
+				dns_rdata_reset(&rdata);
+				n++;
+			}
+			dns_rdataset_disassociate(&rdataset);
+			dns_rdataset_disassociate(&sigset);
+		}
+		dns_rdatasetiter_destroy(&rdsiter);
+		dns_db_detachnode(db, &node);
+	}
+	ATF_CHECK_EQ(result, ISC_R_NOMORE);
+	dns_dbiterator_destroy(&dbiter);
+	dns_db_detach(&db);
+	return (n);
+}
+
+/*
+ * Sign the test zone with 'jobs' signing jobs, describe the resulting
+ * journal in 'out' and check the signatures with 'key'.
+ */
+static void
+sign_zone(unsigned int jobs, dst_key_t *key, isc_buffer_t *out) {
+	isc_result_t result;
+	dns_zone_t *zone = NULL;
+	dns_view_t *view = NULL;
+	int i = 0;
+
+	(void)unlink(JOURNAL);
+
+	result = dns_test_makezone("example", &zone, NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_test_setupzonemgr();
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_test_managezone(zone);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	view = dns_zone_getview(zone);
+
+	/*
+	 * Zone maintenance, which does the signing, is skipped in views
+	 * without an address database.
+	 */
+	result = dns_adb_create(mctx, view, timermgr, taskmgr, &view->adb);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_zone_setfile(zone, ZONEFILE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zone_setjournal(zone, JOURNAL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zone_setkeydirectory(zone, KEYDIR);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_zone_setprivatetype(zone, PRIVATETYPE);
+	dns_zone_setnotifytype(zone, dns_notifytype_no);
+	dns_zone_setsignjobs(zone, jobs);
+
+	/*
+	 * Sign the whole zone in a single pass, whatever the number
+	 * of jobs, so the journals have the same transactions.
+	 */
+	dns_zone_setnodes(zone, 10000);
+	dns_zone_setsignatures(zone, 10000);
+
+	result = dns_zone_load(zone);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zone_signwithkey(zone, DST_ALG_HMACSHA256, KEYID,
+				      ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	while (!signing_complete(zone) && i++ < 5000)
+		dns_test_nap(1000);
+	ATF_REQUIRE(signing_complete(zone));
+
+	read_journal(out);
+	ATF_CHECK(verify_zone(zone, key) > 0);
+
+	dns_test_releasezone(zone);
+	dns_test_closezonemgr();
+	dns_zone_detach(&zone);
+	dns_adb_shutdown(view->adb);
+	dns_view_detach(&view);
+
+	(void)unlink(JOURNAL);
+}
+
+/*
+ * Individual unit tests
+ */
+ATF_TC(signjobs);
+ATF_TC_HEAD(signjobs, tc) {
+	atf_tc_set_md_var(tc, "descr", "signing a zone with several jobs "
+			  "makes the same changes as signing it with one");
+}
+ATF_TC_BODY(signjobs, tc) {
+	isc_result_t result;
+	isc_buffer_t *inline_diff = NULL, *batch_diff = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dst_key_t *key = NULL;
+	const char *a, *b, *end;
+	unsigned int line;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(name, "example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dst_key_fromfile(name, KEYID, DST_ALG_HMACSHA256,
+				  DST_TYPE_PUBLIC | DST_TYPE_PRIVATE,
+				  KEYDIR, mctx, &key);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_buffer_allocate(mctx, &inline_diff, DIFFSIZE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_buffer_allocate(mctx, &batch_diff, DIFFSIZE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	sign_zone(1, key, inline_diff);
+	sign_zone(4, key, batch_diff);
+
+	/*
+	 * Report the first change that differs.
+	 */
+	a = isc_buffer_base(inline_diff);
+	b = isc_buffer_base(batch_diff);
+	end = a + ISC_MIN(isc_buffer_usedlength(inline_diff),
+			  isc_buffer_usedlength(batch_diff));
+	for (line = 1; a < end && *a == *b; a++, b++)
+		if (*a == '\n')
+			line++;
+	ATF_CHECK_MSG(isc_buffer_usedlength(inline_diff) ==
+		      isc_buffer_usedlength(batch_diff) && a == end,
+		      "journals differ at change %u", line);
+
+	isc_buffer_free(&inline_diff);
+	isc_buffer_free(&batch_diff);
+	dst_key_free(&key);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, signjobs);
+	return (atf_no_error());
+}
@@ -12,6 +12,7 @@
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/sha2.h>
+#include <isc/stats.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/util.h>
@@ -33,6 +34,8 @@
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
 #include <dns/result.h>
+#include <dns/sigcache.h>
+#include <dns/stats.h>
 #include <dns/validator.h>
 #include <dns/view.h>
 
@@ -84,6 +87,10 @@
 						 * have attempted a verify. */
 #define VALATTR_INSECURITY		0x0010	/*%< Attempting proveunsecure. */
 #define VALATTR_DLVTRIED		0x0020	/*%< Looked for a DLV record. */
+#define VALATTR_VERIFYING		0x0040	/*%< Waiting for the crypto
+						 * pool to verify a signature. */
+#define VALATTR_VERIFIED		0x0080	/*%< 'vresult' holds the
+						 * crypto pool's result. */
 
 /*!
  * NSEC proofs to be looked for.
@@ -218,7 +225,8 @@ exit_check(dns_validator_t *val) {
 
 	INSIST(val->event == NULL);
 
-	if (val->fetch != NULL || val->subvalidator != NULL)
+	if (val->fetch != NULL || val->subvalidator != NULL ||
+	    (val->attributes & VALATTR_VERIFYING) != 0)
 		return (ISC_FALSE);
 
 	return (ISC_TRUE);
@@ -1484,50 +1492,67 @@ isselfsigned(dns_validator_t *val) {
 	return (answer);
 }
 
+static inline void
+inc_stat(dns_validator_t *val, isc_statscounter_t counter) {
+	if (val->view->resstats != NULL)
+		isc_stats_increment(val->view->resstats, counter);
+}
+
 /*%
- * Attempt to verify the rdataset using the given key and rdata (RRSIG).
- * The signature was good and from a wildcard record and the QNAME does
- * not match the wildcard we need to look for a NOQNAME proof.
- *
- * Returns:
- * \li	ISC_R_SUCCESS if the verification succeeds.
- * \li	Others if the verification fails.
+ * A signature verification handed to the view's crypto pool.  The
+ * validator leaves the RRset, the RRSIG and the key alone until the
+ * event comes back to its task.
+ */
+typedef struct verifyevent {
+	ISC_EVENT_COMMON(struct verifyevent);
+	dns_view_t		*view;
+	dns_name_t		*name;
+	dns_rdataset_t		*rdataset;
+	dst_key_t		*key;
+	dns_rdata_t		rdata;
+	isc_uint16_t		keyid;
+	isc_boolean_t		usecache;
+	dns_sigcachekey_t	sckey;
+	isc_boolean_t		ignore;
+	dns_fixedname_t		wild;
+	isc_result_t		result;
+} verifyevent_t;
+
+/*%
+ * Verify the RRSIG 'rdata' over 'rdataset' with 'key', ignoring the
+ * signature's validity period if that is all that is wrong with it and
+ * the view accepts expired signatures; '*ignorep' is set if it did.
+ * This may run on a crypto pool task, so it must not touch the
+ * validator.
  */
 static isc_result_t
-verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
-       isc_uint16_t keyid)
+verify_rdataset(dns_view_t *view, dns_name_t *name, dns_rdataset_t *rdataset,
+		dst_key_t *key, dns_rdata_t *rdata, dns_name_t *wild,
+		isc_boolean_t *ignorep)
 {
 	isc_result_t result;
-	dns_fixedname_t fixed;
 	isc_boolean_t ignore = ISC_FALSE;
-	dns_name_t *wild;
 
-	val->attributes |= VALATTR_TRIEDVERIFY;
-	dns_fixedname_init(&fixed);
-	wild = dns_fixedname_name(&fixed);
  again:
-	result = dns_dnssec_verify3(val->event->name, val->event->rdataset,
-				    key, ignore, val->view->maxbits,
-				    val->view->mctx, rdata, wild);
+	result = dns_dnssec_verify3(name, rdataset, key, ignore,
+				    view->maxbits, view->mctx, rdata, wild);
 	if ((result == DNS_R_SIGEXPIRED || result == DNS_R_SIGFUTURE) &&
-	    val->view->acceptexpired)
+	    view->acceptexpired)
 	{
 		ignore = ISC_TRUE;
 		goto again;
 	}
-	if (ignore && (result == ISC_R_SUCCESS || result == DNS_R_FROMWILDCARD))
-		validator_log(val, ISC_LOG_INFO,
-			      "accepted expired %sRRSIG (keyid=%u)",
-			      (result == DNS_R_FROMWILDCARD) ?
-			      "wildcard " : "", keyid);
-	else if (result == DNS_R_SIGEXPIRED || result == DNS_R_SIGFUTURE)
-		validator_log(val, ISC_LOG_INFO,
-			      "verify failed due to bad signature (keyid=%u): "
-			      "%s", keyid, isc_result_totext(result));
-	else
-		validator_log(val, ISC_LOG_DEBUG(3),
-			      "verify rdataset (keyid=%u): %s",
-			      keyid, isc_result_totext(result));
+	*ignorep = ignore;
+	return (result);
+}
+
+/*%
+ * A signature verified and was from a wildcard record: if the QNAME
+ * does not match the wildcard we need to look for a NOQNAME proof.
+ */
+static isc_result_t
+checkfromwildcard(dns_validator_t *val, isc_result_t result, dns_name_t *wild)
+{
 	if (result == DNS_R_FROMWILDCARD) {
 		if (!dns_name_equal(val->event->name, wild)) {
 			dns_name_t *closest;
@@ -1548,6 +1573,195 @@ verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
 	return (result);
 }
 
+/*%
+ * Log the result of verify_rdataset(), remember a good signature in
+ * the view's signature cache if 'sckey' is not NULL, and check for a
+ * wildcard expansion.
+ */
+static isc_result_t
+verify_finish(dns_validator_t *val, isc_result_t result, isc_boolean_t ignore,
+	      dns_name_t *wild, isc_uint16_t keyid, dns_sigcachekey_t *sckey)
+{
+	if (sckey != NULL && !ignore &&
+	    (result == ISC_R_SUCCESS || result == DNS_R_FROMWILDCARD))
+		(void)dns_sigcache_add(val->view->sigcache, sckey);
+	if (ignore && (result == ISC_R_SUCCESS || result == DNS_R_FROMWILDCARD))
+		validator_log(val, ISC_LOG_INFO,
+			      "accepted expired %sRRSIG (keyid=%u)",
+			      (result == DNS_R_FROMWILDCARD) ?
+			      "wildcard " : "", keyid);
+	else if (result == DNS_R_SIGEXPIRED || result == DNS_R_SIGFUTURE)
+		validator_log(val, ISC_LOG_INFO,
+			      "verify failed due to bad signature (keyid=%u): "
+			      "%s", keyid, isc_result_totext(result));
+	else
+		validator_log(val, ISC_LOG_DEBUG(3),
+			      "verify rdataset (keyid=%u): %s",
+			      keyid, isc_result_totext(result));
+	return (checkfromwildcard(val, result, wild));
+}
+
+/*
+ * Run on a crypto pool task.
+ */
+static void
+verify_work(isc_event_t *event) {
+	verifyevent_t *vevent = (verifyevent_t *)event;
+
+	vevent->result = verify_rdataset(vevent->view, vevent->name,
+					 vevent->rdataset, vevent->key,
+					 &vevent->rdata,
+					 dns_fixedname_name(&vevent->wild),
+					 &vevent->ignore);
+}
+
+/*
+ * The crypto pool has verified a signature: resume validate().
+ */
+static void
+verify_done(isc_task_t *task, isc_event_t *event) {
+	verifyevent_t *vevent;
+	dns_validator_t *val;
+	isc_boolean_t want_destroy;
+	isc_result_t result;
+
+	UNUSED(task);
+	INSIST(event->ev_type == DNS_EVENT_VALIDATORVERIFY);
+	vevent = (verifyevent_t *)event;
+	val = vevent->ev_arg;
+
+	LOCK(&val->lock);
+	val->attributes &= ~VALATTR_VERIFYING;
+	if (CANCELED(val)) {
+		validator_done(val, ISC_R_CANCELED);
+	} else {
+		val->vresult = verify_finish(val, vevent->result,
+					     vevent->ignore,
+					     dns_fixedname_name(&vevent->wild),
+					     vevent->keyid,
+					     vevent->usecache ?
+					     &vevent->sckey : NULL);
+		val->attributes |= VALATTR_VERIFIED;
+		result = validate(val, ISC_TRUE);
+		if (result != DNS_R_WAIT)
+			validator_done(val, result);
+	}
+	want_destroy = exit_check(val);
+	UNLOCK(&val->lock);
+	isc_event_free(&event);
+	if (want_destroy)
+		destroy(val);
+}
+
+/*%
+ * Queue the verification on the view's crypto pool; verify_done() is
+ * called on the validator's task when it has been done.
+ */
+static isc_result_t
+verify_submit(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
+	      isc_uint16_t keyid, dns_sigcachekey_t *sckey)
+{
+	verifyevent_t *vevent;
+	isc_event_t *event;
+	isc_result_t result;
+
+	vevent = (verifyevent_t *)
+		isc_event_allocate(val->view->mctx, val,
+				   DNS_EVENT_VALIDATORVERIFY, verify_done,
+				   val, sizeof(*vevent));
+	if (vevent == NULL)
+		return (ISC_R_NOMEMORY);
+	vevent->view = val->view;
+	vevent->name = val->event->name;
+	vevent->rdataset = val->event->rdataset;
+	vevent->key = key;
+	dns_rdata_init(&vevent->rdata);
+	dns_rdata_clone(rdata, &vevent->rdata);
+	vevent->keyid = keyid;
+	vevent->usecache = ISC_TF(sckey != NULL);
+	if (sckey != NULL)
+		vevent->sckey = *sckey;
+	vevent->ignore = ISC_FALSE;
+	dns_fixedname_init(&vevent->wild);
+	vevent->result = ISC_R_UNEXPECTED;
+
+	event = (isc_event_t *)vevent;
+	result = dst_cryptopool_submit(val->view->cryptopool, verify_work,
+				       val->task, &event);
+	if (result != ISC_R_SUCCESS) {
+		isc_event_free(&event);
+		return (result);
+	}
+	val->attributes |= VALATTR_VERIFYING;
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * Attempt to verify the rdataset using the given key and rdata (RRSIG).
+ * The signature was good and from a wildcard record and the QNAME does
+ * not match the wildcard we need to look for a NOQNAME proof.
+ *
+ * If 'offload' is true and the view has a crypto pool, the work is
+ * queued there and DNS_R_WAIT is returned; the result is later passed
+ * back to validate() in 'val->vresult'.
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS if the verification succeeds.
+ * \li	DNS_R_WAIT if the verification has been queued.
+ * \li	Others if the verification fails.
+ */
+static isc_result_t
+verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
+       isc_uint16_t keyid, isc_boolean_t offload)
+{
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	isc_boolean_t ignore;
+	isc_boolean_t usecache = ISC_FALSE;
+	dns_sigcachekey_t sckey;
+	isc_stdtime_t now;
+	dns_name_t *wild;
+
+	val->attributes |= VALATTR_TRIEDVERIFY;
+	dns_fixedname_init(&fixed);
+	wild = dns_fixedname_name(&fixed);
+
+	/*
+	 * Skip the public key operation if this exact signature has
+	 * already been verified with this key.
+	 */
+	if (val->view->sigcache != NULL &&
+	    dns_sigcache_makekey(val->event->name, val->event->rdataset,
+				 rdata, key, val->view->maxbits,
+				 &sckey) == ISC_R_SUCCESS)
+	{
+		usecache = ISC_TRUE;
+		isc_stdtime_get(&now);
+		result = dns_sigcache_find(val->view->sigcache, &sckey,
+					   now, wild);
+		if (result == ISC_R_SUCCESS || result == DNS_R_FROMWILDCARD) {
+			inc_stat(val, dns_resstatscounter_sigcachehit);
+			validator_log(val, ISC_LOG_DEBUG(3),
+				      "verify rdataset (keyid=%u): %s "
+				      "(cached)", keyid,
+				      isc_result_totext(result));
+			return (checkfromwildcard(val, result, wild));
+		}
+		inc_stat(val, dns_resstatscounter_sigcachemiss);
+	}
+
+	if (offload && val->view->cryptopool != NULL &&
+	    verify_submit(val, key, rdata, keyid,
+			  usecache ? &sckey : NULL) == ISC_R_SUCCESS)
+		return (DNS_R_WAIT);
+
+	result = verify_rdataset(val->view, val->event->name,
+				 val->event->rdataset, key, rdata, wild,
+				 &ignore);
+	return (verify_finish(val, result, ignore, wild, keyid,
+			      usecache ? &sckey : NULL));
+}
+
 /*%
  * Attempts positive response validation of a normal RRset.
  *
@@ -1562,6 +1776,7 @@ validate(dns_validator_t *val, isc_boolean_t resume) {
 	isc_result_t result, vresult = DNS_R_NOVALIDSIG;
 	dns_validatorevent_t *event;
 	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_boolean_t verified = ISC_FALSE;
 
 	/*
 	 * Caller must be holding the validator lock.
@@ -1571,8 +1786,11 @@ validate(dns_validator_t *val, isc_boolean_t resume) {
 
 	if (resume) {
 		/*
-		 * We already have a sigrdataset.
+		 * We already have a sigrdataset, and if the crypto pool
+		 * has verified it with 'val->key' the result as well.
 		 */
+		verified = ISC_TF((val->attributes & VALATTR_VERIFIED) != 0);
+		val->attributes &= ~VALATTR_VERIFIED;
 		result = ISC_R_SUCCESS;
 		validator_log(val, ISC_LOG_DEBUG(3), "resuming validate");
 	} else {
@@ -1624,8 +1842,15 @@ validate(dns_validator_t *val, isc_boolean_t resume) {
 		}
 
 		do {
-			vresult = verify(val, val->key, &rdata,
-					val->siginfo->keyid);
+			if (resume && verified) {
+				vresult = val->vresult;
+				verified = ISC_FALSE;
+			} else {
+				vresult = verify(val, val->key, &rdata,
+						 val->siginfo->keyid, ISC_TRUE);
+				if (vresult == DNS_R_WAIT)
+					return (DNS_R_WAIT);
+			}
 			if (vresult == ISC_R_SUCCESS)
 				break;
 			if (val->keynode != NULL) {
@@ -1739,7 +1964,7 @@ checkkey(dns_validator_t *val, dns_rdata_t *keyrdata, isc_uint16_t keyid,
 				 */
 				continue;
 		}
-		result = verify(val, dstkey, &rdata, sig.keyid);
+		result = verify(val, dstkey, &rdata, sig.keyid, ISC_FALSE);
 		if (result == ISC_R_SUCCESS)
 			break;
 	}
@@ -2024,7 +2249,7 @@ validatezonekey(dns_validator_t *val) {
 					break;
 				}
 				result = verify(val, dstkey, &sigrdata,
-						sig.keyid);
+						sig.keyid, ISC_FALSE);
 				if (result == ISC_R_SUCCESS) {
 					dns_keytable_detachkeynode(
 								val->keytable,
@@ -3786,6 +4011,7 @@ dns_validator_create(dns_view_t *view, dns_name_t *name, dns_rdatatype_t type,
 	val->keynode = NULL;
 	val->key = NULL;
 	val->siginfo = NULL;
+	val->vresult = DNS_R_NOVALIDSIG;
 	val->task = task;
 	val->action = action;
 	val->arg = arg;
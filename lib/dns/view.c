@@ -26,6 +26,7 @@
 
 #include <dns/acl.h>
 #include <dns/adb.h>
+#include <dns/anscache.h>
 #include <dns/badcache.h>
 #include <dns/cache.h>
 #include <dns/db.h>
@@ -49,6 +50,7 @@
 #include <dns/result.h>
 #include <dns/rpz.h>
 #include <dns/rrl.h>
+#include <dns/sigcache.h>
 #include <dns/stats.h>
 #include <dns/time.h>
 #include <dns/tsig.h>
@@ -244,6 +246,9 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	view->failcache = NULL;
 	(void)dns_badcache_init(view->mctx, DNS_VIEW_FAILCACHESIZE,
 				   &view->failcache);
+	view->anscache = NULL;
+	view->sigcache = NULL;
+	view->cryptopool = NULL;
 	view->v6bias = 0;
 	view->dtenv = NULL;
 	view->dttypes = 0;
@@ -526,6 +531,12 @@ destroy(dns_view_t *view) {
 	dns_aclenv_destroy(&view->aclenv);
 	if (view->failcache != NULL)
 		dns_badcache_destroy(&view->failcache);
+	if (view->anscache != NULL)
+		dns_anscache_destroy(&view->anscache);
+	if (view->sigcache != NULL)
+		dns_sigcache_detach(&view->sigcache);
+	if (view->cryptopool != NULL)
+		dst_cryptopool_detach(&view->cryptopool);
 	DESTROYLOCK(&view->new_zone_lock);
 	DESTROYLOCK(&view->lock);
 	isc_refcount_destroy(&view->references);
@@ -1825,6 +1836,24 @@ dns_view_setresstats(dns_view_t *view, isc_stats_t *stats) {
 	isc_stats_attach(stats, &view->resstats);
 }
 
+void
+dns_view_setsigcache(dns_view_t *view, dns_sigcache_t *sigcache) {
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(!view->frozen);
+	REQUIRE(view->sigcache == NULL);
+
+	dns_sigcache_attach(sigcache, &view->sigcache);
+}
+
+void
+dns_view_setcryptopool(dns_view_t *view, dst_cryptopool_t *cryptopool) {
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(!view->frozen);
+	REQUIRE(view->cryptopool == NULL);
+
+	dst_cryptopool_attach(cryptopool, &view->cryptopool);
+}
+
 void
 dns_view_getresstats(dns_view_t *view, isc_stats_t **statsp) {
 	REQUIRE(DNS_VIEW_VALID(view));
@@ -11,6 +11,7 @@
 #include <config.h>
 #include <errno.h>
 
+#include <isc/atomic.h>
 #include <isc/file.h>
 #include <isc/hex.h>
 #include <isc/mutex.h>
@@ -198,6 +199,17 @@ struct dns_zone {
 #endif
 	dns_db_t		*db;		/* Locked by dblock */
 
+	/*
+	 * Bumped whenever the zone's data may have changed: a new
+	 * database is attached or a version is committed.  Readers
+	 * don't lock; writers use genlock where there is no atomic add.
+	 */
+	isc_int32_t		generation;
+	isc_boolean_t		genuntracked;	/* Locked by dblock */
+#ifndef ISC_PLATFORM_HAVEXADD
+	isc_mutex_t		genlock;
+#endif
+
 	/* Locked */
 	dns_zonemgr_t		*zmgr;
 	ISC_LINK(dns_zone_t)	link;		/* Used by zmgr. */
@@ -412,6 +424,22 @@ struct dns_zone {
 	 */
 	dns_ttl_t		maxttl;
 
+	/*%
+	 * number of threads used to load the master file
+	 */
+	unsigned int		loadjobs;
+
+	/*%
+	 * number of threads used to generate signatures, and the
+	 * signatures generated so far and the time taken, in total
+	 * and for the current zone_sign() pass
+	 */
+	unsigned int		signjobs;
+	isc_uint64_t		signcount;
+	isc_uint64_t		signusecs;
+	isc_uint64_t		signpasscount;
+	isc_uint64_t		signpassusecs;
+
 	/*
 	 * Inline zone signing state.
 	 */
@@ -745,6 +773,7 @@ static isc_result_t zone_replacedb(dns_zone_t *zone, dns_db_t *db,
 				   isc_boolean_t dump);
 static inline void zone_attachdb(dns_zone_t *zone, dns_db_t *db);
 static inline void zone_detachdb(dns_zone_t *zone);
+static isc_result_t zone_dbupdated(dns_db_t *db, void *fn_arg);
 static isc_result_t default_journal(dns_zone_t *zone);
 static void zone_xfrdone(dns_zone_t *zone, isc_result_t result);
 static isc_result_t zone_postload(dns_zone_t *zone, dns_db_t *db,
@@ -908,11 +937,26 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	if (result != ISC_R_SUCCESS)
 		goto free_mutex;
 
+#ifndef ISC_PLATFORM_HAVEXADD
+	result = isc_mutex_init(&zone->genlock);
+	if (result != ISC_R_SUCCESS) {
+		ZONEDB_DESTROYLOCK(&zone->dblock);
+		goto free_mutex;
+	}
+#endif
+
 	/* XXX MPA check that all elements are initialised */
 #ifdef DNS_ZONE_CHECKLOCK
 	zone->locked = ISC_FALSE;
 #endif
 	zone->db = NULL;
+	/*
+	 * Start from a random generation so that answers cached for a
+	 * deleted zone can't be mistaken for those of a new zone that
+	 * happens to be allocated at the same address.
+	 */
+	isc_random_get((isc_uint32_t *)&zone->generation);
+	zone->genuntracked = ISC_FALSE;
 	zone->zmgr = NULL;
 	ISC_LINK_INIT(zone, link);
 	result = isc_refcount_init(&zone->erefs, 1);	/* Implicit attach. */
@@ -968,6 +1012,12 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	zone->masterscnt = 0;
 	zone->curmaster = 0;
 	zone->maxttl = 0;
+	zone->loadjobs = 1;
+	zone->signjobs = 1;
+	zone->signcount = 0;
+	zone->signusecs = 0;
+	zone->signpasscount = 0;
+	zone->signpassusecs = 0;
 	zone->notify = NULL;
 	zone->notifykeynames = NULL;
 	zone->notifydscp = NULL;
@@ -1074,6 +1124,9 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	isc_refcount_destroy(&zone->erefs);
 
  free_dblock:
+#ifndef ISC_PLATFORM_HAVEXADD
+	DESTROYLOCK(&zone->genlock);
+#endif
 	ZONEDB_DESTROYLOCK(&zone->dblock);
 
  free_mutex:
@@ -1207,6 +1260,9 @@ zone_free(dns_zone_t *zone) {
 		dns_ssutable_detach(&zone->ssutable);
 
 	/* last stuff */
+#ifndef ISC_PLATFORM_HAVEXADD
+	DESTROYLOCK(&zone->genlock);
+#endif
 	ZONEDB_DESTROYLOCK(&zone->dblock);
 	DESTROYLOCK(&zone->lock);
 	isc_refcount_destroy(&zone->erefs);
@@ -1314,6 +1370,21 @@ dns_zone_getserial2(dns_zone_t *zone, isc_uint32_t *serialp) {
 	return (result);
 }
 
+isc_result_t
+dns_zone_getgeneration(dns_zone_t *zone, isc_uint32_t *generationp) {
+	isc_boolean_t untracked;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(generationp != NULL);
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+	untracked = zone->genuntracked;
+	*generationp = (isc_uint32_t)zone->generation;
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+
+	return (untracked ? ISC_R_NOTFOUND : ISC_R_SUCCESS);
+}
+
 isc_uint32_t
 dns_zone_getserial(dns_zone_t *zone) {
 	isc_result_t result;
@@ -1598,6 +1669,21 @@ dns_zone_setmaxttl(dns_zone_t *zone, dns_ttl_t maxttl) {
 	return;
 }
 
+unsigned int
+dns_zone_getloadjobs(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	return (zone->loadjobs);
+}
+
+void
+dns_zone_setloadjobs(dns_zone_t *zone, unsigned int jobs) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(jobs > 0);
+
+	zone->loadjobs = jobs;
+}
+
 static isc_result_t
 default_journal(dns_zone_t *zone) {
 	isc_result_t result;
@@ -2262,6 +2348,26 @@ zone_gotreadhandle(isc_task_t *task, isc_event_t *event) {
 
 	options = get_master_options(load->zone);
 
+	/*
+	 * The parallel loader runs its own threads and returns once the
+	 * whole file is in, so there is nothing to spread over quanta.
+	 */
+	if (load->zone->loadjobs > 1 &&
+	    load->zone->masterformat == dns_masterformat_text)
+	{
+		result = dns_master_loadfile6(load->zone->masterfile,
+					      dns_db_origin(load->db),
+					      dns_db_origin(load->db),
+					      load->zone->rdclass, options, 0,
+					      &load->callbacks,
+					      zone_registerinclude,
+					      load->zone, load->zone->mctx,
+					      load->zone->masterformat,
+					      load->zone->maxttl,
+					      load->zone->loadjobs);
+		goto fail;
+	}
+
 	result = dns_master_loadfileinc5(load->zone->masterfile,
 					 dns_db_origin(load->db),
 					 dns_db_origin(load->db),
@@ -2431,14 +2537,14 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 			zone_idetach(&callbacks.zone);
 			return (result);
 		}
-		result = dns_master_loadfile5(zone->masterfile,
+		result = dns_master_loadfile6(zone->masterfile,
 					      &zone->origin, &zone->origin,
 					      zone->rdclass, options, 0,
 					      &callbacks,
 					      zone_registerinclude,
 					      zone, zone->mctx,
 					      zone->masterformat,
-					      zone->maxttl);
+					      zone->maxttl, zone->loadjobs);
 		tresult = dns_db_endload(db, &callbacks);
 		if (result == ISC_R_SUCCESS)
 			result = tresult;
@@ -6155,12 +6261,393 @@ del_sigs(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name,
 	return (result);
 }
 
+/*
+ * Signature batches.
+ *
+ * zone_sign() and zone_resigninc() queue the rdatasets they want signed
+ * in a batch instead of signing each one as it is found.  When the
+ * batch is flushed the signatures are generated by up to 'jobs'
+ * threads, this one included, and then added to the database and the
+ * diff in the order they were queued, so the diff and the journal are
+ * the same as they would have been had the signatures been generated
+ * one at a time.  A batch with a single job signs each rdataset as it
+ * is added, as before.
+ *
+ * Each queued rdataset is copied, so later changes to the database
+ * before the batch is flushed do not affect what is signed.  The
+ * signatures are not visible in the database until the batch is
+ * flushed; callers that look for existing signatures must use
+ * sigbatch_pending() and flush the batch first if necessary.
+ */
+#define SIGBATCH_MAX	256
+
+typedef struct sigjob {
+	dns_fixedname_t		fixed;
+	dns_name_t		*name;
+	dns_rdatalist_t		rdatalist;
+	dns_rdataset_t		rdataset;
+	dst_key_t		*key;
+	isc_stdtime_t		inception;
+	isc_stdtime_t		expire;
+	size_t			size;
+	isc_result_t		result;
+	dns_rdata_t		sig_rdata;
+	unsigned char		data[1024]; /* XXX */
+} sigjob_t;
+
+typedef struct sigbatch {
+	isc_mem_t		*mctx;
+	dns_db_t		*db;
+	dns_dbversion_t		*version;
+	dns_diff_t		*diff;
+	unsigned int		jobs;
+	isc_mutex_t		lock;
+	unsigned int		next;
+	unsigned int		count;
+	sigjob_t		*list[SIGBATCH_MAX];
+	isc_uint64_t		signatures;
+} sigbatch_t;
+
+static isc_result_t
+sigbatch_init(sigbatch_t *batch, isc_mem_t *mctx, dns_db_t *db,
+	      dns_dbversion_t *version, dns_diff_t *diff, unsigned int jobs)
+{
+	isc_result_t result;
+
+	result = isc_mutex_init(&batch->lock);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	batch->mctx = mctx;
+	batch->db = db;
+	batch->version = version;
+	batch->diff = diff;
+#ifdef ISC_PLATFORM_USETHREADS
+	batch->jobs = jobs;
+#else
+	UNUSED(jobs);
+	batch->jobs = 1;
+#endif
+	batch->next = 0;
+	batch->count = 0;
+	batch->signatures = 0;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+sigjob_free(sigbatch_t *batch, sigjob_t **jobp) {
+	sigjob_t *job = *jobp;
+
+	*jobp = NULL;
+	dns_rdataset_disassociate(&job->rdataset);
+	isc_mem_put(batch->mctx, job, job->size);
+}
+
+/*
+ * Queue the signing of 'rdataset' at 'name' with 'key'.
+ */
+static isc_result_t
+sigjob_create(sigbatch_t *batch, dns_name_t *name, dns_rdataset_t *rdataset,
+	      dst_key_t *key, isc_stdtime_t inception, isc_stdtime_t expire)
+{
+	sigjob_t *job;
+	dns_rdata_t *rdatas;
+	unsigned char *base;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_region_t r;
+	unsigned int n = 0, i;
+	size_t length = 0, size;
+	isc_result_t result;
+
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdataset_current(rdataset, &rdata);
+		length += rdata.length;
+		n++;
+		dns_rdata_reset(&rdata);
+	}
+	if (result != ISC_R_NOMORE)
+		return (result);
+
+	size = sizeof(*job) + n * sizeof(dns_rdata_t) + length;
+	job = isc_mem_get(batch->mctx, size);
+	if (job == NULL)
+		return (ISC_R_NOMEMORY);
+	job->size = size;
+	rdatas = (dns_rdata_t *)(job + 1);
+	base = (unsigned char *)(rdatas + n);
+
+	dns_fixedname_init(&job->fixed);
+	job->name = dns_fixedname_name(&job->fixed);
+	dns_name_copy(name, job->name, NULL);
+	dns_rdatalist_init(&job->rdatalist);
+	job->rdatalist.rdclass = rdataset->rdclass;
+	job->rdatalist.type = rdataset->type;
+	job->rdatalist.covers = rdataset->covers;
+	job->rdatalist.ttl = rdataset->ttl;
+
+	i = 0;
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		INSIST(i < n);
+		dns_rdataset_current(rdataset, &rdata);
+		dns_rdata_init(&rdatas[i]);
+		dns_rdata_toregion(&rdata, &r);
+		memmove(base, r.base, r.length);
+		r.base = base;
+		dns_rdata_fromregion(&rdatas[i], rdata.rdclass, rdata.type,
+				     &r);
+		ISC_LIST_APPEND(job->rdatalist.rdata, &rdatas[i], link);
+		base += r.length;
+		dns_rdata_reset(&rdata);
+		i++;
+	}
+	INSIST(result == ISC_R_NOMORE && i == n);
+
+	dns_rdataset_init(&job->rdataset);
+	RUNTIME_CHECK(dns_rdatalist_tordataset(&job->rdatalist,
+					       &job->rdataset)
+		      == ISC_R_SUCCESS);
+	job->key = key;
+	job->inception = inception;
+	job->expire = expire;
+	job->result = ISC_R_UNSET;
+	dns_rdata_init(&job->sig_rdata);
+
+	batch->list[batch->count++] = job;
+	return (ISC_R_SUCCESS);
+}
+
+static isc_threadresult_t
+#ifdef _WIN32
+WINAPI
+#endif
+sigbatch_run(isc_threadarg_t arg) {
+	sigbatch_t *batch = arg;
+	sigjob_t *job;
+	isc_buffer_t buffer;
+	unsigned int i;
+
+	for (;;) {
+		LOCK(&batch->lock);
+		if (batch->next == batch->count) {
+			UNLOCK(&batch->lock);
+			break;
+		}
+		i = batch->next++;
+		UNLOCK(&batch->lock);
+
+		job = batch->list[i];
+		isc_buffer_init(&buffer, job->data, sizeof(job->data));
+		job->result = dns_dnssec_sign(job->name, &job->rdataset,
+					      job->key, &job->inception,
+					      &job->expire, batch->mctx,
+					      &buffer, &job->sig_rdata);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+/*
+ * Generate the signatures queued in 'batch' and add them to the
+ * database and the diff in order.  The first error stops the rest
+ * from being added; the batch is empty afterwards in any case.
+ */
+static isc_result_t
+sigbatch_flush(sigbatch_t *batch) {
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int i;
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_thread_t *threads = NULL;
+	unsigned int nthreads = 0, want;
+
+	if (batch->count == 0)
+		return (ISC_R_SUCCESS);
+
+	/*
+	 * This thread does its share of the work too.  If a thread
+	 * cannot be created the others just get more of it.
+	 */
+	batch->next = 0;
+	want = ISC_MIN(batch->jobs, batch->count) - 1;
+	if (want > 0)
+		threads = isc_mem_get(batch->mctx, want * sizeof(*threads));
+	if (threads != NULL) {
+		for (i = 0; i < want; i++) {
+			if (isc_thread_create(sigbatch_run, batch,
+					      &threads[i]) != ISC_R_SUCCESS)
+				break;
+			nthreads++;
+		}
+	}
+	(void)sigbatch_run(batch);
+	for (i = 0; i < nthreads; i++)
+		RUNTIME_CHECK(isc_thread_join(threads[i], NULL) ==
+			      ISC_R_SUCCESS);
+	if (threads != NULL)
+		isc_mem_put(batch->mctx, threads, want * sizeof(*threads));
+#endif
+
+	for (i = 0; i < batch->count; i++) {
+		sigjob_t *job = batch->list[i];
+
+		if (result == ISC_R_SUCCESS)
+			result = job->result;
+		/* XXX inefficient - will cause dataset merging */
+		if (result == ISC_R_SUCCESS)
+			result = update_one_rr(batch->db, batch->version,
+					       batch->diff,
+					       DNS_DIFFOP_ADDRESIGN,
+					       job->name, job->rdatalist.ttl,
+					       &job->sig_rdata);
+		if (result == ISC_R_SUCCESS)
+			batch->signatures++;
+		sigjob_free(batch, &batch->list[i]);
+	}
+	batch->count = 0;
+	return (result);
+}
+
+static void
+sigbatch_destroy(sigbatch_t *batch) {
+	unsigned int i;
+
+	for (i = 0; i < batch->count; i++)
+		sigjob_free(batch, &batch->list[i]);
+	batch->count = 0;
+	DESTROYLOCK(&batch->lock);
+}
+
+/*
+ * Is a signature of the 'type' rdataset at 'name' queued in 'batch'?
+ * If 'key' is not NULL only signatures by 'key' are considered.
+ */
+static isc_boolean_t
+sigbatch_pending(sigbatch_t *batch, dns_name_t *name, dns_rdatatype_t type,
+		 dst_key_t *key)
+{
+	unsigned int i;
+
+	for (i = 0; i < batch->count; i++) {
+		sigjob_t *job = batch->list[i];
+
+		if (job->rdatalist.type == type &&
+		    (key == NULL || job->key == key) &&
+		    dns_name_equal(job->name, name))
+			return (ISC_TRUE);
+	}
+	return (ISC_FALSE);
+}
+
+/*
+ * Sign 'rdataset' at 'name' with 'key', now if 'batch' has a single
+ * job and otherwise when the batch is flushed.
+ */
+static isc_result_t
+sigbatch_add(sigbatch_t *batch, dns_name_t *name, dns_rdataset_t *rdataset,
+	     dst_key_t *key, isc_stdtime_t inception, isc_stdtime_t expire)
+{
+	isc_result_t result;
+
+	if (batch->jobs <= 1) {
+		dns_rdata_t sig_rdata = DNS_RDATA_INIT;
+		unsigned char data[1024]; /* XXX */
+		isc_buffer_t buffer;
+
+		/* Calculate the signature, creating a RRSIG RDATA. */
+		isc_buffer_init(&buffer, data, sizeof(data));
+		CHECK(dns_dnssec_sign(name, rdataset, key, &inception,
+				      &expire, batch->mctx, &buffer,
+				      &sig_rdata));
+		/* Update the database and journal with the RRSIG. */
+		/* XXX inefficient - will cause dataset merging */
+		CHECK(update_one_rr(batch->db, batch->version, batch->diff,
+				    DNS_DIFFOP_ADDRESIGN, name, rdataset->ttl,
+				    &sig_rdata));
+		batch->signatures++;
+		return (ISC_R_SUCCESS);
+	}
+
+	if (batch->count == SIGBATCH_MAX)
+		CHECK(sigbatch_flush(batch));
+	result = sigjob_create(batch, name, rdataset, key, inception, expire);
+ failure:
+	return (result);
+}
+
+/*
+ * The 'sig-signing-nodes' and 'sig-signing-signatures' limits apply
+ * to each signing job.
+ */
+static isc_int32_t
+sign_quantum(isc_uint32_t limit, unsigned int jobs) {
+	isc_uint64_t quantum = (isc_uint64_t)limit * jobs;
+
+	if (quantum > ISC_INT32_MAX)
+		quantum = ISC_INT32_MAX;
+	return ((isc_int32_t)quantum);
+}
+
+/*
+ * Account for 'signatures' generated since 'start'.  If 'pass' is
+ * set they are also counted towards the current zone_sign() pass.
+ */
+static void
+zone_signstats(dns_zone_t *zone, isc_uint64_t signatures, isc_time_t *start,
+	       isc_boolean_t pass)
+{
+	isc_time_t now;
+	isc_uint64_t usecs;
+
+	TIME_NOW(&now);
+	usecs = isc_time_microdiff(&now, start);
+
+	LOCK_ZONE(zone);
+	zone->signcount += signatures;
+	zone->signusecs += usecs;
+	if (pass) {
+		zone->signpasscount += signatures;
+		zone->signpassusecs += usecs;
+	}
+	UNLOCK_ZONE(zone);
+}
+
+/*
+ * Report how fast the zone_sign() pass that has just finished
+ * generated its signatures.
+ */
+static void
+zone_signpassdone(dns_zone_t *zone) {
+	isc_uint64_t signatures, usecs;
+
+	LOCK_ZONE(zone);
+	signatures = zone->signpasscount;
+	usecs = zone->signpassusecs;
+	zone->signpasscount = 0;
+	zone->signpassusecs = 0;
+	UNLOCK_ZONE(zone);
+
+	if (signatures == 0)
+		return;
+	dns_zone_log(zone, ISC_LOG_INFO,
+		     "signing complete: %" ISC_PRINT_QUADFORMAT "u signatures "
+		     "in %" ISC_PRINT_QUADFORMAT "u.%03u seconds "
+		     "(%" ISC_PRINT_QUADFORMAT "u per second, %u jobs)",
+		     signatures, usecs / 1000000,
+		     (unsigned int)(usecs % 1000000 / 1000),
+		     usecs == 0 ? signatures : signatures * 1000000 / usecs,
+		     zone->signjobs);
+}
+
 static isc_result_t
 add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name,
 	 dns_rdatatype_t type, dns_diff_t *diff, dst_key_t **keys,
 	 unsigned int nkeys, isc_mem_t *mctx, isc_stdtime_t inception,
 	 isc_stdtime_t expire, isc_boolean_t check_ksk,
-	 isc_boolean_t keyset_kskonly)
+	 isc_boolean_t keyset_kskonly, sigbatch_t *batch)
 {
 	isc_result_t result;
 	dns_dbnode_t *node = NULL;
@@ -6231,6 +6718,12 @@ add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name,
 		} else if (REVOKE(keys[i]) && type != dns_rdatatype_dnskey)
 				continue;
 
+		if (batch != NULL) {
+			CHECK(sigbatch_add(batch, name, &rdataset, keys[i],
+					   inception, expire));
+			continue;
+		}
+
 		/* Calculate the signature, creating a RRSIG RDATA. */
 		isc_buffer_clear(&buffer);
 		CHECK(dns_dnssec_sign(name, &rdataset, keys[i],
@@ -6271,9 +6764,14 @@ zone_resigninc(dns_zone_t *zone) {
 	unsigned int i;
 	unsigned int nkeys = 0;
 	unsigned int resign;
+	unsigned int signatures;
+	sigbatch_t batch;
+	isc_boolean_t havebatch = ISC_FALSE;
+	isc_time_t start;
 
 	ENTER;
 
+	TIME_NOW(&start);
 	dns_rdataset_init(&rdataset);
 	dns_fixedname_init(&fixed);
 	dns_diff_init(zone->mctx, &_sig_diff);
@@ -6313,6 +6811,12 @@ zone_resigninc(dns_zone_t *zone) {
 		goto failure;
 	}
 
+	result = sigbatch_init(&batch, zone->mctx, db, version,
+			       zonediff.diff, zone->signjobs);
+	if (result != ISC_R_SUCCESS)
+		goto failure;
+	havebatch = ISC_TRUE;
+
 	inception = now - 3600;	/* Allow for clock skew. */
 	soaexpire = now + dns_zone_getsigvalidityinterval(zone);
 	/*
@@ -6323,6 +6827,8 @@ zone_resigninc(dns_zone_t *zone) {
 	isc_random_get(&jitter);
 	expire = soaexpire - jitter % 3600;
 	stop = now + 5;
+	signatures = (unsigned int)sign_quantum(zone->signatures,
+						zone->signjobs);
 
 	check_ksk = DNS_ZONE_OPTION(zone, DNS_ZONEOPT_UPDATECHECKKSK);
 	keyset_kskonly = DNS_ZONE_OPTION(zone, DNS_ZONEOPT_DNSKEYKSKONLY);
@@ -6341,13 +6847,29 @@ zone_resigninc(dns_zone_t *zone) {
 		covers = rdataset.covers;
 		dns_rdataset_disassociate(&rdataset);
 
+		/*
+		 * If the new signatures for this rdataset are still
+		 * queued, add them and look again.
+		 */
+		if (sigbatch_pending(&batch, name, covers, NULL)) {
+			result = sigbatch_flush(&batch);
+			if (result != ISC_R_SUCCESS) {
+				dns_zone_log(zone, ISC_LOG_ERROR,
+					     "zone_resigninc:sigbatch_flush "
+					     "-> %s",
+					     dns_result_totext(result));
+				break;
+			}
+			goto next;
+		}
+
 		/*
 		 * Stop if we hit the SOA as that means we have walked the
 		 * entire zone.  The SOA record should always be the most
 		 * recent signature.
 		 */
 		/* XXXMPA increase number of RRsets signed pre call */
-		if (covers == dns_rdatatype_soa || i++ > zone->signatures ||
+		if (covers == dns_rdatatype_soa || i++ > signatures ||
 		    resign > stop)
 			break;
 
@@ -6362,13 +6884,14 @@ zone_resigninc(dns_zone_t *zone) {
 
 		result = add_sigs(db, version, name, covers, zonediff.diff,
 				  zone_keys, nkeys, zone->mctx, inception,
-				  expire, check_ksk, keyset_kskonly);
+				  expire, check_ksk, keyset_kskonly, &batch);
 		if (result != ISC_R_SUCCESS) {
 			dns_zone_log(zone, ISC_LOG_ERROR,
 				     "zone_resigninc:add_sigs -> %s",
 				     dns_result_totext(result));
 			break;
 		}
+ next:
 		result	= dns_db_getsigningtime(db, &rdataset, name);
 		if (nkeys == 0 && result == ISC_R_NOTFOUND) {
 			result = ISC_R_SUCCESS;
@@ -6383,6 +6906,14 @@ zone_resigninc(dns_zone_t *zone) {
 	if (result != ISC_R_NOMORE && result != ISC_R_SUCCESS)
 		goto failure;
 
+	result = sigbatch_flush(&batch);
+	if (result != ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "zone_resigninc:sigbatch_flush -> %s",
+			     dns_result_totext(result));
+		goto failure;
+	}
+
 	result = del_sigs(zone, db, version, &zone->origin, dns_rdatatype_soa,
 			  &zonediff, zone_keys, nkeys, now, ISC_TRUE);
 	if (result != ISC_R_SUCCESS) {
@@ -6419,7 +6950,8 @@ zone_resigninc(dns_zone_t *zone) {
 	 */
 	result = add_sigs(db, version, &zone->origin, dns_rdatatype_soa,
 			  zonediff.diff, zone_keys, nkeys, zone->mctx,
-			  inception, soaexpire, check_ksk, keyset_kskonly);
+			  inception, soaexpire, check_ksk, keyset_kskonly,
+			  NULL);
 	if (result != ISC_R_SUCCESS) {
 		dns_zone_log(zone, ISC_LOG_ERROR,
 			     "zone_resigninc:add_sigs -> %s",
@@ -6432,8 +6964,11 @@ zone_resigninc(dns_zone_t *zone) {
 
 	/* Everything has succeeded. Commit the changes. */
 	dns_db_closeversion(db, &version, ISC_TRUE);
+	zone_signstats(zone, batch.signatures, &start, ISC_FALSE);
 
  failure:
+	if (havebatch)
+		sigbatch_destroy(&batch);
 	dns_diff_clear(&_sig_diff);
 	for (i = 0; i < nkeys; i++)
 		dst_key_free(&zone_keys[i]);
@@ -6562,14 +7097,11 @@ sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
 	    isc_stdtime_t inception, isc_stdtime_t expire,
 	    unsigned int minimum, isc_boolean_t is_ksk,
 	    isc_boolean_t keyset_kskonly, isc_boolean_t *delegation,
-	    dns_diff_t *diff, isc_int32_t *signatures, isc_mem_t *mctx)
+	    dns_diff_t *diff, isc_int32_t *signatures, sigbatch_t *batch)
 {
 	isc_result_t result;
 	dns_rdatasetiter_t *iterator = NULL;
 	dns_rdataset_t rdataset;
-	dns_rdata_t rdata = DNS_RDATA_INIT;
-	isc_buffer_t buffer;
-	unsigned char data[1024];
 	isc_boolean_t seen_soa, seen_ns, seen_rr, seen_dname, seen_nsec,
 		      seen_nsec3, seen_ds;
 	isc_boolean_t bottom;
@@ -6582,7 +7114,6 @@ sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
 	}
 
 	dns_rdataset_init(&rdataset);
-	isc_buffer_init(&buffer, data, sizeof(data));
 	seen_rr = seen_soa = seen_ns = seen_dname = seen_nsec =
 	seen_nsec3 = seen_ds = ISC_FALSE;
 	for (result = dns_rdatasetiter_first(iterator);
@@ -6657,17 +7188,12 @@ sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
 		    rdataset.type != dns_rdatatype_ds &&
 		    rdataset.type != dns_rdatatype_nsec)
 			goto next_rdataset;
+		if (sigbatch_pending(batch, name, rdataset.type, key))
+			CHECK(sigbatch_flush(batch));
 		if (signed_with_key(db, node, version, rdataset.type, key))
 			goto next_rdataset;
-		/* Calculate the signature, creating a RRSIG RDATA. */
-		isc_buffer_clear(&buffer);
-		CHECK(dns_dnssec_sign(name, &rdataset, key, &inception,
-				      &expire, mctx, &buffer, &rdata));
-		/* Update the database and journal with the RRSIG. */
-		/* XXX inefficient - will cause dataset merging */
-		CHECK(update_one_rr(db, version, diff, DNS_DIFFOP_ADDRESIGN,
-				    name, rdataset.ttl, &rdata));
-		dns_rdata_reset(&rdata);
+		CHECK(sigbatch_add(batch, name, &rdataset, key, inception,
+				   expire));
 		(*signatures)--;
  next_rdataset:
 		dns_rdataset_disassociate(&rdataset);
@@ -7139,7 +7665,7 @@ update_sigs(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *version,
 		result = add_sigs(db, version, &tuple->name,
 				  tuple->rdata.type, zonediff->diff,
 				  zone_keys, nkeys, zone->mctx, inception,
-				  expire, check_ksk, keyset_kskonly);
+				  expire, check_ksk, keyset_kskonly, NULL);
 		if (result != ISC_R_SUCCESS) {
 			dns_zone_log(zone, ISC_LOG_ERROR,
 				     "update_sigs:add_sigs -> %s",
@@ -7824,7 +8350,8 @@ zone_nsec3chain(dns_zone_t *zone) {
 
 	result = add_sigs(db, version, &zone->origin, dns_rdatatype_soa,
 			  zonediff.diff, zone_keys, nkeys, zone->mctx,
-			  inception, soaexpire, check_ksk, keyset_kskonly);
+			  inception, soaexpire, check_ksk, keyset_kskonly,
+			  NULL);
 	if (result != ISC_R_SUCCESS) {
 		dns_zone_log(zone, ISC_LOG_ERROR, "zone_nsec3chain:"
 			     "add_sigs -> %s", dns_result_totext(result));
@@ -8053,9 +8580,14 @@ zone_sign(dns_zone_t *zone) {
 	unsigned int i, j;
 	unsigned int nkeys = 0;
 	isc_uint32_t nodes;
+	sigbatch_t batch;
+	isc_boolean_t havebatch = ISC_FALSE;
+	isc_time_t start;
 
 	ENTER;
 
+	TIME_NOW(&start);
+
 	dns_rdataset_init(&rdataset);
 	dns_fixedname_init(&fixed);
 	name = dns_fixedname_name(&fixed);
@@ -8102,6 +8634,12 @@ zone_sign(dns_zone_t *zone) {
 		goto failure;
 	}
 
+	result = sigbatch_init(&batch, zone->mctx, db, version,
+			       zonediff.diff, zone->signjobs);
+	if (result != ISC_R_SUCCESS)
+		goto failure;
+	havebatch = ISC_TRUE;
+
 	inception = now - 3600;	/* Allow for clock skew. */
 	soaexpire = now + dns_zone_getsigvalidityinterval(zone);
 
@@ -8118,8 +8656,8 @@ zone_sign(dns_zone_t *zone) {
 	 * we have no more nodes to pull off or we reach the limits
 	 * for this quantum.
 	 */
-	nodes = zone->nodes;
-	signatures = zone->signatures;
+	nodes = sign_quantum(zone->nodes, zone->signjobs);
+	signatures = sign_quantum(zone->signatures, zone->signjobs);
 	signing = ISC_LIST_HEAD(zone->signing);
 	first = ISC_TRUE;
 
@@ -8279,7 +8817,7 @@ zone_sign(dns_zone_t *zone) {
 					  expire, zone->minimum, is_ksk,
 					  ISC_TF(both && keyset_kskonly),
 					  &delegation, zonediff.diff,
-					  &signatures, zone->mctx));
+					  &signatures, &batch));
 			/*
 			 * If we are adding we are done.  Look for other keys
 			 * of the same algorithm if deleting.
@@ -8300,6 +8838,13 @@ zone_sign(dns_zone_t *zone) {
 				ISC_LIST_UNLINK(zone->signing, signing, link);
 				ISC_LIST_APPEND(cleanup, signing, link);
 				dns_dbiterator_pause(signing->dbiterator);
+				result = sigbatch_flush(&batch);
+				if (result != ISC_R_SUCCESS) {
+					dns_zone_log(zone, ISC_LOG_ERROR,
+					     "zone_sign:sigbatch_flush -> %s",
+					     dns_result_totext(result));
+					goto failure;
+				}
 				if (nkeys != 0 && build_nsec) {
 					/*
 					 * We have finished regenerating the
@@ -8353,10 +8898,23 @@ zone_sign(dns_zone_t *zone) {
 
  next_signing:
 		dns_dbiterator_pause(signing->dbiterator);
+		/*
+		 * The next signing may remove a key that queued
+		 * signatures refer to.
+		 */
+		CHECK(sigbatch_flush(&batch));
 		signing = nextsigning;
 		first = ISC_TRUE;
 	}
 
+	result = sigbatch_flush(&batch);
+	if (result != ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "zone_sign:sigbatch_flush -> %s",
+			     dns_result_totext(result));
+		goto failure;
+	}
+
 	if (ISC_LIST_HEAD(post_diff.tuples) != NULL) {
 		result = update_sigs(&post_diff, db, version, zone_keys,
 				     nkeys, zone, inception, expire, now,
@@ -8405,7 +8963,8 @@ zone_sign(dns_zone_t *zone) {
 	 */
 	result = add_sigs(db, version, &zone->origin, dns_rdatatype_soa,
 			  zonediff.diff, zone_keys, nkeys, zone->mctx,
-			  inception, soaexpire, check_ksk, keyset_kskonly);
+			  inception, soaexpire, check_ksk, keyset_kskonly,
+			  NULL);
 	if (result != ISC_R_SUCCESS) {
 		dns_zone_log(zone, ISC_LOG_ERROR,
 			     "zone_sign:add_sigs -> %s",
@@ -8452,6 +9011,7 @@ zone_sign(dns_zone_t *zone) {
 	set_resigntime(zone);
 
 	if (commit) {
+		zone_signstats(zone, batch.signatures, &start, ISC_TRUE);
 		LOCK_ZONE(zone);
 		DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_NEEDNOTIFY);
 		zone_needdump(zone, DNS_DUMP_DELAY);
@@ -8459,6 +9019,9 @@ zone_sign(dns_zone_t *zone) {
 	}
 
  failure:
+	if (havebatch)
+		sigbatch_destroy(&batch);
+
 	/*
 	 * Pause all dbiterators.
 	 */
@@ -8500,8 +9063,10 @@ zone_sign(dns_zone_t *zone) {
 		else
 			isc_interval_set(&interval, 0, 10000000); /* 10 ms */
 		isc_time_nowplusinterval(&zone->signingtime, &interval);
-	} else
+	} else {
 		isc_time_settoepoch(&zone->signingtime);
+		zone_signpassdone(zone);
+	}
 
 	INSIST(version == NULL);
 }
@@ -14721,12 +15286,48 @@ zone_replacedb(dns_zone_t *zone, dns_db_t *db, isc_boolean_t dump) {
 	return (result);
 }
 
+static void
+zone_bumpgeneration(dns_zone_t *zone) {
+#ifdef ISC_PLATFORM_HAVEXADD
+	(void)isc_atomic_xadd(&zone->generation, 1);
+#else
+	LOCK(&zone->genlock);
+	zone->generation++;
+	UNLOCK(&zone->genlock);
+#endif
+}
+
+/*
+ * Update listener for the zone's current database: a committed
+ * version means previously rendered answers may be out of date.
+ */
+static isc_result_t
+zone_dbupdated(dns_db_t *db, void *fn_arg) {
+	dns_zone_t *zone = fn_arg;
+
+	UNUSED(db);
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	zone_bumpgeneration(zone);
+	return (ISC_R_SUCCESS);
+}
+
 /* The caller must hold the dblock as a writer. */
 static inline void
 zone_attachdb(dns_zone_t *zone, dns_db_t *db) {
+	isc_result_t result;
+
 	REQUIRE(zone->db == NULL && db != NULL);
 
 	dns_db_attach(db, &zone->db);
+	result = dns_db_updatenotify_register(zone->db, zone_dbupdated, zone);
+	if (result != ISC_R_SUCCESS)
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "unable to follow database updates: %s; "
+			     "answers from this zone will not be cached",
+			     isc_result_totext(result));
+	zone->genuntracked = ISC_TF(result != ISC_R_SUCCESS);
+	zone_bumpgeneration(zone);
 }
 
 /* The caller must hold the dblock as a writer. */
@@ -14734,7 +15335,11 @@ static inline void
 zone_detachdb(dns_zone_t *zone) {
 	REQUIRE(zone->db != NULL);
 
+	if (!zone->genuntracked)
+		(void)dns_db_updatenotify_unregister(zone->db,
+						     zone_dbupdated, zone);
 	dns_db_detach(&zone->db);
+	zone_bumpgeneration(zone);
 }
 
 static void
@@ -17011,6 +17616,34 @@ dns_zone_getsignatures(dns_zone_t *zone) {
 	return (zone->signatures);
 }
 
+void
+dns_zone_setsignjobs(dns_zone_t *zone, unsigned int jobs) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(jobs > 0);
+
+	zone->signjobs = jobs;
+}
+
+unsigned int
+dns_zone_getsignjobs(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	return (zone->signjobs);
+}
+
+void
+dns_zone_getsigningstats(dns_zone_t *zone, isc_uint64_t *signaturesp,
+			 isc_uint64_t *usecsp)
+{
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(signaturesp != NULL);
+	REQUIRE(usecsp != NULL);
+
+	LOCK_ZONE(zone);
+	*signaturesp = zone->signcount;
+	*usecsp = zone->signusecs;
+	UNLOCK_ZONE(zone);
+}
+
 void
 dns_zone_setprivatetype(dns_zone_t *zone, dns_rdatatype_t type) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -17311,7 +17944,7 @@ sign_apex(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
 		result = add_sigs(db, ver, &zone->origin, dns_rdatatype_dnskey,
 				  zonediff->diff, zone_keys, nkeys, zone->mctx,
 				  inception, soaexpire, check_ksk,
-				  keyset_kskonly);
+				  keyset_kskonly, NULL);
 		if (result != ISC_R_SUCCESS) {
 			dns_zone_log(zone, ISC_LOG_ERROR,
 				     "sign_apex:add_sigs -> %s",
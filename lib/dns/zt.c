@@ -80,7 +80,12 @@ dns_zt_create(isc_mem_t *mctx, dns_rdataclass_t rdclass, dns_zt_t **ztp) {
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_zt;
 
-	result = isc_rwlock_init(&zt->rwlock, 0, 0);
+	/*
+	 * Every query looks up the zone table, and zones are rarely added
+	 * or removed.
+	 */
+	result = isc_rwlock_initx(&zt->rwlock, 0, 0, mctx,
+				  ISC_RWLOCK_BIGREADER);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_rbt;
 
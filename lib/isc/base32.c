@@ -39,10 +39,85 @@ mem_tobuffer(isc_buffer_t *target, void *base, unsigned int length);
 
 /*@}*/
 
-static const char base32[] =
-	 "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567=abcdefghijklmnopqrstuvwxyz234567";
-static const char base32hex[] =
-	"0123456789ABCDEFGHIJKLMNOPQRSTUV=0123456789abcdefghijklmnopqrstuv";
+static const char base32[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+static const char base32hex[] = "0123456789ABCDEFGHIJKLMNOPQRSTUV";
+
+/*%
+ * Digit values indexed by character, upper or lower case: 0-31 for
+ * digits, 32 for the "=" pad and 0xff for anything else.
+ */
+static const unsigned char base32_decode[256] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0x20, 0xff, 0xff,
+	0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+	0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+	0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+/*%
+ * The same for the extended hex alphabet.
+ */
+static const unsigned char base32hex_decode[256] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0xff, 0xff, 0xff, 0x20, 0xff, 0xff,
+	0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+	0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+	0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+	0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+	0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
 
 static isc_result_t
 base32_totext(isc_region_t *source, int wordlength, const char *wordbreak,
@@ -55,45 +130,25 @@ base32_totext(isc_region_t *source, int wordlength, const char *wordbreak,
 		wordlength = 8;
 
 	memset(buf, 0, sizeof(buf));
-	while (source->length > 0) {
-		buf[0] = base[((source->base[0]>>3)&0x1f)];	/* 5 + */
-		if (source->length == 1) {
-			buf[1] = base[(source->base[0]<<2)&0x1c];
-			buf[2] = buf[3] = buf[4] = pad;
-			buf[5] = buf[6] = buf[7] = pad;
-			RETERR(str_totext(buf, target));
-			break;
-		}
-		buf[1] = base[((source->base[0]<<2)&0x1c)|	/* 3 = 8 */
+	while (source->length >= 5) {
+		unsigned char *dst;
+
+		if (isc_buffer_availablelength(target) < 8)
+			return (ISC_R_NOSPACE);
+		dst = isc_buffer_used(target);
+		dst[0] = base[((source->base[0]>>3)&0x1f)];	/* 5 + */
+		dst[1] = base[((source->base[0]<<2)&0x1c)|	/* 3 = 8 */
 			      ((source->base[1]>>6)&0x03)];	/* 2 + */
-		buf[2] = base[((source->base[1]>>1)&0x1f)];	/* 5 + */
-		if (source->length == 2) {
-			buf[3] = base[(source->base[1]<<4)&0x10];
-			buf[4] = buf[5] = buf[6] = buf[7] = pad;
-			RETERR(str_totext(buf, target));
-			break;
-		}
-		buf[3] = base[((source->base[1]<<4)&0x10)|	/* 1 = 8 */
+		dst[2] = base[((source->base[1]>>1)&0x1f)];	/* 5 + */
+		dst[3] = base[((source->base[1]<<4)&0x10)|	/* 1 = 8 */
 			      ((source->base[2]>>4)&0x0f)];	/* 4 + */
-		if (source->length == 3) {
-			buf[4] = base[(source->base[2]<<1)&0x1e];
-			buf[5] = buf[6] = buf[7] = pad;
-			RETERR(str_totext(buf, target));
-			break;
-		}
-		buf[4] = base[((source->base[2]<<1)&0x1e)|	/* 4 = 8 */
+		dst[4] = base[((source->base[2]<<1)&0x1e)|	/* 4 = 8 */
 			      ((source->base[3]>>7)&0x01)];	/* 1 + */
-		buf[5] = base[((source->base[3]>>2)&0x1f)];	/* 5 + */
-		if (source->length == 4) {
-			buf[6] = base[(source->base[3]<<3)&0x18];
-			buf[7] = pad;
-			RETERR(str_totext(buf, target));
-			break;
-		}
-		buf[6] = base[((source->base[3]<<3)&0x18)|	/* 2 = 8 */
+		dst[5] = base[((source->base[3]>>2)&0x1f)];	/* 5 + */
+		dst[6] = base[((source->base[3]<<3)&0x18)|	/* 2 = 8 */
 			      ((source->base[4]>>5)&0x07)];	/* 3 + */
-		buf[7] = base[source->base[4]&0x1f];		/* 5 = 8 */
-		RETERR(str_totext(buf, target));
+		dst[7] = base[source->base[4]&0x1f];		/* 5 = 8 */
+		isc_buffer_add(target, 8);
 		isc_region_consume(source, 5);
 
 		loops++;
@@ -104,8 +159,30 @@ base32_totext(isc_region_t *source, int wordlength, const char *wordbreak,
 			RETERR(str_totext(wordbreak, target));
 		}
 	}
-	if (source->length > 0)
+
+	/*
+	 * Fewer than five bytes are left.  Encode them as if zero filled
+	 * and pad out the rest of the group.
+	 */
+	if (source->length > 0) {
+		static const unsigned int ndigits[5] = { 0, 2, 4, 5, 7 };
+		unsigned char last[5];
+		unsigned int i;
+
+		memset(last, 0, sizeof(last));
+		memmove(last, source->base, source->length);
+		buf[0] = base[((last[0]>>3)&0x1f)];
+		buf[1] = base[((last[0]<<2)&0x1c)|((last[1]>>6)&0x03)];
+		buf[2] = base[((last[1]>>1)&0x1f)];
+		buf[3] = base[((last[1]<<4)&0x10)|((last[2]>>4)&0x0f)];
+		buf[4] = base[((last[2]<<1)&0x1e)|((last[3]>>7)&0x01)];
+		buf[5] = base[((last[3]>>2)&0x1f)];
+		buf[6] = base[((last[3]<<3)&0x18)|((last[4]>>5)&0x07)];
+		for (i = ndigits[source->length]; i < 8; i++)
+			buf[i] = pad;
+		RETERR(str_totext(buf, target));
 		isc_region_consume(source, source->length);
+	}
 	return (ISC_R_SUCCESS);
 }
 
@@ -142,40 +219,34 @@ typedef struct {
 	int digits;		/*%< Number of buffered base32 digits */
 	isc_boolean_t seen_end;	/*%< True if "=" end marker seen */
 	int val[8];
-	const char *base;	/*%< Which encoding we are using */
+	const unsigned char *decode; /*%< Which encoding we are using */
 	int seen_32;		/*%< Number of significant bytes if non zero */
 	isc_boolean_t pad;	/*%< Expect padding */
 } base32_decode_ctx_t;
 
 static inline void
-base32_decode_init(base32_decode_ctx_t *ctx, int length, const char base[],
-		   isc_boolean_t pad, isc_buffer_t *target)
+base32_decode_init(base32_decode_ctx_t *ctx, int length,
+		   const unsigned char decode[], isc_boolean_t pad,
+		   isc_buffer_t *target)
 {
 	ctx->digits = 0;
 	ctx->seen_end = ISC_FALSE;
 	ctx->seen_32 = 0;
 	ctx->length = length;
 	ctx->target = target;
-	ctx->base = base;
+	ctx->decode = decode;
 	ctx->pad = pad;
 }
 
 static inline isc_result_t
 base32_decode_char(base32_decode_ctx_t *ctx, int c) {
-	const char *s;
 	unsigned int last;
 
 	if (ctx->seen_end)
 		return (ISC_R_BADBASE32);
-	if ((s = strchr(ctx->base, c)) == NULL)
+	last = ctx->decode[c & 0xff];
+	if (last == 0xff)
 		return (ISC_R_BADBASE32);
-	last = (unsigned int)(s - ctx->base);
-
-	/*
-	 * Handle lower case.
-	 */
-	if (last > 32)
-		last -= 33;
 
 	/*
 	 * Check that padding is contiguous.
@@ -255,6 +326,78 @@ base32_decode_char(base32_decode_ctx_t *ctx, int c) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Decode whole groups of eight digits straight into the target.  This
+ * stops at the first group holding padding or anything that isn't a
+ * digit, and short of any group that would overrun the target or the
+ * expected length; base32_decode_char() deals with whatever is left,
+ * including reporting any error.  Returns the number of characters
+ * consumed.
+ */
+static inline unsigned int
+base32_decode_block(base32_decode_ctx_t *ctx, const unsigned char *src,
+		    unsigned int srclen)
+{
+	const unsigned char *decode = ctx->decode;
+	unsigned char *dst;
+	unsigned int ngroups, i;
+
+	if (ctx->digits != 0 || ctx->seen_end)
+		return (0);
+
+	ngroups = srclen / 8;
+	if (ngroups > isc_buffer_availablelength(ctx->target) / 5)
+		ngroups = isc_buffer_availablelength(ctx->target) / 5;
+	if (ctx->length >= 0 && ngroups > (unsigned int)ctx->length / 5)
+		ngroups = (unsigned int)ctx->length / 5;
+
+	dst = isc_buffer_used(ctx->target);
+	for (i = 0; i < ngroups; i++) {
+		unsigned int v[8];
+
+		v[0] = decode[src[0]];
+		v[1] = decode[src[1]];
+		v[2] = decode[src[2]];
+		v[3] = decode[src[3]];
+		v[4] = decode[src[4]];
+		v[5] = decode[src[5]];
+		v[6] = decode[src[6]];
+		v[7] = decode[src[7]];
+		/* Both 32 ("=") and 0xff have one of these bits set. */
+		if (((v[0] | v[1] | v[2] | v[3] |
+		      v[4] | v[5] | v[6] | v[7]) & 0xe0) != 0)
+			break;
+		dst[0] = (unsigned char)((v[0]<<3)|(v[1]>>2));
+		dst[1] = (unsigned char)((v[1]<<6)|(v[2]<<1)|(v[3]>>4));
+		dst[2] = (unsigned char)((v[3]<<4)|(v[4]>>1));
+		dst[3] = (unsigned char)((v[4]<<7)|(v[5]<<2)|(v[6]>>3));
+		dst[4] = (unsigned char)((v[6]<<5)|(v[7]));
+		src += 8;
+		dst += 5;
+	}
+
+	isc_buffer_add(ctx->target, i * 5);
+	if (ctx->length >= 0)
+		ctx->length -= i * 5;
+	return (i * 8);
+}
+
+static inline isc_result_t
+base32_decode_chars(base32_decode_ctx_t *ctx, const unsigned char *src,
+		    unsigned int srclen)
+{
+	unsigned int i = 0;
+
+	while (i < srclen) {
+		i += base32_decode_block(ctx, src + i, srclen - i);
+		if (i == srclen)
+			break;
+		RETERR(base32_decode_char(ctx, src[i]));
+		i++;
+	}
+	return (ISC_R_SUCCESS);
+}
+
 static inline isc_result_t
 base32_decode_finish(base32_decode_ctx_t *ctx) {
 
@@ -275,19 +418,17 @@ base32_decode_finish(base32_decode_ctx_t *ctx) {
 }
 
 static isc_result_t
-base32_tobuffer(isc_lex_t *lexer, const char base[], isc_boolean_t pad,
-		isc_buffer_t *target, int length)
+base32_tobuffer(isc_lex_t *lexer, const unsigned char decode[],
+		isc_boolean_t pad, isc_buffer_t *target, int length)
 {
 	base32_decode_ctx_t ctx;
 	isc_textregion_t *tr;
 	isc_token_t token;
 	isc_boolean_t eol;
 
-	base32_decode_init(&ctx, length, base, pad, target);
+	base32_decode_init(&ctx, length, decode, pad, target);
 
 	while (!ctx.seen_end && (ctx.length != 0)) {
-		unsigned int i;
-
 		if (length > 0)
 			eol = ISC_FALSE;
 		else
@@ -297,8 +438,8 @@ base32_tobuffer(isc_lex_t *lexer, const char base[], isc_boolean_t pad,
 		if (token.type != isc_tokentype_string)
 			break;
 		tr = &token.value.as_textregion;
-		for (i = 0; i < tr->length; i++)
-			RETERR(base32_decode_char(&ctx, tr->base[i]));
+		RETERR(base32_decode_chars(&ctx, (unsigned char *)tr->base,
+					   tr->length));
 	}
 	if (ctx.length < 0 && !ctx.seen_end)
 		isc_lex_ungettoken(lexer, &token);
@@ -308,33 +449,39 @@ base32_tobuffer(isc_lex_t *lexer, const char base[], isc_boolean_t pad,
 
 isc_result_t
 isc_base32_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
-	return (base32_tobuffer(lexer, base32, ISC_TRUE, target, length));
+	return (base32_tobuffer(lexer, base32_decode, ISC_TRUE,
+				target, length));
 }
 
 isc_result_t
 isc_base32hex_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
-	return (base32_tobuffer(lexer, base32hex, ISC_TRUE, target, length));
+	return (base32_tobuffer(lexer, base32hex_decode, ISC_TRUE,
+				target, length));
 }
 
 isc_result_t
 isc_base32hexnp_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
-	return (base32_tobuffer(lexer, base32hex, ISC_FALSE, target, length));
+	return (base32_tobuffer(lexer, base32hex_decode, ISC_FALSE,
+				target, length));
 }
 
 static isc_result_t
-base32_decodestring(const char *cstr, const char base[], isc_boolean_t pad,
-		    isc_buffer_t *target)
+base32_decodestring(const char *cstr, const unsigned char decode[],
+		    isc_boolean_t pad, isc_buffer_t *target)
 {
 	base32_decode_ctx_t ctx;
 
-	base32_decode_init(&ctx, -1, base, pad, target);
+	base32_decode_init(&ctx, -1, decode, pad, target);
 	for (;;) {
-		int c = *cstr++;
-		if (c == '\0')
+		size_t n;
+
+		cstr += strspn(cstr, " \t\n\r");
+		if (*cstr == '\0')
 			break;
-		if (c == ' ' || c == '\t' || c == '\n' || c== '\r')
-			continue;
-		RETERR(base32_decode_char(&ctx, c));
+		n = strcspn(cstr, " \t\n\r");
+		RETERR(base32_decode_chars(&ctx, (const unsigned char *)cstr,
+				       (unsigned int)n));
+		cstr += n;
 	}
 	RETERR(base32_decode_finish(&ctx));
 	return (ISC_R_SUCCESS);
@@ -342,28 +489,35 @@ base32_decodestring(const char *cstr, const char base[], isc_boolean_t pad,
 
 isc_result_t
 isc_base32_decodestring(const char *cstr, isc_buffer_t *target) {
-	return (base32_decodestring(cstr, base32, ISC_TRUE, target));
+	return (base32_decodestring(cstr, base32_decode, ISC_TRUE, target));
 }
 
 isc_result_t
 isc_base32hex_decodestring(const char *cstr, isc_buffer_t *target) {
-	return (base32_decodestring(cstr, base32hex, ISC_TRUE, target));
+	return (base32_decodestring(cstr, base32hex_decode, ISC_TRUE, target));
 }
 
 isc_result_t
 isc_base32hexnp_decodestring(const char *cstr, isc_buffer_t *target) {
-	return (base32_decodestring(cstr, base32hex, ISC_FALSE, target));
+	return (base32_decodestring(cstr, base32hex_decode, ISC_FALSE, target));
 }
 
 static isc_result_t
-base32_decoderegion(isc_region_t *source, const char base[],
+base32_decoderegion(isc_region_t *source, const unsigned char decode[],
 		    isc_boolean_t pad, isc_buffer_t *target)
 {
 	base32_decode_ctx_t ctx;
 
-	base32_decode_init(&ctx, -1, base, pad, target);
+	base32_decode_init(&ctx, -1, decode, pad, target);
 	while (source->length != 0) {
-		int c = *source->base;
+		int c;
+
+		isc_region_consume(source,
+				   base32_decode_block(&ctx, source->base,
+						       source->length));
+		if (source->length == 0)
+			break;
+		c = *source->base;
 		RETERR(base32_decode_char(&ctx, c));
 		isc_region_consume(source, 1);
 	}
@@ -373,17 +527,17 @@ base32_decoderegion(isc_region_t *source, const char base[],
 
 isc_result_t
 isc_base32_decoderegion(isc_region_t *source, isc_buffer_t *target) {
-	return (base32_decoderegion(source, base32, ISC_TRUE, target));
+	return (base32_decoderegion(source, base32_decode, ISC_TRUE, target));
 }
 
 isc_result_t
 isc_base32hex_decoderegion(isc_region_t *source, isc_buffer_t *target) {
-	return (base32_decoderegion(source, base32hex, ISC_TRUE, target));
+	return (base32_decoderegion(source, base32hex_decode, ISC_TRUE, target));
 }
 
 isc_result_t
 isc_base32hexnp_decoderegion(isc_region_t *source, isc_buffer_t *target) {
-	return (base32_decoderegion(source, base32hex, ISC_FALSE, target));
+	return (base32_decoderegion(source, base32hex_decode, ISC_FALSE, target));
 }
 
 static isc_result_t
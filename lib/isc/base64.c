@@ -40,6 +40,45 @@ static const char base64[] =
 	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=";
 /*@}*/
 
+/*%
+ * Digit values indexed by character: 0-63 for digits, 64 for the
+ * "=" pad and 0xff for anything else.
+ */
+static const unsigned char base64_decode[256] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+	0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b,
+	0x3c, 0x3d, 0xff, 0xff, 0xff, 0x40, 0xff, 0xff,
+	0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+	0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+	0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30,
+	0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
 isc_result_t
 isc_base64_totext(isc_region_t *source, int wordlength,
 		  const char *wordbreak, isc_buffer_t *target)
@@ -52,13 +91,18 @@ isc_base64_totext(isc_region_t *source, int wordlength,
 
 	memset(buf, 0, sizeof(buf));
 	while (source->length > 2) {
-		buf[0] = base64[(source->base[0]>>2)&0x3f];
-		buf[1] = base64[((source->base[0]<<4)&0x30)|
+		unsigned char *dst;
+
+		if (isc_buffer_availablelength(target) < 4)
+			return (ISC_R_NOSPACE);
+		dst = isc_buffer_used(target);
+		dst[0] = base64[(source->base[0]>>2)&0x3f];
+		dst[1] = base64[((source->base[0]<<4)&0x30)|
 				((source->base[1]>>4)&0x0f)];
-		buf[2] = base64[((source->base[1]<<2)&0x3c)|
+		dst[2] = base64[((source->base[1]<<2)&0x3c)|
 				((source->base[2]>>6)&0x03)];
-		buf[3] = base64[source->base[2]&0x3f];
-		RETERR(str_totext(buf, target));
+		dst[3] = base64[source->base[2]&0x3f];
+		isc_buffer_add(target, 4);
 		isc_region_consume(source, 3);
 
 		loops++;
@@ -109,13 +153,14 @@ base64_decode_init(base64_decode_ctx_t *ctx, int length, isc_buffer_t *target)
 
 static inline isc_result_t
 base64_decode_char(base64_decode_ctx_t *ctx, int c) {
-	const char *s;
+	unsigned int v;
 
 	if (ctx->seen_end)
 		return (ISC_R_BADBASE64);
-	if ((s = strchr(base64, c)) == NULL)
+	v = base64_decode[c & 0xff];
+	if (v == 0xff)
 		return (ISC_R_BADBASE64);
-	ctx->val[ctx->digits++] = (int)(s - base64);
+	ctx->val[ctx->digits++] = (int)v;
 	if (ctx->digits == 4) {
 		int n;
 		unsigned char buf[3];
@@ -158,6 +203,70 @@ base64_decode_char(base64_decode_ctx_t *ctx, int c) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Decode whole groups of four digits straight into the target.  This
+ * stops at the first group holding padding or anything that isn't a
+ * digit, and short of any group that would overrun the target or the
+ * expected length; base64_decode_char() deals with whatever is left,
+ * including reporting any error.  Returns the number of characters
+ * consumed.
+ */
+static inline unsigned int
+base64_decode_block(base64_decode_ctx_t *ctx, const unsigned char *src,
+		    unsigned int srclen)
+{
+	unsigned char *dst;
+	unsigned int ngroups, i;
+
+	if (ctx->digits != 0 || ctx->seen_end)
+		return (0);
+
+	ngroups = srclen / 4;
+	if (ngroups > isc_buffer_availablelength(ctx->target) / 3)
+		ngroups = isc_buffer_availablelength(ctx->target) / 3;
+	if (ctx->length >= 0 && ngroups > (unsigned int)ctx->length / 3)
+		ngroups = (unsigned int)ctx->length / 3;
+
+	dst = isc_buffer_used(ctx->target);
+	for (i = 0; i < ngroups; i++) {
+		unsigned int a, b, c, d;
+
+		a = base64_decode[src[0]];
+		b = base64_decode[src[1]];
+		c = base64_decode[src[2]];
+		d = base64_decode[src[3]];
+		/* Both 64 ("=") and 0xff have one of these bits set. */
+		if (((a | b | c | d) & 0xc0) != 0)
+			break;
+		dst[0] = (unsigned char)((a << 2) | (b >> 4));
+		dst[1] = (unsigned char)((b << 4) | (c >> 2));
+		dst[2] = (unsigned char)((c << 6) | d);
+		src += 4;
+		dst += 3;
+	}
+
+	isc_buffer_add(ctx->target, i * 3);
+	if (ctx->length >= 0)
+		ctx->length -= i * 3;
+	return (i * 4);
+}
+
+static inline isc_result_t
+base64_decode_chars(base64_decode_ctx_t *ctx, const unsigned char *src,
+		    unsigned int srclen)
+{
+	unsigned int i = 0;
+
+	while (i < srclen) {
+		i += base64_decode_block(ctx, src + i, srclen - i);
+		if (i == srclen)
+			break;
+		RETERR(base64_decode_char(ctx, src[i]));
+		i++;
+	}
+	return (ISC_R_SUCCESS);
+}
+
 static inline isc_result_t
 base64_decode_finish(base64_decode_ctx_t *ctx) {
 	if (ctx->length > 0)
@@ -177,8 +286,6 @@ isc_base64_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
 	base64_decode_init(&ctx, length, target);
 
 	while (!ctx.seen_end && (ctx.length != 0)) {
-		unsigned int i;
-
 		if (length > 0)
 			eol = ISC_FALSE;
 		else
@@ -188,8 +295,8 @@ isc_base64_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
 		if (token.type != isc_tokentype_string)
 			break;
 		tr = &token.value.as_textregion;
-		for (i = 0; i < tr->length; i++)
-			RETERR(base64_decode_char(&ctx, tr->base[i]));
+		RETERR(base64_decode_chars(&ctx, (unsigned char *)tr->base,
+					   tr->length));
 	}
 	if (ctx.length < 0 && !ctx.seen_end)
 		isc_lex_ungettoken(lexer, &token);
@@ -203,12 +310,15 @@ isc_base64_decodestring(const char *cstr, isc_buffer_t *target) {
 
 	base64_decode_init(&ctx, -1, target);
 	for (;;) {
-		int c = *cstr++;
-		if (c == '\0')
+		size_t n;
+
+		cstr += strspn(cstr, " \t\n\r");
+		if (*cstr == '\0')
 			break;
-		if (c == ' ' || c == '\t' || c == '\n' || c== '\r')
-			continue;
-		RETERR(base64_decode_char(&ctx, c));
+		n = strcspn(cstr, " \t\n\r");
+		RETERR(base64_decode_chars(&ctx, (const unsigned char *)cstr,
+				       (unsigned int)n));
+		cstr += n;
 	}
 	RETERR(base64_decode_finish(&ctx));
 	return (ISC_R_SUCCESS);
@@ -12,8 +12,6 @@
 
 #include <config.h>
 
-#include <ctype.h>
-
 #include <isc/buffer.h>
 #include <isc/hex.h>
 #include <isc/lex.h>
@@ -38,21 +36,63 @@ mem_tobuffer(isc_buffer_t *target, void *base, unsigned int length);
 
 static const char hex[] = "0123456789ABCDEF";
 
+/*%
+ * Digit values indexed by character, upper or lower case, with 0xff
+ * for anything that isn't a hex digit.
+ */
+static const unsigned char hex_decode[256] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
 isc_result_t
 isc_hex_totext(isc_region_t *source, int wordlength,
 	       const char *wordbreak, isc_buffer_t *target)
 {
-	char buf[3];
 	unsigned int loops = 0;
 
 	if (wordlength < 2)
 		wordlength = 2;
 
-	memset(buf, 0, sizeof(buf));
 	while (source->length > 0) {
-		buf[0] = hex[(source->base[0] >> 4) & 0xf];
-		buf[1] = hex[(source->base[0]) & 0xf];
-		RETERR(str_totext(buf, target));
+		unsigned char *dst;
+
+		if (isc_buffer_availablelength(target) < 2)
+			return (ISC_R_NOSPACE);
+		dst = isc_buffer_used(target);
+		dst[0] = hex[(source->base[0] >> 4) & 0xf];
+		dst[1] = hex[(source->base[0]) & 0xf];
+		isc_buffer_add(target, 2);
 		isc_region_consume(source, 1);
 
 		loops++;
@@ -86,11 +126,12 @@ hex_decode_init(hex_decode_ctx_t *ctx, int length, isc_buffer_t *target)
 
 static inline isc_result_t
 hex_decode_char(hex_decode_ctx_t *ctx, int c) {
-	const char *s;
+	unsigned int v;
 
-	if ((s = strchr(hex, toupper(c))) == NULL)
+	v = hex_decode[c & 0xff];
+	if (v == 0xff)
 		return (ISC_R_BADHEX);
-	ctx->val[ctx->digits++] = (int)(s - hex);
+	ctx->val[ctx->digits++] = (int)v;
 	if (ctx->digits == 2) {
 		unsigned char num;
 
@@ -107,6 +148,63 @@ hex_decode_char(hex_decode_ctx_t *ctx, int c) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Decode pairs of digits straight into the target, stopping at the
+ * first pair that isn't two hex digits and short of overrunning the
+ * target or the expected length; hex_decode_char() deals with whatever
+ * is left, including reporting any error.  Returns the number of
+ * characters consumed.
+ */
+static inline unsigned int
+hex_decode_block(hex_decode_ctx_t *ctx, const unsigned char *src,
+		 unsigned int srclen)
+{
+	unsigned char *dst;
+	unsigned int n, i;
+
+	if (ctx->digits != 0)
+		return (0);
+
+	n = srclen / 2;
+	if (n > isc_buffer_availablelength(ctx->target))
+		n = isc_buffer_availablelength(ctx->target);
+	if (ctx->length >= 0 && n > (unsigned int)ctx->length)
+		n = (unsigned int)ctx->length;
+
+	dst = isc_buffer_used(ctx->target);
+	for (i = 0; i < n; i++) {
+		unsigned int hi, lo;
+
+		hi = hex_decode[src[0]];
+		lo = hex_decode[src[1]];
+		if (((hi | lo) & 0xf0) != 0)
+			break;
+		*dst++ = (unsigned char)((hi << 4) | lo);
+		src += 2;
+	}
+
+	isc_buffer_add(ctx->target, i);
+	if (ctx->length >= 0)
+		ctx->length -= i;
+	return (i * 2);
+}
+
+static inline isc_result_t
+hex_decode_chars(hex_decode_ctx_t *ctx, const unsigned char *src,
+		 unsigned int srclen)
+{
+	unsigned int i = 0;
+
+	while (i < srclen) {
+		i += hex_decode_block(ctx, src + i, srclen - i);
+		if (i == srclen)
+			break;
+		RETERR(hex_decode_char(ctx, src[i]));
+		i++;
+	}
+	return (ISC_R_SUCCESS);
+}
+
 static inline isc_result_t
 hex_decode_finish(hex_decode_ctx_t *ctx) {
 	if (ctx->length > 0)
@@ -126,8 +224,6 @@ isc_hex_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
 	hex_decode_init(&ctx, length, target);
 
 	while (ctx.length != 0) {
-		unsigned int i;
-
 		if (length > 0)
 			eol = ISC_FALSE;
 		else
@@ -137,8 +233,8 @@ isc_hex_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
 		if (token.type != isc_tokentype_string)
 			break;
 		tr = &token.value.as_textregion;
-		for (i = 0; i < tr->length; i++)
-			RETERR(hex_decode_char(&ctx, tr->base[i]));
+		RETERR(hex_decode_chars(&ctx, (unsigned char *)tr->base,
+					tr->length));
 	}
 	if (ctx.length < 0)
 		isc_lex_ungettoken(lexer, &token);
@@ -152,12 +248,15 @@ isc_hex_decodestring(const char *cstr, isc_buffer_t *target) {
 
 	hex_decode_init(&ctx, -1, target);
 	for (;;) {
-		int c = *cstr++;
-		if (c == '\0')
+		size_t n;
+
+		cstr += strspn(cstr, " \t\n\r");
+		if (*cstr == '\0')
 			break;
-		if (c == ' ' || c == '\t' || c == '\n' || c== '\r')
-			continue;
-		RETERR(hex_decode_char(&ctx, c));
+		n = strcspn(cstr, " \t\n\r");
+		RETERR(hex_decode_chars(&ctx, (const unsigned char *)cstr,
+				    (unsigned int)n));
+		cstr += n;
 	}
 	RETERR(hex_decode_finish(&ctx));
 	return (ISC_R_SUCCESS);
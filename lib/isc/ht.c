@@ -18,43 +18,280 @@
 #include <isc/result.h>
 #include <isc/util.h>
 
+/*
+ * The table uses open addressing with linear probing.  Each slot holds
+ * the full hash value of its key next to the node pointer, so probing
+ * compares hash values from a contiguous array and only dereferences a
+ * node (to compare keys) when the hash matches.  Entries are removed by
+ * shifting later members of the probe sequence back into the hole, so
+ * there are no tombstones.
+ *
+ * The table grows when it becomes 3/4 full and shrinks when it drops
+ * below 1/8 full.  Resizing is incremental: a new slot array is
+ * allocated and the old one is kept alongside it, lookups consult both,
+ * new entries always go into the new array, and every add or delete
+ * moves a few entries across until the old array is empty.
+ */
 
 typedef struct isc_ht_node isc_ht_node_t;
+typedef struct isc_ht_slot isc_ht_slot_t;
+typedef struct isc_ht_table isc_ht_table_t;
 
 #define ISC_HT_MAGIC			ISC_MAGIC('H', 'T', 'a', 'b')
 #define ISC_HT_VALID(ht)		ISC_MAGIC_VALID(ht, ISC_HT_MAGIC)
 
+#define HT_MINBITS		3
+#define HT_MAXBITS		32
+#define HT_OVERCOMMIT(t, n)	((n) > (t)->size - ((t)->size >> 2))
+#define HT_UNDERCOMMIT(t, n)	((n) < ((t)->size >> 3))
+
+/*%
+ * Number of old slots examined on each add or delete while a resize
+ * is in progress.
+ */
+#define HT_REHASH_STEP		32
+
 struct isc_ht_node {
 	void *value;
-	isc_ht_node_t *next;
 	size_t keysize;
 	unsigned char key[];
 };
 
+struct isc_ht_slot {
+	isc_uint32_t hashval;
+	isc_ht_node_t *node;
+};
+
+struct isc_ht_table {
+	isc_uint8_t bits;
+	size_t size;
+	size_t mask;
+	unsigned int count;
+	isc_ht_slot_t *slots;
+};
+
 struct isc_ht {
 	unsigned int magic;
 	isc_mem_t *mctx;
-	size_t size;
-	size_t mask;
 	unsigned int count;
-	isc_ht_node_t **table;
+	/*%
+	 * table[0] is the current table; table[1] is the table being
+	 * emptied into it during a resize, and has no slots otherwise.
+	 * Slots of table[1] below 'hashpos' have all been moved.
+	 */
+	isc_ht_table_t table[2];
+	size_t hashpos;
 };
 
+/*%
+ * Entries of table[t] are visited in slot order, starting just after
+ * the empty slot 'start' and wrapping around.  Removing an entry only
+ * ever moves entries that come later in the same run of occupied slots
+ * back towards it, and such a run never extends past an empty slot, so
+ * with this order isc_ht_iter_delcurrent_next() neither skips nor
+ * revisits entries.
+ */
 struct isc_ht_iter {
 	isc_ht_t *ht;
-	size_t i;
+	unsigned int t;
+	size_t start;
+	size_t n;
 	isc_ht_node_t *cur;
 };
 
+static isc_result_t
+table_init(isc_ht_t *ht, isc_ht_table_t *table, isc_uint8_t bits) {
+	size_t i;
+
+	table->slots = isc_mem_get(ht->mctx,
+				   ((size_t)1 << bits) * sizeof(isc_ht_slot_t));
+	if (table->slots == NULL)
+		return (ISC_R_NOMEMORY);
+
+	table->bits = bits;
+	table->size = (size_t)1 << bits;
+	table->mask = table->size - 1;
+	table->count = 0;
+	for (i = 0; i < table->size; i++) {
+		table->slots[i].hashval = 0;
+		table->slots[i].node = NULL;
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+table_free(isc_ht_t *ht, isc_ht_table_t *table) {
+	size_t i;
+
+	for (i = 0; i < table->size && table->count > 0; i++) {
+		isc_ht_node_t *node = table->slots[i].node;
+		if (node != NULL) {
+			isc_mem_put(ht->mctx, node,
+				    sizeof(isc_ht_node_t) + node->keysize);
+			table->count--;
+			ht->count--;
+		}
+	}
+	INSIST(table->count == 0);
+
+	isc_mem_put(ht->mctx, table->slots,
+		    table->size * sizeof(isc_ht_slot_t));
+	table->slots = NULL;
+	table->bits = 0;
+	table->size = 0;
+	table->mask = 0;
+}
+
+/*%
+ * Return the slot holding 'key' in 'table', or NULL.
+ */
+static isc_ht_slot_t *
+table_find(const isc_ht_table_t *table, isc_uint32_t hashval,
+	   const unsigned char *key, isc_uint32_t keysize)
+{
+	isc_ht_slot_t *slot;
+	size_t i;
+
+	if (table->count == 0)
+		return (NULL);
+
+	for (i = hashval & table->mask;
+	     (slot = &table->slots[i])->node != NULL;
+	     i = (i + 1) & table->mask)
+	{
+		if (slot->hashval == hashval &&
+		    slot->node->keysize == keysize &&
+		    memcmp(slot->node->key, key, keysize) == 0)
+		{
+			return (slot);
+		}
+	}
+
+	return (NULL);
+}
+
+static void
+table_insert(isc_ht_table_t *table, isc_uint32_t hashval,
+	     isc_ht_node_t *node)
+{
+	size_t i;
+
+	INSIST(table->count < table->mask);
+
+	for (i = hashval & table->mask;
+	     table->slots[i].node != NULL;
+	     i = (i + 1) & table->mask)
+		;
+
+	table->slots[i].hashval = hashval;
+	table->slots[i].node = node;
+	table->count++;
+}
+
+/*%
+ * Empty slot 'i' of 'table' and close the gap: each later entry of the
+ * run whose home slot is not between the gap and its own position moves
+ * back into the gap, which leaves a new gap behind it.
+ */
+static void
+table_remove(isc_ht_table_t *table, size_t i) {
+	size_t j, home;
+
+	INSIST(table->slots[i].node != NULL);
+
+	for (j = (i + 1) & table->mask;
+	     table->slots[j].node != NULL;
+	     j = (j + 1) & table->mask)
+	{
+		home = table->slots[j].hashval & table->mask;
+		if (((j - home) & table->mask) >= ((j - i) & table->mask)) {
+			table->slots[i] = table->slots[j];
+			i = j;
+		}
+	}
+
+	table->slots[i].hashval = 0;
+	table->slots[i].node = NULL;
+	table->count--;
+}
+
+/*%
+ * Move up to HT_REHASH_STEP slots' worth of entries from the old table
+ * into the current one ('steps' == 0 moves everything), and release
+ * the old table once it is empty.
+ */
+static void
+rehash_step(isc_ht_t *ht, unsigned int steps) {
+	isc_ht_table_t *old = &ht->table[1];
+	isc_ht_slot_t *slot;
+
+	if (old->slots == NULL)
+		return;
+
+	while (old->count > 0) {
+		INSIST(ht->hashpos < old->size);
+		slot = &old->slots[ht->hashpos];
+		if (slot->node == NULL) {
+			ht->hashpos++;
+		} else {
+			/*
+			 * Removing the entry may pull a later one into
+			 * this slot, so look at it again next time.
+			 */
+			table_insert(&ht->table[0], slot->hashval, slot->node);
+			table_remove(old, ht->hashpos);
+		}
+		if (steps > 0 && --steps == 0)
+			break;
+	}
+
+	if (old->count == 0) {
+		table_free(ht, old);
+		ht->hashpos = 0;
+	}
+}
+
+/*%
+ * Start moving the entries to a new table of 2^bits slots.  Any resize
+ * already in progress is completed first.
+ */
+static isc_result_t
+rehash_start(isc_ht_t *ht, isc_uint8_t bits) {
+	isc_ht_table_t table;
+	isc_result_t result;
+
+	rehash_step(ht, 0);
+	INSIST(ht->table[1].slots == NULL);
+
+	result = table_init(ht, &table, bits);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	ht->table[1] = ht->table[0];
+	ht->table[0] = table;
+	ht->hashpos = 0;
+
+	if (ht->table[1].count == 0)
+		table_free(ht, &ht->table[1]);
+
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 isc_ht_init(isc_ht_t **htp, isc_mem_t *mctx, isc_uint8_t bits) {
 	isc_ht_t *ht = NULL;
-	size_t i;
+	isc_result_t result;
 
 	REQUIRE(htp != NULL && *htp == NULL);
 	REQUIRE(mctx != NULL);
 	REQUIRE(bits >= 1 && bits <= (sizeof(size_t)*8 - 1));
 
+	if (bits < HT_MINBITS)
+		bits = HT_MINBITS;
+	if (bits > HT_MAXBITS)
+		bits = HT_MAXBITS;
+
 	ht = isc_mem_get(mctx, sizeof(struct isc_ht));
 	if (ht == NULL) {
 		return (ISC_R_NOMEMORY);
@@ -63,18 +300,14 @@ isc_ht_init(isc_ht_t **htp, isc_mem_t *mctx, isc_uint8_t bits) {
 	ht->mctx = NULL;
 	isc_mem_attach(mctx, &ht->mctx);
 
-	ht->size = ((size_t)1<<bits);
-	ht->mask = ((size_t)1<<bits)-1;
 	ht->count = 0;
+	ht->hashpos = 0;
+	memset(ht->table, 0, sizeof(ht->table));
 
-	ht->table = isc_mem_get(ht->mctx, ht->size * sizeof(isc_ht_node_t*));
-	if (ht->table == NULL) {
+	result = table_init(ht, &ht->table[0], bits);
+	if (result != ISC_R_SUCCESS) {
 		isc_mem_putanddetach(&ht->mctx, ht, sizeof(struct isc_ht));
-		return (ISC_R_NOMEMORY);
-	}
-
-	for (i = 0; i < ht->size; i++) {
-		ht->table[i] = NULL;
+		return (result);
 	}
 
 	ht->magic = ISC_HT_MAGIC;
@@ -86,7 +319,6 @@ isc_ht_init(isc_ht_t **htp, isc_mem_t *mctx, isc_uint8_t bits) {
 void
 isc_ht_destroy(isc_ht_t **htp) {
 	isc_ht_t *ht;
-	size_t i;
 
 	REQUIRE(htp != NULL);
 
@@ -95,20 +327,12 @@ isc_ht_destroy(isc_ht_t **htp) {
 
 	ht->magic = 0;
 
-	for (i = 0; i < ht->size; i++) {
-		isc_ht_node_t *node = ht->table[i];
-		while (node != NULL) {
-			isc_ht_node_t *next = node->next;
-			ht->count--;
-			isc_mem_put(ht->mctx, node,
-				    sizeof(isc_ht_node_t) + node->keysize);
-			node = next;
-		}
-	}
+	if (ht->table[1].slots != NULL)
+		table_free(ht, &ht->table[1]);
+	table_free(ht, &ht->table[0]);
 
 	INSIST(ht->count == 0);
 
-	isc_mem_put(ht->mctx, ht->table, ht->size * sizeof(isc_ht_node_t*));
 	isc_mem_putanddetach(&ht->mctx, ht, sizeof(struct isc_ht));
 
 	*htp = NULL;
@@ -120,18 +344,33 @@ isc_ht_add(isc_ht_t *ht, const unsigned char *key,
 {
 	isc_ht_node_t *node;
 	isc_uint32_t hash;
+	isc_result_t result;
 
 	REQUIRE(ISC_HT_VALID(ht));
 	REQUIRE(key != NULL && keysize > 0);
 
 	hash = isc_hash_function(key, keysize, ISC_TRUE, NULL);
-	node = ht->table[hash & ht->mask];
-	while (node != NULL) {
-		if (keysize == node->keysize &&
-		    memcmp(key, node->key, keysize) == 0) {
-			return (ISC_R_EXISTS);
+	if (table_find(&ht->table[0], hash, key, keysize) != NULL ||
+	    table_find(&ht->table[1], hash, key, keysize) != NULL)
+	{
+		return (ISC_R_EXISTS);
+	}
+
+	if (HT_OVERCOMMIT(&ht->table[0], ht->count + 1) &&
+	    ht->table[0].bits < HT_MAXBITS)
+	{
+		result = rehash_start(ht, ht->table[0].bits + 1);
+		/*
+		 * If the table can't grow, carry on as long as there
+		 * is room left.
+		 */
+		if (result != ISC_R_SUCCESS &&
+		    ht->count + 1 >= ht->table[0].mask)
+		{
+			return (result);
 		}
-		node = node->next;
+	} else if (ht->count + 1 >= ht->table[0].mask) {
+		return (ISC_R_NOSPACE);
 	}
 
 	node = isc_mem_get(ht->mctx, sizeof(isc_ht_node_t) + keysize);
@@ -140,11 +379,13 @@ isc_ht_add(isc_ht_t *ht, const unsigned char *key,
 
 	memmove(node->key, key, keysize);
 	node->keysize = keysize;
-	node->next = ht->table[hash & ht->mask];
 	node->value = value;
 
+	table_insert(&ht->table[0], hash, node);
 	ht->count++;
-	ht->table[hash & ht->mask] = node;
+
+	rehash_step(ht, HT_REHASH_STEP);
+
 	return (ISC_R_SUCCESS);
 }
 
@@ -152,57 +393,59 @@ isc_result_t
 isc_ht_find(const isc_ht_t *ht, const unsigned char *key,
 	    isc_uint32_t keysize, void **valuep)
 {
-	isc_ht_node_t *node;
+	isc_ht_slot_t *slot;
 	isc_uint32_t hash;
 
 	REQUIRE(ISC_HT_VALID(ht));
 	REQUIRE(key != NULL && keysize > 0);
 
 	hash = isc_hash_function(key, keysize, ISC_TRUE, NULL);
-	node = ht->table[hash & ht->mask];
-	while (node != NULL) {
-		if (keysize == node->keysize &&
-		    memcmp(key, node->key, keysize) == 0)
-		{
-			if (valuep != NULL)
-				*valuep = node->value;
-			return (ISC_R_SUCCESS);
-		}
-		node = node->next;
-	}
-
-	return (ISC_R_NOTFOUND);
+	slot = table_find(&ht->table[0], hash, key, keysize);
+	if (slot == NULL)
+		slot = table_find(&ht->table[1], hash, key, keysize);
+	if (slot == NULL)
+		return (ISC_R_NOTFOUND);
+
+	if (valuep != NULL)
+		*valuep = slot->node->value;
+	return (ISC_R_SUCCESS);
 }
 
 isc_result_t
 isc_ht_delete(isc_ht_t *ht, const unsigned char *key, isc_uint32_t keysize) {
-	isc_ht_node_t *node, *prev;
+	isc_ht_table_t *table;
+	isc_ht_slot_t *slot;
+	isc_ht_node_t *node;
 	isc_uint32_t hash;
 
 	REQUIRE(ISC_HT_VALID(ht));
 	REQUIRE(key != NULL && keysize > 0);
 
-	prev = NULL;
 	hash = isc_hash_function(key, keysize, ISC_TRUE, NULL);
-	node = ht->table[hash & ht->mask];
-	while (node != NULL) {
-		if (keysize == node->keysize &&
-		    memcmp(key, node->key, keysize) == 0) {
-			if (prev == NULL)
-				ht->table[hash & ht->mask] = node->next;
-			else
-				prev->next = node->next;
-			isc_mem_put(ht->mctx, node,
-				    sizeof(isc_ht_node_t) + node->keysize);
-			ht->count--;
+	table = &ht->table[0];
+	slot = table_find(table, hash, key, keysize);
+	if (slot == NULL) {
+		table = &ht->table[1];
+		slot = table_find(table, hash, key, keysize);
+	}
+	if (slot == NULL)
+		return (ISC_R_NOTFOUND);
 
-			return (ISC_R_SUCCESS);
-		}
+	node = slot->node;
+	table_remove(table, slot - table->slots);
+	isc_mem_put(ht->mctx, node, sizeof(isc_ht_node_t) + node->keysize);
+	ht->count--;
 
-		prev = node;
-		node = node->next;
+	if (ht->table[1].slots != NULL) {
+		rehash_step(ht, HT_REHASH_STEP);
+	} else if (HT_UNDERCOMMIT(&ht->table[0], ht->count) &&
+		   ht->table[0].bits > HT_MINBITS)
+	{
+		/* Failing to shrink is harmless. */
+		(void)rehash_start(ht, ht->table[0].bits - 1);
 	}
-	return (ISC_R_NOTFOUND);
+
+	return (ISC_R_SUCCESS);
 }
 
 isc_result_t
@@ -217,7 +460,9 @@ isc_ht_iter_create(isc_ht_t *ht, isc_ht_iter_t **itp) {
 		return (ISC_R_NOMEMORY);
 
 	it->ht = ht;
-	it->i = 0;
+	it->t = 0;
+	it->start = 0;
+	it->n = 0;
 	it->cur = NULL;
 
 	*itp = it;
@@ -239,20 +484,61 @@ isc_ht_iter_destroy(isc_ht_iter_t **itp) {
 	*itp = NULL;
 }
 
+static inline isc_ht_slot_t *
+iter_slot(isc_ht_iter_t *it) {
+	isc_ht_table_t *table = &it->ht->table[it->t];
+
+	return (&table->slots[(it->start + 1 + it->n) & table->mask]);
+}
+
+/*%
+ * Starting at the current position, find the next occupied slot,
+ * moving on to the next table when this one is exhausted.
+ */
+static isc_result_t
+iter_scan(isc_ht_iter_t *it) {
+	isc_ht_table_t *table;
+
+	for (;;) {
+		table = &it->ht->table[it->t];
+		if (table->count > 0) {
+			for (; it->n < table->size; it->n++) {
+				if (iter_slot(it)->node != NULL) {
+					it->cur = iter_slot(it)->node;
+					return (ISC_R_SUCCESS);
+				}
+			}
+		}
+
+		if (++it->t == 2)
+			break;
+
+		table = &it->ht->table[it->t];
+		it->n = 0;
+		it->start = 0;
+		while (it->start < table->size &&
+		       table->slots[it->start].node != NULL)
+			it->start++;
+	}
+
+	it->cur = NULL;
+	return (ISC_R_NOMORE);
+}
+
 isc_result_t
 isc_ht_iter_first(isc_ht_iter_t *it) {
 	REQUIRE(it != NULL);
 
-	it->i = 0;
-	while (it->i < it->ht->size && it->ht->table[it->i] == NULL)
-		it->i++;
-
-	if (it->i == it->ht->size)
-		return (ISC_R_NOMORE);
+	/*
+	 * Table 0 is never full, so this finds an empty slot.
+	 */
+	it->t = 0;
+	it->n = 0;
+	it->start = 0;
+	while (it->ht->table[0].slots[it->start].node != NULL)
+		it->start++;
 
-	it->cur = it->ht->table[it->i];
-
-	return (ISC_R_SUCCESS);
+	return (iter_scan(it));
 }
 
 isc_result_t
@@ -260,61 +546,36 @@ isc_ht_iter_next(isc_ht_iter_t *it) {
 	REQUIRE(it != NULL);
 	REQUIRE(it->cur != NULL);
 
-	it->cur = it->cur->next;
-	if (it->cur == NULL) {
-		do {
-			it->i++;
-		} while (it->i < it->ht->size && it->ht->table[it->i] == NULL);
-		if (it->i >= it->ht->size)
-			return (ISC_R_NOMORE);
-		it->cur = it->ht->table[it->i];
-	}
-
-	return (ISC_R_SUCCESS);
+	it->n++;
+	return (iter_scan(it));
 }
 
 isc_result_t
 isc_ht_iter_delcurrent_next(isc_ht_iter_t *it) {
-	isc_result_t result = ISC_R_SUCCESS;
-	isc_ht_node_t *to_delete = NULL;
-	isc_ht_node_t *prev = NULL;
-	isc_ht_node_t *node = NULL;
-	isc_uint32_t hash;
+	isc_ht_table_t *table;
+	isc_ht_slot_t *slot;
+	isc_ht_node_t *node;
 	isc_ht_t *ht;
+
 	REQUIRE(it != NULL);
 	REQUIRE(it->cur != NULL);
-	to_delete = it->cur;
-	ht = it->ht;
-
-	it->cur = it->cur->next;
-	if (it->cur == NULL) {
-		do {
-			it->i++;
-		} while (it->i < ht->size && ht->table[it->i] == NULL);
-		if (it->i >= ht->size)
-			result = ISC_R_NOMORE;
-		else
-			it->cur = ht->table[it->i];
-	}
-
-	hash = isc_hash_function(to_delete->key, to_delete->keysize, ISC_TRUE,
-				 NULL);
-	node = ht->table[hash & ht->mask];
-	while (node != to_delete) {
-		prev = node;
-		node = node->next;
-		INSIST(node != NULL);
-	}
 
-	if (prev == NULL)
-		ht->table[hash & ht->mask] = node->next;
-	else
-		prev->next = node->next;
-	isc_mem_put(ht->mctx, node,
-		    sizeof(isc_ht_node_t) + node->keysize);
+	ht = it->ht;
+	table = &ht->table[it->t];
+	slot = iter_slot(it);
+	node = slot->node;
+	INSIST(node == it->cur);
+
+	/*
+	 * No resizing here, as that would move entries about underneath
+	 * the iterator.  The slot is looked at again because a later
+	 * entry may have been moved into it.
+	 */
+	table_remove(table, slot - table->slots);
+	isc_mem_put(ht->mctx, node, sizeof(isc_ht_node_t) + node->keysize);
 	ht->count--;
 
-	return (result);
+	return (iter_scan(it));
 }
 
 void
@@ -19,7 +19,9 @@ typedef struct isc_ht isc_ht_t;
 typedef struct isc_ht_iter isc_ht_iter_t;
 
 /*%
- * Initialize hashtable at *htp, using memory context and size of (1<<bits)
+ * Initialize hashtable at *htp, using memory context and an initial size
+ * of (1<<bits).  The table grows and shrinks as entries are added and
+ * deleted, so 'bits' is only a hint of the expected number of entries.
  *
  * Requires:
  *\li	htp is not NULL
@@ -90,6 +92,9 @@ isc_ht_delete(isc_ht_t *ht, const unsigned char *key, isc_uint32_t keysize);
 
 /*%
  * Create an iterator for the hashtable; point '*itp' to it.
+ *
+ * While an iterator is in use, the hashtable must not be changed other
+ * than through isc_ht_iter_delcurrent_next() on that iterator.
  */
 isc_result_t
 isc_ht_iter_create(isc_ht_t *ht, isc_ht_iter_t **itp);
@@ -32,7 +32,28 @@ int isc_iterated_hash(unsigned char out[NSEC3_MAX_HASH_LENGTH],
 		      unsigned int hashalg, int iterations,
 		      const unsigned char *salt, int saltlength,
 		      const unsigned char *in, int inlength);
+/*%<
+ * Compute the NSEC3 hash (RFC 5155) of 'in' using the given hash
+ * algorithm, number of iterations and salt, and store it in 'out'.
+ *
+ * Returns the length of the hash, or 0 if 'hashalg' is not supported.
+ */
 
+int isc_iterated_hash_batch(unsigned char *out[], unsigned int count,
+			    unsigned int hashalg, int iterations,
+			    const unsigned char *salt, int saltlength,
+			    const unsigned char *const in[],
+			    const int inlength[]);
+/*%<
+ * Compute the NSEC3 hashes of 'count' inputs, 'in[i]' of length
+ * 'inlength[i]' hashed into 'out[i]', all with the same algorithm,
+ * number of iterations and salt.  The result is the same as calling
+ * isc_iterated_hash() on each input in turn, but where the platform
+ * allows, several inputs are hashed at once in the lanes of a vector
+ * unit.
+ *
+ * Returns the length of the hashes, or 0 if 'hashalg' is not supported.
+ */
 
 ISC_LANG_ENDDECLS
 
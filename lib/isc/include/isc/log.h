@@ -91,6 +91,17 @@ typedef enum {
 } isc_log_rollsuffix_t;
 /*@}*/
 
+/*@{*/
+/*!
+ * \brief What to do with a message when the asynchronous logging queue
+ * is full.  See isc_log_setasync().
+ */
+typedef enum {
+	isc_logoverflow_block,
+	isc_logoverflow_drop
+} isc_logoverflow_t;
+/*@}*/
+
 /*!
  * \brief Used to name the categories used by a library.
  *
@@ -872,6 +883,59 @@ isc_log_closefilelogs(isc_log_t *lctx);
  *	next needed.
  */
 
+isc_result_t
+isc_log_setasync(isc_log_t *lctx, unsigned int size,
+		 isc_logoverflow_t overflow);
+/*%<
+ * Turn asynchronous logging on or off.
+ *
+ * When 'size' is non-zero, isc_log_write() and friends format the
+ * message on the calling thread and pass it to a background writer
+ * thread through a queue of 'size' entries (rounded up to a power of
+ * two), instead of writing it out while holding the context lock.
+ * The writer thread writes messages out in batches and flushes each
+ * file channel once per batch.  Messages at #ISC_LOG_CRITICAL are
+ * still written by the calling thread, after everything queued before
+ * them, so that they are not lost if the program exits straight away.
+ *
+ * 'overflow' selects what happens when the queue is full: with
+ * isc_logoverflow_block the logging thread waits for room, and with
+ * isc_logoverflow_drop the message is discarded.  The writer thread
+ * logs how many messages were discarded once it catches up.
+ *
+ * A 'size' of zero turns asynchronous logging off.  Messages that are
+ * already queued are written before this function returns.
+ *
+ * Notes:
+ *\li	The queue is created the first time asynchronous logging is
+ *	turned on and lasts until the context is destroyed.  Later calls
+ *	can change 'overflow' but not the size of the queue.
+ *
+ * Requires:
+ *\li	lctx is a valid context.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS	Success
+ *\li	#ISC_R_NOMEMORY	Resource Limit: Out of memory
+ *\li	#ISC_R_NOTIMPLEMENTED	Threads or atomic operations are not
+ *				available on this platform.
+ *\li	Other errors if the writer thread cannot be started.
+ */
+
+void
+isc_log_getqueuestats(isc_log_t *lctx, isc_uint64_t *droppedp,
+		      isc_uint64_t *blockedp);
+/*%<
+ * Get the number of messages discarded because the asynchronous
+ * logging queue was full, and the number of times a logging thread had
+ * to wait for room in it.  Both are zero if asynchronous logging has
+ * never been turned on.
+ *
+ * Requires:
+ *\li	lctx is a valid context.
+ *\li	droppedp and blockedp are not NULL.
+ */
+
 isc_logcategory_t *
 isc_log_categorybyname(isc_log_t *lctx, const char *name);
 /*%<
@@ -314,6 +314,11 @@ isc_mem_createx2(size_t max_size, size_t target_size,
  * 'target_size' are zero, default values will be * used.  When
  * ISC_MEMFLAG_INTERNAL is not set, 'target_size' is ignored.
  *
+ * With threads, a context that uses ISC_MEMFLAG_INTERNAL without
+ * ISC_MEMFLAG_NOLOCK also caches a few free pieces of each size per
+ * thread.  Cached pieces count as in use in isc_mem_inuse() and for
+ * the water marks.
+ *
  * 'max_size' is also used to size the statistics arrays and the array
  * used to record active memory when ISC_MEM_DEBUGRECORD is set.  Setting
  * 'max_size' too low can have detrimental effects on performance.
@@ -26,6 +26,11 @@ typedef enum {
 	isc_rwlocktype_write
 } isc_rwlocktype_t;
 
+/*%
+ * Options for isc_rwlock_initx().
+ */
+#define ISC_RWLOCK_BIGREADER	0x00000001	/*%< per-CPU reader slots */
+
 #ifdef ISC_PLATFORM_USETHREADS
 #if defined(ISC_PLATFORM_HAVEXADD) && defined(ISC_PLATFORM_HAVECMPXCHG)
 #define ISC_RWLOCK_USEATOMIC 1
@@ -67,6 +72,20 @@ struct isc_rwlock {
 	/* Unlocked. */
 	unsigned int		write_quota;
 
+	/*
+	 * Big-reader mode (ISC_RWLOCK_BIGREADER): readers are counted in
+	 * 'nslots' per-CPU counters, each on a cache line of its own,
+	 * instead of in cnt_and_flag, and a writer sets 'brwriter' and
+	 * waits for all the counters to drain.  'slots' is NULL when the
+	 * lock is not in big-reader mode.
+	 */
+	isc_mem_t		*mctx;
+	isc_int32_t		*slots;
+	unsigned int		nslots;
+	void			*slotsmem;
+	size_t			slotssize;
+	isc_int32_t		brwriter;
+
 #else  /* ISC_PLATFORM_HAVEXADD && ISC_PLATFORM_HAVECMPXCHG */
 
 	/*%< Locked by lock. */
@@ -104,6 +123,33 @@ isc_result_t
 isc_rwlock_init(isc_rwlock_t *rwl, unsigned int read_quota,
 		unsigned int write_quota);
 
+isc_result_t
+isc_rwlock_initx(isc_rwlock_t *rwl, unsigned int read_quota,
+		 unsigned int write_quota, isc_mem_t *mctx,
+		 unsigned int options);
+/*%<
+ * Initialize the read-write lock 'rwl'.  isc_rwlock_init() is
+ * isc_rwlock_initx() with no 'mctx' and no options.
+ *
+ * If 'options' includes ISC_RWLOCK_BIGREADER, the lock is made a
+ * "big-reader" lock: each reader only touches a counter private to its
+ * CPU, so readers on different CPUs do not contend with one another,
+ * while a writer has to wait for every CPU's counter to drain.  This
+ * suits locks that are taken for reading very often and for writing
+ * rarely.  Writers are preferred: new readers wait while a writer is
+ * waiting or working.  The counters are allocated from 'mctx'.
+ * Without atomic operations the option is ignored.
+ *
+ * Requires:
+ *\li	'rwl' is not NULL.
+ *\li	'mctx' is a valid memory context if ISC_RWLOCK_BIGREADER is set.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_UNEXPECTED
+ */
+
 isc_result_t
 isc_rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type);
 
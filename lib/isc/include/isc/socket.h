@@ -125,6 +125,14 @@ ISC_LANG_BEGINDECLS
  */
 #define ISC_SOCKET_REUSEADDRESS		0x01U
 
+/*%
+ * In isc_socket_bind() set socket option SO_REUSEPORT prior to calling
+ * bind() if a non zero port is specified, so that several sockets bound
+ * to the same address share the incoming datagrams.  This is only
+ * supported where the kernel balances the load between such sockets.
+ */
+#define ISC_SOCKET_REUSEPORT		0x02U
+
 /*%
  * Statistics counters.  Used as isc_statscounter_t values.
  */
@@ -203,7 +211,19 @@ enum {
 	isc_sockstatscounter_rawrecvfail = 60,
 	isc_sockstatscounter_rawactive = 61,
 
-	isc_sockstatscounter_max = 62
+	isc_sockstatscounter_udprecvbatch1 = 62,
+	isc_sockstatscounter_udprecvbatch2 = 63,
+	isc_sockstatscounter_udprecvbatch4 = 64,
+	isc_sockstatscounter_udprecvbatch8 = 65,
+	isc_sockstatscounter_udprecvbatch16 = 66,
+
+	isc_sockstatscounter_udpsendbatch1 = 67,
+	isc_sockstatscounter_udpsendbatch2 = 68,
+	isc_sockstatscounter_udpsendbatch4 = 69,
+	isc_sockstatscounter_udpsendbatch8 = 70,
+	isc_sockstatscounter_udpsendbatch16 = 71,
+
+	isc_sockstatscounter_max = 72
 };
 
 /***
@@ -309,6 +329,7 @@ typedef enum {
  */
 #define ISC_SOCKFLAG_IMMEDIATE	0x00000001	/*%< send event only if needed */
 #define ISC_SOCKFLAG_NORETRY	0x00000002	/*%< drop failed UDP sends */
+#define ISC_SOCKFLAG_BATCH	0x00000004	/*%< coalesce UDP I/O */
 /*@}*/
 
 /*@{*/
@@ -705,6 +726,7 @@ isc_socket_bind(isc_socket_t *sock, const isc_sockaddr_t *addressp,
  * \li	ISC_R_ADDRNOTAVAIL
  * \li	ISC_R_ADDRINUSE
  * \li	ISC_R_BOUND
+ * \li	ISC_R_NOTIMPLEMENTED	ISC_SOCKET_REUSEPORT is not supported
  * \li	ISC_R_UNEXPECTED
  */
 
@@ -876,12 +898,18 @@ isc_socket_recv2(isc_socket_t *sock, isc_region_t *region,
  *	expected to be initialized.
  *
  *\li	For isc_socket_recv2():
- *	The only defined value for 'flags' is ISC_SOCKFLAG_IMMEDIATE.  If
- *	set and the operation completes, the return value will be
- *	ISC_R_SUCCESS and the event will be filled in and not sent.  If the
- *	operation does not complete, the return value will be
- *	ISC_R_INPROGRESS and the event will be sent when the operation
- *	completes.
+ *	The only defined values for 'flags' are ISC_SOCKFLAG_IMMEDIATE
+ *	and ISC_SOCKFLAG_BATCH.  If ISC_SOCKFLAG_IMMEDIATE is set and the
+ *	operation completes, the return value will be ISC_R_SUCCESS and the
+ *	event will be filled in and not sent.  If the operation does not
+ *	complete, the return value will be ISC_R_INPROGRESS and the event
+ *	will be sent when the operation completes.
+ *
+ *\li	ISC_SOCKFLAG_BATCH only affects unconnected UDP sockets.  If set,
+ *	no attempt is made to read immediately; the request is queued so
+ *	that the socket manager can fill it, together with the other
+ *	queued requests, using a single system call (recvmmsg() where
+ *	available).  On systems without such a call the flag is ignored.
  *
  * Requires:
  *
@@ -967,8 +995,8 @@ isc_socket_sendto2(isc_socket_t *sock, isc_region_t *region,
  *	expected to be initialized.
  *
  *\li	For isc_socket_sendto2():
- *	The only defined values for 'flags' are ISC_SOCKFLAG_IMMEDIATE
- *	and ISC_SOCKFLAG_NORETRY.
+ *	The only defined values for 'flags' are ISC_SOCKFLAG_IMMEDIATE,
+ *	ISC_SOCKFLAG_NORETRY and ISC_SOCKFLAG_BATCH.
  *
  *\li	If ISC_SOCKFLAG_IMMEDIATE is set and the operation completes, the
  *	return value will be ISC_R_SUCCESS and the event will be filled
@@ -982,6 +1010,15 @@ isc_socket_sendto2(isc_socket_t *sock, isc_region_t *region,
  *	Using this option along with ISC_SOCKFLAG_IMMEDIATE allows the caller
  *	to specify a region that is allocated on the stack.
  *
+ *\li	ISC_SOCKFLAG_BATCH only affects unconnected UDP sockets.  If set,
+ *	the request is sent immediately when no other send is queued on
+ *	the socket.  Otherwise, or if it cannot be sent without blocking,
+ *	it is queued, even with ISC_SOCKFLAG_NORETRY, and written out
+ *	together with the other queued requests using a single system
+ *	call (sendmmsg() where available).  The region must remain
+ *	valid until the completion event is received.  On systems without
+ *	such a call the flag is ignored.
+ *
  * Requires:
  *
  *\li	'socket' is a valid, bound socket.
@@ -1025,12 +1062,16 @@ isc_socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 
 isc_result_t
 isc_socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		      unsigned int maxsocks);
+		      unsigned int maxsocks, int nthreads);
 /*%<
  * Create a socket manager.  If "maxsocks" is non-zero, it specifies the
  * maximum number of sockets that the created manager should handle.
+ * "nthreads" is the number of watcher threads that will wait for socket
+ * events; each socket is serviced by exactly one of them.  It is ignored
+ * (and a single watcher is used) when the manager is built without
+ * threads or uses select().
  * isc_socketmgr_create() is equivalent of isc_socketmgr_create2() with
- * "maxsocks" being zero.
+ * "maxsocks" being zero and "nthreads" being one.
  * isc_socketmgr_createinctx() also associates the new manager with the
  * specified application context.
  *
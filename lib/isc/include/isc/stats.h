@@ -22,6 +22,11 @@ ISC_LANG_BEGINDECLS
  */
 #define ISC_STATSDUMP_VERBOSE	0x00000001 /*%< dump 0-value counters */
 
+/*%<
+ * Flag(s) for isc_stats_create2().
+ */
+#define ISC_STATSCREATE_SHARDED	0x00000001 /*%< per-thread counter rows */
+
 /*%<
  * Dump callback type.
  */
@@ -44,6 +49,28 @@ isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters);
  *\li	anything else	-- failure
  */
 
+isc_result_t
+isc_stats_create2(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters,
+		  unsigned int options);
+/*%<
+ * Like isc_stats_create(), but if 'options' has the
+ * ISC_STATSCREATE_SHARDED flag, keep a row of counters per thread (up
+ * to a limit) where the platform allows, so that threads updating the
+ * counters at the same time do not contend for them.  This multiplies
+ * the memory used by the set, and is meant for heavily updated,
+ * server-wide sets.
+ *
+ * Requires:
+ *\li	'mctx' must be a valid memory context.
+ *
+ *\li	'statsp' != NULL && '*statsp' == NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS	-- all ok
+ *
+ *\li	anything else	-- failure
+ */
+
 void
 isc_stats_attach(isc_stats_t *stats, isc_stats_t **statsp);
 /*%<
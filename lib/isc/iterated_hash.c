@@ -11,9 +11,47 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #include <isc/sha1.h>
 #include <isc/iterated_hash.h>
+#include <isc/types.h>
+#include <isc/util.h>
+
+/*
+ * isc_iterated_hash_batch() computes several SHA-1 hashes side by side,
+ * one per lane of a vector register, when the compiler targets AVX2
+ * (8 lanes) or SSE2 (4 lanes).
+ */
+#if defined(__AVX2__) && defined(__GNUC__)
+#include <immintrin.h>
+#define IH_LANES		8
+typedef __m256i ih_vec_t;
+#define V_ADD(a, b)		_mm256_add_epi32(a, b)
+#define V_AND(a, b)		_mm256_and_si256(a, b)
+#define V_ANDNOT(a, b)		_mm256_andnot_si256(a, b)
+#define V_OR(a, b)		_mm256_or_si256(a, b)
+#define V_XOR(a, b)		_mm256_xor_si256(a, b)
+#define V_SLL(a, n)		_mm256_slli_epi32(a, n)
+#define V_SRL(a, n)		_mm256_srli_epi32(a, n)
+#define V_SET1(x)		_mm256_set1_epi32((int)(x))
+#define V_LOAD(p)		_mm256_loadu_si256((const __m256i *)(p))
+#define V_STORE(p, v)		_mm256_storeu_si256((__m256i *)(p), v)
+#elif defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define IH_LANES		4
+typedef __m128i ih_vec_t;
+#define V_ADD(a, b)		_mm_add_epi32(a, b)
+#define V_AND(a, b)		_mm_and_si128(a, b)
+#define V_ANDNOT(a, b)		_mm_andnot_si128(a, b)
+#define V_OR(a, b)		_mm_or_si128(a, b)
+#define V_XOR(a, b)		_mm_xor_si128(a, b)
+#define V_SLL(a, n)		_mm_slli_epi32(a, n)
+#define V_SRL(a, n)		_mm_srli_epi32(a, n)
+#define V_SET1(x)		_mm_set1_epi32((int)(x))
+#define V_LOAD(p)		_mm_loadu_si128((const __m128i *)(p))
+#define V_STORE(p, v)		_mm_storeu_si128((__m128i *)(p), v)
+#endif
 
 int
 isc_iterated_hash(unsigned char out[ISC_SHA1_DIGESTLENGTH],
@@ -38,3 +76,237 @@ isc_iterated_hash(unsigned char out[ISC_SHA1_DIGESTLENGTH],
 
 	return (ISC_SHA1_DIGESTLENGTH);
 }
+
+#ifdef IH_LANES
+
+/*
+ * The longest message hashed in lanes: a name and a salt of up to 255
+ * octets each, plus padding.
+ */
+#define IH_MAXBLOCKS		9
+
+#define V_ROTL(x, n)		V_OR(V_SLL(x, n), V_SRL(x, 32 - (n)))
+
+#define ROUND(f, k, t) \
+	do { \
+		if ((t) >= 16) \
+			w[(t) & 15] = V_ROTL(V_XOR(V_XOR(w[((t) - 3) & 15], \
+							 w[((t) - 8) & 15]), \
+						   V_XOR(w[((t) - 14) & 15], \
+							 w[(t) & 15])), 1); \
+		tmp = V_ADD(V_ADD(V_ROTL(a, 5), f), \
+			    V_ADD(V_ADD(e, k), w[(t) & 15])); \
+		e = d; \
+		d = c; \
+		c = V_ROTL(b, 30); \
+		b = a; \
+		a = tmp; \
+	} while (0)
+
+#define F1	V_XOR(d, V_AND(b, V_XOR(c, d)))
+#define F2	V_XOR(b, V_XOR(c, d))
+#define F3	V_OR(V_AND(b, c), V_AND(d, V_OR(b, c)))
+
+static const isc_uint32_t sha1_iv[5] = {
+	0x67452301U, 0xefcdab89U, 0x98badcfeU, 0x10325476U, 0xc3d2e1f0U
+};
+
+/*
+ * Run the SHA-1 compression function on one block in every lane.
+ */
+static void
+sha1_lanes(ih_vec_t h[5], const ih_vec_t block[16]) {
+	ih_vec_t w[16], a, b, c, d, e, tmp, k;
+	int t;
+
+	memmove(w, block, sizeof(w));
+	a = h[0];
+	b = h[1];
+	c = h[2];
+	d = h[3];
+	e = h[4];
+
+	k = V_SET1(0x5a827999U);
+	for (t = 0; t < 20; t++)
+		ROUND(F1, k, t);
+	k = V_SET1(0x6ed9eba1U);
+	for (; t < 40; t++)
+		ROUND(F2, k, t);
+	k = V_SET1(0x8f1bbcdcU);
+	for (; t < 60; t++)
+		ROUND(F3, k, t);
+	k = V_SET1(0xca62c1d6U);
+	for (; t < 80; t++)
+		ROUND(F2, k, t);
+
+	h[0] = V_ADD(h[0], a);
+	h[1] = V_ADD(h[1], b);
+	h[2] = V_ADD(h[2], c);
+	h[3] = V_ADD(h[3], d);
+	h[4] = V_ADD(h[4], e);
+}
+
+/*
+ * Append the SHA-1 padding for a 'length' octet message to 'msg' and
+ * return the number of blocks.
+ */
+static unsigned int
+sha1_pad(unsigned char *msg, unsigned int length) {
+	unsigned int blocks = (length + 8) / 64 + 1;
+	isc_uint64_t bits = (isc_uint64_t)length * 8;
+	unsigned int i;
+
+	msg[length] = 0x80;
+	memset(msg + length + 1, 0, blocks * 64 - length - 1);
+	for (i = 0; i < 8; i++)
+		msg[blocks * 64 - 1 - i] = (unsigned char)(bits >> (i * 8));
+	return (blocks);
+}
+
+static inline isc_uint32_t
+load32(const unsigned char *p) {
+	return (((isc_uint32_t)p[0] << 24) | ((isc_uint32_t)p[1] << 16) |
+		((isc_uint32_t)p[2] << 8) | (isc_uint32_t)p[3]);
+}
+
+/*
+ * Hash 'count' (at most IH_LANES) inputs in lanes.  Lanes past 'count'
+ * hash the first input again and are discarded.  'tail' holds the
+ * blocks hashed after each intermediate digest: the salt and padding
+ * from word 5 onwards, broadcast to every lane.
+ */
+static void
+hash_lanes(unsigned char *out[], unsigned int count, int iterations,
+	   const unsigned char *salt, int saltlength,
+	   const unsigned char *const in[], const int inlength[],
+	   const ih_vec_t *tail, unsigned int tailblocks)
+{
+	unsigned char msg[IH_LANES][IH_MAXBLOCKS * 64];
+	unsigned int blocks[IH_LANES], maxblocks = 0;
+	isc_uint32_t words[16][IH_LANES], active[IH_LANES];
+	isc_uint32_t digest[5][IH_LANES];
+	ih_vec_t h[5], state[5], block[16], mask;
+	unsigned int lane, b, i, t, src;
+	int n;
+
+	for (lane = 0; lane < IH_LANES; lane++) {
+		src = (lane < count) ? lane : 0;
+		memmove(msg[lane], in[src], inlength[src]);
+		memmove(msg[lane] + inlength[src], salt, saltlength);
+		blocks[lane] = sha1_pad(msg[lane], inlength[src] + saltlength);
+		if (blocks[lane] > maxblocks)
+			maxblocks = blocks[lane];
+	}
+
+	/*
+	 * The first hash covers the input and the salt, so the lanes
+	 * may need different numbers of blocks.  A lane that has run
+	 * out of blocks keeps its state.
+	 */
+	for (i = 0; i < 5; i++)
+		h[i] = V_SET1(sha1_iv[i]);
+	for (b = 0; b < maxblocks; b++) {
+		for (lane = 0; lane < IH_LANES; lane++) {
+			for (t = 0; t < 16; t++)
+				words[t][lane] = (b < blocks[lane])
+					? load32(msg[lane] + b * 64 + t * 4)
+					: 0;
+			active[lane] = (b < blocks[lane]) ? 0xffffffffU : 0;
+		}
+		for (t = 0; t < 16; t++)
+			block[t] = V_LOAD(words[t]);
+		mask = V_LOAD(active);
+		memmove(state, h, sizeof(state));
+		sha1_lanes(state, block);
+		for (i = 0; i < 5; i++)
+			h[i] = V_OR(V_AND(mask, state[i]),
+				    V_ANDNOT(mask, h[i]));
+	}
+
+	/*
+	 * The rest hash the previous digest and the salt, which are the
+	 * same length in every lane.  The digest is already in the
+	 * first five words.
+	 */
+	for (n = 0; n < iterations; n++) {
+		for (i = 0; i < 5; i++) {
+			block[i] = h[i];
+			state[i] = V_SET1(sha1_iv[i]);
+		}
+		memmove(&block[5], &tail[5], 11 * sizeof(block[0]));
+		sha1_lanes(state, block);
+		for (b = 1; b < tailblocks; b++)
+			sha1_lanes(state, &tail[b * 16]);
+		memmove(h, state, sizeof(h));
+	}
+
+	for (i = 0; i < 5; i++)
+		V_STORE(digest[i], h[i]);
+	for (lane = 0; lane < count; lane++) {
+		for (i = 0; i < 5; i++) {
+			out[lane][i * 4] = (unsigned char)(digest[i][lane] >> 24);
+			out[lane][i * 4 + 1] =
+				(unsigned char)(digest[i][lane] >> 16);
+			out[lane][i * 4 + 2] =
+				(unsigned char)(digest[i][lane] >> 8);
+			out[lane][i * 4 + 3] = (unsigned char)digest[i][lane];
+		}
+	}
+}
+
+#endif /* IH_LANES */
+
+int
+isc_iterated_hash_batch(unsigned char *out[], unsigned int count,
+			unsigned int hashalg, int iterations,
+			const unsigned char *salt, int saltlength,
+			const unsigned char *const in[], const int inlength[])
+{
+	unsigned int i = 0;
+#ifdef IH_LANES
+	unsigned char msg[IH_MAXBLOCKS * 64];
+	ih_vec_t tail[IH_MAXBLOCKS * 16];
+	unsigned int tailblocks, lanes, j, t;
+	isc_boolean_t fits;
+#endif
+
+	if (hashalg != 1)
+		return (0);
+
+#ifdef IH_LANES
+	if (count < 2 || saltlength < 0 ||
+	    ISC_SHA1_DIGESTLENGTH + saltlength + 9 > (int)sizeof(msg))
+		goto scalar;
+
+	/*
+	 * The blocks hashed after an intermediate digest, with room for
+	 * the digest at the start.
+	 */
+	memset(msg, 0, ISC_SHA1_DIGESTLENGTH);
+	memmove(msg + ISC_SHA1_DIGESTLENGTH, salt, saltlength);
+	tailblocks = sha1_pad(msg, ISC_SHA1_DIGESTLENGTH + saltlength);
+	for (t = 0; t < tailblocks * 16; t++)
+		tail[t] = V_SET1(load32(msg + t * 4));
+
+	while (count - i >= 2) {
+		lanes = ISC_MIN(count - i, IH_LANES);
+		fits = ISC_TRUE;
+		for (j = i; j < i + lanes; j++)
+			if (inlength[j] < 0 ||
+			    inlength[j] + saltlength + 9 > (int)sizeof(msg))
+				fits = ISC_FALSE;
+		if (!fits)
+			break;
+		hash_lanes(out + i, lanes, iterations, salt, saltlength,
+			   in + i, inlength + i, tail, tailblocks);
+		i += lanes;
+	}
+
+ scalar:
+#endif
+	for (; i < count; i++)
+		(void)isc_iterated_hash(out[i], hashalg, iterations,
+					salt, saltlength, in[i], inlength[i]);
+
+	return (ISC_SHA1_DIGESTLENGTH);
+}
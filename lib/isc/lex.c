@@ -27,6 +27,34 @@
 #include <isc/string.h>
 #include <isc/util.h>
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define LEX_USE_SSE2 1
+#endif
+
+/*%
+ * Lexers that own their input file read it this many bytes at a time.
+ */
+#define LEX_READBUFSIZE			65536
+
+/*%
+ * The largest set of stop characters that is scanned for with vector
+ * compares; larger sets fall back to the lookup table alone.
+ */
+#define LEX_MAXSTOPS			16
+
+/*%
+ * The characters that can end (or otherwise interrupt) a run of
+ * ordinary characters in a given lexer state.  'map' is indexed by
+ * character; 'chars' lists the same set for the vector scan and is
+ * only valid when 'nchars' is not zero.
+ */
+typedef struct stopset {
+	unsigned int			nchars;
+	unsigned char			chars[LEX_MAXSTOPS];
+	unsigned char			map[256];
+} stopset_t;
+
 typedef struct inputsource {
 	isc_result_t			result;
 	isc_boolean_t			is_file;
@@ -36,6 +64,9 @@ typedef struct inputsource {
 	isc_buffer_t *			pushback;
 	unsigned int			ignored;
 	void *				input;
+	unsigned char *			readbuf;
+	size_t				readlen;
+	size_t				readpos;
 	char *				name;
 	unsigned long			line;
 	unsigned long			saved_line;
@@ -58,9 +89,102 @@ struct isc_lex {
 	unsigned int			paren_count;
 	unsigned int			saved_paren_count;
 	isc_lexspecials_t		specials;
+	stopset_t			string_stops;
+	stopset_t			qstring_stops;
 	LIST(struct inputsource)	sources;
 };
 
+static void
+stopset_add(stopset_t *stops, unsigned char c) {
+	if (stops->map[c] != 0)
+		return;
+	stops->map[c] = 1;
+	if (stops->nchars < LEX_MAXSTOPS)
+		stops->chars[stops->nchars] = c;
+	stops->nchars++;
+}
+
+static void
+stopset_init(stopset_t *stops) {
+	stops->nchars = 0;
+	memset(stops->map, 0, sizeof(stops->map));
+}
+
+static void
+stopset_done(stopset_t *stops) {
+	if (stops->nchars > LEX_MAXSTOPS)
+		stops->nchars = 0;
+}
+
+/*
+ * Work out which characters end a run of ordinary characters in the
+ * string and quoted string states.  Anything that could be a delimiter,
+ * an escape or the start of a comment is a stop; stopping on more than
+ * is strictly needed is harmless as the stop character itself is always
+ * handled by the character-at-a-time code.
+ */
+static void
+update_stops(isc_lex_t *lex) {
+	unsigned int c;
+
+	stopset_init(&lex->string_stops);
+	stopset_add(&lex->string_stops, ' ');
+	stopset_add(&lex->string_stops, '\t');
+	stopset_add(&lex->string_stops, '\r');
+	stopset_add(&lex->string_stops, '\n');
+	stopset_add(&lex->string_stops, '\\');
+	if ((lex->comments & ISC_LEXCOMMENT_DNSMASTERFILE) != 0)
+		stopset_add(&lex->string_stops, ';');
+	if ((lex->comments & (ISC_LEXCOMMENT_C|ISC_LEXCOMMENT_CPLUSPLUS)) != 0)
+		stopset_add(&lex->string_stops, '/');
+	if ((lex->comments & ISC_LEXCOMMENT_SHELL) != 0)
+		stopset_add(&lex->string_stops, '#');
+	for (c = 0; c < 256; c++)
+		if (lex->specials[c])
+			stopset_add(&lex->string_stops, (unsigned char)c);
+	stopset_done(&lex->string_stops);
+
+	stopset_init(&lex->qstring_stops);
+	stopset_add(&lex->qstring_stops, '"');
+	stopset_add(&lex->qstring_stops, '\\');
+	stopset_add(&lex->qstring_stops, '\n');
+	stopset_done(&lex->qstring_stops);
+}
+
+/*
+ * Return the length of the longest prefix of 'p' that contains no
+ * character from 'stops'.  Nothing past the first stop character
+ * is examined.
+ */
+static size_t
+span(const stopset_t *stops, const unsigned char *p, size_t len) {
+	size_t i = 0;
+#ifdef LEX_USE_SSE2
+	__m128i want[LEX_MAXSTOPS];
+	unsigned int j, n = stops->nchars;
+
+	if (n != 0 && len >= 16) {
+		for (j = 0; j < n; j++)
+			want[j] = _mm_set1_epi8((char)stops->chars[j]);
+		for (; i + 16 <= len; i += 16) {
+			__m128i v, m;
+			unsigned int mask;
+
+			v = _mm_loadu_si128((const __m128i *)(p + i));
+			m = _mm_cmpeq_epi8(v, want[0]);
+			for (j = 1; j < n; j++)
+				m = _mm_or_si128(m, _mm_cmpeq_epi8(v, want[j]));
+			mask = (unsigned int)_mm_movemask_epi8(m);
+			if (mask != 0)
+				return (i + __builtin_ctz(mask));
+		}
+	}
+#endif
+	while (i < len && stops->map[p[i]] == 0)
+		i++;
+	return (i);
+}
+
 static inline isc_result_t
 grow_data(isc_lex_t *lex, size_t *remainingp, char **currp, char **prevp) {
 	char *tmp;
@@ -108,6 +232,7 @@ isc_lex_create(isc_mem_t *mctx, size_t max_token, isc_lex_t **lexp) {
 	lex->paren_count = 0;
 	lex->saved_paren_count = 0;
 	memset(lex->specials, 0, 256);
+	update_stops(lex);
 	INIT_LIST(lex->sources);
 	lex->magic = LEX_MAGIC;
 
@@ -158,6 +283,7 @@ isc_lex_setcomments(isc_lex_t *lex, unsigned int comments) {
 	REQUIRE(VALID_LEX(lex));
 
 	lex->comments = comments;
+	update_stops(lex);
 }
 
 void
@@ -181,6 +307,7 @@ isc_lex_setspecials(isc_lex_t *lex, isc_lexspecials_t specials) {
 	REQUIRE(VALID_LEX(lex));
 
 	memmove(lex->specials, specials, 256);
+	update_stops(lex);
 }
 
 static inline isc_result_t
@@ -199,6 +326,9 @@ new_source(isc_lex_t *lex, isc_boolean_t is_file, isc_boolean_t need_close,
 	source->at_eof = ISC_FALSE;
 	source->last_was_eol = lex->last_was_eol;
 	source->input = input;
+	source->readbuf = NULL;
+	source->readlen = 0;
+	source->readpos = 0;
 	source->name = isc_mem_strdup(lex->mctx, name);
 	if (source->name == NULL) {
 		isc_mem_put(lex->mctx, source, sizeof(*source));
@@ -221,6 +351,7 @@ new_source(isc_lex_t *lex, isc_boolean_t is_file, isc_boolean_t need_close,
 
 isc_result_t
 isc_lex_openfile(isc_lex_t *lex, const char *filename) {
+	inputsource *source;
 	isc_result_t result;
 	FILE *stream = NULL;
 
@@ -235,9 +366,19 @@ isc_lex_openfile(isc_lex_t *lex, const char *filename) {
 		return (result);
 
 	result = new_source(lex, ISC_TRUE, ISC_TRUE, stream, filename);
-	if (result != ISC_R_SUCCESS)
+	if (result != ISC_R_SUCCESS) {
 		(void)fclose(stream);
-	return (result);
+		return (result);
+	}
+
+	/*
+	 * Nobody else can see this stream, so it can be read ahead
+	 * in large blocks rather than a character at a time.  If the
+	 * buffer can't be had, fall back to doing just that.
+	 */
+	source = HEAD(lex->sources);
+	source->readbuf = isc_mem_get(lex->mctx, LEX_READBUFSIZE);
+	return (ISC_R_SUCCESS);
 }
 
 isc_result_t
@@ -289,6 +430,9 @@ isc_lex_close(isc_lex_t *lex) {
 	if (source->is_file) {
 		if (source->need_close)
 			(void)fclose((FILE *)(source->input));
+		if (source->readbuf != NULL)
+			isc_mem_put(lex->mctx, source->readbuf,
+				    LEX_READBUFSIZE);
 	}
 	isc_mem_free(lex->mctx, source->name);
 	isc_buffer_free(&source->pushback);
@@ -324,29 +468,96 @@ pushback(inputsource *source, int c) {
 		source->line--;
 }
 
+static isc_result_t
+growpushback(isc_lex_t *lex, inputsource *source, unsigned int needed) {
+	isc_buffer_t *tbuf = NULL;
+	unsigned int newlen;
+	isc_region_t used;
+	isc_result_t result;
+
+	newlen = isc_buffer_length(source->pushback) * 2;
+	while (newlen - isc_buffer_usedlength(source->pushback) < needed)
+		newlen *= 2;
+	result = isc_buffer_allocate(lex->mctx, &tbuf, newlen);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	isc_buffer_usedregion(source->pushback, &used);
+	result = isc_buffer_copyregion(tbuf, &used);
+	INSIST(result == ISC_R_SUCCESS);
+	tbuf->current = source->pushback->current;
+	isc_buffer_free(&source->pushback);
+	source->pushback = tbuf;
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 pushandgrow(isc_lex_t *lex, inputsource *source, int c) {
 	if (isc_buffer_availablelength(source->pushback) == 0) {
-		isc_buffer_t *tbuf = NULL;
-		unsigned int oldlen;
-		isc_region_t used;
-		isc_result_t result;
-
-		oldlen = isc_buffer_length(source->pushback);
-		result = isc_buffer_allocate(lex->mctx, &tbuf, oldlen * 2);
+		isc_result_t result = growpushback(lex, source, 1);
 		if (result != ISC_R_SUCCESS)
 			return (result);
-		isc_buffer_usedregion(source->pushback, &used);
-		result = isc_buffer_copyregion(tbuf, &used);
-		INSIST(result == ISC_R_SUCCESS);
-		tbuf->current = source->pushback->current;
-		isc_buffer_free(&source->pushback);
-		source->pushback = tbuf;
 	}
 	isc_buffer_putuint8(source->pushback, (isc_uint8_t)c);
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Consume the run of characters at the current input position that
+ * contains nothing from 'stops', appending it to the token being built
+ * and to the pushback buffer exactly as reading it one character at a
+ * time would have.  Only input that is already in memory is looked at,
+ * so this may consume nothing even when the run continues; the caller
+ * carries on a character at a time in that case.
+ */
+static isc_result_t
+scanrun(isc_lex_t *lex, inputsource *source, const stopset_t *stops,
+	char **currp, size_t *remainingp, char **prevp)
+{
+	const unsigned char *p;
+	isc_buffer_t *buffer = NULL;
+	size_t len, n;
+	isc_result_t result;
+
+	if (source->is_file) {
+		if (source->readbuf == NULL)
+			return (ISC_R_SUCCESS);
+		p = source->readbuf + source->readpos;
+		len = source->readlen - source->readpos;
+	} else {
+		buffer = source->input;
+		p = (unsigned char *)buffer->base + buffer->current;
+		len = buffer->used - buffer->current;
+	}
+
+	n = span(stops, p, len);
+	if (n == 0)
+		return (ISC_R_SUCCESS);
+
+	if (isc_buffer_availablelength(source->pushback) < n) {
+		result = growpushback(lex, source, (unsigned int)n);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+	isc_buffer_putmem(source->pushback, p, (unsigned int)n);
+	isc_buffer_forward(source->pushback, (unsigned int)n);
+
+	while (*remainingp < n) {
+		result = grow_data(lex, remainingp, currp, prevp);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+	memmove(*currp, p, n);
+	*currp += n;
+	**currp = '\0';
+	*remainingp -= n;
+
+	if (buffer != NULL)
+		buffer->current += (unsigned int)n;
+	else
+		source->readpos += n;
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 	inputsource *source;
@@ -426,8 +637,49 @@ isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 #endif
 
 	do {
+		if (isc_buffer_remaininglength(source->pushback) == 0 &&
+		    !escaped &&
+		    (state == lexstate_string || state == lexstate_qstring))
+		{
+			/*
+			 * Take the ordinary characters in bulk; the one
+			 * that stops the run is read below as usual.
+			 */
+			source->result =
+				scanrun(lex, source,
+					(state == lexstate_string)
+					   ? &lex->string_stops
+					   : &lex->qstring_stops,
+					&curr, &remaining, &prev);
+			if (source->result != ISC_R_SUCCESS) {
+				result = source->result;
+				goto done;
+			}
+		}
+
 		if (isc_buffer_remaininglength(source->pushback) == 0) {
-			if (source->is_file) {
+			if (source->is_file && source->readbuf != NULL) {
+				stream = source->input;
+
+				if (source->readpos == source->readlen) {
+					source->readpos = 0;
+					source->readlen = fread(source->readbuf,
+								1,
+								LEX_READBUFSIZE,
+								stream);
+				}
+				if (source->readpos < source->readlen) {
+					c = source->readbuf[source->readpos++];
+				} else {
+					if (ferror(stream)) {
+						source->result = ISC_R_IOERROR;
+						result = source->result;
+						goto done;
+					}
+					c = EOF;
+					source->at_eof = ISC_TRUE;
+				}
+			} else if (source->is_file) {
 				stream = source->input;
 
 #if defined(HAVE_FLOCKFILE) && defined(HAVE_GETCUNLOCKED)
@@ -20,6 +20,8 @@
 
 #include <sys/types.h>	/* dev_t FreeBSD 2.1 */
 
+#include <isc/atomic.h>
+#include <isc/condition.h>
 #include <isc/dir.h>
 #include <isc/file.h>
 #include <isc/log.h>
@@ -30,6 +32,7 @@
 #include <isc/stat.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/util.h>
 
@@ -48,6 +51,18 @@
 #define PATH_MAX 1024	/* AIX and others don't define this. */
 #endif
 
+/*
+ * Asynchronous logging (isc_log_setasync()) needs a writer thread and
+ * atomic operations for its queue.
+ */
+#if defined(ISC_PLATFORM_USETHREADS) && defined(ISC_PLATFORM_HAVEXADD) && \
+    defined(ISC_PLATFORM_HAVECMPXCHG)
+#define USE_LOG_QUEUE
+#endif
+
+#define LOG_QUEUE_MAXSIZE	(1024 * 1024)
+#define LOG_BATCH_SIZE		256
+
 /*!
  * This is the structure that holds each named channel.  A simple linked
  * list chains all of the channels together, so an individual channel is
@@ -65,6 +80,7 @@ struct isc_logchannel {
 	int 				level;
 	unsigned int			flags;
 	isc_logdestination_t 		destination;
+	isc_boolean_t			dirty;
 	ISC_LINK(isc_logchannel_t)	link;
 };
 
@@ -96,6 +112,56 @@ struct isc_logmessage {
 	ISC_LINK(isc_logmessage_t)	link;
 };
 
+#ifdef USE_LOG_QUEUE
+/*!
+ * A message waiting in the asynchronous logging queue.  The text is
+ * stored immediately after the structure; 'size' is the size of the
+ * whole allocation.
+ */
+typedef struct isc_logrecord {
+	isc_logcategory_t *		category;
+	isc_logmodule_t *		module;
+	int				level;
+	isc_time_t			time;
+	size_t				size;
+	char *				text;
+} isc_logrecord_t;
+
+typedef struct isc_logslot {
+	isc_int32_t			seq;
+	isc_logrecord_t *		record;
+} isc_logslot_t;
+
+/*!
+ * The asynchronous logging queue and its writer thread.  See
+ * isc_logqueue_get() for how the ring works.
+ */
+typedef struct isc_logqueue {
+	/* Not locked. */
+	isc_log_t *			lctx;
+	unsigned int			size;
+	isc_logslot_t *			slots;
+	isc_thread_t			thread;
+	/* Atomic. */
+	isc_int32_t			tail;
+	isc_int32_t			idle;
+	/* Writer thread only. */
+	isc_uint32_t			head;
+	isc_mutex_t			lock;
+	/* Locked by queue lock. */
+	isc_boolean_t			enabled;
+	isc_logoverflow_t		overflow;
+	isc_condition_t			ready;
+	isc_condition_t			space;
+	isc_uint32_t			written;
+	unsigned int			waiters;
+	isc_boolean_t			shutdown;
+	isc_uint64_t			dropped;
+	isc_uint64_t			reported;
+	isc_uint64_t			blocked;
+} isc_logqueue_t;
+#endif /* USE_LOG_QUEUE */
+
 /*!
  * The isc_logconfig structure is used to store the configurable information
  * about where messages are actually supposed to be sent -- the information
@@ -146,6 +212,10 @@ struct isc_log {
 	isc_logconfig_t * 		logconfig;
 	char 				buffer[LOG_BUFFER_SIZE];
 	ISC_LIST(isc_logmessage_t)	messages;
+#ifdef USE_LOG_QUEUE
+	/* Set once, freed by isc_log_destroy(). */
+	isc_logqueue_t *		queue;
+#endif
 };
 
 /*!
@@ -225,6 +295,11 @@ sync_channellist(isc_logconfig_t *lcfg);
 static isc_result_t
 greatest_version(isc_logfile_t *file, int versions, int *greatest);
 
+#ifdef USE_LOG_QUEUE
+static void
+isc_logqueue_destroy(isc_logqueue_t **queuep);
+#endif
+
 static void
 isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 	     isc_logmodule_t *module, int level, isc_boolean_t write_once,
@@ -274,6 +349,9 @@ isc_log_create(isc_mem_t *mctx, isc_log_t **lctxp, isc_logconfig_t **lcfgp) {
 		lctx->debug_level = 0;
 
 		ISC_LIST_INIT(lctx->messages);
+#ifdef USE_LOG_QUEUE
+		lctx->queue = NULL;
+#endif
 
 		result = isc_mutex_init(&lctx->lock);
 		if (result != ISC_R_SUCCESS) {
@@ -462,6 +540,11 @@ isc_log_destroy(isc_log_t **lctxp) {
 	lctx = *lctxp;
 	mctx = lctx->mctx;
 
+#ifdef USE_LOG_QUEUE
+	if (lctx->queue != NULL)
+		isc_logqueue_destroy(&lctx->queue);
+#endif
+
 	if (lctx->logconfig != NULL) {
 		lcfg = lctx->logconfig;
 		lctx->logconfig = NULL;
@@ -728,6 +811,7 @@ isc_log_createchannel(isc_logconfig_t *lcfg, const char *name,
 	channel->type = type;
 	channel->level = level;
 	channel->flags = flags;
+	channel->dirty = ISC_FALSE;
 	ISC_LINK_INIT(channel, link);
 
 	switch (type) {
@@ -1577,65 +1661,114 @@ isc_log_wouldlog(isc_log_t *lctx, int level) {
 			level <= lctx->debug_level)));
 }
 
-static void
-isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
-	     isc_logmodule_t *module, int level, isc_boolean_t write_once,
-	     isc_msgcat_t *msgcat, int msgset, int msg,
-	     const char *format, va_list args)
-{
-	int syslog_level;
-	const char *time_string;
-	char local_time[64];
-	char iso8601z_string[64];
-	char iso8601l_string[64];
-	char level_string[24];
-	const char *iformat;
-	struct stat statbuf;
-	isc_boolean_t matched = ISC_FALSE;
-	isc_boolean_t printtime, iso8601, utc, printtag, printcolon;
-	isc_boolean_t printcategory, printmodule, printlevel, buffered;
-	isc_logconfig_t *lcfg;
-	isc_logchannel_t *channel;
-	isc_logchannellist_t *category_channels;
-	isc_result_t result;
+/*
+ * Check 'text' against the messages logged within the duplicate
+ * interval.  Returns ISC_TRUE if it is a duplicate; otherwise it is
+ * remembered and ISC_FALSE is returned.
+ *
+ * The caller must be holding the context lock.
+ */
+static isc_boolean_t
+isc_log_duplicate(isc_log_t *lctx, isc_logconfig_t *lcfg, const char *text) {
+	isc_logmessage_t *message, *next;
+	isc_time_t oldest;
+	isc_interval_t interval;
 
-	REQUIRE(lctx == NULL || VALID_CONTEXT(lctx));
-	REQUIRE(category != NULL);
-	REQUIRE(module != NULL);
-	REQUIRE(level != ISC_LOG_DYNAMIC);
-	REQUIRE(format != NULL);
+	isc_interval_set(&interval, lcfg->duplicate_interval, 0);
 
 	/*
-	 * Programs can use libraries that use this logging code without
-	 * wanting to do any logging, thus the log context is allowed to
-	 * be non-existent.
+	 * 'oldest' is the age of the oldest messages
+	 * which fall within the duplicate_interval
+	 * range.
 	 */
-	if (lctx == NULL)
-		return;
+	TIME_NOW(&oldest);
+	if (isc_time_subtract(&oldest, &interval, &oldest) != ISC_R_SUCCESS)
+		/*
+		 * Can't effectively do the checking
+		 * without having a valid time.
+		 */
+		message = NULL;
+	else
+		message = ISC_LIST_HEAD(lctx->messages);
 
-	REQUIRE(category->id < lctx->category_count);
-	REQUIRE(module->id < lctx->module_count);
+	while (message != NULL) {
+		if (isc_time_compare(&message->time, &oldest) < 0) {
+			/*
+			 * This message is older
+			 * than the duplicate_interval,
+			 * so it should be dropped from
+			 * the history.
+			 *
+			 * Setting the interval to be
+			 * to be longer will obviously
+			 * not cause the expired
+			 * message to spring back into
+			 * existence.
+			 */
+			next = ISC_LIST_NEXT(message, link);
 
-	if (! isc_log_wouldlog(lctx, level))
-		return;
+			ISC_LIST_UNLINK(lctx->messages, message, link);
 
-	if (msgcat != NULL)
-		iformat = isc_msgcat_get(msgcat, msgset, msg, format);
-	else
-		iformat = format;
+			isc_mem_put(lctx->mctx, message,
+				    sizeof(*message) + 1 +
+				    strlen(message->text));
 
-	local_time[0] = '\0';
-	iso8601l_string[0] = '\0';
-	iso8601z_string[0] = '\0';
-	level_string[0] = '\0';
+			message = next;
+			continue;
+		}
 
-	LOCK(&lctx->lock);
+		/*
+		 * This message is in the duplicate
+		 * filtering interval ...
+		 */
+		if (strcmp(text, message->text) == 0)
+			/*
+			 * ... and it is a duplicate.
+			 */
+			return (ISC_TRUE);
 
-	lctx->buffer[0] = '\0';
+		message = ISC_LIST_NEXT(message, link);
+	}
 
-	lcfg = lctx->logconfig;
+	/*
+	 * It wasn't in the duplicate interval,
+	 * so add it to the message list.
+	 */
+	message = isc_mem_get(lctx->mctx,
+			      sizeof(isc_logmessage_t) + strlen(text) + 1);
+	if (message != NULL) {
+		/*
+		 * Put the text immediately after
+		 * the struct.  The strcpy is safe.
+		 */
+		message->text = (char *)(message + 1);
+		strcpy(message->text, text);
 
-	category_channels = ISC_LIST_HEAD(lcfg->channellists[category->id]);
+		TIME_NOW(&message->time);
+
+		ISC_LINK_INIT(message, link);
+		ISC_LIST_APPEND(lctx->messages, message, link);
+	}
+
+	return (ISC_FALSE);
+}
+
+/*
+ * Return the next channel that a message of the given category, module
+ * and level should be written to, or NULL when there are no more.
+ * '*listp' and '*matchedp' hold the position in the channel lists
+ * between calls; they start out as the head of the category's channel
+ * list and ISC_FALSE.
+ *
+ * The caller must be holding the context lock.
+ */
+static isc_logchannel_t *
+isc_log_nextchannel(isc_log_t *lctx, isc_logconfig_t *lcfg,
+		    isc_logmodule_t *module, int level,
+		    isc_logchannellist_t **listp, isc_boolean_t *matchedp)
+{
+	isc_logchannellist_t *category_channels = *listp;
+	isc_logchannel_t *channel = NULL;
 
 	/*
 	 * XXXDCL add duplicate filtering? (To not write multiple times to
@@ -1646,10 +1779,12 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 		 * If the channel list end was reached and a match was made,
 		 * everything is finished.
 		 */
-		if (category_channels == NULL && matched)
+		if (category_channels == NULL && *matchedp) {
+			channel = NULL;
 			break;
+		}
 
-		if (category_channels == NULL && ! matched &&
+		if (category_channels == NULL && ! *matchedp &&
 		    category_channels != ISC_LIST_HEAD(lcfg->channellists[0]))
 			/*
 			 * No category/module pair was explicitly configured.
@@ -1658,7 +1793,7 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 			category_channels =
 				ISC_LIST_HEAD(lcfg->channellists[0]);
 
-		if (category_channels == NULL && ! matched)
+		if (category_channels == NULL && ! *matchedp)
 			/*
 			 * No matching module was explicitly configured
 			 * for the category named "default".  Use the internal
@@ -1673,7 +1808,7 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 			continue;
 		}
 
-		matched = ISC_TRUE;
+		*matchedp = ISC_TRUE;
 
 		channel = category_channels->channel;
 		category_channels = ISC_LIST_NEXT(category_channels, link);
@@ -1688,292 +1823,813 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 		} else if (channel->level < level)
 			continue;
 
-		if ((channel->flags & ISC_LOG_PRINTTIME) != 0 &&
-		    local_time[0] == '\0')
-		{
-			isc_time_t isctime;
+		break;
+	} while (1);
+
+	*listp = category_channels;
+	return (channel);
+}
+
+/*
+ * The time and level strings printed in front of a message, formatted
+ * the first time a channel asks for them.
+ */
+typedef struct isc_logprefix {
+	const isc_time_t *	time;
+	char			local_time[64];
+	char			iso8601z_string[64];
+	char			iso8601l_string[64];
+	char			level_string[24];
+} isc_logprefix_t;
 
+static void
+isc_log_initprefix(isc_logprefix_t *prefix, const isc_time_t *time) {
+	prefix->time = time;
+	prefix->local_time[0] = '\0';
+	prefix->iso8601l_string[0] = '\0';
+	prefix->iso8601z_string[0] = '\0';
+	prefix->level_string[0] = '\0';
+}
+
+/*
+ * Write 'text' to 'channel'.  If 'batched' is true, a file channel is
+ * not flushed here but marked for isc_log_flushchannels().
+ *
+ * The caller must be holding the context lock.
+ */
+static void
+isc_log_writechannel(isc_logconfig_t *lcfg, isc_logchannel_t *channel,
+		     isc_logcategory_t *category, isc_logmodule_t *module,
+		     int level, isc_logprefix_t *prefix, const char *text,
+		     isc_boolean_t batched)
+{
+	int syslog_level;
+	const char *time_string;
+	struct stat statbuf;
+	isc_boolean_t printtime, iso8601, utc, printtag, printcolon;
+	isc_boolean_t printcategory, printmodule, printlevel, buffered;
+	isc_result_t result;
+
+	if ((channel->flags & ISC_LOG_PRINTTIME) != 0 &&
+	    prefix->local_time[0] == '\0')
+	{
+		isc_time_t isctime;
+
+		if (prefix->time != NULL)
+			isctime = *prefix->time;
+		else
 			TIME_NOW(&isctime);
 
-			isc_time_formattimestamp(&isctime,
-						 local_time,
-						 sizeof(local_time));
-			isc_time_formatISO8601ms(&isctime,
-						 iso8601z_string,
-						 sizeof(iso8601z_string));
-			isc_time_formatISO8601Lms(&isctime,
-						  iso8601l_string,
-						  sizeof(iso8601l_string));
+		isc_time_formattimestamp(&isctime,
+					 prefix->local_time,
+					 sizeof(prefix->local_time));
+		isc_time_formatISO8601ms(&isctime,
+					 prefix->iso8601z_string,
+					 sizeof(prefix->iso8601z_string));
+		isc_time_formatISO8601Lms(&isctime,
+					  prefix->iso8601l_string,
+					  sizeof(prefix->iso8601l_string));
+	}
+
+	if ((channel->flags & ISC_LOG_PRINTLEVEL) != 0 &&
+	    prefix->level_string[0] == '\0') {
+		if (level < ISC_LOG_CRITICAL)
+			snprintf(prefix->level_string,
+				 sizeof(prefix->level_string),
+				 isc_msgcat_get(isc_msgcat,
+						ISC_MSGSET_LOG,
+						ISC_MSG_LEVEL,
+						"level %d: "),
+				 level);
+		else if (level > ISC_LOG_DYNAMIC)
+			snprintf(prefix->level_string,
+				 sizeof(prefix->level_string),
+				 "%s %d: ", log_level_strings[0],
+				 level);
+		else
+			snprintf(prefix->level_string,
+				 sizeof(prefix->level_string),
+				 "%s: ", log_level_strings[-level]);
+	}
+
+	utc	      = ISC_TF((channel->flags & ISC_LOG_UTC) != 0);
+	iso8601       = ISC_TF((channel->flags & ISC_LOG_ISO8601) != 0);
+	printtime     = ISC_TF((channel->flags & ISC_LOG_PRINTTIME)
+			       != 0);
+	printtag      = ISC_TF((channel->flags &
+				(ISC_LOG_PRINTTAG|ISC_LOG_PRINTPREFIX))
+			       != 0 && lcfg->tag != NULL);
+	printcolon    = ISC_TF((channel->flags & ISC_LOG_PRINTTAG)
+			       != 0 && lcfg->tag != NULL);
+	printcategory = ISC_TF((channel->flags & ISC_LOG_PRINTCATEGORY)
+			       != 0);
+	printmodule   = ISC_TF((channel->flags & ISC_LOG_PRINTMODULE)
+			       != 0);
+	printlevel    = ISC_TF((channel->flags & ISC_LOG_PRINTLEVEL)
+			       != 0);
+	buffered      = ISC_TF((channel->flags & ISC_LOG_BUFFERED)
+			       != 0);
+
+	if (printtime) {
+		if (iso8601) {
+			if (utc) {
+				time_string = prefix->iso8601z_string;
+			} else {
+				time_string = prefix->iso8601l_string;
+			}
+		} else {
+			time_string = prefix->local_time;
 		}
+	} else
+		time_string = "";
 
-		if ((channel->flags & ISC_LOG_PRINTLEVEL) != 0 &&
-		    level_string[0] == '\0') {
-			if (level < ISC_LOG_CRITICAL)
-				snprintf(level_string, sizeof(level_string),
-					 isc_msgcat_get(isc_msgcat,
-							ISC_MSGSET_LOG,
-							ISC_MSG_LEVEL,
-							"level %d: "),
-					 level);
-			else if (level > ISC_LOG_DYNAMIC)
-				snprintf(level_string, sizeof(level_string),
-					 "%s %d: ", log_level_strings[0],
-					 level);
-			else
-				snprintf(level_string, sizeof(level_string),
-					 "%s: ", log_level_strings[-level]);
+	switch (channel->type) {
+	case ISC_LOG_TOFILE:
+		if (FILE_MAXREACHED(channel)) {
+			/*
+			 * If the file can be rolled, OR
+			 * If the file no longer exists, OR
+			 * If the file is less than the maximum size,
+			 *    (such as if it had been renamed and
+			 *     a new one touched, or it was truncated
+			 *     in place)
+			 * ... then close it to trigger reopening.
+			 */
+			if (FILE_VERSIONS(channel) !=
+			    ISC_LOG_ROLLNEVER ||
+			    (stat(FILE_NAME(channel), &statbuf) != 0 &&
+			     errno == ENOENT) ||
+			    statbuf.st_size < FILE_MAXSIZE(channel)) {
+				(void)fclose(FILE_STREAM(channel));
+				FILE_STREAM(channel) = NULL;
+				FILE_MAXREACHED(channel) = ISC_FALSE;
+			} else
+				/*
+				 * Eh, skip it.
+				 */
+				break;
 		}
 
+		if (FILE_STREAM(channel) == NULL) {
+			result = isc_log_open(channel);
+			if (result != ISC_R_SUCCESS &&
+			    result != ISC_R_MAXSIZE &&
+			    (channel->flags & ISC_LOG_OPENERR) == 0) {
+				syslog(LOG_ERR,
+				       "isc_log_open '%s' failed: %s",
+				       FILE_NAME(channel),
+				       isc_result_totext(result));
+				channel->flags |= ISC_LOG_OPENERR;
+			}
+			if (result != ISC_R_SUCCESS)
+				break;
+			channel->flags &= ~ISC_LOG_OPENERR;
+		}
+		/* FALLTHROUGH */
+
+	case ISC_LOG_TOFILEDESC:
+		fprintf(FILE_STREAM(channel),
+			"%s%s%s%s%s%s%s%s%s%s\n",
+			printtime     ? time_string	: "",
+			printtime     ? " "		: "",
+			printtag      ? lcfg->tag	: "",
+			printcolon    ? ": "		: "",
+			printcategory ? category->name	: "",
+			printcategory ? ": "		: "",
+			printmodule   ? (module != NULL ? module->name
+							: "no_module")
+							: "",
+			printmodule   ? ": "		: "",
+			printlevel    ? prefix->level_string : "",
+			text);
+
 		/*
-		 * Only format the message once.
+		 * A batch is flushed, and the size of the file checked,
+		 * once the whole batch has been written.
 		 */
-		if (lctx->buffer[0] == '\0') {
-			(void)vsnprintf(lctx->buffer, sizeof(lctx->buffer),
-					iformat, args);
+		if (batched) {
+			channel->dirty = ISC_TRUE;
+			break;
+		}
+
+		if (!buffered)
+			fflush(FILE_STREAM(channel));
+
+		/*
+		 * If the file now exceeds its maximum size
+		 * threshold, note it so that it will not be logged
+		 * to any more.
+		 */
+		if (FILE_MAXSIZE(channel) > 0) {
+			INSIST(channel->type == ISC_LOG_TOFILE);
+
+			/* XXXDCL NT fstat/fileno */
+			/* XXXDCL complain if fstat fails? */
+			if (fstat(fileno(FILE_STREAM(channel)),
+				  &statbuf) >= 0 &&
+			    statbuf.st_size > FILE_MAXSIZE(channel))
+				FILE_MAXREACHED(channel) = ISC_TRUE;
+		}
+
+		break;
+
+	case ISC_LOG_TOSYSLOG:
+		if (level > 0)
+			syslog_level = LOG_DEBUG;
+		else if (level < ISC_LOG_CRITICAL)
+			syslog_level = LOG_CRIT;
+		else
+			syslog_level = syslog_map[-level];
+
+		(void)syslog(FACILITY(channel) | syslog_level,
+		       "%s%s%s%s%s%s%s%s%s%s",
+		       printtime     ? time_string	: "",
+		       printtime     ? " "		: "",
+		       printtag      ? lcfg->tag	: "",
+		       printcolon    ? ": "		: "",
+		       printcategory ? category->name	: "",
+		       printcategory ? ": "		: "",
+		       printmodule   ? (module != NULL
+					 ? module->name
+					 : "no_module")
+							: "",
+		       printmodule   ? ": "		: "",
+		       printlevel    ? prefix->level_string : "",
+		       text);
+		break;
+
+	case ISC_LOG_TONULL:
+		break;
+
+	}
+}
+
+#ifdef USE_LOG_QUEUE
+/*
+ * Flush the file channels written to by a batch of messages.
+ *
+ * The caller must be holding the context lock.
+ */
+static void
+isc_log_flushchannel(isc_logchannel_t *channel) {
+	struct stat statbuf;
+
+	if (channel == NULL || !channel->dirty)
+		return;
+	channel->dirty = ISC_FALSE;
+
+	if (FILE_STREAM(channel) == NULL)
+		return;
+
+	if ((channel->flags & ISC_LOG_BUFFERED) == 0)
+		fflush(FILE_STREAM(channel));
 
+	if (FILE_MAXSIZE(channel) > 0) {
+		INSIST(channel->type == ISC_LOG_TOFILE);
+
+		if (fstat(fileno(FILE_STREAM(channel)), &statbuf) >= 0 &&
+		    statbuf.st_size > FILE_MAXSIZE(channel))
+			FILE_MAXREACHED(channel) = ISC_TRUE;
+	}
+}
+
+static void
+isc_log_flushchannels(isc_logconfig_t *lcfg) {
+	isc_logchannel_t *channel;
+
+	for (channel = ISC_LIST_HEAD(lcfg->channels);
+	     channel != NULL;
+	     channel = ISC_LIST_NEXT(channel, link))
+		isc_log_flushchannel(channel);
+	isc_log_flushchannel(default_channel.channel);
+}
+
+/*
+ * Write an already formatted message to every channel it should go to.
+ *
+ * The caller must be holding the context lock.
+ */
+static void
+isc_log_output(isc_log_t *lctx, isc_logcategory_t *category,
+	       isc_logmodule_t *module, int level, const isc_time_t *time,
+	       const char *text, isc_boolean_t batched)
+{
+	isc_logconfig_t *lcfg = lctx->logconfig;
+	isc_logchannellist_t *category_channels;
+	isc_logchannel_t *channel;
+	isc_logprefix_t prefix;
+	isc_boolean_t matched = ISC_FALSE;
+
+	isc_log_initprefix(&prefix, time);
+	category_channels = ISC_LIST_HEAD(lcfg->channellists[category->id]);
+	while ((channel = isc_log_nextchannel(lctx, lcfg, module, level,
+					      &category_channels,
+					      &matched)) != NULL)
+		isc_log_writechannel(lcfg, channel, category, module, level,
+				     &prefix, text, batched);
+}
+
+/*
+ * The asynchronous logging queue is a bounded multi-producer,
+ * single-consumer ring of message pointers.  Each slot carries a
+ * sequence number: a producer may fill slot 'pos & mask' when its
+ * sequence equals 'pos', and sets it to 'pos + 1' once the record
+ * pointer is in place; the writer takes the record when the sequence is
+ * 'pos + 1', and hands the slot back to the producers by setting it to
+ * 'pos + size'.  Producers claim positions with a compare-and-swap on
+ * 'tail', so logging threads never wait for each other, only (under
+ * isc_logoverflow_block) for the writer when the ring is full.
+ */
+static isc_logrecord_t *
+isc_logqueue_get(isc_logqueue_t *queue) {
+	isc_logslot_t *slot;
+	isc_logrecord_t *record;
+
+	slot = &queue->slots[queue->head & (queue->size - 1)];
+	if (isc_atomic_xadd(&slot->seq, 0) != (isc_int32_t)(queue->head + 1))
+		return (NULL);
+
+	record = slot->record;
+	slot->record = NULL;
+	(void)isc_atomic_xadd(&slot->seq, (isc_int32_t)(queue->size - 1));
+	queue->head++;
+
+	return (record);
+}
+
+static isc_boolean_t
+isc_logqueue_put(isc_logqueue_t *queue, isc_logrecord_t *record) {
+	isc_logslot_t *slot;
+	isc_int32_t pos, seq, diff;
+
+	for (;;) {
+		pos = isc_atomic_xadd(&queue->tail, 0);
+		slot = &queue->slots[(isc_uint32_t)pos & (queue->size - 1)];
+		seq = isc_atomic_xadd(&slot->seq, 0);
+		diff = (isc_int32_t)((isc_uint32_t)seq - (isc_uint32_t)pos);
+		if (diff == 0) {
+			if (isc_atomic_cmpxchg(&queue->tail, pos,
+					       (isc_int32_t)((isc_uint32_t)pos
+							     + 1)) == pos)
+				break;
+		} else if (diff < 0) {
 			/*
-			 * Check for duplicates.
+			 * The slot still holds a message from the
+			 * previous lap: the ring is full.
 			 */
-			if (write_once) {
-				isc_logmessage_t *message, *next;
-				isc_time_t oldest;
-				isc_interval_t interval;
+			return (ISC_FALSE);
+		}
+	}
 
-				isc_interval_set(&interval,
-						 lcfg->duplicate_interval, 0);
+	slot->record = record;
+	(void)isc_atomic_xadd(&slot->seq, 1);
 
-				/*
-				 * 'oldest' is the age of the oldest messages
-				 * which fall within the duplicate_interval
-				 * range.
-				 */
-				TIME_NOW(&oldest);
-				if (isc_time_subtract(&oldest, &interval,
-						      &oldest)
-				    != ISC_R_SUCCESS)
-					/*
-					 * Can't effectively do the checking
-					 * without having a valid time.
-					 */
-					message = NULL;
-				else
-					message = ISC_LIST_HEAD(lctx->messages);
-
-				while (message != NULL) {
-					if (isc_time_compare(&message->time,
-							     &oldest) < 0) {
-						/*
-						 * This message is older
-						 * than the duplicate_interval,
-						 * so it should be dropped from
-						 * the history.
-						 *
-						 * Setting the interval to be
-						 * to be longer will obviously
-						 * not cause the expired
-						 * message to spring back into
-						 * existence.
-						 */
-						next = ISC_LIST_NEXT(message,
-								     link);
-
-						ISC_LIST_UNLINK(lctx->messages,
-								message, link);
-
-						isc_mem_put(lctx->mctx,
-							message,
-							sizeof(*message) + 1 +
-							strlen(message->text));
-
-						message = next;
-						continue;
-					}
+	return (ISC_TRUE);
+}
 
-					/*
-					 * This message is in the duplicate
-					 * filtering interval ...
-					 */
-					if (strcmp(lctx->buffer, message->text)
-					    == 0) {
-						/*
-						 * ... and it is a duplicate.
-						 * Unlock the mutex and
-						 * get the hell out of Dodge.
-						 */
-						UNLOCK(&lctx->lock);
-						return;
-					}
+/*
+ * Queue 'record' for the writer thread, applying the overflow policy
+ * if the ring is full.
+ */
+static void
+isc_logqueue_send(isc_logqueue_t *queue, isc_logrecord_t *record) {
+	if (!isc_logqueue_put(queue, record)) {
+		LOCK(&queue->lock);
+		if (queue->overflow == isc_logoverflow_drop) {
+			queue->dropped++;
+			UNLOCK(&queue->lock);
+			isc_mem_put(queue->lctx->mctx, record, record->size);
+			return;
+		}
+		queue->blocked++;
+		queue->waiters++;
+		while (!isc_logqueue_put(queue, record)) {
+			SIGNAL(&queue->ready);
+			WAIT(&queue->space, &queue->lock);
+		}
+		queue->waiters--;
+		UNLOCK(&queue->lock);
+	}
 
-					message = ISC_LIST_NEXT(message, link);
-				}
+	/*
+	 * The writer sets 'idle' before checking for work one last time,
+	 * and we check it after making the record visible, so one of us
+	 * is bound to notice the other.
+	 */
+	if (isc_atomic_xadd(&queue->idle, 0) != 0) {
+		LOCK(&queue->lock);
+		SIGNAL(&queue->ready);
+		UNLOCK(&queue->lock);
+	}
+}
 
-				/*
-				 * It wasn't in the duplicate interval,
-				 * so add it to the message list.
-				 */
-				message = isc_mem_get(lctx->mctx,
-						    sizeof(isc_logmessage_t) +
-						    strlen(lctx->buffer) + 1);
-				if (message != NULL) {
-					/*
-					 * Put the text immediately after
-					 * the struct.  The strcpy is safe.
-					 */
-					message->text = (char *)(message + 1);
-					strcpy(message->text, lctx->buffer);
-
-					TIME_NOW(&message->time);
-
-					ISC_LINK_INIT(message, link);
-					ISC_LIST_APPEND(lctx->messages,
-							message, link);
-				}
+/*
+ * Wait until everything queued so far has been written.
+ */
+static void
+isc_logqueue_flush(isc_logqueue_t *queue) {
+	isc_uint32_t target;
+
+	LOCK(&queue->lock);
+	target = (isc_uint32_t)isc_atomic_xadd(&queue->tail, 0);
+	queue->waiters++;
+	while ((isc_int32_t)(target - queue->written) > 0) {
+		SIGNAL(&queue->ready);
+		WAIT(&queue->space, &queue->lock);
+	}
+	queue->waiters--;
+	UNLOCK(&queue->lock);
+}
+
+static isc_threadresult_t
+#ifdef _WIN32
+WINAPI
+#endif
+isc_logqueue_run(void *arg) {
+	isc_logqueue_t *queue = arg;
+	isc_log_t *lctx = queue->lctx;
+	isc_logrecord_t *record;
+	isc_uint64_t dropped;
+	isc_time_t when;
+	isc_interval_t interval;
+	unsigned int n;
+	char text[128];
+
+	isc_interval_set(&interval, 1, 0);
+
+	for (;;) {
+		LOCK(&queue->lock);
+		dropped = queue->dropped - queue->reported;
+		queue->reported = queue->dropped;
+		UNLOCK(&queue->lock);
+
+		n = 0;
+		LOCK(&lctx->lock);
+		while (n < LOG_BATCH_SIZE &&
+		       (record = isc_logqueue_get(queue)) != NULL)
+		{
+			isc_log_output(lctx, record->category, record->module,
+				       record->level, &record->time,
+				       record->text, ISC_TRUE);
+			isc_mem_put(lctx->mctx, record, record->size);
+			n++;
+		}
+		if (dropped != 0) {
+			snprintf(text, sizeof(text),
+				 "%" ISC_PRINT_QUADFORMAT "u log messages "
+				 "dropped: logging queue full", dropped);
+			isc_log_output(lctx, ISC_LOGCATEGORY_GENERAL,
+				       ISC_LOGMODULE_OTHER, ISC_LOG_WARNING,
+				       NULL, text, ISC_TRUE);
+		}
+		if (n != 0 || dropped != 0)
+			isc_log_flushchannels(lctx->logconfig);
+		UNLOCK(&lctx->lock);
+
+		LOCK(&queue->lock);
+		queue->written += n;
+		if (queue->waiters > 0)
+			BROADCAST(&queue->space);
+		if (n == 0) {
+			if (queue->shutdown) {
+				UNLOCK(&queue->lock);
+				break;
+			}
+			(void)isc_atomic_xadd(&queue->idle, 1);
+			if (isc_atomic_xadd(&queue->slots[queue->head &
+						  (queue->size - 1)].seq,
+					    0) !=
+			    (isc_int32_t)(queue->head + 1))
+			{
+				TIME_NOW(&when);
+				if (isc_time_add(&when, &interval,
+						 &when) == ISC_R_SUCCESS)
+					(void)WAITUNTIL(&queue->ready,
+							&queue->lock, &when);
+				else
+					WAIT(&queue->ready, &queue->lock);
 			}
+			(void)isc_atomic_xadd(&queue->idle, -1);
 		}
+		UNLOCK(&queue->lock);
+	}
 
-		utc	      = ISC_TF((channel->flags & ISC_LOG_UTC) != 0);
-		iso8601       = ISC_TF((channel->flags & ISC_LOG_ISO8601) != 0);
-		printtime     = ISC_TF((channel->flags & ISC_LOG_PRINTTIME)
-				       != 0);
-		printtag      = ISC_TF((channel->flags &
-					(ISC_LOG_PRINTTAG|ISC_LOG_PRINTPREFIX))
-				       != 0 && lcfg->tag != NULL);
-		printcolon    = ISC_TF((channel->flags & ISC_LOG_PRINTTAG)
-				       != 0 && lcfg->tag != NULL);
-		printcategory = ISC_TF((channel->flags & ISC_LOG_PRINTCATEGORY)
-				       != 0);
-		printmodule   = ISC_TF((channel->flags & ISC_LOG_PRINTMODULE)
-				       != 0);
-		printlevel    = ISC_TF((channel->flags & ISC_LOG_PRINTLEVEL)
-				       != 0);
-		buffered      = ISC_TF((channel->flags & ISC_LOG_BUFFERED)
-				       != 0);
-
-		if (printtime) {
-			if (iso8601) {
-				if (utc) {
-					time_string = iso8601z_string;
-				} else {
-					time_string = iso8601l_string;
-				}
-			} else {
-				time_string = local_time;
-			}
-		} else
-			time_string = "";
+	return ((isc_threadresult_t)0);
+}
 
-		switch (channel->type) {
-		case ISC_LOG_TOFILE:
-			if (FILE_MAXREACHED(channel)) {
-				/*
-				 * If the file can be rolled, OR
-				 * If the file no longer exists, OR
-				 * If the file is less than the maximum size,
-				 *    (such as if it had been renamed and
-				 *     a new one touched, or it was truncated
-				 *     in place)
-				 * ... then close it to trigger reopening.
-				 */
-				if (FILE_VERSIONS(channel) !=
-				    ISC_LOG_ROLLNEVER ||
-				    (stat(FILE_NAME(channel), &statbuf) != 0 &&
-				     errno == ENOENT) ||
-				    statbuf.st_size < FILE_MAXSIZE(channel)) {
-					(void)fclose(FILE_STREAM(channel));
-					FILE_STREAM(channel) = NULL;
-					FILE_MAXREACHED(channel) = ISC_FALSE;
-				} else
-					/*
-					 * Eh, skip it.
-					 */
-					break;
-			}
+static isc_result_t
+isc_logqueue_create(isc_log_t *lctx, unsigned int size,
+		    isc_logoverflow_t overflow, isc_logqueue_t **queuep)
+{
+	isc_logqueue_t *queue;
+	isc_result_t result;
+	unsigned int i;
 
-			if (FILE_STREAM(channel) == NULL) {
-				result = isc_log_open(channel);
-				if (result != ISC_R_SUCCESS &&
-				    result != ISC_R_MAXSIZE &&
-				    (channel->flags & ISC_LOG_OPENERR) == 0) {
-					syslog(LOG_ERR,
-					       "isc_log_open '%s' failed: %s",
-					       FILE_NAME(channel),
-					       isc_result_totext(result));
-					channel->flags |= ISC_LOG_OPENERR;
-				}
-				if (result != ISC_R_SUCCESS)
-					break;
-				channel->flags &= ~ISC_LOG_OPENERR;
-			}
-			/* FALLTHROUGH */
-
-		case ISC_LOG_TOFILEDESC:
-			fprintf(FILE_STREAM(channel),
-				"%s%s%s%s%s%s%s%s%s%s\n",
-				printtime     ? time_string	: "",
-				printtime     ? " "		: "",
-				printtag      ? lcfg->tag	: "",
-				printcolon    ? ": "		: "",
-				printcategory ? category->name	: "",
-				printcategory ? ": "		: "",
-				printmodule   ? (module != NULL ? module->name
-								: "no_module")
-								: "",
-				printmodule   ? ": "		: "",
-				printlevel    ? level_string	: "",
-				lctx->buffer);
-
-			if (!buffered)
-				fflush(FILE_STREAM(channel));
+	queue = isc_mem_get(lctx->mctx, sizeof(*queue));
+	if (queue == NULL)
+		return (ISC_R_NOMEMORY);
 
-			/*
-			 * If the file now exceeds its maximum size
-			 * threshold, note it so that it will not be logged
-			 * to any more.
-			 */
-			if (FILE_MAXSIZE(channel) > 0) {
-				INSIST(channel->type == ISC_LOG_TOFILE);
-
-				/* XXXDCL NT fstat/fileno */
-				/* XXXDCL complain if fstat fails? */
-				if (fstat(fileno(FILE_STREAM(channel)),
-					  &statbuf) >= 0 &&
-				    statbuf.st_size > FILE_MAXSIZE(channel))
-					FILE_MAXREACHED(channel) = ISC_TRUE;
-			}
+	queue->size = 1;
+	while (queue->size < size && queue->size < LOG_QUEUE_MAXSIZE)
+		queue->size <<= 1;
+	queue->slots = isc_mem_get(lctx->mctx,
+				   queue->size * sizeof(isc_logslot_t));
+	if (queue->slots == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_queue;
+	}
+	for (i = 0; i < queue->size; i++) {
+		queue->slots[i].seq = (isc_int32_t)i;
+		queue->slots[i].record = NULL;
+	}
 
-			break;
+	queue->lctx = lctx;
+	queue->enabled = ISC_FALSE;
+	queue->overflow = overflow;
+	queue->tail = 0;
+	queue->head = 0;
+	queue->written = 0;
+	queue->idle = 0;
+	queue->waiters = 0;
+	queue->shutdown = ISC_FALSE;
+	queue->dropped = 0;
+	queue->reported = 0;
+	queue->blocked = 0;
+
+	result = isc_mutex_init(&queue->lock);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_slots;
+	result = isc_condition_init(&queue->ready);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_lock;
+	result = isc_condition_init(&queue->space);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_ready;
+	result = isc_thread_create(isc_logqueue_run, queue, &queue->thread);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_space;
+	isc_thread_setname(queue->thread, "isc-log");
 
-		case ISC_LOG_TOSYSLOG:
-			if (level > 0)
-				syslog_level = LOG_DEBUG;
-			else if (level < ISC_LOG_CRITICAL)
-				syslog_level = LOG_CRIT;
-			else
-				syslog_level = syslog_map[-level];
-
-			(void)syslog(FACILITY(channel) | syslog_level,
-			       "%s%s%s%s%s%s%s%s%s%s",
-			       printtime     ? time_string	: "",
-			       printtime     ? " "		: "",
-			       printtag      ? lcfg->tag	: "",
-			       printcolon    ? ": "		: "",
-			       printcategory ? category->name	: "",
-			       printcategory ? ": "		: "",
-			       printmodule   ? (module != NULL
-						 ? module->name
-						 : "no_module")
-								: "",
-			       printmodule   ? ": "		: "",
-			       printlevel    ? level_string	: "",
-			       lctx->buffer);
-			break;
+	*queuep = queue;
+	return (ISC_R_SUCCESS);
 
-		case ISC_LOG_TONULL:
-			break;
+ cleanup_space:
+	(void)isc_condition_destroy(&queue->space);
+ cleanup_ready:
+	(void)isc_condition_destroy(&queue->ready);
+ cleanup_lock:
+	DESTROYLOCK(&queue->lock);
+ cleanup_slots:
+	isc_mem_put(lctx->mctx, queue->slots,
+		    queue->size * sizeof(isc_logslot_t));
+ cleanup_queue:
+	isc_mem_put(lctx->mctx, queue, sizeof(*queue));
+	return (result);
+}
+
+/*
+ * Write out whatever is still queued, stop the writer thread and free
+ * the queue.
+ */
+static void
+isc_logqueue_destroy(isc_logqueue_t **queuep) {
+	isc_logqueue_t *queue = *queuep;
+	isc_mem_t *mctx = queue->lctx->mctx;
+
+	LOCK(&queue->lock);
+	queue->enabled = ISC_FALSE;
+	queue->shutdown = ISC_TRUE;
+	SIGNAL(&queue->ready);
+	UNLOCK(&queue->lock);
+
+	(void)isc_thread_join(queue->thread, NULL);
+
+	INSIST(isc_logqueue_get(queue) == NULL);
+
+	(void)isc_condition_destroy(&queue->space);
+	(void)isc_condition_destroy(&queue->ready);
+	DESTROYLOCK(&queue->lock);
+	isc_mem_put(mctx, queue->slots, queue->size * sizeof(isc_logslot_t));
+	isc_mem_put(mctx, queue, sizeof(*queue));
+
+	*queuep = NULL;
+}
 
+/*
+ * Format the message on the calling thread and queue it for the writer.
+ */
+static void
+isc_log_enqueue(isc_log_t *lctx, isc_logqueue_t *queue,
+		isc_logcategory_t *category, isc_logmodule_t *module,
+		int level, isc_boolean_t write_once,
+		const char *format, va_list args)
+{
+	isc_logrecord_t *record;
+	char text[LOG_BUFFER_SIZE];
+	size_t length;
+
+	(void)vsnprintf(text, sizeof(text), format, args);
+
+	if (write_once) {
+		isc_boolean_t duplicate;
+
+		LOCK(&lctx->lock);
+		duplicate = isc_log_duplicate(lctx, lctx->logconfig, text);
+		UNLOCK(&lctx->lock);
+		if (duplicate)
+			return;
+	}
+
+	length = strlen(text);
+	record = isc_mem_get(lctx->mctx, sizeof(*record) + length + 1);
+	if (record == NULL) {
+		/*
+		 * Write it here and now rather than lose it.
+		 */
+		LOCK(&lctx->lock);
+		isc_log_output(lctx, category, module, level, NULL, text,
+			       ISC_FALSE);
+		UNLOCK(&lctx->lock);
+		return;
+	}
+
+	record->category = category;
+	record->module = module;
+	record->level = level;
+	record->size = sizeof(*record) + length + 1;
+	record->text = (char *)(record + 1);
+	memmove(record->text, text, length + 1);
+	TIME_NOW(&record->time);
+
+	isc_logqueue_send(queue, record);
+}
+#endif /* USE_LOG_QUEUE */
+
+isc_result_t
+isc_log_setasync(isc_log_t *lctx, unsigned int size,
+		 isc_logoverflow_t overflow)
+{
+#ifdef USE_LOG_QUEUE
+	isc_logqueue_t *queue;
+	isc_result_t result;
+
+	REQUIRE(VALID_CONTEXT(lctx));
+	REQUIRE(overflow == isc_logoverflow_block ||
+		overflow == isc_logoverflow_drop);
+
+	queue = lctx->queue;
+	if (size == 0) {
+		if (queue != NULL) {
+			LOCK(&queue->lock);
+			queue->enabled = ISC_FALSE;
+			UNLOCK(&queue->lock);
+			isc_logqueue_flush(queue);
 		}
+		return (ISC_R_SUCCESS);
+	}
 
-	} while (1);
+	if (queue == NULL) {
+		result = isc_logqueue_create(lctx, size, overflow, &queue);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+		LOCK(&lctx->lock);
+		lctx->queue = queue;
+		UNLOCK(&lctx->lock);
+	}
+
+	LOCK(&queue->lock);
+	queue->overflow = overflow;
+	queue->enabled = ISC_TRUE;
+	UNLOCK(&queue->lock);
+
+	return (ISC_R_SUCCESS);
+#else
+	REQUIRE(VALID_CONTEXT(lctx));
+	UNUSED(overflow);
+
+	return (size == 0 ? ISC_R_SUCCESS : ISC_R_NOTIMPLEMENTED);
+#endif /* USE_LOG_QUEUE */
+}
+
+void
+isc_log_getqueuestats(isc_log_t *lctx, isc_uint64_t *droppedp,
+		      isc_uint64_t *blockedp)
+{
+	REQUIRE(VALID_CONTEXT(lctx));
+	REQUIRE(droppedp != NULL);
+	REQUIRE(blockedp != NULL);
+
+	*droppedp = 0;
+	*blockedp = 0;
+#ifdef USE_LOG_QUEUE
+	if (lctx->queue != NULL) {
+		LOCK(&lctx->queue->lock);
+		*droppedp = lctx->queue->dropped;
+		*blockedp = lctx->queue->blocked;
+		UNLOCK(&lctx->queue->lock);
+	}
+#endif
+}
+
+static void
+isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
+	     isc_logmodule_t *module, int level, isc_boolean_t write_once,
+	     isc_msgcat_t *msgcat, int msgset, int msg,
+	     const char *format, va_list args)
+{
+	const char *iformat;
+	isc_boolean_t matched = ISC_FALSE, formatted = ISC_FALSE;
+	isc_logconfig_t *lcfg;
+	isc_logchannel_t *channel;
+	isc_logchannellist_t *category_channels;
+	isc_logprefix_t prefix;
+#ifdef USE_LOG_QUEUE
+	isc_logqueue_t *queue;
+#endif
+
+	REQUIRE(lctx == NULL || VALID_CONTEXT(lctx));
+	REQUIRE(category != NULL);
+	REQUIRE(module != NULL);
+	REQUIRE(level != ISC_LOG_DYNAMIC);
+	REQUIRE(format != NULL);
+
+	/*
+	 * Programs can use libraries that use this logging code without
+	 * wanting to do any logging, thus the log context is allowed to
+	 * be non-existent.
+	 */
+	if (lctx == NULL)
+		return;
+
+	REQUIRE(category->id < lctx->category_count);
+	REQUIRE(module->id < lctx->module_count);
+
+	if (! isc_log_wouldlog(lctx, level))
+		return;
+
+	if (msgcat != NULL)
+		iformat = isc_msgcat_get(msgcat, msgset, msg, format);
+	else
+		iformat = format;
+
+#ifdef USE_LOG_QUEUE
+	/*
+	 * As in isc_log_wouldlog(), the queue is looked at without
+	 * locking; it is never freed before the context is destroyed.
+	 *
+	 * Critical messages are written directly, after everything
+	 * queued before them, because the program may be about to exit.
+	 */
+	queue = lctx->queue;
+	if (queue != NULL && queue->enabled) {
+		if (level > ISC_LOG_CRITICAL) {
+			isc_log_enqueue(lctx, queue, category, module, level,
+					write_once, iformat, args);
+			return;
+		}
+		isc_logqueue_flush(queue);
+	}
+#endif /* USE_LOG_QUEUE */
+
+	isc_log_initprefix(&prefix, NULL);
+
+	LOCK(&lctx->lock);
+
+	lctx->buffer[0] = '\0';
+
+	lcfg = lctx->logconfig;
+
+	category_channels = ISC_LIST_HEAD(lcfg->channellists[category->id]);
+
+	while ((channel = isc_log_nextchannel(lctx, lcfg, module, level,
+					      &category_channels,
+					      &matched)) != NULL)
+	{
+		/*
+		 * Only format the message once.
+		 */
+		if (!formatted) {
+			(void)vsnprintf(lctx->buffer, sizeof(lctx->buffer),
+					iformat, args);
+			formatted = ISC_TRUE;
+
+			/*
+			 * Check for duplicates.
+			 */
+			if (write_once &&
+			    isc_log_duplicate(lctx, lcfg, lctx->buffer))
+			{
+				/*
+				 * Unlock the mutex and
+				 * get the hell out of Dodge.
+				 */
+				break;
+			}
+		}
+
+		isc_log_writechannel(lcfg, channel, category, module, level,
+				     &prefix, lctx->buffer, ISC_FALSE);
+	}
 
 	UNLOCK(&lctx->lock);
 }
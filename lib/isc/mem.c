@@ -15,7 +15,11 @@
 #include <stddef.h>
 
 #include <limits.h>
+#ifdef HAVE_INTTYPES_H
+#include <inttypes.h> /* uintptr_t */
+#endif
 
+#include <isc/atomic.h>
 #include <isc/bind9.h>
 #include <isc/json.h>
 #include <isc/magic.h>
@@ -23,9 +27,12 @@
 #include <isc/msgs.h>
 #include <isc/once.h>
 #include <isc/ondestroy.h>
+#include <isc/os.h>
+#include <isc/platform.h>
 #include <isc/string.h>
 #include <isc/mutex.h>
 #include <isc/print.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 #include <isc/xml.h>
 
@@ -49,6 +56,36 @@ LIBISC_EXTERNAL_DATA unsigned int isc_mem_defaultflags = ISC_MEMFLAG_DEFAULT;
 #define TABLE_INCREMENT		1024
 #define DEBUGLIST_COUNT		1024
 
+/*%
+ * With threads, internal contexts keep per-thread caches ("magazines")
+ * of free blocks for each quantized size, so that most isc_mem_get()
+ * and isc_mem_put() calls take an uncontended shard lock instead of the
+ * context lock.  Magazines are refilled from and drained to the
+ * context's free lists, which act as the depot, half a magazine at a
+ * time.  A magazine holds at most MAGAZINE_BYTES, and between
+ * MAGAZINE_MINROUNDS and MAGAZINE_MAXROUNDS blocks.
+ *
+ * While the context is over its high water mark, blocks are not kept
+ * in the magazines: a put sends the whole magazine back to the free
+ * lists and a get takes a single block, so that memory freed to relieve
+ * the pressure is seen as free at once.
+ *
+ * Threads are given shards round robin the first time they use a
+ * context, so threads beyond the number of shards share a shard.
+ * The number of shards is that of the CPUs, rounded up to a power
+ * of two, but no more than MAXSHARDS.
+ */
+#if defined(ISC_PLATFORM_USETHREADS) && defined(ISC_PLATFORM_HAVEXADD)
+#define ISC_MEM_MAGAZINES	1
+#else
+#define ISC_MEM_MAGAZINES	0
+#endif
+
+#define MAXSHARDS		16
+#define MAGAZINE_BYTES		4096
+#define MAGAZINE_MINROUNDS	4U
+#define MAGAZINE_MAXROUNDS	32U
+
 /*
  * Types.
  */
@@ -96,6 +133,19 @@ struct stats {
 	unsigned long		freefrags;
 };
 
+#if ISC_MEM_MAGAZINES
+typedef struct magazine {
+	element *		rounds;
+	unsigned int		count;
+	unsigned long		totalgets;	/*%< not yet in stats[] */
+} magazine_t;
+
+typedef struct memshard {
+	isc_mutex_t		lock;
+	magazine_t *		magazines;	/*%< indexed by size class */
+} memshard_t;
+#endif
+
 #define MEM_MAGIC		ISC_MAGIC('M', 'e', 'm', 'C')
 #define VALID_CONTEXT(c)	ISC_MAGIC_VALID(c, MEM_MAGIC)
 
@@ -117,6 +167,13 @@ static isc_mutex_t 		createlock;
  */
 static isc_uint64_t		totallost;
 
+#if ISC_MEM_MAGAZINES
+static isc_once_t		shard_once = ISC_ONCE_INIT;
+static isc_thread_key_t		shard_key;
+static unsigned int		shard_count = 1;
+static isc_int32_t		shard_next = 0;
+#endif
+
 struct isc__mem {
 	isc_mem_t		common;
 	isc_ondestroy_t		ondestroy;
@@ -155,6 +212,10 @@ struct isc__mem {
 	unsigned int		basic_table_size;
 	unsigned char *		lowest;
 	unsigned char *		highest;
+#if ISC_MEM_MAGAZINES
+	memshard_t **		shards;
+	unsigned int		nshards;
+#endif
 
 #if ISC_MEM_TRACKLINES
 	debuglist_t *	 	debuglist;
@@ -786,6 +847,315 @@ mem_putunlocked(isc__mem_t *ctx, void *mem, size_t size) {
 	ctx->inuse -= new_size;
 }
 
+#if ISC_MEM_MAGAZINES
+static void
+shard_initialize(void) {
+	unsigned int ncpus = isc_os_ncpus();
+
+	if (isc_thread_key_create(&shard_key, NULL) != 0)
+		return;
+
+	while (shard_count < ncpus && shard_count < MAXSHARDS)
+		shard_count <<= 1;
+}
+
+#if ISC_MEM_TRACKLINES
+#define USE_MAGAZINE(ctx, size) \
+	((ctx)->shards != NULL && quantize(size) < (ctx)->max_size && \
+	 (isc_mem_debugging & TRACE_OR_RECORD) == 0)
+#else
+#define USE_MAGAZINE(ctx, size) \
+	((ctx)->shards != NULL && quantize(size) < (ctx)->max_size)
+#endif
+
+#define NO_WATER	(-1)
+
+static inline unsigned int
+magazine_rounds(size_t new_size) {
+	size_t rounds = MAGAZINE_BYTES / new_size;
+
+	if (rounds < MAGAZINE_MINROUNDS)
+		return (MAGAZINE_MINROUNDS);
+	if (rounds > MAGAZINE_MAXROUNDS)
+		return (MAGAZINE_MAXROUNDS);
+	return ((unsigned int)rounds);
+}
+
+/*
+ * Find the shard of the calling thread, creating it on first use.
+ * Returns NULL if the shard could not be created.
+ */
+static memshard_t *
+getshard(isc__mem_t *ctx) {
+	memshard_t *shard;
+	uintptr_t id;
+	unsigned int i;
+	size_t nclasses, size;
+
+	id = (uintptr_t) isc_thread_key_getspecific(shard_key);
+	if (ISC_UNLIKELY(id == 0)) {
+		id = (uintptr_t) isc_atomic_xadd(&shard_next, 1) + 1;
+		(void)isc_thread_key_setspecific(shard_key, (void *) id);
+	}
+	i = (unsigned int)((id - 1) & (ctx->nshards - 1));
+
+	shard = ctx->shards[i];
+	if (ISC_LIKELY(shard != NULL))
+		return (shard);
+
+	nclasses = ctx->max_size / ALIGNMENT_SIZE + 1;
+	size = sizeof(*shard) + nclasses * sizeof(magazine_t);
+
+	LOCK(&ctx->lock);
+	shard = ctx->shards[i];
+	if (shard == NULL) {
+		shard = (ctx->memalloc)(ctx->arg, size);
+		if (shard == NULL) {
+			ctx->memalloc_failures++;
+		} else if (isc_mutex_init(&shard->lock) != ISC_R_SUCCESS) {
+			(ctx->memfree)(ctx->arg, shard);
+			shard = NULL;
+		} else {
+			shard->magazines = (magazine_t *)(shard + 1);
+			memset(shard->magazines, 0,
+			       nclasses * sizeof(magazine_t));
+			ctx->malloced += size;
+			if (ctx->malloced > ctx->maxmalloced)
+				ctx->maxmalloced = ctx->malloced;
+			ctx->shards[i] = shard;
+		}
+	}
+	UNLOCK(&ctx->lock);
+
+	return (shard);
+}
+
+/*
+ * Check the water marks after 'inuse' has grown or shrunk, and return
+ * the one to signal, if any.
+ *
+ * Requires: we hold the context lock.
+ */
+static inline int
+magazine_hiwater(isc__mem_t *ctx) {
+	if (ctx->inuse > ctx->maxinuse)
+		ctx->maxinuse = ctx->inuse;
+	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water) {
+		ctx->is_overmem = ISC_TRUE;
+		if (!ctx->hi_called)
+			return (ISC_MEM_HIWATER);
+	}
+	return (NO_WATER);
+}
+
+static inline int
+magazine_lowater(isc__mem_t *ctx) {
+	if (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U) {
+		ctx->is_overmem = ISC_FALSE;
+		if (ctx->hi_called)
+			return (ISC_MEM_LOWATER);
+	}
+	return (NO_WATER);
+}
+
+/*
+ * Blocks held by a magazine are accounted as in use by the context,
+ * both in 'inuse' and in the stats[] of their quantized size, so the
+ * accounting only changes when blocks move between a magazine and the
+ * free lists, under the context lock.  'inuse' thus overstates the
+ * memory really in use by what the magazines hold, which is bounded.
+ */
+static inline void
+magazine_fold(isc__mem_t *ctx, magazine_t *mag, size_t new_size) {
+	ctx->stats[new_size].totalgets += mag->totalgets;
+	mag->totalgets = 0;
+}
+
+/*
+ * Refill 'mag' with half a magazine of 'new_size' blocks from the free
+ * lists, or with a single block if the context is over its high water
+ * mark.  Returns the water mark to signal, if any.
+ *
+ * Requires: we hold the context lock.
+ */
+static int
+magazine_fill(isc__mem_t *ctx, magazine_t *mag, size_t new_size) {
+	unsigned int want = magazine_rounds(new_size) / 2;
+	element *e;
+
+	if (ctx->is_overmem)
+		want = 1;
+
+	while (mag->count < want) {
+		if (ctx->freelists[new_size] == NULL &&
+		    !more_frags(ctx, new_size))
+			break;
+		e = ctx->freelists[new_size];
+		ctx->freelists[new_size] = e->next;
+		e->next = mag->rounds;
+		mag->rounds = e;
+		mag->count++;
+		ctx->stats[new_size].gets++;
+		ctx->stats[new_size].freefrags--;
+		ctx->inuse += new_size;
+	}
+	magazine_fold(ctx, mag, new_size);
+
+	return (magazine_hiwater(ctx));
+}
+
+/*
+ * Return all but 'keep' blocks from 'mag' to the free lists.
+ * Returns the water mark to signal, if any.
+ *
+ * Requires: we hold the context lock.
+ */
+static int
+magazine_drain(isc__mem_t *ctx, magazine_t *mag, size_t new_size,
+	       unsigned int keep)
+{
+	element *e;
+
+	while (mag->count > keep) {
+		e = mag->rounds;
+		mag->rounds = e->next;
+		mag->count--;
+		e->next = ctx->freelists[new_size];
+		ctx->freelists[new_size] = e;
+		INSIST(ctx->stats[new_size].gets != 0U);
+		ctx->stats[new_size].gets--;
+		ctx->stats[new_size].freefrags++;
+		ctx->inuse -= new_size;
+	}
+	magazine_fold(ctx, mag, new_size);
+
+	return (magazine_lowater(ctx));
+}
+
+static inline void *
+magazine_get(isc__mem_t *ctx, size_t size, int *waterp) {
+	size_t new_size = quantize(size);
+	memshard_t *shard;
+	magazine_t *mag;
+	element *ret;
+
+	*waterp = NO_WATER;
+
+	shard = getshard(ctx);
+	if (shard == NULL) {
+		/*
+		 * Account the block under its quantized size, as the
+		 * magazines do, whichever way it is returned.
+		 */
+		LOCK(&ctx->lock);
+		ret = mem_getunlocked(ctx, new_size);
+		*waterp = magazine_hiwater(ctx);
+		UNLOCK(&ctx->lock);
+		return (ret);
+	}
+
+	LOCK(&shard->lock);
+	mag = &shard->magazines[new_size / ALIGNMENT_SIZE];
+	if (mag->count == 0) {
+		LOCK(&ctx->lock);
+		*waterp = magazine_fill(ctx, mag, new_size);
+		UNLOCK(&ctx->lock);
+		if (mag->count == 0) {
+			UNLOCK(&shard->lock);
+			return (NULL);
+		}
+	}
+	ret = mag->rounds;
+	mag->rounds = ret->next;
+	mag->count--;
+	mag->totalgets++;
+	UNLOCK(&shard->lock);
+
+#if ISC_MEM_FILL
+	memset(ret, 0xbe, new_size); /* Mnemonic for "beef". */
+#endif
+
+	return (ret);
+}
+
+/* coverity[+free : arg-1] */
+static inline int
+magazine_put(isc__mem_t *ctx, void *mem, size_t size) {
+	size_t new_size = quantize(size);
+	unsigned int rounds;
+	memshard_t *shard;
+	magazine_t *mag;
+	int water = NO_WATER;
+
+#if ISC_MEM_FILL
+#if ISC_MEM_CHECKOVERRUN
+	check_overrun(mem, size, new_size);
+#endif
+	memset(mem, 0xde, new_size); /* Mnemonic for "dead". */
+#endif
+
+	shard = getshard(ctx);
+	if (shard == NULL) {
+		LOCK(&ctx->lock);
+		mem_putunlocked(ctx, mem, new_size);
+		water = magazine_lowater(ctx);
+		UNLOCK(&ctx->lock);
+		return (water);
+	}
+
+	rounds = magazine_rounds(new_size);
+
+	LOCK(&shard->lock);
+	mag = &shard->magazines[new_size / ALIGNMENT_SIZE];
+	((element *)mem)->next = mag->rounds;
+	mag->rounds = mem;
+	mag->count++;
+	/*
+	 * is_overmem is read without the context lock, as in
+	 * isc_mem_isovermem(); at worst a magazine is drained late.
+	 */
+	if (mag->count > rounds || ctx->is_overmem) {
+		LOCK(&ctx->lock);
+		water = magazine_drain(ctx, mag, new_size,
+				       ctx->is_overmem ? 0 : rounds / 2);
+		UNLOCK(&ctx->lock);
+	}
+	UNLOCK(&shard->lock);
+
+	return (water);
+}
+
+/*
+ * Return the blocks held by every shard to the free lists, and free
+ * the shards.
+ *
+ * Requires: no other reference to the context.
+ */
+static void
+destroy_shards(isc__mem_t *ctx) {
+	memshard_t *shard;
+	size_t nclasses, i;
+	unsigned int n;
+
+	nclasses = ctx->max_size / ALIGNMENT_SIZE + 1;
+	for (n = 0; n < ctx->nshards; n++) {
+		shard = ctx->shards[n];
+		if (shard == NULL)
+			continue;
+		for (i = 1; i < nclasses; i++)
+			(void)magazine_drain(ctx, &shard->magazines[i],
+					     i * ALIGNMENT_SIZE, 0);
+		DESTROYLOCK(&shard->lock);
+		(ctx->memfree)(ctx->arg, shard);
+		ctx->malloced -= sizeof(*shard) +
+				 nclasses * sizeof(magazine_t);
+	}
+	(ctx->memfree)(ctx->arg, ctx->shards);
+	ctx->malloced -= ctx->nshards * sizeof(memshard_t *);
+	ctx->shards = NULL;
+}
+#endif /* ISC_MEM_MAGAZINES */
+
 /*!
  * Perform a malloc, doing memory filling and overrun detection as necessary.
  */
@@ -987,6 +1357,10 @@ isc_mem_createx2(size_t init_max_size, size_t target_size,
 	ctx->basic_table_size = 0;
 	ctx->lowest = NULL;
 	ctx->highest = NULL;
+#if ISC_MEM_MAGAZINES
+	ctx->shards = NULL;
+	ctx->nshards = 0;
+#endif
 
 	ctx->stats = (memalloc)(arg,
 				(ctx->max_size+1) * sizeof(struct stats));
@@ -1015,6 +1389,29 @@ isc_mem_createx2(size_t init_max_size, size_t target_size,
 		ctx->maxmalloced += ctx->max_size * sizeof(element *);
 	}
 
+#if ISC_MEM_MAGAZINES
+	if ((flags & (ISC_MEMFLAG_INTERNAL|ISC_MEMFLAG_NOLOCK)) ==
+	    ISC_MEMFLAG_INTERNAL)
+	{
+		RUNTIME_CHECK(isc_once_do(&shard_once, shard_initialize)
+			      == ISC_R_SUCCESS);
+		if (shard_count > 1) {
+			ctx->shards = (memalloc)(arg, shard_count *
+							sizeof(memshard_t *));
+			if (ctx->shards == NULL) {
+				result = ISC_R_NOMEMORY;
+				goto error;
+			}
+			memset(ctx->shards, 0,
+			       shard_count * sizeof(memshard_t *));
+			ctx->nshards = shard_count;
+			ctx->malloced += shard_count * sizeof(memshard_t *);
+			ctx->maxmalloced +=
+				shard_count * sizeof(memshard_t *);
+		}
+	}
+#endif
+
 #if ISC_MEM_TRACKLINES
 	if ((isc_mem_debugging & ISC_MEM_DEBUGRECORD) != 0) {
 		unsigned int i;
@@ -1047,6 +1444,10 @@ isc_mem_createx2(size_t init_max_size, size_t target_size,
 			(memfree)(arg, ctx->stats);
 		if (ctx->freelists != NULL)
 			(memfree)(arg, ctx->freelists);
+#if ISC_MEM_MAGAZINES
+		if (ctx->shards != NULL)
+			(memfree)(arg, ctx->shards);
+#endif
 #if ISC_MEM_TRACKLINES
 		if (ctx->debuglist != NULL)
 			(ctx->memfree)(ctx->arg, ctx->debuglist);
@@ -1064,6 +1465,11 @@ destroy(isc__mem_t *ctx) {
 	unsigned int i;
 	isc_ondestroy_t ondest;
 
+#if ISC_MEM_MAGAZINES
+	if (ctx->shards != NULL)
+		destroy_shards(ctx);
+#endif
+
 	LOCK(&contextslock);
 	ISC_LIST_UNLINK(contexts, ctx, link);
 	totallost += ctx->inuse;
@@ -1231,6 +1637,23 @@ isc___mem_putanddetach(isc_mem_t **ctxp, void *ptr, size_t size FLARG) {
 		return;
 	}
 
+#if ISC_MEM_MAGAZINES
+	if (USE_MAGAZINE(ctx, size)) {
+		(void)magazine_put(ctx, ptr, size);
+
+		LOCK(&ctx->lock);
+		INSIST(ctx->references > 0);
+		ctx->references--;
+		if (ctx->references == 0)
+			want_destroy = ISC_TRUE;
+		UNLOCK(&ctx->lock);
+		if (want_destroy)
+			destroy(ctx);
+
+		return;
+	}
+#endif
+
 	MCTXLOCK(ctx, &ctx->lock);
 
 	DELETE_TRACE(ctx, ptr, size, file, line);
@@ -1303,6 +1726,17 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 	if ((isc_mem_debugging & (ISC_MEM_DEBUGSIZE|ISC_MEM_DEBUGCTX)) != 0)
 		return (isc__mem_allocate(ctx0, size FLARG_PASS));
 
+#if ISC_MEM_MAGAZINES
+	if (USE_MAGAZINE(ctx, size)) {
+		int water;
+
+		ptr = magazine_get(ctx, size, &water);
+		if (water != NO_WATER && ctx->water != NULL)
+			(ctx->water)(ctx->water_arg, water);
+		return (ptr);
+	}
+#endif
+
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
 		MCTXLOCK(ctx, &ctx->lock);
 		ptr = mem_getunlocked(ctx, size);
@@ -1356,6 +1790,17 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 		return;
 	}
 
+#if ISC_MEM_MAGAZINES
+	if (USE_MAGAZINE(ctx, size)) {
+		int water;
+
+		water = magazine_put(ctx, ptr, size);
+		if (water != NO_WATER && ctx->water != NULL)
+			(ctx->water)(ctx->water_arg, water);
+		return;
+	}
+#endif
+
 	MCTXLOCK(ctx, &ctx->lock);
 
 	DELETE_TRACE(ctx, ptr, size, file, line);
@@ -13,18 +13,33 @@
 #include <config.h>
 
 #include <stddef.h>
+#include <string.h>
+#ifdef HAVE_INTTYPES_H
+#include <inttypes.h> /* uintptr_t */
+#endif
 
 #include <isc/atomic.h>
 #include <isc/magic.h>
+#include <isc/mem.h>
 #include <isc/msgs.h>
+#include <isc/once.h>
+#include <isc/os.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/rwlock.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #define RWLOCK_MAGIC		ISC_MAGIC('R', 'W', 'L', 'k')
 #define VALID_RWLOCK(rwl)	ISC_MAGIC_VALID(rwl, RWLOCK_MAGIC)
 
+isc_result_t
+isc_rwlock_init(isc_rwlock_t *rwl, unsigned int read_quota,
+		unsigned int write_quota)
+{
+	return (isc_rwlock_initx(rwl, read_quota, write_quota, NULL, 0));
+}
+
 #ifdef ISC_PLATFORM_USETHREADS
 
 #ifndef RWLOCK_DEFAULT_READ_QUOTA
@@ -42,6 +57,32 @@
 #if defined(ISC_PLATFORM_HAVEXADD) && defined(ISC_PLATFORM_HAVECMPXCHG)
 static isc_result_t
 isc__rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type);
+
+/*%
+ * Big-reader locks keep one reader counter per CPU, up to
+ * RWLOCK_BR_MAXSLOTS of them, each on a cache line of its own.
+ */
+#ifndef RWLOCK_BR_MAXSLOTS
+#define RWLOCK_BR_MAXSLOTS 16
+#endif
+
+#define RWLOCK_BR_CACHELINE	64
+#define RWLOCK_BR_STRIDE	(RWLOCK_BR_CACHELINE / sizeof(isc_int32_t))
+
+static isc_result_t
+br_init(isc_rwlock_t *rwl, isc_mem_t *mctx);
+static void
+br_destroy(isc_rwlock_t *rwl);
+static isc_result_t
+br_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type);
+static isc_result_t
+br_trylock(isc_rwlock_t *rwl, isc_rwlocktype_t type);
+static isc_result_t
+br_tryupgrade(isc_rwlock_t *rwl);
+static void
+br_downgrade(isc_rwlock_t *rwl);
+static isc_result_t
+br_unlock(isc_rwlock_t *rwl, isc_rwlocktype_t type);
 #endif
 
 #ifdef ISC_RWLOCK_TRACE
@@ -91,12 +132,14 @@ print_lock(const char *operation, isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 #endif /* ISC_RWLOCK_TRACE */
 
 isc_result_t
-isc_rwlock_init(isc_rwlock_t *rwl, unsigned int read_quota,
-		unsigned int write_quota)
+isc_rwlock_initx(isc_rwlock_t *rwl, unsigned int read_quota,
+		 unsigned int write_quota, isc_mem_t *mctx,
+		 unsigned int options)
 {
 	isc_result_t result;
 
 	REQUIRE(rwl != NULL);
+	REQUIRE((options & ISC_RWLOCK_BIGREADER) == 0 || mctx != NULL);
 
 	/*
 	 * In case there's trouble initializing, we zero magic now.  If all
@@ -118,7 +161,16 @@ isc_rwlock_init(isc_rwlock_t *rwl, unsigned int read_quota,
 	if (write_quota == 0)
 		write_quota = RWLOCK_DEFAULT_WRITE_QUOTA;
 	rwl->write_quota = write_quota;
+	rwl->mctx = NULL;
+	rwl->slots = NULL;
+	rwl->nslots = 0;
+	rwl->slotsmem = NULL;
+	rwl->slotssize = 0;
+	rwl->brwriter = 0;
 #else
+	UNUSED(mctx);
+	UNUSED(options);
+
 	rwl->type = isc_rwlocktype_read;
 	rwl->original = isc_rwlocktype_none;
 	rwl->active = 0;
@@ -158,10 +210,22 @@ isc_rwlock_init(isc_rwlock_t *rwl, unsigned int read_quota,
 		goto destroy_rcond;
 	}
 
+#if defined(ISC_PLATFORM_HAVEXADD) && defined(ISC_PLATFORM_HAVECMPXCHG)
+	if ((options & ISC_RWLOCK_BIGREADER) != 0) {
+		result = br_init(rwl, mctx);
+		if (result != ISC_R_SUCCESS)
+			goto destroy_wcond;
+	}
+#endif
+
 	rwl->magic = RWLOCK_MAGIC;
 
 	return (ISC_R_SUCCESS);
 
+#if defined(ISC_PLATFORM_HAVEXADD) && defined(ISC_PLATFORM_HAVECMPXCHG)
+  destroy_wcond:
+	(void)isc_condition_destroy(&rwl->writeable);
+#endif
   destroy_rcond:
 	(void)isc_condition_destroy(&rwl->readable);
   destroy_lock:
@@ -177,6 +241,8 @@ isc_rwlock_destroy(isc_rwlock_t *rwl) {
 #if defined(ISC_PLATFORM_HAVEXADD) && defined(ISC_PLATFORM_HAVECMPXCHG)
 	REQUIRE(rwl->write_requests == rwl->write_completions &&
 		rwl->cnt_and_flag == 0 && rwl->readers_waiting == 0);
+	if (rwl->slots != NULL)
+		br_destroy(rwl);
 #else
 	LOCK(&rwl->lock);
 	REQUIRE(rwl->active == 0 &&
@@ -371,9 +437,19 @@ isc__rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 isc_result_t
 isc_rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 	isc_int32_t cnt = 0;
-	isc_int32_t max_cnt = rwl->spins * 2 + 10;
+	isc_int32_t max_cnt;
 	isc_result_t result = ISC_R_SUCCESS;
 
+	REQUIRE(VALID_RWLOCK(rwl));
+
+	/*
+	 * Big-reader locks do their own spinning; updating 'spins' here
+	 * would make every reader write to the shared cache line.
+	 */
+	if (rwl->slots != NULL)
+		return (br_lock(rwl, type));
+
+	max_cnt = rwl->spins * 2 + 10;
 	if (max_cnt > RWLOCK_MAX_ADAPTIVE_COUNT)
 		max_cnt = RWLOCK_MAX_ADAPTIVE_COUNT;
 
@@ -398,6 +474,9 @@ isc_rwlock_trylock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 
 	REQUIRE(VALID_RWLOCK(rwl));
 
+	if (rwl->slots != NULL)
+		return (br_trylock(rwl, type));
+
 #ifdef ISC_RWLOCK_TRACE
 	print_lock(isc_msgcat_get(isc_msgcat, ISC_MSGSET_RWLOCK,
 				  ISC_MSG_PRELOCK, "prelock"), rwl, type);
@@ -460,6 +539,9 @@ isc_rwlock_tryupgrade(isc_rwlock_t *rwl) {
 
 	REQUIRE(VALID_RWLOCK(rwl));
 
+	if (rwl->slots != NULL)
+		return (br_tryupgrade(rwl));
+
 	/* Try to acquire write access. */
 	prevcnt = isc_atomic_cmpxchg(&rwl->cnt_and_flag,
 				     READER_INCR, WRITER_ACTIVE);
@@ -489,6 +571,11 @@ isc_rwlock_downgrade(isc_rwlock_t *rwl) {
 
 	REQUIRE(VALID_RWLOCK(rwl));
 
+	if (rwl->slots != NULL) {
+		br_downgrade(rwl);
+		return;
+	}
+
 	/* Become an active reader. */
 	prev_readers = isc_atomic_xadd(&rwl->cnt_and_flag, READER_INCR);
 	/* We must have been a writer. */
@@ -511,6 +598,9 @@ isc_rwlock_unlock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 
 	REQUIRE(VALID_RWLOCK(rwl));
 
+	if (rwl->slots != NULL)
+		return (br_unlock(rwl, type));
+
 #ifdef ISC_RWLOCK_TRACE
 	print_lock(isc_msgcat_get(isc_msgcat, ISC_MSGSET_RWLOCK,
 				  ISC_MSG_PREUNLOCK, "preunlock"), rwl, type);
@@ -576,6 +666,259 @@ isc_rwlock_unlock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Big-reader locks.
+ *
+ * Instead of cnt_and_flag, readers are counted in per-CPU slots, each
+ * on a cache line of its own, so that readers running on different CPUs
+ * do not write to the same cache line.  A thread is given a slot, round
+ * robin, the first time it takes a big-reader lock, and remembers it in
+ * a thread key; threads beyond the number of slots share, so the slots
+ * are still updated atomically.
+ *
+ * A reader increments its slot and then checks 'brwriter'.  If no
+ * writer is there it has the lock; otherwise it backs out, wakes the
+ * writer if need be, and waits for the writer to finish.  A writer sets
+ * 'brwriter', which stops new readers, and then waits for the sum of
+ * the slots to drop to zero.  Since both sides update their own word
+ * before reading the other's with a full barrier in between, at least
+ * one of them sees the other.  Writers are always preferred, so a
+ * big-reader lock only suits data that is written rarely.
+ */
+
+static isc_once_t		br_once = ISC_ONCE_INIT;
+static isc_thread_key_t		br_key;
+static unsigned int		br_nslots = 0;
+static isc_int32_t		br_next = 0;
+
+static void
+br_initialize(void) {
+	unsigned int ncpus = isc_os_ncpus();
+
+	if (isc_thread_key_create(&br_key, NULL) != 0)
+		return;
+
+	br_nslots = 1;
+	while (br_nslots < ncpus && br_nslots < RWLOCK_BR_MAXSLOTS)
+		br_nslots <<= 1;
+}
+
+static isc_result_t
+br_init(isc_rwlock_t *rwl, isc_mem_t *mctx) {
+	uintptr_t p;
+
+	RUNTIME_CHECK(isc_once_do(&br_once, br_initialize) == ISC_R_SUCCESS);
+
+	/*
+	 * Without a thread key, fall back to an ordinary lock.
+	 */
+	if (br_nslots == 0)
+		return (ISC_R_SUCCESS);
+
+	rwl->slotssize = br_nslots * RWLOCK_BR_CACHELINE + RWLOCK_BR_CACHELINE;
+	rwl->slotsmem = isc_mem_get(mctx, rwl->slotssize);
+	if (rwl->slotsmem == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(rwl->slotsmem, 0, rwl->slotssize);
+
+	p = (uintptr_t) rwl->slotsmem;
+	p = (p + RWLOCK_BR_CACHELINE - 1) &
+	    ~((uintptr_t) RWLOCK_BR_CACHELINE - 1);
+	rwl->slots = (isc_int32_t *) p;
+	rwl->nslots = br_nslots;
+	isc_mem_attach(mctx, &rwl->mctx);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * Return the calling thread's reader slot of 'rwl'.
+ */
+static inline isc_int32_t *
+br_slot(isc_rwlock_t *rwl) {
+	uintptr_t id;
+
+	id = (uintptr_t) isc_thread_key_getspecific(br_key);
+	if (ISC_UNLIKELY(id == 0)) {
+		id = (uintptr_t) isc_atomic_xadd(&br_next, 1) + 1;
+		(void)isc_thread_key_setspecific(br_key, (void *) id);
+	}
+
+	return (rwl->slots + ((id - 1) & (rwl->nslots - 1)) *
+		RWLOCK_BR_STRIDE);
+}
+
+/*%
+ * Return the number of readers holding, or about to give up trying
+ * for, 'rwl'.
+ */
+static isc_int32_t
+br_readers(isc_rwlock_t *rwl) {
+	const volatile isc_int32_t *slot = rwl->slots;
+	isc_int32_t readers = 0;
+	unsigned int i;
+
+	for (i = 0; i < rwl->nslots; i++, slot += RWLOCK_BR_STRIDE)
+		readers += *slot;
+
+	return (readers);
+}
+
+static void
+br_destroy(isc_rwlock_t *rwl) {
+	REQUIRE(rwl->brwriter == 0 && br_readers(rwl) == 0);
+
+	rwl->slots = NULL;
+	isc_mem_putanddetach(&rwl->mctx, rwl->slotsmem, rwl->slotssize);
+}
+
+/*%
+ * Drop a read reference from 'slot', waking a writer that is waiting
+ * for the readers to drain.
+ */
+static inline void
+br_readdone(isc_rwlock_t *rwl, isc_int32_t *slot) {
+	(void)isc_atomic_xadd(slot, -1);
+	if (ISC_UNLIKELY(rwl->brwriter != 0)) {
+		LOCK(&rwl->lock);
+		BROADCAST(&rwl->writeable);
+		UNLOCK(&rwl->lock);
+	}
+}
+
+static inline isc_boolean_t
+br_tryread(isc_rwlock_t *rwl, isc_int32_t *slot) {
+	(void)isc_atomic_xadd(slot, 1);
+	if (ISC_LIKELY(rwl->brwriter == 0))
+		return (ISC_TRUE);
+	br_readdone(rwl, slot);
+	return (ISC_FALSE);
+}
+
+/*%
+ * Clear 'brwriter' and wake anyone waiting for it.
+ */
+static void
+br_release(isc_rwlock_t *rwl) {
+	(void)isc_atomic_xadd(&rwl->brwriter, -1);
+
+	LOCK(&rwl->lock);
+	if (rwl->readers_waiting > 0)
+		BROADCAST(&rwl->readable);
+	BROADCAST(&rwl->writeable);
+	UNLOCK(&rwl->lock);
+}
+
+/*%
+ * Wait for the readers of 'rwl' to drain, after setting 'brwriter'.
+ * Readers hold the lock briefly, so spin for a while before sleeping.
+ */
+static void
+br_drain(isc_rwlock_t *rwl) {
+	isc_int32_t cnt;
+
+	for (cnt = 0; br_readers(rwl) != 0; cnt++) {
+		if (cnt < RWLOCK_MAX_ADAPTIVE_COUNT) {
+#ifdef ISC_PLATFORM_BUSYWAITNOP
+			ISC_PLATFORM_BUSYWAITNOP;
+#endif
+			continue;
+		}
+		LOCK(&rwl->lock);
+		if (br_readers(rwl) != 0)
+			WAIT(&rwl->writeable, &rwl->lock);
+		UNLOCK(&rwl->lock);
+	}
+}
+
+static isc_result_t
+br_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
+	isc_int32_t *slot;
+
+	if (type == isc_rwlocktype_read) {
+		slot = br_slot(rwl);
+		while (!br_tryread(rwl, slot)) {
+			LOCK(&rwl->lock);
+			rwl->readers_waiting++;
+			if (rwl->brwriter != 0)
+				WAIT(&rwl->readable, &rwl->lock);
+			rwl->readers_waiting--;
+			UNLOCK(&rwl->lock);
+		}
+	} else {
+		while (isc_atomic_cmpxchg(&rwl->brwriter, 0, 1) != 0) {
+			LOCK(&rwl->lock);
+			if (rwl->brwriter != 0)
+				WAIT(&rwl->writeable, &rwl->lock);
+			UNLOCK(&rwl->lock);
+		}
+		br_drain(rwl);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+br_trylock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
+	if (type == isc_rwlocktype_read) {
+		if (!br_tryread(rwl, br_slot(rwl)))
+			return (ISC_R_LOCKBUSY);
+	} else {
+		if (isc_atomic_cmpxchg(&rwl->brwriter, 0, 1) != 0)
+			return (ISC_R_LOCKBUSY);
+		if (br_readers(rwl) != 0) {
+			br_release(rwl);
+			return (ISC_R_LOCKBUSY);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+br_tryupgrade(isc_rwlock_t *rwl) {
+	isc_int32_t *slot;
+
+	if (isc_atomic_cmpxchg(&rwl->brwriter, 0, 1) != 0)
+		return (ISC_R_LOCKBUSY);
+
+	/*
+	 * Give up our own read reference; if that leaves no readers,
+	 * we are the writer.  Otherwise take it back and let the
+	 * others carry on.
+	 */
+	slot = br_slot(rwl);
+	INSIST(br_readers(rwl) > 0);
+	(void)isc_atomic_xadd(slot, -1);
+	if (br_readers(rwl) == 0)
+		return (ISC_R_SUCCESS);
+
+	(void)isc_atomic_xadd(slot, 1);
+	br_release(rwl);
+
+	return (ISC_R_LOCKBUSY);
+}
+
+static void
+br_downgrade(isc_rwlock_t *rwl) {
+	INSIST(rwl->brwriter != 0);
+
+	(void)isc_atomic_xadd(br_slot(rwl), 1);
+	br_release(rwl);
+}
+
+static isc_result_t
+br_unlock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
+	if (type == isc_rwlocktype_read) {
+		br_readdone(rwl, br_slot(rwl));
+	} else {
+		INSIST(rwl->brwriter != 0);
+		br_release(rwl);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 #else /* ISC_PLATFORM_HAVEXADD && ISC_PLATFORM_HAVECMPXCHG */
 
 static isc_result_t
@@ -786,13 +1129,16 @@ isc_rwlock_unlock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 #else /* ISC_PLATFORM_USETHREADS */
 
 isc_result_t
-isc_rwlock_init(isc_rwlock_t *rwl, unsigned int read_quota,
-		unsigned int write_quota)
+isc_rwlock_initx(isc_rwlock_t *rwl, unsigned int read_quota,
+		 unsigned int write_quota, isc_mem_t *mctx,
+		 unsigned int options)
 {
 	REQUIRE(rwl != NULL);
 
 	UNUSED(read_quota);
 	UNUSED(write_quota);
+	UNUSED(mctx);
+	UNUSED(options);
 
 	rwl->type = isc_rwlocktype_read;
 	rwl->active = 0;
@@ -13,15 +13,21 @@
 #include <config.h>
 
 #include <string.h>
+#ifdef HAVE_INTTYPES_H
+#include <inttypes.h> /* uintptr_t */
+#endif
 
 #include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/once.h>
+#include <isc/os.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/rwlock.h>
 #include <isc/stats.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #define ISC_STATS_MAGIC			ISC_MAGIC('S', 't', 'a', 't')
@@ -76,14 +82,63 @@ typedef struct {
 typedef isc_uint64_t isc_stat_t;
 #endif
 
+/*%
+ * With 64-bit atomic operations and threads, every counter is split
+ * into per-thread shards, each shard's counters on cache lines of their
+ * own: an update then only touches a line that is normally used by the
+ * updating thread alone, instead of one that every thread is bouncing
+ * between CPUs.  The shards are summed when the counters are read.
+ * Threads are given shards round robin the first time they update a
+ * counter, so threads beyond the number of shards share; the updates
+ * stay atomic for that reason.
+ *
+ * Shards multiply the memory used by a statistics set, so only sets
+ * created with ISC_STATSCREATE_SHARDED have them; that is meant for the
+ * server-wide and per-view sets that every query updates, not the
+ * per-zone ones.  Their number is that of
+ * the CPUs, rounded up to a power of two, but no more than
+ * ISC_STATS_MAXSHARDS.
+ */
+#if ISC_STATS_HAVEATOMICQ && defined(ISC_PLATFORM_USETHREADS) && \
+	defined(ISC_PLATFORM_HAVEXADD)
+#define ISC_STATS_SHARDED 1
+#else
+#define ISC_STATS_SHARDED 0
+#endif
+
+#define ISC_STATS_MAXSHARDS		16
+#define ISC_STATS_CACHELINE		64
+
+#if ISC_STATS_SHARDED
+static isc_once_t		shard_once = ISC_ONCE_INIT;
+static isc_thread_key_t		shard_key;
+static unsigned int		shard_count = 1;
+static isc_int32_t		shard_next = 0;
+
+static void
+shard_initialize(void) {
+	unsigned int ncpus = isc_os_ncpus();
+
+	if (isc_thread_key_create(&shard_key, NULL) != 0)
+		return;
+
+	while (shard_count < ncpus && shard_count < ISC_STATS_MAXSHARDS)
+		shard_count <<= 1;
+}
+#endif
+
 struct isc_stats {
 	/*% Unlocked */
 	unsigned int	magic;
 	isc_mem_t	*mctx;
 	int		ncounters;
 
+	unsigned int	nshards;	/* a power of 2 */
+	unsigned int	stride;		/* counters per shard, padded */
+
 	isc_mutex_t	lock;
 	unsigned int	references; /* locked by lock */
+					/* also serializes isc_stats_set() */
 
 	/*%
 	 * Locked by counterlock or unlocked if efficient rwlock is not
@@ -92,7 +147,9 @@ struct isc_stats {
 #if ISC_STATS_LOCKCOUNTERS
 	isc_rwlock_t	counterlock;
 #endif
-	isc_stat_t	*counters;
+	isc_stat_t	*counters;	/* 'nshards' rows of 'stride' */
+	void		*countersmem;
+	size_t		counterssize;
 
 	/*%
 	 * We don't want to lock the counters while we are dumping, so we first
@@ -109,7 +166,9 @@ struct isc_stats {
 };
 
 static isc_result_t
-create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
+create_stats(isc_mem_t *mctx, int ncounters, unsigned int options,
+	     isc_stats_t **statsp)
+{
 	isc_stats_t *stats;
 	isc_result_t result = ISC_R_SUCCESS;
 
@@ -123,11 +182,37 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 	if (result != ISC_R_SUCCESS)
 		goto clean_stats;
 
-	stats->counters = isc_mem_get(mctx, sizeof(isc_stat_t) * ncounters);
-	if (stats->counters == NULL) {
+	stats->nshards = 1;
+	stats->stride = ncounters;
+	stats->counterssize = sizeof(isc_stat_t) * ncounters;
+#if ISC_STATS_SHARDED
+	RUNTIME_CHECK(isc_once_do(&shard_once, shard_initialize)
+		      == ISC_R_SUCCESS);
+	if ((options & ISC_STATSCREATE_SHARDED) != 0 && shard_count > 1) {
+		unsigned int perline = ISC_STATS_CACHELINE / sizeof(isc_stat_t);
+
+		stats->nshards = shard_count;
+		stats->stride = (ncounters + perline - 1) / perline * perline;
+		stats->counterssize = sizeof(isc_stat_t) * stats->stride *
+				      stats->nshards + ISC_STATS_CACHELINE;
+	}
+#else
+	UNUSED(options);
+#endif
+	stats->countersmem = isc_mem_get(mctx, stats->counterssize);
+	if (stats->countersmem == NULL) {
 		result = ISC_R_NOMEMORY;
 		goto clean_mutex;
 	}
+	memset(stats->countersmem, 0, stats->counterssize);
+	stats->counters = stats->countersmem;
+	if (stats->nshards > 1) {
+		uintptr_t p = (uintptr_t) stats->countersmem;
+
+		p = (p + ISC_STATS_CACHELINE - 1) &
+		    ~((uintptr_t) ISC_STATS_CACHELINE - 1);
+		stats->counters = (isc_stat_t *) p;
+	}
 	stats->copiedcounters = isc_mem_get(mctx,
 					    sizeof(isc_uint64_t) * ncounters);
 	if (stats->copiedcounters == NULL) {
@@ -142,7 +227,6 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 #endif
 
 	stats->references = 1;
-	memset(stats->counters, 0, sizeof(isc_stat_t) * ncounters);
 	stats->mctx = NULL;
 	isc_mem_attach(mctx, &stats->mctx);
 	stats->ncounters = ncounters;
@@ -153,7 +237,7 @@ create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
 	return (result);
 
 clean_counters:
-	isc_mem_put(mctx, stats->counters, sizeof(isc_stat_t) * ncounters);
+	isc_mem_put(mctx, stats->countersmem, stats->counterssize);
 
 #if ISC_STATS_LOCKCOUNTERS
 clean_copiedcounters:
@@ -197,8 +281,8 @@ isc_stats_detach(isc_stats_t **statsp) {
 	if (stats->references == 0) {
 		isc_mem_put(stats->mctx, stats->copiedcounters,
 			    sizeof(isc_stat_t) * stats->ncounters);
-		isc_mem_put(stats->mctx, stats->counters,
-			    sizeof(isc_stat_t) * stats->ncounters);
+		isc_mem_put(stats->mctx, stats->countersmem,
+			    stats->counterssize);
 		UNLOCK(&stats->lock);
 		DESTROYLOCK(&stats->lock);
 #if ISC_STATS_LOCKCOUNTERS
@@ -218,8 +302,33 @@ isc_stats_ncounters(isc_stats_t *stats) {
 	return (stats->ncounters);
 }
 
+/*%
+ * Return the calling thread's shard of the counters of 'stats'.
+ */
+static inline isc_stat_t *
+shard_counters(isc_stats_t *stats) {
+#if ISC_STATS_SHARDED
+	uintptr_t id;
+
+	if (stats->nshards == 1)
+		return (stats->counters);
+
+	id = (uintptr_t) isc_thread_key_getspecific(shard_key);
+	if (ISC_UNLIKELY(id == 0)) {
+		id = (uintptr_t) isc_atomic_xadd(&shard_next, 1) + 1;
+		(void)isc_thread_key_setspecific(shard_key, (void *) id);
+	}
+
+	return (stats->counters +
+		((id - 1) & (stats->nshards - 1)) * stats->stride);
+#else
+	return (stats->counters);
+#endif
+}
+
 static inline void
 incrementcounter(isc_stats_t *stats, int counter) {
+	isc_stat_t *counters = shard_counters(stats);
 	isc_int32_t prev;
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -232,7 +341,7 @@ incrementcounter(isc_stats_t *stats, int counter) {
 #endif
 
 #if ISC_STATS_USEMULTIFIELDS
-	prev = isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].lo, 1);
+	prev = isc_atomic_xadd((isc_int32_t *)&counters[counter].lo, 1);
 	/*
 	 * If the lower 32-bit field overflows, increment the higher field.
 	 * Note that it's *theoretically* possible that the lower field
@@ -242,13 +351,13 @@ incrementcounter(isc_stats_t *stats, int counter) {
 	 * by the write (exclusive) lock.
 	 */
 	if (prev == (isc_int32_t)0xffffffff)
-		isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].hi, 1);
+		isc_atomic_xadd((isc_int32_t *)&counters[counter].hi, 1);
 #elif ISC_STATS_HAVEATOMICQ
 	UNUSED(prev);
-	isc_atomic_xaddq((isc_int64_t *)&stats->counters[counter], 1);
+	isc_atomic_xaddq((isc_int64_t *)&counters[counter], 1);
 #else
 	UNUSED(prev);
-	stats->counters[counter]++;
+	counters[counter]++;
 #endif
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -256,8 +365,14 @@ incrementcounter(isc_stats_t *stats, int counter) {
 #endif
 }
 
+/*
+ * A decrement may well hit a different shard than the increment it
+ * undoes; the shards are summed modulo 2^64, so the total is right even
+ * though the shard is left "negative".
+ */
 static inline void
 decrementcounter(isc_stats_t *stats, int counter) {
+	isc_stat_t *counters = shard_counters(stats);
 	isc_int32_t prev;
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -265,16 +380,16 @@ decrementcounter(isc_stats_t *stats, int counter) {
 #endif
 
 #if ISC_STATS_USEMULTIFIELDS
-	prev = isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].lo, -1);
+	prev = isc_atomic_xadd((isc_int32_t *)&counters[counter].lo, -1);
 	if (prev == 0)
-		isc_atomic_xadd((isc_int32_t *)&stats->counters[counter].hi,
+		isc_atomic_xadd((isc_int32_t *)&counters[counter].hi,
 				-1);
 #elif ISC_STATS_HAVEATOMICQ
 	UNUSED(prev);
-	isc_atomic_xaddq((isc_int64_t *)&stats->counters[counter], -1);
+	isc_atomic_xaddq((isc_int64_t *)&counters[counter], -1);
 #else
 	UNUSED(prev);
-	stats->counters[counter]--;
+	counters[counter]--;
 #endif
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -284,6 +399,8 @@ decrementcounter(isc_stats_t *stats, int counter) {
 
 static void
 copy_counters(isc_stats_t *stats) {
+	isc_stat_t *counters;
+	unsigned int shard;
 	int i;
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -294,18 +411,25 @@ copy_counters(isc_stats_t *stats) {
 	isc_rwlock_lock(&stats->counterlock, isc_rwlocktype_write);
 #endif
 
-	for (i = 0; i < stats->ncounters; i++) {
+	memset(stats->copiedcounters, 0,
+	       sizeof(isc_uint64_t) * stats->ncounters);
+
+	for (shard = 0; shard < stats->nshards; shard++) {
+		counters = stats->counters + shard * stats->stride;
+		for (i = 0; i < stats->ncounters; i++) {
 #if ISC_STATS_USEMULTIFIELDS
-		stats->copiedcounters[i] =
-			(isc_uint64_t)(stats->counters[i].hi) << 32 |
-			stats->counters[i].lo;
+			stats->copiedcounters[i] +=
+				(isc_uint64_t)(counters[i].hi) << 32 |
+				counters[i].lo;
 #elif ISC_STATS_HAVEATOMICQ
-		/* use xaddq(..., 0) as an atomic load */
-		stats->copiedcounters[i] =
-			(isc_uint64_t)isc_atomic_xaddq((isc_int64_t *)&stats->counters[i], 0);
+			/* use xaddq(..., 0) as an atomic load */
+			stats->copiedcounters[i] += (isc_uint64_t)
+				isc_atomic_xaddq((isc_int64_t *)&counters[i],
+						 0);
 #else
-		stats->copiedcounters[i] = stats->counters[i];
+			stats->copiedcounters[i] += counters[i];
 #endif
+		}
 	}
 
 #if ISC_STATS_LOCKCOUNTERS
@@ -317,7 +441,16 @@ isc_result_t
 isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, ncounters, statsp));
+	return (create_stats(mctx, ncounters, 0, statsp));
+}
+
+isc_result_t
+isc_stats_create2(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters,
+		  unsigned int options)
+{
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	return (create_stats(mctx, ncounters, options, statsp));
 }
 
 void
@@ -358,9 +491,41 @@ void
 isc_stats_set(isc_stats_t *stats, isc_uint64_t val,
 	      isc_statscounter_t counter)
 {
+	isc_stat_t *counters;
+	unsigned int shard;
+
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
+#if ISC_STATS_SHARDED
+	if (stats->nshards > 1) {
+		isc_uint64_t sum = 0;
+
+		/*
+		 * Updates to the other shards are not held off, so the
+		 * shards cannot simply be overwritten.  Instead add the
+		 * difference between 'val' and the current total to our
+		 * own shard: updates made meanwhile are then neither lost
+		 * nor counted twice.  Concurrent sets are serialized so
+		 * that each sees the total left by the one before.
+		 */
+		LOCK(&stats->lock);
+		for (shard = 0; shard < stats->nshards; shard++) {
+			counters = stats->counters + shard * stats->stride;
+			sum += (isc_uint64_t)
+				isc_atomic_xaddq((isc_int64_t *)
+						 &counters[counter], 0);
+		}
+		counters = shard_counters(stats);
+		isc_atomic_xaddq((isc_int64_t *)&counters[counter],
+				 (isc_int64_t)(val - sum));
+		UNLOCK(&stats->lock);
+		return;
+	}
+#endif
+
+	UNUSED(shard);
+
 #if ISC_STATS_LOCKCOUNTERS
 	/*
 	 * We use a "write" lock before "reading" the statistics counters as
@@ -369,17 +534,17 @@ isc_stats_set(isc_stats_t *stats, isc_uint64_t val,
 	isc_rwlock_lock(&stats->counterlock, isc_rwlocktype_write);
 #endif
 
+	counters = stats->counters;
 #if ISC_STATS_USEMULTIFIELDS
-	stats->counters[counter].hi = (isc_uint32_t)((val >> 32) & 0xffffffff);
-	stats->counters[counter].lo = (isc_uint32_t)(val & 0xffffffff);
+	counters[counter].hi = (isc_uint32_t)((val >> 32) & 0xffffffff);
+	counters[counter].lo = (isc_uint32_t)(val & 0xffffffff);
 #elif ISC_STATS_HAVEATOMICQ
-	isc_atomic_storeq((isc_int64_t *)&stats->counters[counter], val);
+	isc_atomic_storeq((isc_int64_t *)&counters[counter], val);
 #else
-	stats->counters[counter] = val;
+	counters[counter] = val;
 #endif
 
 #if ISC_STATS_LOCKCOUNTERS
 	isc_rwlock_unlock(&stats->counterlock, isc_rwlocktype_write);
 #endif
 }
-
@@ -34,6 +34,10 @@
 #include <isc/util.h>
 #include <isc/xml.h>
 
+#ifdef ISC_PLATFORM_HAVEXADD
+#include <isc/atomic.h>
+#endif
+
 #ifdef OPENSSL_LEAKS
 #include <openssl/err.h>
 #endif
@@ -109,8 +113,10 @@ struct isc__task {
 	isc_time_t			tnow;
 	char				name[16];
 	void *				tag;
+	unsigned int			threadid;
 	/* Locked by task manager lock. */
 	LINK(isc__task_t)		link;
+	/* Locked by the lock of the run queue 'threadid'. */
 	LINK(isc__task_t)		ready_link;
 	LINK(isc__task_t)		ready_priority_link;
 };
@@ -126,6 +132,31 @@ struct isc__task {
 
 typedef ISC_LIST(isc__task_t)	isc__tasklist_t;
 
+/*%
+ * Every worker thread has its own run queue.  A task is assigned to a
+ * queue when it is created and is always made ready on the queue of the
+ * worker that last ran it.  A worker whose queue is empty tries to steal
+ * a ready task from the other queues before going to sleep, and the
+ * stolen task then stays with its new worker.
+ *
+ * Without worker threads there is a single queue.
+ */
+typedef struct isc__taskqueue {
+	/* Not locked. */
+	isc__taskmgr_t *		manager;
+	unsigned int			threadid;
+	isc_mutex_t			lock;
+	/* Locked by queue lock. */
+	isc__tasklist_t			ready_tasks;
+	isc__tasklist_t			ready_priority_tasks;
+	unsigned int			tasks_ready;
+#ifdef USE_WORKER_THREADS
+	isc_condition_t			work_available;
+	isc_boolean_t			sleeping;
+	isc_uint64_t			steals;
+#endif /* USE_WORKER_THREADS */
+} isc__taskqueue_t;
+
 struct isc__taskmgr {
 	/* Not locked. */
 	isc_taskmgr_t			common;
@@ -135,19 +166,24 @@ struct isc__taskmgr {
 	unsigned int			workers;
 	isc_thread_t *			threads;
 #endif /* ISC_PLATFORM_USETHREADS */
+	unsigned int			nqueues;
+	isc__taskqueue_t *		queues;
 	/* Locked by task manager lock. */
 	unsigned int			default_quantum;
 	LIST(isc__task_t)		tasks;
-	isc__tasklist_t			ready_tasks;
-	isc__tasklist_t			ready_priority_tasks;
 	isc_taskmgrmode_t		mode;
 #ifdef ISC_PLATFORM_USETHREADS
-	isc_condition_t			work_available;
+	isc_condition_t			halt_released;
 	isc_condition_t			exclusive_granted;
 	isc_condition_t			paused;
+	/* Locked by task manager lock; also see read_counter(). */
+	isc_int32_t			idle_workers;
+	isc_int32_t			halts;	/* pause/exclusive requests */
+#endif /* ISC_PLATFORM_USETHREADS */
+#ifdef ISC_PLATFORM_USETHREADS
+	unsigned int			curq;
 #endif /* ISC_PLATFORM_USETHREADS */
 	unsigned int			tasks_running;
-	unsigned int			tasks_ready;
 	isc_boolean_t			pause_requested;
 	isc_boolean_t			exclusive_requested;
 	isc_boolean_t			exiting;
@@ -167,6 +203,40 @@ struct isc__taskmgr {
 #define DEFAULT_TASKMGR_QUANTUM		10
 #define DEFAULT_DEFAULT_QUANTUM		5
 #define FINISHED(m)			((m)->exiting && EMPTY((m)->tasks))
+#define HALTED(m)			((m)->pause_requested || \
+					 (m)->exclusive_requested)
+
+#ifdef USE_WORKER_THREADS
+/*
+ * 'idle_workers' and 'halts' are only changed with the manager lock
+ * held, but workers also look at them on their fast paths without it.
+ * Where there is an atomic add those reads use it; otherwise they take
+ * the manager lock, so the caller must not hold it or any queue lock.
+ */
+static inline void
+adjust_counter(isc_int32_t *counter, isc_int32_t delta) {
+#ifdef ISC_PLATFORM_HAVEXADD
+	(void)isc_atomic_xadd(counter, delta);
+#else
+	*counter += delta;
+#endif
+}
+
+static inline isc_int32_t
+read_counter(isc__taskmgr_t *manager, isc_int32_t *counter) {
+	isc_int32_t value;
+
+#ifdef ISC_PLATFORM_HAVEXADD
+	UNUSED(manager);
+	value = isc_atomic_xadd(counter, 0);
+#else
+	LOCK(&manager->lock);
+	value = *counter;
+	UNLOCK(&manager->lock);
+#endif
+	return (value);
+}
+#endif /* USE_WORKER_THREADS */
 
 #ifdef USE_SHARED_MANAGER
 static isc__taskmgr_t *taskmgr = NULL;
@@ -244,13 +314,22 @@ isc_taskmgrmode_t
 isc__taskmgr_mode(isc_taskmgr_t *manager0);
 
 static inline isc_boolean_t
-empty_readyq(isc__taskmgr_t *manager);
+empty_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue);
 
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager);
+pop_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue);
 
 static inline void
-push_readyq(isc__taskmgr_t *manager, isc__task_t *task);
+push_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue,
+	    isc__task_t *task);
+
+#ifdef USE_WORKER_THREADS
+static void
+wake_all_workers(isc__taskmgr_t *manager);
+
+static void
+wake_idle_worker(isc__taskmgr_t *manager, isc__taskqueue_t *queue);
+#endif /* USE_WORKER_THREADS */
 
 static struct isc__taskmethods {
 	isc_taskmethods_t methods;
@@ -321,7 +400,7 @@ task_finished(isc__task_t *task) {
 		 * any idle worker threads so they
 		 * can exit.
 		 */
-		BROADCAST(&manager->work_available);
+		wake_all_workers(manager);
 	}
 #endif /* USE_WORKER_THREADS */
 	UNLOCK(&manager->lock);
@@ -365,6 +444,7 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	isc_time_settoepoch(&task->tnow);
 	memset(task->name, 0, sizeof(task->name));
 	task->tag = NULL;
+	task->threadid = 0;
 	INIT_LINK(task, link);
 	INIT_LINK(task, ready_link);
 	INIT_LINK(task, ready_priority_link);
@@ -374,6 +454,13 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	if (!manager->exiting) {
 		if (task->quantum == 0)
 			task->quantum = manager->default_quantum;
+#ifdef USE_WORKER_THREADS
+		/*
+		 * Spread new tasks over the queues of the workers which
+		 * actually started.
+		 */
+		task->threadid = manager->curq++ % manager->workers;
+#endif /* USE_WORKER_THREADS */
 		APPEND(manager->tasks, task, link);
 	} else
 		exiting = ISC_TRUE;
@@ -460,8 +547,10 @@ task_shutdown(isc__task_t *task) {
 static inline void
 task_ready(isc__task_t *task) {
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue;
 #ifdef USE_WORKER_THREADS
 	isc_boolean_t has_privilege = isc__task_privilege((isc_task_t *) task);
+	isc_boolean_t busy = ISC_FALSE;
 #endif /* USE_WORKER_THREADS */
 
 	REQUIRE(VALID_MANAGER(manager));
@@ -469,13 +558,29 @@ task_ready(isc__task_t *task) {
 
 	XTRACE("task_ready");
 
-	LOCK(&manager->lock);
-	push_readyq(manager, task);
+	queue = &manager->queues[task->threadid];
+	LOCK(&queue->lock);
+	push_readyq(manager, queue, task);
+#ifdef USE_WORKER_THREADS
+	if (manager->mode == isc_taskmgrmode_normal || has_privilege) {
+		if (queue->sleeping) {
+			queue->sleeping = ISC_FALSE;
+			SIGNAL(&queue->work_available);
+		} else {
+			/*
+			 * The owner of the queue is busy; if anyone else
+			 * has nothing to do, let them steal this task.
+			 */
+			busy = ISC_TRUE;
+		}
+	}
+#endif /* USE_WORKER_THREADS */
+	UNLOCK(&queue->lock);
+
 #ifdef USE_WORKER_THREADS
-	if (manager->mode == isc_taskmgrmode_normal || has_privilege)
-		SIGNAL(&manager->work_available);
+	if (busy && read_counter(manager, &manager->idle_workers) > 0)
+		wake_idle_worker(manager, queue);
 #endif /* USE_WORKER_THREADS */
-	UNLOCK(&manager->lock);
 }
 
 static inline isc_boolean_t
@@ -937,379 +1042,442 @@ isc__task_getcurrenttimex(isc_task_t *task0, isc_time_t *t) {
  ***/
 
 /*
- * Return ISC_TRUE if the current ready list for the manager, which is
+ * Return ISC_TRUE if the current ready list for 'queue', which is
  * either ready_tasks or the ready_priority_tasks, depending on whether
- * the manager is currently in normal or privileged execution mode.
+ * the manager is currently in normal or privileged execution mode,
+ * is empty.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline isc_boolean_t
-empty_readyq(isc__taskmgr_t *manager) {
-	isc__tasklist_t queue;
+empty_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
+	isc__tasklist_t list;
 
 	if (manager->mode == isc_taskmgrmode_normal)
-		queue = manager->ready_tasks;
+		list = queue->ready_tasks;
 	else
-		queue = manager->ready_priority_tasks;
+		list = queue->ready_priority_tasks;
 
-	return (ISC_TF(EMPTY(queue)));
+	return (ISC_TF(EMPTY(list)));
 }
 
 /*
  * Dequeue and return a pointer to the first task on the current ready
- * list for the manager.
+ * list of 'queue'.
  * If the task is privileged, dequeue it from the other ready list
  * as well.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager) {
+pop_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
 	isc__task_t *task;
 
 	if (manager->mode == isc_taskmgrmode_normal)
-		task = HEAD(manager->ready_tasks);
+		task = HEAD(queue->ready_tasks);
 	else
-		task = HEAD(manager->ready_priority_tasks);
+		task = HEAD(queue->ready_priority_tasks);
 
 	if (task != NULL) {
-		DEQUEUE(manager->ready_tasks, task, ready_link);
+		DEQUEUE(queue->ready_tasks, task, ready_link);
 		if (ISC_LINK_LINKED(task, ready_priority_link))
-			DEQUEUE(manager->ready_priority_tasks, task,
+			DEQUEUE(queue->ready_priority_tasks, task,
 				ready_priority_link);
+		queue->tasks_ready--;
 	}
 
 	return (task);
 }
 
 /*
- * Push 'task' onto the ready_tasks queue.  If 'task' has the privilege
- * flag set, then also push it onto the ready_priority_tasks queue.
+ * Push 'task' onto the ready_tasks list of 'queue'.  If 'task' has the
+ * privilege flag set, then also push it onto the ready_priority_tasks
+ * list.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline void
-push_readyq(isc__taskmgr_t *manager, isc__task_t *task) {
-	ENQUEUE(manager->ready_tasks, task, ready_link);
+push_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue,
+	    isc__task_t *task)
+{
+	UNUSED(manager);
+
+	ENQUEUE(queue->ready_tasks, task, ready_link);
 	if ((task->flags & TASK_F_PRIVILEGED) != 0)
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	manager->tasks_ready++;
+	queue->tasks_ready++;
 }
 
+/*
+ * Run the events of 'task', which the caller has just taken off a ready
+ * queue, until it runs out of events or its quantum expires.  The number
+ * of events dispatched is added to '*dispatchedp'.
+ *
+ * Returns ISC_TRUE if the task still has work to do and must be put
+ * back on a ready queue.
+ */
+static isc_boolean_t
+task_run(isc__task_t *task, unsigned int *dispatchedp) {
+	unsigned int dispatch_count = 0;
+	isc_boolean_t done = ISC_FALSE;
+	isc_boolean_t requeue = ISC_FALSE;
+	isc_boolean_t finished = ISC_FALSE;
+	isc_event_t *event;
+
+	INSIST(VALID_TASK(task));
+
+	LOCK(&task->lock);
+	INSIST(task->state == task_state_ready);
+	task->state = task_state_running;
+	XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+			      ISC_MSG_RUNNING, "running"));
+	TIME_NOW(&task->tnow);
+	task->now = isc_time_seconds(&task->tnow);
+	do {
+		if (!EMPTY(task->events)) {
+			event = HEAD(task->events);
+			DEQUEUE(task->events, event, ev_link);
+			task->nevents--;
+
+			/*
+			 * Execute the event action.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					      ISC_MSGSET_TASK,
+					      ISC_MSG_EXECUTE,
+					      "execute action"));
+			if (event->ev_action != NULL) {
+				UNLOCK(&task->lock);
+				(event->ev_action)((isc_task_t *)task, event);
+				LOCK(&task->lock);
+			}
+			dispatch_count++;
+		}
+
+		if (task->references == 0 &&
+		    EMPTY(task->events) &&
+		    !TASK_SHUTTINGDOWN(task)) {
+			isc_boolean_t was_idle;
+
+			/*
+			 * There are no references and no
+			 * pending events for this task,
+			 * which means it will not become
+			 * runnable again via an external
+			 * action (such as sending an event
+			 * or detaching).
+			 *
+			 * We initiate shutdown to prevent
+			 * it from becoming a zombie.
+			 *
+			 * We do this here instead of in
+			 * the "if EMPTY(task->events)" block
+			 * below because:
+			 *
+			 *	If we post no shutdown events,
+			 *	we want the task to finish.
+			 *
+			 *	If we did post shutdown events,
+			 *	will still want the task's
+			 *	quantum to be applied.
+			 */
+			was_idle = task_shutdown(task);
+			INSIST(!was_idle);
+		}
+
+		if (EMPTY(task->events)) {
+			/*
+			 * Nothing else to do for this task
+			 * right now.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					      ISC_MSGSET_TASK,
+					      ISC_MSG_EMPTY,
+					      "empty"));
+			if (task->references == 0 &&
+			    TASK_SHUTTINGDOWN(task)) {
+				/*
+				 * The task is done.
+				 */
+				XTRACE(isc_msgcat_get(isc_msgcat,
+						      ISC_MSGSET_TASK,
+						      ISC_MSG_DONE,
+						      "done"));
+				finished = ISC_TRUE;
+				task->state = task_state_done;
+			} else
+				task->state = task_state_idle;
+			done = ISC_TRUE;
+		} else if (dispatch_count >= task->quantum) {
+			/*
+			 * Our quantum has expired, but
+			 * there is more work to be done.
+			 * We'll requeue it to the ready
+			 * queue later.
+			 *
+			 * We don't check quantum until
+			 * dispatching at least one event,
+			 * so the minimum quantum is one.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					      ISC_MSGSET_TASK,
+					      ISC_MSG_QUANTUM,
+					      "quantum"));
+			task->state = task_state_ready;
+			requeue = ISC_TRUE;
+			done = ISC_TRUE;
+		}
+	} while (!done);
+	UNLOCK(&task->lock);
+
+	if (finished)
+		task_finished(task);
+
+	*dispatchedp += dispatch_count;
+
+	return (requeue);
+}
+
+#ifdef USE_WORKER_THREADS
+/*
+ * Wake up every sleeping worker, e.g. because the manager is exiting
+ * or the execution mode has changed.
+ *
+ * Caller must hold the task manager lock.
+ */
 static void
-dispatch(isc__taskmgr_t *manager) {
+wake_all_workers(isc__taskmgr_t *manager) {
+	unsigned int i;
+
+	for (i = 0; i < manager->workers; i++) {
+		isc__taskqueue_t *queue = &manager->queues[i];
+
+		LOCK(&queue->lock);
+		queue->sleeping = ISC_FALSE;
+		SIGNAL(&queue->work_available);
+		UNLOCK(&queue->lock);
+	}
+}
+
+/*
+ * Wake up one sleeping worker other than the owner of 'queue', so that
+ * it can steal the work that has piled up on the busy queues.
+ *
+ * Caller must NOT hold any queue lock.
+ */
+static void
+wake_idle_worker(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
+	isc_boolean_t woken = ISC_FALSE;
+	unsigned int i;
+
+	for (i = 1; i < manager->workers && !woken; i++) {
+		isc__taskqueue_t *idle;
+
+		idle = &manager->queues[(queue->threadid + i) %
+					manager->workers];
+		LOCK(&idle->lock);
+		if (idle->sleeping) {
+			idle->sleeping = ISC_FALSE;
+			SIGNAL(&idle->work_available);
+			woken = ISC_TRUE;
+		}
+		UNLOCK(&idle->lock);
+	}
+}
+
+/*
+ * Try to take a ready task from another worker's queue.  A successfully
+ * stolen task is reassigned to 'queue', so that it is made ready there
+ * from now on.
+ *
+ * Caller must NOT hold any queue lock.
+ */
+static isc__task_t *
+steal_task(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
+	isc__task_t *task = NULL;
+	unsigned int i;
+
+	for (i = 1; i < manager->workers && task == NULL; i++) {
+		isc__taskqueue_t *victim;
+
+		victim = &manager->queues[(queue->threadid + i) %
+					  manager->workers];
+		/*
+		 * Peek without the lock first; a stale value only
+		 * means that we miss or mistime one steal attempt.
+		 */
+		if (victim->tasks_ready == 0)
+			continue;
+
+		LOCK(&victim->lock);
+		task = pop_readyq(manager, victim);
+		if (task != NULL)
+			task->threadid = queue->threadid;
+		UNLOCK(&victim->lock);
+	}
+
+	if (task != NULL) {
+		LOCK(&queue->lock);
+		queue->steals++;
+		UNLOCK(&queue->lock);
+	}
+
+	return (task);
+}
+
+/*
+ * Return ISC_TRUE if any queue has a privileged task ready to run.
+ *
+ * Caller must hold the task manager lock.
+ */
+static isc_boolean_t
+priority_ready(isc__taskmgr_t *manager) {
+	isc_boolean_t ready = ISC_FALSE;
+	unsigned int i;
+
+	for (i = 0; i < manager->workers && !ready; i++) {
+		isc__taskqueue_t *queue = &manager->queues[i];
+
+		LOCK(&queue->lock);
+		ready = ISC_TF(!EMPTY(queue->ready_priority_tasks));
+		UNLOCK(&queue->lock);
+	}
+
+	return (ready);
+}
+
+static void
+dispatch(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
 	isc__task_t *task;
-#ifndef USE_WORKER_THREADS
-	unsigned int total_dispatch_count = 0;
-	isc__tasklist_t new_ready_tasks;
-	isc__tasklist_t new_priority_tasks;
-	unsigned int tasks_ready = 0;
-#endif /* USE_WORKER_THREADS */
 
 	REQUIRE(VALID_MANAGER(manager));
 
 	/*
-	 * Again we're trying to hold the lock for as short a time as possible
-	 * and to do as little locking and unlocking as possible.
-	 *
-	 * In both while loops, the appropriate lock must be held before the
-	 * while body starts.  Code which acquired the lock at the top of
-	 * the loop would be more readable, but would result in a lot of
-	 * extra locking.  Compare:
-	 *
-	 * Straightforward:
-	 *
-	 *	LOCK();
-	 *	...
-	 *	UNLOCK();
-	 *	while (expression) {
-	 *		LOCK();
-	 *		...
-	 *		UNLOCK();
-	 *
-	 *	       	Unlocked part here...
-	 *
-	 *		LOCK();
-	 *		...
-	 *		UNLOCK();
-	 *	}
-	 *
-	 * Note how if the loop continues we unlock and then immediately lock.
-	 * For N iterations of the loop, this code does 2N+1 locks and 2N+1
-	 * unlocks.  Also note that the lock is not held when the while
-	 * condition is tested, which may or may not be important, depending
-	 * on the expression.
-	 *
-	 * As written:
-	 *
-	 *	LOCK();
-	 *	while (expression) {
-	 *		...
-	 *		UNLOCK();
-	 *
-	 *	       	Unlocked part here...
-	 *
-	 *		LOCK();
-	 *		...
-	 *	}
-	 *	UNLOCK();
-	 *
-	 * For N iterations of the loop, this code does N+1 locks and N+1
-	 * unlocks.  The while expression is always protected by the lock.
+	 * The manager lock is only taken when a worker changes between
+	 * being busy and being idle, so that pause and exclusive mode
+	 * requests can count the busy workers.  While there is work on
+	 * its own queue, or work it can steal, a worker only takes
+	 * the queue locks.
 	 */
-
-#ifndef USE_WORKER_THREADS
-	ISC_LIST_INIT(new_ready_tasks);
-	ISC_LIST_INIT(new_priority_tasks);
-#endif
 	LOCK(&manager->lock);
-
 	while (!FINISHED(manager)) {
-#ifdef USE_WORKER_THREADS
 		/*
-		 * For reasons similar to those given in the comment in
-		 * isc_task_send() above, it is safe for us to dequeue
-		 * the task while only holding the manager lock, and then
-		 * change the task to running state while only holding the
-		 * task lock.
-		 *
-		 * If a pause has been requested, don't do any work
-		 * until it's been released.
+		 * If a pause or exclusive mode has been requested,
+		 * don't do any work until it's been released.
 		 */
-		while ((empty_readyq(manager) || manager->pause_requested ||
-			manager->exclusive_requested) && !FINISHED(manager))
-		{
+		if (HALTED(manager)) {
 			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
 						    ISC_MSGSET_GENERAL,
 						    ISC_MSG_WAIT, "wait"));
-			WAIT(&manager->work_available, &manager->lock);
+			WAIT(&manager->halt_released, &manager->lock);
 			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
 						    ISC_MSGSET_TASK,
 						    ISC_MSG_AWAKE, "awake"));
+			continue;
 		}
-#else /* USE_WORKER_THREADS */
-		if (total_dispatch_count >= DEFAULT_TASKMGR_QUANTUM ||
-		    empty_readyq(manager))
-			break;
-#endif /* USE_WORKER_THREADS */
+
+		manager->tasks_running++;
+		UNLOCK(&manager->lock);
+
 		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
 					    ISC_MSG_WORKING, "working"));
+		do {
+			unsigned int dispatched = 0;
 
-		task = pop_readyq(manager);
-		if (task != NULL) {
-			unsigned int dispatch_count = 0;
-			isc_boolean_t done = ISC_FALSE;
-			isc_boolean_t requeue = ISC_FALSE;
-			isc_boolean_t finished = ISC_FALSE;
-			isc_event_t *event;
+			LOCK(&queue->lock);
+			task = pop_readyq(manager, queue);
+			UNLOCK(&queue->lock);
+			if (task == NULL)
+				task = steal_task(manager, queue);
+			if (task == NULL)
+				break;
 
-			INSIST(VALID_TASK(task));
+			if (task_run(task, &dispatched)) {
+				isc_boolean_t backlog;
 
-			/*
-			 * Note we only unlock the manager lock if we actually
-			 * have a task to do.  We must reacquire the manager
-			 * lock before exiting the 'if (task != NULL)' block.
-			 */
-			manager->tasks_ready--;
-			manager->tasks_running++;
-			UNLOCK(&manager->lock);
-
-			LOCK(&task->lock);
-			INSIST(task->state == task_state_ready);
-			task->state = task_state_running;
-			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-					      ISC_MSG_RUNNING, "running"));
-			TIME_NOW(&task->tnow);
-			task->now = isc_time_seconds(&task->tnow);
-			do {
-				if (!EMPTY(task->events)) {
-					event = HEAD(task->events);
-					DEQUEUE(task->events, event, ev_link);
-					task->nevents--;
-
-					/*
-					 * Execute the event action.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							    ISC_MSGSET_TASK,
-							    ISC_MSG_EXECUTE,
-							    "execute action"));
-					if (event->ev_action != NULL) {
-						UNLOCK(&task->lock);
-						(event->ev_action)(
-							(isc_task_t *)task,
-							event);
-						LOCK(&task->lock);
-					}
-					dispatch_count++;
-#ifndef USE_WORKER_THREADS
-					total_dispatch_count++;
-#endif /* USE_WORKER_THREADS */
-				}
-
-				if (task->references == 0 &&
-				    EMPTY(task->events) &&
-				    !TASK_SHUTTINGDOWN(task)) {
-					isc_boolean_t was_idle;
-
-					/*
-					 * There are no references and no
-					 * pending events for this task,
-					 * which means it will not become
-					 * runnable again via an external
-					 * action (such as sending an event
-					 * or detaching).
-					 *
-					 * We initiate shutdown to prevent
-					 * it from becoming a zombie.
-					 *
-					 * We do this here instead of in
-					 * the "if EMPTY(task->events)" block
-					 * below because:
-					 *
-					 *	If we post no shutdown events,
-					 *	we want the task to finish.
-					 *
-					 *	If we did post shutdown events,
-					 *	will still want the task's
-					 *	quantum to be applied.
-					 */
-					was_idle = task_shutdown(task);
-					INSIST(!was_idle);
-				}
-
-				if (EMPTY(task->events)) {
-					/*
-					 * Nothing else to do for this task
-					 * right now.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							      ISC_MSGSET_TASK,
-							      ISC_MSG_EMPTY,
-							      "empty"));
-					if (task->references == 0 &&
-					    TASK_SHUTTINGDOWN(task)) {
-						/*
-						 * The task is done.
-						 */
-						XTRACE(isc_msgcat_get(
-							       isc_msgcat,
-							       ISC_MSGSET_TASK,
-							       ISC_MSG_DONE,
-							       "done"));
-						finished = ISC_TRUE;
-						task->state = task_state_done;
-					} else
-						task->state = task_state_idle;
-					done = ISC_TRUE;
-				} else if (dispatch_count >= task->quantum) {
-					/*
-					 * Our quantum has expired, but
-					 * there is more work to be done.
-					 * We'll requeue it to the ready
-					 * queue later.
-					 *
-					 * We don't check quantum until
-					 * dispatching at least one event,
-					 * so the minimum quantum is one.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							      ISC_MSGSET_TASK,
-							      ISC_MSG_QUANTUM,
-							      "quantum"));
-					task->state = task_state_ready;
-					requeue = ISC_TRUE;
-					done = ISC_TRUE;
-				}
-			} while (!done);
-			UNLOCK(&task->lock);
-
-			if (finished)
-				task_finished(task);
-
-			LOCK(&manager->lock);
-			manager->tasks_running--;
-#ifdef USE_WORKER_THREADS
-			if (manager->exclusive_requested &&
-			    manager->tasks_running == 1) {
-				SIGNAL(&manager->exclusive_granted);
-			} else if (manager->pause_requested &&
-				   manager->tasks_running == 0) {
-				SIGNAL(&manager->paused);
-			}
-#endif /* USE_WORKER_THREADS */
-			if (requeue) {
 				/*
-				 * We know we're awake, so we don't have
-				 * to wakeup any sleeping threads if the
-				 * ready queue is empty before we requeue.
-				 *
-				 * A possible optimization if the queue is
-				 * empty is to 'goto' the 'if (task != NULL)'
-				 * block, avoiding the ENQUEUE of the task
-				 * and the subsequent immediate DEQUEUE
-				 * (since it is the only executable task).
-				 * We don't do this because then we'd be
-				 * skipping the exit_requested check.  The
-				 * cost of ENQUEUE is low anyway, especially
-				 * when you consider that we'd have to do
-				 * an extra EMPTY check to see if we could
-				 * do the optimization.  If the ready queue
-				 * were usually nonempty, the 'optimization'
-				 * might even hurt rather than help.
+				 * The task's quantum has expired.  Put it
+				 * back on our own queue; if that leaves
+				 * more work than we can do right away and
+				 * another worker is idle, let it help.
 				 */
-#ifdef USE_WORKER_THREADS
-				push_readyq(manager, task);
-#else
-				ENQUEUE(new_ready_tasks, task, ready_link);
-				if ((task->flags & TASK_F_PRIVILEGED) != 0)
-					ENQUEUE(new_priority_tasks, task,
-						ready_priority_link);
-				tasks_ready++;
-#endif
+				LOCK(&queue->lock);
+				push_readyq(manager, queue, task);
+				backlog = ISC_TF(queue->tasks_ready > 1);
+				UNLOCK(&queue->lock);
+				if (backlog &&
+				    read_counter(manager,
+						 &manager->idle_workers) > 0)
+					wake_idle_worker(manager, queue);
 			}
+		} while (read_counter(manager, &manager->halts) == 0);
+
+		LOCK(&manager->lock);
+		manager->tasks_running--;
+		if (manager->exclusive_requested &&
+		    manager->tasks_running == 1) {
+			SIGNAL(&manager->exclusive_granted);
+		} else if (manager->pause_requested &&
+			   manager->tasks_running == 0) {
+			SIGNAL(&manager->paused);
 		}
 
-#ifdef USE_WORKER_THREADS
+		if (task != NULL || HALTED(manager) || FINISHED(manager))
+			continue;
+
 		/*
 		 * If we are in privileged execution mode and there are no
-		 * tasks remaining on the current ready queue, then
-		 * we're stuck.  Automatically drop privileges at that
-		 * point and continue with the regular ready queue.
+		 * tasks remaining on the priority queues, then we're
+		 * stuck.  Automatically drop privileges at that point and
+		 * continue with the regular ready queues.
 		 */
-		if (manager->tasks_running == 0 && empty_readyq(manager)) {
+		if (manager->mode != isc_taskmgrmode_normal &&
+		    manager->tasks_running == 0 && !priority_ready(manager))
+		{
 			manager->mode = isc_taskmgrmode_normal;
-			if (!empty_readyq(manager))
-				BROADCAST(&manager->work_available);
+			wake_all_workers(manager);
+			continue;
 		}
-#endif
-	}
-
-#ifndef USE_WORKER_THREADS
-	ISC_LIST_APPENDLIST(manager->ready_tasks, new_ready_tasks, ready_link);
-	ISC_LIST_APPENDLIST(manager->ready_priority_tasks, new_priority_tasks,
-			    ready_priority_link);
-	manager->tasks_ready += tasks_ready;
-	if (empty_readyq(manager))
-		manager->mode = isc_taskmgrmode_normal;
-#endif
 
+		/*
+		 * Nothing to do.  We mark ourselves as sleeping before
+		 * releasing the manager lock, so that anything which
+		 * changes the manager state under that lock and then
+		 * calls wake_all_workers() will wake us up.
+		 */
+		adjust_counter(&manager->idle_workers, 1);
+		LOCK(&queue->lock);
+		UNLOCK(&manager->lock);
+		if (empty_readyq(manager, queue)) {
+			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+						    ISC_MSGSET_GENERAL,
+						    ISC_MSG_WAIT, "wait"));
+			queue->sleeping = ISC_TRUE;
+			while (queue->sleeping)
+				WAIT(&queue->work_available, &queue->lock);
+			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+						    ISC_MSGSET_TASK,
+						    ISC_MSG_AWAKE, "awake"));
+		}
+		UNLOCK(&queue->lock);
+		LOCK(&manager->lock);
+		adjust_counter(&manager->idle_workers, -1);
+	}
 	UNLOCK(&manager->lock);
 }
 
-#ifdef USE_WORKER_THREADS
 static isc_threadresult_t
 #ifdef _WIN32
 WINAPI
 #endif
 run(void *uap) {
-	isc__taskmgr_t *manager = uap;
+	isc__taskqueue_t *queue = uap;
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_STARTING, "starting"));
 
-	dispatch(manager);
+	dispatch(queue->manager, queue);
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_EXITING, "exiting"));
@@ -1320,15 +1488,137 @@ run(void *uap) {
 
 	return ((isc_threadresult_t)0);
 }
+#else /* USE_WORKER_THREADS */
+static void
+dispatch(isc__taskmgr_t *manager) {
+	isc__taskqueue_t *queue = &manager->queues[0];
+	isc__task_t *task;
+	unsigned int total_dispatch_count = 0;
+	isc__tasklist_t new_ready_tasks;
+	isc__tasklist_t new_priority_tasks;
+	unsigned int tasks_ready = 0;
+
+	REQUIRE(VALID_MANAGER(manager));
+
+	/*
+	 * Again we're trying to hold the lock for as short a time as possible
+	 * and to do as little locking and unlocking as possible.
+	 *
+	 * In the while loop, the lock must be held before the while body
+	 * starts.  Code which acquired the lock at the top of the loop
+	 * would be more readable, but would result in a lot of extra
+	 * locking.  For N iterations of the loop, this code does N+1
+	 * locks and N+1 unlocks, and the while expression is always
+	 * protected by the lock.
+	 */
+
+	ISC_LIST_INIT(new_ready_tasks);
+	ISC_LIST_INIT(new_priority_tasks);
+	LOCK(&queue->lock);
+
+	while (!FINISHED(manager)) {
+		if (total_dispatch_count >= DEFAULT_TASKMGR_QUANTUM ||
+		    empty_readyq(manager, queue))
+			break;
+		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					    ISC_MSG_WORKING, "working"));
+
+		task = pop_readyq(manager, queue);
+		if (task != NULL) {
+			isc_boolean_t requeue;
+
+			/*
+			 * Note we only unlock the queue lock if we actually
+			 * have a task to do.  We must reacquire the queue
+			 * lock before exiting the 'if (task != NULL)' block.
+			 */
+			manager->tasks_running++;
+			UNLOCK(&queue->lock);
+
+			requeue = task_run(task, &total_dispatch_count);
+
+			LOCK(&queue->lock);
+			manager->tasks_running--;
+			if (requeue) {
+				/*
+				 * Tasks whose quantum has expired are
+				 * collected separately and only put back on
+				 * the ready queue after the loop, so that
+				 * other tasks get their turn in this call.
+				 */
+				ENQUEUE(new_ready_tasks, task, ready_link);
+				if ((task->flags & TASK_F_PRIVILEGED) != 0)
+					ENQUEUE(new_priority_tasks, task,
+						ready_priority_link);
+				tasks_ready++;
+			}
+		}
+	}
+
+	ISC_LIST_APPENDLIST(queue->ready_tasks, new_ready_tasks, ready_link);
+	ISC_LIST_APPENDLIST(queue->ready_priority_tasks, new_priority_tasks,
+			    ready_priority_link);
+	queue->tasks_ready += tasks_ready;
+	if (empty_readyq(manager, queue))
+		manager->mode = isc_taskmgrmode_normal;
+
+	UNLOCK(&queue->lock);
+}
 #endif /* USE_WORKER_THREADS */
 
+static isc_result_t
+queue_init(isc__taskmgr_t *manager, isc__taskqueue_t *queue,
+	   unsigned int threadid)
+{
+	isc_result_t result;
+
+	queue->manager = manager;
+	queue->threadid = threadid;
+	INIT_LIST(queue->ready_tasks);
+	INIT_LIST(queue->ready_priority_tasks);
+	queue->tasks_ready = 0;
+	result = isc_mutex_init(&queue->lock);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+#ifdef USE_WORKER_THREADS
+	queue->sleeping = ISC_FALSE;
+	queue->steals = 0;
+	if (isc_condition_init(&queue->work_available) != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_condition_init() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+		DESTROYLOCK(&queue->lock);
+		return (ISC_R_UNEXPECTED);
+	}
+#endif /* USE_WORKER_THREADS */
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+queue_destroy(isc__taskqueue_t *queue) {
+	INSIST(EMPTY(queue->ready_tasks));
+	INSIST(EMPTY(queue->ready_priority_tasks));
+
+#ifdef USE_WORKER_THREADS
+	(void)isc_condition_destroy(&queue->work_available);
+#endif /* USE_WORKER_THREADS */
+	DESTROYLOCK(&queue->lock);
+}
+
 static void
 manager_free(isc__taskmgr_t *manager) {
 	isc_mem_t *mctx;
+	unsigned int i;
 
+	for (i = 0; i < manager->nqueues; i++)
+		queue_destroy(&manager->queues[i]);
+	isc_mem_put(manager->mctx, manager->queues,
+		    manager->nqueues * sizeof(isc__taskqueue_t));
 #ifdef USE_WORKER_THREADS
 	(void)isc_condition_destroy(&manager->exclusive_granted);
-	(void)isc_condition_destroy(&manager->work_available);
+	(void)isc_condition_destroy(&manager->halt_released);
 	(void)isc_condition_destroy(&manager->paused);
 	isc_mem_free(manager->mctx, manager->threads);
 #endif /* USE_WORKER_THREADS */
@@ -1400,7 +1690,7 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		result = ISC_R_NOMEMORY;
 		goto cleanup_lock;
 	}
-	if (isc_condition_init(&manager->work_available) != ISC_R_SUCCESS) {
+	if (isc_condition_init(&manager->halt_released) != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_condition_init() %s",
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
@@ -1414,7 +1704,7 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"));
 		result = ISC_R_UNEXPECTED;
-		goto cleanup_workavailable;
+		goto cleanup_haltreleased;
 	}
 	if (isc_condition_init(&manager->paused) != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -1424,15 +1714,36 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		result = ISC_R_UNEXPECTED;
 		goto cleanup_exclusivegranted;
 	}
+	manager->idle_workers = 0;
+	manager->halts = 0;
+	manager->nqueues = workers;
+#else /* USE_WORKER_THREADS */
+	manager->nqueues = 1;
 #endif /* USE_WORKER_THREADS */
+	manager->queues = isc_mem_get(mctx, manager->nqueues *
+				      sizeof(isc__taskqueue_t));
+	if (manager->queues == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_conditions;
+	}
+	for (i = 0; i < manager->nqueues; i++) {
+		result = queue_init(manager, &manager->queues[i], i);
+		if (result != ISC_R_SUCCESS) {
+			while (i > 0)
+				queue_destroy(&manager->queues[--i]);
+			isc_mem_put(mctx, manager->queues, manager->nqueues *
+				    sizeof(isc__taskqueue_t));
+			goto cleanup_conditions;
+		}
+	}
 	if (default_quantum == 0)
 		default_quantum = DEFAULT_DEFAULT_QUANTUM;
 	manager->default_quantum = default_quantum;
 	INIT_LIST(manager->tasks);
-	INIT_LIST(manager->ready_tasks);
-	INIT_LIST(manager->ready_priority_tasks);
+#ifdef USE_WORKER_THREADS
+	manager->curq = 0;
+#endif /* USE_WORKER_THREADS */
 	manager->tasks_running = 0;
-	manager->tasks_ready = 0;
 	manager->exclusive_requested = ISC_FALSE;
 	manager->pause_requested = ISC_FALSE;
 	manager->exiting = ISC_FALSE;
@@ -1446,7 +1757,7 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	 * Start workers.
 	 */
 	for (i = 0; i < workers; i++) {
-		if (isc_thread_create(run, manager,
+		if (isc_thread_create(run, &manager->queues[manager->workers],
 				      &manager->threads[manager->workers]) ==
 		    ISC_R_SUCCESS) {
 			char name[16];	/* thread name limit on Linux */
@@ -1474,16 +1785,19 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 
 	return (ISC_R_SUCCESS);
 
+ cleanup_conditions:
 #ifdef USE_WORKER_THREADS
+	(void)isc_condition_destroy(&manager->paused);
  cleanup_exclusivegranted:
 	(void)isc_condition_destroy(&manager->exclusive_granted);
- cleanup_workavailable:
-	(void)isc_condition_destroy(&manager->work_available);
+ cleanup_haltreleased:
+	(void)isc_condition_destroy(&manager->halt_released);
  cleanup_threads:
 	isc_mem_free(mctx, manager->threads);
  cleanup_lock:
-	DESTROYLOCK(&manager->lock);
 #endif
+	DESTROYLOCK(&manager->excl_lock);
+	DESTROYLOCK(&manager->lock);
  cleanup_mgr:
 	isc_mem_put(mctx, manager, sizeof(*manager));
 	return (result);
@@ -1562,8 +1876,14 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	     task != NULL;
 	     task = NEXT(task, link)) {
 		LOCK(&task->lock);
-		if (task_shutdown(task))
-			push_readyq(manager, task);
+		if (task_shutdown(task)) {
+			isc__taskqueue_t *queue;
+
+			queue = &manager->queues[task->threadid];
+			LOCK(&queue->lock);
+			push_readyq(manager, queue, task);
+			UNLOCK(&queue->lock);
+		}
 		UNLOCK(&task->lock);
 	}
 #ifdef USE_WORKER_THREADS
@@ -1572,7 +1892,7 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	 * there's work left to do, and if there are already no tasks left
 	 * it will cause the workers to see manager->exiting.
 	 */
-	BROADCAST(&manager->work_available);
+	wake_all_workers(manager);
 	UNLOCK(&manager->lock);
 
 	/*
@@ -1606,6 +1926,14 @@ isc__taskmgr_setmode(isc_taskmgr_t *manager0, isc_taskmgrmode_t mode) {
 
 	LOCK(&manager->lock);
 	manager->mode = mode;
+#ifdef USE_WORKER_THREADS
+	/*
+	 * Workers may be sleeping on queues that only hold tasks
+	 * which were not runnable in the old mode.
+	 */
+	if (mode == isc_taskmgrmode_normal)
+		wake_all_workers(manager);
+#endif /* USE_WORKER_THREADS */
 	UNLOCK(&manager->lock);
 }
 
@@ -1632,9 +1960,9 @@ isc__taskmgr_ready(isc_taskmgr_t *manager0) {
 	if (manager == NULL)
 		return (ISC_FALSE);
 
-	LOCK(&manager->lock);
-	is_ready = !empty_readyq(manager);
-	UNLOCK(&manager->lock);
+	LOCK(&manager->queues[0].lock);
+	is_ready = !empty_readyq(manager, &manager->queues[0]);
+	UNLOCK(&manager->queues[0].lock);
 
 	return (is_ready);
 }
@@ -1659,8 +1987,11 @@ isc__taskmgr_dispatch(isc_taskmgr_t *manager0) {
 void
 isc__taskmgr_pause(isc_taskmgr_t *manager0) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
-	manager->pause_requested = ISC_TRUE;
+
 	LOCK(&manager->lock);
+	if (!manager->pause_requested)
+		adjust_counter(&manager->halts, 1);
+	manager->pause_requested = ISC_TRUE;
 	while (manager->tasks_running > 0) {
 		WAIT(&manager->paused, &manager->lock);
 	}
@@ -1674,7 +2005,8 @@ isc__taskmgr_resume(isc_taskmgr_t *manager0) {
 	LOCK(&manager->lock);
 	if (manager->pause_requested) {
 		manager->pause_requested = ISC_FALSE;
-		BROADCAST(&manager->work_available);
+		adjust_counter(&manager->halts, -1);
+		BROADCAST(&manager->halt_released);
 	}
 	UNLOCK(&manager->lock);
 }
@@ -1730,6 +2062,7 @@ isc__task_beginexclusive(isc_task_t *task0) {
 		return (ISC_R_LOCKBUSY);
 	}
 	manager->exclusive_requested = ISC_TRUE;
+	adjust_counter(&manager->halts, 1);
 	while (manager->tasks_running > 1) {
 		WAIT(&manager->exclusive_granted, &manager->lock);
 	}
@@ -1750,7 +2083,8 @@ isc__task_endexclusive(isc_task_t *task0) {
 	LOCK(&manager->lock);
 	REQUIRE(manager->exclusive_requested);
 	manager->exclusive_requested = ISC_FALSE;
-	BROADCAST(&manager->work_available);
+	adjust_counter(&manager->halts, -1);
+	BROADCAST(&manager->halt_released);
 	UNLOCK(&manager->lock);
 #else
 	UNUSED(task0);
@@ -1761,6 +2095,7 @@ void
 isc__task_setprivilege(isc_task_t *task0, isc_boolean_t priv) {
 	isc__task_t *task = (isc__task_t *)task0;
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue;
 	isc_boolean_t oldpriv;
 
 	LOCK(&task->lock);
@@ -1774,14 +2109,26 @@ isc__task_setprivilege(isc_task_t *task0, isc_boolean_t priv) {
 	if (priv == oldpriv)
 		return;
 
-	LOCK(&manager->lock);
+	/*
+	 * The task may be stolen by another worker while we are trying
+	 * to lock its queue; if so, try again with the new queue.
+	 */
+	for (;;) {
+		unsigned int threadid = task->threadid;
+
+		queue = &manager->queues[threadid];
+		LOCK(&queue->lock);
+		if (task->threadid == threadid)
+			break;
+		UNLOCK(&queue->lock);
+	}
 	if (priv && ISC_LINK_LINKED(task, ready_link))
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
 	else if (!priv && ISC_LINK_LINKED(task, ready_priority_link))
-		DEQUEUE(manager->ready_priority_tasks, task,
+		DEQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	UNLOCK(&manager->lock);
+	UNLOCK(&queue->lock);
 }
 
 isc_boolean_t
@@ -1815,10 +2162,17 @@ int
 isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *)mgr0;
 	isc__task_t *task = NULL;
+	unsigned int i, tasks_ready = 0;
 	int xmlrc;
 
 	LOCK(&mgr->lock);
 
+	for (i = 0; i < mgr->nqueues; i++) {
+		LOCK(&mgr->queues[i].lock);
+		tasks_ready += mgr->queues[i].tasks_ready;
+		UNLOCK(&mgr->queues[i].lock);
+	}
+
 	/*
 	 * Write out the thread-model, and some details about each depending
 	 * on which type is enabled.
@@ -1852,9 +2206,43 @@ isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-running */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-ready"));
-	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_ready));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%d", tasks_ready));
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-ready */
 
+#ifdef ISC_PLATFORM_USETHREADS
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "workers"));
+	for (i = 0; i < mgr->workers; i++) {
+		isc__taskqueue_t *queue = &mgr->queues[i];
+		unsigned int depth;
+		isc_uint64_t steals;
+
+		LOCK(&queue->lock);
+		depth = queue->tasks_ready;
+		steals = queue->steals;
+		UNLOCK(&queue->lock);
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "worker"));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "id"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%u", i));
+		TRY0(xmlTextWriterEndElement(writer)); /* id */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "queue-depth"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%u", depth));
+		TRY0(xmlTextWriterEndElement(writer)); /* queue-depth */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "steals"));
+		TRY0(xmlTextWriterWriteFormatString(writer,
+						    "%" ISC_PRINT_QUADFORMAT "u",
+						    steals));
+		TRY0(xmlTextWriterEndElement(writer)); /* steals */
+
+		TRY0(xmlTextWriterEndElement(writer)); /* worker */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* workers */
+#endif /* ISC_PLATFORM_USETHREADS */
+
 	TRY0(xmlTextWriterEndElement(writer)); /* thread-model */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks"));
@@ -1926,9 +2314,16 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *)mgr0;
 	isc__task_t *task = NULL;
 	json_object *obj = NULL, *array = NULL, *taskobj = NULL;
+	unsigned int i, tasks_ready = 0;
 
 	LOCK(&mgr->lock);
 
+	for (i = 0; i < mgr->nqueues; i++) {
+		LOCK(&mgr->queues[i].lock);
+		tasks_ready += mgr->queues[i].tasks_ready;
+		UNLOCK(&mgr->queues[i].lock);
+	}
+
 	/*
 	 * Write out the thread-model, and some details about each depending
 	 * on which type is enabled.
@@ -1959,10 +2354,46 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "tasks-running", obj);
 
-	obj = json_object_new_int(mgr->tasks_ready);
+	obj = json_object_new_int(tasks_ready);
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "tasks-ready", obj);
 
+#ifdef ISC_PLATFORM_USETHREADS
+	array = json_object_new_array();
+	CHECKMEM(array);
+
+	for (i = 0; i < mgr->workers; i++) {
+		isc__taskqueue_t *queue = &mgr->queues[i];
+		json_object *workerobj;
+		unsigned int depth;
+		isc_uint64_t steals;
+
+		LOCK(&queue->lock);
+		depth = queue->tasks_ready;
+		steals = queue->steals;
+		UNLOCK(&queue->lock);
+
+		workerobj = json_object_new_object();
+		CHECKMEM(workerobj);
+		json_object_array_add(array, workerobj);
+
+		obj = json_object_new_int(i);
+		CHECKMEM(obj);
+		json_object_object_add(workerobj, "id", obj);
+
+		obj = json_object_new_int(depth);
+		CHECKMEM(obj);
+		json_object_object_add(workerobj, "queue-depth", obj);
+
+		obj = json_object_new_int64(steals);
+		CHECKMEM(obj);
+		json_object_object_add(workerobj, "steals", obj);
+	}
+
+	json_object_object_add(tasks, "workers", array);
+	array = NULL;
+#endif /* ISC_PLATFORM_USETHREADS */
+
 	array = json_object_new_array();
 	CHECKMEM(array);
 
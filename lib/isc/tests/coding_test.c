@@ -0,0 +1,1064 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/*
+ * Differential tests for the base64, base32 and hex encoders and
+ * decoders: random data, and random damage to its encoding, must give
+ * the same results, output and errors as the character at a time
+ * versions they replaced, which are kept below for reference.
+ */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/base32.h>
+#include <isc/base64.h>
+#include <isc/buffer.h>
+#include <isc/hex.h>
+#include <isc/lex.h>
+#include <isc/mem.h>
+#include <isc/util.h>
+
+#define RETERR(x) do { \
+	isc_result_t _r = (x); \
+	if (_r != ISC_R_SUCCESS) \
+		return (_r); \
+	} while (0)
+
+#define TRIALS		5000
+#define MAXDATA		100
+#define MAXTEXT		1024
+
+static isc_result_t
+str_totext(const char *source, isc_buffer_t *target) {
+	unsigned int l;
+	isc_region_t region;
+
+	isc_buffer_availableregion(target, &region);
+	l = strlen(source);
+
+	if (l > region.length)
+		return (ISC_R_NOSPACE);
+
+	memmove(region.base, source, l);
+	isc_buffer_add(target, l);
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+mem_tobuffer(isc_buffer_t *target, void *base, unsigned int length) {
+	isc_region_t tr;
+
+	isc_buffer_availableregion(target, &tr);
+	if (length > tr.length)
+		return (ISC_R_NOSPACE);
+	memmove(tr.base, base, length);
+	isc_buffer_add(target, length);
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * lib/isc/base64.c as it was.
+ */
+static const char old_base64[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=";
+
+static isc_result_t
+old_base64_totext(isc_region_t *source, int wordlength,
+		  const char *wordbreak, isc_buffer_t *target)
+{
+	char buf[5];
+	unsigned int loops = 0;
+
+	if (wordlength < 4)
+		wordlength = 4;
+
+	memset(buf, 0, sizeof(buf));
+	while (source->length > 2) {
+		buf[0] = old_base64[(source->base[0]>>2)&0x3f];
+		buf[1] = old_base64[((source->base[0]<<4)&0x30)|
+				((source->base[1]>>4)&0x0f)];
+		buf[2] = old_base64[((source->base[1]<<2)&0x3c)|
+				((source->base[2]>>6)&0x03)];
+		buf[3] = old_base64[source->base[2]&0x3f];
+		RETERR(str_totext(buf, target));
+		isc_region_consume(source, 3);
+
+		loops++;
+		if (source->length != 0 &&
+		    (int)((loops + 1) * 4) >= wordlength)
+		{
+			loops = 0;
+			RETERR(str_totext(wordbreak, target));
+		}
+	}
+	if (source->length == 2) {
+		buf[0] = old_base64[(source->base[0]>>2)&0x3f];
+		buf[1] = old_base64[((source->base[0]<<4)&0x30)|
+				((source->base[1]>>4)&0x0f)];
+		buf[2] = old_base64[((source->base[1]<<2)&0x3c)];
+		buf[3] = '=';
+		RETERR(str_totext(buf, target));
+		isc_region_consume(source, 2);
+	} else if (source->length == 1) {
+		buf[0] = old_base64[(source->base[0]>>2)&0x3f];
+		buf[1] = old_base64[((source->base[0]<<4)&0x30)];
+		buf[2] = buf[3] = '=';
+		RETERR(str_totext(buf, target));
+		isc_region_consume(source, 1);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * State of a base64 decoding process in progress.
+ */
+typedef struct {
+	int length;		/*%< Desired length of binary data or -1 */
+	isc_buffer_t *target;	/*%< Buffer for resulting binary data */
+	int digits;		/*%< Number of buffered base64 digits */
+	isc_boolean_t seen_end;	/*%< True if "=" end marker seen */
+	int val[4];
+} old_base64_decode_ctx_t;
+
+static inline void
+old_base64_decode_init(old_base64_decode_ctx_t *ctx, int length,
+		       isc_buffer_t *target)
+{
+	ctx->digits = 0;
+	ctx->seen_end = ISC_FALSE;
+	ctx->length = length;
+	ctx->target = target;
+}
+
+static inline isc_result_t
+old_base64_decode_char(old_base64_decode_ctx_t *ctx, int c) {
+	const char *s;
+
+	if (ctx->seen_end)
+		return (ISC_R_BADBASE64);
+	if ((s = strchr(old_base64, c)) == NULL)
+		return (ISC_R_BADBASE64);
+	ctx->val[ctx->digits++] = (int)(s - old_base64);
+	if (ctx->digits == 4) {
+		int n;
+		unsigned char buf[3];
+		if (ctx->val[0] == 64 || ctx->val[1] == 64)
+			return (ISC_R_BADBASE64);
+		if (ctx->val[2] == 64 && ctx->val[3] != 64)
+			return (ISC_R_BADBASE64);
+		/*
+		 * Check that bits that should be zero are.
+		 */
+		if (ctx->val[2] == 64 && (ctx->val[1] & 0xf) != 0)
+			return (ISC_R_BADBASE64);
+		/*
+		 * We don't need to test for ctx->val[2] != 64 as
+		 * the bottom two bits of 64 are zero.
+		 */
+		if (ctx->val[3] == 64 && (ctx->val[2] & 0x3) != 0)
+			return (ISC_R_BADBASE64);
+		n = (ctx->val[2] == 64) ? 1 :
+			(ctx->val[3] == 64) ? 2 : 3;
+		if (n != 3) {
+			ctx->seen_end = ISC_TRUE;
+			if (ctx->val[2] == 64)
+				ctx->val[2] = 0;
+			if (ctx->val[3] == 64)
+				ctx->val[3] = 0;
+		}
+		buf[0] = (ctx->val[0]<<2)|(ctx->val[1]>>4);
+		buf[1] = (ctx->val[1]<<4)|(ctx->val[2]>>2);
+		buf[2] = (ctx->val[2]<<6)|(ctx->val[3]);
+		RETERR(mem_tobuffer(ctx->target, buf, n));
+		if (ctx->length >= 0) {
+			if (n > ctx->length)
+				return (ISC_R_BADBASE64);
+			else
+				ctx->length -= n;
+		}
+		ctx->digits = 0;
+	}
+	return (ISC_R_SUCCESS);
+}
+
+static inline isc_result_t
+old_base64_decode_finish(old_base64_decode_ctx_t *ctx) {
+	if (ctx->length > 0)
+		return (ISC_R_UNEXPECTEDEND);
+	if (ctx->digits != 0)
+		return (ISC_R_BADBASE64);
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+old_base64_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
+	old_base64_decode_ctx_t ctx;
+	isc_textregion_t *tr;
+	isc_token_t token;
+	isc_boolean_t eol;
+
+	old_base64_decode_init(&ctx, length, target);
+
+	while (!ctx.seen_end && (ctx.length != 0)) {
+		unsigned int i;
+
+		if (length > 0)
+			eol = ISC_FALSE;
+		else
+			eol = ISC_TRUE;
+		RETERR(isc_lex_getmastertoken(lexer, &token,
+					      isc_tokentype_string, eol));
+		if (token.type != isc_tokentype_string)
+			break;
+		tr = &token.value.as_textregion;
+		for (i = 0; i < tr->length; i++)
+			RETERR(old_base64_decode_char(&ctx, tr->base[i]));
+	}
+	if (ctx.length < 0 && !ctx.seen_end)
+		isc_lex_ungettoken(lexer, &token);
+	RETERR(old_base64_decode_finish(&ctx));
+	return (ISC_R_SUCCESS);
+}
+
+
+static isc_result_t
+old_base64_decodestring(const char *cstr, isc_buffer_t *target) {
+	old_base64_decode_ctx_t ctx;
+
+	old_base64_decode_init(&ctx, -1, target);
+	for (;;) {
+		int c = *cstr++;
+		if (c == '\0')
+			break;
+		if (c == ' ' || c == '\t' || c == '\n' || c== '\r')
+			continue;
+		RETERR(old_base64_decode_char(&ctx, c));
+	}
+	RETERR(old_base64_decode_finish(&ctx));
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * lib/isc/base32.c as it was.
+ */
+static const char old_base32[] =
+	 "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567=abcdefghijklmnopqrstuvwxyz234567";
+static const char old_base32hex[] =
+	"0123456789ABCDEFGHIJKLMNOPQRSTUV=0123456789abcdefghijklmnopqrstuv";
+
+
+static isc_result_t
+old_base32_totext(isc_region_t *source, int wordlength, const char *wordbreak,
+	      isc_buffer_t *target, const char base[], char pad)
+{
+	char buf[9];
+	unsigned int loops = 0;
+
+	if (wordlength >= 0 && wordlength < 8)
+		wordlength = 8;
+
+	memset(buf, 0, sizeof(buf));
+	while (source->length > 0) {
+		buf[0] = base[((source->base[0]>>3)&0x1f)];	/* 5 + */
+		if (source->length == 1) {
+			buf[1] = base[(source->base[0]<<2)&0x1c];
+			buf[2] = buf[3] = buf[4] = pad;
+			buf[5] = buf[6] = buf[7] = pad;
+			RETERR(str_totext(buf, target));
+			break;
+		}
+		buf[1] = base[((source->base[0]<<2)&0x1c)|	/* 3 = 8 */
+			      ((source->base[1]>>6)&0x03)];	/* 2 + */
+		buf[2] = base[((source->base[1]>>1)&0x1f)];	/* 5 + */
+		if (source->length == 2) {
+			buf[3] = base[(source->base[1]<<4)&0x10];
+			buf[4] = buf[5] = buf[6] = buf[7] = pad;
+			RETERR(str_totext(buf, target));
+			break;
+		}
+		buf[3] = base[((source->base[1]<<4)&0x10)|	/* 1 = 8 */
+			      ((source->base[2]>>4)&0x0f)];	/* 4 + */
+		if (source->length == 3) {
+			buf[4] = base[(source->base[2]<<1)&0x1e];
+			buf[5] = buf[6] = buf[7] = pad;
+			RETERR(str_totext(buf, target));
+			break;
+		}
+		buf[4] = base[((source->base[2]<<1)&0x1e)|	/* 4 = 8 */
+			      ((source->base[3]>>7)&0x01)];	/* 1 + */
+		buf[5] = base[((source->base[3]>>2)&0x1f)];	/* 5 + */
+		if (source->length == 4) {
+			buf[6] = base[(source->base[3]<<3)&0x18];
+			buf[7] = pad;
+			RETERR(str_totext(buf, target));
+			break;
+		}
+		buf[6] = base[((source->base[3]<<3)&0x18)|	/* 2 = 8 */
+			      ((source->base[4]>>5)&0x07)];	/* 3 + */
+		buf[7] = base[source->base[4]&0x1f];		/* 5 = 8 */
+		RETERR(str_totext(buf, target));
+		isc_region_consume(source, 5);
+
+		loops++;
+		if (source->length != 0 && wordlength >= 0 &&
+		    (int)((loops + 1) * 8) >= wordlength)
+		{
+			loops = 0;
+			RETERR(str_totext(wordbreak, target));
+		}
+	}
+	if (source->length > 0)
+		isc_region_consume(source, source->length);
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * State of a base32 decoding process in progress.
+ */
+typedef struct {
+	int length;		/*%< Desired length of binary data or -1 */
+	isc_buffer_t *target;	/*%< Buffer for resulting binary data */
+	int digits;		/*%< Number of buffered base32 digits */
+	isc_boolean_t seen_end;	/*%< True if "=" end marker seen */
+	int val[8];
+	const char *base;	/*%< Which encoding we are using */
+	int seen_32;		/*%< Number of significant bytes if non zero */
+	isc_boolean_t pad;	/*%< Expect padding */
+} old_base32_decode_ctx_t;
+
+static inline void
+old_base32_decode_init(old_base32_decode_ctx_t *ctx, int length,
+		       const char base[], isc_boolean_t pad,
+		       isc_buffer_t *target)
+{
+	ctx->digits = 0;
+	ctx->seen_end = ISC_FALSE;
+	ctx->seen_32 = 0;
+	ctx->length = length;
+	ctx->target = target;
+	ctx->base = base;
+	ctx->pad = pad;
+}
+
+static inline isc_result_t
+old_base32_decode_char(old_base32_decode_ctx_t *ctx, int c) {
+	const char *s;
+	unsigned int last;
+
+	if (ctx->seen_end)
+		return (ISC_R_BADBASE32);
+	if ((s = strchr(ctx->base, c)) == NULL)
+		return (ISC_R_BADBASE32);
+	last = (unsigned int)(s - ctx->base);
+
+	/*
+	 * Handle lower case.
+	 */
+	if (last > 32)
+		last -= 33;
+
+	/*
+	 * Check that padding is contiguous.
+	 */
+	if (last != 32 && ctx->seen_32 != 0)
+		return (ISC_R_BADBASE32);
+
+	/*
+	 * If padding is not permitted flag padding as a error.
+	 */
+	if (last == 32 && !ctx->pad)
+		return (ISC_R_BADBASE32);
+
+	/*
+	 * Check that padding starts at the right place and that
+	 * bits that should be zero are.
+	 * Record how many significant bytes in answer (seen_32).
+	 */
+	if (last == 32 && ctx->seen_32 == 0)
+		switch (ctx->digits) {
+		case 0:
+		case 1:
+			return (ISC_R_BADBASE32);
+		case 2:
+			if ((ctx->val[1]&0x03) != 0)
+				return (ISC_R_BADBASE32);
+			ctx->seen_32 = 1;
+			break;
+		case 3:
+			return (ISC_R_BADBASE32);
+		case 4:
+			if ((ctx->val[3]&0x0f) != 0)
+				return (ISC_R_BADBASE32);
+			ctx->seen_32 = 3;
+			break;
+		case 5:
+			if ((ctx->val[4]&0x01) != 0)
+				return (ISC_R_BADBASE32);
+			ctx->seen_32 = 3;
+			break;
+		case 6:
+			return (ISC_R_BADBASE32);
+		case 7:
+			if ((ctx->val[6]&0x07) != 0)
+				return (ISC_R_BADBASE32);
+			ctx->seen_32 = 4;
+			break;
+		}
+
+	/*
+	 * Zero fill pad values.
+	 */
+	ctx->val[ctx->digits++] = (last == 32) ? 0 : last;
+
+	if (ctx->digits == 8) {
+		int n = 5;
+		unsigned char buf[5];
+
+		if (ctx->seen_32 != 0) {
+			ctx->seen_end = ISC_TRUE;
+			n = ctx->seen_32;
+		}
+		buf[0] = (ctx->val[0]<<3)|(ctx->val[1]>>2);
+		buf[1] = (ctx->val[1]<<6)|(ctx->val[2]<<1)|(ctx->val[3]>>4);
+		buf[2] = (ctx->val[3]<<4)|(ctx->val[4]>>1);
+		buf[3] = (ctx->val[4]<<7)|(ctx->val[5]<<2)|(ctx->val[6]>>3);
+		buf[4] = (ctx->val[6]<<5)|(ctx->val[7]);
+		RETERR(mem_tobuffer(ctx->target, buf, n));
+		if (ctx->length >= 0) {
+			if (n > ctx->length)
+				return (ISC_R_BADBASE32);
+			else
+				ctx->length -= n;
+		}
+		ctx->digits = 0;
+	}
+	return (ISC_R_SUCCESS);
+}
+
+static inline isc_result_t
+old_base32_decode_finish(old_base32_decode_ctx_t *ctx) {
+
+	if (ctx->length > 0)
+		return (ISC_R_UNEXPECTEDEND);
+	/*
+	 * Add missing padding if required.
+	 */
+	if (!ctx->pad && ctx->digits != 0) {
+		ctx->pad = ISC_TRUE;
+		do {
+			RETERR(old_base32_decode_char(ctx, '='));
+		} while (ctx->digits != 0);
+	}
+	if (ctx->digits != 0)
+		return (ISC_R_BADBASE32);
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+old_base32_tobuffer(isc_lex_t *lexer, const char base[], isc_boolean_t pad,
+		isc_buffer_t *target, int length)
+{
+	old_base32_decode_ctx_t ctx;
+	isc_textregion_t *tr;
+	isc_token_t token;
+	isc_boolean_t eol;
+
+	old_base32_decode_init(&ctx, length, base, pad, target);
+
+	while (!ctx.seen_end && (ctx.length != 0)) {
+		unsigned int i;
+
+		if (length > 0)
+			eol = ISC_FALSE;
+		else
+			eol = ISC_TRUE;
+		RETERR(isc_lex_getmastertoken(lexer, &token,
+					      isc_tokentype_string, eol));
+		if (token.type != isc_tokentype_string)
+			break;
+		tr = &token.value.as_textregion;
+		for (i = 0; i < tr->length; i++)
+			RETERR(old_base32_decode_char(&ctx, tr->base[i]));
+	}
+	if (ctx.length < 0 && !ctx.seen_end)
+		isc_lex_ungettoken(lexer, &token);
+	RETERR(old_base32_decode_finish(&ctx));
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+old_base32_decodestring(const char *cstr, const char base[], isc_boolean_t pad,
+			isc_buffer_t *target)
+{
+	old_base32_decode_ctx_t ctx;
+
+	old_base32_decode_init(&ctx, -1, base, pad, target);
+	for (;;) {
+		int c = *cstr++;
+		if (c == '\0')
+			break;
+		if (c == ' ' || c == '\t' || c == '\n' || c== '\r')
+			continue;
+		RETERR(old_base32_decode_char(&ctx, c));
+	}
+	RETERR(old_base32_decode_finish(&ctx));
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+old_base32_decoderegion(isc_region_t *source, const char base[],
+		    isc_boolean_t pad, isc_buffer_t *target)
+{
+	old_base32_decode_ctx_t ctx;
+
+	old_base32_decode_init(&ctx, -1, base, pad, target);
+	while (source->length != 0) {
+		int c = *source->base;
+		RETERR(old_base32_decode_char(&ctx, c));
+		isc_region_consume(source, 1);
+	}
+	RETERR(old_base32_decode_finish(&ctx));
+	return (ISC_R_SUCCESS);
+}
+
+
+/*
+ * lib/isc/hex.c as it was.
+ */
+static const char old_hex[] = "0123456789ABCDEF";
+
+static isc_result_t
+old_hex_totext(isc_region_t *source, int wordlength,
+	       const char *wordbreak, isc_buffer_t *target)
+{
+	char buf[3];
+	unsigned int loops = 0;
+
+	if (wordlength < 2)
+		wordlength = 2;
+
+	memset(buf, 0, sizeof(buf));
+	while (source->length > 0) {
+		buf[0] = old_hex[(source->base[0] >> 4) & 0xf];
+		buf[1] = old_hex[(source->base[0]) & 0xf];
+		RETERR(str_totext(buf, target));
+		isc_region_consume(source, 1);
+
+		loops++;
+		if (source->length != 0 &&
+		    (int)((loops + 1) * 2) >= wordlength)
+		{
+			loops = 0;
+			RETERR(str_totext(wordbreak, target));
+		}
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * State of a hex decoding process in progress.
+ */
+typedef struct {
+	int length;		/*%< Desired length of binary data or -1 */
+	isc_buffer_t *target;	/*%< Buffer for resulting binary data */
+	int digits;		/*%< Number of buffered hex digits */
+	int val[2];
+} old_hex_decode_ctx_t;
+
+static inline void
+old_hex_decode_init(old_hex_decode_ctx_t *ctx, int length,
+		    isc_buffer_t *target)
+{
+	ctx->digits = 0;
+	ctx->length = length;
+	ctx->target = target;
+}
+
+static inline isc_result_t
+old_hex_decode_char(old_hex_decode_ctx_t *ctx, int c) {
+	const char *s;
+
+	if ((s = strchr(old_hex, toupper(c))) == NULL)
+		return (ISC_R_BADHEX);
+	ctx->val[ctx->digits++] = (int)(s - old_hex);
+	if (ctx->digits == 2) {
+		unsigned char num;
+
+		num = (ctx->val[0] << 4) + (ctx->val[1]);
+		RETERR(mem_tobuffer(ctx->target, &num, 1));
+		if (ctx->length >= 0) {
+			if (ctx->length == 0)
+				return (ISC_R_BADHEX);
+			else
+				ctx->length -= 1;
+		}
+		ctx->digits = 0;
+	}
+	return (ISC_R_SUCCESS);
+}
+
+static inline isc_result_t
+old_hex_decode_finish(old_hex_decode_ctx_t *ctx) {
+	if (ctx->length > 0)
+		return (ISC_R_UNEXPECTEDEND);
+	if (ctx->digits != 0)
+		return (ISC_R_BADHEX);
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+old_hex_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
+	old_hex_decode_ctx_t ctx;
+	isc_textregion_t *tr;
+	isc_token_t token;
+	isc_boolean_t eol;
+
+	old_hex_decode_init(&ctx, length, target);
+
+	while (ctx.length != 0) {
+		unsigned int i;
+
+		if (length > 0)
+			eol = ISC_FALSE;
+		else
+			eol = ISC_TRUE;
+		RETERR(isc_lex_getmastertoken(lexer, &token,
+					      isc_tokentype_string, eol));
+		if (token.type != isc_tokentype_string)
+			break;
+		tr = &token.value.as_textregion;
+		for (i = 0; i < tr->length; i++)
+			RETERR(old_hex_decode_char(&ctx, tr->base[i]));
+	}
+	if (ctx.length < 0)
+		isc_lex_ungettoken(lexer, &token);
+	RETERR(old_hex_decode_finish(&ctx));
+	return (ISC_R_SUCCESS);
+}
+
+
+static isc_result_t
+old_hex_decodestring(const char *cstr, isc_buffer_t *target) {
+	old_hex_decode_ctx_t ctx;
+
+	old_hex_decode_init(&ctx, -1, target);
+	for (;;) {
+		int c = *cstr++;
+		if (c == '\0')
+			break;
+		if (c == ' ' || c == '\t' || c == '\n' || c== '\r')
+			continue;
+		RETERR(old_hex_decode_char(&ctx, c));
+	}
+	RETERR(old_hex_decode_finish(&ctx));
+	return (ISC_R_SUCCESS);
+}
+/*
+ * Wrappers giving the old base32 functions the public signatures.
+ */
+static isc_result_t
+old_b32_totext(isc_region_t *source, int wordlength, const char *wordbreak,
+	       isc_buffer_t *target)
+{
+	return (old_base32_totext(source, wordlength, wordbreak, target,
+				  old_base32, '='));
+}
+
+static isc_result_t
+old_b32hex_totext(isc_region_t *source, int wordlength,
+		  const char *wordbreak, isc_buffer_t *target)
+{
+	return (old_base32_totext(source, wordlength, wordbreak, target,
+				  old_base32hex, '='));
+}
+
+static isc_result_t
+old_b32hexnp_totext(isc_region_t *source, int wordlength,
+		    const char *wordbreak, isc_buffer_t *target)
+{
+	return (old_base32_totext(source, wordlength, wordbreak, target,
+				  old_base32hex, 0));
+}
+
+static isc_result_t
+old_b32_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
+	return (old_base32_tobuffer(lexer, old_base32, ISC_TRUE,
+				    target, length));
+}
+
+static isc_result_t
+old_b32hex_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
+	return (old_base32_tobuffer(lexer, old_base32hex, ISC_TRUE,
+				    target, length));
+}
+
+static isc_result_t
+old_b32hexnp_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
+	return (old_base32_tobuffer(lexer, old_base32hex, ISC_FALSE,
+				    target, length));
+}
+
+static isc_result_t
+old_b32_decodestring(const char *cstr, isc_buffer_t *target) {
+	return (old_base32_decodestring(cstr, old_base32, ISC_TRUE, target));
+}
+
+static isc_result_t
+old_b32hex_decodestring(const char *cstr, isc_buffer_t *target) {
+	return (old_base32_decodestring(cstr, old_base32hex, ISC_TRUE,
+					target));
+}
+
+static isc_result_t
+old_b32hexnp_decodestring(const char *cstr, isc_buffer_t *target) {
+	return (old_base32_decodestring(cstr, old_base32hex, ISC_FALSE,
+					target));
+}
+
+static isc_result_t
+old_b32_decoderegion(isc_region_t *source, isc_buffer_t *target) {
+	return (old_base32_decoderegion(source, old_base32, ISC_TRUE, target));
+}
+
+static isc_result_t
+old_b32hex_decoderegion(isc_region_t *source, isc_buffer_t *target) {
+	return (old_base32_decoderegion(source, old_base32hex, ISC_TRUE,
+					target));
+}
+
+static isc_result_t
+old_b32hexnp_decoderegion(isc_region_t *source, isc_buffer_t *target) {
+	return (old_base32_decoderegion(source, old_base32hex, ISC_FALSE,
+					target));
+}
+
+typedef isc_result_t (*totext_t)(isc_region_t *, int, const char *,
+				 isc_buffer_t *);
+typedef isc_result_t (*tobuffer_t)(isc_lex_t *, isc_buffer_t *, int);
+typedef isc_result_t (*decodestring_t)(const char *, isc_buffer_t *);
+typedef isc_result_t (*decoderegion_t)(isc_region_t *, isc_buffer_t *);
+
+typedef struct {
+	const char *name;
+	totext_t totext, old_totext;
+	tobuffer_t tobuffer, old_tobuffer;
+	decodestring_t decodestring, old_decodestring;
+	decoderegion_t decoderegion, old_decoderegion;
+} coding_t;
+
+static const coding_t codings[] = {
+	{ "base64", isc_base64_totext, old_base64_totext,
+	  isc_base64_tobuffer, old_base64_tobuffer,
+	  isc_base64_decodestring, old_base64_decodestring, NULL, NULL },
+	{ "base32", isc_base32_totext, old_b32_totext,
+	  isc_base32_tobuffer, old_b32_tobuffer,
+	  isc_base32_decodestring, old_b32_decodestring,
+	  isc_base32_decoderegion, old_b32_decoderegion },
+	{ "base32hex", isc_base32hex_totext, old_b32hex_totext,
+	  isc_base32hex_tobuffer, old_b32hex_tobuffer,
+	  isc_base32hex_decodestring, old_b32hex_decodestring,
+	  isc_base32hex_decoderegion, old_b32hex_decoderegion },
+	{ "base32hexnp", isc_base32hexnp_totext, old_b32hexnp_totext,
+	  isc_base32hexnp_tobuffer, old_b32hexnp_tobuffer,
+	  isc_base32hexnp_decodestring, old_b32hexnp_decodestring,
+	  isc_base32hexnp_decoderegion, old_b32hexnp_decoderegion },
+	{ "hex", isc_hex_totext, old_hex_totext,
+	  isc_hex_tobuffer, old_hex_tobuffer,
+	  isc_hex_decodestring, old_hex_decodestring, NULL, NULL }
+};
+
+static const char *wordbreaks[] = { "", " ", "\n\t" };
+
+/*
+ * Characters to damage an encoding with: the pad, digits from each
+ * alphabet in both cases, and things that belong in none of them.
+ * NUL is left out as the old decoders took it for the end of their
+ * alphabets.
+ */
+static const char noise[] = "=AZaz0179+/-_!. \t\x7f\x80\xff";
+
+static unsigned int
+random_data(unsigned char *data) {
+	unsigned int i, len;
+
+	len = rand() % (MAXDATA + 1);
+	for (i = 0; i < len; i++)
+		data[i] = rand() & 0xff;
+	return (len);
+}
+
+/*
+ * Encode random data and then, most of the time, damage the text.
+ * Returns the length of the text.
+ */
+static unsigned int
+random_text(const coding_t *coding, char *text, unsigned int *datalenp) {
+	unsigned char data[MAXDATA];
+	isc_region_t r;
+	isc_buffer_t b;
+	unsigned int len, i, n;
+
+	r.base = data;
+	r.length = *datalenp = random_data(data);
+	isc_buffer_init(&b, text, MAXTEXT - 1);
+	ATF_REQUIRE_EQ(coding->old_totext(&r, rand() % 40,
+					  wordbreaks[rand() % 3], &b),
+		       ISC_R_SUCCESS);
+	len = isc_buffer_usedlength(&b);
+
+	n = rand() % 4;
+	for (i = 0; i < n && len > 0; i++) {
+		switch (rand() % 3) {
+		case 0:
+			text[rand() % len] = noise[rand() % (sizeof(noise) - 1)];
+			break;
+		case 1:
+			len = rand() % len;
+			break;
+		case 2:
+			text[rand() % len] = ' ';
+			break;
+		}
+	}
+	text[len] = '\0';
+	return (len);
+}
+
+static void
+check_totext(const coding_t *coding) {
+	unsigned char data[MAXDATA];
+	char text[2][MAXTEXT];
+	isc_region_t r[2];
+	isc_buffer_t b[2];
+	isc_result_t result[2];
+	unsigned int i, len, size;
+	const char *wordbreak;
+	int wordlength;
+
+	len = random_data(data);
+	wordlength = rand() % 80 - 5;
+	wordbreak = wordbreaks[rand() % 3];
+	size = (rand() % 4 == 0) ? rand() % (len * 2 + 3) : MAXTEXT;
+
+	for (i = 0; i < 2; i++) {
+		r[i].base = data;
+		r[i].length = len;
+		isc_buffer_init(&b[i], text[i], size);
+	}
+	result[0] = coding->totext(&r[0], wordlength, wordbreak, &b[0]);
+	result[1] = coding->old_totext(&r[1], wordlength, wordbreak, &b[1]);
+
+	ATF_REQUIRE_EQ_MSG(result[0], result[1], "%s", coding->name);
+	ATF_REQUIRE_EQ(r[0].length, r[1].length);
+	ATF_REQUIRE_EQ(isc_buffer_usedlength(&b[0]),
+		       isc_buffer_usedlength(&b[1]));
+	ATF_REQUIRE(memcmp(text[0], text[1],
+			   isc_buffer_usedlength(&b[0])) == 0);
+}
+
+static void
+check_tobuffer(isc_mem_t *mctx, const coding_t *coding) {
+	char text[MAXTEXT];
+	unsigned char out[2][MAXDATA * 2];
+	isc_lex_t *lex[2] = { NULL, NULL };
+	isc_buffer_t source[2], target[2];
+	isc_result_t result[2];
+	isc_token_t token[2];
+	unsigned int i, len, datalen, size;
+	int length;
+
+	len = random_text(coding, text, &datalen);
+	switch (rand() % 4) {
+	case 0:
+		length = -1;
+		break;
+	case 1:
+		length = datalen;
+		break;
+	default:
+		length = rand() % (datalen + 2);
+		break;
+	}
+	size = (rand() % 4 == 0) ? rand() % (datalen + 1) : sizeof(out[0]);
+
+	for (i = 0; i < 2; i++) {
+		ATF_REQUIRE_EQ(isc_lex_create(mctx, 64, &lex[i]),
+			       ISC_R_SUCCESS);
+		isc_buffer_init(&source[i], text, len);
+		isc_buffer_add(&source[i], len);
+		ATF_REQUIRE_EQ(isc_lex_openbuffer(lex[i], &source[i]),
+			       ISC_R_SUCCESS);
+		isc_buffer_init(&target[i], out[i], size);
+	}
+	result[0] = coding->tobuffer(lex[0], &target[0], length);
+	result[1] = coding->old_tobuffer(lex[1], &target[1], length);
+
+	ATF_REQUIRE_EQ_MSG(result[0], result[1], "%s \"%s\" length %d",
+			   coding->name, text, length);
+	ATF_REQUIRE_EQ(isc_buffer_usedlength(&target[0]),
+		       isc_buffer_usedlength(&target[1]));
+	ATF_REQUIRE(memcmp(out[0], out[1],
+			   isc_buffer_usedlength(&target[0])) == 0);
+
+	/*
+	 * Both must have left the lexer in the same place.
+	 */
+	for (i = 0; i < 2; i++)
+		result[i] = isc_lex_gettoken(lex[i], ISC_LEXOPT_EOF,
+					     &token[i]);
+	ATF_REQUIRE_EQ(result[0], result[1]);
+	if (result[0] == ISC_R_SUCCESS) {
+		ATF_REQUIRE_EQ(token[0].type, token[1].type);
+		ATF_REQUIRE_EQ(isc_buffer_consumedlength(&source[0]),
+			       isc_buffer_consumedlength(&source[1]));
+	}
+
+	for (i = 0; i < 2; i++)
+		isc_lex_destroy(&lex[i]);
+}
+
+static void
+check_decodestring(const coding_t *coding) {
+	char text[MAXTEXT];
+	unsigned char out[2][MAXDATA * 2];
+	isc_buffer_t target[2];
+	isc_result_t result[2];
+	unsigned int i, datalen, size;
+
+	(void)random_text(coding, text, &datalen);
+	size = (rand() % 4 == 0) ? rand() % (datalen + 1) : sizeof(out[0]);
+
+	for (i = 0; i < 2; i++)
+		isc_buffer_init(&target[i], out[i], size);
+	result[0] = coding->decodestring(text, &target[0]);
+	result[1] = coding->old_decodestring(text, &target[1]);
+
+	ATF_REQUIRE_EQ_MSG(result[0], result[1], "%s \"%s\"",
+			   coding->name, text);
+	ATF_REQUIRE_EQ(isc_buffer_usedlength(&target[0]),
+		       isc_buffer_usedlength(&target[1]));
+	ATF_REQUIRE(memcmp(out[0], out[1],
+			   isc_buffer_usedlength(&target[0])) == 0);
+}
+
+static void
+check_decoderegion(const coding_t *coding) {
+	char text[MAXTEXT];
+	unsigned char out[2][MAXDATA * 2];
+	isc_region_t r[2];
+	isc_buffer_t target[2];
+	isc_result_t result[2];
+	unsigned int i, len, datalen, size;
+
+	len = random_text(coding, text, &datalen);
+	size = (rand() % 4 == 0) ? rand() % (datalen + 1) : sizeof(out[0]);
+
+	for (i = 0; i < 2; i++) {
+		r[i].base = (unsigned char *)text;
+		r[i].length = len;
+		isc_buffer_init(&target[i], out[i], size);
+	}
+	result[0] = coding->decoderegion(&r[0], &target[0]);
+	result[1] = coding->old_decoderegion(&r[1], &target[1]);
+
+	ATF_REQUIRE_EQ_MSG(result[0], result[1], "%s \"%s\"",
+			   coding->name, text);
+	ATF_REQUIRE_EQ(r[0].length, r[1].length);
+	ATF_REQUIRE_EQ(isc_buffer_usedlength(&target[0]),
+		       isc_buffer_usedlength(&target[1]));
+	ATF_REQUIRE(memcmp(out[0], out[1],
+			   isc_buffer_usedlength(&target[0])) == 0);
+}
+
+ATF_TC(totext);
+ATF_TC_HEAD(totext, tc) {
+	atf_tc_set_md_var(tc, "descr", "encoders match the old ones");
+}
+ATF_TC_BODY(totext, tc) {
+	unsigned int i, j;
+
+	UNUSED(tc);
+
+	srand(1);
+	for (i = 0; i < sizeof(codings) / sizeof(codings[0]); i++)
+		for (j = 0; j < TRIALS; j++)
+			check_totext(&codings[i]);
+}
+
+ATF_TC(tobuffer);
+ATF_TC_HEAD(tobuffer, tc) {
+	atf_tc_set_md_var(tc, "descr", "decoding from a lexer matches the "
+			  "old decoders");
+}
+ATF_TC_BODY(tobuffer, tc) {
+	isc_mem_t *mctx = NULL;
+	unsigned int i, j;
+
+	UNUSED(tc);
+
+	ATF_REQUIRE_EQ(isc_mem_create(0, 0, &mctx), ISC_R_SUCCESS);
+
+	srand(2);
+	for (i = 0; i < sizeof(codings) / sizeof(codings[0]); i++)
+		for (j = 0; j < TRIALS; j++)
+			check_tobuffer(mctx, &codings[i]);
+
+	isc_mem_destroy(&mctx);
+}
+
+ATF_TC(decodestring);
+ATF_TC_HEAD(decodestring, tc) {
+	atf_tc_set_md_var(tc, "descr", "decoding strings matches the old "
+			  "decoders");
+}
+ATF_TC_BODY(decodestring, tc) {
+	unsigned int i, j;
+
+	UNUSED(tc);
+
+	srand(3);
+	for (i = 0; i < sizeof(codings) / sizeof(codings[0]); i++)
+		for (j = 0; j < TRIALS; j++)
+			check_decodestring(&codings[i]);
+}
+
+ATF_TC(decoderegion);
+ATF_TC_HEAD(decoderegion, tc) {
+	atf_tc_set_md_var(tc, "descr", "decoding regions matches the old "
+			  "decoders");
+}
+ATF_TC_BODY(decoderegion, tc) {
+	unsigned int i, j;
+
+	UNUSED(tc);
+
+	srand(4);
+	for (i = 0; i < sizeof(codings) / sizeof(codings[0]); i++) {
+		if (codings[i].decoderegion == NULL)
+			continue;
+		for (j = 0; j < TRIALS; j++)
+			check_decoderegion(&codings[i]);
+	}
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, totext);
+	ATF_TP_ADD_TC(tp, tobuffer);
+	ATF_TP_ADD_TC(tp, decodestring);
+	ATF_TP_ADD_TC(tp, decoderegion);
+	return (atf_no_error());
+}
@@ -20,10 +20,12 @@
 #include <isc/crc64.h>
 #include <isc/hmacmd5.h>
 #include <isc/hmacsha.h>
+#include <isc/iterated_hash.h>
 #include <isc/md5.h>
 #include <isc/sha1.h>
 #include <isc/util.h>
 #include <isc/print.h>
+#include <isc/random.h>
 #include <isc/string.h>
 
 #include <pk11/site.h>
@@ -1963,6 +1965,119 @@ ATF_TC_BODY(isc_hash_initializer, tc) {
 	ATF_CHECK_EQ(h1, h2);
 }
 
+/*
+ * NSEC3 hash of "example" from RFC 5155, Appendix A.
+ */
+ATF_TC(isc_iterated_hash);
+ATF_TC_HEAD(isc_iterated_hash, tc) {
+	atf_tc_set_md_var(tc, "descr", "NSEC3 hash example from RFC5155");
+}
+ATF_TC_BODY(isc_iterated_hash, tc) {
+	const unsigned char name[] = "\007example";
+	const unsigned char salt[] = { 0xaa, 0xbb, 0xcc, 0xdd };
+	const unsigned char *in[5];
+	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
+	unsigned char hashes[5][NSEC3_MAX_HASH_LENGTH];
+	unsigned char *out[5];
+	int inlength[5];
+	unsigned int i;
+	int length;
+
+	UNUSED(tc);
+
+	length = isc_iterated_hash(hash, 1, 12, salt, sizeof(salt),
+				   name, sizeof(name));
+	ATF_REQUIRE_EQ(length, ISC_SHA1_DIGESTLENGTH);
+	tohexstr(hash, length, str);
+	ATF_CHECK_STREQ(str, "0x065368ABEED7EC6E9FEBA96B8C8BC3E8B791F716");
+
+	for (i = 0; i < 5; i++) {
+		in[i] = name;
+		inlength[i] = sizeof(name);
+		out[i] = hashes[i];
+	}
+	length = isc_iterated_hash_batch(out, 5, 1, 12, salt, sizeof(salt),
+					 in, inlength);
+	ATF_REQUIRE_EQ(length, ISC_SHA1_DIGESTLENGTH);
+	for (i = 0; i < 5; i++)
+		ATF_CHECK(memcmp(hashes[i], hash, length) == 0);
+
+	/* Only SHA-1 is defined. */
+	ATF_CHECK_EQ(isc_iterated_hash(hash, 2, 12, salt, sizeof(salt),
+				       name, sizeof(name)), 0);
+	ATF_CHECK_EQ(isc_iterated_hash_batch(out, 5, 2, 12, salt, sizeof(salt),
+					     in, inlength), 0);
+}
+
+#define BATCH	21
+
+ATF_TC(isc_iterated_hash_batch);
+ATF_TC_HEAD(isc_iterated_hash_batch, tc) {
+	atf_tc_set_md_var(tc, "descr", "batched NSEC3 hashes match "
+			  "isc_iterated_hash()");
+}
+ATF_TC_BODY(isc_iterated_hash_batch, tc) {
+	static const int iterations[] = { 0, 1, 10, 150 };
+	static const int saltlengths[] = { 0, 4, 40, 255 };
+	unsigned char names[BATCH][255], salt[255];
+	unsigned char hashes[BATCH][NSEC3_MAX_HASH_LENGTH];
+	unsigned char expect[NSEC3_MAX_HASH_LENGTH];
+	const unsigned char *in[BATCH];
+	unsigned char *out[BATCH];
+	int inlength[BATCH];
+	unsigned int i, j, it, sl, count;
+	isc_uint32_t r;
+
+	UNUSED(tc);
+
+	/*
+	 * Names of every length from a single byte to 255 bytes, so that
+	 * lanes in the same group need different numbers of blocks.
+	 */
+	for (i = 0; i < BATCH; i++) {
+		isc_random_get(&r);
+		inlength[i] = (i == 0) ? 255 : 1 + r % 255;
+		for (j = 0; j < (unsigned int)inlength[i]; j++) {
+			isc_random_get(&r);
+			names[i][j] = r & 0xff;
+		}
+		in[i] = names[i];
+		out[i] = hashes[i];
+	}
+	for (j = 0; j < sizeof(salt); j++) {
+		isc_random_get(&r);
+		salt[j] = r & 0xff;
+	}
+
+	for (it = 0; it < sizeof(iterations) / sizeof(iterations[0]); it++) {
+		for (sl = 0; sl < sizeof(saltlengths) / sizeof(saltlengths[0]);
+		     sl++)
+		{
+			for (count = 1; count <= BATCH; count++) {
+				memset(hashes, 0, sizeof(hashes));
+				ATF_REQUIRE_EQ(isc_iterated_hash_batch(out,
+						count, 1, iterations[it], salt,
+						saltlengths[sl], in, inlength),
+					       ISC_SHA1_DIGESTLENGTH);
+				for (i = 0; i < count; i++) {
+					(void)isc_iterated_hash(expect, 1,
+							iterations[it], salt,
+							saltlengths[sl],
+							in[i], inlength[i]);
+					ATF_CHECK_MSG(memcmp(expect, hashes[i],
+						      ISC_SHA1_DIGESTLENGTH)
+						      == 0,
+						      "iterations %d salt %d "
+						      "count %u input %u",
+						      iterations[it],
+						      saltlengths[sl],
+						      count, i);
+				}
+			}
+		}
+	}
+}
+
 /*
  * Main
  */
@@ -1991,6 +2106,8 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, isc_sha384);
 	ATF_TP_ADD_TC(tp, isc_sha512);
 	ATF_TP_ADD_TC(tp, isc_crc64);
+	ATF_TP_ADD_TC(tp, isc_iterated_hash);
+	ATF_TP_ADD_TC(tp, isc_iterated_hash_batch);
 
 	return (atf_no_error());
 }
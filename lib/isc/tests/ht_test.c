@@ -257,6 +257,130 @@ static void test_ht_iterator() {
 	ATF_REQUIRE_EQ(ht, NULL);
 }
 
+static void test_ht_resize() {
+	isc_ht_t *ht = NULL;
+	isc_result_t result;
+	isc_mem_t *mctx = NULL;
+	isc_ht_iter_t *iter = NULL;
+	isc_int64_t i;
+	isc_int64_t v;
+	isc_uint32_t count = 7000;
+	isc_uint32_t walked;
+	unsigned char key[16];
+	unsigned char *seen;
+
+	result = isc_mem_createx2(0, 0, default_memalloc, default_memfree,
+				  NULL, &mctx, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	seen = calloc(count + 1, 1);
+	ATF_REQUIRE(seen != NULL);
+
+	result = isc_ht_init(&ht, mctx, 1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Check every entry added so far after each addition, so that
+	 * lookups are exercised while entries are being moved to the
+	 * grown table.
+	 */
+	for (i = 1; i <= count; i++) {
+		isc_int64_t j;
+
+		snprintf((char *)key, 16, "%lld key of a raw hashtable!!", i);
+		result = isc_ht_add(ht, key, 16, (void *) i);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_REQUIRE_EQ(isc_ht_count(ht), i);
+		if (i % 97 != 0)
+			continue;
+		for (j = 1; j <= i; j++) {
+			void *f = NULL;
+			snprintf((char *)key, 16,
+				 "%lld key of a raw hashtable!!", j);
+			result = isc_ht_find(ht, key, 16, &f);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			ATF_REQUIRE_EQ(j, (isc_int64_t) f);
+		}
+	}
+
+	/*
+	 * With 7000 entries the last growth has not finished yet, so
+	 * the iterator has to cover both tables.
+	 */
+	result = isc_ht_iter_create(ht, &iter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	walked = 0;
+	for (result = isc_ht_iter_first(iter);
+	     result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(iter))
+	{
+		isc_ht_iter_current(iter, (void**) &v);
+		ATF_REQUIRE(v >= 1 && v <= count);
+		ATF_REQUIRE_EQ(seen[v], 0);
+		seen[v] = 1;
+		walked++;
+	}
+	ATF_REQUIRE_EQ(result, ISC_R_NOMORE);
+	ATF_REQUIRE_EQ(walked, count);
+	isc_ht_iter_destroy(&iter);
+
+	/*
+	 * Shrink it again, checking the survivors along the way.
+	 */
+	for (i = 1; i <= count - 10; i++) {
+		isc_int64_t j;
+
+		snprintf((char *)key, 16, "%lld key of a raw hashtable!!", i);
+		result = isc_ht_delete(ht, key, 16);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = isc_ht_delete(ht, key, 16);
+		ATF_REQUIRE_EQ(result, ISC_R_NOTFOUND);
+		if (i % 97 != 0)
+			continue;
+		for (j = i + 1; j <= count; j++) {
+			void *f = NULL;
+			snprintf((char *)key, 16,
+				 "%lld key of a raw hashtable!!", j);
+			result = isc_ht_find(ht, key, 16, &f);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			ATF_REQUIRE_EQ(j, (isc_int64_t) f);
+		}
+	}
+	ATF_REQUIRE_EQ(isc_ht_count(ht), 10);
+
+	/*
+	 * Grow it half way, then empty it through an iterator.
+	 */
+	memset(seen, 0, count + 1);
+	for (i = 1; i <= count / 2; i++) {
+		snprintf((char *)key, 16, "%lld key of a raw hashtable!!", i);
+		result = isc_ht_add(ht, key, 16, (void *) i);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	result = isc_ht_iter_create(ht, &iter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	walked = 0;
+	for (result = isc_ht_iter_first(iter);
+	     result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_delcurrent_next(iter))
+	{
+		isc_ht_iter_current(iter, (void**) &v);
+		ATF_REQUIRE(v >= 1 && v <= count);
+		ATF_REQUIRE_EQ(seen[v], 0);
+		seen[v] = 1;
+		walked++;
+	}
+	ATF_REQUIRE_EQ(result, ISC_R_NOMORE);
+	ATF_REQUIRE_EQ(walked, count / 2 + 10);
+	ATF_REQUIRE_EQ(isc_ht_count(ht), 0);
+	isc_ht_iter_destroy(&iter);
+
+	isc_ht_destroy(&ht);
+	ATF_REQUIRE_EQ(ht, NULL);
+	free(seen);
+	isc_mem_destroy(&mctx);
+}
+
 ATF_TC(isc_ht_20);
 ATF_TC_HEAD(isc_ht_20, tc) {
 	atf_tc_set_md_var(tc, "descr", "20 bit, 2M elements test");
@@ -311,6 +435,16 @@ ATF_TC_BODY(isc_ht_iterator, tc) {
 	test_ht_iterator();
 }
 
+ATF_TC(isc_ht_resize);
+ATF_TC_HEAD(isc_ht_resize, tc) {
+	atf_tc_set_md_var(tc, "descr", "hashtable growing and shrinking");
+}
+
+ATF_TC_BODY(isc_ht_resize, tc) {
+	UNUSED(tc);
+	test_ht_resize();
+}
+
 /*
  * Main
  */
@@ -320,6 +454,7 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, isc_ht_1);
 /*	ATF_TP_ADD_TC(tp, isc_ht_32); */
 	ATF_TP_ADD_TC(tp, isc_ht_iterator);
+	ATF_TP_ADD_TC(tp, isc_ht_resize);
 	return (atf_no_error());
 }
 
@@ -97,12 +97,197 @@ ATF_TC_BODY(lex_setline, tc) {
 	ATF_REQUIRE_EQ(line, 105U);
 }
 
+/*
+ * Pieces of master file text that exercise every way a run of
+ * ordinary characters can end: delimiters, specials, escapes,
+ * comments, quotes and line ends, as well as tokens long enough to
+ * span several vector compares and to outgrow the token buffer.
+ */
+static const char *pieces[] = {
+	" ", "\t", "\n", "\r\n", "(", ")", "@", "IN", "3600",
+	"; a comment\n", ";\n", "\"quoted text\"", "\"esc\\\"aped\"",
+	"\"two\\\nlines\"", "\"\"", "\"unterminated\n",
+	"\\ ", "\\;", "\\(", "\\\\", "\\065", "/", "#", "{}", "\x01",
+	"\xff", "\x00", "abcdefghijklmnopqrstuvwxyz0123456789abcdefghijkl",
+	"www.example.com.", "10.53.0.1", "2001:db8::1", "3600s"
+};
+
+#define LEXTEXT_SIZE	20000
+#define LEXTEXT_FILE	"./lex_test.in"
+
+static size_t
+make_text(unsigned char *text, size_t size) {
+	size_t len = 0, n;
+	const char *piece;
+	unsigned int i;
+
+	while (len < size - 64) {
+		i = rand() % (sizeof(pieces) / sizeof(pieces[0]));
+		piece = pieces[i];
+		/* "\x00" is a one byte piece that strlen can't measure. */
+		n = (*piece == '\0') ? 1 : strlen(piece);
+		memmove(text + len, piece, n);
+		len += n;
+	}
+	return (len);
+}
+
+static void
+check_same(isc_lex_t *lex[3], unsigned int options) {
+	isc_token_t token[3];
+	isc_region_t text[3];
+	isc_result_t result[3];
+	unsigned int i, count = 0;
+
+	for (;;) {
+		for (i = 0; i < 3; i++)
+			result[i] = isc_lex_gettoken(lex[i], options,
+						     &token[i]);
+		for (i = 1; i < 3; i++) {
+			ATF_REQUIRE_EQ_MSG(result[i], result[0],
+					   "token %u", count);
+			ATF_REQUIRE_EQ(isc_lex_getsourceline(lex[i]),
+				       isc_lex_getsourceline(lex[0]));
+		}
+		if (result[0] == ISC_R_EOF ||
+		    (result[0] == ISC_R_SUCCESS &&
+		     token[0].type == isc_tokentype_eof))
+			break;
+		count++;
+		/* Syntax errors are reported and lexing carries on. */
+		if (result[0] != ISC_R_SUCCESS)
+			continue;
+		for (i = 0; i < 3; i++)
+			isc_lex_getlasttokentext(lex[i], &token[i], &text[i]);
+		for (i = 1; i < 3; i++) {
+			ATF_REQUIRE_EQ_MSG(token[i].type, token[0].type,
+					   "token %u", count);
+			ATF_REQUIRE_EQ(text[i].length, text[0].length);
+			ATF_REQUIRE(memcmp(text[i].base, text[0].base,
+					   text[0].length) == 0);
+			switch (token[0].type) {
+			case isc_tokentype_string:
+			case isc_tokentype_qstring:
+				ATF_REQUIRE_EQ(token[i].value.as_textregion.length,
+					     token[0].value.as_textregion.length);
+				ATF_REQUIRE(memcmp(
+					     token[i].value.as_textregion.base,
+					     token[0].value.as_textregion.base,
+					     token[0].value.as_textregion.length)
+					    == 0);
+				break;
+			case isc_tokentype_number:
+				ATF_REQUIRE_EQ(token[i].value.as_ulong,
+					       token[0].value.as_ulong);
+				break;
+			case isc_tokentype_special:
+			case isc_tokentype_initialws:
+				ATF_REQUIRE_EQ(token[i].value.as_char,
+					       token[0].value.as_char);
+				break;
+			default:
+				break;
+			}
+		}
+		/* Reread every so often, as the master file loader does. */
+		if (count % 7 == 3)
+			for (i = 0; i < 3; i++)
+				isc_lex_ungettoken(lex[i], &token[i]);
+	}
+}
+
+ATF_TC(lex_runs);
+ATF_TC_HEAD(lex_runs, tc) {
+	atf_tc_set_md_var(tc, "descr", "buffers, owned files and streams "
+			  "tokenize identically");
+}
+ATF_TC_BODY(lex_runs, tc) {
+	static const unsigned int optionsets[] = {
+		ISC_LEXOPT_EOL | ISC_LEXOPT_EOF | ISC_LEXOPT_DNSMULTILINE |
+		ISC_LEXOPT_ESCAPE | ISC_LEXOPT_QSTRING,
+		ISC_LEXOPT_EOL | ISC_LEXOPT_EOF | ISC_LEXOPT_DNSMULTILINE |
+		ISC_LEXOPT_ESCAPE | ISC_LEXOPT_NUMBER | ISC_LEXOPT_INITIALWS,
+		ISC_LEXOPT_EOF | ISC_LEXOPT_QSTRING |
+		ISC_LEXOPT_QSTRINGMULTILINE | ISC_LEXOPT_ESCAPE,
+		ISC_LEXOPT_EOF | ISC_LEXOPT_BTEXT
+	};
+	static const unsigned int commentsets[] = {
+		ISC_LEXCOMMENT_DNSMASTERFILE,
+		ISC_LEXCOMMENT_C | ISC_LEXCOMMENT_CPLUSPLUS |
+		ISC_LEXCOMMENT_SHELL,
+		0
+	};
+	isc_mem_t *mctx = NULL;
+	isc_result_t result;
+	isc_lex_t *lex[3] = { NULL, NULL, NULL };
+	isc_lexspecials_t specials;
+	isc_buffer_t buf;
+	unsigned char *text;
+	size_t len;
+	FILE *fp, *stream;
+	unsigned int i, j, round;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	text = malloc(LEXTEXT_SIZE);
+	ATF_REQUIRE(text != NULL);
+
+	memset(specials, 0, sizeof(specials));
+	specials[0] = 1;
+	specials['('] = 1;
+	specials[')'] = 1;
+	specials['"'] = 1;
+	specials['{'] = 1;
+
+	srand(12345);
+	for (round = 0; round < 40; round++) {
+		len = make_text(text, LEXTEXT_SIZE);
+		fp = fopen(LEXTEXT_FILE, "w");
+		ATF_REQUIRE(fp != NULL);
+		ATF_REQUIRE_EQ(fwrite(text, 1, len, fp), len);
+		ATF_REQUIRE_EQ(fclose(fp), 0);
+
+		for (i = 0; i < 3; i++) {
+			/* A tiny initial token buffer so that it has to grow. */
+			result = isc_lex_create(mctx, 4, &lex[i]);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			isc_lex_setspecials(lex[i], specials);
+			isc_lex_setcomments(lex[i], commentsets[round % 3]);
+		}
+
+		isc_buffer_init(&buf, text, (unsigned int)len);
+		isc_buffer_add(&buf, (unsigned int)len);
+		result = isc_lex_openbuffer(lex[0], &buf);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = isc_lex_openfile(lex[1], LEXTEXT_FILE);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		stream = fopen(LEXTEXT_FILE, "r");
+		ATF_REQUIRE(stream != NULL);
+		result = isc_lex_openstream(lex[2], stream);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		check_same(lex, optionsets[round % 4]);
+
+		for (j = 0; j < 3; j++)
+			isc_lex_destroy(&lex[j]);
+		fclose(stream);
+	}
+
+	free(text);
+	(void)unlink(LEXTEXT_FILE);
+	isc_mem_destroy(&mctx);
+}
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, lex_0xff);
 	ATF_TP_ADD_TC(tp, lex_setline);
+	ATF_TP_ADD_TC(tp, lex_runs);
 	return (atf_no_error());
 }
 
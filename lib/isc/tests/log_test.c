@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atf-c.h>
+
+#include <isc/log.h>
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/result.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include "isctest.h"
+
+#define LOGFILE		"./log_test.out"
+#define NTHREADS	4
+#define NMESSAGES	5000
+
+static isc_log_t *alctx = NULL;
+
+static isc_logcategory_t test_categories[] = {
+	{ "test", 0 },
+	{ NULL, 0 }
+};
+
+static isc_logmodule_t test_modules[] = {
+	{ "test", 0 },
+	{ NULL, 0 }
+};
+
+static void
+setup_log(void) {
+	isc_logconfig_t *logconfig = NULL;
+	isc_logdestination_t destination;
+	isc_result_t result;
+
+	(void)unlink(LOGFILE);
+
+	result = isc_log_create(mctx, &alctx, &logconfig);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_log_registercategories(alctx, test_categories);
+	isc_log_registermodules(alctx, test_modules);
+
+	destination.file.stream = NULL;
+	destination.file.name = LOGFILE;
+	destination.file.versions = ISC_LOG_ROLLNEVER;
+	destination.file.maximum_size = 0;
+	destination.file.suffix = isc_log_rollsuffix_increment;
+	result = isc_log_createchannel(logconfig, "test", ISC_LOG_TOFILE,
+				       ISC_LOG_INFO, &destination, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_log_usechannel(logconfig, "test", NULL, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+writer(void *arg) {
+	unsigned long id = (unsigned long)arg;
+	int i;
+
+	for (i = 0; i < NMESSAGES; i++)
+		isc_log_write(alctx, &test_categories[0], &test_modules[0],
+			      ISC_LOG_INFO, "thread %lu message %d", id, i);
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+run_writers(void) {
+	isc_thread_t threads[NTHREADS];
+	unsigned long i;
+
+	for (i = 0; i < NTHREADS; i++)
+		ATF_REQUIRE_EQ(isc_thread_create(writer, (void *)i,
+						 &threads[i]),
+			       ISC_R_SUCCESS);
+	for (i = 0; i < NTHREADS; i++)
+		(void)isc_thread_join(threads[i], NULL);
+}
+
+/*
+ * Read back the log file.  Every message must be there at most once
+ * and messages from any one thread must be in the order they were
+ * logged.  Returns the number of messages found and sets '*reportsp'
+ * to the number of "messages dropped" reports.
+ */
+static unsigned int
+check_log(unsigned int *reportsp) {
+	char line[256];
+	int last[NTHREADS];
+	unsigned int found = 0, reports = 0;
+	unsigned long id;
+	int n;
+	FILE *fp;
+
+	for (n = 0; n < NTHREADS; n++)
+		last[n] = -1;
+
+	fp = fopen(LOGFILE, "r");
+	ATF_REQUIRE(fp != NULL);
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "thread %lu message %d", &id, &n) == 2) {
+			ATF_REQUIRE(id < NTHREADS);
+			ATF_CHECK(n > last[id]);
+			last[id] = n;
+			found++;
+		} else if (strstr(line, "log messages dropped") != NULL) {
+			reports++;
+		} else {
+			ATF_CHECK_MSG(0, "unexpected line: %s", line);
+		}
+	}
+	fclose(fp);
+
+	*reportsp = reports;
+	return (found);
+}
+
+ATF_TC(async_block);
+ATF_TC_HEAD(async_block, tc) {
+	atf_tc_set_md_var(tc, "descr", "asynchronous logging loses nothing "
+			  "when the queue blocks");
+}
+ATF_TC_BODY(async_block, tc) {
+	isc_result_t result;
+	isc_uint64_t dropped, blocked;
+	unsigned int reports;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	setup_log();
+
+	/*
+	 * A small queue so that the writers have to wait for it.
+	 */
+	result = isc_log_setasync(alctx, 64, isc_logoverflow_block);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		isc_log_destroy(&alctx);
+		isc_test_end();
+		atf_tc_skip("asynchronous logging not supported");
+	}
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	run_writers();
+
+	/*
+	 * Turning the queue off writes out whatever is left in it.
+	 */
+	result = isc_log_setasync(alctx, 0, isc_logoverflow_block);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_log_getqueuestats(alctx, &dropped, &blocked);
+	ATF_CHECK_EQ(dropped, 0);
+
+	isc_log_destroy(&alctx);
+
+	ATF_CHECK_EQ(check_log(&reports), NTHREADS * NMESSAGES);
+	ATF_CHECK_EQ(reports, 0);
+
+	(void)unlink(LOGFILE);
+	isc_test_end();
+}
+
+ATF_TC(async_drop);
+ATF_TC_HEAD(async_drop, tc) {
+	atf_tc_set_md_var(tc, "descr", "asynchronous logging accounts for "
+			  "every message it drops");
+}
+ATF_TC_BODY(async_drop, tc) {
+	isc_result_t result;
+	isc_uint64_t dropped, blocked;
+	unsigned int found, reports;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	setup_log();
+
+	result = isc_log_setasync(alctx, 16, isc_logoverflow_drop);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		isc_log_destroy(&alctx);
+		isc_test_end();
+		atf_tc_skip("asynchronous logging not supported");
+	}
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	run_writers();
+
+	result = isc_log_setasync(alctx, 0, isc_logoverflow_drop);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_log_getqueuestats(alctx, &dropped, &blocked);
+	ATF_CHECK_EQ(blocked, 0);
+
+	isc_log_destroy(&alctx);
+
+	found = check_log(&reports);
+	ATF_CHECK_EQ(found + dropped, NTHREADS * NMESSAGES);
+	if (dropped != 0)
+		ATF_CHECK(reports > 0);
+
+	(void)unlink(LOGFILE);
+	isc_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, async_block);
+	ATF_TP_ADD_TC(tp, async_drop);
+	return (atf_no_error());
+}
@@ -18,6 +18,7 @@
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/result.h>
+#include <isc/thread.h>
 
 static void *
 default_memalloc(void *arg, size_t size) {
@@ -141,12 +142,165 @@ ATF_TC_BODY(isc_mem_inuse, tc) {
 	isc_test_end();
 }
 
+#ifdef ISC_PLATFORM_USETHREADS
+#define NTHREADS	8
+#define NBLOCKS		20000
+
+static isc_mem_t *tmctx = NULL;
+static int hiwater_calls, lowater_calls;
+
+static void
+water(void *arg, int mark) {
+	UNUSED(arg);
+
+	if (mark == ISC_MEM_HIWATER)
+		hiwater_calls++;
+	else
+		lowater_calls++;
+	isc_mem_waterack(tmctx, mark);
+}
+
+static void *
+churn(void *arg) {
+	void **ptrs;
+	int i;
+
+	UNUSED(arg);
+
+	ptrs = malloc(NBLOCKS * sizeof(*ptrs));
+	ATF_REQUIRE(ptrs != NULL);
+	for (i = 0; i < NBLOCKS; i++) {
+		ptrs[i] = isc_mem_get(tmctx, (i % 25 + 1) * 16);
+		ATF_REQUIRE(ptrs[i] != NULL);
+	}
+	for (i = 0; i < NBLOCKS; i++)
+		isc_mem_put(tmctx, ptrs[i], (i % 25 + 1) * 16);
+	free(ptrs);
+
+	return (NULL);
+}
+
+ATF_TC(isc_mem_threads);
+ATF_TC_HEAD(isc_mem_threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "gets and puts from several threads "
+			  "keep the water marks working");
+}
+
+ATF_TC_BODY(isc_mem_threads, tc) {
+	isc_result_t result;
+	isc_thread_t threads[NTHREADS];
+	size_t hiwater = 4 * 1024 * 1024;
+	unsigned int debugging;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Recording allocations would bypass the per-thread caches;
+	 * nothing else allocates while this context is in use.
+	 */
+	debugging = isc_mem_debugging;
+	isc_mem_debugging = 0;
+
+	result = isc_mem_create(0, 0, &tmctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_mem_setwater(tmctx, water, NULL, hiwater, hiwater / 2);
+
+	for (i = 0; i < NTHREADS; i++) {
+		result = isc_thread_create(churn, NULL, &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++)
+		isc_thread_join(threads[i], NULL);
+
+	/*
+	 * Every thread alone goes past the high water mark, so the
+	 * mark must have been crossed both ways; what the threads' caches
+	 * still hold counts as in use but stays well below the mark.
+	 */
+	ATF_CHECK(hiwater_calls > 0);
+	ATF_CHECK(lowater_calls > 0);
+	ATF_CHECK(!isc_mem_isovermem(tmctx));
+	ATF_CHECK(isc_mem_inuse(tmctx) < hiwater / 2);
+	ATF_CHECK(isc_mem_maxinuse(tmctx) > hiwater);
+
+	isc_mem_setwater(tmctx, NULL, NULL, 0, 0);
+	/* Fails on an accounting mismatch. */
+	isc_mem_destroy(&tmctx);
+	isc_mem_debugging = debugging;
+
+	isc_test_end();
+}
+
+#define NSIZES		68	/* 16 to 1088 bytes, below the max size */
+#define NPERSIZE	64
+
+ATF_TC(isc_mem_overmem);
+ATF_TC_HEAD(isc_mem_overmem, tc) {
+	atf_tc_set_md_var(tc, "descr", "blocks freed while over the high "
+			  "water mark are not held back by the caches");
+}
+
+ATF_TC_BODY(isc_mem_overmem, tc) {
+	isc_result_t result;
+	void *ptrs[NSIZES][NPERSIZE];
+	size_t hiwater = 1024 * 1024, lowater = 64 * 1024;
+	unsigned int debugging;
+	int i, j;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	debugging = isc_mem_debugging;
+	isc_mem_debugging = 0;
+
+	result = isc_mem_create(0, 0, &tmctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_mem_setwater(tmctx, water, NULL, hiwater, lowater);
+	hiwater_calls = lowater_calls = 0;
+
+	for (i = 0; i < NSIZES; i++)
+		for (j = 0; j < NPERSIZE; j++) {
+			ptrs[i][j] = isc_mem_get(tmctx, (i + 1) * 16);
+			ATF_REQUIRE(ptrs[i][j] != NULL);
+		}
+	ATF_CHECK(isc_mem_isovermem(tmctx));
+	ATF_CHECK_EQ(hiwater_calls, 1);
+
+	/*
+	 * Partly filled caches for every size would add up to more
+	 * than the low water mark if they kept their blocks.
+	 */
+	for (i = 0; i < NSIZES; i++)
+		for (j = 0; j < NPERSIZE; j++)
+			isc_mem_put(tmctx, ptrs[i][j], (i + 1) * 16);
+	ATF_CHECK(!isc_mem_isovermem(tmctx));
+	ATF_CHECK_EQ(lowater_calls, 1);
+	ATF_CHECK(isc_mem_inuse(tmctx) < lowater);
+
+	isc_mem_setwater(tmctx, NULL, NULL, 0, 0);
+	isc_mem_destroy(&tmctx);
+	isc_mem_debugging = debugging;
+
+	isc_test_end();
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, isc_mem_total);
 	ATF_TP_ADD_TC(tp, isc_mem_inuse);
+#ifdef ISC_PLATFORM_USETHREADS
+	ATF_TP_ADD_TC(tp, isc_mem_threads);
+	ATF_TP_ADD_TC(tp, isc_mem_overmem);
+#endif
 
 	return (atf_no_error());
 }
@@ -18,6 +18,7 @@
 #include <isc/platform.h>
 #include <isc/socket.h>
 #include <isc/print.h>
+#include <isc/stats.h>
 
 #include "../task_p.h"
 #include "../unix/socket_p.h"
@@ -313,6 +314,151 @@ ATF_TC_BODY(udp_dup, tc) {
 	isc_test_end();
 }
 
+/* Test batched UDP sendto/recv */
+#define NBATCH	8
+
+static isc_uint64_t sockstats[isc_sockstatscounter_max];
+
+static void
+getstat(isc_statscounter_t counter, isc_uint64_t value, void *arg) {
+	UNUSED(arg);
+
+	sockstats[counter] = value;
+}
+
+static isc_uint64_t
+sumstats(isc_stats_t *stats, isc_statscounter_t first,
+	 isc_statscounter_t last)
+{
+	isc_uint64_t total = 0;
+	isc_statscounter_t counter;
+
+	memset(sockstats, 0, sizeof(sockstats));
+	isc_stats_dump(stats, getstat, NULL, 0);
+	for (counter = first; counter <= last; counter++)
+		total += sockstats[counter];
+	return (total);
+}
+
+ATF_TC(udp_batch);
+ATF_TC_HEAD(udp_batch, tc) {
+	atf_tc_set_md_var(tc, "descr", "batched UDP sendto/recv");
+}
+ATF_TC_BODY(udp_batch, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	isc_stats_t *stats = NULL;
+	isc_socketevent_t *dev;
+	char sendbuf[NBATCH][16], recvbuf[NBATCH][BUFSIZ];
+	completion_t completion[NBATCH], sendcompletion[NBATCH];
+	isc_region_t r;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_stats_create(mctx, &stats, isc_sockstatscounter_max);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_socketmgr_setstats(socketmgr, stats);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+	isc_sockaddr_fromin(&addr2, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s1, &addr1);
+	ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+			 isc_result_totext(result));
+	ATF_REQUIRE(isc_sockaddr_getport(&addr1) != 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s2, &addr2);
+	ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+			 isc_result_totext(result));
+	ATF_REQUIRE(isc_sockaddr_getport(&addr2) != 0);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Queue the receives first, so that the datagrams arriving
+	 * later can be read together.
+	 */
+	for (i = 0; i < NBATCH; i++) {
+		completion_init(&completion[i]);
+		recvbuf[i][0] = '\0';
+		dev = isc_socket_socketevent(mctx, s2, ISC_SOCKEVENT_RECVDONE,
+					     event_done, &completion[i]);
+		ATF_REQUIRE(dev != NULL);
+		r.base = (void *) recvbuf[i];
+		r.length = BUFSIZ;
+		result = isc_socket_recv2(s2, &r, 1, task, dev,
+					  ISC_SOCKFLAG_BATCH);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/*
+	 * With nothing queued ahead of them, batched sends are
+	 * written out at once.
+	 */
+	for (i = 0; i < NBATCH; i++) {
+		snprintf(sendbuf[i], sizeof(sendbuf[i]), "batch %u", i);
+		completion_init(&sendcompletion[i]);
+		dev = isc_socket_socketevent(mctx, s1, ISC_SOCKEVENT_SENDDONE,
+					     event_done, &sendcompletion[i]);
+		ATF_REQUIRE(dev != NULL);
+		r.base = (void *) sendbuf[i];
+		r.length = strlen(sendbuf[i]) + 1;
+		result = isc_socket_sendto2(s1, &r, task, &addr2, NULL, dev,
+					    ISC_SOCKFLAG_IMMEDIATE |
+					    ISC_SOCKFLAG_NORETRY |
+					    ISC_SOCKFLAG_BATCH);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		if (result == ISC_R_SUCCESS) {
+			ATF_CHECK_EQ(dev->result, ISC_R_SUCCESS);
+			isc_event_free((isc_event_t **)&dev);
+		} else
+			waitfor(&sendcompletion[i]);
+	}
+
+	for (i = 0; i < NBATCH; i++) {
+		waitfor(&completion[i]);
+		ATF_CHECK(completion[i].done);
+		ATF_CHECK_EQ(completion[i].result, ISC_R_SUCCESS);
+		snprintf(sendbuf[i], sizeof(sendbuf[i]), "batch %u", i);
+		ATF_CHECK_STREQ(recvbuf[i], sendbuf[i]);
+	}
+
+	ATF_CHECK_EQ(sumstats(stats, isc_sockstatscounter_udpsendbatch1,
+			      isc_sockstatscounter_udpsendbatch16), 0);
+#if defined(__linux__) && defined(MSG_WAITFORONE) && \
+    defined(ISC_NET_BSD44MSGHDR)
+	/* The receives were satisfied by recvmmsg(). */
+	ATF_CHECK(sumstats(stats, isc_sockstatscounter_udprecvbatch1,
+			   isc_sockstatscounter_udprecvbatch16) > 0);
+#endif
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+
+	isc_stats_detach(&stats);
+
+	isc_test_end();
+}
+
 /* Test TCP sendto/recv (IPv4) */
 ATF_TC(udp_dscp_v4);
 ATF_TC_HEAD(udp_dscp_v4, tc) {
@@ -780,6 +926,7 @@ ATF_TC_BODY(net_probedscp, tc) {
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, udp_sendto);
 	ATF_TP_ADD_TC(tp, udp_dup);
+	ATF_TP_ADD_TC(tp, udp_batch);
 	ATF_TP_ADD_TC(tp, tcp_dscp_v4);
 	ATF_TP_ADD_TC(tp, tcp_dscp_v6);
 	ATF_TP_ADD_TC(tp, udp_dscp_v4);
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <string.h>
+
+#include <isc/platform.h>
+#include <isc/result.h>
+#include <isc/stats.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include "isctest.h"
+
+#define NCOUNTERS	10
+
+static void
+collect(isc_statscounter_t counter, isc_uint64_t value, void *arg) {
+	isc_uint64_t *values = arg;
+
+	ATF_REQUIRE(counter < NCOUNTERS);
+	values[counter] = value;
+}
+
+static void
+getvalues(isc_stats_t *stats, isc_uint64_t *values) {
+	memset(values, 0xff, sizeof(*values) * NCOUNTERS);
+	isc_stats_dump(stats, collect, values, ISC_STATSDUMP_VERBOSE);
+}
+
+ATF_TC(basic);
+ATF_TC_HEAD(basic, tc) {
+	atf_tc_set_md_var(tc, "descr", "increment, decrement, set and dump");
+}
+ATF_TC_BODY(basic, tc) {
+	isc_result_t result;
+	isc_stats_t *stats = NULL;
+	isc_uint64_t values[NCOUNTERS];
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_stats_create(mctx, &stats, NCOUNTERS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(isc_stats_ncounters(stats), NCOUNTERS);
+
+	getvalues(stats, values);
+	for (i = 0; i < NCOUNTERS; i++)
+		ATF_CHECK_EQ(values[i], 0);
+
+	for (i = 0; i < NCOUNTERS; i++) {
+		int j;
+
+		for (j = 0; j <= i; j++)
+			isc_stats_increment(stats, i);
+	}
+	isc_stats_decrement(stats, 3);
+
+	getvalues(stats, values);
+	for (i = 0; i < NCOUNTERS; i++)
+		ATF_CHECK_EQ(values[i], (isc_uint64_t)(i == 3 ? i : i + 1));
+
+	isc_stats_set(stats, 1000, 5);
+	getvalues(stats, values);
+	ATF_CHECK_EQ(values[5], 1000);
+	ATF_CHECK_EQ(values[4], 5);
+
+	/* Without ISC_STATSDUMP_VERBOSE, zero counters are skipped. */
+	isc_stats_set(stats, 0, 0);
+	memset(values, 0, sizeof(values));
+	values[0] = 42;
+	isc_stats_dump(stats, collect, values, 0);
+	ATF_CHECK_EQ(values[0], 42);
+
+	isc_stats_detach(&stats);
+	ATF_CHECK_EQ(stats, NULL);
+
+	isc_test_end();
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+#define NTHREADS	8
+#define NUPDATES	100000
+
+static isc_stats_t *tstats = NULL;
+
+static void *
+updater(void *arg) {
+	int i;
+
+	UNUSED(arg);
+
+	for (i = 0; i < NUPDATES; i++) {
+		isc_stats_increment(tstats, 0);
+		isc_stats_decrement(tstats, 1);
+		if ((i % 2) == 0)
+			isc_stats_increment(tstats, 2);
+	}
+
+	return (NULL);
+}
+
+ATF_TC(threads);
+ATF_TC_HEAD(threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "updates from several threads are "
+			  "all counted");
+}
+ATF_TC_BODY(threads, tc) {
+	isc_result_t result;
+	isc_thread_t threads[NTHREADS];
+	isc_uint64_t values[NCOUNTERS];
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_stats_create2(mctx, &tstats, NCOUNTERS,
+				   ISC_STATSCREATE_SHARDED);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Decrements from other threads must cancel a value set here,
+	 * whatever shard either lands in.
+	 */
+	isc_stats_set(tstats, NTHREADS * NUPDATES, 1);
+
+	for (i = 0; i < NTHREADS; i++) {
+		result = isc_thread_create(updater, NULL, &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++)
+		isc_thread_join(threads[i], NULL);
+
+	getvalues(tstats, values);
+	ATF_CHECK_EQ(values[0], NTHREADS * NUPDATES);
+	ATF_CHECK_EQ(values[1], 0);
+	ATF_CHECK_EQ(values[2], NTHREADS * NUPDATES / 2);
+	for (i = 3; i < NCOUNTERS; i++)
+		ATF_CHECK_EQ(values[i], 0);
+
+	/*
+	 * Setting a counter whose value is spread over the shards.
+	 */
+	isc_stats_set(tstats, 7, 0);
+	isc_stats_set(tstats, 0, 2);
+	getvalues(tstats, values);
+	ATF_CHECK_EQ(values[0], 7);
+	ATF_CHECK_EQ(values[1], 0);
+	ATF_CHECK_EQ(values[2], 0);
+
+	isc_stats_detach(&tstats);
+
+	isc_test_end();
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, basic);
+#ifdef ISC_PLATFORM_USETHREADS
+	ATF_TP_ADD_TC(tp, threads);
+#endif
+	return (atf_no_error());
+}
@@ -56,6 +56,93 @@ set_and_drop(isc_task_t *task, isc_event_t *event) {
 	isc_taskmgr_setmode(taskmgr, isc_taskmgrmode_normal);
 }
 
+#ifdef ISC_PLATFORM_USETHREADS
+#define NWORKERS	4
+
+static int blocked_result;
+
+/*
+ * Hold this worker until every other event has been run, so that the
+ * tasks waiting behind it on its queue can only be run by stealing.
+ */
+static void
+block(isc_task_t *task, isc_event_t *event) {
+	int i = 0, *value = (int *) event->ev_arg;
+	int n;
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+	do {
+		LOCK(&set_lock);
+		n = counter;
+		UNLOCK(&set_lock);
+		if (n == *value)
+			break;
+		isc_test_nap(1000);
+	} while (i++ < 5000);
+	LOCK(&set_lock);
+	blocked_result = n;
+	UNLOCK(&set_lock);
+}
+
+static void
+count(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	isc_event_free(&event);
+	LOCK(&set_lock);
+	counter++;
+	UNLOCK(&set_lock);
+}
+
+static isc_boolean_t spin_stop;
+static int spins;
+
+/* Keep resending the event to the task until told to stop. */
+static void
+spin(isc_task_t *task, isc_event_t *event) {
+	isc_boolean_t stop;
+
+	LOCK(&set_lock);
+	spins++;
+	stop = spin_stop;
+	if (stop)
+		counter++;
+	UNLOCK(&set_lock);
+	if (stop)
+		isc_event_free(&event);
+	else
+		isc_task_send(task, &event);
+}
+
+static int excl_spins;
+static isc_result_t excl_result, excl_again;
+
+static void
+exclusive(isc_task_t *task, isc_event_t *event) {
+	int before, after;
+
+	isc_event_free(&event);
+
+	excl_result = isc_task_beginexclusive(task);
+	LOCK(&set_lock);
+	before = spins;
+	UNLOCK(&set_lock);
+	isc_test_nap(100000);
+	LOCK(&set_lock);
+	after = spins;
+	UNLOCK(&set_lock);
+	excl_again = isc_task_beginexclusive(task);
+	if (excl_result == ISC_R_SUCCESS)
+		isc_task_endexclusive(task);
+
+	LOCK(&set_lock);
+	excl_spins = after - before;
+	UNLOCK(&set_lock);
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
 /*
  * Individual unit tests
  */
@@ -394,6 +481,189 @@ ATF_TC_BODY(privilege_drop, tc) {
 	isc_test_end();
 }
 
+/*
+ * Work stealing: while one worker is stuck in a long event, the tasks
+ * queued behind it are run by the other workers.
+ */
+ATF_TC(steal_work);
+ATF_TC_HEAD(steal_work, tc) {
+	atf_tc_set_md_var(tc, "descr", "idle workers steal ready tasks");
+}
+ATF_TC_BODY(steal_work, tc) {
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_result_t result;
+	isc_taskmgr_t *manager = NULL;
+	isc_task_t *tasks[NWORKERS * 4];
+	isc_event_t *event;
+	int expected = NWORKERS * 4 - 1;
+	unsigned int n;
+	int i = 0, blocked;
+
+	UNUSED(tc);
+
+	counter = 0;
+	blocked_result = -1;
+	result = isc_mutex_init(&set_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_taskmgr_create(mctx, NWORKERS, 0, &manager);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Tasks are spread over the queues in turn, so every queue,
+	 * including the blocked one, has several of them.
+	 */
+	for (n = 0; n < NWORKERS * 4; n++) {
+		tasks[n] = NULL;
+		result = isc_task_create(manager, 0, &tasks[n]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	event = isc_event_allocate(mctx, tasks[0], ISC_TASKEVENT_TEST,
+				   block, &expected, sizeof (isc_event_t));
+	ATF_REQUIRE(event != NULL);
+	isc_task_send(tasks[0], &event);
+
+	for (n = 1; n < NWORKERS * 4; n++) {
+		event = isc_event_allocate(mctx, tasks[n], ISC_TASKEVENT_TEST,
+					   count, NULL, sizeof (isc_event_t));
+		ATF_REQUIRE(event != NULL);
+		isc_task_send(tasks[n], &event);
+	}
+
+	for (;;) {
+		LOCK(&set_lock);
+		blocked = blocked_result;
+		UNLOCK(&set_lock);
+		if (blocked != -1 || i++ > 10000)
+			break;
+		isc_test_nap(1000);
+	}
+
+	/* Everything else ran while the first worker was held. */
+	ATF_CHECK_EQ(blocked_result, expected);
+
+	for (n = 0; n < NWORKERS * 4; n++)
+		isc_task_detach(&tasks[n]);
+	isc_taskmgr_destroy(&manager);
+
+	isc_test_end();
+	DESTROYLOCK(&set_lock);
+#else
+	UNUSED(tc);
+
+	atf_tc_skip("requires worker threads");
+#endif
+}
+
+/*
+ * Exclusive mode: no other task runs between isc_task_beginexclusive()
+ * and isc_task_endexclusive(), and the workers resume afterwards.
+ */
+ATF_TC(exclusive_mode);
+ATF_TC_HEAD(exclusive_mode, tc) {
+	atf_tc_set_md_var(tc, "descr", "exclusive mode stops other tasks");
+}
+ATF_TC_BODY(exclusive_mode, tc) {
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_result_t result;
+	isc_taskmgr_t *manager = NULL;
+	isc_task_t *spinners[NWORKERS], *task = NULL;
+	isc_event_t *event;
+	unsigned int n;
+	int i, before, now;
+
+	UNUSED(tc);
+
+	counter = 0;
+	spins = 0;
+	spin_stop = ISC_FALSE;
+	excl_spins = -1;
+	result = isc_mutex_init(&set_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_taskmgr_create(mctx, NWORKERS, 0, &manager);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (n = 0; n < NWORKERS; n++) {
+		spinners[n] = NULL;
+		result = isc_task_create(manager, 0, &spinners[n]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		event = isc_event_allocate(mctx, spinners[n],
+					   ISC_TASKEVENT_TEST, spin, NULL,
+					   sizeof (isc_event_t));
+		ATF_REQUIRE(event != NULL);
+		isc_task_send(spinners[n], &event);
+	}
+	result = isc_task_create(manager, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	event = isc_event_allocate(mctx, task, ISC_TASKEVENT_TEST,
+				   exclusive, NULL, sizeof (isc_event_t));
+	ATF_REQUIRE(event != NULL);
+	isc_task_send(task, &event);
+
+	for (i = 0; i < 10000; i++) {
+		LOCK(&set_lock);
+		now = excl_spins;
+		UNLOCK(&set_lock);
+		if (now != -1)
+			break;
+		isc_test_nap(1000);
+	}
+
+	ATF_CHECK_EQ(excl_result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(excl_again, ISC_R_LOCKBUSY);
+	/* The spinners were stopped for the whole exclusive section. */
+	ATF_CHECK_EQ(excl_spins, 0);
+
+	/* ...and run again once it has ended. */
+	LOCK(&set_lock);
+	before = spins;
+	UNLOCK(&set_lock);
+	for (i = 0; i < 10000; i++) {
+		LOCK(&set_lock);
+		now = spins;
+		UNLOCK(&set_lock);
+		if (now > before)
+			break;
+		isc_test_nap(1000);
+	}
+	ATF_CHECK(now > before);
+
+	LOCK(&set_lock);
+	spin_stop = ISC_TRUE;
+	UNLOCK(&set_lock);
+	for (i = 0; i < 10000; i++) {
+		LOCK(&set_lock);
+		now = counter;
+		UNLOCK(&set_lock);
+		if (now == NWORKERS)
+			break;
+		isc_test_nap(1000);
+	}
+	ATF_CHECK_EQ(counter, NWORKERS);
+
+	for (n = 0; n < NWORKERS; n++)
+		isc_task_detach(&spinners[n]);
+	isc_task_detach(&task);
+	isc_taskmgr_destroy(&manager);
+
+	isc_test_end();
+	DESTROYLOCK(&set_lock);
+#else
+	UNUSED(tc);
+
+	atf_tc_skip("requires worker threads");
+#endif
+}
+
 /*
  * Main
  */
@@ -402,6 +672,8 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, all_events);
 	ATF_TP_ADD_TC(tp, privileged_events);
 	ATF_TP_ADD_TC(tp, privilege_drop);
+	ATF_TP_ADD_TC(tp, steal_work);
+	ATF_TP_ADD_TC(tp, exclusive_mode);
 
 	return (atf_no_error());
 }
@@ -0,0 +1,481 @@
+/*
+ * Copyright (C) 2017  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * The timing wheels are internal to timer.c, so it is included here
+ * and the wheel functions are called directly, on a shard that has
+ * no run thread and whose clock is moved by hand.
+ */
+#include "../timer.c"
+
+/*
+ * An arbitrary, unaligned starting tick, so that the timers below
+ * are cascaded at different points in their lifetimes.
+ */
+#define BASE		1500000000123ULL
+
+static timershard_t shard;
+
+/*
+ * Helper functions
+ */
+static void
+setup_shard(isc_uint64_t current) {
+	unsigned int level, i;
+
+	memset(&shard, 0, sizeof(shard));
+	INIT_LIST(shard.timers);
+	for (level = 0; level < TIMER_LEVELS; level++)
+		for (i = 0; i < TIMER_SLOTS; i++)
+			INIT_LIST(shard.wheel[level][i]);
+	INIT_LIST(shard.overflow);
+	shard.current = current;
+}
+
+static void
+setup_timer(isc__timer_t *timer) {
+	memset(timer, 0, sizeof(*timer));
+	ISC_LINK_INIT(timer, wlink);
+	timer->shard = &shard;
+	timer->type = isc_timertype_once;
+}
+
+/*
+ * Make 'timer' due at 'tick', as isc_timer_reset() would.
+ */
+static void
+set_tick(isc__timer_t *timer, isc_uint64_t tick) {
+	isc_result_t result;
+	isc_time_t now;
+
+	tick2time(shard.current, &now);
+	tick2time(tick, &timer->expires);
+	result = schedule(timer, &now, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE_EQ(timer->tick, tick);
+}
+
+/*
+ * Check that every scheduled timer is in the slot it says it is in,
+ * and that the counts of timers are right.
+ */
+static void
+check_shard(void) {
+	isc__timer_t *timer;
+	timerlist_t *slot;
+	unsigned int level, i, n, total = 0;
+
+	for (level = 0; level <= TIMER_LEVELS; level++) {
+		n = 0;
+		for (i = 0; i < TIMER_SLOTS; i++) {
+			if (level == TIMER_OVERFLOW) {
+				if (i > 0)
+					break;
+				slot = &shard.overflow;
+			} else
+				slot = &shard.wheel[level][i];
+			for (timer = HEAD(*slot);
+			     timer != NULL;
+			     timer = NEXT(timer, wlink))
+			{
+				ATF_CHECK_EQ(timer->level, level);
+				ATF_CHECK(timer->slot == slot);
+				ATF_CHECK(timer->tick >= shard.current);
+				n++;
+			}
+		}
+		ATF_CHECK_EQ(n, shard.nlevel[level]);
+		total += n;
+	}
+	ATF_CHECK_EQ(total, shard.nscheduled);
+}
+
+/*
+ * Check that the run thread would wake up no later than 'tick'.
+ */
+static void
+check_nextdue(isc_uint64_t tick) {
+	isc_time_t due;
+
+	wheel_nextdue(&shard, &due);
+	ATF_CHECK(time2tick(&due, ISC_FALSE) <= tick);
+}
+
+/*
+ * Move the clock on to 'tick'.  Return the number of timers that
+ * expired, and the first of them in '*timerp'.
+ */
+static unsigned int
+advance(isc_uint64_t tick, isc__timer_t **timerp) {
+	timerlist_t expired;
+	isc__timer_t *timer;
+	unsigned int n = 0;
+
+	if (timerp != NULL)
+		*timerp = NULL;
+	INIT_LIST(expired);
+	wheel_advance(&shard, tick, &expired);
+	ATF_CHECK(shard.current > tick);
+	while ((timer = HEAD(expired)) != NULL) {
+		UNLINK(expired, timer, wlink);
+		if (timerp != NULL && n == 0)
+			*timerp = timer;
+		n++;
+	}
+	check_shard();
+	return (n);
+}
+
+/*
+ * Wake up as the run thread would, at the time wheel_nextdue() asks
+ * for, and check that no timer expires later than it was due.  Return
+ * the number of timers that expired, and the first of them in
+ * '*timerp'.
+ */
+static unsigned int
+wakeup(isc__timer_t **timerp) {
+	timerlist_t expired;
+	isc__timer_t *timer;
+	isc_time_t due;
+	isc_uint64_t tick;
+	unsigned int n = 0;
+
+	if (timerp != NULL)
+		*timerp = NULL;
+	wheel_nextdue(&shard, &due);
+	tick = time2tick(&due, ISC_FALSE);
+	ATF_CHECK(tick >= shard.current);
+	INIT_LIST(expired);
+	wheel_advance(&shard, tick, &expired);
+	while ((timer = HEAD(expired)) != NULL) {
+		UNLINK(expired, timer, wlink);
+		ATF_CHECK_EQ(timer->tick, tick);
+		if (timerp != NULL && n == 0)
+			*timerp = timer;
+		n++;
+	}
+	check_shard();
+	return (n);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(cascade);
+ATF_TC_HEAD(cascade, tc) {
+	atf_tc_set_md_var(tc, "descr", "timers are cascaded down through "
+			  "every level and expire on time");
+}
+ATF_TC_BODY(cascade, tc) {
+	static const isc_uint64_t deltas[] = {
+		1, 255,						/* 0 */
+		256, 300, 65535,				/* 1 */
+		65536, 70000, 16777215,				/* 2 */
+		16777216, 1000000000, 4294967295ULL	/* 3 */
+	};
+	static const unsigned int levels[] = {
+		0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3
+	};
+	isc__timer_t timers[sizeof(deltas) / sizeof(deltas[0])];
+	isc__timer_t *timer;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	setup_shard(BASE);
+	for (i = 0; i < sizeof(timers) / sizeof(timers[0]); i++) {
+		setup_timer(&timers[i]);
+		set_tick(&timers[i], BASE + deltas[i]);
+		ATF_CHECK_EQ(timers[i].level, levels[i]);
+	}
+	check_shard();
+
+	for (i = 0; i < sizeof(timers) / sizeof(timers[0]); i++) {
+		check_nextdue(BASE + deltas[i]);
+		ATF_CHECK_EQ(advance(BASE + deltas[i] - 1, NULL), 0);
+		ATF_CHECK_EQ(timers[i].level, 0);
+		ATF_CHECK_EQ(advance(BASE + deltas[i], &timer), 1);
+		ATF_CHECK(timer == &timers[i]);
+	}
+	ATF_CHECK_EQ(shard.nscheduled, 0);
+}
+
+ATF_TC(overflow);
+ATF_TC_HEAD(overflow, tc) {
+	atf_tc_set_md_var(tc, "descr", "timers due beyond the top level "
+			  "expire on time");
+}
+ATF_TC_BODY(overflow, tc) {
+	static const isc_uint64_t deltas[] = {
+		100,
+		4294967296ULL,
+		4294967301ULL,
+		274877919251ULL	/* about 8.7 years */
+	};
+	isc__timer_t timers[sizeof(deltas) / sizeof(deltas[0])];
+	isc__timer_t *timer;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	setup_shard(BASE);
+	for (i = 0; i < sizeof(timers) / sizeof(timers[0]); i++) {
+		setup_timer(&timers[i]);
+		set_tick(&timers[i], BASE + deltas[i]);
+		ATF_CHECK_EQ(timers[i].level, i == 0 ? 0 : TIMER_OVERFLOW);
+	}
+	check_shard();
+
+	/*
+	 * Once only the overflow list is left, the wheel wakes up at
+	 * most once per turn of the top level.
+	 */
+	ATF_CHECK_EQ(advance(BASE + deltas[0], &timer), 1);
+	ATF_CHECK(timer == &timers[0]);
+	check_nextdue(BASE + deltas[1]);
+
+	for (i = 1; i < sizeof(timers) / sizeof(timers[0]); i++) {
+		check_nextdue(BASE + deltas[i]);
+		ATF_CHECK_EQ(advance(BASE + deltas[i] - 1, NULL), 0);
+		ATF_CHECK_EQ(timers[i].level, 0);
+		ATF_CHECK_EQ(advance(BASE + deltas[i], &timer), 1);
+		ATF_CHECK(timer == &timers[i]);
+	}
+	ATF_CHECK_EQ(shard.nscheduled, 0);
+}
+
+ATF_TC(reset_cascading);
+ATF_TC_HEAD(reset_cascading, tc) {
+	atf_tc_set_md_var(tc, "descr", "timers reset or stopped while they "
+			  "are being cascaded expire when they should");
+}
+ATF_TC_BODY(reset_cascading, tc) {
+	isc__timer_t stopped, later, sooner, again;
+	isc__timer_t *timer;
+	isc_uint64_t tick, boundary;
+
+	UNUSED(tc);
+
+	setup_shard(BASE);
+	setup_timer(&stopped);
+	setup_timer(&later);
+	setup_timer(&sooner);
+	setup_timer(&again);
+
+	/*
+	 * Three timers in the same level 2 slot, and one in level 1.
+	 */
+	tick = BASE + 70000;
+	set_tick(&stopped, tick);
+	set_tick(&later, tick);
+	set_tick(&sooner, tick + 10);
+	set_tick(&again, BASE + 1000);
+	ATF_CHECK_EQ(stopped.level, 2);
+	ATF_CHECK(stopped.slot == later.slot && later.slot == sooner.slot);
+	ATF_CHECK_EQ(again.level, 1);
+
+	/*
+	 * Let 'again' reach level 0, then push it back up to level 1.
+	 */
+	boundary = (BASE + 1000) & ~(isc_uint64_t)TIMER_MASK;
+	ATF_CHECK_EQ(advance(boundary, NULL), 0);
+	ATF_CHECK_EQ(again.level, 0);
+	set_tick(&again, BASE + 1300);
+	ATF_CHECK_EQ(again.level, 1);
+	ATF_CHECK_EQ(advance(BASE + 1299, NULL), 0);
+	ATF_CHECK_EQ(advance(BASE + 1300, &timer), 1);
+	ATF_CHECK(timer == &again);
+
+	/*
+	 * Cascade the level 2 slot into level 1, then stop one of its
+	 * timers, move one much further away and bring one forward.
+	 */
+	boundary = tick & ~(isc_uint64_t)0xffff;
+	ATF_REQUIRE(boundary > BASE + 1300U);
+	ATF_CHECK_EQ(advance(boundary, NULL), 0);
+	ATF_CHECK_EQ(stopped.level, 1);
+	ATF_CHECK_EQ(later.level, 1);
+	ATF_CHECK_EQ(sooner.level, 1);
+
+	deschedule(&stopped);
+	ATF_CHECK(stopped.slot == NULL);
+	set_tick(&later, tick + 4294967296ULL);
+	ATF_CHECK_EQ(later.level, TIMER_OVERFLOW);
+	set_tick(&sooner, shard.current + 5);
+	ATF_CHECK_EQ(sooner.level, 0);
+	check_shard();
+
+	ATF_CHECK_EQ(advance(shard.current + 4, NULL), 0);
+	ATF_CHECK_EQ(advance(shard.current, &timer), 1);
+	ATF_CHECK(timer == &sooner);
+
+	ATF_CHECK_EQ(advance(tick + 10, NULL), 0);
+	ATF_CHECK_EQ(advance(later.tick - 1, NULL), 0);
+	ATF_CHECK_EQ(advance(later.tick, &timer), 1);
+	ATF_CHECK(timer == &later);
+	ATF_CHECK_EQ(shard.nscheduled, 0);
+}
+
+ATF_TC(nextdue_mixed);
+ATF_TC_HEAD(nextdue_mixed, tc) {
+	atf_tc_set_md_var(tc, "descr", "a higher level cascaded before the "
+			  "next slot of a lower level is not woken up late");
+}
+ATF_TC_BODY(nextdue_mixed, tc) {
+	isc__timer_t high, low, cascaded, level0;
+	isc__timer_t *timer;
+	isc_uint64_t boundary;
+	unsigned int i, n;
+
+	UNUSED(tc);
+
+	/*
+	 * A level 2 timer due just after the next level 2 cascade, and
+	 * a level 1 timer whose slot comes well after that cascade.
+	 */
+	boundary = (BASE + 0x10000) & ~(isc_uint64_t)0xffff;
+	setup_shard(boundary - 0xffff);
+	setup_timer(&high);
+	setup_timer(&low);
+	set_tick(&high, boundary + 0x5);
+	ATF_CHECK_EQ(high.level, 2);
+	ATF_CHECK_EQ(advance(boundary - 0x8000, NULL), 0);
+	set_tick(&low, boundary + 0x7f00);
+	ATF_CHECK_EQ(low.level, 1);
+	check_nextdue(boundary);
+
+	/*
+	 * The same between levels 1 and 0.
+	 */
+	setup_timer(&cascaded);
+	setup_timer(&level0);
+	set_tick(&cascaded, boundary - 0x100 + 0x10);
+	ATF_CHECK_EQ(cascaded.level, 1);
+	ATF_CHECK_EQ(advance(boundary - 0x180, NULL), 0);
+	set_tick(&level0, boundary - 0x90);
+	ATF_CHECK_EQ(level0.level, 0);
+	check_nextdue(boundary - 0x100);
+
+	n = 0;
+	for (i = 0; i < 1000 && shard.nscheduled > 0; i++) {
+		if (wakeup(&timer) != 0) {
+			ATF_CHECK(timer == (n == 0 ? &cascaded :
+					    n == 1 ? &level0 :
+					    n == 2 ? &high : &low));
+			n++;
+		}
+	}
+	ATF_CHECK_EQ(n, 4);
+	ATF_CHECK_EQ(shard.nscheduled, 0);
+}
+
+static isc_mutex_t fired_lock;
+static int fired_short, fired_long;
+static isc_time_t fired_at;
+
+static void
+fired(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	LOCK(&fired_lock);
+	if (event->ev_arg == &fired_short) {
+		TIME_NOW(&fired_at);
+		fired_short++;
+	} else
+		fired_long++;
+	UNLOCK(&fired_lock);
+	isc_event_free(&event);
+}
+
+ATF_TC(long_timeout);
+ATF_TC_HEAD(long_timeout, tc) {
+	atf_tc_set_md_var(tc, "descr", "a timer due beyond the top level "
+			  "does not delay nor fire with a shorter one");
+}
+ATF_TC_BODY(long_timeout, tc) {
+	isc_result_t result;
+	isc_mem_t *mctx = NULL;
+	isc_taskmgr_t *taskmgr = NULL;
+	isc_timermgr_t *timermgr = NULL;
+	isc_task_t *task = NULL;
+	isc_timer_t *shorttimer = NULL, *longtimer = NULL;
+	isc_interval_t interval;
+	isc_time_t start, due;
+	int i, nshort = 0, nlong = 0;
+
+	UNUSED(tc);
+
+	result = isc_mutex_init(&fired_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_mem_create(0, 0, &mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_taskmgr_create(mctx, 1, 0, &taskmgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_timermgr_create(mctx, &timermgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* 60 days, more than the 49.7 the levels can hold. */
+	isc_interval_set(&interval, 60 * 24 * 3600, 0);
+	result = isc_timer_create(timermgr, isc_timertype_once, NULL,
+				  &interval, task, fired, &fired_long,
+				  &longtimer);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Long enough to be cascaded from level 1. */
+	TIME_NOW(&start);
+	isc_interval_set(&interval, 0, 400000000);
+	result = isc_time_add(&start, &interval, &due);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_timer_create(timermgr, isc_timertype_once, NULL,
+				  &interval, task, fired, &fired_short,
+				  &shorttimer);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 300 && nshort == 0; i++) {
+		usleep(10000);
+		LOCK(&fired_lock);
+		nshort = fired_short;
+		nlong = fired_long;
+		UNLOCK(&fired_lock);
+	}
+	ATF_CHECK_EQ(nshort, 1);
+	ATF_CHECK_EQ(nlong, 0);
+	if (nshort != 0)
+		ATF_CHECK(isc_time_compare(&fired_at, &due) >= 0);
+
+	isc_timer_detach(&shorttimer);
+	isc_timer_detach(&longtimer);
+	isc_task_detach(&task);
+	isc_timermgr_destroy(&timermgr);
+	isc_taskmgr_destroy(&taskmgr);
+	isc_mem_destroy(&mctx);
+	DESTROYLOCK(&fired_lock);
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, cascade);
+	ATF_TP_ADD_TC(tp, overflow);
+	ATF_TP_ADD_TC(tp, reset_cascading);
+	ATF_TP_ADD_TC(tp, nextdue_mixed);
+	ATF_TP_ADD_TC(tp, long_timeout);
+
+	return (atf_no_error());
+}
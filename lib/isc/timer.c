@@ -13,13 +13,14 @@
 #include <config.h>
 
 #include <isc/app.h>
+#include <isc/atomic.h>
 #include <isc/condition.h>
-#include <isc/heap.h>
 #include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/msgs.h>
 #include <isc/once.h>
+#include <isc/os.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/task.h>
@@ -63,50 +64,107 @@
 #define TIMER_MAGIC			ISC_MAGIC('T', 'I', 'M', 'R')
 #define VALID_TIMER(t)			ISC_MAGIC_VALID(t, TIMER_MAGIC)
 
+/*%
+ * Scheduled timers are kept in hierarchical timing wheels, so that
+ * scheduling, rescheduling and cancelling a timer are all O(1).
+ *
+ * Time is counted in ticks of TIMER_TICK nanoseconds.  A timer's due
+ * time is rounded up to a whole tick, so an event may be posted up to
+ * one tick late, but never early.  Each wheel has TIMER_LEVELS levels
+ * of TIMER_SLOTS slots: a timer due fewer than TIMER_SLOTS ticks after
+ * the wheel's current tick lives in level 0, in the slot indexed by
+ * the low TIMER_BITS bits of its due tick; one due fewer than
+ * TIMER_SLOTS^2 ticks away lives in level 1, indexed by the next
+ * TIMER_BITS bits, and so on.  Anything further away than the top
+ * level can hold is put on an overflow list.  Whenever the low bits
+ * of the current tick wrap around, the matching slot of the level
+ * above is "cascaded", i.e. its timers are redistributed into the
+ * lower levels.
+ *
+ * A manager runs several independent wheels ("shards"), each with its
+ * own lock and, in threaded builds, its own run thread, so that timer
+ * churn on a busy server is spread over several locks rather than
+ * serialized on one.  Timers are assigned to shards round-robin when
+ * they are created and stay there for their lifetime.
+ */
+#define TIMER_TICK			1000000		/* 1ms */
+#define TIMER_TICKSPERSEC		(1000000000 / TIMER_TICK)
+#define TIMER_BITS			8
+#define TIMER_SLOTS			(1 << TIMER_BITS)
+#define TIMER_MASK			(TIMER_SLOTS - 1)
+#define TIMER_LEVELS			4
+#define TIMER_OVERFLOW			TIMER_LEVELS
+
+#if defined(USE_TIMER_THREAD) && defined(ISC_PLATFORM_HAVEXADD)
+#define TIMER_MAXSHARDS			8
+#else
+#define TIMER_MAXSHARDS			1
+#endif
+
 typedef struct isc__timer isc__timer_t;
 typedef struct isc__timermgr isc__timermgr_t;
+typedef struct timershard timershard_t;
+typedef ISC_LIST(isc__timer_t) timerlist_t;
 
 struct isc__timer {
 	/*! Not locked. */
 	isc_timer_t			common;
 	isc__timermgr_t *		manager;
+	timershard_t *			shard;
 	isc_mutex_t			lock;
 	/*! Locked by timer lock. */
 	unsigned int			references;
 	isc_time_t			idle;
-	/*! Locked by manager lock. */
+	/*! Locked by shard lock. */
 	isc_timertype_t			type;
 	isc_time_t			expires;
 	isc_interval_t			interval;
 	isc_task_t *			task;
 	isc_taskaction_t		action;
 	void *				arg;
-	unsigned int			index;
 	isc_time_t			due;
+	isc_uint64_t			tick;
+	unsigned int			level;
+	timerlist_t *			slot;
+	LINK(isc__timer_t)		wlink;
 	LINK(isc__timer_t)		link;
 };
 
-#define TIMER_MANAGER_MAGIC		ISC_MAGIC('T', 'I', 'M', 'M')
-#define VALID_MANAGER(m)		ISC_MAGIC_VALID(m, TIMER_MANAGER_MAGIC)
-
-struct isc__timermgr {
+struct timershard {
 	/* Not locked. */
-	isc_timermgr_t			common;
-	isc_mem_t *			mctx;
+	isc__timermgr_t *		manager;
 	isc_mutex_t			lock;
-	/* Locked by manager lock. */
+	/* Locked by shard lock. */
 	isc_boolean_t			done;
 	LIST(isc__timer_t)		timers;
 	unsigned int			nscheduled;
 	isc_time_t			due;
+	isc_uint64_t			current;
+	unsigned int			nlevel[TIMER_LEVELS + 1];
+	timerlist_t			wheel[TIMER_LEVELS][TIMER_SLOTS];
+	timerlist_t			overflow;
 #ifdef USE_TIMER_THREAD
 	isc_condition_t			wakeup;
 	isc_thread_t			thread;
 #endif	/* USE_TIMER_THREAD */
+};
+
+#define TIMER_MANAGER_MAGIC		ISC_MAGIC('T', 'I', 'M', 'M')
+#define VALID_MANAGER(m)		ISC_MAGIC_VALID(m, TIMER_MANAGER_MAGIC)
+
+struct isc__timermgr {
+	/* Not locked. */
+	isc_timermgr_t			common;
+	isc_mem_t *			mctx;
+	unsigned int			nshards;
+	timershard_t *			shards;
+#if TIMER_MAXSHARDS > 1
+	isc_int32_t			next;
+#endif
 #ifdef USE_SHARED_MANAGER
+	/* Locked by the lock of the first shard. */
 	unsigned int			refs;
 #endif /* USE_SHARED_MANAGER */
-	isc_heap_t *			heap;
 };
 
 /*%
@@ -174,12 +232,224 @@ static struct isc__timermgrmethods {
 static isc__timermgr_t *timermgr = NULL;
 #endif /* USE_SHARED_MANAGER */
 
+static inline isc_uint64_t
+time2tick(const isc_time_t *t, isc_boolean_t roundup) {
+	unsigned int nanoseconds = isc_time_nanoseconds(t);
+	isc_uint64_t tick;
+
+	tick = (isc_uint64_t)isc_time_seconds(t) * TIMER_TICKSPERSEC +
+	       nanoseconds / TIMER_TICK;
+	if (roundup && (nanoseconds % TIMER_TICK) != 0)
+		tick++;
+	return (tick);
+}
+
+static inline void
+tick2time(isc_uint64_t tick, isc_time_t *t) {
+	isc_time_set(t, (unsigned int)(tick / TIMER_TICKSPERSEC),
+		     (unsigned int)(tick % TIMER_TICKSPERSEC) * TIMER_TICK);
+}
+
+/*
+ * Put 'timer' in the slot for 'timer->tick'.  A tick that has already
+ * gone by is treated as the current one.
+ *
+ * The caller must be holding the shard lock.
+ */
+static inline void
+wheel_link(timershard_t *shard, isc__timer_t *timer) {
+	isc_uint64_t delta;
+	unsigned int level;
+
+	if (timer->tick < shard->current)
+		timer->tick = shard->current;
+	delta = timer->tick - shard->current;
+
+	for (level = 0; level < TIMER_LEVELS; level++) {
+		if (delta < ((isc_uint64_t)1 << ((level + 1) * TIMER_BITS)))
+			break;
+	}
+	if (level < TIMER_LEVELS)
+		timer->slot = &shard->wheel[level][(timer->tick >>
+						    (level * TIMER_BITS)) &
+						   TIMER_MASK];
+	else
+		timer->slot = &shard->overflow;
+	timer->level = level;
+	APPEND(*timer->slot, timer, wlink);
+	shard->nlevel[level]++;
+}
+
+static inline void
+wheel_unlink(timershard_t *shard, isc__timer_t *timer) {
+	INSIST(timer->slot != NULL);
+	INSIST(shard->nlevel[timer->level] > 0);
+
+	UNLINK(*timer->slot, timer, wlink);
+	shard->nlevel[timer->level]--;
+	timer->slot = NULL;
+}
+
+/*
+ * Redistribute the timers in 'slot' relative to the current tick.
+ */
+static void
+wheel_cascade(timershard_t *shard, timerlist_t *slot) {
+	timerlist_t list;
+	isc__timer_t *timer;
+
+	if (EMPTY(*slot))
+		return;
+
+	INIT_LIST(list);
+	ISC_LIST_APPENDLIST(list, *slot, wlink);
+	while ((timer = HEAD(list)) != NULL) {
+		UNLINK(list, timer, wlink);
+		INSIST(shard->nlevel[timer->level] > 0);
+		shard->nlevel[timer->level]--;
+		wheel_link(shard, timer);
+	}
+}
+
+/*
+ * The clock has been stepped backwards: start the wheel again from
+ * 'tick' and put every timer back according to its due time.
+ */
+static void
+wheel_rebase(timershard_t *shard, isc_uint64_t tick) {
+	timerlist_t list;
+	isc__timer_t *timer;
+	unsigned int level, i;
+
+	INIT_LIST(list);
+	for (level = 0; level < TIMER_LEVELS; level++) {
+		for (i = 0; i < TIMER_SLOTS; i++)
+			ISC_LIST_APPENDLIST(list, shard->wheel[level][i],
+					    wlink);
+		shard->nlevel[level] = 0;
+	}
+	ISC_LIST_APPENDLIST(list, shard->overflow, wlink);
+	shard->nlevel[TIMER_OVERFLOW] = 0;
+
+	shard->current = tick;
+	while ((timer = HEAD(list)) != NULL) {
+		UNLINK(list, timer, wlink);
+		timer->tick = time2tick(&timer->due, ISC_TRUE);
+		wheel_link(shard, timer);
+	}
+}
+
+/*
+ * Move the wheel on to 'tick', cascading the higher levels as their
+ * slots come due, and append every timer due at or before 'tick' to
+ * 'expired'.  Stretches of ticks in which nothing can happen are
+ * skipped.
+ */
+static void
+wheel_advance(timershard_t *shard, isc_uint64_t tick, timerlist_t *expired) {
+	isc__timer_t *timer;
+	timerlist_t *slot;
+	isc_uint64_t current, next, span;
+	unsigned int level, i;
+
+	while (shard->current <= tick) {
+		current = shard->current;
+
+		if ((current & TIMER_MASK) == 0) {
+			for (level = 1; level < TIMER_LEVELS; level++) {
+				i = (current >> (level * TIMER_BITS)) &
+				    TIMER_MASK;
+				wheel_cascade(shard, &shard->wheel[level][i]);
+				if (i != 0)
+					break;
+			}
+			if (level == TIMER_LEVELS)
+				wheel_cascade(shard, &shard->overflow);
+		}
+
+		slot = &shard->wheel[0][current & TIMER_MASK];
+		while ((timer = HEAD(*slot)) != NULL) {
+			wheel_unlink(shard, timer);
+			INSIST(shard->nscheduled > 0);
+			shard->nscheduled--;
+			APPEND(*expired, timer, wlink);
+		}
+		shard->current++;
+
+		if (shard->nlevel[0] != 0)
+			continue;
+
+		/*
+		 * Level 0 is empty, so nothing can fire before the
+		 * next slot of the lowest non-empty level is cascaded.
+		 */
+		for (level = 1; level < TIMER_LEVELS; level++)
+			if (shard->nlevel[level] != 0)
+				break;
+		if (level == TIMER_LEVELS &&
+		    shard->nlevel[TIMER_OVERFLOW] == 0)
+		{
+			next = tick + 1;
+		} else {
+			span = (isc_uint64_t)1 << (level * TIMER_BITS);
+			next = (shard->current + span - 1) & ~(span - 1);
+			if (next > tick + 1)
+				next = tick + 1;
+		}
+		if (next > shard->current)
+			shard->current = next;
+	}
+}
+
+/*
+ * Return the time of the earliest tick at which the wheel has work
+ * to do.  Each level's next non-empty slot is cascaded at a multiple
+ * of that level's span, and a higher level may be cascaded before a
+ * lower one fires, so take the earliest of them over every non-empty
+ * level, including the overflow list.
+ */
+static void
+wheel_nextdue(timershard_t *shard, isc_time_t *due) {
+	isc_uint64_t base, next, span, tick;
+	unsigned int level, i;
+
+	INSIST(shard->nscheduled > 0);
+
+	next = ISC_UINT64_MAX;
+	for (level = 0; level < TIMER_LEVELS; level++) {
+		if (shard->nlevel[level] == 0)
+			continue;
+		span = (isc_uint64_t)1 << (level * TIMER_BITS);
+		base = (shard->current + span - 1) >> (level * TIMER_BITS);
+		if ((base << (level * TIMER_BITS)) >= next)
+			break;
+		for (i = 0; i < TIMER_SLOTS; i++) {
+			if (!EMPTY(shard->wheel[level]
+					       [(base + i) & TIMER_MASK]))
+				break;
+		}
+		INSIST(i < TIMER_SLOTS);
+		tick = (base + i) << (level * TIMER_BITS);
+		if (tick < next)
+			next = tick;
+	}
+
+	if (level == TIMER_LEVELS && shard->nlevel[TIMER_OVERFLOW] != 0) {
+		span = (isc_uint64_t)1 << (TIMER_LEVELS * TIMER_BITS);
+		tick = (shard->current + span - 1) & ~(span - 1);
+		if (tick < next)
+			next = tick;
+	}
+
+	INSIST(next != ISC_UINT64_MAX);
+	tick2time(next, due);
+}
+
 static inline isc_result_t
 schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 	isc_result_t result;
-	isc__timermgr_t *manager;
-	isc_time_t due;
-	int cmp;
+	timershard_t *shard;
+	isc_time_t due, when;
 #ifdef USE_TIMER_THREAD
 	isc_boolean_t timedwait;
 #endif
@@ -194,15 +464,15 @@ schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 	UNUSED(signal_ok);
 #endif /* USE_TIMER_THREAD */
 
-	manager = timer->manager;
+	shard = timer->shard;
 
 #ifdef USE_TIMER_THREAD
 	/*!
-	 * If the manager was timed wait, we may need to signal the
-	 * manager to force a wakeup.
+	 * If the shard was timed wait, we may need to signal the
+	 * shard to force a wakeup.
 	 */
-	timedwait = ISC_TF(manager->nscheduled > 0 &&
-			   isc_time_seconds(&manager->due) != 0);
+	timedwait = ISC_TF(shard->nscheduled > 0 &&
+			   isc_time_seconds(&shard->due) != 0);
 #endif
 
 	/*
@@ -230,41 +500,33 @@ schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 	 * Schedule the timer.
 	 */
 
-	if (timer->index > 0) {
+	if (timer->slot != NULL) {
 		/*
 		 * Already scheduled.
 		 */
-		cmp = isc_time_compare(&due, &timer->due);
-		timer->due = due;
-		switch (cmp) {
-		case -1:
-			isc_heap_increased(manager->heap, timer->index);
-			break;
-		case 1:
-			isc_heap_decreased(manager->heap, timer->index);
-			break;
-		case 0:
-			/* Nothing to do. */
-			break;
-		}
+		wheel_unlink(shard, timer);
 	} else {
-		timer->due = due;
-		result = isc_heap_insert(manager->heap, timer);
-		if (result != ISC_R_SUCCESS) {
-			INSIST(result == ISC_R_NOMEMORY);
-			return (ISC_R_NOMEMORY);
-		}
-		manager->nscheduled++;
+		/*
+		 * An empty wheel can be restarted from the present,
+		 * however long it has been idle.
+		 */
+		if (shard->nscheduled == 0)
+			shard->current = time2tick(now, ISC_FALSE);
+		shard->nscheduled++;
 	}
+	timer->due = due;
+	timer->tick = time2tick(&due, ISC_TRUE);
+	wheel_link(shard, timer);
+	tick2time(timer->tick, &when);
 
 	XTRACETIMER(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
 				   ISC_MSG_SCHEDULE, "schedule"), timer, due);
 
 	/*
-	 * If this timer is at the head of the queue, we need to ensure
-	 * that we won't miss it if it has a more recent due time than
-	 * the current "next" timer.  We do this either by waking up the
-	 * run thread, or explicitly setting the value in the manager.
+	 * If this timer is due before anything else in the shard, we
+	 * need to ensure that we won't miss it.  We do this either by
+	 * waking up the run thread, or explicitly setting the value in
+	 * the shard.
 	 */
 #ifdef USE_TIMER_THREAD
 
@@ -281,11 +543,11 @@ schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 		isc_time_t then;
 
 		isc_interval_set(&fifteen, 15, 0);
-		result = isc_time_add(&manager->due, &fifteen, &then);
+		result = isc_time_add(&shard->due, &fifteen, &then);
 
 		if (result == ISC_R_SUCCESS &&
 		    isc_time_compare(&then, now) < 0) {
-			SIGNAL(&manager->wakeup);
+			SIGNAL(&shard->wakeup);
 			signal_ok = ISC_FALSE;
 			isc_log_write(isc_lctx, ISC_LOGCATEGORY_GENERAL,
 				      ISC_LOGMODULE_TIMER, ISC_LOG_WARNING,
@@ -293,16 +555,24 @@ schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 		}
 	}
 
-	if (timer->index == 1 && signal_ok) {
+	/*
+	 * 'due' is epoch while the run thread waits without a timeout.
+	 * It is moved up here so that a burst of timers scheduled
+	 * before the thread wakes up only signals it once.
+	 */
+	if (signal_ok && (isc_time_isepoch(&shard->due) ||
+			  isc_time_compare(&when, &shard->due) < 0))
+	{
 		XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
 				      ISC_MSG_SIGNALSCHED,
 				      "signal (schedule)"));
-		SIGNAL(&manager->wakeup);
+		shard->due = when;
+		SIGNAL(&shard->wakeup);
 	}
 #else /* USE_TIMER_THREAD */
-	if (timer->index == 1 &&
-	    isc_time_compare(&timer->due, &manager->due) < 0)
-		manager->due = timer->due;
+	if (shard->nscheduled == 1 ||
+	    isc_time_compare(&when, &shard->due) < 0)
+		shard->due = when;
 #endif /* USE_TIMER_THREAD */
 
 	return (ISC_R_SUCCESS);
@@ -310,45 +580,34 @@ schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 
 static inline void
 deschedule(isc__timer_t *timer) {
-#ifdef USE_TIMER_THREAD
-	isc_boolean_t need_wakeup = ISC_FALSE;
-#endif
-	isc__timermgr_t *manager;
+	timershard_t *shard;
 
 	/*
 	 * The caller must ensure locking.
+	 *
+	 * There is no need to wake up the run thread: if this timer was
+	 * the next one due, the thread will wake up for nothing and work
+	 * out when to sleep until next.
 	 */
 
-	manager = timer->manager;
-	if (timer->index > 0) {
-#ifdef USE_TIMER_THREAD
-		if (timer->index == 1)
-			need_wakeup = ISC_TRUE;
-#endif
-		isc_heap_delete(manager->heap, timer->index);
-		timer->index = 0;
-		INSIST(manager->nscheduled > 0);
-		manager->nscheduled--;
-#ifdef USE_TIMER_THREAD
-		if (need_wakeup) {
-			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
-					      ISC_MSG_SIGNALDESCHED,
-					      "signal (deschedule)"));
-			SIGNAL(&manager->wakeup);
-		}
-#endif /* USE_TIMER_THREAD */
+	shard = timer->shard;
+	if (timer->slot != NULL) {
+		wheel_unlink(shard, timer);
+		INSIST(shard->nscheduled > 0);
+		shard->nscheduled--;
 	}
 }
 
 static void
 destroy(isc__timer_t *timer) {
 	isc__timermgr_t *manager = timer->manager;
+	timershard_t *shard = timer->shard;
 
 	/*
 	 * The caller must ensure it is safe to destroy the timer.
 	 */
 
-	LOCK(&manager->lock);
+	LOCK(&shard->lock);
 
 	(void)isc_task_purgerange(timer->task,
 				  timer,
@@ -356,9 +615,9 @@ destroy(isc__timer_t *timer) {
 				  ISC_TIMEREVENT_LASTEVENT,
 				  NULL);
 	deschedule(timer);
-	UNLINK(manager->timers, timer, link);
+	UNLINK(shard->timers, timer, link);
 
-	UNLOCK(&manager->lock);
+	UNLOCK(&shard->lock);
 
 	isc_task_detach(&timer->task);
 	DESTROYLOCK(&timer->lock);
@@ -367,6 +626,19 @@ destroy(isc__timer_t *timer) {
 	isc_mem_put(manager->mctx, timer, sizeof(*timer));
 }
 
+static inline timershard_t *
+getshard(isc__timermgr_t *manager) {
+#if TIMER_MAXSHARDS > 1
+	isc_uint32_t n;
+
+	if (manager->nshards > 1) {
+		n = (isc_uint32_t)isc_atomic_xadd(&manager->next, 1);
+		return (&manager->shards[n & (manager->nshards - 1)]);
+	}
+#endif
+	return (&manager->shards[0]);
+}
+
 isc_result_t
 isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 		  const isc_time_t *expires, const isc_interval_t *interval,
@@ -375,6 +647,7 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 {
 	isc__timermgr_t *manager = (isc__timermgr_t *)manager0;
 	isc__timer_t *timer;
+	timershard_t *shard;
 	isc_result_t result;
 	isc_time_t now;
 
@@ -419,6 +692,7 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 		return (ISC_R_NOMEMORY);
 
 	timer->manager = manager;
+	timer->shard = shard = getshard(manager);
 	timer->references = 1;
 
 	if (type == isc_timertype_once && !isc_interval_iszero(interval)) {
@@ -447,19 +721,22 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 	 * keep track of whether arg started as a true const.
 	 */
 	DE_CONST(arg, timer->arg);
-	timer->index = 0;
+	timer->tick = 0;
+	timer->level = 0;
+	timer->slot = NULL;
 	result = isc_mutex_init(&timer->lock);
 	if (result != ISC_R_SUCCESS) {
 		isc_task_detach(&timer->task);
 		isc_mem_put(manager->mctx, timer, sizeof(*timer));
 		return (result);
 	}
+	ISC_LINK_INIT(timer, wlink);
 	ISC_LINK_INIT(timer, link);
 	timer->common.impmagic = TIMER_MAGIC;
 	timer->common.magic = ISCAPI_TIMER_MAGIC;
 	timer->common.methods = (isc_timermethods_t *)&timermethods;
 
-	LOCK(&manager->lock);
+	LOCK(&shard->lock);
 
 	/*
 	 * Note we don't have to lock the timer like we normally would because
@@ -471,9 +748,9 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 	else
 		result = ISC_R_SUCCESS;
 	if (result == ISC_R_SUCCESS)
-		APPEND(manager->timers, timer, link);
+		APPEND(shard->timers, timer, link);
 
-	UNLOCK(&manager->lock);
+	UNLOCK(&shard->lock);
 
 	if (result != ISC_R_SUCCESS) {
 		timer->common.impmagic = 0;
@@ -497,6 +774,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 	isc__timer_t *timer = (isc__timer_t *)timer0;
 	isc_time_t now;
 	isc__timermgr_t *manager;
+	timershard_t *shard;
 	isc_result_t result;
 
 	/*
@@ -508,6 +786,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 	REQUIRE(VALID_TIMER(timer));
 	manager = timer->manager;
 	REQUIRE(VALID_MANAGER(manager));
+	shard = timer->shard;
 
 	if (expires == NULL)
 		expires = isc_time_epoch;
@@ -532,7 +811,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 		isc_time_settoepoch(&now);
 	}
 
-	LOCK(&manager->lock);
+	LOCK(&shard->lock);
 	LOCK(&timer->lock);
 
 	if (purge)
@@ -560,7 +839,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 	}
 
 	UNLOCK(&timer->lock);
-	UNLOCK(&manager->lock);
+	UNLOCK(&shard->lock);
 
 	return (result);
 }
@@ -598,7 +877,7 @@ isc__timer_touch(isc_timer_t *timer0) {
 	 *
 	 *	REQUIRE(timer->type == isc_timertype_once);
 	 *
-	 * but we cannot without locking the manager lock too, which we
+	 * but we cannot without locking the shard lock too, which we
 	 * don't want to do.
 	 */
 
@@ -655,122 +934,127 @@ isc__timer_detach(isc_timer_t **timerp) {
 }
 
 static void
-dispatch(isc__timermgr_t *manager, isc_time_t *now) {
-	isc_boolean_t done = ISC_FALSE, post_event, need_schedule;
+dispatch(timershard_t *shard, isc_time_t *now) {
+	isc__timermgr_t *manager = shard->manager;
+	isc_boolean_t post_event, need_schedule;
 	isc_timerevent_t *event;
 	isc_eventtype_t type = 0;
 	isc__timer_t *timer;
 	isc_result_t result;
 	isc_boolean_t idle;
+	timerlist_t expired;
+	isc_uint64_t tick;
 
 	/*!
-	 * The caller must be holding the manager lock.
+	 * The caller must be holding the shard lock.
 	 */
 
-	while (manager->nscheduled > 0 && !done) {
-		timer = isc_heap_element(manager->heap, 1);
-		INSIST(timer != NULL && timer->type != isc_timertype_inactive);
-		if (isc_time_compare(now, &timer->due) >= 0) {
-			if (timer->type == isc_timertype_ticker) {
-				type = ISC_TIMEREVENT_TICK;
-				post_event = ISC_TRUE;
-				need_schedule = ISC_TRUE;
-			} else if (timer->type == isc_timertype_limited) {
-				int cmp;
-				cmp = isc_time_compare(now, &timer->expires);
-				if (cmp >= 0) {
-					type = ISC_TIMEREVENT_LIFE;
-					post_event = ISC_TRUE;
-					need_schedule = ISC_FALSE;
-				} else {
-					type = ISC_TIMEREVENT_TICK;
-					post_event = ISC_TRUE;
-					need_schedule = ISC_TRUE;
-				}
-			} else if (!isc_time_isepoch(&timer->expires) &&
-				   isc_time_compare(now,
-						    &timer->expires) >= 0) {
+	tick = time2tick(now, ISC_FALSE);
+	if (shard->nscheduled > 0 && tick + 1 < shard->current)
+		wheel_rebase(shard, tick);
+
+	INIT_LIST(expired);
+	wheel_advance(shard, tick, &expired);
+
+	while ((timer = HEAD(expired)) != NULL) {
+		UNLINK(expired, timer, wlink);
+		INSIST(timer->type != isc_timertype_inactive);
+
+		if (timer->type == isc_timertype_ticker) {
+			type = ISC_TIMEREVENT_TICK;
+			post_event = ISC_TRUE;
+			need_schedule = ISC_TRUE;
+		} else if (timer->type == isc_timertype_limited) {
+			int cmp;
+			cmp = isc_time_compare(now, &timer->expires);
+			if (cmp >= 0) {
 				type = ISC_TIMEREVENT_LIFE;
 				post_event = ISC_TRUE;
 				need_schedule = ISC_FALSE;
 			} else {
-				idle = ISC_FALSE;
-
-				LOCK(&timer->lock);
-				if (!isc_time_isepoch(&timer->idle) &&
-				    isc_time_compare(now,
-						     &timer->idle) >= 0) {
-					idle = ISC_TRUE;
-				}
-				UNLOCK(&timer->lock);
-				if (idle) {
-					type = ISC_TIMEREVENT_IDLE;
-					post_event = ISC_TRUE;
-					need_schedule = ISC_FALSE;
-				} else {
-					/*
-					 * Idle timer has been touched;
-					 * reschedule.
-					 */
-					XTRACEID(isc_msgcat_get(isc_msgcat,
-								ISC_MSGSET_TIMER,
-								ISC_MSG_IDLERESCHED,
-								"idle reschedule"),
-						 timer);
-					post_event = ISC_FALSE;
-					need_schedule = ISC_TRUE;
-				}
+				type = ISC_TIMEREVENT_TICK;
+				post_event = ISC_TRUE;
+				need_schedule = ISC_TRUE;
 			}
+		} else if (!isc_time_isepoch(&timer->expires) &&
+			   isc_time_compare(now,
+					    &timer->expires) >= 0) {
+			type = ISC_TIMEREVENT_LIFE;
+			post_event = ISC_TRUE;
+			need_schedule = ISC_FALSE;
+		} else {
+			idle = ISC_FALSE;
 
-			if (post_event) {
-				XTRACEID(isc_msgcat_get(isc_msgcat,
-							ISC_MSGSET_TIMER,
-							ISC_MSG_POSTING,
-							"posting"), timer);
+			LOCK(&timer->lock);
+			if (!isc_time_isepoch(&timer->idle) &&
+			    isc_time_compare(now,
+					     &timer->idle) >= 0) {
+				idle = ISC_TRUE;
+			}
+			UNLOCK(&timer->lock);
+			if (idle) {
+				type = ISC_TIMEREVENT_IDLE;
+				post_event = ISC_TRUE;
+				need_schedule = ISC_FALSE;
+			} else {
 				/*
-				 * XXX We could preallocate this event.
+				 * Idle timer has been touched;
+				 * reschedule.
 				 */
-				event = (isc_timerevent_t *)isc_event_allocate(manager->mctx,
-							   timer,
-							   type,
-							   timer->action,
-							   timer->arg,
-							   sizeof(*event));
-
-				if (event != NULL) {
-					event->due = timer->due;
-					isc_task_send(timer->task,
-						      ISC_EVENT_PTR(&event));
-				} else
-					UNEXPECTED_ERROR(__FILE__, __LINE__, "%s",
-						 isc_msgcat_get(isc_msgcat,
-							 ISC_MSGSET_TIMER,
-							 ISC_MSG_EVENTNOTALLOC,
-							 "couldn't "
-							 "allocate event"));
+				XTRACEID(isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_TIMER,
+							ISC_MSG_IDLERESCHED,
+							"idle reschedule"),
+					 timer);
+				post_event = ISC_FALSE;
+				need_schedule = ISC_TRUE;
 			}
+		}
 
-			timer->index = 0;
-			isc_heap_delete(manager->heap, 1);
-			manager->nscheduled--;
+		if (post_event) {
+			XTRACEID(isc_msgcat_get(isc_msgcat,
+						ISC_MSGSET_TIMER,
+						ISC_MSG_POSTING,
+						"posting"), timer);
+			/*
+			 * XXX We could preallocate this event.
+			 */
+			event = (isc_timerevent_t *)isc_event_allocate(manager->mctx,
+						   timer,
+						   type,
+						   timer->action,
+						   timer->arg,
+						   sizeof(*event));
+
+			if (event != NULL) {
+				event->due = timer->due;
+				isc_task_send(timer->task,
+					      ISC_EVENT_PTR(&event));
+			} else
+				UNEXPECTED_ERROR(__FILE__, __LINE__, "%s",
+					 isc_msgcat_get(isc_msgcat,
+						 ISC_MSGSET_TIMER,
+						 ISC_MSG_EVENTNOTALLOC,
+						 "couldn't "
+						 "allocate event"));
+		}
 
-			if (need_schedule) {
-				result = schedule(timer, now, ISC_FALSE);
-				if (result != ISC_R_SUCCESS)
-					UNEXPECTED_ERROR(__FILE__, __LINE__,
-							 "%s: %u",
+		if (need_schedule) {
+			result = schedule(timer, now, ISC_FALSE);
+			if (result != ISC_R_SUCCESS)
+				UNEXPECTED_ERROR(__FILE__, __LINE__,
+						 "%s: %u",
 						isc_msgcat_get(isc_msgcat,
 							ISC_MSGSET_TIMER,
 							ISC_MSG_SCHEDFAIL,
 							"couldn't schedule "
 							"timer"),
-							 result);
-			}
-		} else {
-			manager->due = timer->due;
-			done = ISC_TRUE;
+						 result);
 		}
 	}
+
+	if (shard->nscheduled > 0)
+		wheel_nextdue(shard, &shard->due);
 }
 
 #ifdef USE_TIMER_THREAD
@@ -779,38 +1063,40 @@ static isc_threadresult_t
 WINAPI
 #endif
 run(void *uap) {
-	isc__timermgr_t *manager = uap;
+	timershard_t *shard = uap;
 	isc_time_t now;
 	isc_result_t result;
 
-	LOCK(&manager->lock);
-	while (!manager->done) {
+	LOCK(&shard->lock);
+	while (!shard->done) {
 		TIME_NOW(&now);
 
 		XTRACETIME(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 					  ISC_MSG_RUNNING,
 					  "running"), now);
 
-		dispatch(manager, &now);
+		dispatch(shard, &now);
 
-		if (manager->nscheduled > 0) {
+		if (shard->nscheduled > 0) {
 			XTRACETIME2(isc_msgcat_get(isc_msgcat,
 						   ISC_MSGSET_GENERAL,
 						   ISC_MSG_WAITUNTIL,
 						   "waituntil"),
-				    manager->due, now);
-			result = WAITUNTIL(&manager->wakeup, &manager->lock, &manager->due);
+				    shard->due, now);
+			result = WAITUNTIL(&shard->wakeup, &shard->lock,
+					   &shard->due);
 			INSIST(result == ISC_R_SUCCESS ||
 			       result == ISC_R_TIMEDOUT);
 		} else {
 			XTRACETIME(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						  ISC_MSG_WAIT, "wait"), now);
-			WAIT(&manager->wakeup, &manager->lock);
+			isc_time_settoepoch(&shard->due);
+			WAIT(&shard->wakeup, &shard->lock);
 		}
 		XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
 				      ISC_MSG_WAKEUP, "wakeup"));
 	}
-	UNLOCK(&manager->lock);
+	UNLOCK(&shard->lock);
 
 #ifdef OPENSSL_LEAKS
 	ERR_remove_state(0);
@@ -820,34 +1106,101 @@ run(void *uap) {
 }
 #endif /* USE_TIMER_THREAD */
 
-static isc_boolean_t
-sooner(void *v1, void *v2) {
-	isc__timer_t *t1, *t2;
+static isc_result_t
+shard_init(isc__timermgr_t *manager, timershard_t *shard) {
+	isc_result_t result;
+	unsigned int level, i;
+
+	shard->manager = manager;
+	shard->done = ISC_FALSE;
+	INIT_LIST(shard->timers);
+	shard->nscheduled = 0;
+	isc_time_settoepoch(&shard->due);
+	shard->current = 0;
+	for (level = 0; level < TIMER_LEVELS; level++) {
+		shard->nlevel[level] = 0;
+		for (i = 0; i < TIMER_SLOTS; i++)
+			INIT_LIST(shard->wheel[level][i]);
+	}
+	shard->nlevel[TIMER_OVERFLOW] = 0;
+	INIT_LIST(shard->overflow);
 
-	t1 = v1;
-	t2 = v2;
-	REQUIRE(VALID_TIMER(t1));
-	REQUIRE(VALID_TIMER(t2));
+	result = isc_mutex_init(&shard->lock);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+#ifdef USE_TIMER_THREAD
+	if (isc_condition_init(&shard->wakeup) != ISC_R_SUCCESS) {
+		DESTROYLOCK(&shard->lock);
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_condition_init() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+		return (ISC_R_UNEXPECTED);
+	}
+	if (isc_thread_create(run, shard, &shard->thread) != ISC_R_SUCCESS) {
+		(void)isc_condition_destroy(&shard->wakeup);
+		DESTROYLOCK(&shard->lock);
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_thread_create() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+		return (ISC_R_UNEXPECTED);
+	}
+	isc_thread_setname(shard->thread, "isc-timer");
+#endif
 
-	if (isc_time_compare(&t1->due, &t2->due) < 0)
-		return (ISC_TRUE);
-	return (ISC_FALSE);
+	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Stop the run threads of the first 'nshards' shards and release them.
+ */
 static void
-set_index(void *what, unsigned int index) {
-	isc__timer_t *timer;
-
-	timer = what;
-	REQUIRE(VALID_TIMER(timer));
+shards_destroy(isc__timermgr_t *manager, unsigned int nshards) {
+	timershard_t *shard;
+	unsigned int i;
+
+	for (i = 0; i < nshards; i++) {
+		shard = &manager->shards[i];
+		LOCK(&shard->lock);
+		REQUIRE(EMPTY(shard->timers));
+		shard->done = ISC_TRUE;
+#ifdef USE_TIMER_THREAD
+		XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
+				      ISC_MSG_SIGNALDESTROY,
+				      "signal (destroy)"));
+		SIGNAL(&shard->wakeup);
+#endif /* USE_TIMER_THREAD */
+		UNLOCK(&shard->lock);
+	}
 
-	timer->index = index;
+	for (i = 0; i < nshards; i++) {
+		shard = &manager->shards[i];
+#ifdef USE_TIMER_THREAD
+		/*
+		 * Wait for thread to exit.
+		 */
+		if (isc_thread_join(shard->thread, NULL) != ISC_R_SUCCESS)
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_join() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+		(void)isc_condition_destroy(&shard->wakeup);
+#endif /* USE_TIMER_THREAD */
+		DESTROYLOCK(&shard->lock);
+	}
 }
 
 isc_result_t
 isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	isc__timermgr_t *manager;
 	isc_result_t result;
+	unsigned int i;
+#if TIMER_MAXSHARDS > 1
+	unsigned int ncpus;
+#endif
 
 	/*
 	 * Create a timer manager.
@@ -871,51 +1224,35 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	manager->common.magic = ISCAPI_TIMERMGR_MAGIC;
 	manager->common.methods = (isc_timermgrmethods_t *)&timermgrmethods;
 	manager->mctx = NULL;
-	manager->done = ISC_FALSE;
-	INIT_LIST(manager->timers);
-	manager->nscheduled = 0;
-	isc_time_settoepoch(&manager->due);
-	manager->heap = NULL;
-	result = isc_heap_create(mctx, sooner, set_index, 0, &manager->heap);
-	if (result != ISC_R_SUCCESS) {
-		INSIST(result == ISC_R_NOMEMORY);
+
+	/*
+	 * One shard per CPU, rounded up to a power of two.
+	 */
+	manager->nshards = 1;
+#if TIMER_MAXSHARDS > 1
+	manager->next = 0;
+	ncpus = isc_os_ncpus();
+	while (manager->nshards < ncpus &&
+	       manager->nshards < TIMER_MAXSHARDS)
+		manager->nshards <<= 1;
+#endif
+	manager->shards = isc_mem_get(mctx, manager->nshards *
+					    sizeof(timershard_t));
+	if (manager->shards == NULL) {
 		isc_mem_put(mctx, manager, sizeof(*manager));
 		return (ISC_R_NOMEMORY);
 	}
-	result = isc_mutex_init(&manager->lock);
-	if (result != ISC_R_SUCCESS) {
-		isc_heap_destroy(&manager->heap);
-		isc_mem_put(mctx, manager, sizeof(*manager));
-		return (result);
+	for (i = 0; i < manager->nshards; i++) {
+		result = shard_init(manager, &manager->shards[i]);
+		if (result != ISC_R_SUCCESS) {
+			shards_destroy(manager, i);
+			isc_mem_put(mctx, manager->shards,
+				    manager->nshards * sizeof(timershard_t));
+			isc_mem_put(mctx, manager, sizeof(*manager));
+			return (result);
+		}
 	}
 	isc_mem_attach(mctx, &manager->mctx);
-#ifdef USE_TIMER_THREAD
-	if (isc_condition_init(&manager->wakeup) != ISC_R_SUCCESS) {
-		isc_mem_detach(&manager->mctx);
-		DESTROYLOCK(&manager->lock);
-		isc_heap_destroy(&manager->heap);
-		isc_mem_put(mctx, manager, sizeof(*manager));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		return (ISC_R_UNEXPECTED);
-	}
-	if (isc_thread_create(run, manager, &manager->thread) !=
-	    ISC_R_SUCCESS) {
-		isc_mem_detach(&manager->mctx);
-		(void)isc_condition_destroy(&manager->wakeup);
-		DESTROYLOCK(&manager->lock);
-		isc_heap_destroy(&manager->heap);
-		isc_mem_put(mctx, manager, sizeof(*manager));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_create() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		return (ISC_R_UNEXPECTED);
-	}
-	isc_thread_setname(manager->thread, "isc-timer");
-#endif
 #ifdef USE_SHARED_MANAGER
 	manager->refs = 1;
 	timermgr = manager;
@@ -930,10 +1267,12 @@ void
 isc_timermgr_poke(isc_timermgr_t *manager0) {
 #ifdef USE_TIMER_THREAD
 	isc__timermgr_t *manager = (isc__timermgr_t *)manager0;
+	unsigned int i;
 
 	REQUIRE(VALID_MANAGER(manager));
 
-	SIGNAL(&manager->wakeup);
+	for (i = 0; i < manager->nshards; i++)
+		SIGNAL(&manager->shards[i].wakeup);
 #else
 	UNUSED(manager0);
 #endif
@@ -952,55 +1291,31 @@ isc__timermgr_destroy(isc_timermgr_t **managerp) {
 	manager = (isc__timermgr_t *)*managerp;
 	REQUIRE(VALID_MANAGER(manager));
 
-	LOCK(&manager->lock);
-
 #ifdef USE_SHARED_MANAGER
+	LOCK(&manager->shards[0].lock);
 	manager->refs--;
 	if (manager->refs > 0) {
-		UNLOCK(&manager->lock);
+		UNLOCK(&manager->shards[0].lock);
 		*managerp = NULL;
 		return;
 	}
 	timermgr = NULL;
+	UNLOCK(&manager->shards[0].lock);
 #endif /* USE_SHARED_MANAGER */
 
 #ifndef USE_TIMER_THREAD
 	isc__timermgr_dispatch((isc_timermgr_t *)manager);
 #endif
 
-	REQUIRE(EMPTY(manager->timers));
-	manager->done = ISC_TRUE;
-
-#ifdef USE_TIMER_THREAD
-	XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
-			      ISC_MSG_SIGNALDESTROY, "signal (destroy)"));
-	SIGNAL(&manager->wakeup);
-#endif /* USE_TIMER_THREAD */
-
-	UNLOCK(&manager->lock);
-
-#ifdef USE_TIMER_THREAD
-	/*
-	 * Wait for thread to exit.
-	 */
-	if (isc_thread_join(manager->thread, NULL) != ISC_R_SUCCESS)
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_join() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-#endif /* USE_TIMER_THREAD */
-
 	/*
 	 * Clean up.
 	 */
-#ifdef USE_TIMER_THREAD
-	(void)isc_condition_destroy(&manager->wakeup);
-#endif /* USE_TIMER_THREAD */
-	DESTROYLOCK(&manager->lock);
-	isc_heap_destroy(&manager->heap);
+	shards_destroy(manager, manager->nshards);
+	mctx = manager->mctx;
+	isc_mem_put(mctx, manager->shards,
+		    manager->nshards * sizeof(timershard_t));
 	manager->common.impmagic = 0;
 	manager->common.magic = 0;
-	mctx = manager->mctx;
 	isc_mem_put(mctx, manager, sizeof(*manager));
 	isc_mem_detach(&mctx);
 
@@ -1020,9 +1335,9 @@ isc__timermgr_nextevent(isc_timermgr_t *manager0, isc_time_t *when) {
 	if (manager == NULL)
 		manager = timermgr;
 #endif
-	if (manager == NULL || manager->nscheduled == 0)
+	if (manager == NULL || manager->shards[0].nscheduled == 0)
 		return (ISC_R_NOTFOUND);
-	*when = manager->due;
+	*when = manager->shards[0].due;
 	return (ISC_R_SUCCESS);
 }
 
@@ -1038,7 +1353,7 @@ isc__timermgr_dispatch(isc_timermgr_t *manager0) {
 	if (manager == NULL)
 		return;
 	TIME_NOW(&now);
-	dispatch(manager, &now);
+	dispatch(&manager->shards[0], &now);
 }
 #endif /* USE_TIMER_THREAD */
 
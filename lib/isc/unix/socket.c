@@ -318,8 +318,23 @@ typedef isc_event_t intev_t;
  */
 #define NRETRIES 10
 
+/*%
+ * Linux can move several UDP datagrams with one recvmmsg() or sendmmsg()
+ * call.  When more than one request is queued on an unconnected UDP
+ * socket, up to MAXBATCH_UDP of them are satisfied by a single call.
+ * BATCHCMSGBUFLEN bounds the per-datagram control buffer; sockets that
+ * need more than that fall back to one datagram per call.
+ */
+#if defined(__linux__) && defined(MSG_WAITFORONE) && \
+    defined(ISC_NET_BSD44MSGHDR)
+#define USE_MMSG	1
+#define MAXBATCH_UDP	32
+#define BATCHCMSGBUFLEN	256
+#endif
+
 typedef struct isc__socket isc__socket_t;
 typedef struct isc__socketmgr isc__socketmgr_t;
+typedef struct isc__socketthread isc__socketthread_t;
 
 #define NEWCONNSOCK(ev) ((isc__socket_t *)(ev)->newsocket)
 
@@ -384,13 +399,15 @@ struct isc__socket {
 #define SOCKET_MANAGER_MAGIC	ISC_MAGIC('I', 'O', 'm', 'g')
 #define VALID_MANAGER(m)	ISC_MAGIC_VALID(m, SOCKET_MANAGER_MAGIC)
 
-struct isc__socketmgr {
-	/* Not locked. */
-	isc_socketmgr_t		common;
-	isc_mem_t	       *mctx;
-	isc_mutex_t		lock;
-	isc_mutex_t		*fdlock;
-	isc_stats_t		*stats;
+/*%
+ * Each watcher thread owns its own event multiplexer and control pipe.
+ * A descriptor is always watched by the same thread (see FDTHREAD()), so
+ * all the watch/unwatch/close processing for it is serialized in that
+ * thread just as it was with a single watcher.
+ */
+struct isc__socketthread {
+	isc__socketmgr_t	*manager;
+	int			threadid;
 #ifdef USE_KQUEUE
 	int			kqueue_fd;
 	int			nevents;
@@ -408,13 +425,27 @@ struct isc__socketmgr {
 	int			nevents;
 	struct pollfd		*events;
 #endif	/* USE_DEVPOLL */
+#ifdef USE_WATCHER_THREAD
+	int			pipe_fds[2];
+	isc_thread_t		thread;
+#endif	/* USE_WATCHER_THREAD */
+};
+
+#define FDTHREAD(m, fd)		(&(m)->threads[(fd) % (m)->nthreads])
+
+struct isc__socketmgr {
+	/* Not locked. */
+	isc_socketmgr_t		common;
+	isc_mem_t	       *mctx;
+	isc_mutex_t		lock;
+	isc_mutex_t		*fdlock;
+	isc_stats_t		*stats;
+	int			nthreads;
+	isc__socketthread_t	*threads;
 #ifdef USE_SELECT
 	int			fd_bufsize;
 #endif	/* USE_SELECT */
 	unsigned int		maxsocks;
-#ifdef ISC_PLATFORM_USETHREADS
-	int			pipe_fds[2];
-#endif
 
 	/* Locked by fdlock. */
 	isc__socket_t	       **fds;
@@ -437,7 +468,6 @@ struct isc__socketmgr {
 #endif	/* USE_SELECT */
 	int			reserved;	/* unlocked */
 #ifdef USE_WATCHER_THREAD
-	isc_thread_t		watcher;
 	isc_condition_t		shutdown_ok;
 #else /* USE_WATCHER_THREAD */
 	unsigned int		refs;
@@ -486,7 +516,7 @@ static void build_msghdr_send(isc__socket_t *, isc_socketevent_t *,
 static void build_msghdr_recv(isc__socket_t *, isc_socketevent_t *,
 			      struct msghdr *, struct iovec *, size_t *);
 #ifdef USE_WATCHER_THREAD
-static isc_boolean_t process_ctlfd(isc__socketmgr_t *manager);
+static isc_boolean_t process_ctlfd(isc__socketthread_t *thread);
 #endif
 static void setdscp(isc__socket_t *sock, isc_dscp_t dscp);
 
@@ -596,7 +626,7 @@ isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks);
+		       unsigned int maxsocks, int nthreads);
 isc_result_t
 isc_socketmgr_getmaxsockets(isc_socketmgr_t *manager0, unsigned int *nsockp);
 void
@@ -894,12 +924,15 @@ dec_stats(isc_stats_t *stats, isc_statscounter_t counterid) {
 }
 
 static inline isc_result_t
-watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+watch_fd(isc__socketthread_t *thread, int fd, int msg) {
+	isc__socketmgr_t *manager = thread->manager;
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
 	struct kevent evchange;
 
+	UNUSED(manager);
+
 	memset(&evchange, 0, sizeof(evchange));
 	if (msg == SELECT_POKE_READ)
 		evchange.filter = EVFILT_READ;
@@ -907,7 +940,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_ADD;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
@@ -928,7 +961,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	event.data.fd = fd;
 
 	op = (oldevents == 0U) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
-	ret = epoll_ctl(manager->epoll_fd, op, fd, &event);
+	ret = epoll_ctl(thread->epoll_fd, op, fd, &event);
 	if (ret == -1) {
 		if (errno == EEXIST)
 			UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -950,7 +983,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	pfd.fd = fd;
 	pfd.revents = 0;
 	LOCK(&manager->fdlock[lockid]);
-	if (write(manager->devpoll_fd, &pfd, sizeof(pfd)) == -1)
+	if (write(thread->devpoll_fd, &pfd, sizeof(pfd)) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
@@ -974,12 +1007,15 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 }
 
 static inline isc_result_t
-unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+unwatch_fd(isc__socketthread_t *thread, int fd, int msg) {
+	isc__socketmgr_t *manager = thread->manager;
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
 	struct kevent evchange;
 
+	UNUSED(manager);
+
 	memset(&evchange, 0, sizeof(evchange));
 	if (msg == SELECT_POKE_READ)
 		evchange.filter = EVFILT_READ;
@@ -987,7 +1023,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_DELETE;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
@@ -1006,7 +1042,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	event.data.fd = fd;
 
 	op = (event.events == 0U) ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
-	ret = epoll_ctl(manager->epoll_fd, op, fd, &event);
+	ret = epoll_ctl(thread->epoll_fd, op, fd, &event);
 	if (ret == -1 && errno != ENOENT) {
 		char strbuf[ISC_STRERRORSIZE];
 		isc__strerror(errno, strbuf, sizeof(strbuf));
@@ -1043,7 +1079,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		writelen += sizeof(pfds[1]);
 	}
 
-	if (write(manager->devpoll_fd, pfds, writelen) == -1)
+	if (write(thread->devpoll_fd, pfds, writelen) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
@@ -1067,7 +1103,8 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 }
 
 static void
-wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
+wakeup_socket(isc__socketthread_t *thread, int fd, int msg) {
+	isc__socketmgr_t *manager = thread->manager;
 	isc_result_t result;
 	int lockid = FDLOCK_ID(fd);
 
@@ -1083,8 +1120,8 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 		/* No one should be updating fdstate, so no need to lock it */
 		INSIST(manager->fdstate[fd] == CLOSE_PENDING);
 		manager->fdstate[fd] = CLOSED;
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		(void)close(fd);
 		return;
 	}
@@ -1101,8 +1138,8 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 		 * fdlock; otherwise it could cause deadlock due to a lock order
 		 * reversal.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
 	if (manager->fdstate[fd] != MANAGED) {
@@ -1114,7 +1151,7 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 	/*
 	 * Set requested bit.
 	 */
-	result = watch_fd(manager, fd, msg);
+	result = watch_fd(thread, fd, msg);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * XXXJT: what should we do?  Ignoring the failure of watching
@@ -1135,7 +1172,7 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
  * will not get partial writes.
  */
 static void
-select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+thread_poke(isc__socketthread_t *thread, int fd, int msg) {
 	int cc;
 	int buf[2];
 	char strbuf[ISC_STRERRORSIZE];
@@ -1144,7 +1181,7 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
 	buf[1] = msg;
 
 	do {
-		cc = write(mgr->pipe_fds[1], buf, sizeof(buf));
+		cc = write(thread->pipe_fds[1], buf, sizeof(buf));
 #ifdef ENOSR
 		/*
 		 * Treat ENOSR as EAGAIN but loop slowly as it is
@@ -1170,16 +1207,24 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
 	INSIST(cc == sizeof(buf));
 }
 
+/*
+ * Poke the watcher thread that is responsible for 'fd'.
+ */
+static void
+select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+	thread_poke(FDTHREAD(mgr, fd), fd, msg);
+}
+
 /*
  * Read a message on the internal fd.
  */
 static void
-select_readmsg(isc__socketmgr_t *mgr, int *fd, int *msg) {
+select_readmsg(isc__socketthread_t *thread, int *fd, int *msg) {
 	int buf[2];
 	int cc;
 	char strbuf[ISC_STRERRORSIZE];
 
-	cc = read(mgr->pipe_fds[0], buf, sizeof(buf));
+	cc = read(thread->pipe_fds[0], buf, sizeof(buf));
 	if (cc < 0) {
 		*msg = SELECT_POKE_NOTHING;
 		*fd = -1;	/* Silence compiler. */
@@ -1208,7 +1253,7 @@ select_poke(isc__socketmgr_t *manager, int fd, int msg) {
 	if (msg == SELECT_POKE_SHUTDOWN)
 		return;
 	else if (fd >= 0)
-		wakeup_socket(manager, fd, msg);
+		wakeup_socket(FDTHREAD(manager, fd), fd, msg);
 	return;
 }
 #endif /* USE_WATCHER_THREAD */
@@ -1849,43 +1894,12 @@ dump_msg(struct msghdr *msg) {
 #define DOIO_HARD		2	/* i/o error, event sent */
 #define DOIO_EOF		3	/* EOF, no event sent */
 
+/*
+ * Map a recvmsg() or recvmmsg() failure other than a soft error onto
+ * a DOIO_* code, setting dev->result when the error is hard.
+ */
 static int
-doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
-	int cc;
-	struct iovec iov[MAXSCATTERGATHER_RECV];
-	size_t read_count;
-	size_t actual_count;
-	struct msghdr msghdr;
-	isc_buffer_t *buffer;
-	int recv_errno;
-	char strbuf[ISC_STRERRORSIZE];
-
-	build_msghdr_recv(sock, dev, &msghdr, iov, &read_count);
-
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
-
-	cc = recvmsg(sock->fd, &msghdr, 0);
-	recv_errno = errno;
-
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
-
-	if (cc < 0) {
-		if (SOFT_ERROR(recv_errno))
-			return (DOIO_SOFT);
-
-		if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
-			isc__strerror(recv_errno, strbuf, sizeof(strbuf));
-			socket_log(sock, NULL, IOEVENT,
-				   isc_msgcat, ISC_MSGSET_SOCKET,
-				   ISC_MSG_DOIORECV,
-				  "doio_recv: recvmsg(%d) %d bytes, err %d/%s",
-				   sock->fd, cc, recv_errno, strbuf);
-		}
-
+recv_error(isc__socket_t *sock, isc_socketevent_t *dev, int recv_errno) {
 #define SOFT_OR_HARD(_system, _isc) \
 	if (recv_errno == _system) { \
 		if (sock->connected) { \
@@ -1904,34 +1918,46 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 		return (DOIO_HARD); \
 	}
 
-		SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
-		SOFT_OR_HARD(ENETUNREACH, ISC_R_NETUNREACH);
-		SOFT_OR_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
-		SOFT_OR_HARD(EHOSTDOWN, ISC_R_HOSTDOWN);
-		/* HPUX 11.11 can return EADDRNOTAVAIL. */
-		SOFT_OR_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
-		ALWAYS_HARD(ENOBUFS, ISC_R_NORESOURCES);
-		/* Should never get this one but it was seen. */
+	SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
+	SOFT_OR_HARD(ENETUNREACH, ISC_R_NETUNREACH);
+	SOFT_OR_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(EHOSTDOWN, ISC_R_HOSTDOWN);
+	/* HPUX 11.11 can return EADDRNOTAVAIL. */
+	SOFT_OR_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
+	ALWAYS_HARD(ENOBUFS, ISC_R_NORESOURCES);
+	/* Should never get this one but it was seen. */
 #ifdef ENOPROTOOPT
-		SOFT_OR_HARD(ENOPROTOOPT, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(ENOPROTOOPT, ISC_R_HOSTUNREACH);
 #endif
-		/*
-		 * HPUX returns EPROTO and EINVAL on receiving some ICMP/ICMPv6
-		 * errors.
-		 */
+	/*
+	 * HPUX returns EPROTO and EINVAL on receiving some ICMP/ICMPv6
+	 * errors.
+	 */
 #ifdef EPROTO
-		SOFT_OR_HARD(EPROTO, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(EPROTO, ISC_R_HOSTUNREACH);
 #endif
-		SOFT_OR_HARD(EINVAL, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(EINVAL, ISC_R_HOSTUNREACH);
 
 #undef SOFT_OR_HARD
 #undef ALWAYS_HARD
 
-		dev->result = isc__errno2result(recv_errno);
-		inc_stats(sock->manager->stats,
-			  sock->statsindex[STATID_RECVFAIL]);
-		return (DOIO_HARD);
-	}
+	dev->result = isc__errno2result(recv_errno);
+	inc_stats(sock->manager->stats,
+		  sock->statsindex[STATID_RECVFAIL]);
+	return (DOIO_HARD);
+}
+
+/*
+ * Complete a read of 'cc' bytes into 'dev' described by 'msghdr':
+ * check the source address, pull out the control messages and update
+ * the buffers.
+ */
+static int
+recv_done(isc__socket_t *sock, isc_socketevent_t *dev, struct msghdr *msghdr,
+	  int cc, size_t read_count)
+{
+	size_t actual_count;
+	isc_buffer_t *buffer;
 
 	/*
 	 * On TCP and UNIX sockets, zero length reads indicate EOF,
@@ -1953,7 +1979,7 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	}
 
 	if (sock->type == isc_sockettype_udp) {
-		dev->address.length = msghdr.msg_namelen;
+		dev->address.length = msghdr->msg_namelen;
 		if (isc_sockaddr_getport(&dev->address) == 0) {
 			if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
 				socket_log(sock, &dev->address, IOEVENT,
@@ -1991,7 +2017,7 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	 * If there are control messages attached, run through them and pull
 	 * out the interesting bits.
 	 */
-	process_cmsg(sock, &msghdr, dev);
+	process_cmsg(sock, msghdr, dev);
 
 	/*
 	 * update the buffers (if any) and the i/o count
@@ -2031,6 +2057,47 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	return (DOIO_SUCCESS);
 }
 
+static int
+doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
+	int cc;
+	struct iovec iov[MAXSCATTERGATHER_RECV];
+	size_t read_count;
+	struct msghdr msghdr;
+	int recv_errno;
+	char strbuf[ISC_STRERRORSIZE];
+
+	build_msghdr_recv(sock, dev, &msghdr, iov, &read_count);
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	cc = recvmsg(sock->fd, &msghdr, 0);
+	recv_errno = errno;
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	if (cc < 0) {
+		if (SOFT_ERROR(recv_errno))
+			return (DOIO_SOFT);
+
+		if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
+			isc__strerror(recv_errno, strbuf, sizeof(strbuf));
+			socket_log(sock, NULL, IOEVENT,
+				   isc_msgcat, ISC_MSGSET_SOCKET,
+				   ISC_MSG_DOIORECV,
+				  "doio_recv: recvmsg(%d) %d bytes, err %d/%s",
+				   sock->fd, cc, recv_errno, strbuf);
+		}
+
+		return (recv_error(sock, dev, recv_errno));
+	}
+
+	return (recv_done(sock, dev, &msghdr, cc, read_count));
+}
+
 /*
  * Returns:
  *	DOIO_SUCCESS	The operation succeeded.  dev->result contains
@@ -2044,40 +2111,20 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
  *
  *	No other return values are possible.
  */
+/*
+ * Map a sendmsg() or sendmmsg() failure onto a DOIO_* code, setting
+ * dev->result when the error is hard.
+ */
 static int
-doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
-	int cc;
-	struct iovec iov[MAXSCATTERGATHER_SEND];
-	size_t write_count;
-	struct msghdr msghdr;
+send_error(isc__socket_t *sock, isc_socketevent_t *dev, int send_errno) {
 	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
-	int attempts = 0;
-	int send_errno;
 	char strbuf[ISC_STRERRORSIZE];
 
-	build_msghdr_send(sock, dev, &msghdr, iov, &write_count);
-
- resend:
-	if (sock->type == isc_sockettype_udp &&
-	    sock->manager->maxudp != 0 &&
-	    write_count > (size_t)sock->manager->maxudp)
-		cc = write_count;
-	else
-		cc = sendmsg(sock->fd, &msghdr, 0);
-	send_errno = errno;
-
-	/*
-	 * Check for error or block condition.
-	 */
-	if (cc < 0) {
-		if (send_errno == EINTR && ++attempts < NRETRIES)
-			goto resend;
-
-		if (SOFT_ERROR(send_errno)) {
-			if (errno == EWOULDBLOCK || errno == EAGAIN)
-				dev->result = ISC_R_WOULDBLOCK;
-			return (DOIO_SOFT);
-		}
+	if (SOFT_ERROR(send_errno)) {
+		if (send_errno == EWOULDBLOCK || send_errno == EAGAIN)
+			dev->result = ISC_R_WOULDBLOCK;
+		return (DOIO_SOFT);
+	}
 
 #define SOFT_OR_HARD(_system, _isc) \
 	if (send_errno == _system) { \
@@ -2097,42 +2144,50 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
 		return (DOIO_HARD); \
 	}
 
-		SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
-		ALWAYS_HARD(EACCES, ISC_R_NOPERM);
-		ALWAYS_HARD(EAFNOSUPPORT, ISC_R_ADDRNOTAVAIL);
-		ALWAYS_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
-		ALWAYS_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
+	ALWAYS_HARD(EACCES, ISC_R_NOPERM);
+	ALWAYS_HARD(EAFNOSUPPORT, ISC_R_ADDRNOTAVAIL);
+	ALWAYS_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
+	ALWAYS_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
 #ifdef EHOSTDOWN
-		ALWAYS_HARD(EHOSTDOWN, ISC_R_HOSTUNREACH);
+	ALWAYS_HARD(EHOSTDOWN, ISC_R_HOSTUNREACH);
 #endif
-		ALWAYS_HARD(ENETUNREACH, ISC_R_NETUNREACH);
-		ALWAYS_HARD(ENOBUFS, ISC_R_NORESOURCES);
-		ALWAYS_HARD(EPERM, ISC_R_HOSTUNREACH);
-		ALWAYS_HARD(EPIPE, ISC_R_NOTCONNECTED);
-		ALWAYS_HARD(ECONNRESET, ISC_R_CONNECTIONRESET);
+	ALWAYS_HARD(ENETUNREACH, ISC_R_NETUNREACH);
+	ALWAYS_HARD(ENOBUFS, ISC_R_NORESOURCES);
+	ALWAYS_HARD(EPERM, ISC_R_HOSTUNREACH);
+	ALWAYS_HARD(EPIPE, ISC_R_NOTCONNECTED);
+	ALWAYS_HARD(ECONNRESET, ISC_R_CONNECTIONRESET);
 
 #undef SOFT_OR_HARD
 #undef ALWAYS_HARD
 
-		/*
-		 * The other error types depend on whether or not the
-		 * socket is UDP or TCP.  If it is UDP, some errors
-		 * that we expect to be fatal under TCP are merely
-		 * annoying, and are really soft errors.
-		 *
-		 * However, these soft errors are still returned as
-		 * a status.
-		 */
-		isc_sockaddr_format(&dev->address, addrbuf, sizeof(addrbuf));
-		isc__strerror(send_errno, strbuf, sizeof(strbuf));
-		UNEXPECTED_ERROR(__FILE__, __LINE__, "internal_send: %s: %s",
-				 addrbuf, strbuf);
-		dev->result = isc__errno2result(send_errno);
-		inc_stats(sock->manager->stats,
-			  sock->statsindex[STATID_SENDFAIL]);
-		return (DOIO_HARD);
-	}
+	/*
+	 * The other error types depend on whether or not the
+	 * socket is UDP or TCP.  If it is UDP, some errors
+	 * that we expect to be fatal under TCP are merely
+	 * annoying, and are really soft errors.
+	 *
+	 * However, these soft errors are still returned as
+	 * a status.
+	 */
+	isc_sockaddr_format(&dev->address, addrbuf, sizeof(addrbuf));
+	isc__strerror(send_errno, strbuf, sizeof(strbuf));
+	UNEXPECTED_ERROR(__FILE__, __LINE__, "internal_send: %s: %s",
+			 addrbuf, strbuf);
+	dev->result = isc__errno2result(send_errno);
+	inc_stats(sock->manager->stats,
+		  sock->statsindex[STATID_SENDFAIL]);
+	return (DOIO_HARD);
+}
 
+/*
+ * Complete a write of 'cc' bytes out of the 'write_count' requested
+ * from 'dev'.
+ */
+static int
+send_done(isc__socket_t *sock, isc_socketevent_t *dev, int cc,
+	  size_t write_count)
+{
 	if (cc == 0) {
 		inc_stats(sock->manager->stats,
 			  sock->statsindex[STATID_SENDFAIL]);
@@ -2157,6 +2212,39 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
 	return (DOIO_SUCCESS);
 }
 
+static int
+doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
+	int cc;
+	struct iovec iov[MAXSCATTERGATHER_SEND];
+	size_t write_count;
+	struct msghdr msghdr;
+	int attempts = 0;
+	int send_errno;
+
+	build_msghdr_send(sock, dev, &msghdr, iov, &write_count);
+
+ resend:
+	if (sock->type == isc_sockettype_udp &&
+	    sock->manager->maxudp != 0 &&
+	    write_count > (size_t)sock->manager->maxudp)
+		cc = write_count;
+	else
+		cc = sendmsg(sock->fd, &msghdr, 0);
+	send_errno = errno;
+
+	/*
+	 * Check for error or block condition.
+	 */
+	if (cc < 0) {
+		if (send_errno == EINTR && ++attempts < NRETRIES)
+			goto resend;
+
+		return (send_error(sock, dev, send_errno));
+	}
+
+	return (send_done(sock, dev, cc, write_count));
+}
+
 /*
  * Kill.
  *
@@ -2189,8 +2277,9 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 		 * solve this would be to dup() the watched descriptor, but we
 		 * take a simpler approach at this moment.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(FDTHREAD(manager, fd), fd, SELECT_POKE_READ);
+		(void)unwatch_fd(FDTHREAD(manager, fd), fd,
+				 SELECT_POKE_WRITE);
 	} else
 		select_poke(manager, fd, SELECT_POKE_CLOSE);
 
@@ -2221,9 +2310,9 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 			}
 			UNLOCK(&manager->fdlock[lockid]);
 		}
-#ifdef ISC_PLATFORM_USETHREADS
-		if (manager->maxfd < manager->pipe_fds[0])
-			manager->maxfd = manager->pipe_fds[0];
+#ifdef USE_WATCHER_THREAD
+		if (manager->maxfd < manager->threads[0].pipe_fds[0])
+			manager->maxfd = manager->threads[0].pipe_fds[0];
 #endif
 	}
 
@@ -3771,45 +3860,256 @@ internal_accept(isc_task_t *me, isc_event_t *ev) {
 	return;
 }
 
-static void
-internal_recv(isc_task_t *me, isc_event_t *ev) {
-	isc_socketevent_t *dev;
-	isc__socket_t *sock;
+#ifdef USE_MMSG
+/*%
+ * Can queued requests on 'sock' be coalesced into one recvmmsg() or
+ * sendmmsg() call?  Only unconnected UDP sockets qualify: errors on a
+ * connected socket belong to the request that triggered them.
+ */
+#define BATCHABLE(sock, list, cmsglen) \
+	((sock)->type == isc_sockettype_udp && !(sock)->connected && \
+	 (cmsglen) <= BATCHCMSGBUFLEN && \
+	 ISC_LIST_HEAD((sock)->list) != NULL && \
+	 ISC_LIST_NEXT(ISC_LIST_HEAD((sock)->list), ev_link) != NULL)
 
-	INSIST(ev->ev_type == ISC_SOCKEVENT_INTR);
+typedef union {
+	struct cmsghdr		hdr;
+	char			buf[BATCHCMSGBUFLEN];
+} batchcmsg_t;
 
-	sock = ev->ev_sender;
-	INSIST(VALID_SOCKET(sock));
+#define BATCHSTATS_BUCKETS \
+	(isc_sockstatscounter_udprecvbatch16 - \
+	 isc_sockstatscounter_udprecvbatch1 + 1)
 
-	LOCK(&sock->lock);
-	socket_log(sock, NULL, IOEVENT,
-		   isc_msgcat, ISC_MSGSET_SOCKET, ISC_MSG_INTERNALRECV,
-		   "internal_recv: task %p got event %p", me, ev);
+/*
+ * Count one batch of 'n' datagrams in the histogram starting at
+ * 'counter': 1, 2-3, 4-7, 8-15 and 16 or more.
+ */
+static void
+inc_batchstats(isc__socket_t *sock, isc_statscounter_t counter,
+	       unsigned int n)
+{
+	unsigned int bucket = 0;
 
-	INSIST(sock->pending_recv == 1);
-	sock->pending_recv = 0;
+	INSIST(n > 0);
 
-	INSIST(sock->references > 0);
-	sock->references--;  /* the internal event is done with this socket */
-	if (sock->references == 0) {
-		UNLOCK(&sock->lock);
-		destroy(&sock);
-		return;
+	while (n > 1 && bucket < BATCHSTATS_BUCKETS - 1) {
+		bucket++;
+		n >>= 1;
 	}
+	inc_stats(sock->manager->stats, counter + bucket);
+}
 
-	/*
-	 * Try to do as much I/O as possible on this socket.  There are no
-	 * limits here, currently.
-	 */
-	dev = ISC_LIST_HEAD(sock->recv_list);
-	while (dev != NULL) {
-		switch (doio_recv(sock, dev)) {
-		case DOIO_SOFT:
-			goto poke;
+/*
+ * Read as many datagrams as are waiting, up to one for each of the first
+ * MAXBATCH_UDP requests on the receive queue, with a single recvmmsg().
+ * Completed requests are posted; requests that got nothing, or whose
+ * datagram was dropped, stay queued.
+ *
+ * Returns DOIO_SUCCESS when every request offered was filled, so the
+ * socket may still be readable, or when a hard error was posted to the
+ * first request; DOIO_SOFT once the socket has been drained.
+ *
+ * The caller must hold the socket lock.
+ */
+static int
+doio_recvbatch(isc__socket_t *sock) {
+	struct mmsghdr msgs[MAXBATCH_UDP];
+	isc_socketevent_t *devs[MAXBATCH_UDP];
+	struct iovec iov[MAXBATCH_UDP][MAXSCATTERGATHER_RECV];
+	size_t read_count[MAXBATCH_UDP];
+#if defined(USE_CMSG)
+	batchcmsg_t cmsgbuf[MAXBATCH_UDP];
+#endif
+	isc_socketevent_t *dev;
+	unsigned int i, n = 0;
+	int cc;
+	int recv_errno;
+	char strbuf[ISC_STRERRORSIZE];
 
-		case DOIO_EOF:
-			/*
-			 * read of 0 means the remote end was closed.
+	for (dev = ISC_LIST_HEAD(sock->recv_list);
+	     dev != NULL && n < MAXBATCH_UDP;
+	     dev = ISC_LIST_NEXT(dev, ev_link))
+	{
+		build_msghdr_recv(sock, dev, &msgs[n].msg_hdr, iov[n],
+				  &read_count[n]);
+#if defined(USE_CMSG)
+		msgs[n].msg_hdr.msg_control = cmsgbuf[n].buf;
+#endif
+		msgs[n].msg_len = 0;
+		devs[n++] = dev;
+	}
+
+	cc = recvmmsg(sock->fd, msgs, n, 0, NULL);
+	recv_errno = errno;
+
+	if (cc < 0) {
+		if (SOFT_ERROR(recv_errno))
+			return (DOIO_SOFT);
+
+		if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
+			isc__strerror(recv_errno, strbuf, sizeof(strbuf));
+			socket_log(sock, NULL, IOEVENT,
+				   isc_msgcat, ISC_MSGSET_SOCKET,
+				   ISC_MSG_DOIORECV,
+				   "doio_recvbatch: recvmmsg(%d) %u "
+				   "requests, err %d/%s",
+				   sock->fd, n, recv_errno, strbuf);
+		}
+
+		dev = devs[0];
+		if (recv_error(sock, dev, recv_errno) == DOIO_SOFT)
+			return (DOIO_SOFT);
+		send_recvdone_event(sock, &dev);
+		return (DOIO_SUCCESS);
+	}
+
+	if (cc == 0)
+		return (DOIO_SOFT);
+
+	inc_batchstats(sock, isc_sockstatscounter_udprecvbatch1,
+		       (unsigned int)cc);
+
+	for (i = 0; i < (unsigned int)cc; i++) {
+		dev = devs[i];
+		switch (recv_done(sock, dev, &msgs[i].msg_hdr,
+				  (int)msgs[i].msg_len, read_count[i])) {
+		case DOIO_SOFT:
+			break;
+		case DOIO_SUCCESS:
+		case DOIO_HARD:
+			send_recvdone_event(sock, &dev);
+			break;
+		case DOIO_EOF:
+		default:
+			INSIST(0);
+		}
+	}
+
+	return (((unsigned int)cc == n) ? DOIO_SUCCESS : DOIO_SOFT);
+}
+
+/*
+ * Write the datagrams of the first MAXBATCH_UDP requests on the send
+ * queue with a single sendmmsg(), posting each request that completed.
+ *
+ * Returns DOIO_SUCCESS when progress was made, DOIO_SOFT when the socket
+ * cannot take any more data for now.
+ *
+ * The caller must hold the socket lock.
+ */
+static int
+doio_sendbatch(isc__socket_t *sock) {
+	struct mmsghdr msgs[MAXBATCH_UDP];
+	isc_socketevent_t *devs[MAXBATCH_UDP];
+	struct iovec iov[MAXBATCH_UDP][MAXSCATTERGATHER_SEND];
+	size_t write_count[MAXBATCH_UDP];
+#if defined(USE_CMSG)
+	batchcmsg_t cmsgbuf[MAXBATCH_UDP];
+#endif
+	isc_socketevent_t *dev;
+	unsigned int i, n = 0;
+	int cc;
+	int send_errno;
+
+	for (dev = ISC_LIST_HEAD(sock->send_list);
+	     dev != NULL && n < MAXBATCH_UDP;
+	     dev = ISC_LIST_NEXT(dev, ev_link))
+	{
+		build_msghdr_send(sock, dev, &msgs[n].msg_hdr, iov[n],
+				  &write_count[n]);
+#if defined(USE_CMSG)
+		/*
+		 * build_msghdr_send() uses the socket's own control
+		 * buffer; give each datagram a private copy.
+		 */
+		if (msgs[n].msg_hdr.msg_controllen != 0) {
+			INSIST(msgs[n].msg_hdr.msg_controllen <=
+			       sizeof(cmsgbuf[n].buf));
+			memmove(cmsgbuf[n].buf, msgs[n].msg_hdr.msg_control,
+				msgs[n].msg_hdr.msg_controllen);
+			msgs[n].msg_hdr.msg_control = cmsgbuf[n].buf;
+		}
+#endif
+		msgs[n].msg_len = 0;
+		devs[n++] = dev;
+	}
+
+	cc = sendmmsg(sock->fd, msgs, n, 0);
+	send_errno = errno;
+
+	if (cc < 0) {
+		dev = devs[0];
+		if (send_error(sock, dev, send_errno) == DOIO_SOFT)
+			return (DOIO_SOFT);
+		send_senddone_event(sock, &dev);
+		return (DOIO_SUCCESS);
+	}
+
+	if (cc == 0)
+		return (DOIO_SOFT);
+
+	inc_batchstats(sock, isc_sockstatscounter_udpsendbatch1,
+		       (unsigned int)cc);
+
+	for (i = 0; i < (unsigned int)cc; i++) {
+		dev = devs[i];
+		if (send_done(sock, dev, (int)msgs[i].msg_len,
+			      write_count[i]) != DOIO_SOFT)
+			send_senddone_event(sock, &dev);
+	}
+
+	return (DOIO_SUCCESS);
+}
+#endif /* USE_MMSG */
+
+static void
+internal_recv(isc_task_t *me, isc_event_t *ev) {
+	isc_socketevent_t *dev;
+	isc__socket_t *sock;
+
+	INSIST(ev->ev_type == ISC_SOCKEVENT_INTR);
+
+	sock = ev->ev_sender;
+	INSIST(VALID_SOCKET(sock));
+
+	LOCK(&sock->lock);
+	socket_log(sock, NULL, IOEVENT,
+		   isc_msgcat, ISC_MSGSET_SOCKET, ISC_MSG_INTERNALRECV,
+		   "internal_recv: task %p got event %p", me, ev);
+
+	INSIST(sock->pending_recv == 1);
+	sock->pending_recv = 0;
+
+	INSIST(sock->references > 0);
+	sock->references--;  /* the internal event is done with this socket */
+	if (sock->references == 0) {
+		UNLOCK(&sock->lock);
+		destroy(&sock);
+		return;
+	}
+
+	/*
+	 * Try to do as much I/O as possible on this socket.  There are no
+	 * limits here, currently.
+	 */
+	dev = ISC_LIST_HEAD(sock->recv_list);
+	while (dev != NULL) {
+#ifdef USE_MMSG
+		if (BATCHABLE(sock, recv_list, sock->recvcmsgbuflen)) {
+			if (doio_recvbatch(sock) == DOIO_SOFT)
+				goto poke;
+			dev = ISC_LIST_HEAD(sock->recv_list);
+			continue;
+		}
+#endif
+		switch (doio_recv(sock, dev)) {
+		case DOIO_SOFT:
+			goto poke;
+
+		case DOIO_EOF:
+			/*
+			 * read of 0 means the remote end was closed.
 			 * Run through the event queue and dispatch all
 			 * the events with an EOF result code.
 			 */
@@ -3871,6 +4171,15 @@ internal_send(isc_task_t *me, isc_event_t *ev) {
 	 */
 	dev = ISC_LIST_HEAD(sock->send_list);
 	while (dev != NULL) {
+#ifdef USE_MMSG
+		if (sock->manager->maxudp == 0 &&
+		    BATCHABLE(sock, send_list, sock->sendcmsgbuflen)) {
+			if (doio_sendbatch(sock) == DOIO_SOFT)
+				goto poke;
+			dev = ISC_LIST_HEAD(sock->send_list);
+			continue;
+		}
+#endif
 		switch (doio_send(sock, dev)) {
 		case DOIO_SOFT:
 			goto poke;
@@ -3978,9 +4287,10 @@ internal_fdwatch_read(isc_task_t *me, isc_event_t *ev) {
  * and unlocking twice if both reads and writes are possible.
  */
 static void
-process_fd(isc__socketmgr_t *manager, int fd, isc_boolean_t readable,
+process_fd(isc__socketthread_t *thread, int fd, isc_boolean_t readable,
 	   isc_boolean_t writeable)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	isc__socket_t *sock;
 	isc_boolean_t unlock_sock;
 	isc_boolean_t unwatch_read = ISC_FALSE, unwatch_write = ISC_FALSE;
@@ -3993,8 +4303,8 @@ process_fd(isc__socketmgr_t *manager, int fd, isc_boolean_t readable,
 	if (manager->fdstate[fd] == CLOSE_PENDING) {
 		UNLOCK(&manager->fdlock[lockid]);
 
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
 
@@ -4039,15 +4349,16 @@ check_write:
  unlock_fd:
 	UNLOCK(&manager->fdlock[lockid]);
 	if (unwatch_read)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
 	if (unwatch_write)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 
 }
 
 #ifdef USE_KQUEUE
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct kevent *events, int nevents) {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	isc_boolean_t readable, writable;
 	isc_boolean_t done = ISC_FALSE;
@@ -4055,7 +4366,7 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		/*
 		 * This is not an error, but something unexpected.  If this
 		 * happens, it may indicate the need for increasing
@@ -4070,34 +4381,36 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].ident < manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].ident == (uintptr_t)manager->pipe_fds[0]) {
+		if (events[i].ident == (uintptr_t)thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
 #endif
 		readable = ISC_TF(events[i].filter == EVFILT_READ);
 		writable = ISC_TF(events[i].filter == EVFILT_WRITE);
-		process_fd(manager, events[i].ident, readable, writable);
+		process_fd(thread, events[i].ident, readable, writable);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_EPOLL)
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
+process_fds(isc__socketthread_t *thread, struct epoll_event *events,
+	    int nevents)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	isc_boolean_t done = ISC_FALSE;
 #ifdef USE_WATCHER_THREAD
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
@@ -4107,7 +4420,7 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].data.fd < (int)manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].data.fd == manager->pipe_fds[0]) {
+		if (events[i].data.fd == thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
@@ -4124,28 +4437,29 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 			int fd = events[i].data.fd;
 			events[i].events |= manager->epoll_events[fd];
 		}
-		process_fd(manager, events[i].data.fd,
+		process_fd(thread, events[i].data.fd,
 			   (events[i].events & EPOLLIN) != 0,
 			   (events[i].events & EPOLLOUT) != 0);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_DEVPOLL)
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct pollfd *events, int nevents) {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 	isc_boolean_t done = ISC_FALSE;
 #ifdef USE_WATCHER_THREAD
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
@@ -4155,38 +4469,39 @@ process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].fd < (int)manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].fd == manager->pipe_fds[0]) {
+		if (events[i].fd == thread->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
 #endif
-		process_fd(manager, events[i].fd,
+		process_fd(thread, events[i].fd,
 			   (events[i].events & POLLIN) != 0,
 			   (events[i].events & POLLOUT) != 0);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_SELECT)
 static void
-process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
+process_fds(isc__socketthread_t *thread, int maxfd, fd_set *readfds,
 	    fd_set *writefds)
 {
+	isc__socketmgr_t *manager = thread->manager;
 	int i;
 
 	REQUIRE(maxfd <= (int)manager->maxsocks);
 
 	for (i = 0; i < maxfd; i++) {
 #ifdef USE_WATCHER_THREAD
-		if (i == manager->pipe_fds[0] || i == manager->pipe_fds[1])
+		if (i == thread->pipe_fds[0] || i == thread->pipe_fds[1])
 			continue;
 #endif /* USE_WATCHER_THREAD */
-		process_fd(manager, i, FD_ISSET(i, readfds),
+		process_fd(thread, i, FD_ISSET(i, readfds),
 			   FD_ISSET(i, writefds));
 	}
 }
@@ -4194,11 +4509,12 @@ process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
 
 #ifdef USE_WATCHER_THREAD
 static isc_boolean_t
-process_ctlfd(isc__socketmgr_t *manager) {
+process_ctlfd(isc__socketthread_t *thread) {
+	isc__socketmgr_t *manager = thread->manager;
 	int msg, fd;
 
 	for (;;) {
-		select_readmsg(manager, &fd, &msg);
+		select_readmsg(thread, &fd, &msg);
 
 		manager_log(manager, IOEVENT,
 			    isc_msgcat_get(isc_msgcat, ISC_MSGSET_SOCKET,
@@ -4227,7 +4543,7 @@ process_ctlfd(isc__socketmgr_t *manager) {
 		 * and decide if we need to watch on it now
 		 * or not.
 		 */
-		wakeup_socket(manager, fd, msg);
+		wakeup_socket(thread, fd, msg);
 	}
 
 	return (ISC_FALSE);
@@ -4242,7 +4558,8 @@ process_ctlfd(isc__socketmgr_t *manager) {
  */
 static isc_threadresult_t
 watcher(void *uap) {
-	isc__socketmgr_t *manager = uap;
+	isc__socketthread_t *thread = uap;
+	isc__socketmgr_t *manager = thread->manager;
 	isc_boolean_t done;
 	int cc;
 #ifdef USE_KQUEUE
@@ -4268,34 +4585,34 @@ watcher(void *uap) {
 	/*
 	 * Get the control fd here.  This will never change.
 	 */
-	ctlfd = manager->pipe_fds[0];
+	ctlfd = thread->pipe_fds[0];
 #endif
 	done = ISC_FALSE;
 	while (!done) {
 		do {
 #ifdef USE_KQUEUE
-			cc = kevent(manager->kqueue_fd, NULL, 0,
-				    manager->events, manager->nevents, NULL);
+			cc = kevent(thread->kqueue_fd, NULL, 0,
+				    thread->events, thread->nevents, NULL);
 #elif defined(USE_EPOLL)
-			cc = epoll_wait(manager->epoll_fd, manager->events,
-					manager->nevents, -1);
+			cc = epoll_wait(thread->epoll_fd, thread->events,
+					thread->nevents, -1);
 #elif defined(USE_DEVPOLL)
 			/*
 			 * Re-probe every thousand calls.
 			 */
-			if (manager->calls++ > 1000U) {
+			if (thread->calls++ > 1000U) {
 				result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 				if (result != ISC_R_SUCCESS)
-					manager->open_max = 64;
-				manager->calls = 0;
+					thread->open_max = 64;
+				thread->calls = 0;
 			}
 			for (pass = 0; pass < 2; pass++) {
-				dvp.dp_fds = manager->events;
-				dvp.dp_nfds = manager->nevents;
-				if (dvp.dp_nfds >= manager->open_max)
-					dvp.dp_nfds = manager->open_max - 1;
+				dvp.dp_fds = thread->events;
+				dvp.dp_nfds = thread->nevents;
+				if (dvp.dp_nfds >= thread->open_max)
+					dvp.dp_nfds = thread->open_max - 1;
 #ifndef ISC_SOCKET_USE_POLLWATCH
 				dvp.dp_timeout = -1;
 #else
@@ -4305,7 +4622,7 @@ watcher(void *uap) {
 					dvp.dp_timeout =
 						 ISC_SOCKET_POLLWATCH_TIMEOUT;
 #endif	/* ISC_SOCKET_USE_POLLWATCH */
-				cc = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+				cc = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 				if (cc == -1 && errno == EINVAL) {
 					/*
 					 * {OPEN_MAX} may have dropped.  Look
@@ -4313,9 +4630,9 @@ watcher(void *uap) {
 					 */
 					result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 					if (result != ISC_R_SUCCESS)
-						manager->open_max = 64;
+						thread->open_max = 64;
 				} else
 					break;
 			}
@@ -4370,16 +4687,16 @@ watcher(void *uap) {
 		} while (cc < 0);
 
 #if defined(USE_KQUEUE) || defined (USE_EPOLL) || defined (USE_DEVPOLL)
-		done = process_fds(manager, manager->events, cc);
+		done = process_fds(thread, thread->events, cc);
 #elif defined(USE_SELECT)
-		process_fds(manager, maxfd, manager->read_fds_copy,
+		process_fds(thread, maxfd, manager->read_fds_copy,
 			    manager->write_fds_copy);
 
 		/*
 		 * Process reads on internal, control fd.
 		 */
 		if (FD_ISSET(ctlfd, manager->read_fds_copy))
-			done = process_ctlfd(manager);
+			done = process_ctlfd(thread);
 #endif
 	}
 
@@ -4414,20 +4731,44 @@ isc__socketmgr_maxudp(isc_socketmgr_t *manager0, int maxudp) {
  */
 
 static isc_result_t
-setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+setup_thread(isc_mem_t *mctx, isc__socketthread_t *thread) {
 	isc_result_t result;
-#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
+#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL) || \
+    defined(USE_WATCHER_THREAD)
 	char strbuf[ISC_STRERRORSIZE];
 #endif
 
+#ifdef USE_WATCHER_THREAD
+	/*
+	 * Create the special fds that will be used to wake up the
+	 * select/poll loop when something internal needs to be done.
+	 */
+	if (pipe(thread->pipe_fds) != 0) {
+		isc__strerror(errno, strbuf, sizeof(strbuf));
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "pipe() %s: %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"),
+				 strbuf);
+		return (ISC_R_UNEXPECTED);
+	}
+
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[0]) == ISC_R_SUCCESS);
+#if 0
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[1]) == ISC_R_SUCCESS);
+#endif
+#endif	/* USE_WATCHER_THREAD */
+
 #ifdef USE_KQUEUE
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct kevent) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	manager->kqueue_fd = kqueue();
-	if (manager->kqueue_fd == -1) {
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct kevent) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_pipe;
+	}
+	thread->kqueue_fd = kqueue();
+	if (thread->kqueue_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4435,28 +4776,26 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
-		return (result);
+		goto cleanup_events;
 	}
 
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->kqueue_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
-		return (result);
+		close(thread->kqueue_fd);
+		goto cleanup_events;
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_EPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	manager->epoll_fd = epoll_create(manager->nevents);
-	if (manager->epoll_fd == -1) {
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_pipe;
+	}
+	thread->epoll_fd = epoll_create(thread->nevents);
+	if (thread->epoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4464,44 +4803,30 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
-		return (result);
+		goto cleanup_events;
 	}
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->epoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
-		return (result);
+		close(thread->epoll_fd);
+		goto cleanup_events;
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_DEVPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
 	result = isc_resource_getcurlimit(isc_resource_openfiles,
-					  &manager->open_max);
+					  &thread->open_max);
 	if (result != ISC_R_SUCCESS)
-		manager->open_max = 64;
-	manager->calls = 0;
-	manager->events = isc_mem_get(mctx, sizeof(struct pollfd) *
-				      manager->nevents);
-	if (manager->events == NULL)
-		return (ISC_R_NOMEMORY);
-	/*
-	 * Note: fdpollinfo should be able to support all possible FDs, so
-	 * it must have maxsocks entries (not nevents).
-	 */
-	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
-					  manager->maxsocks);
-	if (manager->fdpollinfo == NULL) {
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		return (ISC_R_NOMEMORY);
+		thread->open_max = 64;
+	thread->calls = 0;
+	thread->events = isc_mem_get(mctx, sizeof(struct pollfd) *
+				     thread->nevents);
+	if (thread->events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_pipe;
 	}
-	memset(manager->fdpollinfo, 0, sizeof(pollinfo_t) * manager->maxsocks);
-	manager->devpoll_fd = open("/dev/poll", O_RDWR);
-	if (manager->devpoll_fd == -1) {
+	thread->devpoll_fd = open("/dev/poll", O_RDWR);
+	if (thread->devpoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4509,26 +4834,101 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
-		return (result);
+		goto cleanup_events;
 	}
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->devpoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
-		return (result);
+		close(thread->devpoll_fd);
+		goto cleanup_events;
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_SELECT)
+	UNUSED(mctx);
 	UNUSED(result);
 
+#ifdef USE_WATCHER_THREAD
+	(void)watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
+#endif /* USE_WATCHER_THREAD */
+#endif	/* USE_KQUEUE */
+
+	return (ISC_R_SUCCESS);
+
+#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
+ cleanup_events:
+#ifdef USE_KQUEUE
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct kevent) * thread->nevents);
+#elif defined(USE_EPOLL)
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct epoll_event) * thread->nevents);
+#elif defined(USE_DEVPOLL)
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct pollfd) * thread->nevents);
+#endif
+	thread->events = NULL;
+
+ cleanup_pipe:
+#ifdef USE_WATCHER_THREAD
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+#endif	/* USE_WATCHER_THREAD */
+	return (result);
+#endif
+}
+
+static void
+cleanup_thread(isc_mem_t *mctx, isc__socketthread_t *thread) {
+#ifdef USE_WATCHER_THREAD
+	isc_result_t result;
+
+	result = unwatch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
+	if (result != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "epoll_ctl(DEL) %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+	}
+#endif	/* USE_WATCHER_THREAD */
+
+#ifdef USE_KQUEUE
+	close(thread->kqueue_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct kevent) * thread->nevents);
+#elif defined(USE_EPOLL)
+	close(thread->epoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct epoll_event) * thread->nevents);
+#elif defined(USE_DEVPOLL)
+	close(thread->devpoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct pollfd) * thread->nevents);
+#elif defined(USE_SELECT)
+	UNUSED(mctx);
+#endif	/* USE_KQUEUE */
+
+#ifdef USE_WATCHER_THREAD
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+#endif	/* USE_WATCHER_THREAD */
+}
+
+static isc_result_t
+setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+	isc_result_t result;
+	int i;
+
+#if defined(USE_DEVPOLL)
+	/*
+	 * Note: fdpollinfo should be able to support all possible FDs, so
+	 * it must have maxsocks entries (not nevents).
+	 */
+	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
+					  manager->maxsocks);
+	if (manager->fdpollinfo == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(manager->fdpollinfo, 0, sizeof(pollinfo_t) * manager->maxsocks);
+#elif defined(USE_SELECT)
 #if ISC_SOCKET_MAXSOCKETS > FD_SETSIZE
 	/*
 	 * Note: this code should also cover the case of MAXSOCKETS <=
@@ -4556,60 +4956,85 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 						      manager->fd_bufsize);
 	}
 	if (manager->write_fds_copy == NULL) {
-		if (manager->write_fds != NULL) {
-			isc_mem_put(mctx, manager->write_fds,
-				    manager->fd_bufsize);
-		}
-		if (manager->read_fds_copy != NULL) {
-			isc_mem_put(mctx, manager->read_fds_copy,
-				    manager->fd_bufsize);
-		}
-		if (manager->read_fds != NULL) {
-			isc_mem_put(mctx, manager->read_fds,
-				    manager->fd_bufsize);
-		}
-		return (ISC_R_NOMEMORY);
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
 	}
 	memset(manager->read_fds, 0, manager->fd_bufsize);
 	memset(manager->write_fds, 0, manager->fd_bufsize);
-
-#ifdef USE_WATCHER_THREAD
-	(void)watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	manager->maxfd = manager->pipe_fds[0];
-#else /* USE_WATCHER_THREAD */
 	manager->maxfd = 0;
-#endif /* USE_WATCHER_THREAD */
-#endif	/* USE_KQUEUE */
+#endif	/* USE_DEVPOLL */
+
+	manager->threads = isc_mem_get(mctx, manager->nthreads *
+				       sizeof(isc__socketthread_t));
+	if (manager->threads == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+	memset(manager->threads, 0,
+	       manager->nthreads * sizeof(isc__socketthread_t));
+
+	for (i = 0; i < manager->nthreads; i++) {
+		manager->threads[i].manager = manager;
+		manager->threads[i].threadid = i;
+		result = setup_thread(mctx, &manager->threads[i]);
+		if (result != ISC_R_SUCCESS) {
+			while (--i >= 0)
+				cleanup_thread(mctx, &manager->threads[i]);
+			isc_mem_put(mctx, manager->threads,
+				    manager->nthreads *
+				    sizeof(isc__socketthread_t));
+			manager->threads = NULL;
+			goto cleanup;
+		}
+	}
+
+#if defined(USE_SELECT) && defined(USE_WATCHER_THREAD)
+	manager->maxfd = manager->threads[0].pipe_fds[0];
+#endif
 
 	return (ISC_R_SUCCESS);
+
+ cleanup:
+#if defined(USE_DEVPOLL)
+	isc_mem_put(mctx, manager->fdpollinfo,
+		    sizeof(pollinfo_t) * manager->maxsocks);
+	manager->fdpollinfo = NULL;
+#elif defined(USE_SELECT)
+	if (manager->write_fds_copy != NULL) {
+		isc_mem_put(mctx, manager->write_fds_copy,
+			    manager->fd_bufsize);
+	}
+	if (manager->write_fds != NULL) {
+		isc_mem_put(mctx, manager->write_fds,
+			    manager->fd_bufsize);
+	}
+	if (manager->read_fds_copy != NULL) {
+		isc_mem_put(mctx, manager->read_fds_copy,
+			    manager->fd_bufsize);
+	}
+	if (manager->read_fds != NULL) {
+		isc_mem_put(mctx, manager->read_fds,
+			    manager->fd_bufsize);
+	}
+	manager->read_fds = NULL;
+	manager->read_fds_copy = NULL;
+	manager->write_fds = NULL;
+	manager->write_fds_copy = NULL;
+#endif	/* USE_DEVPOLL */
+	return (result);
 }
 
 static void
 cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
-#ifdef USE_WATCHER_THREAD
-	isc_result_t result;
+	int i;
 
-	result = unwatch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	if (result != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "epoll_ctl(DEL) %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-	}
-#endif	/* USE_WATCHER_THREAD */
+	for (i = 0; i < manager->nthreads; i++)
+		cleanup_thread(mctx, &manager->threads[i]);
+	isc_mem_put(mctx, manager->threads,
+		    manager->nthreads * sizeof(isc__socketthread_t));
+	manager->threads = NULL;
 
-#ifdef USE_KQUEUE
-	close(manager->kqueue_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct kevent) * manager->nevents);
-#elif defined(USE_EPOLL)
-	close(manager->epoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct epoll_event) * manager->nevents);
-#elif defined(USE_DEVPOLL)
-	close(manager->devpoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct pollfd) * manager->nevents);
+#if defined(USE_DEVPOLL)
 	isc_mem_put(mctx, manager->fdpollinfo,
 		    sizeof(pollinfo_t) * manager->maxsocks);
 #elif defined(USE_SELECT)
@@ -4621,22 +5046,22 @@ cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 		isc_mem_put(mctx, manager->write_fds, manager->fd_bufsize);
 	if (manager->write_fds_copy != NULL)
 		isc_mem_put(mctx, manager->write_fds_copy, manager->fd_bufsize);
-#endif	/* USE_KQUEUE */
+#endif	/* USE_DEVPOLL */
 }
 
 isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
-	return (isc__socketmgr_create2(mctx, managerp, 0));
+	return (isc__socketmgr_create2(mctx, managerp, 0, 1));
 }
 
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks)
+		       unsigned int maxsocks, int nthreads)
 {
 	int i;
 	isc__socketmgr_t *manager;
 #ifdef USE_WATCHER_THREAD
-	char strbuf[ISC_STRERRORSIZE];
+	char name[sizeof("isc-socket-") + 11];
 #endif
 	isc_result_t result;
 
@@ -4656,6 +5081,16 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 
 	if (maxsocks == 0)
 		maxsocks = ISC_SOCKET_MAXSOCKETS;
+#if defined(USE_WATCHER_THREAD) && !defined(USE_SELECT)
+	if (nthreads < 1)
+		nthreads = 1;
+#else
+	/*
+	 * select() keeps its descriptor sets in the manager, so there can
+	 * only be one loop.
+	 */
+	nthreads = 1;
+#endif
 
 	manager = isc_mem_get(mctx, sizeof(*manager));
 	if (manager == NULL)
@@ -4664,6 +5099,7 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	/* zero-clear so that necessary cleanup on failure will be easy */
 	memset(manager, 0, sizeof(*manager));
 	manager->maxsocks = maxsocks;
+	manager->nthreads = nthreads;
 	manager->reserved = 0;
 	manager->maxudp = 0;
 	manager->fds = isc_mem_get(mctx,
@@ -4723,26 +5159,6 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		result = ISC_R_UNEXPECTED;
 		goto cleanup_lock;
 	}
-
-	/*
-	 * Create the special fds that will be used to wake up the
-	 * select/poll loop when something internal needs to be done.
-	 */
-	if (pipe(manager->pipe_fds) != 0) {
-		isc__strerror(errno, strbuf, sizeof(strbuf));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "pipe() %s: %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"),
-				 strbuf);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_condition;
-	}
-
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[0]) == ISC_R_SUCCESS);
-#if 0
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[1]) == ISC_R_SUCCESS);
-#endif
 #endif	/* USE_WATCHER_THREAD */
 
 #ifdef USE_SHARED_MANAGER
@@ -4760,19 +5176,31 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 
 #ifdef USE_WATCHER_THREAD
 	/*
-	 * Start up the select/poll thread.
+	 * Start up the select/poll threads.
 	 */
-	if (isc_thread_create(watcher, manager, &manager->watcher) !=
-	    ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_create() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		cleanup_watcher(mctx, manager);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup;
+	for (i = 0; i < manager->nthreads; i++) {
+		isc__socketthread_t *thread = &manager->threads[i];
+
+		if (isc_thread_create(watcher, thread, &thread->thread) !=
+		    ISC_R_SUCCESS) {
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_create() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+			while (--i >= 0) {
+				thread = &manager->threads[i];
+				thread_poke(thread, 0, SELECT_POKE_SHUTDOWN);
+				(void)isc_thread_join(thread->thread, NULL);
+			}
+			cleanup_watcher(mctx, manager);
+			result = ISC_R_UNEXPECTED;
+			goto cleanup;
+		}
+		snprintf(name, sizeof(name), "isc-socket-%d", i);
+		isc_thread_setname(thread->thread, name);
 	}
-	isc_thread_setname(manager->watcher, "isc-socket");
 #endif /* USE_WATCHER_THREAD */
 	isc_mem_attach(mctx, &manager->mctx);
 
@@ -4785,12 +5213,6 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 
 cleanup:
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
-#endif	/* USE_WATCHER_THREAD */
-
-#ifdef USE_WATCHER_THREAD
-cleanup_condition:
 	(void)isc_condition_destroy(&manager->shutdown_ok);
 #endif	/* USE_WATCHER_THREAD */
 
@@ -4893,22 +5315,23 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 
 	UNLOCK(&manager->lock);
 
-	/*
-	 * Here, poke our select/poll thread.  Do this by closing the write
-	 * half of the pipe, which will send EOF to the read half.
-	 * This is currently a no-op in the non-threaded case.
-	 */
-	select_poke(manager, 0, SELECT_POKE_SHUTDOWN);
-
 #ifdef USE_WATCHER_THREAD
 	/*
-	 * Wait for thread to exit.
+	 * Here, poke our select/poll threads and wait for them to exit.
 	 */
-	if (isc_thread_join(manager->watcher, NULL) != ISC_R_SUCCESS)
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_join() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
+	for (i = 0; i < manager->nthreads; i++)
+		thread_poke(&manager->threads[i], 0, SELECT_POKE_SHUTDOWN);
+
+	for (i = 0; i < manager->nthreads; i++) {
+		if (isc_thread_join(manager->threads[i].thread, NULL) !=
+		    ISC_R_SUCCESS)
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_join() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+	}
 #endif /* USE_WATCHER_THREAD */
 
 	/*
@@ -4917,8 +5340,6 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 	cleanup_watcher(manager->mctx, manager);
 
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
 	(void)isc_condition_destroy(&manager->shutdown_ok);
 #endif /* USE_WATCHER_THREAD */
 
@@ -4971,6 +5392,15 @@ socket_recv(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 	dev->ev_sender = task;
 
 	if (sock->type == isc_sockettype_udp) {
+#ifdef USE_MMSG
+		/*
+		 * Leave batched requests for internal_recv() to
+		 * satisfy together with the rest of the queue.
+		 */
+		if ((flags & ISC_SOCKFLAG_BATCH) != 0 && !sock->connected)
+			io_state = DOIO_SOFT;
+		else
+#endif
 		io_state = doio_recv(sock, dev);
 	} else {
 		LOCK(&sock->lock);
@@ -5147,6 +5577,7 @@ socket_send(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 	    unsigned int flags)
 {
 	int io_state;
+	isc_boolean_t batch = ISC_FALSE;
 	isc_boolean_t have_lock = ISC_FALSE;
 	isc_task_t *ntask = NULL;
 	isc_result_t result = ISC_R_SUCCESS;
@@ -5173,9 +5604,29 @@ socket_send(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 		}
 	}
 
-	if (sock->type == isc_sockettype_udp)
+	if (sock->type == isc_sockettype_udp) {
+#ifdef USE_MMSG
+		/*
+		 * A batched request goes out at once when nothing is
+		 * queued ahead of it.  Otherwise, or if the socket
+		 * buffer is full, it is queued so that internal_send()
+		 * can write it out together with the others.
+		 */
+		if ((flags & ISC_SOCKFLAG_BATCH) != 0 && !sock->connected &&
+		    sock->manager->maxudp == 0)
+		{
+			batch = ISC_TRUE;
+			LOCK(&sock->lock);
+			have_lock = ISC_TRUE;
+
+			if (ISC_LIST_EMPTY(sock->send_list))
+				io_state = doio_send(sock, dev);
+			else
+				io_state = DOIO_SOFT;
+		} else
+#endif
 		io_state = doio_send(sock, dev);
-	else {
+	} else {
 		LOCK(&sock->lock);
 		have_lock = ISC_TRUE;
 
@@ -5191,7 +5642,7 @@ socket_send(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 		 * We couldn't send all or part of the request right now, so
 		 * queue it unless ISC_SOCKFLAG_NORETRY is set.
 		 */
-		if ((flags & ISC_SOCKFLAG_NORETRY) == 0) {
+		if ((flags & ISC_SOCKFLAG_NORETRY) == 0 || batch) {
 			isc_task_attach(task, &ntask);
 			dev->attributes |= ISC_SOCKEVENTATTR_ATTACHED;
 
@@ -5343,7 +5794,8 @@ isc__socket_sendto2(isc_socket_t *sock0, isc_region_t *region,
 	isc__socket_t *sock = (isc__socket_t *)sock0;
 
 	REQUIRE(VALID_SOCKET(sock));
-	REQUIRE((flags & ~(ISC_SOCKFLAG_IMMEDIATE|ISC_SOCKFLAG_NORETRY)) == 0);
+	REQUIRE((flags & ~(ISC_SOCKFLAG_IMMEDIATE|ISC_SOCKFLAG_NORETRY|
+			    ISC_SOCKFLAG_BATCH)) == 0);
 	if ((flags & ISC_SOCKFLAG_NORETRY) != 0)
 		REQUIRE(sock->type == isc_sockettype_udp);
 	event->ev_sender = sock;
@@ -5577,6 +6029,29 @@ isc__socket_bind(isc_socket_t *sock0, const isc_sockaddr_t *sockaddr,
 						ISC_MSG_FAILED, "failed"));
 		/* Press on... */
 	}
+
+	/*
+	 * SO_REUSEPORT is only useful to us where the kernel spreads the
+	 * datagrams across the sockets sharing the port, so refuse it
+	 * elsewhere and let the caller fall back to a single socket.
+	 */
+	if ((options & ISC_SOCKET_REUSEPORT) != 0 &&
+	    isc_sockaddr_getport(sockaddr) != (in_port_t)0) {
+#if defined(SO_REUSEPORT_LB)
+		int opt = SO_REUSEPORT_LB;
+#elif defined(SO_REUSEPORT) && defined(__linux__)
+		int opt = SO_REUSEPORT;
+#else
+		int opt = -1;
+#endif
+		if (opt == -1 ||
+		    setsockopt(sock->fd, SOL_SOCKET, opt, (void *)&on,
+			       sizeof(on)) < 0)
+		{
+			UNLOCK(&sock->lock);
+			return (ISC_R_NOTIMPLEMENTED);
+		}
+	}
 #ifdef AF_UNIX
  bind_socket:
 #endif
@@ -6388,6 +6863,7 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 			  isc_socketwait_t **swaitp)
 {
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+	isc__socketthread_t *thread;
 	int n;
 #ifdef USE_KQUEUE
 	struct timespec ts, *tsp;
@@ -6409,6 +6885,7 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 #endif
 	if (manager == NULL)
 		return (0);
+	thread = &manager->threads[0];
 
 #ifdef USE_KQUEUE
 	if (tvp != NULL) {
@@ -6417,8 +6894,8 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		tsp = &ts;
 	} else
 		tsp = NULL;
-	swait_private.nevents = kevent(manager->kqueue_fd, NULL, 0,
-				       manager->events, manager->nevents,
+	swait_private.nevents = kevent(thread->kqueue_fd, NULL, 0,
+				       thread->events, thread->nevents,
 				       tsp);
 	n = swait_private.nevents;
 #elif defined(USE_EPOLL)
@@ -6426,32 +6903,32 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		timeout = tvp->tv_sec * 1000 + (tvp->tv_usec + 999) / 1000;
 	else
 		timeout = -1;
-	swait_private.nevents = epoll_wait(manager->epoll_fd,
-					   manager->events,
-					   manager->nevents, timeout);
+	swait_private.nevents = epoll_wait(thread->epoll_fd,
+					   thread->events,
+					   thread->nevents, timeout);
 	n = swait_private.nevents;
 #elif defined(USE_DEVPOLL)
 	/*
 	 * Re-probe every thousand calls.
 	 */
-	if (manager->calls++ > 1000U) {
+	if (thread->calls++ > 1000U) {
 		result = isc_resource_getcurlimit(isc_resource_openfiles,
-						  &manager->open_max);
+						  &thread->open_max);
 		if (result != ISC_R_SUCCESS)
-			manager->open_max = 64;
-		manager->calls = 0;
+			thread->open_max = 64;
+		thread->calls = 0;
 	}
 	for (pass = 0; pass < 2; pass++) {
-		dvp.dp_fds = manager->events;
-		dvp.dp_nfds = manager->nevents;
-		if (dvp.dp_nfds >= manager->open_max)
-			dvp.dp_nfds = manager->open_max - 1;
+		dvp.dp_fds = thread->events;
+		dvp.dp_nfds = thread->nevents;
+		if (dvp.dp_nfds >= thread->open_max)
+			dvp.dp_nfds = thread->open_max - 1;
 		if (tvp != NULL) {
 			dvp.dp_timeout = tvp->tv_sec * 1000 +
 				(tvp->tv_usec + 999) / 1000;
 		} else
 			dvp.dp_timeout = -1;
-		n = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+		n = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 		if (n == -1 && errno == EINVAL) {
 			/*
 			 * {OPEN_MAX} may have dropped.  Look
@@ -6459,14 +6936,16 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 			 */
 			result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 			if (result != ISC_R_SUCCESS)
-				manager->open_max = 64;
+				thread->open_max = 64;
 		} else
 			break;
 	}
 	swait_private.nevents = n;
 #elif defined(USE_SELECT)
+	UNUSED(thread);
+
 	memmove(manager->read_fds_copy, manager->read_fds, manager->fd_bufsize);
 	memmove(manager->write_fds_copy, manager->write_fds,
 		manager->fd_bufsize);
@@ -6486,6 +6965,7 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 isc_result_t
 isc__socketmgr_dispatch(isc_socketmgr_t *manager0, isc_socketwait_t *swait) {
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+	isc__socketthread_t *thread;
 
 	REQUIRE(swait == &swait_private);
 
@@ -6495,12 +6975,13 @@ isc__socketmgr_dispatch(isc_socketmgr_t *manager0, isc_socketwait_t *swait) {
 #endif
 	if (manager == NULL)
 		return (ISC_R_NOTFOUND);
+	thread = &manager->threads[0];
 
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
-	(void)process_fds(manager, manager->events, swait->nevents);
+	(void)process_fds(thread, thread->events, swait->nevents);
 	return (ISC_R_SUCCESS);
 #elif defined(USE_SELECT)
-	process_fds(manager, swait->maxfd, swait->readset, swait->writeset);
+	process_fds(thread, swait->maxfd, swait->readset, swait->writeset);
 	return (ISC_R_SUCCESS);
 #endif
 }
@@ -2652,18 +2652,21 @@ SocketIoThread(LPVOID ThreadContext) {
  */
 isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
-	return (isc_socketmgr_create2(mctx, managerp, 0));
+	return (isc_socketmgr_create2(mctx, managerp, 0, 1));
 }
 
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks)
+		       unsigned int maxsocks, int nthreads)
 {
 	isc_socketmgr_t *manager;
 	isc_result_t result;
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
 
+	/* Completion ports have their own pool of I/O threads. */
+	UNUSED(nthreads);
+
 	if (maxsocks != 0)
 		return (ISC_R_NOTIMPLEMENTED);
 
@@ -3210,7 +3213,8 @@ isc__socket_sendto2(isc_socket_t *sock, isc_region_t *region,
 	LOCK(&sock->lock);
 	CONSISTENT(sock);
 
-	REQUIRE((flags & ~(ISC_SOCKFLAG_IMMEDIATE|ISC_SOCKFLAG_NORETRY)) == 0);
+	REQUIRE((flags & ~(ISC_SOCKFLAG_IMMEDIATE|ISC_SOCKFLAG_NORETRY|
+			    ISC_SOCKFLAG_BATCH)) == 0);
 	if ((flags & ISC_SOCKFLAG_NORETRY) != 0)
 		REQUIRE(sock->type == isc_sockettype_udp);
 	event->ev_sender = sock;
@@ -3259,6 +3263,10 @@ isc__socket_bind(isc_socket_t *sock, const isc_sockaddr_t *sockaddr,
 		UNLOCK(&sock->lock);
 		return (ISC_R_FAMILYMISMATCH);
 	}
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+	}
 	/*
 	 * Only set SO_REUSEADDR when we want a specific port.
 	 */
@@ -50,6 +50,7 @@ cfg_aclconfctx_create(isc_mem_t *mctx, cfg_aclconfctx_t **ret) {
 #ifdef HAVE_GEOIP
 	actx->geoip = NULL;
 #endif
+	actx->cachesize = 0;
 
 	*ret = actx;
 	return (ISC_R_SUCCESS);
@@ -122,6 +123,12 @@ get_acl_def(const cfg_obj_t *cctx, const char *name, const cfg_obj_t **ret) {
 	return (ISC_R_NOTFOUND);
 }
 
+static isc_result_t
+acl_fromconfig(const cfg_obj_t *caml, const cfg_obj_t *cctx,
+	       isc_log_t *lctx, cfg_aclconfctx_t *ctx,
+	       isc_mem_t *mctx, unsigned int nest_level,
+	       isc_uint16_t family, dns_acl_t **target);
+
 static isc_result_t
 convert_named_acl(const cfg_obj_t *nameobj, const cfg_obj_t *cctx,
 		  isc_log_t *lctx, cfg_aclconfctx_t *ctx,
@@ -164,8 +171,8 @@ convert_named_acl(const cfg_obj_t *nameobj, const cfg_obj_t *cctx,
 	DE_CONST(aclname, loop.name);
 	loop.magic = LOOP_MAGIC;
 	ISC_LIST_APPEND(ctx->named_acl_cache, &loop, nextincache);
-	result = cfg_acl_fromconfig(cacl, cctx, lctx, ctx, mctx,
-				    nest_level, &dacl);
+	result = acl_fromconfig(cacl, cctx, lctx, ctx, mctx,
+				nest_level, 0, &dacl);
 	ISC_LIST_UNLINK(ctx->named_acl_cache, &loop, nextincache);
 	loop.magic = 0;
 	loop.name = NULL;
@@ -616,6 +623,11 @@ cfg_acl_fromconfig(const cfg_obj_t *caml, const cfg_obj_t *cctx,
 				    nest_level, 0, target));
 }
 
+/*
+ * Compile the ACL once it is complete.  ACLs built on the way, for
+ * nested lists and named ACLs, are left alone: most of them are merged
+ * into their parent, and dns_acl_compile() takes care of the others.
+ */
 isc_result_t
 cfg_acl_fromconfig2(const cfg_obj_t *caml, const cfg_obj_t *cctx,
 		   isc_log_t *lctx, cfg_aclconfctx_t *ctx,
@@ -623,6 +635,25 @@ cfg_acl_fromconfig2(const cfg_obj_t *caml, const cfg_obj_t *cctx,
 		   isc_uint16_t family, dns_acl_t **target)
 {
 	isc_result_t result;
+
+	result = acl_fromconfig(caml, cctx, lctx, ctx, mctx, nest_level,
+				family, target);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	result = dns_acl_compile(*target, ctx->cachesize);
+	if (result != ISC_R_SUCCESS)
+		dns_acl_detach(target);
+	return (result);
+}
+
+static isc_result_t
+acl_fromconfig(const cfg_obj_t *caml, const cfg_obj_t *cctx,
+	       isc_log_t *lctx, cfg_aclconfctx_t *ctx,
+	       isc_mem_t *mctx, unsigned int nest_level,
+	       isc_uint16_t family, dns_acl_t **target)
+{
+	isc_result_t result;
 	dns_acl_t *dacl = NULL, *inneracl = NULL;
 	dns_aclelement_t *de;
 	const cfg_listelt_t *elt;
@@ -756,9 +787,9 @@ cfg_acl_fromconfig2(const cfg_obj_t *caml, const cfg_obj_t *cctx,
 			 */
 			if (inneracl != NULL)
 				dns_acl_detach(&inneracl);
-			result = cfg_acl_fromconfig(ce, cctx, lctx,
-						    ctx, mctx, new_nest_level,
-						    &inneracl);
+			result = acl_fromconfig(ce, cctx, lctx,
+						ctx, mctx, new_nest_level,
+						0, &inneracl);
 			if (result != ISC_R_SUCCESS)
 				goto cleanup;
 nested_acl:
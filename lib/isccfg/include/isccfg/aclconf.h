@@ -26,6 +26,7 @@ typedef struct cfg_aclconfctx {
 #ifdef HAVE_GEOIP
 	dns_geoip_databases_t *geoip;
 #endif
+	unsigned int cachesize;		/* passed to dns_acl_compile() */
 	isc_refcount_t references;
 } cfg_aclconfctx_t;
 
@@ -80,6 +81,9 @@ cfg_acl_fromconfig2(const cfg_obj_t *caml, const cfg_obj_t *cctx,
  * specified.  If 'family' is not zero, then only addresses/prefixes
  * of a matching family (AF_INET or AF_INET6) may be configured.
  *
+ * The new ACL is compiled with dns_acl_compile(), using a decision
+ * cache of 'ctx->cachesize' entries, and so must not be modified.
+ *
  * On success, attach '*target' to the new dns_acl_t object.
  */
 